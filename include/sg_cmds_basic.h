@@ -74,6 +74,11 @@ int sg_ll_log_select(int sg_fd, bool pcr, bool sp, int pc, int pg_code,
                      int subpg_code, uint8_t * paramp, int param_len,
                      bool noisy, int verbose);
 
+/* Similar to sg_ll_log_select(). See note above about "_pt" suffix. */
+int sg_ll_log_select_pt(struct sg_pt_base * ptp, bool pcr, bool sp, int pc,
+                        int pg_code, int subpg_code, uint8_t * paramp,
+                        int param_len, bool noisy, int verbose);
+
 /* Invokes a SCSI LOG SENSE command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> Log Sense not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_UNIT_ATTENTION,
@@ -90,6 +95,12 @@ int sg_ll_log_sense_v2(int sg_fd, bool ppc, bool sp, int pc, int pg_code,
                        int mx_resp_len, int timeout_secs, int * residp,
                        bool noisy, int verbose);
 
+/* Similar to sg_ll_log_sense_v2(). See note above about "_pt" suffix. */
+int sg_ll_log_sense_pt(struct sg_pt_base * ptp, bool ppc, bool sp, int pc,
+                       int pg_code, int subpg_code, int paramp, uint8_t * resp,
+                       int mx_resp_len, int timeout_secs, int * residp,
+                       bool noisy, int verbose);
+
 /* Invokes a SCSI MODE SELECT (6) command.  Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> invalid opcode, SG_LIB_CAT_ILLEGAL_REQ ->
  * bad field in cdb, * SG_LIB_CAT_NOT_READY -> device not ready,
@@ -102,6 +113,11 @@ int sg_ll_mode_select6_v2(int sg_fd, bool pf, bool rtd, bool sp,
                           void * paramp, int param_len, bool noisy,
                           int verbose);
 
+/* Similar to sg_ll_mode_select6_v2(). See note above about "_pt" suffix. */
+int sg_ll_mode_select6_pt(struct sg_pt_base * ptp, bool pf, bool rtd, bool sp,
+                          void * paramp, int param_len, bool noisy,
+                          int verbose);
+
 /* Invokes a SCSI MODE SELECT (10) command.  Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> invalid opcode, SG_LIB_CAT_ILLEGAL_REQ ->
  * bad field in cdb, * SG_LIB_CAT_NOT_READY -> device not ready,
@@ -114,6 +130,11 @@ int sg_ll_mode_select10_v2(int sg_fd, bool pf, bool rtd, bool sp,
                            void * paramp, int param_len, bool noisy,
                            int verbose);
 
+/* Similar to sg_ll_mode_select10_v2(). See note above about "_pt" suffix. */
+int sg_ll_mode_select10_pt(struct sg_pt_base * ptp, bool pf, bool rtd, bool sp,
+                           void * paramp, int param_len, bool noisy,
+                           int verbose);
+
 /* Invokes a SCSI MODE SENSE (6) command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> invalid opcode, SG_LIB_CAT_ILLEGAL_REQ ->
  * bad field in cdb, * SG_LIB_CAT_NOT_READY -> device not ready,
@@ -123,6 +144,11 @@ int sg_ll_mode_sense6(int sg_fd, bool dbd, int pc, int pg_code,
                       int sub_pg_code, void * resp, int mx_resp_len,
                       bool noisy, int verbose);
 
+/* Similar to sg_ll_mode_sense6(). See note above about "_pt" suffix. */
+int sg_ll_mode_sense6_pt(struct sg_pt_base * ptp, bool dbd, int pc,
+                         int pg_code, int sub_pg_code, void * resp,
+                         int mx_resp_len, bool noisy, int verbose);
+
 /* Invokes a SCSI MODE SENSE (10) command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> invalid opcode, SG_LIB_CAT_ILLEGAL_REQ ->
  * bad field in cdb, * SG_LIB_CAT_NOT_READY -> device not ready,
@@ -139,6 +165,12 @@ int sg_ll_mode_sense10_v2(int sg_fd, bool llbaa, bool dbd, int pc,
                           int mx_resp_len, int timeout_secs, int * residp,
                           bool noisy, int verbose);
 
+/* Similar to sg_ll_mode_sense10_v2(). See note above about "_pt" suffix. */
+int sg_ll_mode_sense10_pt(struct sg_pt_base * ptp, bool llbaa, bool dbd,
+                          int pc, int pg_code, int sub_pg_code, void * resp,
+                          int mx_resp_len, int timeout_secs, int * residp,
+                          bool noisy, int verbose);
+
 /* Invokes a SCSI PREVENT ALLOW MEDIUM REMOVAL command (SPC-3)
  * prevent==0 allows removal, prevent==1 prevents removal ...
  * Return of 0 -> success,
@@ -148,6 +180,10 @@ int sg_ll_mode_sense10_v2(int sg_fd, bool llbaa, bool dbd, int pc,
  * -1 -> other failure */
 int sg_ll_prevent_allow(int sg_fd, int prevent, bool noisy, int verbose);
 
+/* Similar to sg_ll_prevent_allow(). See note above about "_pt" suffix. */
+int sg_ll_prevent_allow_pt(struct sg_pt_base * ptp, int prevent, bool noisy,
+                           int verbose);
+
 /* Invokes a SCSI READ CAPACITY (10) command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> invalid opcode, SG_LIB_CAT_UNIT_ATTENTION
  * -> perhaps media changed, SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb,
@@ -156,6 +192,10 @@ int sg_ll_prevent_allow(int sg_fd, int prevent, bool noisy, int verbose);
 int sg_ll_readcap_10(int sg_fd, bool pmi, unsigned int lba, void * resp,
                      int mx_resp_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_readcap_10(). See note above about "_pt" suffix. */
+int sg_ll_readcap_10_pt(struct sg_pt_base * ptp, bool pmi, unsigned int lba,
+                        void * resp, int mx_resp_len, bool noisy, int verbose);
+
 /* Invokes a SCSI READ CAPACITY (16) command. Returns 0 -> success,
  * SG_LIB_CAT_UNIT_ATTENTION -> media changed??, SG_LIB_CAT_INVALID_OP
  *  -> cdb not supported, SG_LIB_CAT_IlLEGAL_REQ -> bad field in cdb
@@ -164,6 +204,10 @@ int sg_ll_readcap_10(int sg_fd, bool pmi, unsigned int lba, void * resp,
 int sg_ll_readcap_16(int sg_fd, bool pmi, uint64_t llba, void * resp,
                      int mx_resp_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_readcap_16(). See note above about "_pt" suffix. */
+int sg_ll_readcap_16_pt(struct sg_pt_base * ptp, bool pmi, uint64_t llba,
+                        void * resp, int mx_resp_len, bool noisy, int verbose);
+
 /* Invokes a SCSI REPORT LUNS command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> Report Luns not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_ABORTED_COMMAND,
@@ -216,6 +260,11 @@ int sg_ll_sync_cache_10(int sg_fd, bool sync_nv, bool immed, int group,
                         unsigned int lba, unsigned int count, bool noisy,
                         int verbose);
 
+/* Similar to sg_ll_sync_cache_10(). See note above about "_pt" suffix. */
+int sg_ll_sync_cache_10_pt(struct sg_pt_base * ptp, bool sync_nv, bool immed,
+                           int group, unsigned int lba, unsigned int count,
+                           bool noisy, int verbose);
+
 /* Invokes a SCSI TEST UNIT READY command.
  * 'pack_id' is just for diagnostics, safe to set to 0.
  * Return of 0 -> success, SG_LIB_CAT_UNIT_ATTENTION,
@@ -326,6 +375,20 @@ int sg_cmds_open_flags(const char * device_name, int flags, int verbose);
    Implementation calls scsi_pt_close_device(). */
 int sg_cmds_close_device(int device_fd);
 
+/* The sg_ll_* functions that take a file descriptor (rather than a pt
+ * object) get their pt object from a per file descriptor pool, so
+ * repeated commands on the same device reuse one object. Only file
+ * descriptors opened with sg_cmds_open_device() or sg_cmds_open_flags()
+ * are pooled; sg_cmds_close_device() removes the file descriptor (and its
+ * object) from the pool. Such file descriptors should be closed with
+ * sg_cmds_close_device(); one closed otherwise is noticed (via fstat())
+ * when its pooled object is next wanted. The pool can be compiled out by
+ * defining SG_CMDS_NO_PT_POOL. These two functions expose that pool: the
+ * first returns an object associated with sg_fd (or NULL if out of
+ * memory) and the second gives it back (or destructs it). */
+struct sg_pt_base * sg_cmds_get_pt_obj(int sg_fd, int verbose);
+void sg_cmds_put_pt_obj(struct sg_pt_base * ptvp);
+
 const char * sg_cmds_version();
 
 #define SG_NO_DATA_IN 0
@@ -76,6 +76,12 @@ int sg_ll_format_unit_v2(int sg_fd, int fmtpinfo, bool longlist, bool fmtdata,
                          int timeout_secs, void * paramp, int param_len,
                          bool noisy, int verbose);
 
+/* Similar to sg_ll_format_unit_v2(). See note above about "_pt" suffix. */
+int sg_ll_format_unit_pt(struct sg_pt_base * ptp, int fmtpinfo, bool longlist,
+                         bool fmtdata, bool cmplst, int dlist_format, int ffmt,
+                         int timeout_secs, void * paramp, int param_len,
+                         bool noisy, int vb);
+
 /* Invokes a SCSI GET LBA STATUS(16) or GET LBA STATUS(32) command (SBC).
  * Returns 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> GET LBA STATUS(16 or 32) not supported,
@@ -87,11 +93,22 @@ int sg_ll_get_lba_status(int sg_fd, uint64_t start_llba, void * resp,
 int sg_ll_get_lba_status16(int sg_fd, uint64_t start_llba, uint8_t rt,
                            void * resp, int alloc_len, bool noisy,
                            int verbose);
+
+/* Similar to sg_ll_get_lba_status16(). See note above about "_pt" suffix. */
+int sg_ll_get_lba_status16_pt(struct sg_pt_base * ptp, uint64_t start_llba,
+                              uint8_t rt, void * resp, int alloc_len,
+                              bool noisy, int vb);
 int sg_ll_get_lba_status32(int sg_fd, uint64_t start_llba, uint32_t scan_len,
                            uint32_t element_id, uint8_t rt,
                            void * resp, int alloc_len, bool noisy,
                            int verbose);
 
+/* Similar to sg_ll_get_lba_status32(). See note above about "_pt" suffix. */
+int sg_ll_get_lba_status32_pt(struct sg_pt_base * ptp, uint64_t start_llba,
+                              uint32_t scan_len, uint32_t element_id,
+                              uint8_t rt, void * resp, int alloc_len,
+                              bool noisy, int vb);
+
 /* Invokes a SCSI PERSISTENT RESERVE IN command (SPC). Returns 0
  * when successful, SG_LIB_CAT_INVALID_OP if command not supported,
  * SG_LIB_CAT_ILLEGAL_REQ if field in cdb not supported,
@@ -99,6 +116,12 @@ int sg_ll_get_lba_status32(int sg_fd, uint64_t start_llba, uint32_t scan_len,
 int sg_ll_persistent_reserve_in(int sg_fd, int rq_servact, void * resp,
                                 int mx_resp_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_persistent_reserve_in(). See note above about
+ * "_pt" suffix. */
+int sg_ll_persistent_reserve_in_pt(struct sg_pt_base * ptp, int rq_servact,
+                                   void * resp, int mx_resp_len, bool noisy,
+                                   int vb);
+
 /* Invokes a SCSI PERSISTENT RESERVE OUT command (SPC). Returns 0
  * when successful, SG_LIB_CAT_INVALID_OP if command not supported,
  * SG_LIB_CAT_ILLEGAL_REQ if field in cdb not supported,
@@ -107,6 +130,13 @@ int sg_ll_persistent_reserve_out(int sg_fd, int rq_servact, int rq_scope,
                                  unsigned int rq_type, void * paramp,
                                  int param_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_persistent_reserve_out(). See note above about
+ * "_pt" suffix. */
+int sg_ll_persistent_reserve_out_pt(struct sg_pt_base * ptp, int rq_servact,
+                                    int rq_scope, unsigned int rq_type,
+                                    void * paramp, int param_len, bool noisy,
+                                    int vb);
+
 /* Invokes a SCSI READ BLOCK LIMITS command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> READ BLOCK LIMITS not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_ABORTED_COMMAND,
@@ -114,6 +144,10 @@ int sg_ll_persistent_reserve_out(int sg_fd, int rq_servact, int rq_scope,
 int sg_ll_read_block_limits(int sg_fd, void * resp, int mx_resp_len,
                             bool noisy, int verbose);
 
+/* Similar to sg_ll_read_block_limits(). See note above about "_pt" suffix. */
+int sg_ll_read_block_limits_pt(struct sg_pt_base * ptp, void * resp,
+                               int mx_resp_len, bool noisy, int vb);
+
 /* Invokes a SCSI READ BUFFER command (SPC). Return of 0 ->
  * success, SG_LIB_CAT_INVALID_OP -> invalid opcode,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_UNIT_ATTENTION,
@@ -122,6 +156,11 @@ int sg_ll_read_block_limits(int sg_fd, void * resp, int mx_resp_len,
 int sg_ll_read_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
                       void * resp, int mx_resp_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_read_buffer(). See note above about "_pt" suffix. */
+int sg_ll_read_buffer_pt(struct sg_pt_base * ptp, int mode, int buffer_id,
+                         int buffer_offset, void * resp, int mx_resp_len,
+                         bool noisy, int vb);
+
 /* Invokes a SCSI READ DEFECT DATA (10) command (SBC). Return of 0 ->
  * success, SG_LIB_CAT_INVALID_OP -> invalid opcode,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_UNIT_ATTENTION,
@@ -131,6 +170,11 @@ int sg_ll_read_defect10(int sg_fd, bool req_plist, bool req_glist,
                         int dl_format, void * resp, int mx_resp_len,
                         bool noisy, int verbose);
 
+/* Similar to sg_ll_read_defect10(). See note above about "_pt" suffix. */
+int sg_ll_read_defect10_pt(struct sg_pt_base * ptp, bool req_plist,
+                           bool req_glist, int dl_format, void * resp,
+                           int mx_resp_len, bool noisy, int vb);
+
 /* Invokes a SCSI READ LONG (10) command (SBC). Note that 'xfer_len'
  * is in bytes. Returns 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> READ LONG(10) not supported,
@@ -143,6 +187,11 @@ int sg_ll_read_long10(int sg_fd, bool pblock, bool correct, unsigned int lba,
                       void * resp, int xfer_len, int * offsetp, bool noisy,
                       int verbose);
 
+/* Similar to sg_ll_read_long10(). See note above about "_pt" suffix. */
+int sg_ll_read_long10_pt(struct sg_pt_base * ptp, bool pblock, bool correct,
+                         unsigned int lba, void * resp, int xfer_len,
+                         int * offsetp, bool noisy, int vb);
+
 /* Invokes a SCSI READ LONG (16) command (SBC). Note that 'xfer_len'
  * is in bytes. Returns 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> READ LONG(16) not supported,
@@ -155,6 +204,11 @@ int sg_ll_read_long16(int sg_fd, bool pblock, bool correct, uint64_t llba,
                       void * resp, int xfer_len, int * offsetp, bool noisy,
                       int verbose);
 
+/* Similar to sg_ll_read_long16(). See note above about "_pt" suffix. */
+int sg_ll_read_long16_pt(struct sg_pt_base * ptp, bool pblock, bool correct,
+                         uint64_t llba, void * resp, int xfer_len,
+                         int * offsetp, bool noisy, int vb);
+
 /* Invokes a SCSI READ MEDIA SERIAL NUMBER command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> Read media serial number not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_UNIT_ATTENTION,
@@ -163,6 +217,11 @@ int sg_ll_read_long16(int sg_fd, bool pblock, bool correct, uint64_t llba,
 int sg_ll_read_media_serial_num(int sg_fd, void * resp, int mx_resp_len,
                                 bool noisy, int verbose);
 
+/* Similar to sg_ll_read_media_serial_num(). See note above about
+ * "_pt" suffix. */
+int sg_ll_read_media_serial_num_pt(struct sg_pt_base * ptp, void * resp,
+                                   int mx_resp_len, bool noisy, int vb);
+
 /* Invokes a SCSI REASSIGN BLOCKS command.  Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> invalid opcode, SG_LIB_CAT_UNIT_ATTENTION,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_ABORTED_COMMAND,
@@ -171,6 +230,11 @@ int sg_ll_reassign_blocks(int sg_fd, bool longlba, bool longlist,
                           void * paramp, int param_len, bool noisy,
                           int verbose);
 
+/* Similar to sg_ll_reassign_blocks(). See note above about "_pt" suffix. */
+int sg_ll_reassign_blocks_pt(struct sg_pt_base * ptp, bool longlba,
+                             bool longlist, void * paramp, int param_len,
+                             bool noisy, int vb);
+
 /* Invokes a SCSI RECEIVE DIAGNOSTIC RESULTS command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> Receive diagnostic results not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_UNIT_ATTENTION,
@@ -204,6 +268,10 @@ int sg_ll_receive_diag_pt(struct sg_pt_base * ptp, bool pcv, int pg_code,
 int sg_ll_report_id_info(int sg_fd, int itype, void * resp, int max_resp_len,
                          bool noisy, int verbose);
 
+/* Similar to sg_ll_report_id_info(). See note above about "_pt" suffix. */
+int sg_ll_report_id_info_pt(struct sg_pt_base * ptp, int itype, void * resp,
+                            int max_resp_len, bool noisy, int vb);
+
 /* Invokes a SCSI REPORT TARGET PORT GROUPS command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> Report Target Port Groups not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_ABORTED_COMMAND,
@@ -213,6 +281,12 @@ int sg_ll_report_tgt_prt_grp(int sg_fd, void * resp, int mx_resp_len,
 int sg_ll_report_tgt_prt_grp2(int sg_fd, void * resp, int mx_resp_len,
                               bool extended, bool noisy, int verbose);
 
+/* Similar to sg_ll_report_tgt_prt_grp2(). See note above about
+ * "_pt" suffix. */
+int sg_ll_report_tgt_prt_grp2_pt(struct sg_pt_base * ptp, void * resp,
+                                 int mx_resp_len, bool extended, bool noisy,
+                                 int vb);
+
 /* Invokes a SCSI SET TARGET PORT GROUPS command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> Report Target Port Groups not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_ABORTED_COMMAND,
@@ -220,6 +294,10 @@ int sg_ll_report_tgt_prt_grp2(int sg_fd, void * resp, int mx_resp_len,
 int sg_ll_set_tgt_prt_grp(int sg_fd, void * paramp, int param_len, bool noisy,
                           int verbose);
 
+/* Similar to sg_ll_set_tgt_prt_grp(). See note above about "_pt" suffix. */
+int sg_ll_set_tgt_prt_grp_pt(struct sg_pt_base * ptp, void * paramp,
+                             int param_len, bool noisy, int vb);
+
 /* Invokes a SCSI REPORT REFERRALS command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> Report Referrals not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_ABORTED_COMMAND,
@@ -228,6 +306,11 @@ int sg_ll_report_referrals(int sg_fd, uint64_t start_llba, bool one_seg,
                            void * resp, int mx_resp_len, bool noisy,
                            int verbose);
 
+/* Similar to sg_ll_report_referrals(). See note above about "_pt" suffix. */
+int sg_ll_report_referrals_pt(struct sg_pt_base * ptp, uint64_t start_llba,
+                              bool one_seg, void * resp, int mx_resp_len,
+                              bool noisy, int vb);
+
 /* Invokes a SCSI SEND DIAGNOSTIC command. Foreground, extended self tests can
  * take a long time, if so set long_duration flag in which case the timeout
  * is set to 7200 seconds; if the value of long_duration is > 7200 then that
@@ -254,6 +337,10 @@ int sg_ll_send_diag_pt(struct sg_pt_base * ptp, int st_code, bool pf_bit,
 int sg_ll_set_id_info(int sg_fd, int itype, void * paramp, int param_len,
                       bool noisy, int verbose);
 
+/* Similar to sg_ll_set_id_info(). See note above about "_pt" suffix. */
+int sg_ll_set_id_info_pt(struct sg_pt_base * ptp, int itype, void * paramp,
+                         int param_len, bool noisy, int vb);
+
 /* Invokes a SCSI UNMAP (SBC-3) command. Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> command not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_ABORTED_COMMAND,
@@ -265,6 +352,11 @@ int sg_ll_unmap(int sg_fd, int group_num, int timeout_secs, void * paramp,
 int sg_ll_unmap_v2(int sg_fd, bool anchor, int group_num, int timeout_secs,
                    void * paramp, int param_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_unmap_v2(). See note above about "_pt" suffix. */
+int sg_ll_unmap_pt(struct sg_pt_base * ptp, bool anchor, int group_num,
+                   int timeout_secs, void * paramp, int param_len, bool noisy,
+                   int vb);
+
 /* Invokes a SCSI VERIFY (10) command (SBC and MMC).
  * Note that 'veri_len' is in blocks while 'data_out_len' is in bytes.
  * Returns of 0 -> success,
@@ -279,6 +371,12 @@ int sg_ll_verify10(int sg_fd, int vrprotect, bool dpo, int bytechk,
                    int data_out_len, unsigned int * infop, bool noisy,
                    int verbose);
 
+/* Similar to sg_ll_verify10(). See note above about "_pt" suffix. */
+int sg_ll_verify10_pt(struct sg_pt_base * ptp, int vrprotect, bool dpo,
+                      int bytchk, unsigned int lba, int veri_len,
+                      void * data_out, int data_out_len, unsigned int * infop,
+                      bool noisy, int vb);
+
 /* Invokes a SCSI VERIFY (16) command (SBC).
  * Note that 'veri_len' is in blocks while 'data_out_len' is in bytes.
  * Returns of 0 -> success,
@@ -293,6 +391,12 @@ int sg_ll_verify16(int sg_fd, int vrprotect, bool dpo, int bytechk,
                    void * data_out, int data_out_len, uint64_t * infop,
                    bool noisy, int verbose);
 
+/* Similar to sg_ll_verify16(). See note above about "_pt" suffix. */
+int sg_ll_verify16_pt(struct sg_pt_base * ptp, int vrprotect, bool dpo,
+                      int bytchk, uint64_t llba, int veri_len, int group_num,
+                      void * data_out, int data_out_len, uint64_t * infop,
+                      bool noisy, int vb);
+
 /* Invokes a SCSI WRITE BUFFER command (SPC). Return of 0 ->
  * success, SG_LIB_CAT_INVALID_OP -> invalid opcode,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_UNIT_ATTENTION,
@@ -314,6 +418,12 @@ sg_ll_write_buffer_v2(int sg_fd, int mode, int m_specific, int buffer_id,
                       uint32_t param_len, int timeout_secs, bool noisy,
                       int verbose);
 
+/* Similar to sg_ll_write_buffer_v2(). See note above about "_pt" suffix. */
+int sg_ll_write_buffer_pt(struct sg_pt_base * ptp, int mode, int m_specific,
+                          int buffer_id, uint32_t buffer_offset, void * paramp,
+                          uint32_t param_len, int timeout_secs, bool noisy,
+                          int vb);
+
 /* Invokes a SCSI WRITE LONG (10) command (SBC). Note that 'xfer_len'
  * is in bytes. Returns 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> WRITE LONG(10) not supported,
@@ -326,6 +436,11 @@ int sg_ll_write_long10(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
                        unsigned int lba, void * data_out, int xfer_len,
                        int * offsetp, bool noisy, int verbose);
 
+/* Similar to sg_ll_write_long10(). See note above about "_pt" suffix. */
+int sg_ll_write_long10_pt(struct sg_pt_base * ptp, bool cor_dis, bool wr_uncor,
+                          bool pblock, unsigned int lba, void * data_out,
+                          int xfer_len, int * offsetp, bool noisy, int vb);
+
 /* Invokes a SCSI WRITE LONG (16) command (SBC). Note that 'xfer_len'
  * is in bytes. Returns 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> WRITE LONG(16) not supported,
@@ -338,6 +453,11 @@ int sg_ll_write_long16(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
                        uint64_t llba, void * data_out, int xfer_len,
                        int * offsetp, bool noisy, int verbose);
 
+/* Similar to sg_ll_write_long16(). See note above about "_pt" suffix. */
+int sg_ll_write_long16_pt(struct sg_pt_base * ptp, bool cor_dis, bool wr_uncor,
+                          bool pblock, uint64_t llba, void * data_out,
+                          int xfer_len, int * offsetp, bool noisy, int vb);
+
 /* Invokes a SPC-3 SCSI RECEIVE COPY RESULTS command. In SPC-4 this function
  * supports all service action variants of the THIRD-PARTY COPY IN opcode.
  * SG_LIB_CAT_INVALID_OP -> Receive copy results not supported,
@@ -347,6 +467,12 @@ int sg_ll_write_long16(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
 int sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
                                int mx_resp_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_receive_copy_results(). See note above about
+ * "_pt" suffix. */
+int sg_ll_receive_copy_results_pt(struct sg_pt_base * ptp, int sa, int list_id,
+                                  void * resp, int mx_resp_len, bool noisy,
+                                  int vb);
+
 /* Invokes a SCSI EXTENDED COPY(LID1) command. For EXTENDED COPY(LID4)
  * including POPULATE TOKEN and WRITE USING TOKEN use
  * sg_ll_3party_copy_out().  Return of 0 -> success,
@@ -357,6 +483,10 @@ int sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
 int sg_ll_extended_copy(int sg_fd, void * paramp, int param_len, bool noisy,
                         int verbose);
 
+/* Similar to sg_ll_extended_copy(). See note above about "_pt" suffix. */
+int sg_ll_extended_copy_pt(struct sg_pt_base * ptp, void * paramp,
+                           int param_len, bool noisy, int vb);
+
 /* Handles various service actions associated with opcode 0x83 which is
  * called THIRD PARTY COPY OUT. These include the EXTENDED COPY(LID4),
  * POPULATE TOKEN and WRITE USING TOKEN commands. Return of 0 -> success,
@@ -368,6 +498,12 @@ int sg_ll_3party_copy_out(int sg_fd, int sa, unsigned int list_id,
                           int group_num, int timeout_secs, void * paramp,
                           int param_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_3party_copy_out(). See note above about "_pt" suffix. */
+int sg_ll_3party_copy_out_pt(struct sg_pt_base * ptp, int sa,
+                             unsigned int list_id, int group_num,
+                             int timeout_secs, void * paramp, int param_len,
+                             bool noisy, int vb);
+
 /* Invokes a SCSI PRE-FETCH(10), PRE-FETCH(16) or SEEK(10) command (SBC).
  * Returns 0 -> success, 25 (SG_LIB_CAT_CONDITION_MET), various SG_LIB_CAT_*
  * positive values or -1 -> other errors. Note that CONDITION MET status
@@ -381,6 +517,11 @@ int sg_ll_pre_fetch_x(int sg_fd, bool do_seek10, bool cdb16, bool immed,
                       uint64_t lba, uint32_t num_blocks, int group_num,
                       int timeout_secs, bool noisy, int verbose);
 
+/* Similar to sg_ll_pre_fetch_x(). See note above about "_pt" suffix. */
+int sg_ll_pre_fetch_x_pt(struct sg_pt_base * ptp, bool do_seek10, bool cdb16,
+                         bool immed, uint64_t lba, uint32_t num_blocks,
+                         int group_num, int timeout_secs, bool noisy, int vb);
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,6 +14,11 @@
 extern "C" {
 #endif
 
+/* Functions with the "_pt" suffix take a pointer to an object (derived from)
+ * sg_pt_base rather than an open file descriptor as their first argument.
+ * See the similar note in sg_cmds_basic.h . */
+
+struct sg_pt_base;
 
 /* Invokes a SCSI GET CONFIGURATION command (MMC-3...6).
  * Returns 0 when successful, SG_LIB_CAT_INVALID_OP if command not
@@ -22,6 +27,10 @@ extern "C" {
 int sg_ll_get_config(int sg_fd, int rt, int starting, void * resp,
                      int mx_resp_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_get_config(). See note above about "_pt" suffix. */
+int sg_ll_get_config_pt(struct sg_pt_base * ptp, int rt, int starting,
+                        void * resp, int mx_resp_len, bool noisy, int verbose);
+
 /* Invokes a SCSI GET PERFORMANCE command (MMC-3...6).
  * Returns 0 when successful, SG_LIB_CAT_INVALID_OP if command not
  * supported, SG_LIB_CAT_ILLEGAL_REQ if field in cdb not supported,
@@ -30,6 +39,12 @@ int sg_ll_get_performance(int sg_fd, int data_type, unsigned int starting_lba,
                           int max_num_desc, int type, void * resp,
                           int mx_resp_len, bool noisy, int verbose);
 
+/* Similar to sg_ll_get_performance(). See note above about "_pt" suffix. */
+int sg_ll_get_performance_pt(struct sg_pt_base * ptp, int data_type,
+                             unsigned int starting_lba, int max_num_desc,
+                             int ttype, void * resp, int mx_resp_len,
+                             bool noisy, int verbose);
+
 /* Invokes a SCSI SET CD SPEED command (MMC).
  * Return of 0 -> success, SG_LIB_CAT_INVALID_OP -> command not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_UNIT_ATTENTION,
@@ -38,6 +53,11 @@ int sg_ll_get_performance(int sg_fd, int data_type, unsigned int starting_lba,
 int sg_ll_set_cd_speed(int sg_fd, int rot_control, int drv_read_speed,
                        int drv_write_speed, bool noisy, int verbose);
 
+/* Similar to sg_ll_set_cd_speed(). See note above about "_pt" suffix. */
+int sg_ll_set_cd_speed_pt(struct sg_pt_base * ptp, int rot_control,
+                          int drv_read_speed, int drv_write_speed, bool noisy,
+                          int verbose);
+
 /* Invokes a SCSI SET STREAMING command (MMC). Return of 0 -> success,
  * SG_LIB_CAT_INVALID_OP -> Set Streaming not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_ABORTED_COMMAND,
@@ -46,6 +66,10 @@ int sg_ll_set_cd_speed(int sg_fd, int rot_control, int drv_read_speed,
 int sg_ll_set_streaming(int sg_fd, int type, void * paramp, int param_len,
                         bool noisy, int verbose);
 
+/* Similar to sg_ll_set_streaming(). See note above about "_pt" suffix. */
+int sg_ll_set_streaming_pt(struct sg_pt_base * ptp, int type, void * paramp,
+                           int param_len, bool noisy, int verbose);
+
 
 #ifdef __cplusplus
 }
@@ -11,7 +11,7 @@
  */
 
 /*
- * Version 1.07 [20181211]
+ * Version 1.08 [20261017]
  */
 
 /*
@@ -184,6 +184,71 @@ int sg_err_category_new(int scsi_status, int host_status, int driver_status,
 int sg_err_category3(struct sg_io_hdr * hp);
 
 
+/* Command trace capture. When the SG_PT_TRACE_EV environment variable is
+ * set to 'FILE[,data]' each command sent by do_scsi_pt() is appended to
+ * FILE as a compact binary record. With ',data' a hash of the data-in
+ * and data-out buffers is also recorded. Each process that opens FILE
+ * first appends a segment record; timestamps in the command records that
+ * follow are relative to it. All fields are little endian and records are
+ * padded to a multiple of 8 bytes. See sg_pt_linux_trace.c . */
+#define SG_PT_TRACE_EV "SG3_UTILS_TRACE"
+#define SG_PT_TRACE_MAGIC "SGPTTRC1"    /* 8 bytes, in each segment record */
+#define SG_PT_TRACE_VERSION 1
+
+#define SG_PT_TRACE_T_CMD 1             /* record types */
+#define SG_PT_TRACE_T_SEG 2
+
+#define SG_PT_TRACE_F_DIN 0x1           /* command record flags */
+#define SG_PT_TRACE_F_DOUT 0x2
+#define SG_PT_TRACE_F_NVME 0x4          /* 'cdb' is a 64 byte NVMe command */
+#define SG_PT_TRACE_F_DIN_HASH 0x8
+#define SG_PT_TRACE_F_DOUT_HASH 0x10
+
+struct sg_pt_trace_rec {        /* decoded form of either record type */
+    int type;                   /* SG_PT_TRACE_T_CMD or SG_PT_TRACE_T_SEG */
+    int flags;                  /* T_SEG: 0x1 -> data hashes being taken */
+    uint32_t pid;               /* T_SEG only */
+    uint32_t tid;               /* T_CMD only: Linux thread id */
+    uint32_t duration_us;
+    uint32_t din_len;           /* requested lengths */
+    uint32_t dout_len;
+    int resid;
+    int res;                    /* value returned by do_scsi_pt() */
+    int status;                 /* SCSI status or NVMe status field */
+    int cdb_len;
+    int sense_len;
+    uint64_t start_ns;          /* T_SEG: realtime of segment start;
+                                 * T_CMD: time since segment start */
+    uint64_t din_hash;          /* valid if SG_PT_TRACE_F_DIN_HASH */
+    uint64_t dout_hash;         /* valid if SG_PT_TRACE_F_DOUT_HASH */
+    const uint8_t * cdbp;       /* points into the given buffer */
+    const uint8_t * sensep;
+};
+
+/* Returns true if command tracing is active in this process. The first
+ * call checks the SG_PT_TRACE_EV environment variable. */
+bool sg_pt_trace_active(void);
+
+/* Monotonic clock in nanoseconds, used for trace timestamps. */
+uint64_t sg_pt_trace_now_ns(void);
+
+/* For applications that drive the sg v3 interface directly (e.g. with
+ * write() and read() ) rather than via do_scsi_pt(). Call after 'hp' has
+ * completed; start_ns should be sg_pt_trace_now_ns() from when the command
+ * was issued and res is 0 or a negated errno. Does nothing unless tracing
+ * is active. */
+void sg_pt_trace_v3(const struct sg_io_hdr * hp, uint64_t start_ns, int res);
+
+/* Decodes the record at the start of bp (with blen bytes available) into
+ * *rp. Returns the length of that record, 0 if blen is 0, or -1 if the
+ * record is malformed or truncated. */
+int sg_pt_trace_decode(const uint8_t * bp, int blen,
+                       struct sg_pt_trace_rec * rp);
+
+/* The hash recorded for data buffers: FNV-1a taken 8 bytes at a time. */
+uint64_t sg_pt_trace_hash(const uint8_t * bp, uint32_t len);
+
+
 /* Note about SCSI status codes found in older versions of Linux.
    Linux has traditionally used a 1 bit right shifted and masked
    version of SCSI standard status codes. Now CHECK_CONDITION
@@ -243,6 +243,59 @@ bool sg_get_sense_filemark_eom_ili(const uint8_t * sensep, int sb_len,
 bool sg_get_sense_progress_fld(const uint8_t * sensep, int sb_len,
                                int * progress_outp);
 
+/* Salient fields of a sense buffer, decoded in one pass by
+ * sg_decode_sense() for callers that classify errors in hot paths. Nothing
+ * is allocated: desc_off[] holds the byte offsets of (up to
+ * SG_SENSE_DESC_MAX) descriptors within the caller's sense buffer, which
+ * should be kept if more detail is needed. Each value field is 0 unless
+ * the flag guarding it is set, except 'info' which, as with
+ * sg_get_sense_info_fld(), is yielded from fixed format sense even when
+ * the VALID bit is clear. */
+#define SG_SENSE_DESC_MAX 16
+
+struct sg_sense_fields {
+    struct sg_scsi_sense_hdr ssh;   /* as from sg_scsi_normalize_sense() */
+    int category;       /* SG_LIB_CAT_* as from sg_err_category_sense() */
+    bool descriptor;    /* response code 0x72 or 0x73 */
+    bool info_valid;    /* as from sg_get_sense_info_fld() */
+    bool has_cmd_spec;  /* as from sg_get_sense_cmd_spec_fld() */
+    bool has_progress;  /* as from sg_get_sense_progress_fld() */
+    bool has_fm_eom_ili;  /* as from sg_get_sense_filemark_eom_ili() */
+    bool filemark;
+    bool eom;
+    bool ili;
+    bool sksv;          /* sense key specific field valid */
+    uint8_t sks[3];     /* sense key specific field, byte 0 has SKSV */
+    uint8_t num_desc;   /* number of valid entries in desc_off[] */
+    uint8_t desc_off[SG_SENSE_DESC_MAX];
+    int progress;       /* multiply by 100, divide by 65536 for percent */
+    uint64_t info;
+    uint64_t cmd_spec;
+};
+
+/* Decodes fixed or descriptor format sense data at 'sensep' into '*sfp',
+ * which is zeroed first. Returns the SG_LIB_CAT_* category (also placed in
+ * sfp->category); SG_LIB_CAT_SENSE if the sense data cannot be decoded. */
+int sg_decode_sense(const uint8_t * sensep, int sb_len,
+                    struct sg_sense_fields * sfp);
+
+/* One completed SCSI command for sg_decode_sense_vec() */
+struct sg_sense_compl {
+    int scsi_status;            /* in: SAM status */
+    int sb_len;                 /* in: bytes of sense data at 'sensep' */
+    const uint8_t * sensep;     /* in: may be NULL when sb_len is 0 */
+    struct sg_sense_fields sf;  /* out */
+};
+
+/* Classifies 'num' completions in one call. GOOD status yields
+ * SG_LIB_CAT_CLEAN, CHECK CONDITION (and COMMAND TERMINATED) have their
+ * sense decoded by sg_decode_sense(), other statuses map to the
+ * SG_LIB_CAT_* values sg_cmds_process_resp() uses for them, else
+ * SG_LIB_CAT_OTHER. The category of each is placed in its sf.category .
+ * Returns the number of completions whose category is other than
+ * SG_LIB_CAT_CLEAN, SG_LIB_CAT_RECOVERED or SG_LIB_CAT_CONDITION_MET. */
+int sg_decode_sense_vec(struct sg_sense_compl * arr, int num);
+
 /* Closely related to sg_print_sense(). Puts decoded sense data in 'buff'.
  * Usually multiline with multiple '\n' including one trailing. If
  * 'raw_sinfo' set appends sense buffer in hex. 'leadin' is string prepended
@@ -534,6 +587,10 @@ int sg_vpd_dev_id_iter(const uint8_t * initial_desig_desc, int page_len,
  * If errnum is negative, flip its sign. */
 char * safe_strerror(int errnum);
 
+/* Thread safe version of safe_strerror(). Places the string in 'b' (of
+ * 'blen' bytes) and returns 'b'. */
+char * sg_strerror_r(int errnum, char * b, int blen);
+
 
 /* Print (to stdout) 'str' of bytes in hex, 16 bytes per line optionally
  * followed at the right hand side of the line with an ASCII interpretation.
@@ -579,6 +636,15 @@ int hex2str(const uint8_t * b_str, int len, const char * leadin, int format,
 int sg_f2hex_arr(const char * fname, bool as_binary, bool no_space,
                  uint8_t * mp_arr, int * mp_arr_len, int max_arr_len);
 
+/* Like sg_f2hex_arr() but the array is allocated (with malloc()) to fit
+ * whatever fname holds, so the input is not size limited. On success
+ * *mp_arrp points to at least MAX(*mp_arr_len, min_arr_len) bytes, those
+ * after the first *mp_arr_len being zeroed, and should be given to free()
+ * by the caller. On error *mp_arrp is set to NULL. */
+int sg_f2hex_arr_alloc(const char * fname, bool as_binary, bool no_space,
+                       uint8_t ** mp_arrp, int * mp_arr_len,
+                       int min_arr_len);
+
 /* Returns true when executed on big endian machine; else returns false.
  * Useful for displaying ATA identify words (which need swapping on a
  * big endian machine). */
@@ -665,6 +731,110 @@ uint32_t sg_get_page_size(void);
  * else returns false. */
 bool sg_is_aligned(const void * pointer, int byte_count);
 
+/* A pool of page aligned data buffers, all of buf_sz bytes (rounded up to
+ * the page size). num_hint is the number of buffers expected to be in use
+ * at once (e.g. one per thread). Buffers are carved from larger "arenas".
+ * With SG_BUF_POOL_HUGE, if num_hint buffers fill at least half of a
+ * SG_BUF_POOL_HUGE_SZ page, arenas are a multiple of that size and are
+ * backed by huge pages when the OS allows (in Linux: hugetlbfs pages, or
+ * failing that transparent huge pages, or failing that normal pages).
+ * With SG_BUF_POOL_NUMA each NUMA node has its own arenas, touched by the
+ * first thread from that node to need one, so a buffer is local to the
+ * node of the thread calling sg_buf_pool_get(). Buffers returned by
+ * sg_buf_pool_put() are kept for re-use on a small per thread free list
+ * and then on a lock-free free list per node. New buffers are zeroed,
+ * re-used ones are not. sg_buf_pool_get() and sg_buf_pool_put() are
+ * thread safe; sg_buf_pool_destroy() frees all buffers of the pool,
+ * including those not put back. Create returns NULL if out of memory. */
+#define SG_BUF_POOL_HUGE 0x1
+#define SG_BUF_POOL_NUMA 0x2
+#define SG_BUF_POOL_HUGE_SZ (2 * 1024 * 1024)
+
+struct sg_buf_pool;
+
+struct sg_buf_pool * sg_buf_pool_create(uint32_t buf_sz, int num_hint,
+                                        int flags, int vb);
+/* Returns NULL if out of memory */
+uint8_t * sg_buf_pool_get(struct sg_buf_pool * bpp);
+void sg_buf_pool_put(struct sg_buf_pool * bpp, uint8_t * bp);
+/* Returns true if any of the pool's arenas are backed by huge pages */
+bool sg_buf_pool_is_huge(const struct sg_buf_pool * bpp);
+void sg_buf_pool_destroy(struct sg_buf_pool * bpp);
+
+/* NUMA placement of threads near a device's host adapter (HBA). For fd
+ * open on an sg or block device, or on a regular file (then the block
+ * device holding it is used), sg_get_fd_numa() finds the HBA's NUMA node
+ * in sysfs and sets bit n of cpu_mask[n / 64] for each CPU local to the
+ * HBA (up to 64 * mask_words CPUs). Returns the node, or -1 if not known
+ * (e.g. on a single node system). The mask may still be set when the node
+ * is -1; it is all zeros when the local CPUs are not known. In Linux only,
+ * other OSes always report -1. */
+#define SG_CPU_MASK_WORDS 16    /* enough for 1024 CPUs */
+
+int sg_get_fd_numa(int fd, uint64_t * cpu_mask, int mask_words, int vb);
+/* Binds the calling thread to the CPUs set in cpu_mask. Returns 0 on
+ * success, EINVAL if no CPUs are set, else an errno value. */
+int sg_set_thread_cpus(const uint64_t * cpu_mask, int mask_words);
+/* Returns the NUMA node of the CPU the calling thread is running on, or -1.
+ * If cpup is not NULL, places that CPU (or -1) in *cpup. */
+int sg_get_thread_numa(int * cpup);
+/* Returns the NUMA node of the memory page holding addr, or -1. The page
+ * must have been touched. */
+int sg_get_addr_numa(const void * addr);
+
+/* Data checksums. sg_crc32c() continues crc (0 to start) over len bytes at
+ * bp, using the CRC32C instructions of the CPU when it has them.
+ * sg_xxh64() returns the XXH64 hash of len bytes at bp. */
+#define SG_HASH_CRC32C 1
+#define SG_HASH_XXH64 2
+
+uint32_t sg_crc32c(uint32_t crc, const uint8_t * bp, uint64_t len);
+uint64_t sg_xxh64(const uint8_t * bp, uint64_t len, uint64_t seed);
+/* Returns the CRC32C of A followed by B given crc_a, crc_b and the length
+ * of B */
+uint32_t sg_crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b);
+
+/* A hash stage for the dd family: chunks of data passing through a copy
+ * are hashed, one hash per extent (i.e. per chunk), on hashing threads so
+ * the copy is not held up. The stage has buffers for num_thr threads; the
+ * utility creates those threads, each given sg_hash_stage_worker() to
+ * run, and after the copy calls sg_hash_stage_stop() then joins them.
+ * sg_hash_stage_submit() hands the chunk at bp to those threads, waiting
+ * while they have num_thr * 4 chunks in hand (when num_thr is 0, or no
+ * worker is running, it hashes the chunk itself). The chunk is hashed
+ * where it is so bp may be written out, but not changed or freed, until
+ * sg_hash_stage_wait(hsp, bp) returns; sg_hash_stage_wait(hsp, NULL)
+ * waits for all chunks. blk is the first block of the chunk
+ * relative to the start of the copy, chunks may be submitted in any order
+ * and from several threads, each no longer than max_blks blocks. Once the
+ * workers are joined sg_hash_stage_finish() hashes anything left then
+ * reports the hash of the whole stream: for CRC32C that is the CRC32C of
+ * all the data, for XXH64 it is the XXH64 of the (little endian) extent
+ * hashes in block order (so it is only compared by verify when the
+ * extents line up). If manifest_fn is given the extent hashes are
+ * written to it; if verify_fn is given they are checked against the
+ * manifest in that file, perhaps written by an earlier copy. Returns 0,
+ * SG_LIB_CAT_MISCOMPARE if the verify failed, or another SG_LIB_* error. */
+#define SG_HASH_MAX_THR 64
+struct sg_hash_stage;
+
+/* Returns NULL if out of memory */
+struct sg_hash_stage * sg_hash_stage_create(int alg, int num_thr, int bs,
+                                            int max_blks);
+/* For pthread_create(), arg is the stage. Returns NULL */
+void * sg_hash_stage_worker(void * hsp);
+void sg_hash_stage_stop(struct sg_hash_stage * hsp);
+void sg_hash_stage_submit(struct sg_hash_stage * hsp, int64_t blk,
+                          const uint8_t * bp, int num_blks);
+void sg_hash_stage_wait(struct sg_hash_stage * hsp, const uint8_t * bp);
+int sg_hash_stage_finish(struct sg_hash_stage * hsp, const char * manifest_fn,
+                         const char * verify_fn, int vb);
+void sg_hash_stage_destroy(struct sg_hash_stage * hsp);
+/* Decodes the argument of a dd style 'hash=ALG[,THR]' operand: ALG is
+ * crc32c or xxh64, THR the number of hashing threads (default 2, may be
+ * 0). Returns true if valid. */
+bool sg_hash_parse(const char * arg, int * algp, int * num_thrp);
+
 /* Does similar job to sg_get_unaligned_be*() but this function starts at
  * a given start_bit (i.e. within byte, so 7 is MSbit of byte and 0 is LSbit)
  * offset. Maximum number of num_bits is 64. For example, these two
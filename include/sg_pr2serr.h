@@ -27,6 +27,7 @@
 
 
 #include <stdio.h>
+#include <stdarg.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -64,6 +65,35 @@ int sg_scnpr(char * cp, int cp_max_len, const char * fmt, ...);
 
 #endif
 
+/* Lock-free logging for multi-threaded utilities (e.g. sgp_dd). Once
+ * sg_log_ring_start() is called, output from pr2serr(), pr2ws(),
+ * sg_log_vpr() and sg_log_write() is queued on a ring owned by the calling
+ * thread rather than written, so threads do not contend on a lock to log.
+ * Queued messages are written, in the order they were logged, by whichever
+ * thread calls sg_log_ring_drain(); usually that is a thread given
+ * sg_log_ring_drain_loop() to run which drains until sg_log_ring_stop()
+ * is called. Anything still queued is drained at exit. Before start and
+ * after stop messages are written directly. A ring of ring_sz bytes (0
+ * for the default) is made for each thread as it first logs. Messages
+ * logged between sg_log_ring_hold() and sg_log_ring_release() by a thread
+ * are written together, as one message. */
+#define SG_LOG_RING_DEF_SZ (64 * 1024)
+#define SG_LOG_RING_TS 0x1      /* prefix lines with seconds since start */
+#define SG_LOG_RING_TID 0x2     /* prefix lines with <n>, n is ring number */
+
+/* Returns 0 if ok, else an error code */
+int sg_log_ring_start(int ring_sz, int flags);
+void sg_log_ring_stop(void);
+/* Returns the number of messages written */
+int sg_log_ring_drain(void);
+/* For pthread_create(), arg is not used. Returns NULL */
+void * sg_log_ring_drain_loop(void * arg);
+void sg_log_ring_hold(void);
+void sg_log_ring_release(void);
+/* Like fwrite(b, 1, len, fp) and vfprintf(fp, fmt, args) */
+int sg_log_write(FILE * fp, const char * b, int len);
+int sg_log_vpr(FILE * fp, const char * fmt, va_list args);
+
 
 #ifdef __cplusplus
 }
@@ -119,6 +119,25 @@ void set_scsi_pt_data_in(struct sg_pt_base * objp,   /* from device */
 void set_scsi_pt_data_out(struct sg_pt_base * objp,    /* to device */
                           const uint8_t * dxferp, int dxfer_olen);
 
+/* Following is a guard which is defined when set_scsi_pt_data_in_iovec()
+ * and set_scsi_pt_data_out_iovec() are present. Older versions of this
+ * library may not have these functions. */
+#define SCSI_PT_IOVEC_FUNCTIONS 1
+struct iovec;
+/* Alternatives to set_scsi_pt_data_in() and set_scsi_pt_data_out() that
+ * take a scatter gather list of 'iov_count' elements (see <sys/uio.h>).
+ * The data transfer length is the sum of the iov_len fields. The list
+ * and the buffers it points to must remain valid until the command has
+ * completed. Only one of the plain and the _iovec setters may be used
+ * for each direction. In Linux the list is given to the sg driver (and
+ * to SG_IO on block devices) as is; for bsg, NVMe and emulated devices
+ * the data is copied through a contiguous buffer. Other ports only
+ * accept a list with one element. */
+void set_scsi_pt_data_in_iovec(struct sg_pt_base * objp,  /* from device */
+                               const struct iovec * iovp, int iov_count);
+void set_scsi_pt_data_out_iovec(struct sg_pt_base * objp,   /* to device */
+                                const struct iovec * iovp, int iov_count);
+
 /* Set a pointer and length to be used for metadata transferred to
  * (out_true=true) or from (out_true=false) device (NVMe only) */
 void set_pt_metadata_xfer(struct sg_pt_base * objp, uint8_t * mdxferp,
@@ -138,6 +157,19 @@ void set_scsi_pt_task_attr(struct sg_pt_base * objp, int attribute,
  * are given, use the pass-through default. */
 #define SCSI_PT_FLAGS_QUEUE_AT_TAIL 0x10
 #define SCSI_PT_FLAGS_QUEUE_AT_HEAD 0x20
+/* Polled completion: rather than sleeping in the OS until the command
+ * completes, do_scsi_pt() submits it asynchronously then spins checking
+ * for its completion. If that takes longer than the spin budget it falls
+ * back to a blocking wait. The budget (in microseconds) is OR-ed in with
+ * SCSI_PT_FLAGS_SPIN_US(); 0 selects SCSI_PT_DEF_SPIN_US while
+ * SCSI_PT_SPIN_FOREVER never blocks. While a polled command is in
+ * progress no other commands should be submitted on that file descriptor
+ * with submit_scsi_pt(). Only in Linux (sg, bsg, io_uring and emulated
+ * devices), ignored elsewhere or when the device can not do it. */
+#define SCSI_PT_FLAGS_POLLED 0x40
+#define SCSI_PT_FLAGS_SPIN_US(us) ((0x7fff & (int)(us)) << 16)
+#define SCSI_PT_DEF_SPIN_US 50
+#define SCSI_PT_SPIN_FOREVER 0x7fff
 /* Set (potentially OS dependent) flags for pass-through mechanism.
  * Apart from contradictions, flags can be OR-ed together. */
 void set_scsi_pt_flags(struct sg_pt_base * objp, int flags);
@@ -145,6 +177,7 @@ void set_scsi_pt_flags(struct sg_pt_base * objp, int flags);
 #define SCSI_PT_DO_START_OK 0
 #define SCSI_PT_DO_BAD_PARAMS 1
 #define SCSI_PT_DO_TIMEOUT 2
+#define SCSI_PT_DO_NOT_SUPPORTED 4      /* e.g. async on this device type */
 #define SCSI_PT_DO_NVME_STATUS 48       /* == SG_LIB_NVME_STATUS */
 /* If OS error prior to or during command submission then returns negated
  * error value (e.g. Unix '-errno'). This includes interrupted system calls
@@ -157,6 +190,97 @@ void set_scsi_pt_flags(struct sg_pt_base * objp, int flags);
 int do_scsi_pt(struct sg_pt_base * objp, int fd, int timeout_secs,
                int verbose);
 
+/* Following is a guard which is defined when the asynchronous pass-through
+ * functions (submit_scsi_pt(), receive_scsi_pt() and poll_scsi_pt()) are
+ * present. Older versions of this library do not have these functions. */
+#define SCSI_PT_ASYNC_FUNCTIONS 1
+
+/* Sends the command held in objp to the device without waiting for it to
+ * complete. Each object submitted represents one command in flight, so the
+ * queue depth on 'fd' is the number of objects submitted but not yet
+ * received. The caller chooses that depth; the OS may impose a limit (e.g.
+ * 16 per file descriptor for the Linux sg v3 driver) in which case -EAGAIN
+ * or -EBUSY is returned and the caller should receive some completions
+ * before trying again. The objp must not be cleared, re-used or destructed
+ * until it has been returned by receive_scsi_pt(). Returns 0 if the command
+ * has been queued, a negated errno if the OS rejected it, or a positive
+ * SCSI_PT_DO_* value. SCSI_PT_DO_NOT_SUPPORTED is returned when this device
+ * type (or OS) has no asynchronous pass-through. */
+int submit_scsi_pt(struct sg_pt_base * objp, int fd, int timeout_secs,
+                   int verbose);
+
+/* Reaps up to max_num commands, previously sent with submit_scsi_pt() on
+ * 'fd', that have completed. Pointers to their objects are placed in
+ * objpp[0] to objpp[<return_value> - 1] in completion order (which may
+ * differ from submission order). The get_scsi_pt_* functions can then be
+ * used on each of those objects, just as after do_scsi_pt(). If wait_ms is
+ * 0 only completions already available are reaped; if negative it waits
+ * until at least one completion is available; otherwise it waits at most
+ * wait_ms milliseconds for the first completion. Returns the number of
+ * objects reaped (0 to max_num) or a negated errno. */
+int receive_scsi_pt(int fd, struct sg_pt_base ** objpp, int max_num,
+                    int wait_ms, int verbose);
+
+/* Returns the number of submitted commands on 'fd' that have completed and
+ * are waiting to be reaped by receive_scsi_pt(). If that number cannot be
+ * determined then 1 is returned if at least one is waiting, else 0. A
+ * negated errno is returned if there is a problem. */
+int poll_scsi_pt(int fd, int verbose);
+
+/* Registers num data buffers (bufpp[k] of buf_lens[k] bytes) with the
+ * asynchronous queue on 'fd' so that the OS can skip mapping them on each
+ * submit_scsi_pt() whose data-in or data-out buffer lies within one of
+ * them. Replaces buffers registered earlier; num of 0 removes them. Must
+ * not be called while commands are in flight on 'fd'. Only useful for the
+ * Linux io_uring backend (i.e. block devices, NVMe char devices and NVMe
+ * generic devices); returns SCSI_PT_DO_NOT_SUPPORTED otherwise. Returns 0
+ * on success or a negated errno. */
+int register_pt_async_buffers(int fd, uint8_t * const * bufpp,
+                              const uint32_t * buf_lens, int num,
+                              int verbose);
+
+/* A multiple request (mrq) object holds a batch of sg_pt_base objects,
+ * each set up as if for do_scsi_pt(), that are to be sent to the same
+ * device. Where the OS allows (e.g. Linux sg driver 4.0.30 and later) the
+ * whole batch is sent with one system call, otherwise each command is sent
+ * in turn with do_scsi_pt(). Either way, after do_pt_mrq() each object in
+ * the batch can be examined with the get_scsi_pt_* functions. The mrq
+ * object does not own the sg_pt_base objects added to it. */
+struct sg_pt_mrq;
+
+/* Creates a mrq object for up to max_num commands to dev_fd. Returns NULL
+ * if problem (e.g. out of memory). */
+struct sg_pt_mrq * construct_pt_mrq_obj(int dev_fd, int max_num,
+                                        int verbose);
+
+/* Appends objp to the batch. Returns its index (origin 0) within the batch
+ * or -1 if the batch is full or objp is NULL. */
+int add_pt_mrq_elem(struct sg_pt_mrq * mrqp, struct sg_pt_base * objp);
+
+/* Returns number of objects in the batch */
+int get_pt_mrq_num(const struct sg_pt_mrq * mrqp);
+
+/* Returns the object at 'index' in the batch, or NULL if index is out of
+ * range. */
+struct sg_pt_base * get_pt_mrq_elem(const struct sg_pt_mrq * mrqp,
+                                    int index);
+
+/* Sends every command in the batch and waits for them all to complete.
+ * Returns 0 if the batch was processed, a negated errno if the OS rejected
+ * it or a positive SCSI_PT_DO_* value. Commands that the OS did not get to
+ * (e.g. after an error) have their OS error set to ECANCELED, so
+ * get_scsi_pt_result_category() yields SCSI_PT_RESULT_OS_ERR for them.
+ * When each command is sent in turn with do_scsi_pt() all are attempted
+ * and the first non-zero result from do_scsi_pt() is returned. */
+int do_pt_mrq(struct sg_pt_mrq * mrqp, int timeout_secs, int verbose);
+
+/* Empties the batch so it may be filled again. The objects that were in
+ * the batch are not altered. */
+void clear_pt_mrq_obj(struct sg_pt_mrq * mrqp);
+
+/* Frees the mrq object but not the sg_pt_base objects added to it. */
+void destruct_pt_mrq_obj(struct sg_pt_mrq * mrqp);
+
 #define SCSI_PT_RESULT_GOOD 0
 #define SCSI_PT_RESULT_STATUS 1 /* other than GOOD and CHECK CONDITION */
 #define SCSI_PT_RESULT_SENSE 2
@@ -245,6 +369,77 @@ uint32_t get_pt_nvme_nsid(const struct sg_pt_base * objp);
  * scsi_pt_close_device() ).  */
 void destruct_scsi_pt_obj(struct sg_pt_base * objp);
 
+
+/* Per opcode latency histograms. When active, the time taken by each
+ * command sent by do_scsi_pt() is added to a histogram kept for its
+ * opcode. SCSI commands (including those translated to NVMe), NVMe
+ * Admin commands and NVMe I/O (NVM command set) commands have separate
+ * opcode spaces. The histograms are log linear with 32 buckets per power
+ * of 2 so percentiles are within about 3 percent. Collection is off
+ * unless sg_pt_lat_hist_enable(true) is called or the SG_PT_LAT_HIST_EV
+ * environment variable is set. If that environment variable is set then
+ * p50, p99, p99.9 and maximum latencies for each opcode seen are written
+ * at process exit to the file named by its value, or to stderr if its
+ * value is empty or "-". */
+#define SG_PT_LAT_HIST_EV "SG3_UTILS_LAT_HIST"
+
+#define SG_PT_LAT_SCSI 0                /* opcode spaces */
+#define SG_PT_LAT_NVME_ADMIN 1
+#define SG_PT_LAT_NVME_IO 2
+
+struct sg_pt_lat_stats {
+    int op_space;               /* one of the SG_PT_LAT_* opcode spaces */
+    int opcode;                 /* SCSI cdb[0] or NVMe opcode */
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+};
+
+/* Turns collection on or off. Returns the previous state. */
+bool sg_pt_lat_hist_enable(bool enable);
+
+/* Returns true if collection is on. The first call checks the
+ * SG_PT_LAT_HIST_EV environment variable. */
+bool sg_pt_lat_hist_active(void);
+
+/* Places summaries of up to max_num histograms, one for each opcode that
+ * has been seen, into arr (which may be NULL if max_num is 0). Entries are
+ * in opcode order, SCSI first. If reset is true each histogram is cleared
+ * as it is read, without losing concurrently added samples. Returns the
+ * number of opcodes seen which may exceed max_num. */
+int sg_pt_lat_hist_snapshot(struct sg_pt_lat_stats * arr, int max_num,
+                            bool reset);
+
+/* Clears all histograms */
+void sg_pt_lat_hist_reset(void);
+
+/* Saves the bucket counts of all histograms so that
+ * sg_pt_lat_hist_since() can later summarize just the samples added
+ * after this call, without clearing anything (e.g. the report at exit
+ * asked for by SG_PT_LAT_HIST_EV). Returns NULL if out of memory. Free
+ * the mark with sg_pt_lat_hist_mark_free(). */
+struct sg_pt_lat_mark;
+struct sg_pt_lat_mark * sg_pt_lat_hist_mark(void);
+
+/* Like sg_pt_lat_hist_snapshot() without reset but only counts samples
+ * added since markp was taken (all samples if markp is NULL). The max_ns
+ * field is an estimate: the largest bucket used, but no more than the
+ * overall maximum. */
+int sg_pt_lat_hist_since(const struct sg_pt_lat_mark * markp,
+                         struct sg_pt_lat_stats * arr, int max_num);
+
+void sg_pt_lat_hist_mark_free(struct sg_pt_lat_mark * markp);
+
+/* Adds a sample of lat_ns nanoseconds for opcode in op_space. Used by the
+ * OS specific pass-through code, and by applications (e.g. sgp_dd) that
+ * send some commands without do_scsi_pt(). Lock free. */
+void sg_pt_lat_hist_add(int op_space, int opcode, uint64_t lat_ns);
+
+extern int sg_pt_lat_hist_state;        /* < 0: not checked yet, 0: off */
+
 #ifdef SG_LIB_WIN32
 #define SG_LIB_WIN32_DIRECT 1
 
@@ -112,16 +112,40 @@ struct sg_io_v4 {
 #endif
 
 
+/* What the SNTL needs to know about a namespace (and its controller) to
+ * translate media access commands. Fetched with NVMe Identify commands
+ * when first needed and kept across clear_scsi_pt_obj(). */
+struct sg_nvme_geom {
+    bool nvm_lims;      /* true when dmrl, dmrsl and wzsl have been fetched */
+    bool zns_known;     /* true when zns (and zsze) have been determined */
+    bool zns;           /* namespace uses the Zoned Namespace command set */
+    uint8_t lbads;      /* log2(LB size) of namespace, 0: not known (yet) */
+    uint8_t lbaf;       /* index of LBA format in use (FLBAS) */
+    uint8_t mdts;       /* MDTS (Identify controller), 0: no limit */
+    uint8_t dlfeat;     /* DLFEAT (Identify namespace, byte 33) */
+    uint8_t dmrl;       /* Dataset Management ranges limit, 0: 256 */
+    uint8_t wzsl;       /* Write Zeroes size limit, 0: none */
+    uint16_t oncs;      /* ONCS (Identify controller), optional commands */
+    uint32_t dmrsl;     /* Dataset Management range size limit, 0: none */
+    uint64_t nsze;      /* namespace size in LBs (NSZE) */
+    uint64_t zsze;      /* zone size in LBs (ZNS Identify namespace) */
+};
+
+struct sg_nvme_id_ent;          /* see sg_pt_linux_nvme.c */
+
 struct sg_pt_linux_scsi {
     struct sg_io_v4 io_hdr;     /* use v4 header as it is more general */
     /* Leave io_hdr in first place of this structure */
     bool is_sg;
     bool is_bsg;
     bool is_nvme;       /* OS device type, if false ignore nvme_direct */
+    bool is_emul;       /* emulated device, see sg_pt_linux_emul.c */
     bool nvme_direct;   /* false: our SNTL; true: received NVMe command */
     bool nvme_stat_dnr; /* Do No Retry, part of completion status field */
     bool nvme_stat_more; /* More, part of completion status field */
     bool mdxfer_out;    /* direction of metadata xfer, true->data-out */
+    bool polled;        /* SCSI_PT_FLAGS_POLLED given */
+    uint16_t spin_us;   /* polled: spin budget, SCSI_PT_SPIN_FOREVER */
     int dev_fd;                 /* -1 if not given (yet) */
     int in_err;
     int os_err;
@@ -136,10 +160,12 @@ struct sg_pt_linux_scsi {
                                  * The whole 16 byte completion q entry is
                                  * sent back as sense data */
     uint32_t mdxfer_len;
+    struct sg_nvme_geom nvme_geom;      /* SNTL media access, cached */
     struct sg_sntl_dev_state_t dev_stat;
     void * mdxferp;
     uint8_t * nvme_id_ctlp;     /* cached response to controller IDENTIFY */
-    uint8_t * free_nvme_id_ctlp;
+    struct sg_nvme_id_ent * nvme_id_ctl_ent;    /* holds nvme_id_ctlp */
+    struct sg_nvme_id_ent * nvme_id_ns_ent;     /* IDENTIFY of nvme_nsid */
     uint8_t tmf_request[4];
 };
 
@@ -175,11 +201,53 @@ struct sg_pt_base {
 extern bool sg_bsg_nvme_char_major_checked;
 extern int sg_bsg_major;
 extern volatile int sg_nvme_char_major;
+extern volatile int sg_nvme_generic_major;
 extern long sg_lin_page_size;
 
 void sg_find_bsg_nvme_char_major(int verbose);
 int sg_do_nvme_pt(struct sg_pt_base * vp, int fd, int time_secs, int vb);
 int sg_linux_get_sg_version(const struct sg_pt_base * vp);
+int sg_nvme_pt_completion(struct sg_pt_linux_scsi * ptp, int res,
+                          uint32_t result, bool sntl, int vb);
+/* NVMe Identify responses are cached process wide and shared by all pt
+ * objects on the same device; this drops those held by ptp. */
+void sg_nvme_id_release(struct sg_pt_linux_scsi * ptp);
+
+/* io_uring backend for the asynchronous pass-through functions used by
+ * devices other than sg and bsg. See sg_pt_linux_uring.c . */
+int sg_uring_submit(struct sg_pt_base * vp, int time_secs, int vb);
+int sg_uring_receive(int fd, struct sg_pt_base ** vpp, int max_num,
+                     int wait_ms, int vb);
+int sg_uring_poll(int fd, int vb);
+int sg_uring_register_bufs(int fd, bool is_nvme, uint32_t nsid,
+                           uint8_t * const * bufpp, const uint32_t * buf_lens,
+                           int num, int vb);
+void sg_uring_release(int fd);
+
+/* User space emulated devices backed by regular files, selected by a
+ * device name starting with SG_EMUL_PREFIX or by setting the SG_EMUL_EV
+ * environment variable. See sg_pt_linux_emul.c . */
+#define SG_EMUL_PREFIX "emul:"
+#define SG_EMUL_EV "SG3_UTILS_EMUL"
+
+int sg_emul_open(const char * name_opts, int flags, int vb);
+int sg_emul_attach(int fd, const char * path, const char * opts, int vb);
+void sg_emul_release(int fd);
+bool sg_emul_dev_type(int fd, bool * is_nvme_p);
+int sg_emul_do_pt(struct sg_pt_base * vp, int time_secs, int vb);
+int sg_emul_nvme_cmd(int fd, struct sg_nvme_passthru_cmd * cmdp, bool admin,
+                     int vb);
+int sg_emul_submit(struct sg_pt_base * vp, int time_secs, int vb);
+int sg_emul_receive(int fd, struct sg_pt_base ** vpp, int max_num,
+                    int wait_ms, int vb);
+int sg_emul_poll(int fd, int vb);
+
+/* Command trace capture, see sg_pt_linux_trace.c . The public part of the
+ * interface (and the record format) is in sg_io_linux.h . */
+extern int sg_pt_trace_state;   /* < 0: not checked yet, 0: off, > 0: on */
+
+void sg_pt_trace_record(const struct sg_pt_base * vp, uint64_t start_ns,
+                        int res);
 
 /* This trims given NVMe block device name in Linux (e.g. /dev/nvme0n1p5)
  * to the name of its associated char device (e.g. /dev/nvme0). If this
@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_buf_pool version 1.00 20261017 */
+
+/* This file contains a pool of equally sized, page aligned, data buffers
+ * as used by the dd family of utilities (see sg_buf_pool_create() in
+ * sg_lib.h). Buffers are carved, in order, from arenas. Each arena is a
+ * single mapping so that, when it is backed by huge pages, a run of
+ * buffers shares a few TLB entries. A buffer that is given back has the
+ * link of its free list written into its first bytes, so the free lists
+ * need no memory of their own.
+ *
+ * The aim is that threads (e.g. of sgp_dd) do not contend on the pool.
+ * Each thread keeps up to SG_BP_TL_MAX free buffers per pool, without
+ * atomics. Beyond that they go onto the free list of the caller's NUMA
+ * node. That list is a LIFO where a push is a compare-and-swap of its
+ * head while a pop takes the whole list with an exchange (and pushes
+ * back what exceeds SG_BP_TL_MAX); as nothing is ever removed from the
+ * middle of the list, the ABA problem of lock-free stacks does not
+ * arise. Arenas are carved with an atomic increment.
+ */
+
+#define _GNU_SOURCE 1           /* for MAP_ANONYMOUS, MAP_HUGETLB */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef SG_LIB_LINUX
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "sg_lib.h"
+#include "sg_pr2serr.h"
+
+#define SG_BP_MAX_NODES 64      /* NUMA nodes beyond this share arenas */
+#define SG_BP_TL_SLOTS 4        /* pools with a per thread free list */
+#define SG_BP_TL_MAX 8          /* buffers on a per thread free list */
+
+struct sg_bp_arena {
+    struct sg_bp_arena * next;  /* list of all arenas of a pool */
+    uint8_t * base;
+    uint8_t * free_p;           /* non-NULL: from sg_memalign() */
+    size_t len;
+    bool huge;
+    uint32_t num_bufs;
+    uint32_t carved;            /* buffers handed out, may overshoot */
+};
+
+struct sg_bp_node {
+    uint8_t * free_head;        /* lock-free LIFO of given back buffers */
+    struct sg_bp_arena * cur;   /* arena being carved */
+};
+
+struct sg_buf_pool {
+    bool want_huge;
+    bool numa;
+    int vb;
+    int num_huge;               /* arenas backed by huge pages */
+    uint32_t buf_sz;
+    uint64_t id;                /* tells pools apart in per thread lists */
+    size_t arena_len;
+    struct sg_bp_arena * all;
+    struct sg_bp_node node_arr[SG_BP_MAX_NODES];
+};
+
+struct sg_bp_tl {               /* a thread's free list for one pool */
+    uint64_t pool_id;           /* 0 -> unused */
+    uint8_t * head;
+    int num;
+};
+
+static uint64_t sg_bp_next_id = 1;
+static __thread struct sg_bp_tl sg_bp_tl_arr[SG_BP_TL_SLOTS];
+
+
+#define BP_NEXT(bp) (*(uint8_t **)(bp))
+
+/* Returns the NUMA node of the CPU this thread is running on, or 0 */
+static int
+bp_node(const struct sg_buf_pool * bpp)
+{
+#if defined(SG_LIB_LINUX) && defined(SYS_getcpu)
+    unsigned int cpu, node;
+
+    if (bpp->numa && (0 == syscall(SYS_getcpu, &cpu, &node, NULL)))
+        return (int)(node % SG_BP_MAX_NODES);
+#else
+    if (bpp) { ; }              /* suppress warning */
+#endif
+    return 0;
+}
+
+/* Returns this thread's free list for bpp. If there is none and claim is
+ * true, an empty slot is taken over. Returns NULL if not found. */
+static struct sg_bp_tl *
+bp_tl_find(const struct sg_buf_pool * bpp, bool claim)
+{
+    int k;
+    struct sg_bp_tl * tlp;
+
+    for (k = 0, tlp = sg_bp_tl_arr; k < SG_BP_TL_SLOTS; ++k, ++tlp) {
+        if (bpp->id == tlp->pool_id)
+            return tlp;
+    }
+    if (! claim)
+        return NULL;
+    /* a slot of a pool that has been destroyed looks in use until this
+     * thread empties it, so only slots without buffers are taken */
+    for (k = 0, tlp = sg_bp_tl_arr; k < SG_BP_TL_SLOTS; ++k, ++tlp) {
+        if (NULL == tlp->head) {
+            tlp->pool_id = bpp->id;
+            tlp->num = 0;
+            return tlp;
+        }
+    }
+    return NULL;
+}
+
+/* Pushes the list first to last onto a node's free list */
+static void
+bp_node_push(struct sg_bp_node * np, uint8_t * first, uint8_t * last)
+{
+    uint8_t * head = __atomic_load_n(&np->free_head, __ATOMIC_RELAXED);
+
+    do {
+        BP_NEXT(last) = head;
+    } while (! __atomic_compare_exchange_n(&np->free_head, &head, first,
+                                           true, __ATOMIC_RELEASE,
+                                           __ATOMIC_RELAXED));
+}
+
+/* Maps ap->len bytes for an arena. Sets ap->huge if backed by huge
+ * pages. Returns NULL on failure. */
+static uint8_t *
+bp_map(struct sg_buf_pool * bpp, struct sg_bp_arena * ap)
+{
+#ifdef SG_LIB_LINUX
+    size_t excess;
+    uint8_t * p;
+    uint8_t * a_p;
+    const size_t hsz = SG_BUF_POOL_HUGE_SZ;
+
+    if (bpp->want_huge) {
+#ifdef MAP_HUGETLB
+        p = (uint8_t *)mmap(NULL, ap->len, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1,
+                            0);
+        if (MAP_FAILED != (void *)p) {
+            ap->huge = true;
+            return p;
+        }
+        if (bpp->vb > 1)
+            pr2ws("%s: no hugetlbfs pages (%s), try transparent huge "
+                  "pages\n", __func__, safe_strerror(errno));
+#endif
+        /* over map so the arena can start on a huge page boundary */
+        p = (uint8_t *)mmap(NULL, ap->len + hsz, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == (void *)p)
+            return NULL;
+        a_p = (uint8_t *)(((sg_uintptr_t)p + hsz - 1) & ~(hsz - 1));
+        if (a_p > p)
+            munmap(p, a_p - p);
+        excess = hsz - (a_p - p);
+        if (excess > 0)
+            munmap(a_p + ap->len, excess);
+#ifdef MADV_HUGEPAGE
+        if (0 == madvise(a_p, ap->len, MADV_HUGEPAGE))
+            ap->huge = true;
+        else if (bpp->vb > 1)
+            pr2ws("%s: madvise(MADV_HUGEPAGE): %s\n", __func__,
+                  safe_strerror(errno));
+#endif
+        return a_p;
+    }
+    p = (uint8_t *)mmap(NULL, ap->len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (MAP_FAILED == (void *)p) ? NULL : p;
+#else
+    if (ap->len > UINT32_MAX)
+        return NULL;
+    return sg_memalign((uint32_t)ap->len, 0, &ap->free_p, bpp->vb > 3);
+#endif
+}
+
+static void
+bp_arena_free(struct sg_bp_arena * ap)
+{
+    if (ap->free_p)
+        free(ap->free_p);
+#ifdef SG_LIB_LINUX
+    else if (ap->base)
+        munmap(ap->base, ap->len);
+#endif
+    free(ap);
+}
+
+static struct sg_bp_arena *
+bp_arena_new(struct sg_buf_pool * bpp)
+{
+    size_t k;
+    uint32_t pg_sz = sg_get_page_size();
+    struct sg_bp_arena * ap;
+
+    ap = (struct sg_bp_arena *)calloc(1, sizeof(*ap));
+    if (NULL == ap)
+        return NULL;
+    ap->len = bpp->arena_len;
+    ap->num_bufs = bpp->arena_len / bpp->buf_sz;
+    ap->base = bp_map(bpp, ap);
+    if (NULL == ap->base) {
+        if (bpp->vb)
+            pr2ws("%s: unable to map %zu bytes: %s\n", __func__, ap->len,
+                  safe_strerror(errno));
+        free(ap);
+        return NULL;
+    }
+    /* first touch places the pages on this thread's node */
+    if (bpp->numa) {
+        for (k = 0; k < ap->len; k += pg_sz)
+            ap->base[k] = 0;
+    }
+    if (bpp->vb > 2)
+        pr2ws("%s: %zu bytes holding %u buffers%s\n", __func__, ap->len,
+              ap->num_bufs, ap->huge ? ", huge pages" : "");
+    return ap;
+}
+
+struct sg_buf_pool *
+sg_buf_pool_create(uint32_t buf_sz, int num_hint, int flags, int vb)
+{
+    uint32_t pg_sz = sg_get_page_size();
+    uint64_t total;
+    const uint64_t hsz = SG_BUF_POOL_HUGE_SZ;
+    struct sg_buf_pool * bpp;
+
+    if (0 == buf_sz)
+        buf_sz = pg_sz;
+    buf_sz = ((buf_sz + pg_sz - 1) / pg_sz) * pg_sz;
+    if (num_hint < 1)
+        num_hint = 1;
+    bpp = (struct sg_buf_pool *)calloc(1, sizeof(*bpp));
+    if (NULL == bpp)
+        return NULL;
+    bpp->buf_sz = buf_sz;
+    bpp->vb = vb;
+    bpp->numa = !! (SG_BUF_POOL_NUMA & flags);
+    bpp->id = __atomic_fetch_add(&sg_bp_next_id, 1, __ATOMIC_RELAXED);
+    total = (uint64_t)buf_sz * num_hint;
+    if ((SG_BUF_POOL_HUGE & flags) && (total >= (hsz / 2))) {
+        bpp->want_huge = true;
+        /* an arena holds at least one buffer, else up to a huge page */
+        total = (buf_sz > hsz) ? buf_sz : hsz;
+        bpp->arena_len = ((total + hsz - 1) / hsz) * hsz;
+    } else
+        bpp->arena_len = buf_sz;
+    if (vb > 1)
+        pr2ws("%s: buf_sz=%u, arena_len=%zu, huge=%d, numa=%d\n", __func__,
+              buf_sz, bpp->arena_len, (int)bpp->want_huge, (int)bpp->numa);
+    return bpp;
+}
+
+uint8_t *
+sg_buf_pool_get(struct sg_buf_pool * bpp)
+{
+    uint32_t k;
+    uint8_t * bp;
+    uint8_t * rest;
+    uint8_t * last;
+    struct sg_bp_tl * tlp;
+    struct sg_bp_node * np;
+    struct sg_bp_arena * ap;
+    struct sg_bp_arena * nap;
+
+    if (NULL == bpp)
+        return NULL;
+    tlp = bp_tl_find(bpp, false);
+    if (tlp && tlp->head) {
+        bp = tlp->head;
+        tlp->head = BP_NEXT(bp);
+        --tlp->num;
+        return bp;
+    }
+    np = bpp->node_arr + bp_node(bpp);
+    bp = __atomic_exchange_n(&np->free_head, NULL, __ATOMIC_ACQUIRE);
+    if (bp) {
+        rest = BP_NEXT(bp);
+        if (NULL == rest)
+            return bp;
+        tlp = bp_tl_find(bpp, true);
+        if (tlp) {
+            /* keep at most SG_BP_TL_MAX, other threads may want the rest */
+            tlp->head = rest;
+            for (tlp->num = 1; (tlp->num < SG_BP_TL_MAX) && BP_NEXT(rest);
+                 rest = BP_NEXT(rest))
+                ++tlp->num;
+            last = rest;
+            rest = BP_NEXT(last);
+            BP_NEXT(last) = NULL;
+            if (NULL == rest)
+                return bp;
+        }
+        for (last = rest; BP_NEXT(last); last = BP_NEXT(last))
+            ;
+        bp_node_push(np, rest, last);
+        return bp;
+    }
+    ap = __atomic_load_n(&np->cur, __ATOMIC_ACQUIRE);
+    while (true) {
+        if (ap) {
+            k = __atomic_fetch_add(&ap->carved, 1, __ATOMIC_RELAXED);
+            if (k < ap->num_bufs)
+                return ap->base + ((size_t)k * bpp->buf_sz);
+        }
+        nap = bp_arena_new(bpp);
+        if (NULL == nap)
+            return NULL;
+        if (__atomic_compare_exchange_n(&np->cur, &ap, nap, false,
+                                        __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE)) {
+            nap->next = __atomic_load_n(&bpp->all, __ATOMIC_RELAXED);
+            while (! __atomic_compare_exchange_n(&bpp->all, &nap->next, nap,
+                                                 true, __ATOMIC_RELEASE,
+                                                 __ATOMIC_RELAXED))
+                ;
+            if (nap->huge)
+                __atomic_fetch_add(&bpp->num_huge, 1, __ATOMIC_RELAXED);
+            ap = nap;
+        } else
+            bp_arena_free(nap); /* another thread got there first */
+    }
+}
+
+void
+sg_buf_pool_put(struct sg_buf_pool * bpp, uint8_t * bp)
+{
+    struct sg_bp_tl * tlp;
+
+    if ((NULL == bpp) || (NULL == bp))
+        return;
+    tlp = bp_tl_find(bpp, true);
+    if (tlp && (tlp->num < SG_BP_TL_MAX)) {
+        BP_NEXT(bp) = tlp->head;
+        tlp->head = bp;
+        ++tlp->num;
+        return;
+    }
+    bp_node_push(bpp->node_arr + bp_node(bpp), bp, bp);
+}
+
+bool
+sg_buf_pool_is_huge(const struct sg_buf_pool * bpp)
+{
+    return bpp && (__atomic_load_n(&bpp->num_huge, __ATOMIC_RELAXED) > 0);
+}
+
+void
+sg_buf_pool_destroy(struct sg_buf_pool * bpp)
+{
+    struct sg_bp_tl * tlp;
+    struct sg_bp_arena * ap;
+    struct sg_bp_arena * nap;
+
+    if (NULL == bpp)
+        return;
+    tlp = bp_tl_find(bpp, false);
+    if (tlp) {
+        tlp->pool_id = 0;
+        tlp->head = NULL;
+        tlp->num = 0;
+    }
+    for (ap = bpp->all; ap; ap = nap) {
+        nap = ap->next;
+        bp_arena_free(ap);
+    }
+    free(bpp);
+}
@@ -23,6 +23,8 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -42,7 +44,7 @@
 #endif
 
 
-static const char * const version_str = "1.93 20190128";
+static const char * const version_str = "1.94 20261017";
 
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
@@ -70,12 +72,153 @@ sg_cmds_version()
     return version_str;
 }
 
+/* Each file descriptor opened by sg_cmds_open_device() or
+ * sg_cmds_open_flags() gets a slot in this pool which holds at most one
+ * idle pt object. sg_cmds_get_pt_obj() takes it out of the slot (or
+ * constructs one if the slot is empty) and sg_cmds_put_pt_obj() puts it
+ * back. Slots are only changed with atomic operations so concurrent
+ * users of the same file descriptor simply construct additional objects.
+ * A slot holds NULL when its file descriptor is not known to the pool.
+ * A caller may close() such a file descriptor itself and the number then
+ * be reused for another file, so what the file descriptor referred to
+ * when opened is kept and checked with fstat() before a pooled object
+ * is handed out again. */
+#if defined(__GNUC__) && (! defined(SG_CMDS_NO_PT_POOL))
+#define SG_CMDS_PT_POOL 1
+#define SG_CMDS_POOL_MAX_FD 1024
+
+static char pt_pool_empty_mark;
+#define PT_POOL_EMPTY ((struct sg_pt_base *)&pt_pool_empty_mark)
+
+static struct sg_pt_base * pt_pool[SG_CMDS_POOL_MAX_FD];
+
+struct pt_pool_id {
+    dev_t dev;
+    dev_t rdev;
+    ino_t ino;
+};
+
+/* written before, and read after, an atomic access to the same slot */
+static struct pt_pool_id pt_pool_id_arr[SG_CMDS_POOL_MAX_FD];
+
+/* Returns true if fstat(fd) succeeds, placing what fd refers to in idp */
+static bool
+pt_pool_fd_id(int fd, struct pt_pool_id * idp)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) < 0)
+        return false;
+    idp->dev = st.st_dev;
+    idp->rdev = st.st_rdev;
+    idp->ino = st.st_ino;
+    return true;
+}
+
+/* Places new_val in fd's slot, destructing the pooled object it held */
+static void
+pt_pool_reset_slot(int fd, struct sg_pt_base * new_val)
+{
+    struct sg_pt_base * ptvp;
+
+    if ((fd < 0) || (fd >= SG_CMDS_POOL_MAX_FD))
+        return;
+    ptvp = __atomic_exchange_n(pt_pool + fd, new_val, __ATOMIC_ACQ_REL);
+    if (ptvp && (PT_POOL_EMPTY != ptvp))
+        destruct_scsi_pt_obj(ptvp);
+}
+
+/* Called when fd has just been opened; fds that fstat() fails on (e.g.
+ * the pt handles of some other OSes) are not pooled. */
+static void
+pt_pool_open_slot(int fd)
+{
+    if ((fd < 0) || (fd >= SG_CMDS_POOL_MAX_FD))
+        return;
+    if (pt_pool_fd_id(fd, pt_pool_id_arr + fd))
+        pt_pool_reset_slot(fd, PT_POOL_EMPTY);
+    else
+        pt_pool_reset_slot(fd, NULL);
+}
+
+/* Returns true if fd still refers to what it did when it was opened */
+static bool
+pt_pool_same_file(int fd)
+{
+    struct pt_pool_id id;
+    const struct pt_pool_id * idp = pt_pool_id_arr + fd;
+
+    return pt_pool_fd_id(fd, &id) && (id.dev == idp->dev) &&
+           (id.rdev == idp->rdev) && (id.ino == idp->ino);
+}
+#endif
+
+/* Returns a pt object associated with sg_fd, taken from the pool if
+ * possible, else a new one. Returns NULL if out of memory. Should be
+ * given back with sg_cmds_put_pt_obj(). */
+struct sg_pt_base *
+sg_cmds_get_pt_obj(int sg_fd, int verbose)
+{
+    struct sg_pt_base * ptvp;
+
+#ifdef SG_CMDS_PT_POOL
+    if ((sg_fd >= 0) && (sg_fd < SG_CMDS_POOL_MAX_FD)) {
+        ptvp = __atomic_load_n(pt_pool + sg_fd, __ATOMIC_ACQUIRE);
+        while (ptvp && (PT_POOL_EMPTY != ptvp)) {
+            if (__atomic_compare_exchange_n(pt_pool + sg_fd, &ptvp,
+                                            PT_POOL_EMPTY, false,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE)) {
+                if (pt_pool_same_file(sg_fd)) {
+                    clear_scsi_pt_obj(ptvp);
+                    return ptvp;
+                }
+                /* closed without sg_cmds_close_device(), so the pooled
+                 * object is stale; forget this fd */
+                destruct_scsi_pt_obj(ptvp);
+                pt_pool_reset_slot(sg_fd, NULL);
+                break;
+            }
+        }
+    }
+#endif
+    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    if (NULL == ptvp)
+        pr2ws("%s: out of memory\n", __func__);
+    return ptvp;
+}
+
+/* Gives a pt object obtained from sg_cmds_get_pt_obj() back to the pool,
+ * or destructs it if its file descriptor's slot is occupied or unknown. */
+void
+sg_cmds_put_pt_obj(struct sg_pt_base * ptvp)
+{
+#ifdef SG_CMDS_PT_POOL
+    int fd;
+    struct sg_pt_base * expect = PT_POOL_EMPTY;
+
+    if (NULL == ptvp)
+        return;
+    fd = get_pt_file_handle(ptvp);
+    if ((fd >= 0) && (fd < SG_CMDS_POOL_MAX_FD) &&
+        __atomic_compare_exchange_n(pt_pool + fd, &expect, ptvp, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return;
+#endif
+    destruct_scsi_pt_obj(ptvp);
+}
+
 /* Returns file descriptor >= 0 if successful. If error in Unix returns
    negated errno. */
 int
 sg_cmds_open_device(const char * device_name, bool read_only, int verbose)
 {
-    return scsi_pt_open_device(device_name, read_only, verbose);
+    int fd = scsi_pt_open_device(device_name, read_only, verbose);
+
+#ifdef SG_CMDS_PT_POOL
+    pt_pool_open_slot(fd);
+#endif
+    return fd;
 }
 
 /* Returns file descriptor >= 0 if successful. If error in Unix returns
@@ -83,13 +226,21 @@ sg_cmds_open_device(const char * device_name, bool read_only, int verbose)
 int
 sg_cmds_open_flags(const char * device_name, int flags, int verbose)
 {
-    return scsi_pt_open_flags(device_name, flags, verbose);
+    int fd = scsi_pt_open_flags(device_name, flags, verbose);
+
+#ifdef SG_CMDS_PT_POOL
+    pt_pool_open_slot(fd);
+#endif
+    return fd;
 }
 
 /* Returns 0 if successful. If error in Unix returns negated errno. */
 int
 sg_cmds_close_device(int device_fd)
 {
+#ifdef SG_CMDS_PT_POOL
+    pt_pool_reset_slot(device_fd, NULL);
+#endif
     return scsi_pt_close_device(device_fd);
 }
 
@@ -352,15 +503,6 @@ sg_cmds_is_nvme(const struct sg_pt_base * ptvp)
     return pt_device_is_nvme(ptvp);
 }
 
-static struct sg_pt_base *
-create_pt_obj(const char * cname)
-{
-    struct sg_pt_base * ptvp = construct_scsi_pt_obj();
-    if (NULL == ptvp)
-        pr2ws("%s: out of memory\n", cname);
-    return ptvp;
-}
-
 static const char * const inquiry_s = "inquiry";
 
 
@@ -448,12 +590,12 @@ sg_ll_inquiry(int sg_fd, bool cmddt, bool evpd, int pg_op, void * resp,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_inquiry_com(ptvp, cmddt, evpd, pg_op, resp, mx_resp_len,
                             0 /* timeout_sec */, NULL, noisy, verbose);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -476,12 +618,12 @@ sg_ll_inquiry_v2(int sg_fd, bool evpd, int pg_op, void * resp,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_inquiry_com(ptvp, false, evpd, pg_op, resp, mx_resp_len,
                             timeout_secs, residp, noisy, verbose);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -641,12 +783,12 @@ sg_ll_test_unit_ready_progress(int sg_fd, int pack_id, int * progress,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_test_unit_ready_progress_pt(ptvp, pack_id, progress, noisy,
                                             verbose);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -660,12 +802,12 @@ sg_ll_test_unit_ready(int sg_fd, int pack_id, bool noisy, int verbose)
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_test_unit_ready_progress_pt(ptvp, pack_id, NULL, noisy,
                                             verbose);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -680,10 +822,9 @@ sg_ll_test_unit_ready_pt(struct sg_pt_base * ptvp, int pack_id, bool noisy,
 /* Invokes a SCSI REQUEST SENSE command. Returns 0 when successful, various
  * SG_LIB_CAT_* positive values or -1 -> other errors */
 static int
-sg_ll_request_sense_com(struct sg_pt_base * ptvp, int sg_fd, bool desc,
-                        void * resp, int mx_resp_len, bool noisy, int verbose)
+sg_ll_request_sense_com(struct sg_pt_base * ptvp, bool desc, void * resp,
+                        int mx_resp_len, bool noisy, int verbose)
 {
-    bool ptvp_given = false;
     int k, ret, res, sense_cat;
     static const char * const rq_s = "request sense";
     uint8_t rs_cdb[REQUEST_SENSE_CMDLEN] =
@@ -704,13 +845,6 @@ sg_ll_request_sense_com(struct sg_pt_base * ptvp, int sg_fd, bool desc,
         pr2ws("\n");
     }
 
-    if (ptvp)
-        ptvp_given = true;
-    else {
-        ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
-        if (NULL == ptvp)
-            return sg_convert_errno(ENOMEM);
-    }
     set_scsi_pt_cdb(ptvp, rs_cdb, sizeof(rs_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
@@ -737,8 +871,6 @@ sg_ll_request_sense_com(struct sg_pt_base * ptvp, int sg_fd, bool desc,
         } else
             ret = 0;
     }
-    if ((! ptvp_given) && ptvp)
-        destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -746,8 +878,16 @@ int
 sg_ll_request_sense(int sg_fd, bool desc, void * resp, int mx_resp_len,
                     bool noisy, int verbose)
 {
-    return sg_ll_request_sense_com(NULL, sg_fd, desc, resp, mx_resp_len,
-                                   noisy, verbose);
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_request_sense_com(ptvp, desc, resp, mx_resp_len, noisy,
+                                  verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
 }
 
 int
@@ -755,18 +895,17 @@ sg_ll_request_sense_pt(struct sg_pt_base * ptvp, bool desc, void * resp,
                        int mx_resp_len, bool noisy, int verbose)
 {
     clear_scsi_pt_obj(ptvp);
-    return sg_ll_request_sense_com(ptvp, -1, desc, resp, mx_resp_len,
-                                   noisy, verbose);
+    return sg_ll_request_sense_com(ptvp, desc, resp, mx_resp_len, noisy,
+                                   verbose);
 }
 
 /* Invokes a SCSI REPORT LUNS command. Return of 0 -> success,
  * various SG_LIB_CAT_* positive values or -1 -> other errors */
 static int
-sg_ll_report_luns_com(struct sg_pt_base * ptvp, int sg_fd, int select_report,
+sg_ll_report_luns_com(struct sg_pt_base * ptvp, int select_report,
                       void * resp, int mx_resp_len, bool noisy, int verbose)
 {
     static const char * const report_luns_s = "report luns";
-    bool ptvp_given = false;
     int k, ret, res, sense_cat;
     uint8_t rl_cdb[REPORT_LUNS_CMDLEN] =
                          {REPORT_LUNS_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
@@ -781,14 +920,10 @@ sg_ll_report_luns_com(struct sg_pt_base * ptvp, int sg_fd, int select_report,
         pr2ws("\n");
     }
 
-    if (ptvp)
-        ptvp_given = true;
-    else if (NULL == ((ptvp = create_pt_obj(report_luns_s))))
-        return sg_convert_errno(ENOMEM);
     set_scsi_pt_cdb(ptvp, rl_cdb, sizeof(rl_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, report_luns_s, res, noisy, verbose,
                                &sense_cat);
     if (-1 == ret)
@@ -805,8 +940,6 @@ sg_ll_report_luns_com(struct sg_pt_base * ptvp, int sg_fd, int select_report,
         }
     } else
         ret = 0;
-    if ((! ptvp_given) && ptvp)
-        destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -817,8 +950,16 @@ int
 sg_ll_report_luns(int sg_fd, int select_report, void * resp, int mx_resp_len,
                   bool noisy, int verbose)
 {
-    return sg_ll_report_luns_com(NULL, sg_fd, select_report, resp,
-                                 mx_resp_len, noisy, verbose);
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_report_luns_com(ptvp, select_report, resp, mx_resp_len,
+                                noisy, verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
 }
 
 
@@ -830,6 +971,6 @@ sg_ll_report_luns_pt(struct sg_pt_base * ptvp, int select_report,
                      void * resp, int mx_resp_len, bool noisy, int verbose)
 {
     clear_scsi_pt_obj(ptvp);
-    return sg_ll_report_luns_com(ptvp, -1, select_report, resp,
-                                 mx_resp_len, noisy, verbose);
+    return sg_ll_report_luns_com(ptvp, select_report, resp, mx_resp_len,
+                                 noisy, verbose);
 }
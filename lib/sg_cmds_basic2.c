@@ -73,28 +73,35 @@
 #define INQUIRY_RESP_INITIAL_LEN 36
 
 
-static struct sg_pt_base *
-create_pt_obj(const char * cname)
-{
-    struct sg_pt_base * ptvp = construct_scsi_pt_obj();
-    if (NULL == ptvp)
-        pr2ws("%s: out of memory\n", cname);
-    return ptvp;
-}
-
 /* Invokes a SCSI SYNCHRONIZE CACHE (10) command. Return of 0 -> success,
  * various SG_LIB_CAT_* positive values or -1 -> other errors */
 int
 sg_ll_sync_cache_10(int sg_fd, bool sync_nv, bool immed, int group,
                     unsigned int lba, unsigned int count, bool noisy,
                     int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_sync_cache_10_pt(ptvp, sync_nv, immed, group, lba, count,
+                                 noisy, verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_sync_cache_10_pt(struct sg_pt_base * ptvp, bool sync_nv, bool immed,
+                       int group, unsigned int lba, unsigned int count,
+                       bool noisy, int verbose)
 {
     static const char * const cdb_s = "synchronize cache(10)";
     int res, ret, k, sense_cat;
     uint8_t sc_cdb[SYNCHRONIZE_CACHE_CMDLEN] =
                 {SYNCHRONIZE_CACHE_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (sync_nv)
         sc_cdb[1] |= 4;
@@ -114,11 +121,10 @@ sg_ll_sync_cache_10(int sg_fd, bool sync_nv, bool immed, int group,
             pr2ws("%02x ", sc_cdb[k]);
         pr2ws("\n");
     }
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, sc_cdb, sizeof(sc_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -134,8 +140,6 @@ sg_ll_sync_cache_10(int sg_fd, bool sync_nv, bool immed, int group,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -144,6 +148,22 @@ sg_ll_sync_cache_10(int sg_fd, bool sync_nv, bool immed, int group,
 int
 sg_ll_readcap_16(int sg_fd, bool pmi, uint64_t llba, void * resp,
                  int mx_resp_len, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_readcap_16_pt(ptvp, pmi, llba, resp, mx_resp_len, noisy,
+                              verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_readcap_16_pt(struct sg_pt_base * ptvp, bool pmi, uint64_t llba,
+                    void * resp, int mx_resp_len, bool noisy, int verbose)
 {
     static const char * const cdb_s = "read capacity(16)";
     int k, ret, res, sense_cat;
@@ -151,7 +171,6 @@ sg_ll_readcap_16(int sg_fd, bool pmi, uint64_t llba, void * resp,
                         {SERVICE_ACTION_IN_16_CMD, READ_CAPACITY_16_SA,
                          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (pmi) { /* lbs only valid when pmi set */
         rc_cdb[14] |= 1;
@@ -165,12 +184,11 @@ sg_ll_readcap_16(int sg_fd, bool pmi, uint64_t llba, void * resp,
             pr2ws("%02x ", rc_cdb[k]);
         pr2ws("\n");
     }
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, rc_cdb, sizeof(rc_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -186,8 +204,6 @@ sg_ll_readcap_16(int sg_fd, bool pmi, uint64_t llba, void * resp,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -196,13 +212,28 @@ sg_ll_readcap_16(int sg_fd, bool pmi, uint64_t llba, void * resp,
 int
 sg_ll_readcap_10(int sg_fd, bool pmi, unsigned int lba, void * resp,
                  int mx_resp_len, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_readcap_10_pt(ptvp, pmi, lba, resp, mx_resp_len, noisy,
+                              verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_readcap_10_pt(struct sg_pt_base * ptvp, bool pmi, unsigned int lba,
+                    void * resp, int mx_resp_len, bool noisy, int verbose)
 {
     static const char * const cdb_s = "read capacity(10)";
     int k, ret, res, sense_cat;
     uint8_t rc_cdb[READ_CAPACITY_10_CMDLEN] =
                          {READ_CAPACITY_10_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (pmi) { /* lbs only valid when pmi set */
         rc_cdb[8] |= 1;
@@ -214,12 +245,11 @@ sg_ll_readcap_10(int sg_fd, bool pmi, unsigned int lba, void * resp,
             pr2ws("%02x ", rc_cdb[k]);
         pr2ws("\n");
     }
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, rc_cdb, sizeof(rc_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -235,8 +265,6 @@ sg_ll_readcap_10(int sg_fd, bool pmi, unsigned int lba, void * resp,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -245,13 +273,29 @@ sg_ll_readcap_10(int sg_fd, bool pmi, unsigned int lba, void * resp,
 int
 sg_ll_mode_sense6(int sg_fd, bool dbd, int pc, int pg_code, int sub_pg_code,
                   void * resp, int mx_resp_len, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_mode_sense6_pt(ptvp, dbd, pc, pg_code, sub_pg_code, resp,
+                               mx_resp_len, noisy, verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_mode_sense6_pt(struct sg_pt_base * ptvp, bool dbd, int pc, int pg_code,
+                     int sub_pg_code, void * resp, int mx_resp_len, bool noisy,
+                     int verbose)
 {
     static const char * const cdb_s = "mode sense(6)";
     int res, ret, k, sense_cat, resid;
     uint8_t modes_cdb[MODE_SENSE6_CMDLEN] =
         {MODE_SENSE6_CMD, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     modes_cdb[1] = (uint8_t)(dbd ? 0x8 : 0);
     modes_cdb[2] = (uint8_t)(((pc << 6) & 0xc0) | (pg_code & 0x3f));
@@ -267,12 +311,11 @@ sg_ll_mode_sense6(int sg_fd, bool dbd, int pc, int pg_code, int sub_pg_code,
             pr2ws("%02x ", modes_cdb[k]);
         pr2ws("\n");
     }
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, modes_cdb, sizeof(modes_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     resid = get_scsi_pt_resid(ptvp);
     if (-1 == ret)
@@ -301,7 +344,6 @@ sg_ll_mode_sense6(int sg_fd, bool dbd, int pc, int pg_code, int sub_pg_code,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
 
     if (resid > 0) {
         if (resid > mx_resp_len) {
@@ -339,10 +381,28 @@ int
 sg_ll_mode_sense10_v2(int sg_fd, bool llbaa, bool dbd, int pc, int pg_code,
                       int sub_pg_code, void * resp, int mx_resp_len,
                       int timeout_secs, int * residp, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_mode_sense10_pt(ptvp, llbaa, dbd, pc, pg_code, sub_pg_code,
+                                resp, mx_resp_len, timeout_secs, residp, noisy,
+                                verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_mode_sense10_pt(struct sg_pt_base * ptvp, bool llbaa, bool dbd, int pc,
+                      int pg_code, int sub_pg_code, void * resp,
+                      int mx_resp_len, int timeout_secs, int * residp,
+                      bool noisy, int verbose)
 {
     int res, ret, k, sense_cat, resid;
     static const char * const cdb_s = "mode sense(10)";
-    struct sg_pt_base * ptvp;
     uint8_t modes_cdb[MODE_SENSE10_CMDLEN] =
         {MODE_SENSE10_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
@@ -364,12 +424,11 @@ sg_ll_mode_sense10_v2(int sg_fd, bool llbaa, bool dbd, int pc, int pg_code,
     if (timeout_secs <= 0)
         timeout_secs = DEF_PT_TIMEOUT;
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        goto gen_err;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, modes_cdb, sizeof(modes_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, timeout_secs, verbose);
+    res = do_scsi_pt(ptvp, -1, timeout_secs, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     resid = get_scsi_pt_resid(ptvp);
     if (residp)
@@ -400,7 +459,6 @@ sg_ll_mode_sense10_v2(int sg_fd, bool llbaa, bool dbd, int pc, int pg_code,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
 
     if (resid > 0) {
         if (resid > mx_resp_len) {
@@ -423,13 +481,28 @@ gen_err:
 int
 sg_ll_mode_select6_v2(int sg_fd, bool pf, bool rtd, bool sp, void * paramp,
                       int param_len, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_mode_select6_pt(ptvp, pf, rtd, sp, paramp, param_len, noisy,
+                                verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_mode_select6_pt(struct sg_pt_base * ptvp, bool pf, bool rtd, bool sp,
+                      void * paramp, int param_len, bool noisy, int verbose)
 {
     static const char * const cdb_s = "mode select(6)";
     int res, ret, k, sense_cat;
     uint8_t modes_cdb[MODE_SELECT6_CMDLEN] =
         {MODE_SELECT6_CMD, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     modes_cdb[1] = (uint8_t)((pf ? 0x10 : 0x0) | (sp ? 0x1 : 0x0));
     if (rtd)
@@ -450,12 +523,11 @@ sg_ll_mode_select6_v2(int sg_fd, bool pf, bool rtd, bool sp, void * paramp,
         hex2stderr((const uint8_t *)paramp, param_len, -1);
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, modes_cdb, sizeof(modes_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -471,8 +543,6 @@ sg_ll_mode_select6_v2(int sg_fd, bool pf, bool rtd, bool sp, void * paramp,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -490,13 +560,28 @@ sg_ll_mode_select6(int sg_fd, bool pf, bool sp, void * paramp, int param_len,
 int
 sg_ll_mode_select10_v2(int sg_fd, bool pf, bool rtd, bool sp, void * paramp,
                        int param_len, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_mode_select10_pt(ptvp, pf, rtd, sp, paramp, param_len, noisy,
+                                 verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_mode_select10_pt(struct sg_pt_base * ptvp, bool pf, bool rtd, bool sp,
+                       void * paramp, int param_len, bool noisy, int verbose)
 {
     static const char * const cdb_s = "mode select(10)";
     int res, ret, k, sense_cat;
     uint8_t modes_cdb[MODE_SELECT10_CMDLEN] =
         {MODE_SELECT10_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     modes_cdb[1] = (uint8_t)((pf ? 0x10 : 0x0) | (sp ? 0x1 : 0x0));
     if (rtd)
@@ -517,12 +602,11 @@ sg_ll_mode_select10_v2(int sg_fd, bool pf, bool rtd, bool sp, void * paramp,
         hex2stderr((const uint8_t *)paramp, param_len, -1);
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, modes_cdb, sizeof(modes_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -538,8 +622,6 @@ sg_ll_mode_select10_v2(int sg_fd, bool pf, bool rtd, bool sp, void * paramp,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -785,13 +867,31 @@ sg_ll_log_sense_v2(int sg_fd, bool ppc, bool sp, int pc, int pg_code,
                    int subpg_code, int paramp, uint8_t * resp,
                    int mx_resp_len, int timeout_secs, int * residp,
                    bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_log_sense_pt(ptvp, ppc, sp, pc, pg_code, subpg_code, paramp,
+                             resp, mx_resp_len, timeout_secs, residp, noisy,
+                             verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_log_sense_pt(struct sg_pt_base * ptvp, bool ppc, bool sp, int pc,
+                   int pg_code, int subpg_code, int paramp, uint8_t * resp,
+                   int mx_resp_len, int timeout_secs, int * residp, bool noisy,
+                   int verbose)
 {
     static const char * const cdb_s = "log sense";
     int res, ret, k, sense_cat, resid;
     uint8_t logs_cdb[LOG_SENSE_CMDLEN] =
         {LOG_SENSE_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (mx_resp_len > 0xffff) {
         pr2ws("mx_resp_len too big\n");
@@ -811,12 +911,11 @@ sg_ll_log_sense_v2(int sg_fd, bool ppc, bool sp, int pc, int pg_code,
     if (timeout_secs <= 0)
         timeout_secs = DEF_PT_TIMEOUT;
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        goto gen_err;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, logs_cdb, sizeof(logs_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, timeout_secs, verbose);
+    res = do_scsi_pt(ptvp, -1, timeout_secs, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     resid = get_scsi_pt_resid(ptvp);
     if (residp)
@@ -841,7 +940,6 @@ sg_ll_log_sense_v2(int sg_fd, bool ppc, bool sp, int pc, int pg_code,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
 
     if (resid > 0) {
         if (resid > mx_resp_len) {
@@ -865,13 +963,29 @@ int
 sg_ll_log_select(int sg_fd, bool pcr, bool sp, int pc, int pg_code,
                  int subpg_code, uint8_t * paramp, int param_len,
                  bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_log_select_pt(ptvp, pcr, sp, pc, pg_code, subpg_code, paramp,
+                              param_len, noisy, verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_log_select_pt(struct sg_pt_base * ptvp, bool pcr, bool sp, int pc,
+                    int pg_code, int subpg_code, uint8_t * paramp,
+                    int param_len, bool noisy, int verbose)
 {
     static const char * const cdb_s = "log select";
     int res, ret, k, sense_cat;
     uint8_t logs_cdb[LOG_SELECT_CMDLEN] =
         {LOG_SELECT_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (param_len > 0xffff) {
         pr2ws("%s: param_len too big\n", cdb_s);
@@ -892,12 +1006,11 @@ sg_ll_log_select(int sg_fd, bool pcr, bool sp, int pc, int pg_code,
         hex2stderr(paramp, param_len, -1);
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, logs_cdb, sizeof(logs_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -913,8 +1026,6 @@ sg_ll_log_select(int sg_fd, bool pcr, bool sp, int pc, int pg_code,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -926,12 +1037,12 @@ sg_ll_start_stop_unit(int sg_fd, bool immed, int pc_mod__fl_num,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_start_stop_unit_pt(ptvp, immed, pc_mod__fl_num, power_cond,
                                    noflush__fl, loej, start, noisy, verbose);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -999,13 +1110,27 @@ sg_ll_start_stop_unit_pt(struct sg_pt_base * ptvp, bool immed,
  * various SG_LIB_CAT_* positive values or -1 -> other errors */
 int
 sg_ll_prevent_allow(int sg_fd, int prevent, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_prevent_allow_pt(ptvp, prevent, noisy, verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_prevent_allow_pt(struct sg_pt_base * ptvp, int prevent, bool noisy,
+                       int verbose)
 {
     static const char * const cdb_s = "prevent allow medium removal";
     int k, res, ret, sense_cat;
     uint8_t p_cdb[PREVENT_ALLOW_CMDLEN] =
                 {PREVENT_ALLOW_CMD, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if ((prevent < 0) || (prevent > 3)) {
         pr2ws("prevent argument should be 0, 1, 2 or 3\n");
@@ -1019,11 +1144,10 @@ sg_ll_prevent_allow(int sg_fd, int prevent, bool noisy, int verbose)
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, p_cdb, sizeof(p_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1039,6 +1163,5 @@ sg_ll_prevent_allow(int sg_fd, int prevent, bool noisy, int verbose)
         }
     } else
             ret = 0;
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
@@ -106,27 +106,34 @@
 #define EXTENDED_COPY_LID1_SA 0x0
 
 
-static struct sg_pt_base *
-create_pt_obj(const char * cname)
-{
-    struct sg_pt_base * ptvp = construct_scsi_pt_obj();
-    if (NULL == ptvp)
-        pr2ws("%s: out of memory\n", cname);
-    return ptvp;
-}
-
 
 /* Invokes a SCSI GET LBA STATUS(16) command (SBC). Returns 0 -> success,
  * various SG_LIB_CAT_* positive values or -1 -> other errors */
 int
 sg_ll_get_lba_status16(int sg_fd, uint64_t start_llba, uint8_t rt,
                       void * resp, int alloc_len, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_get_lba_status16_pt(ptvp, start_llba, rt, resp, alloc_len,
+                                    noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_get_lba_status16_pt(struct sg_pt_base * ptvp, uint64_t start_llba,
+                          uint8_t rt, void * resp, int alloc_len, bool noisy,
+                          int vb)
 {
     static const char * const cdb_s = "Get LBA status(16)";
     int k, res, s_cat, ret;
     uint8_t getLbaStatCmd[SERVICE_ACTION_IN_16_CMDLEN];
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     memset(getLbaStatCmd, 0, sizeof(getLbaStatCmd));
     getLbaStatCmd[0] = SERVICE_ACTION_IN_16_CMD;
@@ -142,12 +149,11 @@ sg_ll_get_lba_status16(int sg_fd, uint64_t start_llba, uint8_t rt,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, getLbaStatCmd, sizeof(getLbaStatCmd));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, alloc_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -175,7 +181,6 @@ sg_ll_get_lba_status16(int sg_fd, uint64_t start_llba, uint8_t rt,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -194,12 +199,28 @@ sg_ll_get_lba_status32(int sg_fd, uint64_t start_llba, uint32_t scan_len,
                        uint32_t element_id, uint8_t rt,
                        void * resp, int alloc_len, bool noisy,
                        int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_get_lba_status32_pt(ptvp, start_llba, scan_len, element_id, rt,
+                                    resp, alloc_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_get_lba_status32_pt(struct sg_pt_base * ptvp, uint64_t start_llba,
+                          uint32_t scan_len, uint32_t element_id, uint8_t rt,
+                          void * resp, int alloc_len, bool noisy, int vb)
 {
     static const char * const cdb_s = "Get LBA status(32)";
     int k, res, s_cat, ret;
     uint8_t gls32_cmd[GLS32_CMD_LEN];
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     memset(gls32_cmd, 0, sizeof(gls32_cmd));
     gls32_cmd[0] = SG_VARIABLE_LENGTH_CMD;
@@ -217,12 +238,11 @@ sg_ll_get_lba_status32(int sg_fd, uint64_t start_llba, uint32_t scan_len,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, gls32_cmd, sizeof(gls32_cmd));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, alloc_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -250,7 +270,6 @@ sg_ll_get_lba_status32(int sg_fd, uint64_t start_llba, uint32_t scan_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -267,6 +286,23 @@ sg_ll_report_tgt_prt_grp(int sg_fd, void * resp, int mx_resp_len,
 int
 sg_ll_report_tgt_prt_grp2(int sg_fd, void * resp, int mx_resp_len,
                           bool extended, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_report_tgt_prt_grp2_pt(ptvp, resp, mx_resp_len, extended,
+                                       noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_report_tgt_prt_grp2_pt(struct sg_pt_base * ptvp, void * resp,
+                             int mx_resp_len, bool extended, bool noisy,
+                             int vb)
 {
     static const char * const cdb_s = "Report target port groups";
     int k, res, ret, s_cat;
@@ -274,7 +310,6 @@ sg_ll_report_tgt_prt_grp2(int sg_fd, void * resp, int mx_resp_len,
                          {MAINTENANCE_IN_CMD, REPORT_TGT_PRT_GRP_SA,
                           0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (extended)
         rtpg_cdb[1] |= 0x20;
@@ -286,12 +321,11 @@ sg_ll_report_tgt_prt_grp2(int sg_fd, void * resp, int mx_resp_len,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, rtpg_cdb, sizeof(rtpg_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -319,7 +353,6 @@ sg_ll_report_tgt_prt_grp2(int sg_fd, void * resp, int mx_resp_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -328,6 +361,21 @@ sg_ll_report_tgt_prt_grp2(int sg_fd, void * resp, int mx_resp_len,
 int
 sg_ll_set_tgt_prt_grp(int sg_fd, void * paramp, int param_len, bool noisy,
                       int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_set_tgt_prt_grp_pt(ptvp, paramp, param_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_set_tgt_prt_grp_pt(struct sg_pt_base * ptvp, void * paramp,
+                         int param_len, bool noisy, int vb)
 {
     static const char * const cdb_s = "Set target port groups";
     int k, res, ret, s_cat;
@@ -335,7 +383,6 @@ sg_ll_set_tgt_prt_grp(int sg_fd, void * paramp, int param_len, bool noisy,
                          {MAINTENANCE_OUT_CMD, SET_TGT_PRT_GRP_SA,
                           0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     sg_put_unaligned_be32((uint32_t)param_len, stpg_cdb + 6);
     if (vb) {
@@ -349,12 +396,11 @@ sg_ll_set_tgt_prt_grp(int sg_fd, void * paramp, int param_len, bool noisy,
         }
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, stpg_cdb, sizeof(stpg_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -370,7 +416,6 @@ sg_ll_set_tgt_prt_grp(int sg_fd, void * paramp, int param_len, bool noisy,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -380,6 +425,23 @@ int
 sg_ll_report_referrals(int sg_fd, uint64_t start_llba, bool one_seg,
                        void * resp, int mx_resp_len, bool noisy,
                        int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_report_referrals_pt(ptvp, start_llba, one_seg, resp,
+                                    mx_resp_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_report_referrals_pt(struct sg_pt_base * ptvp, uint64_t start_llba,
+                          bool one_seg, void * resp, int mx_resp_len,
+                          bool noisy, int vb)
 {
     static const char * const cdb_s = "Report referrals";
     int k, res, ret, s_cat;
@@ -387,7 +449,6 @@ sg_ll_report_referrals(int sg_fd, uint64_t start_llba, bool one_seg,
                          {SERVICE_ACTION_IN_16_CMD, REPORT_REFERRALS_SA,
                           0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     sg_put_unaligned_be64(start_llba, repRef_cdb + 2);
     sg_put_unaligned_be32((uint32_t)mx_resp_len, repRef_cdb + 10);
@@ -400,12 +461,11 @@ sg_ll_report_referrals(int sg_fd, uint64_t start_llba, bool one_seg,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, repRef_cdb, sizeof(repRef_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -433,7 +493,6 @@ sg_ll_report_referrals(int sg_fd, uint64_t start_llba, bool one_seg,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -514,13 +573,13 @@ sg_ll_send_diag(int sg_fd, int st_code, bool pf_bit, bool st_bit,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, vb);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_send_diag_pt(ptvp, st_code, pf_bit, st_bit, devofl_bit,
                              unitofl_bit, long_duration, paramp, param_len,
                              noisy, vb);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -599,12 +658,12 @@ sg_ll_receive_diag(int sg_fd, bool pcv, int pg_code, void * resp,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, vb);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_receive_diag_pt(ptvp, pcv, pg_code, resp, mx_resp_len, 0,
                                 NULL, noisy, vb);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -616,12 +675,12 @@ sg_ll_receive_diag_v2(int sg_fd, bool pcv, int pg_code, void * resp,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, vb);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_receive_diag_pt(ptvp, pcv, pg_code, resp, mx_resp_len,
                                 timeout_secs, residp, noisy, vb);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -630,13 +689,29 @@ sg_ll_receive_diag_v2(int sg_fd, bool pcv, int pg_code, void * resp,
 int
 sg_ll_read_defect10(int sg_fd, bool req_plist, bool req_glist, int dl_format,
                     void * resp, int mx_resp_len, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_read_defect10_pt(ptvp, req_plist, req_glist, dl_format, resp,
+                                 mx_resp_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_read_defect10_pt(struct sg_pt_base * ptvp, bool req_plist,
+                       bool req_glist, int dl_format, void * resp,
+                       int mx_resp_len, bool noisy, int vb)
 {
     static const char * const cdb_s = "Read defect(10)";
     int res, k, ret, s_cat;
     uint8_t rdef_cdb[READ_DEFECT10_CMDLEN] =
         {READ_DEFECT10_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     rdef_cdb[2] = (dl_format & 0x7);
     if (req_plist)
@@ -655,12 +730,11 @@ sg_ll_read_defect10(int sg_fd, bool req_plist, bool req_glist, int dl_format,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, rdef_cdb, sizeof(rdef_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -688,7 +762,6 @@ sg_ll_read_defect10(int sg_fd, bool req_plist, bool req_glist, int dl_format,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -697,6 +770,21 @@ sg_ll_read_defect10(int sg_fd, bool req_plist, bool req_glist, int dl_format,
 int
 sg_ll_read_media_serial_num(int sg_fd, void * resp, int mx_resp_len,
                             bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_read_media_serial_num_pt(ptvp, resp, mx_resp_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_read_media_serial_num_pt(struct sg_pt_base * ptvp, void * resp,
+                               int mx_resp_len, bool noisy, int vb)
 {
     static const char * const cdb_s = "Read media serial number";
     int k, res, ret, s_cat;
@@ -704,7 +792,6 @@ sg_ll_read_media_serial_num(int sg_fd, void * resp, int mx_resp_len,
                          {SERVICE_ACTION_IN_12_CMD, READ_MEDIA_SERIAL_NUM_SA,
                           0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     sg_put_unaligned_be32((uint32_t)mx_resp_len, rmsn_cdb + 6);
     if (vb) {
@@ -714,12 +801,11 @@ sg_ll_read_media_serial_num(int sg_fd, void * resp, int mx_resp_len,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, rmsn_cdb, sizeof(rmsn_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -747,7 +833,6 @@ sg_ll_read_media_serial_num(int sg_fd, void * resp, int mx_resp_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -757,6 +842,21 @@ sg_ll_read_media_serial_num(int sg_fd, void * resp, int mx_resp_len,
 int
 sg_ll_report_id_info(int sg_fd, int itype, void * resp, int max_resp_len,
                      bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_report_id_info_pt(ptvp, itype, resp, max_resp_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_report_id_info_pt(struct sg_pt_base * ptvp, int itype, void * resp,
+                        int max_resp_len, bool noisy, int vb)
 {
     static const char * const cdb_s = "Report identifying information";
     int k, res, ret, s_cat;
@@ -764,7 +864,6 @@ sg_ll_report_id_info(int sg_fd, int itype, void * resp, int max_resp_len,
                         REPORT_IDENTIFYING_INFORMATION_SA,
                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     sg_put_unaligned_be32((uint32_t)max_resp_len, rii_cdb + 6);
     rii_cdb[10] |= (itype << 1) & 0xfe;
@@ -776,12 +875,11 @@ sg_ll_report_id_info(int sg_fd, int itype, void * resp, int max_resp_len,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, rii_cdb, sizeof(rii_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, max_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -809,7 +907,6 @@ sg_ll_report_id_info(int sg_fd, int itype, void * resp, int max_resp_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -819,6 +916,21 @@ sg_ll_report_id_info(int sg_fd, int itype, void * resp, int max_resp_len,
 int
 sg_ll_set_id_info(int sg_fd, int itype, void * paramp, int param_len,
                   bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_set_id_info_pt(ptvp, itype, paramp, param_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_set_id_info_pt(struct sg_pt_base * ptvp, int itype, void * paramp,
+                     int param_len, bool noisy, int vb)
 {
     static const char * const cdb_s = "Set identifying information";
     int k, res, ret, s_cat;
@@ -826,7 +938,6 @@ sg_ll_set_id_info(int sg_fd, int itype, void * paramp, int param_len,
                          SET_IDENTIFYING_INFORMATION_SA,
                          0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     sg_put_unaligned_be32((uint32_t)param_len, sii_cdb + 6);
     sii_cdb[10] |= (itype << 1) & 0xfe;
@@ -841,12 +952,11 @@ sg_ll_set_id_info(int sg_fd, int itype, void * paramp, int param_len,
         }
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, sii_cdb, sizeof(sii_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -862,8 +972,6 @@ sg_ll_set_id_info(int sg_fd, int itype, void * paramp, int param_len,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -899,13 +1007,31 @@ sg_ll_format_unit_v2(int sg_fd, int fmtpinfo, bool longlist, bool fmtdata,
                      bool cmplst, int dlist_format, int ffmt,
                      int timeout_secs, void * paramp, int param_len,
                      bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_format_unit_pt(ptvp, fmtpinfo, longlist, fmtdata, cmplst,
+                               dlist_format, ffmt, timeout_secs, paramp,
+                               param_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_format_unit_pt(struct sg_pt_base * ptvp, int fmtpinfo, bool longlist,
+                     bool fmtdata, bool cmplst, int dlist_format, int ffmt,
+                     int timeout_secs, void * paramp, int param_len,
+                     bool noisy, int vb)
 {
     static const char * const cdb_s = "Format unit";
     int k, res, ret, s_cat, tmout;
     uint8_t fu_cdb[FORMAT_UNIT_CMDLEN] =
                 {FORMAT_UNIT_CMD, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (fmtpinfo)
         fu_cdb[1] |= (fmtpinfo << 6);
@@ -934,12 +1060,11 @@ sg_ll_format_unit_v2(int sg_fd, int fmtpinfo, bool longlist, bool fmtdata,
         }
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, fu_cdb, sizeof(fu_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, tmout, vb);
+    res = do_scsi_pt(ptvp, -1, tmout, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -955,8 +1080,6 @@ sg_ll_format_unit_v2(int sg_fd, int fmtpinfo, bool longlist, bool fmtdata,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -965,13 +1088,28 @@ sg_ll_format_unit_v2(int sg_fd, int fmtpinfo, bool longlist, bool fmtdata,
 int
 sg_ll_reassign_blocks(int sg_fd, bool longlba, bool longlist, void * paramp,
                       int param_len, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_reassign_blocks_pt(ptvp, longlba, longlist, paramp, param_len,
+                                   noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_reassign_blocks_pt(struct sg_pt_base * ptvp, bool longlba, bool longlist,
+                         void * paramp, int param_len, bool noisy, int vb)
 {
     static const char * const cdb_s = "Reassign blocks";
     int res, k, ret, s_cat;
     uint8_t reass_cdb[REASSIGN_BLKS_CMDLEN] =
         {REASSIGN_BLKS_CMD, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (longlba)
         reass_cdb[1] = 0x2;
@@ -988,12 +1126,11 @@ sg_ll_reassign_blocks(int sg_fd, bool longlba, bool longlist, void * paramp,
         hex2stderr((const uint8_t *)paramp, param_len, -1);
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, reass_cdb, sizeof(reass_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1009,8 +1146,6 @@ sg_ll_reassign_blocks(int sg_fd, bool longlba, bool longlist, void * paramp,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1020,13 +1155,29 @@ sg_ll_reassign_blocks(int sg_fd, bool longlba, bool longlist, void * paramp,
 int
 sg_ll_persistent_reserve_in(int sg_fd, int rq_servact, void * resp,
                             int mx_resp_len, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_persistent_reserve_in_pt(ptvp, rq_servact, resp, mx_resp_len,
+                                         noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_persistent_reserve_in_pt(struct sg_pt_base * ptvp, int rq_servact,
+                               void * resp, int mx_resp_len, bool noisy,
+                               int vb)
 {
     static const char * const cdb_s = "Persistent reservation in";
     int res, k, ret, s_cat;
     uint8_t prin_cdb[PERSISTENT_RESERVE_IN_CMDLEN] =
                  {PERSISTENT_RESERVE_IN_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (rq_servact > 0)
         prin_cdb[1] = (uint8_t)(rq_servact & 0x1f);
@@ -1039,12 +1190,11 @@ sg_ll_persistent_reserve_in(int sg_fd, int rq_servact, void * resp,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, prin_cdb, sizeof(prin_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1072,7 +1222,6 @@ sg_ll_persistent_reserve_in(int sg_fd, int rq_servact, void * resp,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1083,13 +1232,30 @@ int
 sg_ll_persistent_reserve_out(int sg_fd, int rq_servact, int rq_scope,
                              unsigned int rq_type, void * paramp,
                              int param_len, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_persistent_reserve_out_pt(ptvp, rq_servact, rq_scope, rq_type,
+                                          paramp, param_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_persistent_reserve_out_pt(struct sg_pt_base * ptvp, int rq_servact,
+                                int rq_scope, unsigned int rq_type,
+                                void * paramp, int param_len, bool noisy,
+                                int vb)
 {
     static const char * const cdb_s = "Persistent reservation out";
     int res, k, ret, s_cat;
     uint8_t prout_cdb[PERSISTENT_RESERVE_OUT_CMDLEN] =
                  {PERSISTENT_RESERVE_OUT_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (rq_servact > 0)
         prout_cdb[1] = (uint8_t)(rq_servact & 0x1f);
@@ -1107,12 +1273,11 @@ sg_ll_persistent_reserve_out(int sg_fd, int rq_servact, int rq_scope,
         }
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, prout_cdb, sizeof(prout_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1128,8 +1293,6 @@ sg_ll_persistent_reserve_out(int sg_fd, int rq_servact, int rq_scope,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1158,12 +1321,28 @@ int
 sg_ll_read_long10(int sg_fd, bool pblock, bool correct, unsigned int lba,
                   void * resp, int xfer_len, int * offsetp, bool noisy,
                   int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_read_long10_pt(ptvp, pblock, correct, lba, resp, xfer_len,
+                               offsetp, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_read_long10_pt(struct sg_pt_base * ptvp, bool pblock, bool correct,
+                     unsigned int lba, void * resp, int xfer_len,
+                     int * offsetp, bool noisy, int vb)
 {
     static const char * const cdb_s = "read long(10)";
     int k, res, s_cat, ret;
     uint8_t readLong_cdb[READ_LONG10_CMDLEN];
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     memset(readLong_cdb, 0, READ_LONG10_CMDLEN);
     readLong_cdb[0] = READ_LONG10_CMD;
@@ -1181,12 +1360,11 @@ sg_ll_read_long10(int sg_fd, bool pblock, bool correct, unsigned int lba,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, readLong_cdb, sizeof(readLong_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, xfer_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1235,7 +1413,6 @@ sg_ll_read_long10(int sg_fd, bool pblock, bool correct, unsigned int lba,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1246,12 +1423,28 @@ int
 sg_ll_read_long16(int sg_fd, bool pblock, bool correct, uint64_t llba,
                   void * resp, int xfer_len, int * offsetp, bool noisy,
                   int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_read_long16_pt(ptvp, pblock, correct, llba, resp, xfer_len,
+                               offsetp, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_read_long16_pt(struct sg_pt_base * ptvp, bool pblock, bool correct,
+                     uint64_t llba, void * resp, int xfer_len, int * offsetp,
+                     bool noisy, int vb)
 {
     static const char * const cdb_s = "read long(16)";
     int k, res, s_cat, ret;
     uint8_t readLong_cdb[SERVICE_ACTION_IN_16_CMDLEN];
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     memset(readLong_cdb, 0, sizeof(readLong_cdb));
     readLong_cdb[0] = SERVICE_ACTION_IN_16_CMD;
@@ -1270,12 +1463,11 @@ sg_ll_read_long16(int sg_fd, bool pblock, bool correct, uint64_t llba,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, readLong_cdb, sizeof(readLong_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, xfer_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1324,7 +1516,6 @@ sg_ll_read_long16(int sg_fd, bool pblock, bool correct, uint64_t llba,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1335,12 +1526,28 @@ int
 sg_ll_write_long10(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
                    unsigned int lba, void * data_out, int xfer_len,
                    int * offsetp, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_write_long10_pt(ptvp, cor_dis, wr_uncor, pblock, lba, data_out,
+                                xfer_len, offsetp, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_write_long10_pt(struct sg_pt_base * ptvp, bool cor_dis, bool wr_uncor,
+                      bool pblock, unsigned int lba, void * data_out,
+                      int xfer_len, int * offsetp, bool noisy, int vb)
 {
     static const char * const cdb_s = "write long(10)";
     int k, res, s_cat, ret;
     uint8_t writeLong_cdb[WRITE_LONG10_CMDLEN];
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     memset(writeLong_cdb, 0, WRITE_LONG10_CMDLEN);
     writeLong_cdb[0] = WRITE_LONG10_CMD;
@@ -1360,12 +1567,11 @@ sg_ll_write_long10(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, writeLong_cdb, sizeof(writeLong_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)data_out, xfer_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1401,8 +1607,6 @@ sg_ll_write_long10(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1413,12 +1617,28 @@ int
 sg_ll_write_long16(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
                    uint64_t llba, void * data_out, int xfer_len,
                    int * offsetp, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_write_long16_pt(ptvp, cor_dis, wr_uncor, pblock, llba,
+                                data_out, xfer_len, offsetp, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_write_long16_pt(struct sg_pt_base * ptvp, bool cor_dis, bool wr_uncor,
+                      bool pblock, uint64_t llba, void * data_out,
+                      int xfer_len, int * offsetp, bool noisy, int vb)
 {
     static const char * const cdb_s = "write long(16)";
     int k, res, s_cat, ret;
     uint8_t writeLong_cdb[SERVICE_ACTION_OUT_16_CMDLEN];
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     memset(writeLong_cdb, 0, sizeof(writeLong_cdb));
     writeLong_cdb[0] = SERVICE_ACTION_OUT_16_CMD;
@@ -1439,12 +1659,11 @@ sg_ll_write_long16(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, writeLong_cdb, sizeof(writeLong_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)data_out, xfer_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1481,8 +1700,6 @@ sg_ll_write_long16(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1495,13 +1712,29 @@ sg_ll_verify10(int sg_fd, int vrprotect, bool dpo, int bytchk,
                unsigned int lba, int veri_len, void * data_out,
                int data_out_len, unsigned int * infop, bool noisy,
                int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_verify10_pt(ptvp, vrprotect, dpo, bytchk, lba, veri_len,
+                            data_out, data_out_len, infop, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_verify10_pt(struct sg_pt_base * ptvp, int vrprotect, bool dpo,
+                  int bytchk, unsigned int lba, int veri_len, void * data_out,
+                  int data_out_len, unsigned int * infop, bool noisy, int vb)
 {
     static const char * const cdb_s = "verify(10)";
     int k, res, ret, s_cat, slen;
     uint8_t v_cdb[VERIFY10_CMDLEN] =
                 {VERIFY10_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     /* N.B. BYTCHK field expanded to 2 bits sbc3r34 */
     v_cdb[1] = (((vrprotect & 0x7) << 5) | ((bytchk & 0x3) << 1)) ;
@@ -1521,13 +1754,12 @@ sg_ll_verify10(int sg_fd, int vrprotect, bool dpo, int bytchk,
             hex2stderr((const uint8_t *)data_out, k, vb < 5);
         }
     }
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, v_cdb, sizeof(v_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     if (data_out_len > 0)
         set_scsi_pt_data_out(ptvp, (uint8_t *)data_out, data_out_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1558,8 +1790,6 @@ sg_ll_verify10(int sg_fd, int vrprotect, bool dpo, int bytchk,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1571,13 +1801,31 @@ int
 sg_ll_verify16(int sg_fd, int vrprotect, bool dpo, int bytchk, uint64_t llba,
                int veri_len, int group_num, void * data_out,
                int data_out_len, uint64_t * infop, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_verify16_pt(ptvp, vrprotect, dpo, bytchk, llba, veri_len,
+                            group_num, data_out, data_out_len, infop, noisy,
+                            vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_verify16_pt(struct sg_pt_base * ptvp, int vrprotect, bool dpo,
+                  int bytchk, uint64_t llba, int veri_len, int group_num,
+                  void * data_out, int data_out_len, uint64_t * infop,
+                  bool noisy, int vb)
 {
     static const char * const cdb_s = "verify(16)";
     int k, res, ret, s_cat, slen;
     uint8_t v_cdb[VERIFY16_CMDLEN] =
                 {VERIFY16_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     /* N.B. BYTCHK field expanded to 2 bits sbc3r34 */
     v_cdb[1] = (((vrprotect & 0x7) << 5) | ((bytchk & 0x3) << 1)) ;
@@ -1598,13 +1846,12 @@ sg_ll_verify16(int sg_fd, int vrprotect, bool dpo, int bytchk, uint64_t llba,
             hex2stderr((const uint8_t *)data_out, k, vb < 5);
         }
     }
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return sg_convert_errno(ENOMEM);
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, v_cdb, sizeof(v_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     if (data_out_len > 0)
         set_scsi_pt_data_out(ptvp, (uint8_t *)data_out, data_out_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1635,8 +1882,6 @@ sg_ll_verify16(int sg_fd, int vrprotect, bool dpo, int bytchk, uint64_t llba,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1726,8 +1971,9 @@ sg_ll_ata_pt(int sg_fd, const uint8_t * cdbp, int cdb_len,
             hex2stderr(apt_cdb, cdb_len, -1);
         }
     }
-    if (NULL == ((ptvp = create_pt_obj(cnamep))))
-        return -1;
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
     set_scsi_pt_cdb(ptvp, apt_cdb, cdb_len);
     set_scsi_pt_sense(ptvp, sp, slen);
     if (dlen > 0) {
@@ -1810,7 +2056,7 @@ sg_ll_ata_pt(int sg_fd, const uint8_t * cdbp, int cdb_len,
     }
 
 out:
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1819,13 +2065,29 @@ out:
 int
 sg_ll_read_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
                   void * resp, int mx_resp_len, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_read_buffer_pt(ptvp, mode, buffer_id, buffer_offset, resp,
+                               mx_resp_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_read_buffer_pt(struct sg_pt_base * ptvp, int mode, int buffer_id,
+                     int buffer_offset, void * resp, int mx_resp_len,
+                     bool noisy, int vb)
 {
     static const char * const cdb_s = "read buffer(10)";
     int res, k, ret, s_cat;
     uint8_t rbuf_cdb[READ_BUFFER_CMDLEN] =
         {READ_BUFFER_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     rbuf_cdb[1] = (uint8_t)(mode & 0x1f);
     rbuf_cdb[2] = (uint8_t)(buffer_id & 0xff);
@@ -1838,12 +2100,11 @@ sg_ll_read_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, rbuf_cdb, sizeof(rbuf_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1871,7 +2132,6 @@ sg_ll_read_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -1910,8 +2170,9 @@ sg_ll_write_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
         }
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
     set_scsi_pt_cdb(ptvp, wbuf_cdb, sizeof(wbuf_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
@@ -1931,8 +2192,7 @@ sg_ll_write_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1948,12 +2208,29 @@ sg_ll_write_buffer_v2(int sg_fd, int mode, int m_specific, int buffer_id,
                       uint32_t buffer_offset, void * paramp,
                       uint32_t param_len, int timeout_secs, bool noisy,
                       int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_write_buffer_pt(ptvp, mode, m_specific, buffer_id,
+                                buffer_offset, paramp, param_len, timeout_secs,
+                                noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_write_buffer_pt(struct sg_pt_base * ptvp, int mode, int m_specific,
+                      int buffer_id, uint32_t buffer_offset, void * paramp,
+                      uint32_t param_len, int timeout_secs, bool noisy, int vb)
 {
     int k, res, ret, s_cat;
     uint8_t wbuf_cdb[WRITE_BUFFER_CMDLEN] =
         {WRITE_BUFFER_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (buffer_offset > 0xffffff) {
         pr2ws("%s: buffer_offset value too large for 24 bits\n", __func__);
@@ -1983,15 +2260,11 @@ sg_ll_write_buffer_v2(int sg_fd, int mode, int m_specific, int buffer_id,
     if (timeout_secs <= 0)
         timeout_secs = DEF_PT_TIMEOUT;
 
-    ptvp = construct_scsi_pt_obj();
-    if (NULL == ptvp) {
-        pr2ws("%s: out of memory\n", __func__);
-        return -1;
-    }
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, wbuf_cdb, sizeof(wbuf_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, timeout_secs, vb);
+    res = do_scsi_pt(ptvp, -1, timeout_secs, vb);
     ret = sg_cmds_process_resp(ptvp, "Write buffer", res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2007,8 +2280,6 @@ sg_ll_write_buffer_v2(int sg_fd, int mode, int m_specific, int buffer_id,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -2027,13 +2298,29 @@ sg_ll_unmap(int sg_fd, int group_num, int timeout_secs, void * paramp,
 int
 sg_ll_unmap_v2(int sg_fd, bool anchor, int group_num, int timeout_secs,
                void * paramp, int param_len, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_unmap_pt(ptvp, anchor, group_num, timeout_secs, paramp,
+                         param_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_unmap_pt(struct sg_pt_base * ptvp, bool anchor, int group_num,
+               int timeout_secs, void * paramp, int param_len, bool noisy,
+               int vb)
 {
     static const char * const cdb_s = "unmap";
     int k, res, ret, s_cat, tmout;
     uint8_t u_cdb[UNMAP_CMDLEN] =
                          {UNMAP_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (anchor)
         u_cdb[1] |= 0x1;
@@ -2051,12 +2338,11 @@ sg_ll_unmap_v2(int sg_fd, bool anchor, int group_num, int timeout_secs,
         }
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, u_cdb, sizeof(u_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, tmout, vb);
+    res = do_scsi_pt(ptvp, -1, tmout, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2072,7 +2358,6 @@ sg_ll_unmap_v2(int sg_fd, bool anchor, int group_num, int timeout_secs,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -2081,13 +2366,27 @@ sg_ll_unmap_v2(int sg_fd, bool anchor, int group_num, int timeout_secs,
 int
 sg_ll_read_block_limits(int sg_fd, void * resp, int mx_resp_len,
                         bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_read_block_limits_pt(ptvp, resp, mx_resp_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_read_block_limits_pt(struct sg_pt_base * ptvp, void * resp,
+                           int mx_resp_len, bool noisy, int vb)
 {
     static const char * const cdb_s = "read block limits";
     int k, ret, res, s_cat;
     uint8_t rl_cdb[READ_BLOCK_LIMITS_CMDLEN] =
       {READ_BLOCK_LIMITS_CMD, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if (vb) {
         pr2ws("    %s cdb: ", cdb_s);
@@ -2096,12 +2395,11 @@ sg_ll_read_block_limits(int sg_fd, void * resp, int mx_resp_len,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, rl_cdb, sizeof(rl_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2129,7 +2427,6 @@ sg_ll_read_block_limits(int sg_fd, void * resp, int mx_resp_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -2139,12 +2436,27 @@ sg_ll_read_block_limits(int sg_fd, void * resp, int mx_resp_len,
 int
 sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
                            int mx_resp_len, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_receive_copy_results_pt(ptvp, sa, list_id, resp, mx_resp_len,
+                                        noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_receive_copy_results_pt(struct sg_pt_base * ptvp, int sa, int list_id,
+                              void * resp, int mx_resp_len, bool noisy, int vb)
 {
     int k, res, ret, s_cat;
     uint8_t rcvcopyres_cdb[THIRD_PARTY_COPY_IN_CMDLEN] =
       {THIRD_PARTY_COPY_IN_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
     char b[64];
 
     sg_get_opcode_sa_name(THIRD_PARTY_COPY_IN_CMD, sa, 0, (int)sizeof(b), b);
@@ -2162,12 +2474,11 @@ sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(b))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, rcvcopyres_cdb, sizeof(rcvcopyres_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, b, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2183,7 +2494,6 @@ sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -2198,12 +2508,26 @@ sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
 int
 sg_ll_extended_copy(int sg_fd, void * paramp, int param_len, bool noisy,
                     int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_extended_copy_pt(ptvp, paramp, param_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_extended_copy_pt(struct sg_pt_base * ptvp, void * paramp, int param_len,
+                       bool noisy, int vb)
 {
     int k, res, ret, s_cat;
     uint8_t xcopy_cdb[THIRD_PARTY_COPY_OUT_CMDLEN] =
       {THIRD_PARTY_COPY_OUT_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
     const char * cdb_s = "Extended copy (LID1)";
 
     xcopy_cdb[1] = (uint8_t)(EXTENDED_COPY_LID1_SA & 0x1f);
@@ -2220,12 +2544,11 @@ sg_ll_extended_copy(int sg_fd, void * paramp, int param_len, bool noisy,
         }
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, xcopy_cdb, sizeof(xcopy_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2241,7 +2564,6 @@ sg_ll_extended_copy(int sg_fd, void * paramp, int param_len, bool noisy,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -2254,12 +2576,28 @@ int
 sg_ll_3party_copy_out(int sg_fd, int sa, unsigned int list_id, int group_num,
                       int timeout_secs, void * paramp, int param_len,
                       bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_3party_copy_out_pt(ptvp, sa, list_id, group_num, timeout_secs,
+                                   paramp, param_len, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_3party_copy_out_pt(struct sg_pt_base * ptvp, int sa,
+                         unsigned int list_id, int group_num, int timeout_secs,
+                         void * paramp, int param_len, bool noisy, int vb)
 {
     int k, res, ret, s_cat, tmout;
     uint8_t xcopy_cdb[THIRD_PARTY_COPY_OUT_CMDLEN] =
       {THIRD_PARTY_COPY_OUT_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
     char cname[80];
 
     sg_get_opcode_sa_name(THIRD_PARTY_COPY_OUT_CMD, sa, 0, sizeof(cname),
@@ -2296,12 +2634,11 @@ sg_ll_3party_copy_out(int sg_fd, int sa, unsigned int list_id, int group_num,
         }
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cname))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, xcopy_cdb, sizeof(xcopy_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, tmout, vb);
+    res = do_scsi_pt(ptvp, -1, tmout, vb);
     ret = sg_cmds_process_resp(ptvp, cname, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2317,7 +2654,6 @@ sg_ll_3party_copy_out(int sg_fd, int sa, unsigned int list_id, int group_num,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -2334,6 +2670,23 @@ int
 sg_ll_pre_fetch_x(int sg_fd, bool do_seek10, bool cdb16, bool immed,
                   uint64_t lba, uint32_t num_blocks, int group_num,
                   int timeout_secs, bool noisy, int vb)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_pre_fetch_x_pt(ptvp, do_seek10, cdb16, immed, lba, num_blocks,
+                               group_num, timeout_secs, noisy, vb);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_pre_fetch_x_pt(struct sg_pt_base * ptvp, bool do_seek10, bool cdb16,
+                     bool immed, uint64_t lba, uint32_t num_blocks,
+                     int group_num, int timeout_secs, bool noisy, int vb)
 {
     static const char * const cdb10_name_s = "Pre-fetch(10)";
     static const char * const cdb16_name_s = "Pre-fetch(16)";
@@ -2342,7 +2695,6 @@ sg_ll_pre_fetch_x(int sg_fd, bool do_seek10, bool cdb16, bool immed,
     const char *cdb_s;
     uint8_t preFetchCdb[PRE_FETCH16_CMDLEN]; /* all use longest cdb */
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     memset(preFetchCdb, 0, sizeof(preFetchCdb));
     if (do_seek10) {
@@ -2391,11 +2743,10 @@ sg_ll_pre_fetch_x(int sg_fd, bool do_seek10, bool cdb16, bool immed,
             pr2ws("%02x ", preFetchCdb[k]);
         pr2ws("\n");
     }
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, preFetchCdb, cdb_len);
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
-    res = do_scsi_pt(ptvp, sg_fd, tmout, vb);
+    res = do_scsi_pt(ptvp, -1, tmout, vb);
     if (0 == res) {
         int sstat = get_scsi_pt_status_response(ptvp);
 
@@ -2422,6 +2773,5 @@ sg_ll_pre_fetch_x(int sg_fd, bool do_seek10, bool cdb16, bool immed,
     } else
         ret = 0;
 fini:
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
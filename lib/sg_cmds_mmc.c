@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <errno.h>
 #include <string.h>
 #include <unistd.h>
 #define __STDC_FORMAT_MACROS 1
@@ -41,15 +42,6 @@
 #define SET_STREAMING_CMDLEN 12
 
 
-static struct sg_pt_base *
-create_pt_obj(const char * cname)
-{
-    struct sg_pt_base * ptvp = construct_scsi_pt_obj();
-    if (NULL == ptvp)
-        pr2ws("%s: out of memory\n", cname);
-    return ptvp;
-}
-
 /* Invokes a SCSI SET CD SPEED command (MMC).
  * Return of 0 -> success, SG_LIB_CAT_INVALID_OP -> command not supported,
  * SG_LIB_CAT_ILLEGAL_REQ -> bad field in cdb, SG_LIB_CAT_UNIT_ATTENTION,
@@ -58,13 +50,29 @@ create_pt_obj(const char * cname)
 int
 sg_ll_set_cd_speed(int sg_fd, int rot_control, int drv_read_speed,
                    int drv_write_speed, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_set_cd_speed_pt(ptvp, rot_control, drv_read_speed,
+                                drv_write_speed, noisy, verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_set_cd_speed_pt(struct sg_pt_base * ptvp, int rot_control,
+                      int drv_read_speed, int drv_write_speed, bool noisy,
+                      int verbose)
 {
     static const char * const cdb_s = "set cd speed";
     int res, ret, k, sense_cat;
     uint8_t scsCmdBlk[SET_CD_SPEED_CMDLEN] = {SET_CD_SPEED_CMD, 0,
                                          0, 0, 0, 0, 0, 0, 0, 0, 0 ,0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     scsCmdBlk[1] |= (rot_control & 0x3);
     sg_put_unaligned_be16((uint16_t)drv_read_speed, scsCmdBlk + 2);
@@ -76,11 +84,10 @@ sg_ll_set_cd_speed(int sg_fd, int rot_control, int drv_read_speed,
             pr2ws("%02x ", scsCmdBlk[k]);
         pr2ws("\n");
     }
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, scsCmdBlk, sizeof(scsCmdBlk));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -103,8 +110,6 @@ sg_ll_set_cd_speed(int sg_fd, int rot_control, int drv_read_speed,
         }
     } else
         ret = 0;
-
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -115,13 +120,28 @@ sg_ll_set_cd_speed(int sg_fd, int rot_control, int drv_read_speed,
 int
 sg_ll_get_config(int sg_fd, int rt, int starting, void * resp,
                  int mx_resp_len, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_get_config_pt(ptvp, rt, starting, resp, mx_resp_len, noisy,
+                              verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_get_config_pt(struct sg_pt_base * ptvp, int rt, int starting,
+                    void * resp, int mx_resp_len, bool noisy, int verbose)
 {
     static const char * const cdb_s = "get configuration";
     int res, k, ret, sense_cat;
     uint8_t gcCmdBlk[GET_CONFIG_CMD_LEN] = {GET_CONFIG_CMD, 0, 0, 0,
                                                   0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if ((rt < 0) || (rt > 3)) {
         pr2ws("Bad rt value: %d\n", rt);
@@ -146,12 +166,11 @@ sg_ll_get_config(int sg_fd, int rt, int starting, void * resp,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, gcCmdBlk, sizeof(gcCmdBlk));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -193,7 +212,6 @@ sg_ll_get_config(int sg_fd, int rt, int starting, void * resp,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -205,13 +223,30 @@ int
 sg_ll_get_performance(int sg_fd, int data_type, unsigned int starting_lba,
                       int max_num_desc, int ttype, void * resp,
                       int mx_resp_len, bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_get_performance_pt(ptvp, data_type, starting_lba, max_num_desc,
+                                   ttype, resp, mx_resp_len, noisy, verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_get_performance_pt(struct sg_pt_base * ptvp, int data_type,
+                         unsigned int starting_lba, int max_num_desc,
+                         int ttype, void * resp, int mx_resp_len, bool noisy,
+                         int verbose)
 {
     static const char * const cdb_s = "get performance";
     int res, k, ret, sense_cat;
     uint8_t gpCmdBlk[GET_PERFORMANCE_CMD_LEN] = {GET_PERFORMANCE_CMD, 0,
                                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     if ((data_type < 0) || (data_type > 0x1f)) {
         pr2ws("Bad data_type value: %d\n", data_type);
@@ -237,12 +272,11 @@ sg_ll_get_performance(int sg_fd, int data_type, unsigned int starting_lba,
         pr2ws("\n");
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, gpCmdBlk, sizeof(gpCmdBlk));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -284,7 +318,6 @@ sg_ll_get_performance(int sg_fd, int data_type, unsigned int starting_lba,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
 
@@ -296,13 +329,28 @@ sg_ll_get_performance(int sg_fd, int data_type, unsigned int starting_lba,
 int
 sg_ll_set_streaming(int sg_fd, int type, void * paramp, int param_len,
                     bool noisy, int verbose)
+{
+    int ret;
+    struct sg_pt_base * ptvp;
+
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
+    if (NULL == ptvp)
+        return sg_convert_errno(ENOMEM);
+    ret = sg_ll_set_streaming_pt(ptvp, type, paramp, param_len, noisy,
+                                 verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return ret;
+}
+
+int
+sg_ll_set_streaming_pt(struct sg_pt_base * ptvp, int type, void * paramp,
+                       int param_len, bool noisy, int verbose)
 {
     static const char * const cdb_s = "set streaming";
     int k, res, ret, sense_cat;
     uint8_t ssCmdBlk[SET_STREAMING_CMDLEN] =
                  {SET_STREAMING_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
-    struct sg_pt_base * ptvp;
 
     ssCmdBlk[8] = type;
     sg_put_unaligned_be16((uint16_t)param_len, ssCmdBlk + 9);
@@ -317,12 +365,11 @@ sg_ll_set_streaming(int sg_fd, int type, void * paramp, int param_len,
         }
     }
 
-    if (NULL == ((ptvp = create_pt_obj(cdb_s))))
-        return -1;
+    clear_scsi_pt_obj(ptvp);
     set_scsi_pt_cdb(ptvp, ssCmdBlk, sizeof(ssCmdBlk));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -345,6 +392,5 @@ sg_ll_set_streaming(int sg_fd, int type, void * paramp, int param_len,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
     return ret;
 }
@@ -0,0 +1,849 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_hash version 1.00 20261017 */
+
+/* This file contains the CRC32C and XXH64 checksums and the hash stage of
+ * the dd family of utilities (see sg_hash_stage_create() in sg_lib.h).
+ * CRC32C uses the SSE 4.2 crc32 instruction on x86_64 when the CPU has it
+ * (checked at run time) and the ARMv8 crc32c instructions when built for
+ * them; otherwise it is table driven, 8 bytes at a time. The stage keeps a
+ * few slots, each naming a chunk still in the submitter's buffer: the
+ * hashing threads hash it there while the submitter goes on to write it.
+ * Before the submitter reads into that buffer again it waits for the hash
+ * with sg_hash_stage_wait(); when no slot is free sg_hash_stage_submit()
+ * waits. So a slow hash slows the copy down rather than adding to the
+ * work of the I/O threads. Slots change state with atomic operations and
+ * threads with nothing to do sleep on a futex (or, other than on Linux,
+ * poll) so, like the logging rings, this file does not need pthreads; the
+ * utility creates the hashing threads, each running
+ * sg_hash_stage_worker().
+ *
+ * A manifest is a text file:
+ *     # <comment lines>
+ *     alg=crc32c bs=512 extents=<n>
+ *     <start block> <number of blocks> <hash in hex>
+ *     ...
+ *     stream=<hash in hex> blocks=<total>
+ * where block numbers are relative to the start of the copy.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef SG_LIB_LINUX
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "sg_lib.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+#define SG_CRC32C_POLY 0x82f63b78      /* Castagnoli, bit reversed */
+
+#define SG_XXH_P1 0x9e3779b185ebca87ULL
+#define SG_XXH_P2 0xc2b2ae3d27d4eb4fULL
+#define SG_XXH_P3 0x165667b19e3779f9ULL
+#define SG_XXH_P4 0x85ebca77c2b2ae63ULL
+#define SG_XXH_P5 0x27d4eb2f165667c5ULL
+
+#define SG_HASH_DEF_THR 2
+#define SG_HASH_SLOTS_PER_THR 4
+#define SG_HASH_POLL_NS 50000   /* without futexes, poll every 50 us */
+
+#define SG_HASH_SLOT_FREE 0
+#define SG_HASH_SLOT_FILL 1     /* submitter setting it up */
+#define SG_HASH_SLOT_READY 2
+#define SG_HASH_SLOT_BUSY 3     /* worker hashing it */
+#define SG_HASH_MAX_REPORT 8    /* miscompares listed by verify */
+
+static uint32_t crc32c_tab[8][256];
+static int crc32c_tab_state;    /* 0: not built, 1: building, 2: ready */
+
+struct sg_hash_ext {
+    int64_t blk;
+    int num_blks;
+    uint64_t hash;
+};
+
+struct sg_hash_slot {
+    int state;                  /* SG_HASH_SLOT_*, atomic */
+    int num_blks;
+    int64_t blk;
+    const uint8_t * bp;         /* submitter's buffer, atomic */
+};
+
+/* What a thread with nothing to do sleeps on: it reads seq, checks for
+ * work and if there is none sleeps until seq moves on. */
+struct sg_hash_event {
+    int seq;                    /* atomic, futex word */
+    int num_sleepers;           /* atomic, to skip needless wake ups */
+};
+
+struct sg_hash_stage {
+    int alg;
+    int bs;
+    int max_blks;
+    bool stopping;              /* atomic, see sg_hash_stage_stop() */
+    bool ext_lock;              /* atomic, spin lock on the extents */
+    int num_ext;
+    int ext_sz;
+    struct sg_hash_ext * ext_arr;
+    int num_workers;            /* atomic, in sg_hash_stage_worker() */
+    int num_slots;
+    struct sg_hash_slot * slot_arr;
+    struct sg_hash_event ready_ev;      /* slot made ready, or stopping */
+    struct sg_hash_event free_ev;       /* slot freed */
+};
+
+
+static void
+crc32c_tab_init(void)
+{
+    int k, j;
+    int exp = 0;
+    uint32_t c;
+
+    if (2 == __atomic_load_n(&crc32c_tab_state, __ATOMIC_ACQUIRE))
+        return;
+    if (! __atomic_compare_exchange_n(&crc32c_tab_state, &exp, 1, false,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        while (2 != __atomic_load_n(&crc32c_tab_state, __ATOMIC_ACQUIRE))
+            sched_yield();      /* another thread is building it */
+        return;
+    }
+    for (k = 0; k < 256; ++k) {
+        c = k;
+        for (j = 0; j < 8; ++j)
+            c = (c >> 1) ^ (SG_CRC32C_POLY & (0 - (c & 1)));
+        crc32c_tab[0][k] = c;
+    }
+    for (k = 0; k < 256; ++k) {
+        for (j = 1; j < 8; ++j)
+            crc32c_tab[j][k] = (crc32c_tab[j - 1][k] >> 8) ^
+                               crc32c_tab[0][crc32c_tab[j - 1][k] & 0xff];
+    }
+    __atomic_store_n(&crc32c_tab_state, 2, __ATOMIC_RELEASE);
+}
+
+/* c is the working value, that is without the final inversion */
+static uint32_t
+crc32c_sw(uint32_t c, const uint8_t * bp, uint64_t len)
+{
+    uint64_t w;
+
+    crc32c_tab_init();
+    for ( ; len >= 8; len -= 8, bp += 8) {
+        w = sg_get_unaligned_le64(bp) ^ c;
+        c = crc32c_tab[7][w & 0xff] ^ crc32c_tab[6][(w >> 8) & 0xff] ^
+            crc32c_tab[5][(w >> 16) & 0xff] ^
+            crc32c_tab[4][(w >> 24) & 0xff] ^
+            crc32c_tab[3][(w >> 32) & 0xff] ^
+            crc32c_tab[2][(w >> 40) & 0xff] ^
+            crc32c_tab[1][(w >> 48) & 0xff] ^ crc32c_tab[0][w >> 56];
+    }
+    for ( ; len > 0; --len)
+        c = (c >> 8) ^ crc32c_tab[0][(c ^ *bp++) & 0xff];
+    return c;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SG_CRC32C_HW_X86 1
+
+__attribute__ ((target ("sse4.2")))
+static uint32_t
+crc32c_x86(uint32_t c, const uint8_t * bp, uint64_t len)
+{
+    uint64_t c64;
+
+    for ( ; (len > 0) && ((uintptr_t)bp & 7); --len)
+        c = __builtin_ia32_crc32qi(c, *bp++);
+    c64 = c;
+    for ( ; len >= 8; len -= 8, bp += 8)
+        c64 = __builtin_ia32_crc32di(c64, sg_get_unaligned_le64(bp));
+    c = (uint32_t)c64;
+    for ( ; len > 0; --len)
+        c = __builtin_ia32_crc32qi(c, *bp++);
+    return c;
+}
+#endif
+
+uint32_t
+sg_crc32c(uint32_t crc, const uint8_t * bp, uint64_t len)
+{
+    uint32_t c = ~crc;
+
+#if defined(SG_CRC32C_HW_X86)
+    static int have_hw = -1;
+    int hw = __atomic_load_n(&have_hw, __ATOMIC_RELAXED);
+
+    if (hw < 0) {               /* all threads get the same answer */
+        hw = !! __builtin_cpu_supports("sse4.2");
+        __atomic_store_n(&have_hw, hw, __ATOMIC_RELAXED);
+    }
+    if (hw)
+        return ~crc32c_x86(c, bp, len);
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    for ( ; len >= 8; len -= 8, bp += 8)
+        c = __crc32cd(c, sg_get_unaligned_le64(bp));
+    for ( ; len > 0; --len)
+        c = __crc32cb(c, *bp++);
+    return ~c;
+#endif
+    return ~crc32c_sw(c, bp, len);
+}
+
+/* Multiplies the 32x32 GF(2) matrix mat by vec */
+static uint32_t
+gf2_times(const uint32_t * mat, uint32_t vec)
+{
+    uint32_t sum = 0;
+
+    for ( ; vec; vec >>= 1, ++mat) {
+        if (vec & 1)
+            sum ^= *mat;
+    }
+    return sum;
+}
+
+static void
+gf2_square(uint32_t * sq, const uint32_t * mat)
+{
+    int n;
+
+    for (n = 0; n < 32; ++n)
+        sq[n] = gf2_times(mat, mat[n]);
+}
+
+/* As crc32_combine() in zlib: crc_a is advanced over len_b zero bytes by
+ * squaring the operator for one zero bit, then crc_b is added. */
+uint32_t
+sg_crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b)
+{
+    int n;
+    uint32_t row;
+    uint32_t even[32];          /* even power of 2 zero bits operator */
+    uint32_t odd[32];           /* odd power of 2 zero bits operator */
+
+    if (0 == len_b)
+        return crc_a;
+    odd[0] = SG_CRC32C_POLY;    /* operator for one zero bit */
+    for (n = 1, row = 1; n < 32; ++n, row <<= 1)
+        odd[n] = row;
+    gf2_square(even, odd);      /* two zero bits */
+    gf2_square(odd, even);      /* four zero bits */
+    do {                        /* first pass is for one zero byte */
+        gf2_square(even, odd);
+        if (len_b & 1)
+            crc_a = gf2_times(even, crc_a);
+        len_b >>= 1;
+        if (0 == len_b)
+            break;
+        gf2_square(odd, even);
+        if (len_b & 1)
+            crc_a = gf2_times(odd, crc_a);
+        len_b >>= 1;
+    } while (len_b);
+    return crc_a ^ crc_b;
+}
+
+static inline uint64_t
+xxh_rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+xxh_round(uint64_t acc, uint64_t in)
+{
+    acc += in * SG_XXH_P2;
+    return xxh_rotl(acc, 31) * SG_XXH_P1;
+}
+
+static inline uint64_t
+xxh_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh_round(0, val);
+    return acc * SG_XXH_P1 + SG_XXH_P4;
+}
+
+uint64_t
+sg_xxh64(const uint8_t * bp, uint64_t len, uint64_t seed)
+{
+    uint64_t h;
+    uint64_t rem = len;
+
+    if (rem >= 32) {
+        uint64_t v1 = seed + SG_XXH_P1 + SG_XXH_P2;
+        uint64_t v2 = seed + SG_XXH_P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - SG_XXH_P1;
+
+        for ( ; rem >= 32; rem -= 32, bp += 32) {
+            v1 = xxh_round(v1, sg_get_unaligned_le64(bp));
+            v2 = xxh_round(v2, sg_get_unaligned_le64(bp + 8));
+            v3 = xxh_round(v3, sg_get_unaligned_le64(bp + 16));
+            v4 = xxh_round(v4, sg_get_unaligned_le64(bp + 24));
+        }
+        h = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) + xxh_rotl(v3, 12) +
+            xxh_rotl(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    } else
+        h = seed + SG_XXH_P5;
+    h += len;
+    for ( ; rem >= 8; rem -= 8, bp += 8) {
+        h ^= xxh_round(0, sg_get_unaligned_le64(bp));
+        h = xxh_rotl(h, 27) * SG_XXH_P1 + SG_XXH_P4;
+    }
+    if (rem >= 4) {
+        h ^= (uint64_t)sg_get_unaligned_le32(bp) * SG_XXH_P1;
+        h = xxh_rotl(h, 23) * SG_XXH_P2 + SG_XXH_P3;
+        rem -= 4;
+        bp += 4;
+    }
+    for ( ; rem > 0; --rem) {
+        h ^= (*bp++) * SG_XXH_P5;
+        h = xxh_rotl(h, 11) * SG_XXH_P1;
+    }
+    h ^= h >> 33;
+    h *= SG_XXH_P2;
+    h ^= h >> 29;
+    h *= SG_XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+bool
+sg_hash_parse(const char * arg, int * algp, int * num_thrp)
+{
+    int n = SG_HASH_DEF_THR;
+    int len;
+    const char * cp;
+
+    cp = strchr(arg, ',');
+    len = cp ? (int)(cp - arg) : (int)strlen(arg);
+    if ((6 == len) && (0 == strncmp(arg, "crc32c", 6)))
+        *algp = SG_HASH_CRC32C;
+    else if ((5 == len) && (0 == strncmp(arg, "xxh64", 5)))
+        *algp = SG_HASH_XXH64;
+    else
+        return false;
+    if (cp) {
+        n = sg_get_num(cp + 1);
+        if ((n < 0) || (n > SG_HASH_MAX_THR))
+            return false;
+    }
+    *num_thrp = n;
+    return true;
+}
+
+static const char *
+hash_alg_name(int alg)
+{
+    return (SG_HASH_XXH64 == alg) ? "xxh64" : "crc32c";
+}
+
+static uint64_t
+hash_chunk(int alg, const uint8_t * bp, uint64_t len)
+{
+    if (SG_HASH_XXH64 == alg)
+        return sg_xxh64(bp, len, 0);
+    return sg_crc32c(0, bp, len);
+}
+
+/* Call holding the stage's ext_lock. Returns false if out of memory. */
+static bool
+hash_add_ext(struct sg_hash_stage * hsp, int64_t blk, int num_blks,
+             uint64_t hash)
+{
+    struct sg_hash_ext * ep;
+
+    if (hsp->num_ext >= hsp->ext_sz) {
+        int n = hsp->ext_sz ? (2 * hsp->ext_sz) : 1024;
+
+        ep = (struct sg_hash_ext *)realloc(hsp->ext_arr, n * sizeof(*ep));
+        if (NULL == ep)
+            return false;
+        hsp->ext_arr = ep;
+        hsp->ext_sz = n;
+    }
+    ep = hsp->ext_arr + hsp->num_ext++;
+    ep->blk = blk;
+    ep->num_blks = num_blks;
+    ep->hash = hash;
+    return true;
+}
+
+static int
+hash_event_seq(struct sg_hash_event * evp)
+{
+    return __atomic_load_n(&evp->seq, __ATOMIC_SEQ_CST);
+}
+
+/* Sleeps unless evp has been signalled since seq was read. Wakes up
+ * spuriously at times, so callers check again. */
+static void
+hash_event_wait(struct sg_hash_event * evp, int seq)
+{
+#if defined(SG_LIB_LINUX) && defined(SYS_futex)
+    __atomic_add_fetch(&evp->num_sleepers, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &evp->seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+    __atomic_sub_fetch(&evp->num_sleepers, 1, __ATOMIC_SEQ_CST);
+#else
+    struct timespec ts;
+
+    if (seq != hash_event_seq(evp))
+        return;
+    ts.tv_sec = 0;
+    ts.tv_nsec = SG_HASH_POLL_NS;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void
+hash_event_signal(struct sg_hash_event * evp)
+{
+    __atomic_add_fetch(&evp->seq, 1, __ATOMIC_SEQ_CST);
+#if defined(SG_LIB_LINUX) && defined(SYS_futex)
+    if (__atomic_load_n(&evp->num_sleepers, __ATOMIC_SEQ_CST) > 0)
+        syscall(SYS_futex, &evp->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL,
+                NULL, 0);
+#endif
+}
+
+static void
+hash_lock(struct sg_hash_stage * hsp)
+{
+    while (__atomic_test_and_set(&hsp->ext_lock, __ATOMIC_ACQUIRE))
+        sched_yield();
+}
+
+static void
+hash_unlock(struct sg_hash_stage * hsp)
+{
+    __atomic_clear(&hsp->ext_lock, __ATOMIC_RELEASE);
+}
+
+static void
+hash_record(struct sg_hash_stage * hsp, int64_t blk, int num_blks,
+            uint64_t h)
+{
+    bool ok;
+
+    hash_lock(hsp);
+    ok = hash_add_ext(hsp, blk, num_blks, h);
+    hash_unlock(hsp);
+    if (! ok)
+        pr2ws("%s: out of memory, extent at block %" PRId64 " lost\n",
+              __func__, blk);
+}
+
+/* Hashes slots that are ready, returns how many */
+static int
+hash_ready_slots(struct sg_hash_stage * hsp)
+{
+    int k, exp;
+    int n = 0;
+    uint64_t h;
+    struct sg_hash_slot * sp;
+
+    for (k = 0, sp = hsp->slot_arr; k < hsp->num_slots; ++k, ++sp) {
+        exp = SG_HASH_SLOT_READY;
+        if (! __atomic_compare_exchange_n(&sp->state, &exp,
+                                          SG_HASH_SLOT_BUSY, false,
+                                          __ATOMIC_ACQUIRE,
+                                          __ATOMIC_RELAXED))
+            continue;
+        h = hash_chunk(hsp->alg, sp->bp, (uint64_t)sp->num_blks * hsp->bs);
+        hash_record(hsp, sp->blk, sp->num_blks, h);
+        __atomic_store_n(&sp->state, SG_HASH_SLOT_FREE, __ATOMIC_RELEASE);
+        hash_event_signal(&hsp->free_ev);
+        ++n;
+    }
+    return n;
+}
+
+void *
+sg_hash_stage_worker(void * vp)
+{
+    bool stop;
+    int seq;
+    struct sg_hash_stage * hsp = (struct sg_hash_stage *)vp;
+
+    __atomic_add_fetch(&hsp->num_workers, 1, __ATOMIC_SEQ_CST);
+    while (true) {
+        /* submitters are done once stopping is seen, so after that a
+         * pass that finds nothing ready means there is nothing left */
+        seq = hash_event_seq(&hsp->ready_ev);
+        stop = __atomic_load_n(&hsp->stopping, __ATOMIC_ACQUIRE);
+        if (hash_ready_slots(hsp) > 0)
+            continue;
+        if (stop)
+            break;
+        hash_event_wait(&hsp->ready_ev, seq);
+    }
+    __atomic_sub_fetch(&hsp->num_workers, 1, __ATOMIC_SEQ_CST);
+    return NULL;
+}
+
+void
+sg_hash_stage_stop(struct sg_hash_stage * hsp)
+{
+    __atomic_store_n(&hsp->stopping, true, __ATOMIC_RELEASE);
+    hash_event_signal(&hsp->ready_ev);
+}
+
+struct sg_hash_stage *
+sg_hash_stage_create(int alg, int num_thr, int bs, int max_blks)
+{
+    int n;
+    struct sg_hash_stage * hsp;
+
+    hsp = (struct sg_hash_stage *)calloc(1, sizeof(*hsp));
+    if (NULL == hsp)
+        return NULL;
+    hsp->alg = alg;
+    hsp->bs = bs;
+    hsp->max_blks = max_blks;
+    if (SG_HASH_CRC32C == alg)
+        crc32c_tab_init();      /* before there are threads */
+    if (num_thr > 0) {
+        n = SG_HASH_SLOTS_PER_THR * num_thr;
+        hsp->slot_arr = (struct sg_hash_slot *)calloc(n,
+                                                      sizeof(*hsp->slot_arr));
+        if (NULL == hsp->slot_arr) {
+            free(hsp);
+            return NULL;
+        }
+        hsp->num_slots = n;
+    }
+    return hsp;
+}
+
+void
+sg_hash_stage_submit(struct sg_hash_stage * hsp, int64_t blk,
+                     const uint8_t * bp, int num_blks)
+{
+    int k, exp, seq;
+    struct sg_hash_slot * sp;
+
+    if ((num_blks <= 0) || (num_blks > hsp->max_blks))
+        return;
+    while (true) {
+        seq = hash_event_seq(&hsp->free_ev);
+        for (k = 0, sp = hsp->slot_arr; k < hsp->num_slots; ++k, ++sp) {
+            exp = SG_HASH_SLOT_FREE;
+            if (__atomic_compare_exchange_n(&sp->state, &exp,
+                                            SG_HASH_SLOT_FILL, false,
+                                            __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED)) {
+                __atomic_store_n(&sp->bp, bp, __ATOMIC_RELAXED);
+                sp->blk = blk;
+                sp->num_blks = num_blks;
+                __atomic_store_n(&sp->state, SG_HASH_SLOT_READY,
+                                 __ATOMIC_RELEASE);
+                hash_event_signal(&hsp->ready_ev);
+                return;
+            }
+        }
+        /* no slot (thr=0) or no worker running: hash it here */
+        if (0 == __atomic_load_n(&hsp->num_workers, __ATOMIC_SEQ_CST))
+            break;
+        hash_event_wait(&hsp->free_ev, seq);    /* until a slot is freed */
+    }
+    hash_record(hsp, blk, num_blks,
+                hash_chunk(hsp->alg, bp, (uint64_t)num_blks * hsp->bs));
+}
+
+void
+sg_hash_stage_wait(struct sg_hash_stage * hsp, const uint8_t * bp)
+{
+    bool pending;
+    int k, seq;
+    struct sg_hash_slot * sp;
+
+    if (NULL == hsp)
+        return;
+    while (true) {
+        seq = hash_event_seq(&hsp->free_ev);
+        pending = false;
+        for (k = 0, sp = hsp->slot_arr; k < hsp->num_slots; ++k, ++sp) {
+            if ((SG_HASH_SLOT_FREE != __atomic_load_n(&sp->state,
+                                                      __ATOMIC_ACQUIRE)) &&
+                ((NULL == bp) ||
+                 (bp == __atomic_load_n(&sp->bp, __ATOMIC_RELAXED)))) {
+                pending = true;
+                break;
+            }
+        }
+        if (! pending)
+            return;
+        if (0 == __atomic_load_n(&hsp->num_workers, __ATOMIC_SEQ_CST))
+            hash_ready_slots(hsp);      /* nobody else will */
+        else
+            hash_event_wait(&hsp->free_ev, seq);
+    }
+}
+
+static int
+ext_cmp(const void * a, const void * b)
+{
+    const struct sg_hash_ext * ap = (const struct sg_hash_ext *)a;
+    const struct sg_hash_ext * bp = (const struct sg_hash_ext *)b;
+
+    return (ap->blk < bp->blk) ? -1 : (ap->blk > bp->blk);
+}
+
+/* Places the hash of the whole stream from the extents, in block order,
+ * in *hp. For XXH64 that depends on how the stream was cut into extents.
+ * Returns 0 or an SG_LIB_* error. */
+static int
+stream_hash(int alg, int bs, const struct sg_hash_ext * arr, int num,
+            uint64_t * hp)
+{
+    int k;
+    uint64_t h = 0;
+    uint8_t * bp;
+
+    if (SG_HASH_CRC32C == alg) {
+        for (k = 0; k < num; ++k)
+            h = sg_crc32c_combine((uint32_t)h, (uint32_t)arr[k].hash,
+                                  (uint64_t)arr[k].num_blks * bs);
+        *hp = h;
+        return 0;
+    }
+    bp = (uint8_t *)malloc(8 * (size_t)(num + 1));
+    if (NULL == bp) {
+        pr2ws("%s: out of memory\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < num; ++k)
+        sg_put_unaligned_le64(arr[k].hash, bp + (8 * k));
+    *hp = sg_xxh64(bp, 8 * (uint64_t)num, 0);
+    free(bp);
+    return 0;
+}
+
+static int
+hash_write_manifest(const struct sg_hash_stage * hsp, const char * fn,
+                    uint64_t stream, int64_t blocks)
+{
+    int k, w;
+    FILE * fp;
+    const struct sg_hash_ext * ep;
+
+    fp = fopen(fn, "w");
+    if (NULL == fp) {
+        pr2ws("unable to open manifest %s: %s\n", fn, safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    w = (SG_HASH_XXH64 == hsp->alg) ? 16 : 8;
+    fprintf(fp, "# sg3_utils hash manifest, one extent per line:\n"
+            "# <start block> <number of blocks> <hash in hex>\n");
+    fprintf(fp, "alg=%s bs=%d extents=%d\n", hash_alg_name(hsp->alg),
+            hsp->bs, hsp->num_ext);
+    for (k = 0, ep = hsp->ext_arr; k < hsp->num_ext; ++k, ++ep)
+        fprintf(fp, "%" PRId64 " %d %0*" PRIx64 "\n", ep->blk, ep->num_blks,
+                w, ep->hash);
+    fprintf(fp, "stream=%0*" PRIx64 " blocks=%" PRId64 "\n", w, stream,
+            blocks);
+    if (fclose(fp)) {
+        pr2ws("error writing manifest %s: %s\n", fn, safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    return 0;
+}
+
+static int
+hash_verify(const struct sg_hash_stage * hsp, const char * fn,
+            uint64_t stream, int64_t blocks, int vb)
+{
+    bool got_stream = false;
+    bool cmp_stream;
+    int k, j, n, num_bad, num_ok, num_odd;
+    int bs = 0;
+    int num = 0;
+    int sz = 0;
+    int res = 0;
+    int64_t m_blocks = -1;
+    uint64_t m_stream = 0;
+    FILE * fp;
+    struct sg_hash_ext * arr = NULL;
+    struct sg_hash_ext * ep;
+    const struct sg_hash_ext * cp;
+    char alg_s[32] = "";
+    char b[256];
+
+    fp = fopen(fn, "r");
+    if (NULL == fp) {
+        pr2ws("unable to open manifest %s: %s\n", fn, safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    while (fgets(b, sizeof(b), fp)) {
+        if (('#' == b[0]) || ('\n' == b[0]))
+            continue;
+        if (0 == strncmp(b, "alg=", 4)) {
+            if ((2 != sscanf(b, "alg=%31s bs=%d", alg_s, &bs)) ||
+                strcmp(alg_s, hash_alg_name(hsp->alg)) || (bs != hsp->bs)) {
+                pr2ws("manifest %s is for alg=%s bs=%d, so use hash=%s "
+                      "and bs=%d\n", fn, alg_s, bs, alg_s, bs);
+                res = SG_LIB_SYNTAX_ERROR;
+                goto fini;
+            }
+        } else if (0 == strncmp(b, "stream=", 7)) {
+            if (2 != sscanf(b, "stream=%" SCNx64 " blocks=%" SCNd64,
+                            &m_stream, &m_blocks))
+                goto bad_line;
+            got_stream = true;
+        } else {
+            if (num >= sz) {
+                sz = sz ? (2 * sz) : 1024;
+                ep = (struct sg_hash_ext *)realloc(arr, sz * sizeof(*ep));
+                if (NULL == ep) {
+                    res = sg_convert_errno(ENOMEM);
+                    goto fini;
+                }
+                arr = ep;
+            }
+            ep = arr + num;
+            if (3 != sscanf(b, "%" SCNd64 " %d %" SCNx64, &ep->blk,
+                            &ep->num_blks, &ep->hash))
+                goto bad_line;
+            ++num;
+        }
+    }
+    if (! got_stream) {
+        pr2ws("manifest %s is truncated\n", fn);
+        res = SG_LIB_FILE_ERROR;
+        goto fini;
+    }
+    qsort(arr, num, sizeof(*arr), ext_cmp);
+    /* merge the (block ordered) extents of the manifest and of this copy */
+    num_bad = 0;
+    num_ok = 0;
+    num_odd = 0;
+    for (k = 0, j = 0, cp = hsp->ext_arr; (k < num) || (j < hsp->num_ext); ) {
+        if ((k < num) && (j < hsp->num_ext) && (arr[k].blk == cp[j].blk)) {
+            if (arr[k].num_blks != cp[j].num_blks)
+                num_odd += 2;
+            else if (arr[k].hash == cp[j].hash)
+                ++num_ok;
+            else {
+                if (num_bad < SG_HASH_MAX_REPORT)
+                    pr2ws("  miscompare: extent at block %" PRId64 ", %d "
+                          "blocks\n", cp[j].blk, cp[j].num_blks);
+                ++num_bad;
+            }
+            ++k;
+            ++j;
+        } else if ((j >= hsp->num_ext) ||
+                   ((k < num) && (arr[k].blk < cp[j].blk))) {
+            ++num_odd;          /* only in the manifest */
+            ++k;
+        } else {
+            ++num_odd;          /* only in this copy */
+            ++j;
+        }
+    }
+    /* the XXH64 stream hash is over the extent hashes so it can only be
+     * compared when the extents line up */
+    cmp_stream = (SG_HASH_XXH64 != hsp->alg) || (0 == num_odd);
+    n = ((m_blocks == blocks) && ((! cmp_stream) || (m_stream == stream)));
+    pr2ws(">> verify against %s: %d extents match, %d miscompare", fn,
+          num_ok, num_bad);
+    if (num_odd > 0)
+        pr2ws(", %d not in both", num_odd);
+    if (cmp_stream)
+        pr2ws("; stream %s\n", n ? "matches" : "differs");
+    else
+        pr2ws("; stream can not be compared%s\n",
+              n ? "" : ", number of blocks differs");
+    if ((num_odd > 0) && (0 == num_bad) && ((! n) || (! cmp_stream)))
+        pr2ws("  extents do not line up, give the BPT (and SKIP) the "
+              "manifest was made\n  with\n");
+    if (vb && (! n))
+        pr2ws("  manifest: %" PRId64 " blocks, this copy: %" PRId64
+              " blocks\n", m_blocks, blocks);
+    if ((num_bad > 0) || (! n))
+        res = SG_LIB_CAT_MISCOMPARE;
+    goto fini;
+bad_line:
+    pr2ws("manifest %s: unable to decode line: %s", fn, b);
+    res = SG_LIB_SYNTAX_ERROR;
+fini:
+    fclose(fp);
+    free(arr);
+    return res;
+}
+
+int
+sg_hash_stage_finish(struct sg_hash_stage * hsp, const char * manifest_fn,
+                     const char * verify_fn, int vb)
+{
+    int k, res, ret;
+    int64_t blocks = 0;
+    uint64_t stream = 0;
+
+    hash_ready_slots(hsp);      /* any left, e.g. when no workers ran */
+    qsort(hsp->ext_arr, hsp->num_ext, sizeof(*hsp->ext_arr), ext_cmp);
+    for (k = 0; k < hsp->num_ext; ++k)
+        blocks += hsp->ext_arr[k].num_blks;
+    ret = stream_hash(hsp->alg, hsp->bs, hsp->ext_arr, hsp->num_ext,
+                      &stream);
+    if (ret)
+        return ret;
+    pr2ws(">> %s of %" PRId64 " blocks in %d extents: %0*" PRIx64 "\n",
+          hash_alg_name(hsp->alg), blocks, hsp->num_ext,
+          (SG_HASH_XXH64 == hsp->alg) ? 16 : 8, stream);
+    if (manifest_fn) {
+        res = hash_write_manifest(hsp, manifest_fn, stream, blocks);
+        if (res)
+            ret = res;
+        else if (vb)
+            pr2ws("  extent hashes written to %s\n", manifest_fn);
+    }
+    if (verify_fn) {
+        res = hash_verify(hsp, verify_fn, stream, blocks, vb);
+        if (res && (0 == ret))
+            ret = res;
+    }
+    return ret;
+}
+
+void
+sg_hash_stage_destroy(struct sg_hash_stage * hsp)
+{
+    if (NULL == hsp)
+        return;
+    free(hsp->slot_arr);
+    free(hsp->ext_arr);
+    free(hsp);
+}
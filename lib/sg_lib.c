@@ -37,6 +37,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <errno.h>
@@ -49,6 +50,10 @@
 #include "config.h"
 #endif
 
+#ifndef SG_LIB_WIN32
+#include <sys/mman.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_lib_data.h"
 #include "sg_unaligned.h"
@@ -70,7 +75,8 @@ pr2ws(const char * fmt, ...)
     int n;
 
     va_start(args, fmt);
-    n = vfprintf(sg_warnings_strm ? sg_warnings_strm : stderr, fmt, args);
+    /* queued on this thread's log ring if sg_log_ring_start() called */
+    n = sg_log_vpr(sg_warnings_strm ? sg_warnings_strm : stderr, fmt, args);
     va_end(args);
     return n;
 }
@@ -121,6 +127,54 @@ sg_get_initial_dsense(void)
     return false;
 }
 
+/* States of the lookup indexes over the tables in sg_lib_data.c . Each
+ * index is built once, on first use, by whichever caller gets there first.
+ * An index that finds its table not laid out as expected is not used. */
+#define SG_LIB_IND_NONE 0
+#define SG_LIB_IND_BUSY 1
+#define SG_LIB_IND_READY 2
+#define SG_LIB_IND_UNUSABLE 3
+
+/* Returns true when the index whose state is '*statep' may be used,
+ * calling 'build_fn' to build it if this is the first call. A concurrent
+ * caller gets false while the index is being built and should scan the
+ * table itself. */
+static bool
+lib_ind_ready(int * statep, bool (*build_fn)(void))
+{
+    int state = __atomic_load_n(statep, __ATOMIC_ACQUIRE);
+
+    if (SG_LIB_IND_BUSY == state)
+        return false;
+    if (SG_LIB_IND_NONE == state) {
+        if (! __atomic_compare_exchange_n(statep, &state, SG_LIB_IND_BUSY,
+                                          false, __ATOMIC_ACQUIRE,
+                                          __ATOMIC_ACQUIRE))
+            return (SG_LIB_IND_READY == state);
+        state = build_fn() ? SG_LIB_IND_READY : SG_LIB_IND_UNUSABLE;
+        __atomic_store_n(statep, state, __ATOMIC_RELEASE);
+    }
+    return (SG_LIB_IND_READY == state);
+}
+
+/* 'vp' is the first element in its array whose value is 'value'. Entries
+   with the same 'value' are adjacent; yields the one matching 'peri_type',
+   or 'vp' if none match. */
+static const struct sg_lib_value_name_t *
+get_value_name_pdt(const struct sg_lib_value_name_t * vp, int value,
+                   int peri_type)
+{
+    const struct sg_lib_value_name_t * holdp = vp;
+
+    if (peri_type < 0)
+        peri_type = 0;
+    for (; vp->name && (value == vp->value); ++vp) {
+        if (peri_type == vp->peri_dev_type)
+            return vp;
+    }
+    return holdp;
+}
+
 /* Searches 'arr' for match on 'value' then 'peri_type'. If matches
    'value' but not 'peri_type' then yields first 'value' match entry.
    Last element of 'arr' has NULL 'name'. If no match returns NULL. */
@@ -129,22 +183,10 @@ get_value_name(const struct sg_lib_value_name_t * arr, int value,
                int peri_type)
 {
     const struct sg_lib_value_name_t * vp = arr;
-    const struct sg_lib_value_name_t * holdp;
 
-    if (peri_type < 0)
-        peri_type = 0;
     for (; vp->name; ++vp) {
-        if (value == vp->value) {
-            if (peri_type == vp->peri_dev_type)
-                return vp;
-            holdp = vp;
-            while ((vp + 1)->name && (value == (vp + 1)->value)) {
-                ++vp;
-                if (peri_type == vp->peri_dev_type)
-                    return vp;
-            }
-            return holdp;
-        }
+        if (value == vp->value)
+            return get_value_name_pdt(vp, value, peri_type);
     }
     return NULL;
 }
@@ -260,51 +302,113 @@ sg_get_sense_key_str(int sense_key, int buff_len, char * buff)
     return buff;
 }
 
+/* Index over sg_lib_asc_ascq_range[] and sg_lib_asc_ascq[], built once on
+ * first use. Entries for a given asc lie in [asc_ind[asc], asc_ind[asc + 1])
+ * of sg_lib_asc_ascq[] (sorted by ascq within that span) and likewise
+ * rng_ind[] for sg_lib_asc_ascq_range[]. If the tables are found not to be
+ * sorted, the index is not used and the tables are scanned. */
+static uint16_t asc_ind[257];
+static uint16_t rng_ind[257];
+static int asc_ind_state = SG_LIB_IND_NONE;
+
+static bool
+asc_ascq_ind_build(void)
+{
+    int k, a, key;
+    int prev = -1;
+    const struct sg_lib_asc_ascq_t * eip;
+    const struct sg_lib_asc_ascq_range_t * ei2p;
+
+    for (k = 0, a = 0; sg_lib_asc_ascq_range[k].text; ++k) {
+        ei2p = &sg_lib_asc_ascq_range[k];
+        key = (ei2p->asc << 8) | ei2p->ascq_min;
+        if ((key <= prev) || (ei2p->ascq_max < ei2p->ascq_min))
+            return false;
+        prev = (ei2p->asc << 8) | ei2p->ascq_max;
+        for ( ; a <= ei2p->asc; ++a)
+            rng_ind[a] = k;
+    }
+    for ( ; a <= 256; ++a)
+        rng_ind[a] = k;
+    prev = -1;
+    for (k = 0, a = 0; sg_lib_asc_ascq[k].text; ++k) {
+        eip = &sg_lib_asc_ascq[k];
+        key = (eip->asc << 8) | eip->ascq;
+        if ((key <= prev) || (k > UINT16_MAX))
+            return false;
+        prev = key;
+        for ( ; a <= eip->asc; ++a)
+            asc_ind[a] = k;
+    }
+    for ( ; a <= 256; ++a)
+        asc_ind[a] = k;
+    return true;
+}
+
 /* Yield string associated with ASC/ASCQ values. Returns 'buff'. */
 char *
 sg_get_asc_ascq_str(int asc, int ascq, int buff_len, char * buff)
 {
-    int k, num, rlen;
-    bool found = false;
-    struct sg_lib_asc_ascq_t * eip;
-    struct sg_lib_asc_ascq_range_t * ei2p;
+    int k, num, rlen, lo, hi, mid;
+    const struct sg_lib_asc_ascq_t * eip = NULL;
+    const struct sg_lib_asc_ascq_range_t * ei2p = NULL;
 
     if (1 == buff_len) {
         buff[0] = '\0';
         return buff;
     }
-    for (k = 0; sg_lib_asc_ascq_range[k].text; ++k) {
-        ei2p = &sg_lib_asc_ascq_range[k];
-        if ((ei2p->asc == asc) &&
-            (ascq >= ei2p->ascq_min)  &&
-            (ascq <= ei2p->ascq_max)) {
-            found = true;
-            num = sg_scnpr(buff, buff_len, "Additional sense: ");
-            rlen = buff_len - num;
-            sg_scnpr(buff + num, ((rlen > 0) ? rlen : 0), ei2p->text, ascq);
+    if ((asc >= 0) && (asc < 256) &&
+        lib_ind_ready(&asc_ind_state, asc_ascq_ind_build)) {
+        for (k = rng_ind[asc]; k < rng_ind[asc + 1]; ++k) {
+            if ((ascq >= sg_lib_asc_ascq_range[k].ascq_min) &&
+                (ascq <= sg_lib_asc_ascq_range[k].ascq_max)) {
+                ei2p = &sg_lib_asc_ascq_range[k];
+                break;
+            }
+        }
+        if (NULL == ei2p) {
+            for (lo = asc_ind[asc], hi = asc_ind[asc + 1]; lo < hi; ) {
+                mid = (lo + hi) / 2;
+                if (sg_lib_asc_ascq[mid].ascq == ascq) {
+                    eip = &sg_lib_asc_ascq[mid];
+                    break;
+                } else if (sg_lib_asc_ascq[mid].ascq < ascq)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+        }
+    } else {
+        for (k = 0; sg_lib_asc_ascq_range[k].text; ++k) {
+            if ((sg_lib_asc_ascq_range[k].asc == asc) &&
+                (ascq >= sg_lib_asc_ascq_range[k].ascq_min) &&
+                (ascq <= sg_lib_asc_ascq_range[k].ascq_max)) {
+                ei2p = &sg_lib_asc_ascq_range[k];
+                break;
+            }
+        }
+        for (k = 0; (NULL == ei2p) && sg_lib_asc_ascq[k].text; ++k) {
+            if ((sg_lib_asc_ascq[k].asc == asc) &&
+                (sg_lib_asc_ascq[k].ascq == ascq)) {
+                eip = &sg_lib_asc_ascq[k];
+                break;
+            }
         }
     }
-    if (found)
-        return buff;
-
-    for (k = 0; sg_lib_asc_ascq[k].text; ++k) {
-        eip = &sg_lib_asc_ascq[k];
-        if (eip->asc == asc &&
-            eip->ascq == ascq) {
-            found = true;
-            sg_scnpr(buff, buff_len, "Additional sense: %s", eip->text);
-        }
-    }
-    if (! found) {
-        if (asc >= 0x80)
-            sg_scnpr(buff, buff_len, "vendor specific ASC=%02x, ASCQ=%02x "
-                     "(hex)", asc, ascq);
-        else if (ascq >= 0x80)
-            sg_scnpr(buff, buff_len, "ASC=%02x, vendor specific qualification "
-                     "ASCQ=%02x (hex)", asc, ascq);
-        else
-            sg_scnpr(buff, buff_len, "ASC=%02x, ASCQ=%02x (hex)", asc, ascq);
-    }
+    if (ei2p) {
+        num = sg_scnpr(buff, buff_len, "Additional sense: ");
+        rlen = buff_len - num;
+        sg_scnpr(buff + num, ((rlen > 0) ? rlen : 0), ei2p->text, ascq);
+    } else if (eip)
+        sg_scnpr(buff, buff_len, "Additional sense: %s", eip->text);
+    else if (asc >= 0x80)
+        sg_scnpr(buff, buff_len, "vendor specific ASC=%02x, ASCQ=%02x "
+                 "(hex)", asc, ascq);
+    else if (ascq >= 0x80)
+        sg_scnpr(buff, buff_len, "ASC=%02x, vendor specific qualification "
+                 "ASCQ=%02x (hex)", asc, ascq);
+    else
+        sg_scnpr(buff, buff_len, "ASC=%02x, ASCQ=%02x (hex)", asc, ascq);
     return buff;
 }
 
@@ -2105,54 +2209,228 @@ sg_scsi_normalize_sense(const uint8_t * sbp, int sb_len,
 
 /* Returns a SG_LIB_CAT_* value. If cannot decode sense buffer (sbp) or a
  * less common sense key then return SG_LIB_CAT_SENSE .*/
+static int
+sense_hdr_category(const struct sg_scsi_sense_hdr * sshp)
+{
+    switch (sshp->sense_key) {          /* 0 to 0x1f */
+    case SPC_SK_NO_SENSE:
+        return SG_LIB_CAT_NO_SENSE;
+    case SPC_SK_RECOVERED_ERROR:
+        return SG_LIB_CAT_RECOVERED;
+    case SPC_SK_NOT_READY:
+        return SG_LIB_CAT_NOT_READY;
+    case SPC_SK_MEDIUM_ERROR:
+    case SPC_SK_HARDWARE_ERROR:
+    case SPC_SK_BLANK_CHECK:
+        return SG_LIB_CAT_MEDIUM_HARD;
+    case SPC_SK_UNIT_ATTENTION:
+        return SG_LIB_CAT_UNIT_ATTENTION;
+        /* used to return SG_LIB_CAT_MEDIA_CHANGED when sshp->asc==0x28 */
+    case SPC_SK_ILLEGAL_REQUEST:
+        if ((0x20 == sshp->asc) && (0x0 == sshp->ascq))
+            return SG_LIB_CAT_INVALID_OP;
+        else if ((0x21 == sshp->asc) && (0x0 == sshp->ascq))
+            return SG_LIB_LBA_OUT_OF_RANGE;
+        else
+            return SG_LIB_CAT_ILLEGAL_REQ;
+        break;
+    case SPC_SK_ABORTED_COMMAND:
+        if (0x10 == sshp->asc)
+            return SG_LIB_CAT_PROTECTION;
+        else
+            return SG_LIB_CAT_ABORTED_COMMAND;
+    case SPC_SK_MISCOMPARE:
+        return SG_LIB_CAT_MISCOMPARE;
+    case SPC_SK_DATA_PROTECT:
+        return SG_LIB_CAT_DATA_PROTECT;
+    case SPC_SK_COPY_ABORTED:
+        return SG_LIB_CAT_COPY_ABORTED;
+    case SPC_SK_COMPLETED:
+    case SPC_SK_VOLUME_OVERFLOW:
+        return SG_LIB_CAT_SENSE;
+    default:
+        ;   /* reserved and vendor specific sense keys fall through */
+    }
+    return SG_LIB_CAT_SENSE;
+}
+
 int
 sg_err_category_sense(const uint8_t * sbp, int sb_len)
 {
     struct sg_scsi_sense_hdr ssh;
 
     if ((sbp && (sb_len > 2)) &&
-        (sg_scsi_normalize_sense(sbp, sb_len, &ssh))) {
-        switch (ssh.sense_key) {        /* 0 to 0x1f */
-        case SPC_SK_NO_SENSE:
-            return SG_LIB_CAT_NO_SENSE;
-        case SPC_SK_RECOVERED_ERROR:
-            return SG_LIB_CAT_RECOVERED;
-        case SPC_SK_NOT_READY:
-            return SG_LIB_CAT_NOT_READY;
-        case SPC_SK_MEDIUM_ERROR:
-        case SPC_SK_HARDWARE_ERROR:
-        case SPC_SK_BLANK_CHECK:
-            return SG_LIB_CAT_MEDIUM_HARD;
-        case SPC_SK_UNIT_ATTENTION:
-            return SG_LIB_CAT_UNIT_ATTENTION;
-            /* used to return SG_LIB_CAT_MEDIA_CHANGED when ssh.asc==0x28 */
-        case SPC_SK_ILLEGAL_REQUEST:
-            if ((0x20 == ssh.asc) && (0x0 == ssh.ascq))
-                return SG_LIB_CAT_INVALID_OP;
-            else if ((0x21 == ssh.asc) && (0x0 == ssh.ascq))
-                return SG_LIB_LBA_OUT_OF_RANGE;
-            else
-                return SG_LIB_CAT_ILLEGAL_REQ;
+        (sg_scsi_normalize_sense(sbp, sb_len, &ssh)))
+        return sense_hdr_category(&ssh);
+    return SG_LIB_CAT_SENSE;
+}
+
+/* Only the first descriptor of each type is used, as with
+ * sg_scsi_sense_desc_find() which this loop follows. */
+static void
+decode_sense_descs(const uint8_t * sbp, int sb_len,
+                   struct sg_sense_fields * sfp)
+{
+    bool seen[0x10];
+    int add_sb_len, add_d_len, desc_len, k;
+    const uint8_t * bp;
+
+    if ((sb_len < 8) || (0 == (add_sb_len = sbp[7])))
+        return;
+    memset(seen, 0, sizeof(seen));
+    add_sb_len = (add_sb_len < (sb_len - 8)) ?  add_sb_len : (sb_len - 8);
+    bp = sbp + 8;
+    for (desc_len = 0, k = 0; k < add_sb_len; k += desc_len) {
+        bp += desc_len;
+        add_d_len = (k < (add_sb_len - 1)) ? bp[1] : -1;
+        desc_len = add_d_len + 2;
+        if (sfp->num_desc < SG_SENSE_DESC_MAX)
+            sfp->desc_off[sfp->num_desc++] = (uint8_t)(bp - sbp);
+        if ((bp[0] < 0x10) && (! seen[bp[0]])) {
+            seen[bp[0]] = true;
+            switch (bp[0]) {
+            case 0:     /* information */
+                if (0xa == add_d_len) {
+                    sfp->info = sg_get_unaligned_be64(bp + 4);
+                    sfp->info_valid = !!(bp[2] & 0x80);
+                }
+                break;
+            case 1:     /* command specific information */
+                if (0xa == add_d_len) {
+                    sfp->cmd_spec = sg_get_unaligned_be64(bp + 4);
+                    sfp->has_cmd_spec = true;
+                }
+                break;
+            case 2:     /* sense key specific */
+                if ((0x6 == add_d_len) && (0x80 & bp[4])) {
+                    sfp->sksv = true;
+                    memcpy(sfp->sks, bp + 4, 3);
+                    if ((SPC_SK_NO_SENSE == sfp->ssh.sense_key) ||
+                        (SPC_SK_NOT_READY == sfp->ssh.sense_key)) {
+                        sfp->progress = sg_get_unaligned_be16(bp + 5);
+                        sfp->has_progress = true;
+                    }
+                }
+                break;
+            case 4:     /* stream commands */
+                if ((add_d_len >= 2) && (bp[3] & 0xe0)) {
+                    sfp->has_fm_eom_ili = true;
+                    sfp->filemark = !!(bp[3] & 0x80);
+                    sfp->eom = !!(bp[3] & 0x40);
+                    sfp->ili = !!(bp[3] & 0x20);
+                }
+                break;
+            case 0xa:   /* another progress indication */
+                if ((0x6 == add_d_len) && (! sfp->has_progress)) {
+                    sfp->progress = sg_get_unaligned_be16(bp + 6);
+                    sfp->has_progress = true;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        if (add_d_len < 0) /* short descriptor ?? */
+            break;
+    }
+}
+
+int
+sg_decode_sense(const uint8_t * sbp, int sb_len,
+                struct sg_sense_fields * sfp)
+{
+    int sk;
+
+    memset(sfp, 0, sizeof(*sfp));
+    if ((NULL == sbp) || (sb_len < 3) ||
+        (! sg_scsi_normalize_sense(sbp, sb_len, &sfp->ssh))) {
+        sfp->category = SG_LIB_CAT_SENSE;
+        return sfp->category;
+    }
+    sfp->category = sense_hdr_category(&sfp->ssh);
+    if (sb_len < 7)
+        return sfp->category;
+    sk = sfp->ssh.sense_key;
+    if (sfp->ssh.response_code >= 0x72) {
+        sfp->descriptor = true;
+        /* sg_scsi_sense_desc_find() doesn't strip the deferred bit */
+        if (sbp[0] <= 0x73)
+            decode_sense_descs(sbp, sb_len, sfp);
+        return sfp->category;
+    }
+    sfp->info = sg_get_unaligned_be32(sbp + 3);
+    sfp->info_valid = !!(sbp[0] & 0x80);
+    if (sb_len > 11) {
+        sfp->cmd_spec = sg_get_unaligned_be32(sbp + 8);
+        sfp->has_cmd_spec = true;
+    }
+    if (sbp[2] & 0xe0) {
+        sfp->has_fm_eom_ili = true;
+        sfp->filemark = !!(sbp[2] & 0x80);
+        sfp->eom = !!(sbp[2] & 0x40);
+        sfp->ili = !!(sbp[2] & 0x20);
+    }
+    if ((sb_len > 17) && (sbp[15] & 0x80)) {
+        sfp->sksv = true;
+        memcpy(sfp->sks, sbp + 15, 3);
+        if ((SPC_SK_NO_SENSE == sk) || (SPC_SK_NOT_READY == sk)) {
+            sfp->progress = sg_get_unaligned_be16(sbp + 16);
+            sfp->has_progress = true;
+        }
+    }
+    return sfp->category;
+}
+
+int
+sg_decode_sense_vec(struct sg_sense_compl * arr, int num)
+{
+    int k, cat;
+    int n = 0;
+    struct sg_sense_compl * cp;
+
+    for (k = 0, cp = arr; k < num; ++k, ++cp) {
+        switch (cp->scsi_status) {
+        case SAM_STAT_GOOD:
+            memset(&cp->sf, 0, sizeof(cp->sf));
+            cat = SG_LIB_CAT_CLEAN;
+            break;
+        case SAM_STAT_CHECK_CONDITION:
+        case SAM_STAT_COMMAND_TERMINATED:
+            cat = sg_decode_sense(cp->sensep, cp->sb_len, &cp->sf);
             break;
-        case SPC_SK_ABORTED_COMMAND:
-            if (0x10 == ssh.asc)
-                return SG_LIB_CAT_PROTECTION;
-            else
-                return SG_LIB_CAT_ABORTED_COMMAND;
-        case SPC_SK_MISCOMPARE:
-            return SG_LIB_CAT_MISCOMPARE;
-        case SPC_SK_DATA_PROTECT:
-            return SG_LIB_CAT_DATA_PROTECT;
-        case SPC_SK_COPY_ABORTED:
-            return SG_LIB_CAT_COPY_ABORTED;
-        case SPC_SK_COMPLETED:
-        case SPC_SK_VOLUME_OVERFLOW:
-            return SG_LIB_CAT_SENSE;
         default:
-            ;   /* reserved and vendor specific sense keys fall through */
+            memset(&cp->sf, 0, sizeof(cp->sf));
+            switch (cp->scsi_status) {
+            case SAM_STAT_CONDITION_MET:
+                cat = SG_LIB_CAT_CONDITION_MET;
+                break;
+            case SAM_STAT_BUSY:
+                cat = SG_LIB_CAT_BUSY;
+                break;
+            case SAM_STAT_RESERVATION_CONFLICT:
+                cat = SG_LIB_CAT_RES_CONFLICT;
+                break;
+            case SAM_STAT_TASK_SET_FULL:
+                cat = SG_LIB_CAT_TS_FULL;
+                break;
+            case SAM_STAT_ACA_ACTIVE:
+                cat = SG_LIB_CAT_ACA_ACTIVE;
+                break;
+            case SAM_STAT_TASK_ABORTED:
+                cat = SG_LIB_CAT_TASK_ABORTED;
+                break;
+            default:
+                cat = SG_LIB_CAT_OTHER;
+                break;
+            }
+            break;
         }
+        cp->sf.category = cat;
+        if ((SG_LIB_CAT_CLEAN != cat) && (SG_LIB_CAT_RECOVERED != cat) &&
+            (SG_LIB_CAT_CONDITION_MET != cat))
+            ++n;
     }
-    return SG_LIB_CAT_SENSE;
+    return n;
 }
 
 /* Beware: gives wrong answer for variable length command (opcode=0x7f) */
@@ -2227,11 +2505,103 @@ static struct op_code2sa_t op_code2sa_arr[] = {
     {0xffff, -1, NULL, NULL},
 };
 
+/* Index over sg_lib_normal_opcodes[] and op_code2sa_arr[] (with its service
+ * action arrays), built once on first use. op_ind[opcode] is the first
+ * entry in sg_lib_normal_opcodes[] with that opcode (or OP_IND_NONE);
+ * op2sa_ind[opcode] is the entry in op_code2sa_arr[] (or -1). For the k-th
+ * entry of op_code2sa_arr[], sa_ind[] from sa_span[k].start holds, sorted
+ * by service action, the first entry in its 'arr' for each service
+ * action. */
+#define OP_IND_NONE 0xffff
+#define SA_IND_MAX 512
+
+struct sa_span_t {
+    uint16_t start;     /* into sa_ind[] */
+    uint16_t num;
+};
+
+static uint16_t op_ind[256];
+static int8_t op2sa_ind[256];
+static struct sa_span_t sa_span[SG_ARRAY_SIZE(op_code2sa_arr)];
+static uint16_t sa_ind[SA_IND_MAX];
+static int op_ind_state = SG_LIB_IND_NONE;
+
+static bool
+op_ind_build(void)
+{
+    int k, j, m, n, v;
+    int num_sa = 0;
+    const struct sg_lib_value_name_t * arr;
+
+    for (k = 0; k < 256; ++k) {
+        op_ind[k] = OP_IND_NONE;
+        op2sa_ind[k] = -1;
+    }
+    for (k = 0; sg_lib_normal_opcodes[k].name; ++k) {
+        v = sg_lib_normal_opcodes[k].value;
+        if ((v < 0) || (v > 255) || (k >= OP_IND_NONE))
+            return false;
+        if (OP_IND_NONE == op_ind[v])
+            op_ind[v] = k;
+    }
+    for (k = 0; op_code2sa_arr[k].arr; ++k) {
+        v = op_code2sa_arr[k].op_code;
+        if ((v < 0) || (v > 255) || (k > INT8_MAX))
+            return false;
+        if (op2sa_ind[v] < 0)
+            op2sa_ind[v] = k;
+        arr = op_code2sa_arr[k].arr;
+        /* insertion sort, keeping only the first entry for each value */
+        for (j = 0, n = 0; arr[j].name; ++j) {
+            for (m = n; (m > 0) &&
+                 (arr[sa_ind[num_sa + m - 1]].value > arr[j].value); --m)
+                ;
+            if ((m > 0) && (arr[sa_ind[num_sa + m - 1]].value == arr[j].value))
+                continue;
+            if ((num_sa + n >= SA_IND_MAX) || (j > UINT16_MAX))
+                return false;
+            memmove(sa_ind + num_sa + m + 1, sa_ind + num_sa + m,
+                    (n - m) * sizeof(sa_ind[0]));
+            sa_ind[num_sa + m] = j;
+            ++n;
+        }
+        sa_span[k].start = num_sa;
+        sa_span[k].num = n;
+        num_sa += n;
+    }
+    return true;
+}
+
+/* Binary search of the service action array of op_code2sa_arr[k], needs
+ * op_ind_build() to have succeeded. */
+static const struct sg_lib_value_name_t *
+get_sa_value_name(int k, int service_action, int peri_type)
+{
+    int lo = sa_span[k].start;
+    int hi = lo + sa_span[k].num;
+    int mid;
+    const struct sg_lib_value_name_t * vp;
+    const struct sg_lib_value_name_t * arr = op_code2sa_arr[k].arr;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        vp = arr + sa_ind[mid];
+        if (vp->value == service_action)
+            return get_value_name_pdt(vp, service_action, peri_type);
+        else if (vp->value < service_action)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
 void
 sg_get_opcode_sa_name(uint8_t cmd_byte0, int service_action,
                       int peri_type, int buff_len, char * buff)
 {
-    int d_pdt;
+    bool indexed;
+    int d_pdt, k;
     const struct sg_lib_value_name_t * vnp;
     const struct op_code2sa_t * osp;
     char b[80];
@@ -2246,27 +2616,37 @@ sg_get_opcode_sa_name(uint8_t cmd_byte0, int service_action,
     if (peri_type < 0)
         peri_type = 0;
     d_pdt = sg_lib_pdt_decay(peri_type);
-    for (osp = op_code2sa_arr; osp->arr; ++osp) {
-        if ((int)cmd_byte0 == osp->op_code) {
-            if ((osp->pdt_match < 0) || (d_pdt == osp->pdt_match)) {
-                vnp = get_value_name(osp->arr, service_action, peri_type);
-                if (vnp) {
-                    if (osp->prefix)
-                        sg_scnpr(buff, buff_len, "%s, %s", osp->prefix,
-                                 vnp->name);
-                    else
-                        sg_scnpr(buff, buff_len, "%s", vnp->name);
-                } else {
-                    sg_get_opcode_name(cmd_byte0, peri_type, sizeof(b), b);
-                    sg_scnpr(buff, buff_len, "%s service action=0x%x", b,
-                             service_action);
-                }
-            } else
-                sg_get_opcode_name(cmd_byte0, peri_type, buff_len, buff);
-            return;
+    indexed = lib_ind_ready(&op_ind_state, op_ind_build);
+    if (indexed)
+        k = op2sa_ind[cmd_byte0];
+    else {
+        for (k = 0; op_code2sa_arr[k].arr; ++k) {
+            if ((int)cmd_byte0 == op_code2sa_arr[k].op_code)
+                break;
         }
+        if (NULL == op_code2sa_arr[k].arr)
+            k = -1;
+    }
+    if (k < 0) {
+        sg_get_opcode_name(cmd_byte0, peri_type, buff_len, buff);
+        return;
     }
-    sg_get_opcode_name(cmd_byte0, peri_type, buff_len, buff);
+    osp = op_code2sa_arr + k;
+    if ((osp->pdt_match < 0) || (d_pdt == osp->pdt_match)) {
+        vnp = indexed ? get_sa_value_name(k, service_action, peri_type) :
+                        get_value_name(osp->arr, service_action, peri_type);
+        if (vnp) {
+            if (osp->prefix)
+                sg_scnpr(buff, buff_len, "%s, %s", osp->prefix, vnp->name);
+            else
+                sg_scnpr(buff, buff_len, "%s", vnp->name);
+        } else {
+            sg_get_opcode_name(cmd_byte0, peri_type, sizeof(b), b);
+            sg_scnpr(buff, buff_len, "%s service action=0x%x", b,
+                     service_action);
+        }
+    } else
+        sg_get_opcode_name(cmd_byte0, peri_type, buff_len, buff);
 }
 
 void
@@ -2293,7 +2673,13 @@ sg_get_opcode_name(uint8_t cmd_byte0, int peri_type, int buff_len,
     case 2:
     case 4:
     case 5:
-        vnp = get_value_name(sg_lib_normal_opcodes, cmd_byte0, peri_type);
+        if (lib_ind_ready(&op_ind_state, op_ind_build))
+            vnp = (OP_IND_NONE == op_ind[cmd_byte0]) ? NULL :
+                  get_value_name_pdt(sg_lib_normal_opcodes +
+                                     op_ind[cmd_byte0], cmd_byte0, peri_type);
+        else
+            vnp = get_value_name(sg_lib_normal_opcodes, cmd_byte0,
+                                 peri_type);
         if (vnp)
             sg_scnpr(buff, buff_len, "%s", vnp->name);
         else
@@ -2701,121 +3087,141 @@ safe_strerror(int errnum)
     return errstr;
 }
 
-static void
-trimTrailingSpaces(char * b)
+/* Thread safe variant of safe_strerror(): places the error string in 'b'
+ * and returns 'b'. Uses the XSI strerror_r() where available. */
+char *
+sg_strerror_r(int errnum, char * b, int blen)
 {
-    int k;
+    if ((NULL == b) || (blen < 1))
+        return b;
+    if (errnum < 0)
+        errnum = -errnum;
+#ifdef SG_LIB_WIN32
+    {
+        errno_t e = strerror_s(b, blen, errnum);
 
-    for (k = ((int)strlen(b) - 1); k >= 0; --k) {
-        if (' ' != b[k])
-            break;
+        if (e)
+            sg_scnpr(b, blen, "unknown errno: %i", errnum);
     }
-    if ('\0' != b[k + 1])
-        b[k + 1] = '\0';
+#else
+    /* _POSIX_C_SOURCE, without _GNU_SOURCE, selects the XSI version */
+    if (strerror_r(errnum, b, blen))
+        sg_scnpr(b, blen, "unknown errno: %i", errnum);
+#endif
+    return b;
 }
 
+static const char hex_digits[] = "0123456789abcdef";
+
+/* Places 'c' as two lower case hex digits at 'b', no trailing '\0' */
+static inline void
+hex_pair(char * b, uint8_t c)
+{
+    b[0] = hex_digits[c >> 4];
+    b[1] = hex_digits[c & 0xf];
+}
+
+/* Places 'a' at 'b' as sprintf(b, "%.2x", a) would but without the trailing
+ * '\0'. Returns the number of characters placed. */
+static int
+hex_addr(char * b, unsigned int a)
+{
+    int k, n;
+    unsigned int t;
+
+    for (n = 2, t = a >> 8; t; t >>= 4)
+        ++n;
+    for (k = n - 1; k >= 0; --k, a >>= 4)
+        b[k] = hex_digits[a & 0xf];
+    return n;
+}
+
+/* Places up to 16 bytes from 'p' as ASCII-hex at 'b', space separated with
+ * an extra space between the 8th and 9th bytes. 'b' is assumed to be
+ * filled with spaces. Returns the offset just past the last hex digit. */
+static int
+hex_line(char * b, const uint8_t * p, int n)
+{
+    int j;
+
+    for (j = 0; j < n; ++j, b += 3)
+        hex_pair(b + (j >= 8), p[j]);
+    return (3 * n) - 1 + (n > 8);
+}
+
+#define DSHF_OBUF_LEN 8192
+
 /* Note the ASCII-hex output goes to stdout. [Most other output from functions
  * in this file go to sg_warnings_strm (default stderr).]
  * 'no_ascii' allows for 3 output types:
  *     > 0     each line has address then up to 16 ASCII-hex bytes
  *     = 0     in addition, the bytes are listed in ASCII to the right
- *     < 0     only the ASCII-hex bytes are listed (i.e. without address) */
+ *     < 0     only the ASCII-hex bytes are listed (i.e. without address)
+ * Lines are built with table lookups and gathered in 'obuf' so that 'fp'
+ * sees one write per DSHF_OBUF_LEN bytes rather than one per line. If
+ * 'logged' is true, writes go via sg_log_write() and are held together so
+ * the dump is not interleaved with other threads' messages. */
 static void
-dStrHexFp(const char* str, int len, int no_ascii, FILE * fp)
+dStrHexFp(const char* str, int len, int no_ascii, FILE * fp, bool logged)
 {
-    const char * p = str;
-    const char * formatstr;
+    const uint8_t * p = (const uint8_t *)str;
     uint8_t c;
-    char buff[82];
-    int a = 0;
-    int bpstart = 5;
+    int a, j, n, llen;
+    int on = 0;
     const int cpstart = 60;
-    int cpos = cpstart;
-    int bpos = bpstart;
-    int i, k, blen;
+    char * lp;
+    char obuf[DSHF_OBUF_LEN];
 
     if (len <= 0)
         return;
-    blen = (int)sizeof(buff);
-    if (0 == no_ascii)  /* address at left and ASCII at right */
-        formatstr = "%.76s\n";
-    else                        /* previously when > 0 str was "%.58s\n" */
-        formatstr = "%s\n";     /* when < 0 str was: "%.48s\n" */
-    memset(buff, ' ', 80);
-    buff[80] = '\0';
-    if (no_ascii < 0) {
-        bpstart = 0;
-        bpos = bpstart;
-        for (k = 0; k < len; k++) {
-            c = *p++;
-            if (bpos == (bpstart + (8 * 3)))
-                bpos++;
-            sg_scnpr(&buff[bpos], blen - bpos, "%.2x", (int)(uint8_t)c);
-            buff[bpos + 2] = ' ';
-            if ((k > 0) && (0 == ((k + 1) % 16))) {
-                trimTrailingSpaces(buff);
-                fprintf(fp, formatstr, buff);
-                bpos = bpstart;
-                memset(buff, ' ', 80);
-            } else
-                bpos += 3;
-        }
-        if (bpos > bpstart) {
-            buff[bpos + 2] = '\0';
-            trimTrailingSpaces(buff);
-            fprintf(fp, "%s\n", buff);
+    if (logged)
+        sg_log_ring_hold();
+    for (a = 0; a < len; a += 16, p += 16) {
+        n = ((len - a) < 16) ? (len - a) : 16;
+        if (on > (DSHF_OBUF_LEN - 80)) {
+            if (logged)
+                sg_log_write(fp, obuf, on);
+            else
+                fwrite(obuf, 1, on, fp);
+            on = 0;
         }
-        return;
-    }
-    /* no_ascii>=0, start each line with address (offset) */
-    k = sg_scnpr(buff + 1, blen - 1, "%.2x", a);
-    buff[k + 1] = ' ';
-
-    for (i = 0; i < len; i++) {
-        c = *p++;
-        bpos += 3;
-        if (bpos == (bpstart + (9 * 3)))
-            bpos++;
-        sg_scnpr(&buff[bpos], blen - bpos, "%.2x", (int)(uint8_t)c);
-        buff[bpos + 2] = ' ';
-        if (no_ascii)
-            buff[cpos++] = ' ';
+        lp = obuf + on;
+        memset(lp, ' ', cpstart);
+        if (no_ascii < 0)
+            llen = hex_line(lp, p, n);
         else {
-            if (! my_isprint(c))
-                c = '.';
-            buff[cpos++] = c;
-        }
-        if (cpos > (cpstart + 15)) {
-            if (no_ascii)
-                trimTrailingSpaces(buff);
-            fprintf(fp, formatstr, buff);
-            bpos = bpstart;
-            cpos = cpstart;
-            a += 16;
-            memset(buff, ' ', 80);
-            k = sg_scnpr(buff + 1, blen - 1, "%.2x", a);
-            buff[k + 1] = ' ';
+            /* start each line with address (offset), hex at column 8 */
+            hex_addr(lp + 1, (unsigned int)a);
+            llen = 8 + hex_line(lp + 8, p, n);
+            if (0 == no_ascii) {
+                for (j = 0; j < n; ++j) {
+                    c = p[j];
+                    lp[cpstart + j] = my_isprint(c) ? c : '.';
+                }
+                llen = cpstart + n;
+            }
         }
+        lp[llen] = '\n';
+        on += llen + 1;
     }
-    if (cpos > cpstart) {
-        buff[cpos] = '\0';
-        if (no_ascii)
-            trimTrailingSpaces(buff);
-        fprintf(fp, "%s\n", buff);
-    }
+    if (logged) {
+        sg_log_write(fp, obuf, on);
+        sg_log_ring_release();
+    } else if (on > 0)
+        fwrite(obuf, 1, on, fp);
 }
 
 void
 dStrHex(const char* str, int len, int no_ascii)
 {
-    dStrHexFp(str, len, no_ascii, stdout);
+    dStrHexFp(str, len, no_ascii, stdout, false);
 }
 
 void
 dStrHexErr(const char* str, int len, int no_ascii)
 {
     dStrHexFp(str, len, no_ascii,
-              (sg_warnings_strm ? sg_warnings_strm : stderr));
+              (sg_warnings_strm ? sg_warnings_strm : stderr), true);
 }
 
 #define DSHS_LINE_BLEN 160
@@ -2832,12 +3238,10 @@ int
 dStrHexStr(const char * str, int len, const char * leadin, int format,
            int b_len, char * b)
 {
-    uint8_t c;
-    int bpstart, bpos, k, n, prior_ascii_len;
+    int bpstart, llen, k, j, m, n, prior_ascii_len;
     bool want_ascii;
     char buff[DSHS_LINE_BLEN + 2];
-    char a[DSHS_BPL + 1];
-    const char * p = str;
+    const uint8_t * p = (const uint8_t *)str;
 
     if (len <= 0) {
         if (b_len > 0)
@@ -2847,10 +3251,6 @@ dStrHexStr(const char * str, int len, const char * leadin, int format,
     if (b_len <= 0)
         return 0;
     want_ascii = !format;
-    if (want_ascii) {
-        memset(a, ' ', DSHS_BPL);
-        a[DSHS_BPL] = '\0';
-    }
     if (leadin) {
         bpstart = strlen(leadin);
         /* Cap leadin at (DSHS_LINE_BLEN - 70) characters */
@@ -2858,46 +3258,31 @@ dStrHexStr(const char * str, int len, const char * leadin, int format,
             bpstart = DSHS_LINE_BLEN - 70;
     } else
         bpstart = 0;
-    bpos = bpstart;
     prior_ascii_len = bpstart + (DSHS_BPL * 3) + 1;
-    n = 0;
-    memset(buff, ' ', DSHS_LINE_BLEN);
-    buff[DSHS_LINE_BLEN] = '\0';
     if (bpstart > 0)
         memcpy(buff, leadin, bpstart);
-    for (k = 0; k < len; k++) {
-        c = *p++;
-        if (bpos == (bpstart + ((DSHS_BPL / 2) * 3)))
-            bpos++;     /* for extra space in middle of each line's hex */
-        sg_scnpr(buff + bpos, (int)sizeof(buff) - bpos, "%.2x",
-                 (int)(uint8_t)c);
-        buff[bpos + 2] = ' ';
-        if (want_ascii)
-            a[k % DSHS_BPL] = my_isprint(c) ? c : '.';
-        if ((k > 0) && (0 == ((k + 1) % DSHS_BPL))) {
-            trimTrailingSpaces(buff);
-            if (want_ascii) {
-                n += sg_scnpr(b + n, b_len - n, "%-*s   %s\n",
-                              prior_ascii_len, buff, a);
-                memset(a, ' ', DSHS_BPL);
-            } else
-                n += sg_scnpr(b + n, b_len - n, "%s\n", buff);
-            if (n >= (b_len - 1))
-                return n;
-            memset(buff, ' ', DSHS_LINE_BLEN);
-            bpos = bpstart;
-            if (bpstart > 0)
-                memcpy(buff, leadin, bpstart);
-        } else
-            bpos += 3;
-    }
-    if (bpos > bpstart) {
-        trimTrailingSpaces(buff);
-        if (want_ascii)
-            n += sg_scnpr(b + n, b_len - n, "%-*s   %s\n", prior_ascii_len,
-                          buff, a);
-        else
-            n += sg_scnpr(b + n, b_len - n, "%s\n", buff);
+    n = 0;
+    for (k = 0; k < len; k += DSHS_BPL, p += DSHS_BPL) {
+        m = ((len - k) < DSHS_BPL) ? (len - k) : DSHS_BPL;
+        memset(buff + bpstart, ' ', prior_ascii_len + 3 - bpstart);
+        llen = bpstart + hex_line(buff + bpstart, p, m);
+        if (want_ascii) {
+            /* as "%-*s   %s" with the ASCII padded out to DSHS_BPL */
+            llen = prior_ascii_len + 3;
+            for (j = 0; j < DSHS_BPL; ++j, ++llen)
+                buff[llen] = (j >= m) ? ' ' : (my_isprint(p[j]) ? p[j] : '.');
+        }
+        buff[llen++] = '\n';
+        /* append as sg_scnpr() would, truncating to fit */
+        j = b_len - n;
+        if (j > 1) {
+            llen = (llen < j) ? llen : (j - 1);
+            memcpy(b + n, buff, llen);
+            n += llen;
+            b[n] = '\0';
+        }
+        if ((m == DSHS_BPL) && (n >= (b_len - 1)))
+            return n;
     }
     return n;
 }
@@ -3406,6 +3791,260 @@ sg_get_llnum_nomult(const char * buf)
     return (1 == res) ? num : -1;
 }
 
+/* Character classes used when tokenizing ASCII hex input. For hex digits
+ * the low nibble holds the digit's value. */
+#define F2H_HEX 0x10
+#define F2H_SEP 0x20            /* space, comma or tab */
+#define F2H_END 0x40            /* '#' or '\r': rest of line ignored */
+
+static const uint8_t f2h_class[256] = {
+    ['0'] = F2H_HEX | 0x0, ['1'] = F2H_HEX | 0x1, ['2'] = F2H_HEX | 0x2,
+    ['3'] = F2H_HEX | 0x3, ['4'] = F2H_HEX | 0x4, ['5'] = F2H_HEX | 0x5,
+    ['6'] = F2H_HEX | 0x6, ['7'] = F2H_HEX | 0x7, ['8'] = F2H_HEX | 0x8,
+    ['9'] = F2H_HEX | 0x9, ['a'] = F2H_HEX | 0xa, ['b'] = F2H_HEX | 0xb,
+    ['c'] = F2H_HEX | 0xc, ['d'] = F2H_HEX | 0xd, ['e'] = F2H_HEX | 0xe,
+    ['f'] = F2H_HEX | 0xf, ['A'] = F2H_HEX | 0xa, ['B'] = F2H_HEX | 0xb,
+    ['C'] = F2H_HEX | 0xc, ['D'] = F2H_HEX | 0xd, ['E'] = F2H_HEX | 0xe,
+    ['F'] = F2H_HEX | 0xf,
+    [' '] = F2H_SEP, [','] = F2H_SEP, ['\t'] = F2H_SEP,
+    ['#'] = F2H_END, ['\r'] = F2H_END,
+};
+
+/* Input of sg_f2hex_arr() and sg_f2hex_arr_alloc() when reading ASCII
+ * hex: either a memory mapped regular file or everything read from a
+ * pipe, stdin or other file into a heap buffer. */
+struct f2h_src {
+    const char * bp;
+    int64_t len;
+    void * map_p;
+    size_t map_len;
+    uint8_t * free_p;
+};
+
+/* Reads from fd until EOF into a heap buffer that grows as needed, hint
+ * being the expected length (or 0). On success *bufp should be freed by
+ * the caller. Returns 0 if ok, else an error code. */
+static int
+f2h_read_all(int fd, const char * fname, int64_t hint, uint8_t ** bufp,
+             int64_t * lenp)
+{
+    int err;
+    int64_t cap = ((hint > 0) && (hint < INT_MAX)) ? (hint + 1) : 65536;
+    int64_t len = 0;
+    ssize_t n;
+    uint8_t * b;
+    uint8_t * nb;
+
+    b = (uint8_t *)malloc(cap);
+    if (NULL == b)
+        return sg_convert_errno(ENOMEM);
+    while (true) {
+        if (len >= cap) {
+            if (cap > INT_MAX) {
+                pr2serr("%s is too large\n", fname);
+                free(b);
+                return SG_LIB_FILE_ERROR;
+            }
+            cap *= 2;
+            nb = (uint8_t *)realloc(b, cap);
+            if (NULL == nb) {
+                free(b);
+                return sg_convert_errno(ENOMEM);
+            }
+            b = nb;
+        }
+        n = read(fd, b + len, cap - len);
+        if (0 == n)
+            break;
+        if (n < 0) {
+            err = errno;
+            if (EINTR == err)
+                continue;
+            pr2serr("read from %s: %s\n", fname, safe_strerror(err));
+            free(b);
+            return sg_convert_errno(err);
+        }
+        len += n;
+    }
+    *bufp = b;
+    *lenp = len;
+    return 0;
+}
+
+/* Makes the contents of fname ('-' for stdin) available in srcp. Regular
+ * files are memory mapped so they can be tokenized without copying. */
+static int
+f2h_src_get(const char * fname, struct f2h_src * srcp)
+{
+    bool has_stdin = (('-' == fname[0]) && ('\0' == fname[1]));
+    int fd, err, ret;
+    int64_t hint = 0;
+    struct stat a_stat;
+
+    memset(srcp, 0, sizeof(*srcp));
+    if (has_stdin)
+        fd = STDIN_FILENO;
+    else {
+        fd = open(fname, O_RDONLY);
+        if (fd < 0) {
+            err = errno;
+            pr2serr("Unable to open %s for reading: %s\n", fname,
+                    safe_strerror(err));
+            return sg_convert_errno(err);
+        }
+    }
+    if ((! has_stdin) && (0 == fstat(fd, &a_stat)) &&
+        S_ISREG(a_stat.st_mode)) {
+        if (0 == a_stat.st_size) {
+            close(fd);
+            srcp->bp = "";
+            return 0;
+        }
+        hint = a_stat.st_size;
+#ifndef SG_LIB_WIN32
+        if ((uint64_t)a_stat.st_size <= SIZE_MAX) {
+            void * p = mmap(NULL, (size_t)a_stat.st_size, PROT_READ,
+                            MAP_PRIVATE, fd, 0);
+
+            if (MAP_FAILED != p) {
+                close(fd);
+                posix_madvise(p, (size_t)a_stat.st_size,
+                              POSIX_MADV_SEQUENTIAL);
+                srcp->map_p = p;
+                srcp->map_len = (size_t)a_stat.st_size;
+                srcp->bp = (const char *)p;
+                srcp->len = a_stat.st_size;
+                return 0;
+            }
+        }   /* if mmap() fails, fall back to read() */
+#endif
+    }
+    ret = f2h_read_all(fd, fname, hint, &srcp->free_p, &srcp->len);
+    if (! has_stdin)
+        close(fd);
+    srcp->bp = (const char *)srcp->free_p;
+    return ret;
+}
+
+static void
+f2h_src_put(struct f2h_src * srcp)
+{
+#ifndef SG_LIB_WIN32
+    if (srcp->map_p)
+        munmap(srcp->map_p, srcp->map_len);
+#endif
+    if (srcp->free_p)
+        free(srcp->free_p);
+    memset(srcp, 0, sizeof(*srcp));
+}
+
+/* Tokenizes blen bytes of ASCII hex at bp into arr which can hold up to
+ * mx_len bytes. Lines are not copied or NUL terminated so their length is
+ * not limited. If no_space is set then an odd hex digit at the end of a
+ * line is joined to a hex digit that starts the next line. Returns 0 if
+ * ok, or an error code. */
+static int
+f2h_parse(const char * leadin, const char * bp, int64_t blen, bool no_space,
+          uint8_t * arr, int mx_len, int * arr_lenp)
+{
+    bool carry = false;
+    int j, k, c, v;
+    int carry_v = 0;
+    int off = 0;
+    const char * lp;            /* start of current line */
+    const char * ep;            /* end of current line (at '\n' or fin) */
+    const char * cp;
+    const char * tp;
+    const char * fin = bp + blen;
+
+    for (j = 0, lp = bp; lp < fin; ++j, lp = ep + 1) {
+        ep = (const char *)memchr(lp, '\n', fin - lp);
+        if (NULL == ep)
+            ep = fin;
+        cp = lp;
+        if (cp == ep) {
+            carry = false;
+            continue;
+        }
+        if (carry) {
+            carry = false;
+            c = f2h_class[(uint8_t)*cp];
+            if (F2H_HEX & c) {
+                if (off >= mx_len)
+                    goto too_long;
+                arr[off++] = (carry_v << 4) | (c & 0xf);
+                ++cp;
+            }
+        }
+        while ((cp < ep) && ((' ' == *cp) || ('\t' == *cp)))
+            ++cp;
+        if ((cp == ep) || ('#' == *cp))
+            continue;
+        if (no_space) {
+            for ( ; ((ep - cp) > 1) && (F2H_HEX & f2h_class[(uint8_t)cp[0]])
+                    && (F2H_HEX & f2h_class[(uint8_t)cp[1]]); cp += 2) {
+                if (off >= mx_len)
+                    goto too_long;
+                arr[off++] = ((f2h_class[(uint8_t)cp[0]] & 0xf) << 4) |
+                             (f2h_class[(uint8_t)cp[1]] & 0xf);
+            }
+            if ((cp < ep) && (F2H_HEX & f2h_class[(uint8_t)*cp])) {
+                carry = true;   /* single hex digit, may pair with next */
+                carry_v = f2h_class[(uint8_t)*cp] & 0xf;
+            }
+            /* anything else on this line is ignored but must be valid */
+            for ( ; cp < ep; ++cp) {
+                c = f2h_class[(uint8_t)*cp];
+                if (F2H_END & c)
+                    break;
+                if (0 == c)
+                    goto syntax;
+            }
+            continue;
+        }
+        while (cp < ep) {
+            c = f2h_class[(uint8_t)*cp];
+            if (F2H_END & c)
+                break;
+            if (0 == (F2H_HEX & c))
+                goto syntax;
+            /* like sscanf("%10x"), digits beyond the tenth are skipped */
+            for (tp = cp, k = 0, v = 0; (cp < ep) &&
+                 (F2H_HEX & (c = f2h_class[(uint8_t)*cp])); ++cp, ++k) {
+                if ((k < 10) && (v <= 0xff))
+                    v = (v << 4) | (c & 0xf);
+            }
+            if (v > 0xff) {
+                pr2serr("%s: hex number larger than 0xff in line %d, pos "
+                        "%d\n", leadin, j + 1, (int)(tp - lp + 1));
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            if (off >= mx_len)
+                goto too_long;
+            arr[off++] = v;
+            if (cp == ep)
+                break;
+            c = f2h_class[(uint8_t)*cp];
+            if (F2H_END & c)
+                break;
+            if (0 == (F2H_SEP & c))
+                goto syntax;
+            while ((cp < ep) && (F2H_SEP & f2h_class[(uint8_t)*cp]))
+                ++cp;
+        }
+    }
+    *arr_lenp = off;
+    return 0;
+syntax:
+    pr2serr("%s: syntax error at line %d, pos %d\n", leadin, j + 1,
+            (int)(cp - lp + 1));
+    return SG_LIB_SYNTAX_ERROR;
+too_long:
+    pr2serr("%s: array length exceeded\n", leadin);
+    *arr_lenp = mx_len;
+    return SG_LIB_LBA_OUT_OF_RANGE;
+}
+
 /* Read ASCII hex bytes or binary from fname (a file named '-' taken as
  * stdin). If reading ASCII hex then there should be either one entry per
  * line or a comma, space or tab separated list of bytes. If no_space is
@@ -3417,16 +4056,11 @@ int
 sg_f2hex_arr(const char * fname, bool as_binary, bool no_space,
              uint8_t * mp_arr, int * mp_arr_len, int max_arr_len)
 {
-    bool has_stdin, split_line;
-    int fn_len, in_len, k, j, m, fd, err;
-    int off = 0;
+    bool has_stdin;
+    int fn_len, k, m, fd, err;
     int ret = 0;
-    unsigned int h;
-    const char * lcp;
-    FILE * fp;
     struct stat a_stat;
-    char line[512];
-    char carry_over[4];
+    struct f2h_src src;
 
     if ((NULL == fname) || (NULL == mp_arr) || (NULL == mp_arr_len))
         return SG_LIB_LOGIC_ERROR;
@@ -3482,139 +4116,105 @@ bin_fini:
     }
 
     /* So read the file as ASCII hex */
-    if (has_stdin)
-        fp = stdin;
-    else {
-        fp = fopen(fname, "r");
-        if (NULL == fp) {
-            err = errno;
-            pr2serr("Unable to open %s for reading: %s\n", fname,
-                    safe_strerror(err));
-            ret = sg_convert_errno(err);
-            goto fini;
-        }
-    }
+    ret = f2h_src_get(fname, &src);
+    if (ret)
+        return ret;
+    ret = f2h_parse(__func__, src.bp, src.len, no_space, mp_arr,
+                    max_arr_len, mp_arr_len);
+    f2h_src_put(&src);
+    return ret;
+}
 
-    carry_over[0] = 0;
-    for (j = 0; j < 512; ++j) {
-        if (NULL == fgets(line, sizeof(line), fp))
-            break;
-        in_len = strlen(line);
-        if (in_len > 0) {
-            if ('\n' == line[in_len - 1]) {
-                --in_len;
-                line[in_len] = '\0';
-                split_line = false;
-            } else
-                split_line = true;
+/* Like sg_f2hex_arr() but the array is allocated (with malloc()) to fit
+ * whatever fname holds, so the input is not size limited. On success
+ * *mp_arrp points to at least MAX(*mp_arr_len, min_arr_len) bytes, those
+ * after the first *mp_arr_len being zeroed, and should be given to free()
+ * by the caller. On error *mp_arrp is set to NULL. */
+int
+sg_f2hex_arr_alloc(const char * fname, bool as_binary, bool no_space,
+                   uint8_t ** mp_arrp, int * mp_arr_len, int min_arr_len)
+{
+    bool has_stdin;
+    int fd, err, ret, n;
+    int64_t len;
+    int64_t hint = 0;
+    uint8_t * arr = NULL;
+    uint8_t * nb;
+    struct stat a_stat;
+    struct f2h_src src;
+
+    if ((NULL == fname) || (NULL == mp_arrp) || (NULL == mp_arr_len))
+        return SG_LIB_LOGIC_ERROR;
+    *mp_arrp = NULL;
+    if ('\0' == fname[0])
+        return SG_LIB_SYNTAX_ERROR;
+    if (min_arr_len < 1)
+        min_arr_len = 1;
+    if (as_binary) {
+        has_stdin = (('-' == fname[0]) && ('\0' == fname[1]));
+        if (has_stdin)
+            fd = STDIN_FILENO;
+        else {
+            fd = open(fname, O_RDONLY);
+            if (fd < 0) {
+                err = errno;
+                pr2serr("unable to open binary file %s: %s\n", fname,
+                         safe_strerror(err));
+                return sg_convert_errno(err);
+            }
+            if ((0 == fstat(fd, &a_stat)) && S_ISREG(a_stat.st_mode))
+                hint = a_stat.st_size;
         }
-        if (in_len < 1) {
-            carry_over[0] = 0;
-            continue;
+        if (hint < min_arr_len)
+            hint = min_arr_len;
+        ret = f2h_read_all(fd, fname, hint, &arr, &len);
+        if (! has_stdin)
+            close(fd);
+        if (ret)
+            return ret;
+        if (0 == len) {
+            pr2serr("read 0 bytes from binary file %s\n", fname);
+            free(arr);
+            return SG_LIB_SYNTAX_ERROR;
         }
-        if (carry_over[0]) {
-            if (isxdigit(line[0])) {
-                carry_over[1] = line[0];
-                carry_over[2] = '\0';
-                if (1 == sscanf(carry_over, "%4x", &h))
-                    mp_arr[off - 1] = h;       /* back up and overwrite */
-                else {
-                    pr2serr("%s: carry_over error ['%s'] around line %d\n",
-                            __func__, carry_over, j + 1);
-                    ret = SG_LIB_SYNTAX_ERROR;
-                    goto fini;
-                }
-                lcp = line + 1;
-                --in_len;
-            } else
-                lcp = line;
-            carry_over[0] = 0;
-        } else
-            lcp = line;
-
-        m = strspn(lcp, " \t");
-        if (m == in_len)
-            continue;
-        lcp += m;
-        in_len -= m;
-        if ('#' == *lcp)
-            continue;
-        k = strspn(lcp, "0123456789aAbBcCdDeEfF ,\t");
-        if ((k < in_len) && ('#' != lcp[k]) && ('\r' != lcp[k])) {
-            pr2serr("%s: syntax error at line %d, pos %d\n", __func__,
-                    j + 1, m + k + 1);
-            ret = SG_LIB_SYNTAX_ERROR;
-            goto fini;
+        n = (int)len;
+    } else {
+        ret = f2h_src_get(fname, &src);
+        if (ret)
+            return ret;
+        /* each byte needs at least one hex digit and a separator */
+        len = (src.len + 1) / 2;
+        if (len > INT_MAX)
+            len = INT_MAX;
+        if (len < min_arr_len)
+            len = min_arr_len;
+        arr = (uint8_t *)malloc(len);
+        if (NULL == arr) {
+            f2h_src_put(&src);
+            return sg_convert_errno(ENOMEM);
         }
-        if (no_space) {
-            for (k = 0; isxdigit(*lcp) && isxdigit(*(lcp + 1));
-                 ++k, lcp += 2) {
-                if (1 != sscanf(lcp, "%2x", &h)) {
-                    pr2serr("%s: bad hex number in line %d, pos %d\n",
-                            __func__, j + 1, (int)(lcp - line + 1));
-                    ret = SG_LIB_SYNTAX_ERROR;
-                    goto fini;
-                }
-                if ((off + k) >= max_arr_len) {
-                    pr2serr("%s: array length exceeded\n", __func__);
-                    *mp_arr_len = max_arr_len;
-                    ret = SG_LIB_LBA_OUT_OF_RANGE;
-                    goto fini;
-                }
-                mp_arr[off + k] = h;
-            }
-            if (isxdigit(*lcp) && (! isxdigit(*(lcp + 1))))
-                carry_over[0] = *lcp;
-            off += k;
-        } else {
-            for (k = 0; k < 1024; ++k) {
-                if (1 == sscanf(lcp, "%10x", &h)) {
-                    if (h > 0xff) {
-                        pr2serr("%s: hex number larger than 0xff in line "
-                                "%d, pos %d\n", __func__, j + 1,
-                                (int)(lcp - line + 1));
-                        ret = SG_LIB_SYNTAX_ERROR;
-                        goto fini;
-                    }
-                    if (split_line && (1 == strlen(lcp))) {
-                        /* single trailing hex digit might be a split pair */
-                        carry_over[0] = *lcp;
-                    }
-                    if ((off + k) >= max_arr_len) {
-                        pr2serr("%s: array length exceeded\n", __func__);
-                        ret = SG_LIB_LBA_OUT_OF_RANGE;
-                        *mp_arr_len = max_arr_len;
-                        goto fini;
-                    }
-                    mp_arr[off + k] = h;
-                    lcp = strpbrk(lcp, " ,\t");
-                    if (NULL == lcp)
-                        break;
-                    lcp += strspn(lcp, " ,\t");
-                    if ('\0' == *lcp)
-                        break;
-                } else {
-                    if (('#' == *lcp) || ('\r' == *lcp)) {
-                        --k;
-                        break;
-                    }
-                    pr2serr("%s: error in line %d, at pos %d\n", __func__,
-                            j + 1, (int)(lcp - line + 1));
-                    ret = SG_LIB_SYNTAX_ERROR;
-                    goto fini;
-                }
-            }
-            off += (k + 1);
+        ret = f2h_parse(__func__, src.bp, src.len, no_space, arr, (int)len,
+                        &n);
+        f2h_src_put(&src);
+        if (ret) {
+            free(arr);
+            return ret;
         }
     }
-    *mp_arr_len = off;
-    if (stdin != fp)
-        fclose(fp);
+    /* trim (or grow) to fit the decoded bytes, but no less than asked */
+    len = (n < min_arr_len) ? min_arr_len : n;
+    nb = (uint8_t *)realloc(arr, len);
+    if (nb)
+        arr = nb;
+    else if (len > n) {
+        free(arr);
+        return sg_convert_errno(ENOMEM);
+    }
+    if (len > n)
+        memset(arr + n, 0, len - n);
+    *mp_arrp = arr;
+    *mp_arr_len = n;
     return 0;
-fini:
-    if (stdin != fp)
-        fclose(fp);
-    return ret;
 }
 
 /* Extract character sequence from ATA words as in the model string
@@ -3656,7 +4256,7 @@ pr2serr(const char * fmt, ...)
     int n;
 
     va_start(args, fmt);
-    n = vfprintf(stderr, fmt, args);
+    n = sg_log_vpr(stderr, fmt, args);
     va_end(args);
     return n;
 }
@@ -19,7 +19,7 @@
 #include "sg_lib_data.h"
 
 
-const char * sg_lib_version_str = "2.68 20190904";/* spc5r22, sbc4r17 */
+const char * sg_lib_version_str = "2.69 20261017";/* spc5r22, sbc4r17 */
 
 
 /* indexed by pdt; those that map to own index do not decay */
@@ -632,7 +632,9 @@ struct sg_lib_value_name_t sg_lib_read_attr_arr[] = {
 
 /* A conveniently formatted list of SCSI ASC/ASCQ codes and their
  * corresponding text can be found at: www.t10.org/lists/asc-num.txt
- * The following should match asc-num.txt dated 20150423 */
+ * The following should match asc-num.txt dated 20150423 .
+ * Both tables are kept in ascending ASC order (then ASCQ or ASCQ range)
+ * since sg_get_asc_ascq_str() builds an index over them that assumes so. */
 
 #ifdef SG_SCSI_STRINGS
 struct sg_lib_asc_ascq_range_t sg_lib_asc_ascq_range[] =
@@ -970,14 +972,14 @@ struct sg_lib_asc_ascq_t sg_lib_asc_ascq[] =
     {0x2A,0x07,"Implicit asymmetric access state transition failed"},
     {0x2A,0x08,"Priority changed"},
     {0x2A,0x09,"Capacity data has changed"},
+    {0x2A,0x0a,"Error history i_t nexus cleared"},
+    {0x2A,0x0b,"Error history snapshot released"},
     {0x2A,0x0c, "Error recovery attributes have changed"},
     {0x2A,0x0d, "Data encryption capabilities changed"},
     {0x2A,0x10,"Timestamp changed"},
     {0x2A,0x11,"Data encryption parameters changed by another i_t nexus"},
     {0x2A,0x12,"Data encryption parameters changed by vendor specific event"},
     {0x2A,0x13,"Data encryption key instance counter has changed"},
-    {0x2A,0x0a,"Error history i_t nexus cleared"},
-    {0x2A,0x0b,"Error history snapshot released"},
     {0x2A,0x14,"SA creation capabilities data has changed"},
     {0x2A,0x15,"Medium removal prevention preempted"},
     {0x2A,0x16,"Zone reset write pointer recommended"},
@@ -1588,6 +1590,9 @@ struct sg_lib_simple_value_name_t sg_lib_nvme_nvm_cmd_arr[] =
     {0xe,  "Reservation Report"},
     {0x11, "Reservation Acquire"},
     {0x15, "Reservation Release"},      /* last optional command in 1.3a */
+    {0x79, "Zone Management Send"},     /* Zoned Namespace command set */
+    {0x7a, "Zone Management Receive"},
+    {0x7d, "Zone Append"},
 
     /* Vendor specific 0x80 to 0xff */
     {0xffff, NULL},                     /* Sentinel */
@@ -1701,6 +1706,15 @@ struct sg_lib_value_name_t sg_lib_nvme_cmd_status_arr[] =
     {0x180, 2, "Conflicting attributes"},
     {0x181,19, "Invalid protection information"},
     {0x182,18, "Attempted write to read only range"},
+    /* for Zoned Namespace (ZNS) Command Set */
+    {0x1b8,27, "Zoned boundary error"},
+    {0x1b9,28, "Zone is full"},
+    {0x1ba,29, "Zone is read only"},
+    {0x1bb,30, "Zone is offline"},
+    {0x1bc,28, "Zone invalid write"},
+    {0x1bd,31, "Too many active zones"},
+    {0x1be,31, "Too many open zones"},
+    {0x1bf, 9, "Invalid zone state transition"},
     /* 0x1c0 - 0x1ff: vendor specific */
 
     /* Media and Data Integrity error values, Status Code Type (SCT): 2h */
@@ -1752,6 +1766,11 @@ struct sg_lib_4tuple_u8 sg_lib_scsi_status_sense_arr[] =
     {0x2, SPC_SK_MEDIUM_ERROR, 0x10, 0x2},      /* PI app tag */
     {0x2, SPC_SK_MISCOMPARE, 0x1d, 0x0},        /* during verify */ /* 25 */
     {0x2, SPC_SK_MEDIUM_ERROR, 0x21, 0x6},      /* read invalid data */
+    {0x2, SPC_SK_ILLEGAL_REQUEST, 0x21, 0x5},   /* write boundary */
+    {0x2, SPC_SK_ILLEGAL_REQUEST, 0x21, 0x4},   /* unaligned write */
+    {0x2, SPC_SK_DATA_PROTECT, 0x27, 0x8},      /* zone read only */
+    {0x2, SPC_SK_DATA_PROTECT, 0x2c, 0xe},      /* zone offline */ /* 30 */
+    {0x2, SPC_SK_DATA_PROTECT, 0xc, 0x12},      /* zone resources */
 
     /* Leave this Sentinel value at end of this array */
     {0xff, 0xff, 0xff, 0xff},
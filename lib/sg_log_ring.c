@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_log_ring version 1.01 20261017 */
+
+/* This file contains per thread logging rings for multi-threaded utilities
+ * such as sgp_dd (see sg_log_ring_start() in sg_pr2serr.h). When started,
+ * each thread that logs is given its own ring on first use. A ring has a
+ * single producer, its thread, and a single consumer, whoever is draining,
+ * so a message is queued with a plain copy and a release store of the
+ * ring's head; there is no lock. Each message takes a sequence number from
+ * a global counter and the drainer merges the rings in that order. A
+ * message is only written once all lower numbers have been, so one whose
+ * number is taken but that is not yet visible in its ring holds back the
+ * rest; thus output is ordered as it was logged. Only one thread drains,
+ * that is arbitrated with a compare-and-swap. A thread whose ring is full
+ * drains, or waits for the current drainer, rather than drop messages.
+ */
+
+#define _POSIX_C_SOURCE 200809L         /* for clock_gettime() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_pr2serr.h"
+
+#define LR_MIN_SZ 4096
+#define LR_MSG_BLEN 512         /* messages longer than this use the heap */
+#define LR_OBUF_SZ 16384        /* drainer batches output in this */
+#define LR_DRAIN_NS 1000000     /* drain loop sleeps 1 ms when idle */
+#define LR_GAP_YIELDS 100000    /* then stop waiting for a missing seq */
+
+#define LR_ALIGN(n) (((n) + 7) & ~(uint32_t)7)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LR_CACHE_ALIGNED __attribute__ ((aligned (64)))
+#else
+#define LR_CACHE_ALIGNED
+#endif
+
+struct sg_lr_hdr {              /* precedes each message in a ring */
+    uint64_t seq;
+    uint64_t ts_ns;             /* since sg_log_ring_start() */
+    FILE * fp;
+    uint32_t len;               /* of text that follows, no trailing NUL */
+    uint32_t pad;
+};
+
+#define LR_HDR_SZ LR_ALIGN((uint32_t)sizeof(struct sg_lr_hdr))
+
+struct sg_lr_ring {
+    struct sg_lr_ring * next;   /* list of all rings, never shrinks */
+    uint8_t * buf;
+    uint32_t sz;                /* power of 2 */
+    int id;
+    uint64_t head LR_CACHE_ALIGNED;     /* only its thread writes */
+    uint64_t tail LR_CACHE_ALIGNED;     /* only the drainer writes */
+};
+
+struct sg_lr_tl {               /* per thread state */
+    struct sg_lr_ring * ring;
+    int hold;                   /* > 0: stage messages until released */
+    FILE * stage_fp;
+    char * stage;
+    uint32_t stage_len;
+    uint32_t stage_sz;
+};
+
+static int lr_active;
+static int lr_stopping;
+static int lr_draining;
+static int lr_flags;
+static int lr_atexit_done;
+static int lr_next_id;
+static uint32_t lr_ring_sz;
+static uint64_t lr_seq;
+static uint64_t lr_out_seq;             /* next seq to write, drainer only */
+static uint64_t lr_start_ns;
+static struct sg_lr_ring * lr_rings;
+static char lr_obuf[LR_OBUF_SZ];        /* only touched by the drainer */
+static int lr_olen;
+static bool lr_bol = true;              /* last message ended a line */
+static FILE * lr_ofp;
+
+static __thread struct sg_lr_tl lr_tl;
+
+
+static uint64_t
+lr_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void
+lr_copy_in(struct sg_lr_ring * rp, uint64_t pos, const void * src,
+           uint32_t n)
+{
+    uint32_t off = (uint32_t)pos & (rp->sz - 1);
+    uint32_t first = rp->sz - off;
+
+    if (n <= first)
+        memcpy(rp->buf + off, src, n);
+    else {
+        memcpy(rp->buf + off, src, first);
+        memcpy(rp->buf, (const uint8_t *)src + first, n - first);
+    }
+}
+
+static void
+lr_copy_out(const struct sg_lr_ring * rp, uint64_t pos, void * dst,
+            uint32_t n)
+{
+    uint32_t off = (uint32_t)pos & (rp->sz - 1);
+    uint32_t first = rp->sz - off;
+
+    if (n <= first)
+        memcpy(dst, rp->buf + off, n);
+    else {
+        memcpy(dst, rp->buf + off, first);
+        memcpy((uint8_t *)dst + first, rp->buf, n - first);
+    }
+}
+
+static void
+lr_oflush(void)
+{
+    if (lr_olen > 0) {
+        fwrite(lr_obuf, 1, lr_olen, lr_ofp);
+        fflush(lr_ofp);
+    }
+    lr_olen = 0;
+}
+
+static void
+lr_out(FILE * fp, const char * b, uint32_t n)
+{
+    if ((fp != lr_ofp) || ((lr_olen + n) > LR_OBUF_SZ)) {
+        lr_oflush();
+        lr_ofp = fp;
+    }
+    if (n > LR_OBUF_SZ)
+        fwrite(b, 1, n, fp);
+    else {
+        memcpy(lr_obuf + lr_olen, b, n);
+        lr_olen += n;
+    }
+}
+
+/* Writes out, in sequence order, all messages queued in the rings. Only
+ * one thread drains at a time; if another is draining then returns -1
+ * when wait is false, otherwise waits for it. A gap in the sequence is a
+ * message still being queued: when wait is false stop there (the drain
+ * loop will be back), otherwise wait for it to appear. Returns the number
+ * of messages written. */
+static int
+lr_drain(bool wait)
+{
+    int expect;
+    int num = 0;
+    int gap_yields = 0;
+    uint32_t k, n;
+    uint64_t head, tail;
+    uint64_t best_seq = 0;
+    struct sg_lr_ring * rp;
+    struct sg_lr_ring * best_rp;
+    struct sg_lr_hdr hdr;
+    struct sg_lr_hdr best_hdr;
+    char b[64];
+
+    while (true) {
+        expect = 0;
+        if (__atomic_compare_exchange_n(&lr_draining, &expect, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+        if (! wait)
+            return -1;
+        sched_yield();
+    }
+    while (true) {
+        best_rp = NULL;
+        for (rp = __atomic_load_n(&lr_rings, __ATOMIC_ACQUIRE); rp;
+             rp = rp->next) {
+            tail = rp->tail;
+            head = __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE);
+            if (head == tail)
+                continue;
+            lr_copy_out(rp, tail, &hdr, sizeof(hdr));
+            if ((NULL == best_rp) || (hdr.seq < best_seq)) {
+                best_rp = rp;
+                best_seq = hdr.seq;
+                best_hdr = hdr;
+            }
+        }
+        if (NULL == best_rp)
+            break;
+        if (best_seq > lr_out_seq) {
+            if (! wait)
+                break;
+            /* its thread is copying it in, unless it was interrupted
+             * (e.g. by a signal) so do not wait forever */
+            if (++gap_yields < LR_GAP_YIELDS) {
+                sched_yield();
+                continue;
+            }
+        }
+        gap_yields = 0;
+        if (best_seq >= lr_out_seq)
+            lr_out_seq = best_seq + 1;
+        ++num;
+        rp = best_rp;
+        if (lr_bol && (lr_flags & (SG_LOG_RING_TS | SG_LOG_RING_TID))) {
+            k = 0;
+            if (lr_flags & SG_LOG_RING_TS)
+                k += sg_scnpr(b + k, sizeof(b) - k, "[%5u.%06u] ",
+                              (unsigned int)(best_hdr.ts_ns / 1000000000),
+                              (unsigned int)((best_hdr.ts_ns / 1000) %
+                                             1000000));
+            if (lr_flags & SG_LOG_RING_TID)
+                k += sg_scnpr(b + k, sizeof(b) - k, "<%d> ", rp->id);
+            lr_out(best_hdr.fp, b, k);
+        }
+        /* text may wrap around the end of the ring */
+        tail = rp->tail + LR_HDR_SZ;
+        k = (uint32_t)tail & (rp->sz - 1);
+        n = rp->sz - k;
+        if (best_hdr.len <= n)
+            lr_out(best_hdr.fp, (const char *)rp->buf + k, best_hdr.len);
+        else {
+            lr_out(best_hdr.fp, (const char *)rp->buf + k, n);
+            lr_out(best_hdr.fp, (const char *)rp->buf, best_hdr.len - n);
+        }
+        if (best_hdr.len > 0)
+            lr_bol = ('\n' == rp->buf[(tail + best_hdr.len - 1) &
+                                       (rp->sz - 1)]);
+        __atomic_store_n(&rp->tail, rp->tail + LR_HDR_SZ +
+                         LR_ALIGN(best_hdr.len), __ATOMIC_RELEASE);
+    }
+    lr_oflush();
+    __atomic_store_n(&lr_draining, 0, __ATOMIC_RELEASE);
+    return num;
+}
+
+static void
+lr_atexit(void)
+{
+    lr_drain(true);
+}
+
+/* Returns this thread's ring, allocating it on first use. Returns NULL
+ * if out of memory. */
+static struct sg_lr_ring *
+lr_my_ring(void)
+{
+    struct sg_lr_ring * rp = lr_tl.ring;
+
+    if (rp)
+        return rp;
+    rp = (struct sg_lr_ring *)calloc(1, sizeof(*rp));
+    if (NULL == rp)
+        return NULL;
+    rp->sz = lr_ring_sz;
+    rp->buf = (uint8_t *)malloc(rp->sz);
+    if (NULL == rp->buf) {
+        free(rp);
+        return NULL;
+    }
+    rp->id = __atomic_add_fetch(&lr_next_id, 1, __ATOMIC_RELAXED);
+    rp->next = __atomic_load_n(&lr_rings, __ATOMIC_RELAXED);
+    while (! __atomic_compare_exchange_n(&lr_rings, &rp->next, rp, true,
+                                         __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    lr_tl.ring = rp;
+    return rp;
+}
+
+/* Queues one message on this thread's ring. If the ring cannot be used
+ * the message is written directly, after what is queued. */
+static void
+lr_put(FILE * fp, const char * txt, uint32_t len)
+{
+    uint32_t need = LR_HDR_SZ + LR_ALIGN(len);
+    uint64_t head;
+    struct sg_lr_ring * rp = lr_my_ring();
+    struct sg_lr_hdr hdr;
+
+    if ((NULL == rp) || (need > (rp->sz / 2))) {
+        lr_drain(true);
+        fwrite(txt, 1, len, fp);
+        return;
+    }
+    head = rp->head;
+    while ((rp->sz - (head - __atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE)))
+           < need) {
+        if (lr_drain(false) <= 0)
+            sched_yield();      /* someone else draining, or a gap */
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.seq = __atomic_fetch_add(&lr_seq, 1, __ATOMIC_RELAXED);
+    if (lr_flags & SG_LOG_RING_TS)
+        hdr.ts_ns = lr_now_ns() - lr_start_ns;
+    hdr.fp = fp;
+    hdr.len = len;
+    lr_copy_in(rp, head, &hdr, sizeof(hdr));
+    lr_copy_in(rp, head + LR_HDR_SZ, txt, len);
+    __atomic_store_n(&rp->head, head + need, __ATOMIC_RELEASE);
+}
+
+/* Appends to this thread's staging buffer, flushing it if it would grow
+ * past what a ring could take. */
+static void
+lr_stage(FILE * fp, const char * txt, uint32_t len)
+{
+    uint32_t sz;
+    char * cp;
+
+    if (lr_tl.stage_len && (fp != lr_tl.stage_fp)) {
+        lr_put(lr_tl.stage_fp, lr_tl.stage, lr_tl.stage_len);
+        lr_tl.stage_len = 0;
+    }
+    lr_tl.stage_fp = fp;
+    if ((lr_tl.stage_len + len) > lr_tl.stage_sz) {
+        for (sz = lr_tl.stage_sz ? lr_tl.stage_sz : LR_MSG_BLEN;
+             sz < (lr_tl.stage_len + len); sz *= 2)
+            ;
+        cp = (char *)realloc(lr_tl.stage, sz);
+        if (NULL == cp) {
+            if (lr_tl.stage_len)
+                lr_put(fp, lr_tl.stage, lr_tl.stage_len);
+            lr_tl.stage_len = 0;
+            lr_put(fp, txt, len);
+            return;
+        }
+        lr_tl.stage = cp;
+        lr_tl.stage_sz = sz;
+    }
+    memcpy(lr_tl.stage + lr_tl.stage_len, txt, len);
+    lr_tl.stage_len += len;
+}
+
+int
+sg_log_ring_start(int ring_sz, int flags)
+{
+    uint32_t sz;
+
+    if (__atomic_load_n(&lr_active, __ATOMIC_ACQUIRE))
+        return 0;
+    if (ring_sz <= 0)
+        ring_sz = SG_LOG_RING_DEF_SZ;
+    for (sz = LR_MIN_SZ; (sz < (uint32_t)ring_sz) && (sz < 0x40000000);
+         sz *= 2)
+        ;
+    /* rings made by an earlier start keep their size */
+    lr_ring_sz = sz;
+    lr_flags = flags;
+    lr_start_ns = lr_now_ns();
+    __atomic_store_n(&lr_stopping, 0, __ATOMIC_RELAXED);
+    if (0 == lr_atexit_done) {
+        if (atexit(lr_atexit))
+            return sg_convert_errno(ENOMEM);
+        lr_atexit_done = 1;
+    }
+    __atomic_store_n(&lr_active, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void
+sg_log_ring_stop(void)
+{
+    __atomic_store_n(&lr_active, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&lr_stopping, 1, __ATOMIC_RELEASE);
+    lr_drain(true);
+}
+
+int
+sg_log_ring_drain(void)
+{
+    return lr_drain(true);
+}
+
+void *
+sg_log_ring_drain_loop(void * arg)
+{
+    struct timespec ts;
+
+    if (arg) { ; }              /* suppress warning */
+    ts.tv_sec = 0;
+    ts.tv_nsec = LR_DRAIN_NS;
+    while (! __atomic_load_n(&lr_stopping, __ATOMIC_ACQUIRE)) {
+        if (lr_drain(false) <= 0)
+            nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+
+void
+sg_log_ring_hold(void)
+{
+    ++lr_tl.hold;
+}
+
+void
+sg_log_ring_release(void)
+{
+    if (lr_tl.hold > 0)
+        --lr_tl.hold;
+    if ((0 == lr_tl.hold) && lr_tl.stage_len) {
+        if (__atomic_load_n(&lr_active, __ATOMIC_ACQUIRE))
+            lr_put(lr_tl.stage_fp, lr_tl.stage, lr_tl.stage_len);
+        else {
+            lr_drain(true);
+            fwrite(lr_tl.stage, 1, lr_tl.stage_len, lr_tl.stage_fp);
+        }
+        lr_tl.stage_len = 0;
+    }
+    if ((0 == lr_tl.hold) && lr_tl.stage) {
+        /* no thread exit hook without pthreads, so do not keep it */
+        free(lr_tl.stage);
+        lr_tl.stage = NULL;
+        lr_tl.stage_sz = 0;
+    }
+}
+
+int
+sg_log_write(FILE * fp, const char * b, int len)
+{
+    if (len <= 0)
+        return 0;
+    if (! __atomic_load_n(&lr_active, __ATOMIC_ACQUIRE))
+        return (int)fwrite(b, 1, len, fp);
+    if (lr_tl.hold > 0)
+        lr_stage(fp, b, len);
+    else
+        lr_put(fp, b, len);
+    return len;
+}
+
+int
+sg_log_vpr(FILE * fp, const char * fmt, va_list args)
+{
+    int n;
+    char * cp;
+    va_list args2;
+    char b[LR_MSG_BLEN];
+
+    if (! __atomic_load_n(&lr_active, __ATOMIC_ACQUIRE))
+        return vfprintf(fp, fmt, args);
+    va_copy(args2, args);
+    n = vsnprintf(b, sizeof(b), fmt, args);
+    if (n < (int)sizeof(b))
+        sg_log_write(fp, b, n);
+    else if ((cp = (char *)malloc(n + 1))) {
+        n = vsnprintf(cp, n + 1, fmt, args2);
+        sg_log_write(fp, cp, n);
+        free(cp);
+    } else
+        sg_log_write(fp, b, sizeof(b) - 1);     /* truncated */
+    va_end(args2);
+    return n;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_numa version 1.00 20261017 */
+
+/* This file finds which NUMA node and CPUs are local to the host adapter
+ * (HBA) behind a file descriptor and binds threads to those CPUs (see
+ * sg_get_fd_numa() in sg_lib.h). In Linux the HBA is found in sysfs: the
+ * /sys/dev/{char,block}/<maj>:<min> link of a device resolves to a path
+ * under /sys/devices whose nearest ancestor with a numa_node attribute is
+ * the bus device (e.g. the PCI function) of the HBA. That ancestor also
+ * has a local_cpulist attribute. Elsewhere the node is reported as
+ * unknown and binding fails with ENOSYS.
+ */
+
+#define _GNU_SOURCE 1           /* for sched_setaffinity(), CPU_SET */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef SG_LIB_LINUX
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+#include "sg_lib.h"
+#include "sg_pr2serr.h"
+
+#define SG_NUMA_SYSFS_DEV "/sys/devices"
+
+/* flags of get_mempolicy(2), given here to avoid needing <numaif.h> */
+#define SG_MPOL_F_NODE 0x1
+#define SG_MPOL_F_ADDR 0x2
+
+
+#ifdef SG_LIB_LINUX
+
+/* Reads the first line of file fn into b. Returns true if successful */
+static bool
+numa_read_line(const char * fn, char * b, int blen)
+{
+    int len;
+    FILE * fp = fopen(fn, "r");
+
+    if (NULL == fp)
+        return false;
+    if (NULL == fgets(b, blen, fp)) {
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+    len = strlen(b);
+    if ((len > 0) && ('\n' == b[len - 1]))
+        b[len - 1] = '\0';
+    return true;
+}
+
+/* Parses a cpulist like "0-7,16-23" into cpu_mask. Returns the number of
+ * CPUs set. */
+static int
+numa_parse_cpulist(const char * cp, uint64_t * cpu_mask, int mask_words)
+{
+    int num = 0;
+    long lo, hi, k;
+    char * ep;
+
+    while (*cp) {
+        lo = strtol(cp, &ep, 10);
+        if ((ep == cp) || (lo < 0))
+            break;
+        hi = lo;
+        if ('-' == *ep) {
+            cp = ep + 1;
+            hi = strtol(cp, &ep, 10);
+            if ((ep == cp) || (hi < lo))
+                break;
+        }
+        for (k = lo; (k <= hi) && (k < (64L * mask_words)); ++k) {
+            cpu_mask[k / 64] |= (uint64_t)1 << (k % 64);
+            ++num;
+        }
+        if (',' != *ep)
+            break;
+        cp = ep + 1;
+    }
+    return num;
+}
+
+#endif  /* SG_LIB_LINUX */
+
+int
+sg_get_fd_numa(int fd, uint64_t * cpu_mask, int mask_words, int vb)
+{
+    int node = -1;
+#ifdef SG_LIB_LINUX
+    int n;
+    dev_t dev;
+    char * cp;
+    struct stat st;
+    char path[PATH_MAX];
+    char b[PATH_MAX + 32];
+    char val[1024];
+
+    if (cpu_mask && (mask_words > 0))
+        memset(cpu_mask, 0, mask_words * sizeof(uint64_t));
+    if (fstat(fd, &st) < 0)
+        return -1;
+    if (S_ISCHR(st.st_mode) || S_ISBLK(st.st_mode))
+        dev = st.st_rdev;
+    else if (S_ISREG(st.st_mode))
+        dev = st.st_dev;        /* the block device the file is on */
+    else
+        return -1;
+    snprintf(b, sizeof(b), "/sys/dev/%s/%u:%u",
+             S_ISCHR(st.st_mode) ? "char" : "block", major(dev), minor(dev));
+    if (NULL == realpath(b, path)) {
+        if (vb > 1)
+            pr2ws("%s: no sysfs device for %s\n", __func__, b);
+        return -1;
+    }
+    /* up towards /sys/devices until a device with a numa_node */
+    while ((0 == strncmp(path, SG_NUMA_SYSFS_DEV,
+                         sizeof(SG_NUMA_SYSFS_DEV) - 1)) &&
+           (strlen(path) > sizeof(SG_NUMA_SYSFS_DEV))) {
+        snprintf(b, sizeof(b), "%s/numa_node", path);
+        if (numa_read_line(b, val, sizeof(val))) {
+            node = atoi(val);
+            if (node < -1)
+                node = -1;
+            n = 0;
+            snprintf(b, sizeof(b), "%s/local_cpulist", path);
+            if (cpu_mask && (mask_words > 0) &&
+                numa_read_line(b, val, sizeof(val)))
+                n = numa_parse_cpulist(val, cpu_mask, mask_words);
+            if (vb > 1)
+                pr2ws("%s: fd=%d HBA %s on node %d, %d local CPUs\n",
+                      __func__, fd, path, node, n);
+            return node;
+        }
+        cp = strrchr(path, '/');
+        if (NULL == cp)
+            break;
+        *cp = '\0';
+    }
+    if (vb > 1)
+        pr2ws("%s: fd=%d, no HBA with a numa_node in sysfs\n", __func__,
+              fd);
+#else
+    if (cpu_mask && (mask_words > 0))
+        memset(cpu_mask, 0, mask_words * sizeof(uint64_t));
+    if (fd || vb) { ; }         /* suppress warning */
+#endif
+    return node;
+}
+
+int
+sg_set_thread_cpus(const uint64_t * cpu_mask, int mask_words)
+{
+#ifdef SG_LIB_LINUX
+    int k;
+    bool any = false;
+    cpu_set_t cset;
+
+    CPU_ZERO(&cset);
+    for (k = 0; (k < (64 * mask_words)) && (k < CPU_SETSIZE); ++k) {
+        if (cpu_mask[k / 64] & ((uint64_t)1 << (k % 64))) {
+            CPU_SET(k, &cset);
+            any = true;
+        }
+    }
+    if (! any)
+        return EINVAL;
+    /* pid 0 is the calling thread */
+    if (sched_setaffinity(0, sizeof(cset), &cset) < 0)
+        return errno;
+    return 0;
+#else
+    if (cpu_mask || mask_words) { ; }   /* suppress warning */
+    return ENOSYS;
+#endif
+}
+
+int
+sg_get_thread_numa(int * cpup)
+{
+#if defined(SG_LIB_LINUX) && defined(SYS_getcpu)
+    unsigned int cpu, node;
+
+    if (0 == syscall(SYS_getcpu, &cpu, &node, NULL)) {
+        if (cpup)
+            *cpup = (int)cpu;
+        return (int)node;
+    }
+#endif
+    if (cpup)
+        *cpup = -1;
+    return -1;
+}
+
+int
+sg_get_addr_numa(const void * addr)
+{
+#if defined(SG_LIB_LINUX) && defined(SYS_get_mempolicy)
+    int node = -1;
+
+    if (0 == syscall(SYS_get_mempolicy, &node, NULL, 0UL, addr,
+                     SG_MPOL_F_NODE | SG_MPOL_F_ADDR))
+        return node;
+#else
+    if (addr) { ; }             /* suppress warning */
+#endif
+    return -1;
+}
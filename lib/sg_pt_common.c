@@ -31,7 +31,7 @@
 #include "sg_pt_nvme.h"
 #endif
 
-static const char * scsi_pt_version_str = "3.12 20190612";
+static const char * scsi_pt_version_str = "3.13 20261017";
 
 
 const char *
@@ -76,10 +76,60 @@ static struct sg_opcode_info_t sg_opcode_info_arr[] =
       0x1, 0xff, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0} },
     {0x1d, 0, 0, {6,            /* SEND DIAGNOSTIC */
       0xf7, 0x0, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0} },
+    {0x28, 0, 0, {10,           /* READ(10) */
+      0x08, 0xff, 0xff, 0xff, 0xff, 0x3f, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0,
+      0} },
+    {0x2a, 0, 0, {10,           /* WRITE(10) */
+      0x08, 0xff, 0xff, 0xff, 0xff, 0x3f, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0,
+      0} },
+    {0x2f, 0, 0, {10,           /* VERIFY(10) */
+      0x06, 0xff, 0xff, 0xff, 0xff, 0x3f, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0,
+      0} },
+    {0x35, 0, 0, {10,           /* SYNCHRONIZE CACHE(10) */
+      0x02, 0xff, 0xff, 0xff, 0xff, 0x3f, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0,
+      0} },
+    {0x41, 0, 0, {10,           /* WRITE SAME(10) */
+      0x08, 0xff, 0xff, 0xff, 0xff, 0x3f, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0,
+      0} },
+    {0x42, 0, 0, {10,           /* UNMAP */
+      0x0, 0, 0, 0, 0, 0x3f, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0, 0} },
     {0x55, 0, 0, {10,           /* MODE SELECT(10) */
       0x13, 0x0, 0x0, 0x0, 0x0, 0x0, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0, 0} },
     {0x5a, 0, 0, {10,           /* MODE SENSE(10) */
       0x18, 0xff, 0xff, 0x0, 0x0, 0x0, 0xff, 0xff, 0xc7, 0, 0, 0, 0, 0, 0} },
+    {0x88, 0, 0, {16,           /* READ(16) */
+      0x08, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0x3f, 0xc7} },
+    {0x8a, 0, 0, {16,           /* WRITE(16) */
+      0x08, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0x3f, 0xc7} },
+    {0x8f, 0, 0, {16,           /* VERIFY(16) */
+      0x06, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0x3f, 0xc7} },
+    {0x91, 0, 0, {16,           /* SYNCHRONIZE CACHE(16) */
+      0x02, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0x3f, 0xc7} },
+    {0x93, 0, 0, {16,           /* WRITE SAME(16) */
+      0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0x3f, 0xc7} },
+    {0x94, 0x1, F_SA_LOW, {16,  /* CLOSE ZONE */
+      0x1, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0, 0, 0xff,
+      0xff, 0x1, 0xc7} },
+    {0x94, 0x2, F_SA_LOW, {16,  /* FINISH ZONE */
+      0x2, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0, 0, 0xff,
+      0xff, 0x1, 0xc7} },
+    {0x94, 0x3, F_SA_LOW, {16,  /* OPEN ZONE */
+      0x3, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0, 0, 0xff,
+      0xff, 0x1, 0xc7} },
+    {0x94, 0x4, F_SA_LOW, {16,  /* RESET WRITE POINTER */
+      0x4, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0, 0, 0xff,
+      0xff, 0x1, 0xc7} },
+    {0x95, 0x0, F_SA_LOW, {16,  /* REPORT ZONES */
+      0x0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0xbf, 0xc7} },
+    {0x9e, 0x12, F_SA_LOW, {16, /* GET LBA STATUS(16) */
+      0x12, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0xff, 0xc7} },
     {0xa0, 0, 0, {12,           /* REPORT LUNS */
       0xe3, 0xff, 0, 0, 0, 0xff, 0xff, 0xff, 0xff, 0, 0xc7, 0, 0, 0, 0} },
     {0xa3, 0xc, F_SA_LOW, {12,  /* REPORT SUPPORTED OPERATION CODES */
@@ -546,3 +596,487 @@ err_out:
 }
 
 #endif          /* (HAVE_NVME && (! IGNORE_NVME)) [near line 140] */
+
+#ifndef SG_LIB_LINUX
+/* ^^^^^^^^^^^^^^^^^^ Linux has its own mrq implementation in sg_pt_linux.c */
+
+/* Generic multiple request (mrq) object: each command in the batch is sent
+ * in turn with do_scsi_pt(). */
+struct sg_pt_mrq {
+    int dev_fd;
+    int max_num;
+    int num;
+    struct sg_pt_base ** objpp;
+};
+
+struct sg_pt_mrq *
+construct_pt_mrq_obj(int dev_fd, int max_num, int verbose)
+{
+    struct sg_pt_mrq * mrqp;
+
+    if (max_num < 1) {
+        if (verbose)
+            pr2ws("%s: max_num must be 1 or more\n", __func__);
+        return NULL;
+    }
+    mrqp = (struct sg_pt_mrq *)calloc(1, sizeof(*mrqp));
+    if (mrqp) {
+        mrqp->objpp = (struct sg_pt_base **)calloc(max_num,
+                                                   sizeof(mrqp->objpp[0]));
+        if (NULL == mrqp->objpp) {
+            free(mrqp);
+            mrqp = NULL;
+        } else {
+            mrqp->dev_fd = dev_fd;
+            mrqp->max_num = max_num;
+        }
+    }
+    if ((NULL == mrqp) && verbose)
+        pr2ws("%s: calloc() failed, out of memory?\n", __func__);
+    return mrqp;
+}
+
+int
+add_pt_mrq_elem(struct sg_pt_mrq * mrqp, struct sg_pt_base * objp)
+{
+    if ((NULL == objp) || (mrqp->num >= mrqp->max_num))
+        return -1;
+    mrqp->objpp[mrqp->num] = objp;
+    return mrqp->num++;
+}
+
+int
+get_pt_mrq_num(const struct sg_pt_mrq * mrqp)
+{
+    return mrqp->num;
+}
+
+struct sg_pt_base *
+get_pt_mrq_elem(const struct sg_pt_mrq * mrqp, int index)
+{
+    return ((index < 0) || (index >= mrqp->num)) ? NULL :
+                                                   mrqp->objpp[index];
+}
+
+/* Each do_scsi_pt() records its own OS error in the object it was given.
+ * Returns the first non-zero do_scsi_pt() result. */
+int
+do_pt_mrq(struct sg_pt_mrq * mrqp, int time_secs, int verbose)
+{
+    int k, res;
+    int err = 0;
+
+    for (k = 0; k < mrqp->num; ++k) {
+        res = do_scsi_pt(mrqp->objpp[k], mrqp->dev_fd, time_secs, verbose);
+        if (res && (0 == err))
+            err = res;
+    }
+    return err;
+}
+
+void
+clear_pt_mrq_obj(struct sg_pt_mrq * mrqp)
+{
+    mrqp->num = 0;
+}
+
+void
+destruct_pt_mrq_obj(struct sg_pt_mrq * mrqp)
+{
+    if (mrqp) {
+        free(mrqp->objpp);
+        free(mrqp);
+    }
+}
+
+#endif          /* SG_LIB_LINUX */
+
+/*
+ * Per opcode latency histograms, see sg_pt.h . Each histogram has
+ * SG_LAT_SUB_NUM linear buckets for every power of 2 nanoseconds (above
+ * SG_LAT_SUB_NUM ns) up to 2**SG_LAT_MAX_MSB ns (about 18 minutes). A
+ * histogram is allocated the first time its opcode is seen and then all
+ * updates are atomic adds, so no locks are needed.
+ */
+
+#define SG_LAT_SUB_BITS 5
+#define SG_LAT_SUB_NUM (1 << SG_LAT_SUB_BITS)
+#define SG_LAT_MAX_MSB 40
+#define SG_LAT_NUM_BKTS ((SG_LAT_MAX_MSB - SG_LAT_SUB_BITS + 2) * \
+                         SG_LAT_SUB_NUM)
+#define SG_LAT_NUM_SPACES 3
+#define SG_LAT_INITING (-2)
+
+struct sg_lat_hist {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t bkt[SG_LAT_NUM_BKTS];
+};
+
+int sg_pt_lat_hist_state = -1;
+
+/* Bucket counts followed by sum_ns of each histogram when marked */
+struct sg_pt_lat_mark {
+    uint64_t * bkt[SG_LAT_NUM_SPACES * 256];    /* NULL: was not in use */
+};
+
+static struct sg_lat_hist * lat_hist_arr[SG_LAT_NUM_SPACES * 256];
+static const char * lat_space_nm[SG_LAT_NUM_SPACES] = {"SCSI", "Adm", "NVM"};
+static const char * lat_hist_fname;
+
+
+static int
+lat_bkt_index(uint64_t ns)
+{
+    int msb;
+
+    if (ns < SG_LAT_SUB_NUM)
+        return (int)ns;
+    msb = 63 - __builtin_clzll(ns);
+    if (msb > SG_LAT_MAX_MSB)
+        return SG_LAT_NUM_BKTS - 1;
+    return ((msb - SG_LAT_SUB_BITS + 1) << SG_LAT_SUB_BITS) +
+           (int)((ns >> (msb - SG_LAT_SUB_BITS)) & (SG_LAT_SUB_NUM - 1));
+}
+
+/* Returns middle of the range of values that map to bucket index k */
+static uint64_t
+lat_bkt_value(int k)
+{
+    int g = k >> SG_LAT_SUB_BITS;
+    uint64_t s = k & (SG_LAT_SUB_NUM - 1);
+
+    if (0 == g)
+        return s;
+    return ((SG_LAT_SUB_NUM + s) << (g - 1)) + ((1ULL << (g - 1)) >> 1);
+}
+
+static void
+lat_hist_dump(void)
+{
+    int k, n;
+    FILE * fp = stderr;
+    struct sg_pt_lat_stats * arr;
+    char b[64];
+
+    n = sg_pt_lat_hist_snapshot(NULL, 0, false);
+    if (n < 1)
+        return;
+    arr = (struct sg_pt_lat_stats *)calloc(n, sizeof(*arr));
+    if (NULL == arr)
+        return;
+    n = sg_pt_lat_hist_snapshot(arr, n, false);
+    if (lat_hist_fname && lat_hist_fname[0] &&
+        (0 != strcmp(lat_hist_fname, "-"))) {
+        fp = fopen(lat_hist_fname, "a");
+        if (NULL == fp) {
+            pr2ws("%s: unable to open %s\n", SG_PT_LAT_HIST_EV,
+                  lat_hist_fname);
+            free(arr);
+            return;
+        }
+    }
+    fprintf(fp, "Pass-through latency per opcode, in microseconds:\n");
+    fprintf(fp, "  %-34s %10s %10s %10s %10s %10s\n", "opcode", "count",
+            "p50", "p99", "p99.9", "max");
+    for (k = 0; k < n; ++k) {
+        if (SG_PT_LAT_SCSI == arr[k].op_space)
+            sg_get_opcode_name((uint8_t)arr[k].opcode, -1, sizeof(b), b);
+        else
+            sg_get_nvme_opcode_name((uint8_t)arr[k].opcode,
+                                    SG_PT_LAT_NVME_ADMIN == arr[k].op_space,
+                                    sizeof(b), b);
+        fprintf(fp, "  %-4s 0x%02x %-24.24s %10" PRIu64 " %10.1f %10.1f "
+                "%10.1f %10.1f\n", lat_space_nm[arr[k].op_space],
+                arr[k].opcode, b, arr[k].count, arr[k].p50_ns / 1000.0,
+                arr[k].p99_ns / 1000.0, arr[k].p999_ns / 1000.0,
+                arr[k].max_ns / 1000.0);
+    }
+    if (fp != stderr)
+        fclose(fp);
+    free(arr);
+}
+
+/* Only one thread does the work, others wait for it to finish */
+static void
+lat_hist_init(void)
+{
+    int expect = -1;
+    const char * cp;
+
+    if (! __atomic_compare_exchange_n(&sg_pt_lat_hist_state, &expect,
+                                      SG_LAT_INITING, false,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        while (SG_LAT_INITING ==
+               __atomic_load_n(&sg_pt_lat_hist_state, __ATOMIC_ACQUIRE))
+            ;
+        return;
+    }
+    cp = getenv(SG_PT_LAT_HIST_EV);
+    if (cp) {
+        lat_hist_fname = cp;
+        atexit(lat_hist_dump);
+    }
+    __atomic_store_n(&sg_pt_lat_hist_state, cp ? 1 : 0, __ATOMIC_RELEASE);
+}
+
+bool
+sg_pt_lat_hist_active(void)
+{
+    int st = __atomic_load_n(&sg_pt_lat_hist_state, __ATOMIC_ACQUIRE);
+
+    if (st < 0) {
+        lat_hist_init();
+        st = __atomic_load_n(&sg_pt_lat_hist_state, __ATOMIC_ACQUIRE);
+    }
+    return st > 0;
+}
+
+bool
+sg_pt_lat_hist_enable(bool enable)
+{
+    bool prev = sg_pt_lat_hist_active();
+
+    __atomic_store_n(&sg_pt_lat_hist_state, enable ? 1 : 0,
+                     __ATOMIC_RELEASE);
+    return prev;
+}
+
+void
+sg_pt_lat_hist_add(int op_space, int opcode, uint64_t lat_ns)
+{
+    uint64_t mx;
+    struct sg_lat_hist * hp;
+    struct sg_lat_hist * expect = NULL;
+    struct sg_lat_hist ** hpp;
+
+    if ((op_space < 0) || (op_space >= SG_LAT_NUM_SPACES))
+        return;
+    hpp = lat_hist_arr + (op_space * 256) + (opcode & 0xff);
+    hp = __atomic_load_n(hpp, __ATOMIC_ACQUIRE);
+    if (NULL == hp) {
+        hp = (struct sg_lat_hist *)calloc(1, sizeof(*hp));
+        if (NULL == hp)
+            return;
+        if (! __atomic_compare_exchange_n(hpp, &expect, hp, false,
+                                          __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE)) {
+            free(hp);           /* another thread won */
+            hp = expect;
+        }
+    }
+    __atomic_add_fetch(hp->bkt + lat_bkt_index(lat_ns), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hp->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hp->sum_ns, lat_ns, __ATOMIC_RELAXED);
+    mx = __atomic_load_n(&hp->max_ns, __ATOMIC_RELAXED);
+    while ((lat_ns > mx) &&
+           (! __atomic_compare_exchange_n(&hp->max_ns, &mx, lat_ns, true,
+                                          __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED)))
+        ;
+}
+
+static void
+lat_hist_clear(struct sg_lat_hist * hp)
+{
+    int k;
+
+    for (k = 0; k < SG_LAT_NUM_BKTS; ++k)
+        __atomic_store_n(hp->bkt + k, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&hp->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&hp->sum_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&hp->max_ns, 0, __ATOMIC_RELAXED);
+}
+
+/* Returns the value below which pct percent of the count samples in bkt
+ * lie, but no more than max_ns */
+static uint64_t
+lat_percentile(const uint64_t * bkt, uint64_t count, uint64_t max_ns,
+               double pct)
+{
+    int k;
+    uint64_t v;
+    uint64_t sum = 0;
+    uint64_t target = (uint64_t)((pct * count) / 100.0 + 0.999999);
+
+    if (0 == target)
+        target = 1;
+    for (k = 0; k < SG_LAT_NUM_BKTS; ++k) {
+        sum += bkt[k];
+        if (sum >= target)
+            break;
+    }
+    v = lat_bkt_value(k);
+    return (v > max_ns) ? max_ns : v;
+}
+
+int
+sg_pt_lat_hist_snapshot(struct sg_pt_lat_stats * arr, int max_num,
+                        bool reset)
+{
+    int k, j, n;
+    uint64_t cnt;
+    struct sg_lat_hist * hp;
+    struct sg_pt_lat_stats * sp;
+    uint64_t * bkt;
+
+    bkt = (arr && (max_num > 0)) ?
+          (uint64_t *)malloc(sizeof(uint64_t) * SG_LAT_NUM_BKTS) : NULL;
+    for (k = 0, n = 0; k < (SG_LAT_NUM_SPACES * 256); ++k) {
+        hp = __atomic_load_n(lat_hist_arr + k, __ATOMIC_ACQUIRE);
+        if ((NULL == hp) ||
+            (0 == __atomic_load_n(&hp->count, __ATOMIC_RELAXED)))
+            continue;
+        if ((NULL == bkt) || (n >= max_num)) {
+            if (reset)
+                lat_hist_clear(hp);
+            ++n;
+            continue;
+        }
+        sp = arr + n++;
+        memset(sp, 0, sizeof(*sp));
+        sp->op_space = k / 256;
+        sp->opcode = k % 256;
+        if (reset) {
+            for (j = 0, cnt = 0; j < SG_LAT_NUM_BKTS; ++j) {
+                bkt[j] = __atomic_exchange_n(hp->bkt + j, 0,
+                                             __ATOMIC_RELAXED);
+                cnt += bkt[j];
+            }
+            __atomic_sub_fetch(&hp->count, cnt, __ATOMIC_RELAXED);
+            sp->sum_ns = __atomic_exchange_n(&hp->sum_ns, 0,
+                                             __ATOMIC_RELAXED);
+            sp->max_ns = __atomic_exchange_n(&hp->max_ns, 0,
+                                             __ATOMIC_RELAXED);
+        } else {
+            for (j = 0, cnt = 0; j < SG_LAT_NUM_BKTS; ++j) {
+                bkt[j] = __atomic_load_n(hp->bkt + j, __ATOMIC_RELAXED);
+                cnt += bkt[j];
+            }
+            sp->sum_ns = __atomic_load_n(&hp->sum_ns, __ATOMIC_RELAXED);
+            sp->max_ns = __atomic_load_n(&hp->max_ns, __ATOMIC_RELAXED);
+        }
+        sp->count = cnt;
+        if (cnt > 0) {
+            sp->p50_ns = lat_percentile(bkt, cnt, sp->max_ns, 50.0);
+            sp->p99_ns = lat_percentile(bkt, cnt, sp->max_ns, 99.0);
+            sp->p999_ns = lat_percentile(bkt, cnt, sp->max_ns, 99.9);
+        }
+    }
+    if (bkt)
+        free(bkt);
+    return n;
+}
+
+void
+sg_pt_lat_hist_reset(void)
+{
+    int k;
+    struct sg_lat_hist * hp;
+
+    for (k = 0; k < (SG_LAT_NUM_SPACES * 256); ++k) {
+        hp = __atomic_load_n(lat_hist_arr + k, __ATOMIC_ACQUIRE);
+        if (hp)
+            lat_hist_clear(hp);
+    }
+}
+
+struct sg_pt_lat_mark *
+sg_pt_lat_hist_mark(void)
+{
+    int k, j;
+    uint64_t * bp;
+    struct sg_lat_hist * hp;
+    struct sg_pt_lat_mark * mp;
+
+    mp = (struct sg_pt_lat_mark *)calloc(1, sizeof(*mp));
+    if (NULL == mp)
+        return NULL;
+    for (k = 0; k < (SG_LAT_NUM_SPACES * 256); ++k) {
+        hp = __atomic_load_n(lat_hist_arr + k, __ATOMIC_ACQUIRE);
+        if (NULL == hp)
+            continue;
+        bp = (uint64_t *)malloc(sizeof(uint64_t) * (SG_LAT_NUM_BKTS + 1));
+        if (NULL == bp) {
+            sg_pt_lat_hist_mark_free(mp);
+            return NULL;
+        }
+        for (j = 0; j < SG_LAT_NUM_BKTS; ++j)
+            bp[j] = __atomic_load_n(hp->bkt + j, __ATOMIC_RELAXED);
+        bp[SG_LAT_NUM_BKTS] = __atomic_load_n(&hp->sum_ns, __ATOMIC_RELAXED);
+        mp->bkt[k] = bp;
+    }
+    return mp;
+}
+
+int
+sg_pt_lat_hist_since(const struct sg_pt_lat_mark * markp,
+                     struct sg_pt_lat_stats * arr, int max_num)
+{
+    int k, j, n, hi;
+    uint64_t cnt, v, sum;
+    const uint64_t * mbp;
+    struct sg_lat_hist * hp;
+    struct sg_pt_lat_stats * sp;
+    uint64_t * bkt;
+
+    bkt = (uint64_t *)malloc(sizeof(uint64_t) * SG_LAT_NUM_BKTS);
+    if (NULL == bkt)
+        return sg_pt_lat_hist_snapshot(NULL, 0, false);
+    for (k = 0, n = 0; k < (SG_LAT_NUM_SPACES * 256); ++k) {
+        hp = __atomic_load_n(lat_hist_arr + k, __ATOMIC_ACQUIRE);
+        if (NULL == hp)
+            continue;
+        mbp = markp ? markp->bkt[k] : NULL;
+        for (j = 0, cnt = 0, hi = 0; j < SG_LAT_NUM_BKTS; ++j) {
+            v = __atomic_load_n(hp->bkt + j, __ATOMIC_RELAXED);
+            if (mbp)    /* histogram may have been reset since */
+                v = (v > mbp[j]) ? (v - mbp[j]) : 0;
+            bkt[j] = v;
+            if (v > 0) {
+                cnt += v;
+                hi = j;
+            }
+        }
+        if (0 == cnt)
+            continue;
+        if ((NULL == arr) || (n >= max_num)) {
+            ++n;
+            continue;
+        }
+        sp = arr + n++;
+        memset(sp, 0, sizeof(*sp));
+        sp->op_space = k / 256;
+        sp->opcode = k % 256;
+        sp->count = cnt;
+        sum = __atomic_load_n(&hp->sum_ns, __ATOMIC_RELAXED);
+        if (mbp)
+            sum = (sum > mbp[SG_LAT_NUM_BKTS]) ?
+                  (sum - mbp[SG_LAT_NUM_BKTS]) : 0;
+        sp->sum_ns = sum;
+        sp->max_ns = __atomic_load_n(&hp->max_ns, __ATOMIC_RELAXED);
+        v = lat_bkt_value(hi);
+        if (v < sp->max_ns)
+            sp->max_ns = v;
+        sp->p50_ns = lat_percentile(bkt, cnt, sp->max_ns, 50.0);
+        sp->p99_ns = lat_percentile(bkt, cnt, sp->max_ns, 99.0);
+        sp->p999_ns = lat_percentile(bkt, cnt, sp->max_ns, 99.9);
+    }
+    free(bkt);
+    return n;
+}
+
+void
+sg_pt_lat_hist_mark_free(struct sg_pt_lat_mark * markp)
+{
+    int k;
+
+    if (NULL == markp)
+        return;
+    for (k = 0; k < (SG_LAT_NUM_SPACES * 256); ++k) {
+        if (markp->bkt[k])
+            free(markp->bkt[k]);
+    }
+    free(markp);
+}
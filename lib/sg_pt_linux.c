@@ -7,7 +7,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-/* sg_pt_linux version 1.47 20190612 */
+/* sg_pt_linux version 1.49 20261017 */
 
 
 #include <stdio.h>
@@ -19,8 +19,10 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/sysmacros.h>      /* to define 'major' */
 #ifndef major
 #include <sys/types.h>
@@ -36,6 +38,7 @@
 #include "sg_pt.h"
 #include "sg_lib.h"
 #include "sg_linux_inc.h"
+#include "sg_io_linux.h"
 #include "sg_pt_linux.h"
 #include "sg_pr2serr.h"
 
@@ -111,6 +114,7 @@ static const char * linux_driver_suggests[] = {
 bool sg_bsg_nvme_char_major_checked = false;
 int sg_bsg_major = 0;
 volatile int sg_nvme_char_major = 0;
+volatile int sg_nvme_generic_major = 0;        /* e.g. /dev/ng0n1 */
 
 bool sg_checked_version_num = false;
 int sg_driver_version_num = 0;
@@ -125,8 +129,8 @@ long sg_lin_page_size = 4096;   /* default, overridden with correct value */
 void
 sg_find_bsg_nvme_char_major(int verbose)
 {
-    bool got_one = false;
     int n;
+    int num_found = 0;
     const char * proc_devices = "/proc/devices";
     char * cp;
     FILE *fp;
@@ -148,14 +152,16 @@ sg_find_bsg_nvme_char_major(int verbose)
         if (2 == sscanf(b, "%d %126s", &n, a)) {
             if (0 == strcmp("bsg", a)) {
                 sg_bsg_major = n;
-                if (got_one)
+                if (++num_found > 2)
                     break;
-                got_one = true;
             } else if (0 == strcmp("nvme", a)) {
                 sg_nvme_char_major = n;
-                if (got_one)
+                if (++num_found > 2)
+                    break;
+            } else if (0 == strcmp("nvme-generic", a)) {
+                sg_nvme_generic_major = n;
+                if (++num_found > 2)
                     break;
-                got_one = true;
             }
         } else
             break;
@@ -166,6 +172,9 @@ sg_find_bsg_nvme_char_major(int verbose)
                 pr2ws("found sg_bsg_major=%d\n", sg_bsg_major);
             if (sg_nvme_char_major > 0)
                 pr2ws("found sg_nvme_char_major=%d\n", sg_nvme_char_major);
+            if (sg_nvme_generic_major > 0)
+                pr2ws("found sg_nvme_generic_major=%d\n",
+                      sg_nvme_generic_major);
         } else
             pr2ws("found no bsg not nvme char device in %s\n", proc_devices);
     }
@@ -175,7 +184,9 @@ sg_find_bsg_nvme_char_major(int verbose)
 /* Assumes that sg_find_bsg_nvme_char_major() has already been called. Returns
  * true if dev_fd is a scsi generic pass-through device. If yields
  * *is_nvme_p = true with *nsid_p = 0 then dev_fd is a NVMe char device.
- * If yields *nsid_p > 0 then dev_fd is a NVMe block device. */
+ * If yields *nsid_p > 0 then dev_fd is a NVMe block device or a NVMe
+ * generic char device (e.g. /dev/ng0n1) which is a per namespace char
+ * device. */
 static bool
 check_file_type(int dev_fd, struct stat * dev_statp, bool * is_bsg_p,
                 bool * is_nvme_p, uint32_t * nsid_p, int * os_err_p,
@@ -185,11 +196,16 @@ check_file_type(int dev_fd, struct stat * dev_statp, bool * is_bsg_p,
     bool is_sg = false;
     bool is_bsg = false;
     bool is_block = false;
+    bool is_emul = false;
     int os_err = 0;
     int major_num;
     uint32_t nsid = 0;          /* invalid NSID */
 
-    if (dev_fd >= 0) {
+    if ((dev_fd >= 0) && sg_emul_dev_type(dev_fd, &is_nvme)) {
+        is_emul = true;
+        if (is_nvme)
+            nsid = 1;
+    } else if (dev_fd >= 0) {
         if (fstat(dev_fd, dev_statp) < 0) {
             os_err = errno;
             if (verbose)
@@ -205,6 +221,19 @@ check_file_type(int dev_fd, struct stat * dev_statp, bool * is_bsg_p,
                 is_bsg = true;
             else if (sg_nvme_char_major == major_num)
                 is_nvme = true;
+            else if ((sg_nvme_generic_major > 0) &&
+                     (sg_nvme_generic_major == major_num)) {
+                is_nvme = true;
+                nsid = ioctl(dev_fd, NVME_IOCTL_ID, NULL);
+                if (SG_NVME_BROADCAST_NSID == nsid) {  /* means ioctl error */
+                    os_err = errno;
+                    if (verbose)
+                        pr2ws("%s: ioctl(NVME_IOCTL_ID) failed: %s "
+                              "(errno=%d)\n", __func__, safe_strerror(os_err),
+                              os_err);
+                } else
+                    os_err = 0;
+            }
         } else if (S_ISBLK(dev_statp->st_mode)) {
             is_block = true;
             if (BLOCK_EXT_MAJOR == major_num) {
@@ -228,14 +257,16 @@ check_file_type(int dev_fd, struct stat * dev_statp, bool * is_bsg_p,
 skip_out:
     if (verbose > 3) {
         pr2ws("%s: file descriptor is ", __func__);
-        if (is_sg)
+        if (is_emul)
+            pr2ws("emulated %s device\n", is_nvme ? "NVMe" : "SCSI");
+        else if (is_sg)
             pr2ws("sg device\n");
         else if (is_bsg)
             pr2ws("bsg device\n");
         else if (is_nvme && (0 == nsid))
             pr2ws("NVMe char device\n");
         else if (is_nvme)
-            pr2ws("NVMe block device, nsid=%lld\n",
+            pr2ws("NVMe block or generic device, nsid=%lld\n",
                   ((uint32_t)-1 == nsid) ? -1LL : (long long)nsid);
         else if (is_block)
             pr2ws("block device\n");
@@ -278,6 +309,8 @@ check_pt_file_handle(int dev_fd, const char * device_name, int verbose)
         uint32_t nsid;
         struct stat a_stat;
 
+        if (sg_emul_dev_type(dev_fd, &is_nvme))
+            return is_nvme ? 4 : 1;
         is_sg = check_file_type(dev_fd, &a_stat, &is_bsg, &is_nvme, &nsid,
                                 &err, verbose);
         if (err)
@@ -334,7 +367,8 @@ check_pt_file_handle(int dev_fd, const char * device_name, int verbose)
 int
 scsi_pt_open_flags(const char * device_name, int flags, int verbose)
 {
-    int fd;
+    int fd, res;
+    const char * cp;
 
     if (! sg_bsg_nvme_char_major_checked) {
         sg_bsg_nvme_char_major_checked = true;
@@ -343,12 +377,23 @@ scsi_pt_open_flags(const char * device_name, int flags, int verbose)
     if (verbose > 1) {
         pr2ws("open %s with flags=0x%x\n", device_name, flags);
     }
+    if (0 == strncmp(device_name, SG_EMUL_PREFIX,
+                     sizeof(SG_EMUL_PREFIX) - 1))
+        return sg_emul_open(device_name + sizeof(SG_EMUL_PREFIX) - 1, flags,
+                            verbose);
     fd = open(device_name, flags);
     if (fd < 0) {
         fd = -errno;
         if (verbose > 1)
             pr2ws("%s: open(%s, 0x%x) failed: %s\n", __func__, device_name,
                   flags, safe_strerror(-fd));
+    } else if ((cp = getenv(SG_EMUL_EV))) {
+        /* only regular files are emulated, others yield -ENODEV */
+        res = sg_emul_attach(fd, device_name, cp, verbose);
+        if (res && (-ENODEV != res)) {
+            close(fd);
+            fd = res;
+        }
     }
     return fd;
 }
@@ -369,6 +414,8 @@ scsi_pt_close_device(int device_fd)
 {
     int res;
 
+    sg_uring_release(device_fd);
+    sg_emul_release(device_fd);
     res = close(device_fd);
     if (res < 0)
         res = -errno;
@@ -430,11 +477,7 @@ destruct_scsi_pt_obj(struct sg_pt_base * vp)
     else {
         struct sg_pt_linux_scsi * ptp = &vp->impl;
 
-        if (ptp->free_nvme_id_ctlp) {
-            free(ptp->free_nvme_id_ctlp);
-            ptp->free_nvme_id_ctlp = NULL;
-            ptp->nvme_id_ctlp = NULL;
-        }
+        sg_nvme_id_release(ptp);
         if (ptp)
             free(ptp);
     }
@@ -444,21 +487,29 @@ destruct_scsi_pt_obj(struct sg_pt_base * vp)
 void
 clear_scsi_pt_obj(struct sg_pt_base * vp)
 {
-    bool is_sg, is_bsg, is_nvme;
-    int fd;
+    bool is_sg, is_bsg, is_nvme, is_emul;
+    int fd, sg_version;
     uint32_t nvme_nsid;
+    struct sg_nvme_geom nvme_geom;
     struct sg_sntl_dev_state_t dev_stat;
+    struct sg_nvme_id_ent * id_ctl_ent;
+    struct sg_nvme_id_ent * id_ns_ent;
+    uint8_t * id_ctlp;
     struct sg_pt_linux_scsi * ptp = &vp->impl;
 
     if (ptp) {
         fd = ptp->dev_fd;
+        sg_version = ptp->sg_version;
         is_sg = ptp->is_sg;
         is_bsg = ptp->is_bsg;
         is_nvme = ptp->is_nvme;
+        is_emul = ptp->is_emul;
         nvme_nsid = ptp->nvme_nsid;
+        nvme_geom = ptp->nvme_geom;
         dev_stat = ptp->dev_stat;
-        if (ptp->free_nvme_id_ctlp)
-            free(ptp->free_nvme_id_ctlp);
+        id_ctl_ent = ptp->nvme_id_ctl_ent;
+        id_ns_ent = ptp->nvme_id_ns_ent;
+        id_ctlp = ptp->nvme_id_ctlp;
         memset(ptp, 0, sizeof(struct sg_pt_linux_scsi));
         ptp->io_hdr.guard = 'Q';
 #ifdef BSG_PROTOCOL_SCSI
@@ -468,12 +519,18 @@ clear_scsi_pt_obj(struct sg_pt_base * vp)
         ptp->io_hdr.subprotocol = BSG_SUB_PROTOCOL_SCSI_CMD;
 #endif
         ptp->dev_fd = fd;
+        ptp->sg_version = sg_version;
         ptp->is_sg = is_sg;
         ptp->is_bsg = is_bsg;
         ptp->is_nvme = is_nvme;
+        ptp->is_emul = is_emul;
         ptp->nvme_direct = false;
         ptp->nvme_nsid = nvme_nsid;
+        ptp->nvme_geom = nvme_geom;
         ptp->dev_stat = dev_stat;
+        ptp->nvme_id_ctl_ent = id_ctl_ent;
+        ptp->nvme_id_ns_ent = id_ns_ent;
+        ptp->nvme_id_ctlp = id_ctlp;
     }
 }
 
@@ -507,6 +564,22 @@ struct sg_extended_info {
 
 #endif
 
+/* Asynchronous ioctls introduced in the sg v4 driver */
+#ifndef SG_IOSUBMIT
+#define SG_IOSUBMIT _IOWR(0x22, 0x41, struct sg_io_v4)
+#endif
+#ifndef SG_IORECEIVE
+#define SG_IORECEIVE _IOWR(0x22, 0x42, struct sg_io_v4)
+#endif
+#ifndef SGV4_FLAG_IMMED
+#define SGV4_FLAG_IMMED 0x400
+#endif
+#ifndef SGV4_FLAG_MULTIPLE_REQS
+#define SGV4_FLAG_MULTIPLE_REQS 0x20000 /* n sg_io_v4s in data-in */
+#endif
+
+#define SG_PT_ASYNC_SENSE_LEN 252       /* room for largest sense */
+
 /* Forget any previous dev_fd and install the one given. May attempt to
  * find file type (e.g. if pass-though) from OS so there could be an error.
  * Returns 0 for success or the same value as get_scsi_pt_os_err()
@@ -522,10 +595,13 @@ set_pt_file_handle(struct sg_pt_base * vp, int dev_fd, int verbose)
         sg_find_bsg_nvme_char_major(verbose);
     }
     ptp->dev_fd = dev_fd;
+    /* Identify data and namespace geometry are fetched by the SNTL */
+    sg_nvme_id_release(ptp);
     if (dev_fd >= 0) {
         ptp->is_sg = check_file_type(dev_fd, &a_stat, &ptp->is_bsg,
                                      &ptp->is_nvme, &ptp->nvme_nsid,
                                      &ptp->os_err, verbose);
+        ptp->is_emul = sg_emul_dev_type(dev_fd, NULL);
         if (ptp->is_sg && (! sg_checked_version_num)) {
             if (ioctl(dev_fd, SG_GET_VERSION_NUM, &ptp->sg_version) < 0) {
                 ptp->sg_version = 0;
@@ -588,6 +664,7 @@ set_pt_file_handle(struct sg_pt_base * vp, int dev_fd, int verbose)
         ptp->is_sg = false;
         ptp->is_bsg = false;
         ptp->is_nvme = false;
+        ptp->is_emul = false;
         ptp->nvme_direct = false;
         ptp->nvme_nsid = 0;
         ptp->os_err = 0;
@@ -668,6 +745,63 @@ set_scsi_pt_data_out(struct sg_pt_base * vp, const uint8_t * dxferp,
     }
 }
 
+/* Returns the sum of the iov_len fields in the iov_count elements of iovp,
+ * or 0 if that is too large for a sg v4 header. */
+static uint32_t
+iovec_total_len(const struct iovec * iovp, int iov_count)
+{
+    int k;
+    uint64_t n;
+
+    for (k = 0, n = 0; k < iov_count; ++k)
+        n += iovp[k].iov_len;
+    return (n > INT32_MAX) ? 0 : (uint32_t)n;
+}
+
+/* Setup for data transfer from device into a scatter gather list */
+void
+set_scsi_pt_data_in_iovec(struct sg_pt_base * vp, const struct iovec * iovp,
+                          int iov_count)
+{
+    uint32_t len;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    if (ptp->io_hdr.din_xferp)
+        ++ptp->in_err;
+    if ((iov_count > 0) && iovp) {
+        len = iovec_total_len(iovp, iov_count);
+        if (0 == len) {
+            ++ptp->in_err;
+            return;
+        }
+        ptp->io_hdr.din_xferp = (__u64)(sg_uintptr_t)iovp;
+        ptp->io_hdr.din_xfer_len = len;
+        ptp->io_hdr.din_iovec_count = iov_count;
+    }
+}
+
+/* Setup for data transfer toward device from a scatter gather list */
+void
+set_scsi_pt_data_out_iovec(struct sg_pt_base * vp, const struct iovec * iovp,
+                           int iov_count)
+{
+    uint32_t len;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    if (ptp->io_hdr.dout_xferp)
+        ++ptp->in_err;
+    if ((iov_count > 0) && iovp) {
+        len = iovec_total_len(iovp, iov_count);
+        if (0 == len) {
+            ++ptp->in_err;
+            return;
+        }
+        ptp->io_hdr.dout_xferp = (__u64)(sg_uintptr_t)iovp;
+        ptp->io_hdr.dout_xfer_len = len;
+        ptp->io_hdr.dout_iovec_count = iov_count;
+    }
+}
+
 void
 set_pt_metadata_xfer(struct sg_pt_base * vp, uint8_t * dxferp,
                      uint32_t dxfer_len, bool out_true)
@@ -747,6 +881,12 @@ set_scsi_pt_flags(struct sg_pt_base * vp, int flags)
         ptp->io_hdr.flags |= BSG_FLAG_Q_AT_TAIL;
         ptp->io_hdr.flags &= ~BSG_FLAG_Q_AT_HEAD;
     }
+    if (SCSI_PT_FLAGS_POLLED & flags) {
+        ptp->polled = true;
+        ptp->spin_us = (flags >> 16) & SCSI_PT_SPIN_FOREVER;
+        if (0 == ptp->spin_us)
+            ptp->spin_us = SCSI_PT_DEF_SPIN_US;
+    }
 }
 
 /* If supported it is the number of bytes requested to transfer less the
@@ -995,50 +1135,86 @@ get_pt_nvme_nsid(const struct sg_pt_base * vp)
     return ptp->nvme_nsid;
 }
 
-/* Executes SCSI command using sg v3 interface */
+/* Builds a sg v3 header in *h3p from the sg v4 header held in ptp. Returns
+ * 0 if successful, else SCSI_PT_DO_BAD_PARAMS . */
 static int
-do_scsi_pt_v3(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
-              int verbose)
+v4_to_v3_hdr(const struct sg_pt_linux_scsi * ptp, int time_secs,
+             struct sg_io_hdr * h3p, int verbose)
 {
-    struct sg_io_hdr v3_hdr;
-
-    memset(&v3_hdr, 0, sizeof(v3_hdr));
+    memset(h3p, 0, sizeof(*h3p));
     /* convert v4 to v3 header */
-    v3_hdr.interface_id = 'S';
-    v3_hdr.dxfer_direction = SG_DXFER_NONE;
-    v3_hdr.cmdp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
-    v3_hdr.cmd_len = (uint8_t)ptp->io_hdr.request_len;
+    h3p->interface_id = 'S';
+    h3p->dxfer_direction = SG_DXFER_NONE;
+    h3p->cmdp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
+    h3p->cmd_len = (uint8_t)ptp->io_hdr.request_len;
     if (ptp->io_hdr.din_xfer_len > 0) {
         if (ptp->io_hdr.dout_xfer_len > 0) {
             if (verbose)
                 pr2ws("sgv3 doesn't support bidi\n");
             return SCSI_PT_DO_BAD_PARAMS;
         }
-        v3_hdr.dxferp = (void *)(long)ptp->io_hdr.din_xferp;
-        v3_hdr.dxfer_len = (unsigned int)ptp->io_hdr.din_xfer_len;
-        v3_hdr.dxfer_direction =  SG_DXFER_FROM_DEV;
+        h3p->dxferp = (void *)(long)ptp->io_hdr.din_xferp;
+        h3p->dxfer_len = (unsigned int)ptp->io_hdr.din_xfer_len;
+        h3p->iovec_count = (unsigned short)ptp->io_hdr.din_iovec_count;
+        h3p->dxfer_direction =  SG_DXFER_FROM_DEV;
     } else if (ptp->io_hdr.dout_xfer_len > 0) {
-        v3_hdr.dxferp = (void *)(long)ptp->io_hdr.dout_xferp;
-        v3_hdr.dxfer_len = (unsigned int)ptp->io_hdr.dout_xfer_len;
-        v3_hdr.dxfer_direction =  SG_DXFER_TO_DEV;
+        h3p->dxferp = (void *)(long)ptp->io_hdr.dout_xferp;
+        h3p->dxfer_len = (unsigned int)ptp->io_hdr.dout_xfer_len;
+        h3p->iovec_count = (unsigned short)ptp->io_hdr.dout_iovec_count;
+        h3p->dxfer_direction =  SG_DXFER_TO_DEV;
+    }
+    if ((ptp->io_hdr.din_iovec_count > 0xffff) ||
+        (ptp->io_hdr.dout_iovec_count > 0xffff)) {
+        if (verbose)
+            pr2ws("too many iovec elements for sgv3\n");
+        return SCSI_PT_DO_BAD_PARAMS;
     }
     if (ptp->io_hdr.response && (ptp->io_hdr.max_response_len > 0)) {
-        v3_hdr.sbp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
-        v3_hdr.mx_sb_len = (uint8_t)ptp->io_hdr.max_response_len;
+        h3p->sbp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
+        h3p->mx_sb_len = (uint8_t)ptp->io_hdr.max_response_len;
     }
-    v3_hdr.pack_id = (int)ptp->io_hdr.request_extra;
+    h3p->pack_id = (int)ptp->io_hdr.request_extra;
+    h3p->usr_ptr = (void *)(sg_uintptr_t)ptp->io_hdr.usr_ptr;
     if (BSG_FLAG_Q_AT_HEAD & ptp->io_hdr.flags)
-        v3_hdr.flags |= SG_FLAG_Q_AT_HEAD;      /* favour AT_HEAD */
+        h3p->flags |= SG_FLAG_Q_AT_HEAD;        /* favour AT_HEAD */
     else if (BSG_FLAG_Q_AT_TAIL & ptp->io_hdr.flags)
-        v3_hdr.flags |= SG_FLAG_Q_AT_TAIL;
+        h3p->flags |= SG_FLAG_Q_AT_TAIL;
 
-    if (NULL == v3_hdr.cmdp) {
+    if (NULL == h3p->cmdp) {
         if (verbose)
             pr2ws("No SCSI command (cdb) given [v3]\n");
         return SCSI_PT_DO_BAD_PARAMS;
     }
     /* io_hdr.timeout is in milliseconds, if greater than zero */
-    v3_hdr.timeout = ((time_secs > 0) ? (time_secs * 1000) : DEF_TIMEOUT);
+    h3p->timeout = ((time_secs > 0) ? (time_secs * 1000) : DEF_TIMEOUT);
+    return 0;
+}
+
+/* Transfers the output fields of a completed sg v3 header back into the sg
+ * v4 header held in ptp. */
+static void
+v3_resp_to_v4(struct sg_pt_linux_scsi * ptp, const struct sg_io_hdr * h3p)
+{
+    ptp->io_hdr.device_status = (__u32)h3p->status;
+    ptp->io_hdr.driver_status = (__u32)h3p->driver_status;
+    ptp->io_hdr.transport_status = (__u32)h3p->host_status;
+    ptp->io_hdr.response_len = (__u32)h3p->sb_len_wr;
+    ptp->io_hdr.duration = (__u32)h3p->duration;
+    ptp->io_hdr.din_resid = (__s32)h3p->resid;
+    /* v3_hdr.info not passed back since no mapping defined (yet) */
+}
+
+/* Executes SCSI command using sg v3 interface */
+static int
+do_scsi_pt_v3(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
+              int verbose)
+{
+    int res;
+    struct sg_io_hdr v3_hdr;
+
+    res = v4_to_v3_hdr(ptp, time_secs, &v3_hdr, verbose);
+    if (res)
+        return res;
     /* Finally do the v3 SG_IO ioctl */
     if (ioctl(fd, SG_IO, &v3_hdr) < 0) {
         ptp->os_err = errno;
@@ -1047,13 +1223,7 @@ do_scsi_pt_v3(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
                   safe_strerror(ptp->os_err), ptp->os_err);
         return -ptp->os_err;
     }
-    ptp->io_hdr.device_status = (__u32)v3_hdr.status;
-    ptp->io_hdr.driver_status = (__u32)v3_hdr.driver_status;
-    ptp->io_hdr.transport_status = (__u32)v3_hdr.host_status;
-    ptp->io_hdr.response_len = (__u32)v3_hdr.sb_len_wr;
-    ptp->io_hdr.duration = (__u32)v3_hdr.duration;
-    ptp->io_hdr.din_resid = (__s32)v3_hdr.resid;
-    /* v3_hdr.info not passed back since no mapping defined (yet) */
+    v3_resp_to_v4(ptp, &v3_hdr);
     return 0;
 }
 
@@ -1079,11 +1249,11 @@ do_scsi_pt_v4(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
     return 0;
 }
 
-/* Executes SCSI command (or at least forwards it to lower layers).
- * Returns 0 for success, negative numbers are negated 'errno' values from
- * OS system calls. Positive return values are errors from this package. */
-int
-do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
+/* Checks and settles the file descriptor to be used by vp, in common to
+ * do_scsi_pt() and submit_scsi_pt(). Returns 0 if okay, else a value
+ * suitable for those functions to return. */
+static int
+check_pt_fd(struct sg_pt_base * vp, int fd, int verbose)
 {
     int err;
     struct sg_pt_linux_scsi * ptp = &vp->impl;
@@ -1110,8 +1280,7 @@ do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
         if (verbose)
             pr2ws("%s: invalid file descriptors\n", __func__);
         return SCSI_PT_DO_BAD_PARAMS;
-    } else
-        fd = ptp->dev_fd;
+    }
     if (! have_checked_for_type) {
         err = set_pt_file_handle(vp, ptp->dev_fd, verbose);
         if (err)
@@ -1119,7 +1288,148 @@ do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
     }
     if (ptp->os_err)
         return -ptp->os_err;
-    if (ptp->is_nvme)
+    return 0;
+}
+
+/* Scatter gather lists are passed as is to the sg driver and to SG_IO (v3)
+ * on block devices. The bsg driver ignores the iovec counts, while the
+ * SNTL, NVMe pass-through and emulated devices expect a single buffer, so
+ * for those the data is copied through a contiguous "bounce" buffer. */
+struct sg_pt_bounce {
+    uint8_t * din_free;
+    uint8_t * dout_free;
+    __u64 din_iovp;             /* caller's lists, restored afterwards */
+    __u64 dout_iovp;
+    __u32 din_iov_count;
+    __u32 dout_iov_count;
+};
+
+static bool
+iovec_need_bounce(const struct sg_pt_linux_scsi * ptp)
+{
+    if ((0 == ptp->io_hdr.din_iovec_count) &&
+        (0 == ptp->io_hdr.dout_iovec_count))
+        return false;
+    if (ptp->is_emul || ptp->is_nvme)
+        return true;
+    return ((! ptp->is_sg) && ptp->is_bsg && (sg_bsg_major > 0));
+}
+
+/* Copies len bytes between bp and the scatter gather list iovp. When
+ * to_iov is true, bp is the source. */
+static void
+iovec_copy(const struct iovec * iovp, int iov_count, uint8_t * bp,
+           uint32_t len, bool to_iov)
+{
+    int k;
+    uint32_t n;
+
+    for (k = 0; (k < iov_count) && (len > 0); ++k, bp += n, len -= n) {
+        n = (iovp[k].iov_len < len) ? iovp[k].iov_len : len;
+        if (to_iov)
+            memcpy(iovp[k].iov_base, bp, n);
+        else
+            memcpy(bp, iovp[k].iov_base, n);
+    }
+}
+
+/* Swaps any scatter gather lists in ptp for bounce buffers, gathering the
+ * data-out list. Returns 0 if okay, else -ENOMEM . */
+static int
+iovec_bounce_start(struct sg_pt_linux_scsi * ptp, struct sg_pt_bounce * bp)
+{
+    uint8_t * dp;
+
+    memset(bp, 0, sizeof(*bp));
+    if (ptp->io_hdr.din_iovec_count > 0) {
+        dp = sg_memalign(ptp->io_hdr.din_xfer_len, 0, &bp->din_free, false);
+        if (NULL == dp)
+            return -ENOMEM;
+        bp->din_iovp = ptp->io_hdr.din_xferp;
+        bp->din_iov_count = ptp->io_hdr.din_iovec_count;
+        ptp->io_hdr.din_xferp = (__u64)(sg_uintptr_t)dp;
+        ptp->io_hdr.din_iovec_count = 0;
+    }
+    if (ptp->io_hdr.dout_iovec_count > 0) {
+        dp = sg_memalign(ptp->io_hdr.dout_xfer_len, 0, &bp->dout_free,
+                         false);
+        if (NULL == dp) {
+            if (bp->din_free) {
+                ptp->io_hdr.din_xferp = bp->din_iovp;
+                ptp->io_hdr.din_iovec_count = bp->din_iov_count;
+                free(bp->din_free);
+            }
+            return -ENOMEM;
+        }
+        iovec_copy((const struct iovec *)(sg_uintptr_t)ptp->io_hdr.dout_xferp,
+                   ptp->io_hdr.dout_iovec_count, dp,
+                   ptp->io_hdr.dout_xfer_len, false);
+        bp->dout_iovp = ptp->io_hdr.dout_xferp;
+        bp->dout_iov_count = ptp->io_hdr.dout_iovec_count;
+        ptp->io_hdr.dout_xferp = (__u64)(sg_uintptr_t)dp;
+        ptp->io_hdr.dout_iovec_count = 0;
+    }
+    return 0;
+}
+
+/* Scatters the data-in actually received into the caller's list, then
+ * restores the lists in ptp and frees the bounce buffers. */
+static void
+iovec_bounce_finish(struct sg_pt_linux_scsi * ptp, struct sg_pt_bounce * bp)
+{
+    int n;
+
+    if (bp->din_free) {
+        n = (int)ptp->io_hdr.din_xfer_len - ptp->io_hdr.din_resid;
+        if (n > (int)ptp->io_hdr.din_xfer_len)
+            n = ptp->io_hdr.din_xfer_len;
+        if (n > 0)
+            iovec_copy((const struct iovec *)(sg_uintptr_t)bp->din_iovp,
+                       bp->din_iov_count,
+                       (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp,
+                       n, true);
+        ptp->io_hdr.din_xferp = bp->din_iovp;
+        ptp->io_hdr.din_iovec_count = bp->din_iov_count;
+        free(bp->din_free);
+    }
+    if (bp->dout_free) {
+        ptp->io_hdr.dout_xferp = bp->dout_iovp;
+        ptp->io_hdr.dout_iovec_count = bp->dout_iov_count;
+        free(bp->dout_free);
+    }
+}
+
+static int do_scsi_pt_polled(struct sg_pt_base * vp, int time_secs,
+                             int verbose);
+
+/* Sends the command in vp to the device type settled by check_pt_fd() */
+static int
+do_scsi_pt_dev(struct sg_pt_base * vp, int time_secs, int verbose)
+{
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    int fd = ptp->dev_fd;
+
+    if (ptp->polled) {
+        int res = do_scsi_pt_polled(vp, time_secs, verbose);
+
+        if (SCSI_PT_DO_NOT_SUPPORTED != res)
+            return res;
+        /* not sent, so use the blocking path */
+    }
+    if (iovec_need_bounce(ptp)) {
+        int res;
+        struct sg_pt_bounce bounce;
+
+        res = iovec_bounce_start(ptp, &bounce);
+        if (res)
+            return res;
+        res = do_scsi_pt_dev(vp, time_secs, verbose);
+        iovec_bounce_finish(ptp, &bounce);
+        return res;
+    }
+    if (ptp->is_emul)
+        return sg_emul_do_pt(vp, time_secs, verbose);
+    else if (ptp->is_nvme)
         return sg_do_nvme_pt(vp, -1, time_secs, verbose);
     else if (ptp->is_sg) {
 #ifdef IGNORE_LINUX_SGV4
@@ -1140,3 +1450,653 @@ do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
     pr2ws("%s: Should never reach this point\n", __func__);
     return 0;
 }
+
+/* Executes SCSI command (or at least forwards it to lower layers).
+ * Returns 0 for success, negative numbers are negated 'errno' values from
+ * OS system calls. Positive return values are errors from this package.
+ * When command tracing (see sg_pt_linux_trace.c) or latency histograms
+ * (see sg_pt_common.c) are active the command is timed and recorded after
+ * it completes. NVMe Admin commands, sent directly or by the SNTL, are
+ * also timed individually where sg_do_nvme_pt() issues them. */
+int
+do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
+{
+    bool do_trace, do_lat;
+    int err;
+    uint64_t start_ns;
+    const struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    err = check_pt_fd(vp, fd, verbose);
+    if (err)
+        return err;
+    do_trace = __atomic_load_n(&sg_pt_trace_state, __ATOMIC_RELAXED) &&
+               sg_pt_trace_active();
+    do_lat = __atomic_load_n(&sg_pt_lat_hist_state, __ATOMIC_RELAXED) &&
+             sg_pt_lat_hist_active();
+    if (! (do_trace || do_lat))
+        return do_scsi_pt_dev(vp, time_secs, verbose);
+    start_ns = sg_pt_trace_now_ns();
+    err = do_scsi_pt_dev(vp, time_secs, verbose);
+    if (do_lat && (! ptp->nvme_direct) && ptp->io_hdr.request)
+        sg_pt_lat_hist_add(SG_PT_LAT_SCSI,
+                           *(const uint8_t *)(sg_uintptr_t)
+                                                ptp->io_hdr.request,
+                           sg_pt_trace_now_ns() - start_ns);
+    if (do_trace)
+        sg_pt_trace_record(vp, start_ns, err);
+    return err;
+}
+
+/*
+ * Asynchronous pass-through. Commands are sent with submit_scsi_pt() and
+ * later reaped with receive_scsi_pt(). Three mechanisms are used depending
+ * on what the file descriptor refers to:
+ *   a) sg driver >= 4.0.0 : ioctl(SG_IOSUBMIT) and ioctl(SG_IORECEIVE)
+ *      with the sg v4 header
+ *   b) sg driver < 4.0.0 : write() and read() of the sg v3 header
+ *   c) bsg driver : write() and read() of the sg v4 header. Note that
+ *      more recent Linux kernels have removed this from bsg, in which case
+ *      the OS error is passed back.
+ * In all cases the sg_pt_base object address is placed in the usr_ptr
+ * field of the header so receive_scsi_pt() can find the object that a
+ * completion belongs to. Other devices (i.e. block devices, NVMe devices
+ * and regular files) use the io_uring backend in sg_pt_linux_uring.c .
+ */
+
+/* Used when asynchronous method is chosen */
+enum sg_pt_async_t {
+    SG_PT_ASYNC_NONE = 0,
+    SG_PT_ASYNC_SG_V4,
+    SG_PT_ASYNC_SG_V3,
+    SG_PT_ASYNC_BSG,
+};
+
+static enum sg_pt_async_t
+async_method(bool is_sg, bool is_bsg, int sg_version)
+{
+    if (is_sg) {
+#ifdef IGNORE_LINUX_SGV4
+        if (sg_version) { ; }       /* suppress warning */
+        return SG_PT_ASYNC_SG_V3;
+#else
+        return (sg_version >= SG_LINUX_SG_VER_V4_BASE) ? SG_PT_ASYNC_SG_V4 :
+                                                         SG_PT_ASYNC_SG_V3;
+#endif
+    } else if (is_bsg && (sg_bsg_major > 0))
+        return SG_PT_ASYNC_BSG;
+    return SG_PT_ASYNC_NONE;
+}
+
+/* Places the output fields of a completed sg v4 header (h4p) into ptp
+ * (which held the matching submitted header). Sense data is copied when
+ * h4p used a different response buffer. */
+static void
+v4_resp_to_ptp(struct sg_pt_linux_scsi * ptp, const struct sg_io_v4 * h4p)
+{
+    uint32_t n;
+
+    ptp->io_hdr.driver_status = h4p->driver_status;
+    ptp->io_hdr.transport_status = h4p->transport_status;
+    ptp->io_hdr.device_status = h4p->device_status;
+    ptp->io_hdr.retry_delay = h4p->retry_delay;
+    ptp->io_hdr.info = h4p->info;
+    ptp->io_hdr.duration = h4p->duration;
+    ptp->io_hdr.din_resid = h4p->din_resid;
+    ptp->io_hdr.dout_resid = h4p->dout_resid;
+    ptp->io_hdr.generated_tag = h4p->generated_tag;
+    n = h4p->response_len;
+    if (n > ptp->io_hdr.max_response_len)
+        n = ptp->io_hdr.max_response_len;
+    ptp->io_hdr.response_len = n;
+    if ((n > 0) && ptp->io_hdr.response &&
+        (ptp->io_hdr.response != h4p->response))
+        memcpy((uint8_t *)(sg_uintptr_t)ptp->io_hdr.response,
+               (const uint8_t *)(sg_uintptr_t)h4p->response, n);
+}
+
+/* Sends the command held in vp to the device without waiting for it to
+ * complete. Returns 0 if queued, a negated errno, or a positive
+ * SCSI_PT_DO_* value. */
+int
+submit_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
+{
+    int err;
+    ssize_t res;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    struct sg_io_hdr v3_hdr;
+
+    err = check_pt_fd(vp, fd, verbose);
+    if (err)
+        return err;
+    fd = ptp->dev_fd;
+    if (0 == ptp->io_hdr.request) {
+        if (verbose)
+            pr2ws("No SCSI command (cdb) given [async]\n");
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    ptp->io_hdr.usr_ptr = (__u64)(sg_uintptr_t)vp;
+    switch (async_method(ptp->is_sg, ptp->is_bsg, ptp->sg_version)) {
+    case SG_PT_ASYNC_SG_V4:
+        ptp->io_hdr.timeout = ((time_secs > 0) ? (time_secs * 1000) :
+                                                 DEF_TIMEOUT);
+        if (ioctl(fd, SG_IOSUBMIT, &ptp->io_hdr) < 0) {
+            err = errno;
+            if (verbose > 1)
+                pr2ws("ioctl(SG_IOSUBMIT) failed: %s (errno=%d)\n",
+                      safe_strerror(err), err);
+            return -err;
+        }
+        return 0;
+    case SG_PT_ASYNC_SG_V3:
+        err = v4_to_v3_hdr(ptp, time_secs, &v3_hdr, verbose);
+        if (err)
+            return err;
+        res = write(fd, &v3_hdr, sizeof(v3_hdr));
+        break;
+    case SG_PT_ASYNC_BSG:
+        if (iovec_need_bounce(ptp))
+            goto no_iovec;
+        ptp->io_hdr.timeout = ((time_secs > 0) ? (time_secs * 1000) :
+                                                 DEF_TIMEOUT);
+        res = write(fd, &ptp->io_hdr, sizeof(ptp->io_hdr));
+        break;
+    default:
+        if (ptp->is_emul) {
+            struct sg_pt_bounce bounce;
+
+            /* emulated commands are executed during submission */
+            if (! iovec_need_bounce(ptp))
+                return sg_emul_submit(vp, time_secs, verbose);
+            err = iovec_bounce_start(ptp, &bounce);
+            if (err)
+                return err;
+            err = sg_emul_submit(vp, time_secs, verbose);
+            iovec_bounce_finish(ptp, &bounce);
+            return err;
+        }
+        if (ptp->io_hdr.din_iovec_count || ptp->io_hdr.dout_iovec_count)
+            goto no_iovec;
+        return sg_uring_submit(vp, time_secs, verbose);
+    }
+    if (res < 0) {
+        err = errno;
+        if (verbose > 1)
+            pr2ws("%s: write() failed: %s (errno=%d)\n", __func__,
+                  safe_strerror(err), err);
+        return -err;
+    }
+    return 0;
+no_iovec:
+    if (verbose)
+        pr2ws("%s: scatter gather lists not supported asynchronously on "
+              "this device\n", __func__);
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+/* Fetches one completion from fd without blocking (unless fd is a blocking
+ * file descriptor with nothing waiting; callers check that first). Returns
+ * 1 and places the owning object in *vpp if a completion was found,
+ * returns 0 if none are waiting, else returns a negated errno. */
+static int
+receive_one(int fd, enum sg_pt_async_t meth, struct sg_pt_base ** vpp,
+            int verbose)
+{
+    int err;
+    ssize_t res;
+    struct sg_pt_base * vp;
+    struct sg_io_hdr v3_hdr;
+    struct sg_io_v4 v4_hdr;
+    uint8_t sense_b[SG_PT_ASYNC_SENSE_LEN];
+
+    if (SG_PT_ASYNC_SG_V3 == meth) {
+        memset(&v3_hdr, 0, sizeof(v3_hdr));
+        v3_hdr.interface_id = 'S';
+        v3_hdr.pack_id = -1;            /* oldest completion */
+        res = read(fd, &v3_hdr, sizeof(v3_hdr));
+    } else {
+        memset(&v4_hdr, 0, sizeof(v4_hdr));
+        v4_hdr.guard = 'Q';
+        v4_hdr.request_extra = (__u32)-1;       /* oldest completion */
+        if (SG_PT_ASYNC_SG_V4 == meth) {
+            v4_hdr.flags = SGV4_FLAG_IMMED;
+            v4_hdr.response = (__u64)(sg_uintptr_t)sense_b;
+            v4_hdr.max_response_len = sizeof(sense_b);
+            res = ioctl(fd, SG_IORECEIVE, &v4_hdr);
+        } else
+            res = read(fd, &v4_hdr, sizeof(v4_hdr));
+    }
+    if (res < 0) {
+        err = errno;
+        if ((EAGAIN == err) || (ENODATA == err))
+            return 0;
+        if (verbose > 1)
+            pr2ws("%s: %s failed: %s (errno=%d)\n", __func__,
+                  (SG_PT_ASYNC_SG_V4 == meth) ? "ioctl(SG_IORECEIVE)" :
+                                                "read()",
+                  safe_strerror(err), err);
+        return -err;
+    }
+    if (SG_PT_ASYNC_SG_V3 == meth) {
+        vp = (struct sg_pt_base *)v3_hdr.usr_ptr;
+        if (vp)
+            v3_resp_to_v4(&vp->impl, &v3_hdr);
+    } else {
+        vp = (struct sg_pt_base *)(sg_uintptr_t)v4_hdr.usr_ptr;
+        if (vp)
+            v4_resp_to_ptp(&vp->impl, &v4_hdr);
+    }
+    if (NULL == vp) {
+        if (verbose)
+            pr2ws("%s: completion without a pt object, not submitted by "
+                  "submit_scsi_pt()?\n", __func__);
+        return -EPROTO;
+    }
+    *vpp = vp;
+    return 1;
+}
+
+/* Fetches the completion of a command on the device that ptp refers to.
+ * When block is false only checks, returning 0 if nothing has completed.
+ * Returns 1 (with the owning object in *vpp) or a negated errno. */
+static int
+receive_own(const struct sg_pt_linux_scsi * ptp, enum sg_pt_async_t meth,
+            bool block, struct sg_pt_base ** vpp, int verbose)
+{
+    int res;
+    struct pollfd a_pollfd;
+
+    if (SG_PT_ASYNC_NONE == meth) {
+        if (ptp->is_emul)
+            return sg_emul_receive(ptp->dev_fd, vpp, 1, block ? -1 : 0,
+                                   verbose);
+        return sg_uring_receive(ptp->dev_fd, vpp, 1, block ? -1 : 0,
+                                verbose);
+    }
+    /* the sg v4 driver is checked with ioctl(SG_IORECEIVE) with the
+     * SGV4_FLAG_IMMED flag, others need poll() so read() won't block */
+    if (block || (SG_PT_ASYNC_SG_V4 != meth)) {
+        a_pollfd.fd = ptp->dev_fd;
+        a_pollfd.events = POLLIN;
+        a_pollfd.revents = 0;
+        res = poll(&a_pollfd, 1, block ? -1 : 0);
+        if (res < 0)
+            return (EINTR == errno) ? 0 : -errno;
+        if (0 == res)
+            return 0;
+    }
+    return receive_one(ptp->dev_fd, meth, vpp, verbose);
+}
+
+/* Executes the command in vp with polled completion (see
+ * SCSI_PT_FLAGS_POLLED in sg_pt.h). The command is sent with
+ * submit_scsi_pt() then its completion is checked for, without
+ * sleeping, until the spin budget is spent; then the wait blocks. If
+ * the command can not be sent asynchronously (e.g. a SCSI command other
+ * than READ, WRITE or SYNCHRONIZE CACHE to a NVMe device), nothing is
+ * sent and SCSI_PT_DO_NOT_SUPPORTED is returned. */
+static int
+do_scsi_pt_polled(struct sg_pt_base * vp, int time_secs, int verbose)
+{
+    bool forever;
+    int res;
+    uint64_t end_ns;
+    enum sg_pt_async_t meth;
+    struct sg_pt_base * rvp = NULL;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    /* io_uring would send NVMe commands to the Admin queue */
+    if (ptp->is_nvme && (! ptp->is_emul) &&
+        (! sg_is_scsi_cdb((const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request,
+                          ptp->io_hdr.request_len)))
+        return SCSI_PT_DO_NOT_SUPPORTED;
+    res = submit_scsi_pt(vp, -1, time_secs, (verbose > 2) ? verbose : 0);
+    if (res)
+        return res;
+    meth = async_method(ptp->is_sg, ptp->is_bsg, ptp->sg_version);
+    forever = (SCSI_PT_SPIN_FOREVER == ptp->spin_us);
+    end_ns = sg_pt_trace_now_ns() + (1000ULL * ptp->spin_us);
+    do {
+        res = receive_own(ptp, meth, false, &rvp, verbose);
+        if (res)
+            break;
+        if ((! forever) && (sg_pt_trace_now_ns() >= end_ns)) {
+            if (verbose > 4)
+                pr2ws("%s: spin budget of %u us spent, now block\n",
+                      __func__, ptp->spin_us);
+            do {
+                res = receive_own(ptp, meth, true, &rvp, verbose);
+            } while (0 == res);
+            break;
+        }
+    } while (true);
+    if (res < 0)
+        return res;
+    if (rvp != vp) {
+        if (verbose)
+            pr2ws("%s: another command completed, don't mix polled "
+                  "commands with submit_scsi_pt() on one device\n",
+                  __func__);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    return 0;
+}
+
+/* Reaps up to max_num completions from fd. Returns number reaped or a
+ * negated errno. */
+int
+receive_scsi_pt(int fd, struct sg_pt_base ** vpp, int max_num, int wait_ms,
+                int verbose)
+{
+    bool is_sg, is_bsg, blocking;
+    int k, res, fl, err;
+    enum sg_pt_async_t meth;
+    struct stat a_stat;
+    struct pollfd a_pollfd;
+
+    if ((NULL == vpp) || (max_num < 1) || (fd < 0)) {
+        if (verbose)
+            pr2ws("%s: bad arguments\n", __func__);
+        return -EINVAL;
+    }
+    if (! sg_bsg_nvme_char_major_checked) {
+        sg_bsg_nvme_char_major_checked = true;
+        sg_find_bsg_nvme_char_major(verbose);
+    }
+    is_sg = check_file_type(fd, &a_stat, &is_bsg, NULL, NULL, &err, verbose);
+    if (err)
+        return -err;
+    meth = async_method(is_sg, is_bsg, sg_driver_version_num);
+    if (SG_PT_ASYNC_NONE == meth) {
+        res = sg_emul_receive(fd, vpp, max_num, wait_ms, verbose);
+        if (-ENOTTY != res)
+            return res;
+        res = sg_uring_receive(fd, vpp, max_num, wait_ms, verbose);
+        if ((-ENOTTY == res) && verbose)
+            pr2ws("%s: nothing submitted to this device\n", __func__);
+        return res;
+    }
+    a_pollfd.fd = fd;
+    a_pollfd.events = POLLIN;
+    if (0 != wait_ms) {
+        a_pollfd.revents = 0;
+        res = poll(&a_pollfd, 1, (wait_ms < 0) ? -1 : wait_ms);
+        if (res < 0) {
+            err = errno;
+            if (verbose > 1)
+                pr2ws("%s: poll() failed: %s\n", __func__,
+                      safe_strerror(err));
+            return -err;
+        } else if (0 == res)
+            return 0;           /* timed out, nothing waiting */
+    }
+    fl = fcntl(fd, F_GETFL);
+    blocking = (fl >= 0) && (0 == (O_NONBLOCK & fl)) &&
+               (SG_PT_ASYNC_SG_V4 != meth);
+    for (k = 0; k < max_num; ++k) {
+        if (blocking && ((k > 0) || (0 == wait_ms))) {
+            /* don't let read() block on a blocking fd */
+            a_pollfd.revents = 0;
+            res = poll(&a_pollfd, 1, 0);
+            if (res <= 0)
+                break;
+        }
+        res = receive_one(fd, meth, vpp + k, verbose);
+        if (res < 0)
+            return (k > 0) ? k : res;
+        else if (0 == res)
+            break;
+    }
+    return k;
+}
+
+/* Returns the number of completions waiting on fd, 1 if at least one is
+ * waiting but the exact number cannot be determined, 0 if none, else a
+ * negated errno. */
+int
+poll_scsi_pt(int fd, int verbose)
+{
+    bool is_sg;
+    int res, err, num_waiting;
+    struct stat a_stat;
+    struct pollfd a_pollfd;
+
+    if (! sg_bsg_nvme_char_major_checked) {
+        sg_bsg_nvme_char_major_checked = true;
+        sg_find_bsg_nvme_char_major(verbose);
+    }
+    is_sg = check_file_type(fd, &a_stat, NULL, NULL, NULL, &err, verbose);
+    if (err)
+        return -err;
+    if (is_sg) {
+        if (ioctl(fd, SG_GET_NUM_WAITING, &num_waiting) < 0) {
+            err = errno;
+            if (verbose > 1)
+                pr2ws("%s: ioctl(SG_GET_NUM_WAITING) failed: %s\n",
+                      __func__, safe_strerror(err));
+            return -err;
+        }
+        return num_waiting;
+    }
+    res = sg_emul_poll(fd, verbose);
+    if (-ENOTTY != res)
+        return res;
+    res = sg_uring_poll(fd, verbose);
+    if (-ENOTTY != res)
+        return res;
+    a_pollfd.fd = fd;
+    a_pollfd.events = POLLIN;
+    a_pollfd.revents = 0;
+    res = poll(&a_pollfd, 1, 0);
+    if (res < 0)
+        return -errno;
+    return (res > 0) ? 1 : 0;
+}
+
+int
+register_pt_async_buffers(int fd, uint8_t * const * bufpp,
+                          const uint32_t * buf_lens, int num, int verbose)
+{
+    bool is_sg, is_bsg, is_nvme;
+    int err;
+    uint32_t nsid;
+    struct stat a_stat;
+
+    if ((num < 0) || ((num > 0) && ((NULL == bufpp) || (NULL == buf_lens))))
+        return -EINVAL;
+    if (! sg_bsg_nvme_char_major_checked) {
+        sg_bsg_nvme_char_major_checked = true;
+        sg_find_bsg_nvme_char_major(verbose);
+    }
+    is_sg = check_file_type(fd, &a_stat, &is_bsg, &is_nvme, &nsid, &err,
+                            verbose);
+    if (err)
+        return -err;
+    if (is_sg || is_bsg) {
+        if (verbose > 1)
+            pr2ws("%s: not needed by sg nor bsg devices\n", __func__);
+        return SCSI_PT_DO_NOT_SUPPORTED;
+    }
+    if (sg_emul_dev_type(fd, NULL))
+        return 0;       /* emulated devices use caller's buffers directly */
+    return sg_uring_register_bufs(fd, is_nvme, nsid, bufpp, buf_lens, num,
+                                  verbose);
+}
+
+/* Linux multiple request (mrq) object. When the sg driver supports it, the
+ * sg v4 headers of all the objects in the batch are copied into hdr_arr
+ * and sent with a single ioctl(SG_IO) whose controlling object has
+ * SGV4_FLAG_MULTIPLE_REQS set. The sg driver places the responses back in
+ * hdr_arr. */
+struct sg_pt_mrq {
+    int dev_fd;
+    int max_num;
+    int num;
+    struct sg_pt_base ** objpp;
+    struct sg_io_v4 * hdr_arr;
+};
+
+struct sg_pt_mrq *
+construct_pt_mrq_obj(int dev_fd, int max_num, int verbose)
+{
+    struct sg_pt_mrq * mrqp;
+
+    if (max_num < 1) {
+        if (verbose)
+            pr2ws("%s: max_num must be 1 or more\n", __func__);
+        return NULL;
+    }
+    mrqp = (struct sg_pt_mrq *)calloc(1, sizeof(*mrqp));
+    if (mrqp) {
+        mrqp->objpp = (struct sg_pt_base **)calloc(max_num,
+                                                   sizeof(mrqp->objpp[0]));
+        mrqp->hdr_arr = (struct sg_io_v4 *)calloc(max_num,
+                                                  sizeof(struct sg_io_v4));
+        if ((NULL == mrqp->objpp) || (NULL == mrqp->hdr_arr)) {
+            destruct_pt_mrq_obj(mrqp);
+            mrqp = NULL;
+        } else {
+            mrqp->dev_fd = dev_fd;
+            mrqp->max_num = max_num;
+        }
+    }
+    if ((NULL == mrqp) && verbose)
+        pr2ws("%s: calloc() failed, out of memory?\n", __func__);
+    return mrqp;
+}
+
+int
+add_pt_mrq_elem(struct sg_pt_mrq * mrqp, struct sg_pt_base * objp)
+{
+    if ((NULL == objp) || (mrqp->num >= mrqp->max_num))
+        return -1;
+    mrqp->objpp[mrqp->num] = objp;
+    return mrqp->num++;
+}
+
+int
+get_pt_mrq_num(const struct sg_pt_mrq * mrqp)
+{
+    return mrqp->num;
+}
+
+struct sg_pt_base *
+get_pt_mrq_elem(const struct sg_pt_mrq * mrqp, int index)
+{
+    return ((index < 0) || (index >= mrqp->num)) ? NULL :
+                                                   mrqp->objpp[index];
+}
+
+void
+clear_pt_mrq_obj(struct sg_pt_mrq * mrqp)
+{
+    mrqp->num = 0;
+}
+
+void
+destruct_pt_mrq_obj(struct sg_pt_mrq * mrqp)
+{
+    if (mrqp) {
+        if (mrqp->objpp)
+            free(mrqp->objpp);
+        if (mrqp->hdr_arr)
+            free(mrqp->hdr_arr);
+        free(mrqp);
+    }
+}
+
+/* Sends every command in the batch. Uses one ioctl(SG_IO) with
+ * SGV4_FLAG_MULTIPLE_REQS when dev_fd is a sg device whose driver is
+ * version 4.0.30 or later. Otherwise calls do_scsi_pt() on each object,
+ * placing any error in that object's os_err, and returns the first
+ * non-zero do_scsi_pt() result. */
+int
+do_pt_mrq(struct sg_pt_mrq * mrqp, int time_secs, int verbose)
+{
+    bool is_sg, is_bsg, is_nvme;
+    int k, err, res, num_done;
+    int nrq = mrqp->num;
+    uint32_t nsid;
+    struct sg_pt_base * vp;
+    struct sg_pt_linux_scsi * ptp;
+    struct sg_io_v4 * h4p;
+    struct stat a_stat;
+    struct sg_io_v4 ctl_v4;
+
+    if (nrq < 1)
+        return 0;
+    if (! sg_bsg_nvme_char_major_checked) {
+        sg_bsg_nvme_char_major_checked = true;
+        sg_find_bsg_nvme_char_major(verbose);
+    }
+    is_sg = check_file_type(mrqp->dev_fd, &a_stat, &is_bsg, &is_nvme, &nsid,
+                            &err, verbose);
+    if (err)
+        return -err;
+#ifdef IGNORE_LINUX_SGV4
+    is_sg = false;
+#endif
+    if ((! is_sg) || (sg_driver_version_num < SG_LINUX_SG_VER_V4_FULL)) {
+        if (verbose > 2)
+            pr2ws("%s: no mrq support, so issue each of %d commands in "
+                  "turn\n", __func__, nrq);
+        for (k = 0, err = 0; k < nrq; ++k) {
+            res = do_scsi_pt(mrqp->objpp[k], mrqp->dev_fd, time_secs,
+                             verbose);
+            if (0 == res)
+                continue;
+            /* positive SCSI_PT_DO_* values mean the command was not sent */
+            mrqp->objpp[k]->impl.os_err = (res < 0) ? -res : EINVAL;
+            if (0 == err)
+                err = res;
+        }
+        return err;
+    }
+    for (k = 0; k < nrq; ++k) {
+        vp = mrqp->objpp[k];
+        ptp = &vp->impl;
+        err = check_pt_fd(vp, mrqp->dev_fd, verbose);
+        if (err)
+            return err;
+        if (0 == ptp->io_hdr.request) {
+            if (verbose)
+                pr2ws("%s: No SCSI command (cdb) given in element %d\n",
+                      __func__, k);
+            return SCSI_PT_DO_BAD_PARAMS;
+        }
+        ptp->io_hdr.timeout = ((time_secs > 0) ? (time_secs * 1000) :
+                                                 DEF_TIMEOUT);
+        ptp->io_hdr.usr_ptr = (__u64)(sg_uintptr_t)vp;
+        mrqp->hdr_arr[k] = ptp->io_hdr;
+    }
+    memset(&ctl_v4, 0, sizeof(ctl_v4));
+    ctl_v4.guard = 'Q';
+    ctl_v4.flags = SGV4_FLAG_MULTIPLE_REQS;
+    ctl_v4.dout_xferp = (__u64)(sg_uintptr_t)mrqp->hdr_arr; /* requests */
+    ctl_v4.dout_xfer_len = nrq * sizeof(struct sg_io_v4);
+    ctl_v4.din_xferp = (__u64)(sg_uintptr_t)mrqp->hdr_arr;  /* responses */
+    ctl_v4.din_xfer_len = nrq * sizeof(struct sg_io_v4);
+    if (ioctl(mrqp->dev_fd, SG_IO, &ctl_v4) < 0) {
+        err = errno;
+        if (verbose > 1)
+            pr2ws("ioctl(SG_IO, MULTIPLE_REQS) failed: %s (errno=%d)\n",
+                  safe_strerror(err), err);
+        for (k = 0; k < nrq; ++k)
+            mrqp->objpp[k]->impl.os_err = err;
+        return -err;
+    }
+    /* ctl_v4.info is the number of requests completed */
+    num_done = ((int)ctl_v4.info < nrq) ? (int)ctl_v4.info : nrq;
+    if ((num_done < nrq) && (verbose > 1))
+        pr2ws("%s: only %d of %d requests completed\n", __func__, num_done,
+              nrq);
+    for (k = 0; k < nrq; ++k)   /* mark all, completed ones cleared below */
+        mrqp->objpp[k]->impl.os_err = ECANCELED;
+    for (k = 0, h4p = mrqp->hdr_arr; k < num_done; ++k, ++h4p) {
+        vp = (struct sg_pt_base *)(sg_uintptr_t)h4p->usr_ptr;
+        if (NULL == vp)
+            continue;
+        vp->impl.os_err = 0;
+        v4_resp_to_ptp(&vp->impl, h4p);
+    }
+    return 0;
+}
@@ -0,0 +1,2119 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_pt_linux_emul version 1.02 20261017 */
+
+/* This file contains a user space emulated storage device that sits behind
+ * the sg_pt interface. It allows the utilities (and the library) to be
+ * exercised without real hardware or the scsi_debug kernel module. The
+ * medium is a regular (usually sparse) file, called the backing file.
+ *
+ * An emulated device is selected in one of two ways:
+ *   a) a device name of the form 'emul:PATH[,OPT[,OPT...]]' given to
+ *      scsi_pt_open_device() or scsi_pt_open_flags(). PATH is created if
+ *      it doesn't exist (so PATH may not contain a comma).
+ *   b) the SG3_UTILS_EMUL environment variable is set, in which case
+ *      every regular file opened by those functions is emulated. The value
+ *      of the environment variable is the (possibly empty) list of OPTs.
+ * The options (OPTs) are:
+ *   lat=US     each command takes at least US microseconds (def: 0)
+ *   lbs=LBS    logical block size in bytes, a power of 2 from 512 to
+ *              65536 (def: 512)
+ *   nvme       emulate a NVMe namespace (nsid=1) rather than a SCSI disk.
+ *              SCSI commands then pass through this library's SNTL
+ *   qd=QD      queue depth (def: 32). Commands beyond this in flight are
+ *              completed with TASK SET FULL status (or -EAGAIN from
+ *              submit_scsi_pt() )
+ *   size=SZ    capacity in bytes, multipliers like 'g' accepted. The
+ *              backing file is extended (sparsely) if needed. When not
+ *              given, the backing file's size is used or, if that is
+ *              zero, 1 GiB
+ *   zconv=NC   number of conventional zones at start of a zoned SCSI
+ *              device
+ *   zsize=ZS   zone size in logical blocks; makes the SCSI device a ZBC
+ *              host managed device with sequential write required zones,
+ *              or the NVMe namespace a zoned (ZNS) namespace
+ *
+ * A SCSI device implements INQUIRY (with VPD pages 0x0, 0x80, 0x83, 0xb0,
+ * 0xb1, 0xb2 and, when zoned, 0xb6), READ CAPACITY(10,16), READ(10,16),
+ * WRITE(10,16), VERIFY(10,16), UNMAP, WRITE SAME(10,16), SYNCHRONIZE
+ * CACHE(10,16), GET LBA STATUS, REPORT ZONES, the ZBC OUT zone actions,
+ * REPORT LUNS, REQUEST SENSE, START STOP UNIT and TEST UNIT READY.
+ * UNMAP, and WRITE SAME with the UNMAP bit, punch holes in the backing
+ * file and GET LBA STATUS reports those holes as deallocated.
+ *
+ * A NVMe device implements the Identify, Get Features, Get Log Page and
+ * Format NVM (which deallocates every LB) Admin commands plus the Flush,
+ * Write, Read, Compare, Write Zeroes and Dataset Management NVM commands.
+ * When zoned it also implements the Zone Management Send and Zone
+ * Management Receive (Report Zones) commands.
+ *
+ * As each command line utility opens the device afresh, zone state is
+ * kept in PATH.zones beside the backing file: the write pointer of each
+ * zone and those conditions that can't be recovered from the backing file
+ * (explicitly open, and full). Zone actions are saved as they happen,
+ * write pointers moved by writes when the device is closed. If PATH.zones
+ * can't be written zone state is kept for the life of the process. When
+ * opened, a write pointer is the greater of that saved and where the data
+ * in that zone of the backing file ends; implicitly open zones come back
+ * closed, as after a power cycle. The asynchronous queue of a device (see submit_scsi_pt() )
+ * should only be used by one thread at a time.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1          /* for fallocate(), SEEK_DATA and SEEK_HOLE */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sched.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <linux/falloc.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_pt.h"
+#include "sg_lib.h"
+#include "sg_linux_inc.h"
+#include "sg_pt_linux.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+#define SG_EMUL_MAX_FD 1024             /* emulate fds below this */
+#define SG_EMUL_DEF_SIZE (1024LL * 1024 * 1024)
+#define SG_EMUL_DEF_LBS 512
+#define SG_EMUL_DEF_QD 32
+#define SG_EMUL_MAX_QD 4096
+#define SG_EMUL_BUF_SZ (256 * 1024)     /* for WRITE SAME and zeroing */
+#define SG_EMUL_NSID 1
+#define SG_EMUL_ZST_SUFFIX ".zones"     /* file of saved zone conditions */
+#define SG_EMUL_ZST_MAGIC "SGEMULZ1"
+#define SG_EMUL_ZST_HDR 16              /* magic, zone size, num zones */
+#define SG_EMUL_ZST_REC 8       /* per zone: be32 WP offset, condition */
+
+#define SCSI_TEST_UNIT_READY_OPC 0x0
+#define SCSI_REQUEST_SENSE_OPC 0x3
+#define SCSI_INQUIRY_OPC 0x12
+#define SCSI_START_STOP_OPC 0x1b
+#define SCSI_READ_CAPACITY10_OPC 0x25
+#define SCSI_READ10_OPC 0x28
+#define SCSI_WRITE10_OPC 0x2a
+#define SCSI_VERIFY10_OPC 0x2f
+#define SCSI_SYNC_CACHE10_OPC 0x35
+#define SCSI_WRITE_SAME10_OPC 0x41
+#define SCSI_UNMAP_OPC 0x42
+#define SCSI_READ16_OPC 0x88
+#define SCSI_WRITE16_OPC 0x8a
+#define SCSI_VERIFY16_OPC 0x8f
+#define SCSI_SYNC_CACHE16_OPC 0x91
+#define SCSI_WRITE_SAME16_OPC 0x93
+#define SCSI_ZBC_OUT_OPC 0x94
+#define SCSI_ZBC_IN_OPC 0x95
+#define SCSI_SERVICE_ACT_IN_OPC 0x9e
+#define SCSI_REPORT_LUNS_OPC 0xa0
+
+#define SCSI_READ_CAPACITY16_SA 0x10
+#define SCSI_GET_LBA_STATUS_SA 0x12
+#define SCSI_REPORT_ZONES_SA 0x0
+#define SCSI_CLOSE_ZONE_SA 0x1
+#define SCSI_FINISH_ZONE_SA 0x2
+#define SCSI_OPEN_ZONE_SA 0x3
+#define SCSI_RESET_WP_SA 0x4
+#define SCSI_SA_MSK 0x1f
+
+#define MEDIUM_ERR_READ_ASC 0x11
+#define WRITE_ERR_ASC 0xc
+#define MISCOMPARE_VERIFY_ASC 0x1d
+#define PARAMETER_LIST_LENGTH_ERR 0x1a
+#define INVALID_OPCODE 0x20
+#define LBA_OUT_OF_RANGE 0x21
+#define UNALIGNED_WRITE_ASCQ 0x4        /* with LBA_OUT_OF_RANGE */
+#define WRITE_BOUNDARY_ASCQ 0x5         /* with LBA_OUT_OF_RANGE */
+#define INVALID_FIELD_IN_CDB 0x24
+#define INVALID_FIELD_IN_PARAM_LIST 0x26
+#define WRITE_PROTECTED 0x27
+
+#define PDT_DISK 0x0
+#define PDT_ZBC 0x14
+
+/* ZBC zone types and zone conditions */
+#define ZT_CONV 0x1
+#define ZT_SEQ_REQ 0x2
+#define ZC_NOT_WP 0x0
+#define ZC_EMPTY 0x1
+#define ZC_IMP_OPEN 0x2
+#define ZC_EXP_OPEN 0x3
+#define ZC_CLOSED 0x4
+#define ZC_FULL 0xe
+
+/* NVMe Admin and NVM command set opcodes */
+#define NVME_ADM_GET_LOG_PAGE 0x2
+#define NVME_ADM_IDENTIFY 0x6
+#define NVME_ADM_GET_FEATURES 0xa
+#define NVME_ADM_FORMAT_NVM 0x80
+#define NVME_NVM_FLUSH 0x0
+#define NVME_NVM_WRITE 0x1
+#define NVME_NVM_READ 0x2
+#define NVME_NVM_COMPARE 0x5
+#define NVME_NVM_WRITE_ZEROES 0x8
+#define NVME_NVM_DSM 0x9
+#define NVME_NVM_ZONE_MGMT_SEND 0x79
+#define NVME_NVM_ZONE_MGMT_RECV 0x7a
+
+/* NVMe status is ((SCT << 8) | SC) with DNR (bit 14) set on errors */
+#define NVME_ST(sct, sc) (0x4000 | ((sct) << 8) | (sc))
+#define NVME_SC_INVALID_OPCODE NVME_ST(0, 0x1)
+#define NVME_SC_INVALID_FIELD NVME_ST(0, 0x2)
+#define NVME_SC_DATA_XFER_ERR NVME_ST(0, 0x4)
+#define NVME_SC_INVALID_NS NVME_ST(0, 0xb)
+#define NVME_SC_INVALID_FORMAT NVME_ST(1, 0xa)
+#define NVME_SC_LBA_RANGE NVME_ST(0, 0x80)
+#define NVME_SC_WRITE_FAULT NVME_ST(2, 0x80)
+#define NVME_SC_READ_ERR NVME_ST(2, 0x81)
+#define NVME_SC_COMPARE_FAILED NVME_ST(2, 0x85)
+#define NVME_SC_READ_ONLY NVME_ST(1, 0x82)
+#define NVME_SC_ZONE_BOUNDARY NVME_ST(1, 0xb8)
+#define NVME_SC_ZONE_FULL NVME_ST(1, 0xb9)
+#define NVME_SC_ZONE_INVALID_WRITE NVME_ST(1, 0xbc)
+
+struct sg_emul_zone {
+    uint64_t start;     /* first LBA in zone */
+    uint64_t wp;        /* write pointer (LBA) */
+    uint8_t type;       /* ZT_* value */
+    uint8_t cond;       /* ZC_* value */
+};
+
+/* An asynchronous command that has been executed but whose completion is
+ * held back until due_ns to honour the lat= option */
+struct sg_emul_done {
+    struct sg_pt_base * vp;
+    uint64_t due_ns;
+};
+
+struct sg_emul {
+    bool is_nvme;
+    int fd;
+    int lb_shift;       /* log2(lb_sz) */
+    int inflight;       /* commands in flight, updated atomically */
+    uint32_t lb_sz;     /* logical block size in bytes */
+    uint32_t lat_us;
+    uint32_t qd;
+    uint32_t zone_lbs;  /* zone size in LBs, 0 if not zoned */
+    uint32_t num_zones;
+    uint32_t num_conv;  /* number of conventional zones (at start) */
+    uint32_t done_head;
+    uint32_t done_num;
+    uint64_t num_lbs;
+    uint64_t ident;     /* from backing file's st_ino, for serial numbers */
+    uint8_t zlock;      /* spinlock for zones[] */
+    bool zst_dirty;     /* zst[] has write pointers not yet saved */
+    int zst_fd;         /* saved zone state, -1 if none */
+    uint8_t * zst;      /* SG_EMUL_ZST_REC bytes of state per zone */
+    struct sg_emul_zone * zones;
+    struct sg_emul_done * done_arr;     /* circular, qd elements */
+};
+
+static struct sg_emul * sg_emul_arr[SG_EMUL_MAX_FD];
+
+static const char * emul_vendor = "SG3UTILS";
+static const char * emul_prod_disk = "EMUL DISK       ";
+static const char * emul_prod_zbc = "EMUL ZBC DISK   ";
+static const char * emul_nvme_mn = "sg3_utils emulated NVMe";
+static const char * emul_rev = "1.00";
+
+
+static struct sg_emul *
+emul_find(int fd)
+{
+    if ((fd < 0) || (fd >= SG_EMUL_MAX_FD))
+        return NULL;
+    return __atomic_load_n(sg_emul_arr + fd, __ATOMIC_ACQUIRE);
+}
+
+static void
+emul_free(struct sg_emul * ep)
+{
+    if (ep->zst_fd >= 0) {
+        if (ep->zst_dirty &&
+            (pwrite(ep->zst_fd, ep->zst,
+                    (size_t)ep->num_zones * SG_EMUL_ZST_REC,
+                    SG_EMUL_ZST_HDR) < 0))
+            pr2ws("emul: unable to save zone state: %s\n",
+                  safe_strerror(errno));
+        close(ep->zst_fd);
+    }
+    if (ep->zst)
+        free(ep->zst);
+    if (ep->zones)
+        free(ep->zones);
+    if (ep->done_arr)
+        free(ep->done_arr);
+    free(ep);
+}
+
+static void
+zone_lock(struct sg_emul * ep)
+{
+    while (__atomic_test_and_set(&ep->zlock, __ATOMIC_ACQUIRE))
+        sched_yield();
+}
+
+static void
+zone_unlock(struct sg_emul * ep)
+{
+    __atomic_clear(&ep->zlock, __ATOMIC_RELEASE);
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void
+sleep_until_ns(uint64_t due_ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = due_ns / 1000000000;
+    ts.tv_nsec = due_ns % 1000000000;
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+                                    NULL))
+        ;
+}
+
+/* Parses the comma separated options in opts. Returns 0 if okay, else
+ * -EINVAL . */
+static int
+emul_parse_opts(struct sg_emul * ep, const char * opts, int64_t * sizep,
+                int vb)
+{
+    int64_t ll;
+    const char * cp;
+    const char * ncp;
+
+    for (cp = opts; cp && *cp; cp = ncp) {
+        ncp = strchr(cp, ',');
+        if (ncp)
+            ++ncp;
+        if (',' == *cp)
+            continue;
+        if ((0 == strncmp(cp, "nvme", 4)) && ((',' == cp[4]) ||
+                                              ('\0' == cp[4]))) {
+#if (HAVE_NVME && (! IGNORE_NVME))
+            ep->is_nvme = true;
+            continue;
+#else
+            pr2ws("emul: NVMe support not built\n");
+            return -EINVAL;
+#endif
+        }
+        if (0 == strncmp(cp, "lat=", 4)) {
+            ll = sg_get_llnum(cp + 4);
+            if ((ll < 0) || (ll > 10000000))
+                goto bad_num;
+            ep->lat_us = (uint32_t)ll;
+        } else if (0 == strncmp(cp, "lbs=", 4)) {
+            ll = sg_get_llnum(cp + 4);
+            if ((ll < 512) || (ll > 65536) || (ll & (ll - 1)))
+                goto bad_num;
+            ep->lb_sz = (uint32_t)ll;
+        } else if (0 == strncmp(cp, "qd=", 3)) {
+            ll = sg_get_llnum(cp + 3);
+            if ((ll < 1) || (ll > SG_EMUL_MAX_QD))
+                goto bad_num;
+            ep->qd = (uint32_t)ll;
+        } else if (0 == strncmp(cp, "size=", 5)) {
+            ll = sg_get_llnum(cp + 5);
+            if (ll < 1)
+                goto bad_num;
+            *sizep = ll;
+        } else if (0 == strncmp(cp, "zconv=", 6)) {
+            ll = sg_get_llnum(cp + 6);
+            if ((ll < 0) || (ll > UINT32_MAX))
+                goto bad_num;
+            ep->num_conv = (uint32_t)ll;
+        } else if (0 == strncmp(cp, "zsize=", 6)) {
+            ll = sg_get_llnum(cp + 6);
+            if ((ll < 1) || (ll > UINT32_MAX))
+                goto bad_num;
+            ep->zone_lbs = (uint32_t)ll;
+        } else {
+            pr2ws("emul: unknown option: %s\n", cp);
+            return -EINVAL;
+        }
+        continue;
+bad_num:
+        pr2ws("emul: bad value in option: %s\n", cp);
+        return -EINVAL;
+    }
+    if (ep->is_nvme && ep->num_conv) {
+        pr2ws("emul: conventional zones are only available for SCSI\n");
+        return -EINVAL;
+    }
+    if (vb > 2)
+        pr2ws("emul: nvme=%d lbs=%u lat=%u qd=%u zsize=%u zconv=%u\n",
+              (int)ep->is_nvme, ep->lb_sz, ep->lat_us, ep->qd, ep->zone_lbs,
+              ep->num_conv);
+    return 0;
+}
+
+/* Sets the write pointer of a sequential zone to just after the last
+ * data (i.e. not a hole) in that zone of the backing file. */
+static void
+emul_zone_recover_wp(struct sg_emul * ep, struct sg_emul_zone * zp)
+{
+    off_t off, hole;
+    off_t end = (off_t)(zp->start + ep->zone_lbs) << ep->lb_shift;
+    off_t last = (off_t)zp->start << ep->lb_shift;
+
+    off = lseek(ep->fd, last, SEEK_DATA);
+    while ((off >= 0) && (off < end)) {
+        hole = lseek(ep->fd, off, SEEK_HOLE);
+        if (hole < 0)
+            break;
+        last = (hole < end) ? hole : end;
+        if (last >= end)
+            break;
+        off = lseek(ep->fd, last, SEEK_DATA);
+    }
+    zp->wp = (last + ep->lb_sz - 1) >> ep->lb_shift;
+    if (zp->wp == zp->start)
+        zp->cond = ZC_EMPTY;
+    else if (zp->wp >= zp->start + ep->zone_lbs)
+        zp->cond = ZC_FULL;
+    else
+        zp->cond = ZC_CLOSED;
+}
+
+/* Called with the zone lock held after the state of a sequential zone
+ * may have changed. If sync the new state is saved now, otherwise when
+ * the device is closed. */
+static void
+emul_zone_save(struct sg_emul * ep, const struct sg_emul_zone * zp,
+               bool sync)
+{
+    uint8_t * rp;
+    uint8_t rec[SG_EMUL_ZST_REC];
+    uint32_t zn;
+
+    if (NULL == ep->zst)
+        return;
+    memset(rec, 0, sizeof(rec));
+    sg_put_unaligned_be32((uint32_t)(zp->wp - zp->start), rec + 0);
+    if ((ZC_EXP_OPEN == zp->cond) || (ZC_FULL == zp->cond))
+        rec[4] = zp->cond;
+    zn = zp->start / ep->zone_lbs;
+    rp = ep->zst + ((size_t)zn * SG_EMUL_ZST_REC);
+    if (0 == memcmp(rp, rec, sizeof(rec)))
+        return;
+    memcpy(rp, rec, sizeof(rec));
+    if (! sync) {
+        ep->zst_dirty = true;
+        return;
+    }
+    if ((ep->zst_fd >= 0) &&
+        (pwrite(ep->zst_fd, rec, sizeof(rec), SG_EMUL_ZST_HDR +
+                ((off_t)zn * SG_EMUL_ZST_REC)) < (ssize_t)sizeof(rec))) {
+        pr2ws("emul: unable to save zone state: %s\n",
+              safe_strerror(errno));
+        close(ep->zst_fd);
+        ep->zst_fd = -1;        /* carry on, in memory only */
+    }
+}
+
+/* Opens (creating if need be) the file of saved zone state beside the
+ * backing file at path, or that of the backing file open on ep->fd if
+ * path is NULL, and applies the saved state to the recovered zones. */
+static void
+emul_zones_load(struct sg_emul * ep, const char * path, int vb)
+{
+    bool ok = false;
+    int fd, n;
+    uint32_t k, wp_off;
+    size_t len = (size_t)ep->num_zones * SG_EMUL_ZST_REC;
+    const uint8_t * rp;
+    struct sg_emul_zone * zp;
+    uint8_t hdr[SG_EMUL_ZST_HDR];
+    char b[512];
+    char zst_path[sizeof(b) + sizeof(SG_EMUL_ZST_SUFFIX)];
+
+    ep->zst = (uint8_t *)calloc(ep->num_zones, SG_EMUL_ZST_REC);
+    if (NULL == ep->zst)
+        return;
+    if (NULL == path) {
+        snprintf(zst_path, sizeof(zst_path), "/proc/self/fd/%d", ep->fd);
+        n = readlink(zst_path, b, sizeof(b) - 1);
+        if (n <= 0)
+            return;
+        b[n] = '\0';
+        path = b;
+    }
+    snprintf(zst_path, sizeof(zst_path), "%s%s", path, SG_EMUL_ZST_SUFFIX);
+    fd = open(zst_path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fd = open(zst_path, O_RDONLY);
+        if ((fd >= 0) && (vb > 1))
+            pr2ws("emul: %s is read-only, zone state not saved\n",
+                  zst_path);
+    }
+    if (fd < 0) {
+        if (vb > 1)
+            pr2ws("emul: unable to open %s: %s\n", zst_path,
+                  safe_strerror(errno));
+        return;
+    }
+    memcpy(hdr, SG_EMUL_ZST_MAGIC, 8);
+    sg_put_unaligned_be32(ep->zone_lbs, hdr + 8);
+    sg_put_unaligned_be32(ep->num_zones, hdr + 12);
+    if ((pread(fd, b, SG_EMUL_ZST_HDR, 0) == SG_EMUL_ZST_HDR) &&
+        (0 == memcmp(b, hdr, SG_EMUL_ZST_HDR)))
+        ok = (pread(fd, ep->zst, len, SG_EMUL_ZST_HDR) == (ssize_t)len);
+    if (! ok) {     /* new, or for another zone layout, so start again */
+        memset(ep->zst, 0, len);
+        if ((ftruncate(fd, 0) < 0) ||
+            (pwrite(fd, hdr, SG_EMUL_ZST_HDR, 0) < SG_EMUL_ZST_HDR)) {
+            close(fd);  /* likely read-only, keep state in memory */
+            return;
+        }
+        ep->zst_dirty = true;
+    }
+    ep->zst_fd = fd;
+    for (k = ep->num_conv, zp = ep->zones + k; k < ep->num_zones; ++k, ++zp) {
+        rp = ep->zst + ((size_t)k * SG_EMUL_ZST_REC);
+        wp_off = sg_get_unaligned_be32(rp + 0);
+        if ((ZC_FULL == rp[4]) || (wp_off >= ep->zone_lbs)) {
+            zp->wp = zp->start + ep->zone_lbs;
+            zp->cond = ZC_FULL;
+        } else {
+            if (zp->wp < (zp->start + wp_off)) {
+                zp->wp = zp->start + wp_off;    /* e.g. zeros written */
+                zp->cond = ZC_CLOSED;
+            }
+            if (ZC_EXP_OPEN == rp[4])
+                zp->cond = ZC_EXP_OPEN;
+        }
+        emul_zone_save(ep, zp, false);  /* now as recovered */
+    }
+}
+
+static int
+emul_zones_init(struct sg_emul * ep, const char * path, int vb)
+{
+    uint32_t k;
+    struct sg_emul_zone * zp;
+
+    ep->num_zones = ep->num_lbs / ep->zone_lbs;
+    if (0 == ep->num_zones) {
+        pr2ws("emul: zsize= larger than capacity\n");
+        return -EINVAL;
+    }
+    if (ep->num_conv > ep->num_zones)
+        ep->num_conv = ep->num_zones;
+    ep->num_lbs = (uint64_t)ep->num_zones * ep->zone_lbs;
+    ep->zones = (struct sg_emul_zone *)calloc(ep->num_zones,
+                                              sizeof(*ep->zones));
+    if (NULL == ep->zones)
+        return -ENOMEM;
+    for (k = 0, zp = ep->zones; k < ep->num_zones; ++k, ++zp) {
+        zp->start = (uint64_t)k * ep->zone_lbs;
+        if (k < ep->num_conv) {
+            zp->type = ZT_CONV;
+            zp->cond = ZC_NOT_WP;
+            zp->wp = UINT64_MAX;
+        } else {
+            zp->type = ZT_SEQ_REQ;
+            emul_zone_recover_wp(ep, zp);
+        }
+    }
+    emul_zones_load(ep, path, vb);
+    return 0;
+}
+
+/* Makes fd, which should be open on a regular file, an emulated device
+ * with the given options. If path is non-NULL it is used to extend the
+ * backing file when fd is read-only. Returns 0 on success, -ENODEV if fd
+ * is not a regular file, else another negated errno. */
+int
+sg_emul_attach(int fd, const char * path, const char * opts, int vb)
+{
+    int res;
+    int64_t size = -1;
+    struct sg_emul * ep;
+    struct sg_emul * old_ep;
+    struct stat a_stat;
+
+    if (fstat(fd, &a_stat) < 0)
+        return -errno;
+    if (! S_ISREG(a_stat.st_mode))
+        return -ENODEV;
+    if (fd >= SG_EMUL_MAX_FD) {
+        if (vb)
+            pr2ws("emul: fd=%d too large to emulate\n", fd);
+        return -EMFILE;
+    }
+    ep = (struct sg_emul *)calloc(1, sizeof(*ep));
+    if (NULL == ep)
+        return -ENOMEM;
+    ep->fd = fd;
+    ep->zst_fd = -1;
+    ep->lb_sz = SG_EMUL_DEF_LBS;
+    ep->qd = SG_EMUL_DEF_QD;
+    ep->ident = (uint64_t)a_stat.st_ino;
+    res = emul_parse_opts(ep, opts, &size, vb);
+    if (res)
+        goto err_out;
+    for (ep->lb_shift = 0; (1U << ep->lb_shift) < ep->lb_sz; ++ep->lb_shift)
+        ;
+    if (size < 0)
+        size = a_stat.st_size ? (int64_t)a_stat.st_size : SG_EMUL_DEF_SIZE;
+    if ((size > a_stat.st_size) && (ftruncate(fd, size) < 0) &&
+        ((NULL == path) || (truncate(path, size) < 0)) && (vb > 1))
+        pr2ws("emul: unable to extend backing file: %s\n",
+              safe_strerror(errno));
+    ep->num_lbs = (uint64_t)size >> ep->lb_shift;
+    if (0 == ep->num_lbs) {
+        pr2ws("emul: capacity less than one logical block\n");
+        res = -EINVAL;
+        goto err_out;
+    }
+    if (ep->zone_lbs) {
+        res = emul_zones_init(ep, path, vb);
+        if (res)
+            goto err_out;
+    }
+    ep->done_arr = (struct sg_emul_done *)calloc(ep->qd,
+                                                 sizeof(*ep->done_arr));
+    if (NULL == ep->done_arr) {
+        res = -ENOMEM;
+        goto err_out;
+    }
+    old_ep = __atomic_exchange_n(sg_emul_arr + fd, ep, __ATOMIC_ACQ_REL);
+    if (old_ep)
+        emul_free(old_ep);
+    if (vb > 1)
+        pr2ws("emul: fd=%d is emulated %s, %" PRIu64 " blocks of %u "
+              "bytes\n", fd, ep->is_nvme ? "NVMe namespace" : "SCSI disk",
+              ep->num_lbs, ep->lb_sz);
+    return 0;
+err_out:
+    emul_free(ep);
+    return res;
+}
+
+/* name_opts is the part of a device name after the "emul:" prefix.
+ * Returns file descriptor >= 0 if successful, else a negated errno. */
+int
+sg_emul_open(const char * name_opts, int flags, int vb)
+{
+    int fd, res;
+    size_t len;
+    const char * cp = strchr(name_opts, ',');
+    char * path;
+
+    len = cp ? (size_t)(cp - name_opts) : strlen(name_opts);
+    if (0 == len)
+        return -EINVAL;
+    path = (char *)malloc(len + 1);
+    if (NULL == path)
+        return -ENOMEM;
+    memcpy(path, name_opts, len);
+    path[len] = '\0';
+    fd = open(path, flags | O_CREAT, 0644);
+    if (fd < 0) {
+        fd = -errno;
+        if (vb > 1)
+            pr2ws("%s: open(%s) failed: %s\n", __func__, path,
+                  safe_strerror(-fd));
+        free(path);
+        return fd;
+    }
+    res = sg_emul_attach(fd, path, cp ? cp + 1 : "", vb);
+    free(path);
+    if (res) {
+        close(fd);
+        return (-ENODEV == res) ? -EINVAL : res;
+    }
+    return fd;
+}
+
+/* Forgets the emulated device (if any) on fd */
+void
+sg_emul_release(int fd)
+{
+    struct sg_emul * ep;
+
+    if ((fd < 0) || (fd >= SG_EMUL_MAX_FD))
+        return;
+    ep = __atomic_exchange_n(sg_emul_arr + fd, NULL, __ATOMIC_ACQ_REL);
+    if (ep)
+        emul_free(ep);
+}
+
+/* Returns true if fd is an emulated device. If so, and is_nvme_p is
+ * non-NULL, indicates whether it is a NVMe namespace (nsid=1). */
+bool
+sg_emul_dev_type(int fd, bool * is_nvme_p)
+{
+    const struct sg_emul * ep = emul_find(fd);
+
+    if (ep && is_nvme_p)
+        *is_nvme_p = ep->is_nvme;
+    return !! ep;
+}
+
+/*
+ * Medium access, in common to the SCSI and NVMe emulations. These return
+ * 0 on success or a (positive) errno value.
+ */
+
+static int
+emul_read(const struct sg_emul * ep, uint8_t * bp, uint64_t lba,
+          uint64_t nbytes)
+{
+    ssize_t res;
+    off_t off = (off_t)lba << ep->lb_shift;
+
+    while (nbytes > 0) {
+        res = pread(ep->fd, bp, nbytes, off);
+        if (res < 0) {
+            if (EINTR == errno)
+                continue;
+            return errno;
+        } else if (0 == res) {          /* past end of backing file */
+            memset(bp, 0, nbytes);
+            break;
+        }
+        bp += res;
+        off += res;
+        nbytes -= res;
+    }
+    return 0;
+}
+
+static int
+emul_write(const struct sg_emul * ep, const uint8_t * bp, uint64_t lba,
+           uint64_t nbytes)
+{
+    ssize_t res;
+    off_t off = (off_t)lba << ep->lb_shift;
+
+    while (nbytes > 0) {
+        res = pwrite(ep->fd, bp, nbytes, off);
+        if (res < 0) {
+            if (EINTR == errno)
+                continue;
+            return errno;
+        }
+        bp += res;
+        off += res;
+        nbytes -= res;
+    }
+    return 0;
+}
+
+/* Writes num copies of the logical block at blkp starting at lba */
+static int
+emul_fill(const struct sg_emul * ep, const uint8_t * blkp, uint64_t lba,
+          uint64_t num)
+{
+    int err = 0;
+    uint32_t k, chunk;
+    uint32_t buf_lbs = SG_EMUL_BUF_SZ >> ep->lb_shift;
+    uint8_t * bp;
+
+    if (0 == buf_lbs)
+        buf_lbs = 1;
+    chunk = (num < buf_lbs) ? (uint32_t)num : buf_lbs;
+    bp = (uint8_t *)malloc((size_t)chunk << ep->lb_shift);
+    if (NULL == bp)
+        return ENOMEM;
+    for (k = 0; k < chunk; ++k)
+        memcpy(bp + ((size_t)k << ep->lb_shift), blkp, ep->lb_sz);
+    while ((num > 0) && (0 == err)) {
+        chunk = (num < buf_lbs) ? (uint32_t)num : buf_lbs;
+        err = emul_write(ep, bp, lba, (uint64_t)chunk << ep->lb_shift);
+        lba += chunk;
+        num -= chunk;
+    }
+    free(bp);
+    return err;
+}
+
+/* Zeros num logical blocks starting at lba. When dealloc is true they are
+ * also deallocated (i.e. a hole is punched in the backing file). */
+static int
+emul_zero(const struct sg_emul * ep, uint64_t lba, uint64_t num,
+          bool dealloc)
+{
+    int mode, err;
+    uint8_t * bp;
+
+    if (0 == num)
+        return 0;
+    mode = FALLOC_FL_KEEP_SIZE |
+           (dealloc ? FALLOC_FL_PUNCH_HOLE : FALLOC_FL_ZERO_RANGE);
+    if (0 == fallocate(ep->fd, mode, (off_t)lba << ep->lb_shift,
+                       (off_t)num << ep->lb_shift))
+        return 0;
+    err = errno;
+    if ((EOPNOTSUPP != err) && (ENOSYS != err))
+        return err;
+    bp = (uint8_t *)calloc(1, ep->lb_sz);     /* fall back to writing */
+    if (NULL == bp)
+        return ENOMEM;
+    err = emul_fill(ep, bp, lba, num);
+    free(bp);
+    return err;
+}
+
+/* Compares nbytes at bp with the medium starting at lba. Sets *miscmpp
+ * to true if they differ. */
+static int
+emul_compare(const struct sg_emul * ep, const uint8_t * bp, uint64_t lba,
+             uint64_t nbytes, bool * miscmpp)
+{
+    int err = 0;
+    uint32_t chunk;
+    uint8_t * rbp;
+
+    *miscmpp = false;
+    rbp = (uint8_t *)malloc(SG_EMUL_BUF_SZ);
+    if (NULL == rbp)
+        return ENOMEM;
+    while ((nbytes > 0) && (0 == err)) {
+        chunk = (nbytes < SG_EMUL_BUF_SZ) ? (uint32_t)nbytes :
+                                            SG_EMUL_BUF_SZ;
+        err = emul_read(ep, rbp, lba, chunk);
+        if ((0 == err) && memcmp(rbp, bp, chunk)) {
+            *miscmpp = true;
+            break;
+        }
+        bp += chunk;
+        lba += chunk >> ep->lb_shift;
+        nbytes -= chunk;
+    }
+    free(rbp);
+    return err;
+}
+
+/*
+ * SCSI emulation
+ */
+
+static void
+mk_sense(struct sg_pt_linux_scsi * ptp, int sk, int asc, int ascq)
+{
+    bool dsense = !! ptp->dev_stat.scsi_dsense;
+    uint32_t n;
+    uint8_t sb[20];
+
+    memset(sb, 0, sizeof(sb));
+    ptp->io_hdr.device_status = SAM_STAT_CHECK_CONDITION;
+    sg_build_sense_buffer(dsense, sb, sk, asc, ascq);
+    n = dsense ? 8 : 18;
+    if (n > ptp->io_hdr.max_response_len)
+        n = ptp->io_hdr.max_response_len;
+    if ((n > 0) && ptp->io_hdr.response)
+        memcpy((uint8_t *)(sg_uintptr_t)ptp->io_hdr.response, sb, n);
+    ptp->io_hdr.response_len = n;
+}
+
+static void
+mk_sense_invalid_cdb(struct sg_pt_linux_scsi * ptp)
+{
+    mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_FIELD_IN_CDB, 0);
+}
+
+/* Maps an errno value from accessing the backing file to SCSI sense
+ * data. Returns 0 if sense data is built, else the negated errno. */
+static int
+mk_sense_from_errno(struct sg_pt_linux_scsi * ptp, int err, bool is_read)
+{
+    switch (err) {
+    case EBADF:
+    case EROFS:
+    case EPERM:
+        mk_sense(ptp, SPC_SK_DATA_PROTECT, WRITE_PROTECTED, 0);
+        return 0;
+    case EIO:
+        mk_sense(ptp, SPC_SK_MEDIUM_ERROR,
+                 is_read ? MEDIUM_ERR_READ_ASC : WRITE_ERR_ASC, 0);
+        return 0;
+    default:
+        ptp->os_err = err;
+        return -err;
+    }
+}
+
+/* Copies up to n bytes from src to the data-in buffer, limited by
+ * alloc_len and sets the residual count. */
+static void
+emul_din(struct sg_pt_linux_scsi * ptp, const uint8_t * src, uint32_t n,
+         uint32_t alloc_len)
+{
+    uint32_t len = ptp->io_hdr.din_xfer_len;
+
+    n = (n < alloc_len) ? n : alloc_len;
+    n = (n < len) ? n : len;
+    if (n > 0)
+        memcpy((uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp, src, n);
+    ptp->io_hdr.din_resid = len - n;
+}
+
+static void
+emul_serial(const struct sg_emul * ep, char * b, int b_len)
+{
+    snprintf(b, b_len, "%016" PRIx64, ep->ident);
+}
+
+static int
+emul_inquiry(const struct sg_emul * ep, struct sg_pt_linux_scsi * ptp,
+             const uint8_t * cdbp)
+{
+    bool zoned = !! ep->zone_lbs;
+    int n;
+    uint32_t alloc_len = sg_get_unaligned_be16(cdbp + 3);
+    uint8_t pdt = zoned ? PDT_ZBC : PDT_DISK;
+    uint8_t resp[256];
+    char b[32];
+
+    if (0x2 & cdbp[1]) {                /* CMDDT obsolete */
+        mk_sense_invalid_cdb(ptp);
+        return 0;
+    }
+    memset(resp, 0, sizeof(resp));
+    resp[0] = pdt;
+    if (0 == (0x1 & cdbp[1])) {         /* standard INQUIRY */
+        if (cdbp[2]) {
+            mk_sense_invalid_cdb(ptp);
+            return 0;
+        }
+        resp[2] = 0x7;                  /* SPC-5 */
+        resp[3] = 0x2;                  /* response data format */
+        resp[4] = 36 - 5;
+        resp[7] = 0x2;                  /* CMDQUE */
+        memcpy(resp + 8, emul_vendor, 8);
+        memcpy(resp + 16, zoned ? emul_prod_zbc : emul_prod_disk, 16);
+        memcpy(resp + 32, emul_rev, 4);
+        emul_din(ptp, resp, 36, alloc_len);
+        return 0;
+    }
+    resp[1] = cdbp[2];
+    switch (cdbp[2]) {
+    case 0x0:           /* Supported VPD pages */
+        n = 4;
+        resp[n++] = 0x0;
+        resp[n++] = 0x80;
+        resp[n++] = 0x83;
+        resp[n++] = 0xb0;
+        resp[n++] = 0xb1;
+        resp[n++] = 0xb2;
+        if (zoned)
+            resp[n++] = 0xb6;
+        break;
+    case 0x80:          /* Unit serial number */
+        emul_serial(ep, b, sizeof(b));
+        n = strlen(b);
+        memcpy(resp + 4, b, n);
+        n += 4;
+        break;
+    case 0x83:          /* Device identification */
+        n = 4;
+        resp[n++] = 0x2;                /* ASCII */
+        resp[n++] = 0x1;                /* T10 vendor id, LU association */
+        resp[n++] = 0;
+        resp[n++] = 8 + 16;
+        memcpy(resp + n, emul_vendor, 8);
+        emul_serial(ep, b, sizeof(b));
+        memcpy(resp + n + 8, b, 16);
+        n += 8 + 16;
+        resp[n++] = 0x1;                /* binary */
+        resp[n++] = 0x3;                /* NAA, LU association */
+        resp[n++] = 0;
+        resp[n++] = 8;
+        /* NAA 3 (locally assigned) */
+        sg_put_unaligned_be64((0x3ULL << 60) |
+                              (ep->ident & 0x0fffffffffffffffULL),
+                              resp + n);
+        n += 8;
+        break;
+    case 0xb0:          /* Block limits */
+        n = 0x40;
+        sg_put_unaligned_be32(SG_EMUL_BUF_SZ >> ep->lb_shift,
+                              resp + 12);       /* optimal xfer len */
+        if (! zoned) {
+            sg_put_unaligned_be32(0xffffffff, resp + 20); /* max unmap */
+            sg_put_unaligned_be32(256, resp + 24);  /* max unmap descs */
+            sg_put_unaligned_be32(1, resp + 28);    /* opt unmap gran */
+        }
+        sg_put_unaligned_be64(0xffffffff, resp + 36); /* max write same */
+        break;
+    case 0xb1:          /* Block device characteristics */
+        n = 0x40;
+        sg_put_unaligned_be16(1, resp + 4);     /* non-rotating medium */
+        break;
+    case 0xb2:          /* Logical block provisioning */
+        n = 8;
+        if (! zoned) {
+            resp[5] = 0x80 | 0x40 | 0x20 | 0x4; /* LBPU LBPWS LBPWS10 */
+            resp[6] = 0x2;                      /* thin provisioned */
+        }
+        break;
+    case 0xb6:          /* Zoned block device characteristics */
+        if (! zoned)
+            goto bad_pg;
+        n = 0x40;
+        resp[4] = 0x1;                          /* URSWRZ */
+        sg_put_unaligned_be32(0xffffffff, resp + 8);
+        sg_put_unaligned_be32(0xffffffff, resp + 12);
+        sg_put_unaligned_be32(0xffffffff, resp + 16);
+        break;
+    default:
+bad_pg:
+        mk_sense_invalid_cdb(ptp);
+        return 0;
+    }
+    sg_put_unaligned_be16(n - 4, resp + 2);
+    emul_din(ptp, resp, n, alloc_len);
+    return 0;
+}
+
+static int
+emul_readcap(const struct sg_emul * ep, struct sg_pt_linux_scsi * ptp,
+             const uint8_t * cdbp, bool is_rcap16)
+{
+    uint64_t last_lba = ep->num_lbs - 1;
+    uint8_t resp[32];
+
+    memset(resp, 0, sizeof(resp));
+    if (! is_rcap16) {
+        sg_put_unaligned_be32((last_lba > 0xffffffff) ? 0xffffffff :
+                              (uint32_t)last_lba, resp + 0);
+        sg_put_unaligned_be32(ep->lb_sz, resp + 4);
+        emul_din(ptp, resp, 8, 8);
+        return 0;
+    }
+    sg_put_unaligned_be64(last_lba, resp + 0);
+    sg_put_unaligned_be32(ep->lb_sz, resp + 8);
+    if (ep->zone_lbs)
+        resp[12] = 0x10;                /* RC BASIS: capacity of medium */
+    else
+        resp[14] = 0x80 | 0x40;         /* LBPME LBPRZ */
+    emul_din(ptp, resp, 32, sg_get_unaligned_be32(cdbp + 10));
+    return 0;
+}
+
+/* Checks that a write of num blocks at lba is allowed by the zone model
+ * and, if so, advances the write pointer. Returns 0 if allowed, otherwise
+ * WRITE_BOUNDARY_ASCQ or UNALIGNED_WRITE_ASCQ. */
+static int
+emul_zone_wp_check(struct sg_emul * ep, uint64_t lba, uint64_t num)
+{
+    int ascq = 0;
+    uint32_t zn = lba / ep->zone_lbs;
+    uint32_t last_zn = (lba + num - 1) / ep->zone_lbs;
+    struct sg_emul_zone * zp = ep->zones + zn;
+
+    if (zn < ep->num_conv)
+        return (last_zn >= ep->num_conv) ? WRITE_BOUNDARY_ASCQ : 0;
+    if (last_zn != zn)
+        return WRITE_BOUNDARY_ASCQ;
+    zone_lock(ep);
+    if (lba != zp->wp)
+        ascq = UNALIGNED_WRITE_ASCQ;
+    else {
+        zp->wp += num;
+        if (zp->wp >= zp->start + ep->zone_lbs)
+            zp->cond = ZC_FULL;
+        else if (ZC_EXP_OPEN != zp->cond)
+            zp->cond = ZC_IMP_OPEN;
+        emul_zone_save(ep, zp, ZC_FULL == zp->cond);
+    }
+    zone_unlock(ep);
+    return ascq;
+}
+
+/* Returns true if a write of num blocks at lba is allowed by the zone
+ * model (and advances the write pointer), otherwise builds sense data and
+ * returns false. */
+static bool
+emul_zone_write(struct sg_emul * ep, struct sg_pt_linux_scsi * ptp,
+                uint64_t lba, uint64_t num)
+{
+    int ascq = emul_zone_wp_check(ep, lba, num);
+
+    if (ascq) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, ascq);
+        return false;
+    }
+    return true;
+}
+
+/* Handles READ(10,16), WRITE(10,16) and VERIFY(10,16) */
+static int
+emul_rw(struct sg_emul * ep, struct sg_pt_linux_scsi * ptp,
+        const uint8_t * cdbp, int vb)
+{
+    bool is_16 = (cdbp[0] >= SCSI_READ16_OPC);
+    bool is_read = false;
+    bool miscmp;
+    int err, bytchk;
+    uint64_t lba, num, nbytes;
+    uint32_t xfer_len;
+    uint8_t * bp;
+
+    if (is_16) {
+        lba = sg_get_unaligned_be64(cdbp + 2);
+        num = sg_get_unaligned_be32(cdbp + 10);
+    } else {
+        lba = sg_get_unaligned_be32(cdbp + 2);
+        num = sg_get_unaligned_be16(cdbp + 7);
+    }
+    if ((lba >= ep->num_lbs) || (num > ep->num_lbs - lba)) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0);
+        return 0;
+    }
+    nbytes = num << ep->lb_shift;
+    if (vb > 3)
+        pr2ws("emul: opcode=0x%x lba=0x%" PRIx64 " num=%" PRIu64 "\n",
+              cdbp[0], lba, num);
+    switch (cdbp[0]) {
+    case SCSI_READ10_OPC:
+    case SCSI_READ16_OPC:
+        is_read = true;
+        xfer_len = ptp->io_hdr.din_xfer_len;
+        bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+        if (nbytes > xfer_len)
+            nbytes = xfer_len & ~(uint64_t)(ep->lb_sz - 1);
+        err = emul_read(ep, bp, lba, nbytes);
+        ptp->io_hdr.din_resid = xfer_len - (err ? 0 : nbytes);
+        break;
+    case SCSI_WRITE10_OPC:
+    case SCSI_WRITE16_OPC:
+        xfer_len = ptp->io_hdr.dout_xfer_len;
+        bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+        if (nbytes > xfer_len) {
+            mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_FIELD_IN_CDB, 0);
+            return 0;
+        }
+        if (ep->zone_lbs && (num > 0) &&
+            (! emul_zone_write(ep, ptp, lba, num)))
+            return 0;
+        err = emul_write(ep, bp, lba, nbytes);
+        ptp->io_hdr.dout_resid = xfer_len - (err ? 0 : nbytes);
+        break;
+    default:            /* VERIFY(10,16) */
+        is_read = true;
+        bytchk = (cdbp[1] >> 1) & 0x3;
+        if (0 == bytchk)        /* medium verification, nothing to do */
+            return 0;
+        xfer_len = ptp->io_hdr.dout_xfer_len;
+        bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+        if (0x2 == bytchk) {
+            mk_sense_invalid_cdb(ptp);
+            return 0;
+        }
+        if (xfer_len < ((0x3 == bytchk) ? ep->lb_sz : nbytes)) {
+            mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_FIELD_IN_CDB, 0);
+            return 0;
+        }
+        miscmp = false;
+        if (0x1 == bytchk)
+            err = emul_compare(ep, bp, lba, nbytes, &miscmp);
+        else {          /* one block compared against each in range */
+            for (err = 0; (num > 0) && (0 == err) && (! miscmp);
+                 --num, ++lba)
+                err = emul_compare(ep, bp, lba, ep->lb_sz, &miscmp);
+        }
+        if ((0 == err) && miscmp) {
+            mk_sense(ptp, SPC_SK_MISCOMPARE, MISCOMPARE_VERIFY_ASC, 0);
+            return 0;
+        }
+        break;
+    }
+    return err ? mk_sense_from_errno(ptp, err, is_read) : 0;
+}
+
+static int
+emul_sync_cache(const struct sg_emul * ep, struct sg_pt_linux_scsi * ptp)
+{
+    if (fdatasync(ep->fd) < 0)
+        return mk_sense_from_errno(ptp, errno, false);
+    return 0;
+}
+
+static int
+emul_unmap(const struct sg_emul * ep, struct sg_pt_linux_scsi * ptp,
+           const uint8_t * cdbp)
+{
+    int err;
+    uint32_t k, num_desc, num;
+    uint32_t param_len = sg_get_unaligned_be16(cdbp + 7);
+    uint64_t lba;
+    const uint8_t * bp = (const uint8_t *)(sg_uintptr_t)
+                         ptp->io_hdr.dout_xferp;
+
+    if (ep->zone_lbs) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_OPCODE, 0);
+        return 0;
+    }
+    if (param_len > ptp->io_hdr.dout_xfer_len)
+        param_len = ptp->io_hdr.dout_xfer_len;
+    if (0 == param_len)
+        return 0;
+    if ((param_len < 8) ||
+        (sg_get_unaligned_be16(bp + 2) + 8U > param_len)) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, PARAMETER_LIST_LENGTH_ERR, 0);
+        return 0;
+    }
+    num_desc = sg_get_unaligned_be16(bp + 2) / 16;
+    for (k = 0, bp += 8; k < num_desc; ++k, bp += 16) {
+        lba = sg_get_unaligned_be64(bp + 0);
+        num = sg_get_unaligned_be32(bp + 8);
+        if ((lba >= ep->num_lbs) || (num > ep->num_lbs - lba)) {
+            mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0);
+            return 0;
+        }
+    }
+    bp = (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp + 8;
+    for (k = 0; k < num_desc; ++k, bp += 16) {
+        err = emul_zero(ep, sg_get_unaligned_be64(bp + 0),
+                        sg_get_unaligned_be32(bp + 8), true);
+        if (err)
+            return mk_sense_from_errno(ptp, err, false);
+    }
+    return 0;
+}
+
+static int
+emul_write_same(struct sg_emul * ep, struct sg_pt_linux_scsi * ptp,
+                const uint8_t * cdbp)
+{
+    bool is_16 = (SCSI_WRITE_SAME16_OPC == cdbp[0]);
+    bool unmap = !! (0x8 & cdbp[1]);
+    bool ndob = is_16 && (0x1 & cdbp[1]);
+    bool zeros;
+    int err;
+    uint32_t k;
+    uint64_t lba, num;
+    const uint8_t * bp = (const uint8_t *)(sg_uintptr_t)
+                         ptp->io_hdr.dout_xferp;
+
+    if (is_16) {
+        lba = sg_get_unaligned_be64(cdbp + 2);
+        num = sg_get_unaligned_be32(cdbp + 10);
+    } else {
+        lba = sg_get_unaligned_be32(cdbp + 2);
+        num = sg_get_unaligned_be16(cdbp + 7);
+    }
+    if (lba >= ep->num_lbs) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0);
+        return 0;
+    }
+    if (0 == num)                       /* WSNZ=0 so to end of medium */
+        num = ep->num_lbs - lba;
+    else if (num > ep->num_lbs - lba) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0);
+        return 0;
+    }
+    if ((! ndob) && (ptp->io_hdr.dout_xfer_len < ep->lb_sz)) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_FIELD_IN_CDB, 0);
+        return 0;
+    }
+    zeros = true;
+    for (k = 0; (! ndob) && (k < ep->lb_sz); ++k) {
+        if (bp[k]) {
+            zeros = false;
+            break;
+        }
+    }
+    if (ep->zone_lbs) {
+        if (! emul_zone_write(ep, ptp, lba, num))
+            return 0;
+        unmap = false;
+    }
+    if (zeros)
+        err = emul_zero(ep, lba, num, unmap);
+    else
+        err = emul_fill(ep, bp, lba, num);
+    return err ? mk_sense_from_errno(ptp, err, false) : 0;
+}
+
+/* GET LBA STATUS: reports runs of mapped and deallocated blocks starting
+ * at the given LBA, found with lseek(SEEK_DATA) and lseek(SEEK_HOLE) on
+ * the backing file. Report types 0 (all), 1 and 3 (deallocated) and 2
+ * (mapped) are honoured; others find nothing. */
+static int
+emul_get_lba_status(const struct sg_emul * ep,
+                    struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp)
+{
+    bool mapped, want;
+    int n, max_desc;
+    int rt = cdbp[14];
+    uint32_t alloc_len = sg_get_unaligned_be32(cdbp + 10);
+    uint32_t num;
+    uint64_t lba = sg_get_unaligned_be64(cdbp + 2);
+    uint64_t end;
+    off_t off, next;
+    uint8_t * resp;
+
+    if (lba >= ep->num_lbs) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0);
+        return 0;
+    }
+    if (alloc_len < 24) {
+        emul_din(ptp, (const uint8_t *)"\0\0\0\0\0\0\0\0", 8, alloc_len);
+        return 0;
+    }
+    max_desc = (alloc_len - 8) / 16;
+    if (max_desc > 1024)
+        max_desc = 1024;
+    resp = (uint8_t *)calloc(8 + (16 * max_desc), 1);
+    if (NULL == resp)
+        return -ENOMEM;
+    for (n = 0; (n < max_desc) && (lba < ep->num_lbs); ) {
+        off = (off_t)lba << ep->lb_shift;
+        next = lseek(ep->fd, off, SEEK_DATA);
+        mapped = (next >= 0) && (next < off + (off_t)ep->lb_sz);
+        if (mapped) {
+            next = lseek(ep->fd, off, SEEK_HOLE);
+            end = (next < 0) ? ep->num_lbs :
+                  (((uint64_t)next + ep->lb_sz - 1) >> ep->lb_shift);
+        } else
+            end = (next < 0) ? ep->num_lbs :
+                               ((uint64_t)next >> ep->lb_shift);
+        if (end > ep->num_lbs)
+            end = ep->num_lbs;
+        if (end <= lba)
+            end = lba + 1;
+        if (0 == rt)
+            want = true;
+        else if ((1 == rt) || (3 == rt))
+            want = ! mapped;
+        else
+            want = (2 == rt) && mapped;
+        if (! want) {
+            lba = end;
+            continue;
+        }
+        for ( ; (lba < end) && (n < max_desc); lba += num, ++n) {
+            num = ((end - lba) > 0xffffffff) ? 0xffffffff :
+                                               (uint32_t)(end - lba);
+            sg_put_unaligned_be64(lba, resp + 8 + (16 * n));
+            sg_put_unaligned_be32(num, resp + 8 + (16 * n) + 8);
+            resp[8 + (16 * n) + 12] = mapped ? 0x0 : 0x1;
+        }
+    }
+    sg_put_unaligned_be32(4 + (16 * n), resp + 0);
+    resp[7] = 0x1;                      /* RTP: report type honoured */
+    emul_din(ptp, resp, 8 + (16 * n), alloc_len);
+    free(resp);
+    return 0;
+}
+
+static bool
+zone_matches(const struct sg_emul_zone * zp, int ro)
+{
+    switch (ro) {
+    case 0x0:
+        return true;
+    case 0x1:
+        return ZC_EMPTY == zp->cond;
+    case 0x2:
+        return ZC_IMP_OPEN == zp->cond;
+    case 0x3:
+        return ZC_EXP_OPEN == zp->cond;
+    case 0x4:
+        return ZC_CLOSED == zp->cond;
+    case 0x5:
+        return ZC_FULL == zp->cond;
+    case 0x3f:
+        return ZC_NOT_WP == zp->cond;
+    default:            /* read only, offline, etc: none of those */
+        return false;
+    }
+}
+
+static int
+emul_report_zones(struct sg_emul * ep, struct sg_pt_linux_scsi * ptp,
+                  const uint8_t * cdbp)
+{
+    bool partial = !! (0x80 & cdbp[14]);
+    int ro = 0x3f & cdbp[14];
+    uint32_t k, n, max_desc;
+    uint32_t alloc_len = sg_get_unaligned_be32(cdbp + 10);
+    uint64_t lba = sg_get_unaligned_be64(cdbp + 2);
+    uint8_t * resp;
+    uint8_t * dp;
+    struct sg_emul_zone * zp;
+
+    if (0 == ep->zone_lbs) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_OPCODE, 0);
+        return 0;
+    }
+    if (lba >= ep->num_lbs) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0);
+        return 0;
+    }
+    max_desc = (alloc_len < 64) ? 0 : ((alloc_len - 64) / 64);
+    k = lba / ep->zone_lbs;
+    if (max_desc > ep->num_zones - k)
+        max_desc = ep->num_zones - k;
+    resp = (uint8_t *)calloc(64 + (64 * max_desc), 1);
+    if (NULL == resp)
+        return -ENOMEM;
+    zone_lock(ep);
+    for (n = 0, zp = ep->zones + k; k < ep->num_zones; ++k, ++zp) {
+        if (! zone_matches(zp, ro))
+            continue;
+        if (n < max_desc) {
+            dp = resp + 64 + (64 * n);
+            dp[0] = zp->type;
+            dp[1] = zp->cond << 4;
+            sg_put_unaligned_be64(ep->zone_lbs, dp + 8);
+            sg_put_unaligned_be64(zp->start, dp + 16);
+            sg_put_unaligned_be64(zp->wp, dp + 24);
+        } else if (partial)
+            break;
+        ++n;
+    }
+    zone_unlock(ep);
+    sg_put_unaligned_be32(64 * n, resp + 0);
+    sg_put_unaligned_be64(ep->num_lbs - 1, resp + 8);
+    n = (n < max_desc) ? n : max_desc;
+    emul_din(ptp, resp, 64 + (64 * n), alloc_len);
+    free(resp);
+    return 0;
+}
+
+/* Applies zone action 'sa' to a sequential zone. Returns 0 or a
+ * (positive) errno value. Called with the zone lock held. */
+static int
+emul_zone_action(struct sg_emul * ep, struct sg_emul_zone * zp, int sa,
+                 bool all)
+{
+    int err = 0;
+
+    switch (sa) {
+    case SCSI_CLOSE_ZONE_SA:
+        if ((ZC_IMP_OPEN == zp->cond) || (ZC_EXP_OPEN == zp->cond))
+            zp->cond = (zp->wp == zp->start) ? ZC_EMPTY : ZC_CLOSED;
+        break;
+    case SCSI_FINISH_ZONE_SA:
+        if (all && (ZC_EMPTY == zp->cond))
+            break;
+        zp->wp = zp->start + ep->zone_lbs;
+        zp->cond = ZC_FULL;
+        break;
+    case SCSI_OPEN_ZONE_SA:
+        if (all && (ZC_CLOSED != zp->cond))
+            break;
+        if (ZC_FULL != zp->cond)
+            zp->cond = ZC_EXP_OPEN;
+        break;
+    case SCSI_RESET_WP_SA:
+        if (ZC_EMPTY == zp->cond)
+            break;
+        zp->wp = zp->start;
+        zp->cond = ZC_EMPTY;
+        err = emul_zero(ep, zp->start, ep->zone_lbs, true);
+        break;
+    }
+    emul_zone_save(ep, zp, true);
+    return err;
+}
+
+static int
+emul_zbc_out(struct sg_emul * ep, struct sg_pt_linux_scsi * ptp,
+             const uint8_t * cdbp)
+{
+    bool all = !! (0x1 & cdbp[14]);
+    int err = 0;
+    int sa = SCSI_SA_MSK & cdbp[1];
+    uint32_t k;
+    uint64_t lba = sg_get_unaligned_be64(cdbp + 2);
+
+    if ((0 == ep->zone_lbs) || (sa < SCSI_CLOSE_ZONE_SA) ||
+        (sa > SCSI_RESET_WP_SA)) {
+        mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_OPCODE, 0);
+        return 0;
+    }
+    if ((! all) && ((lba >= ep->num_lbs) || (lba % ep->zone_lbs) ||
+                    ((lba / ep->zone_lbs) < ep->num_conv))) {
+        mk_sense_invalid_cdb(ptp);
+        return 0;
+    }
+    zone_lock(ep);
+    if (all) {
+        for (k = ep->num_conv; (k < ep->num_zones) && (0 == err); ++k)
+            err = emul_zone_action(ep, ep->zones + k, sa, true);
+    } else
+        err = emul_zone_action(ep, ep->zones + (lba / ep->zone_lbs), sa,
+                               false);
+    zone_unlock(ep);
+    return err ? mk_sense_from_errno(ptp, err, false) : 0;
+}
+
+static int
+emul_req_sense(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp)
+{
+    bool desc = !! (0x1 & cdbp[1]);
+    uint8_t resp[20];
+
+    memset(resp, 0, sizeof(resp));
+    sg_build_sense_buffer(desc, resp, SPC_SK_NO_SENSE, 0, 0);
+    emul_din(ptp, resp, desc ? 8 : 18, cdbp[4]);
+    return 0;
+}
+
+static int
+emul_rluns(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp)
+{
+    uint8_t resp[16];
+
+    memset(resp, 0, sizeof(resp));
+    sg_put_unaligned_be32(8, resp + 0);         /* LUN 0 only */
+    emul_din(ptp, resp, 16, sg_get_unaligned_be32(cdbp + 6));
+    return 0;
+}
+
+static int
+emul_scsi_cmd(struct sg_emul * ep, struct sg_pt_linux_scsi * ptp, int vb)
+{
+    int sa;
+    const uint8_t * cdbp = (const uint8_t *)(sg_uintptr_t)
+                           ptp->io_hdr.request;
+
+    switch (cdbp[0]) {
+    case SCSI_TEST_UNIT_READY_OPC:
+    case SCSI_START_STOP_OPC:
+        return 0;
+    case SCSI_REQUEST_SENSE_OPC:
+        return emul_req_sense(ptp, cdbp);
+    case SCSI_INQUIRY_OPC:
+        return emul_inquiry(ep, ptp, cdbp);
+    case SCSI_READ_CAPACITY10_OPC:
+        return emul_readcap(ep, ptp, cdbp, false);
+    case SCSI_READ10_OPC:
+    case SCSI_READ16_OPC:
+    case SCSI_WRITE10_OPC:
+    case SCSI_WRITE16_OPC:
+    case SCSI_VERIFY10_OPC:
+    case SCSI_VERIFY16_OPC:
+        if (ptp->io_hdr.request_len < (uint32_t)((cdbp[0] < 0x80) ? 10 : 16))
+            break;
+        return emul_rw(ep, ptp, cdbp, vb);
+    case SCSI_SYNC_CACHE10_OPC:
+    case SCSI_SYNC_CACHE16_OPC:
+        return emul_sync_cache(ep, ptp);
+    case SCSI_UNMAP_OPC:
+        return emul_unmap(ep, ptp, cdbp);
+    case SCSI_WRITE_SAME10_OPC:
+    case SCSI_WRITE_SAME16_OPC:
+        return emul_write_same(ep, ptp, cdbp);
+    case SCSI_SERVICE_ACT_IN_OPC:
+        sa = SCSI_SA_MSK & cdbp[1];
+        if (SCSI_READ_CAPACITY16_SA == sa)
+            return emul_readcap(ep, ptp, cdbp, true);
+        else if (SCSI_GET_LBA_STATUS_SA == sa)
+            return emul_get_lba_status(ep, ptp, cdbp);
+        break;
+    case SCSI_ZBC_IN_OPC:
+        if (SCSI_REPORT_ZONES_SA == (SCSI_SA_MSK & cdbp[1]))
+            return emul_report_zones(ep, ptp, cdbp);
+        break;
+    case SCSI_ZBC_OUT_OPC:
+        return emul_zbc_out(ep, ptp, cdbp);
+    case SCSI_REPORT_LUNS_OPC:
+        return emul_rluns(ptp, cdbp);
+    default:
+        break;
+    }
+    if (vb > 2) {
+        char b[64];
+
+        sg_get_command_name(cdbp, -1, sizeof(b), b);
+        pr2ws("emul: SCSI %s command not supported\n", b);
+    }
+    mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_OPCODE, 0);
+    return 0;
+}
+
+/*
+ * NVMe emulation
+ */
+
+#if (HAVE_NVME && (! IGNORE_NVME))
+
+static void
+emul_nvme_pad(uint8_t * dp, const char * s, int len)
+{
+    int n = strlen(s);
+
+    n = (n < len) ? n : len;
+    memset(dp, ' ', len);
+    memcpy(dp, s, n);
+}
+
+static int
+emul_nvme_identify(const struct sg_emul * ep,
+                   struct sg_nvme_passthru_cmd * cmdp, uint8_t * dp)
+{
+    int cns = 0xff & cmdp->cdw10;
+    uint32_t n;
+    uint8_t * up;
+    char b[32];
+
+    if ((NULL == dp) || (0 == cmdp->data_len))
+        return NVME_SC_INVALID_FIELD;
+    up = (uint8_t *)calloc(4096, 1);
+    if (NULL == up)
+        return -ENOMEM;
+    switch (cns) {
+    case 0x0:           /* namespace */
+        if (SG_EMUL_NSID != cmdp->nsid) {
+            free(up);
+            return NVME_SC_INVALID_NS;
+        }
+        sg_put_unaligned_le64(ep->num_lbs, up + 0);     /* NSZE */
+        sg_put_unaligned_le64(ep->num_lbs, up + 8);     /* NCAP */
+        sg_put_unaligned_le64(ep->num_lbs, up + 16);    /* NUSE */
+        up[24] = 0x1;           /* NSFEAT: thin provisioning */
+        up[33] = 0x8 | 0x1;     /* DLFEAT: deallocated LBs read zeros */
+        sg_put_unaligned_be64(ep->ident, up + 120);     /* EUI64 */
+        sg_put_unaligned_le32((uint32_t)ep->lb_shift << 16, up + 128);
+        break;
+    case 0x1:           /* controller */
+        emul_serial(ep, b, sizeof(b));
+        emul_nvme_pad(up + 4, b, 20);                   /* SN */
+        emul_nvme_pad(up + 24, emul_nvme_mn, 40);       /* MN */
+        emul_nvme_pad(up + 64, emul_rev, 8);            /* FR */
+        sg_put_unaligned_le32(0x10400, up + 80);        /* VER: 1.4 */
+        up[512] = 0x66;                                 /* SQES */
+        up[513] = 0x44;                                 /* CQES */
+        sg_put_unaligned_le32(1, up + 516);             /* NN */
+        /* ONCS: Compare, Dataset Management, Write Zeroes */
+        sg_put_unaligned_le16(0x1 | 0x4 | 0x8, up + 520);
+        up[525] = 0x1;                                  /* VWC present */
+        break;
+    case 0x2:           /* active namespace list */
+        sg_put_unaligned_le32(SG_EMUL_NSID, up + 0);
+        break;
+    case 0x3:           /* namespace identification descriptor list */
+        if (SG_EMUL_NSID != cmdp->nsid) {
+            free(up);
+            return NVME_SC_INVALID_NS;
+        }
+        up[0] = 0x1;            /* NIDT: EUI64 */
+        up[1] = 8;
+        sg_put_unaligned_be64(ep->ident, up + 4);
+        up[12] = 0x4;           /* NIDT: Command Set Identifier */
+        up[13] = 1;
+        up[16] = ep->zone_lbs ? 0x2 : 0x0;      /* CSI: ZNS or NVM */
+        break;
+    case 0x5:           /* I/O command set specific namespace */
+        if (SG_EMUL_NSID != cmdp->nsid) {
+            free(up);
+            return NVME_SC_INVALID_NS;
+        }
+        if ((0x2 != (cmdp->cdw11 >> 24)) || (0 == ep->zone_lbs)) {
+            free(up);
+            return NVME_SC_INVALID_FIELD;
+        }
+        sg_put_unaligned_le32(0xffffffff, up + 4);      /* MAR: no limit */
+        sg_put_unaligned_le32(0xffffffff, up + 8);      /* MOR: no limit */
+        sg_put_unaligned_le64(ep->zone_lbs, up + 2816); /* LBAFE0: ZSZE */
+        break;
+    default:
+        free(up);
+        return NVME_SC_INVALID_FIELD;
+    }
+    n = (cmdp->data_len < 4096) ? cmdp->data_len : 4096;
+    memcpy(dp, up, n);
+    free(up);
+    return 0;
+}
+
+static int
+emul_nvme_errno(int err, bool is_read)
+{
+    switch (err) {
+    case EBADF:
+    case EROFS:
+    case EPERM:
+        return NVME_SC_READ_ONLY;
+    case EIO:
+        return is_read ? NVME_SC_READ_ERR : NVME_SC_WRITE_FAULT;
+    default:
+        return -err;
+    }
+}
+
+/* Format NVM: deallocates every LB and empties all zones */
+static int
+emul_nvme_format(struct sg_emul * ep)
+{
+    int err;
+    uint32_t k;
+
+    if (ep->zone_lbs) {
+        zone_lock(ep);
+        for (k = 0; k < ep->num_zones; ++k) {
+            ep->zones[k].wp = ep->zones[k].start;
+            ep->zones[k].cond = ZC_EMPTY;
+            emul_zone_save(ep, ep->zones + k, true);
+        }
+        zone_unlock(ep);
+    }
+    err = emul_zero(ep, 0, ep->num_lbs, true);
+    return err ? emul_nvme_errno(err, false) : 0;
+}
+
+static int
+emul_nvme_admin(struct sg_emul * ep, struct sg_nvme_passthru_cmd * cmdp,
+                uint8_t * dp)
+{
+    uint32_t numd;
+
+    switch (cmdp->opcode) {
+    case NVME_ADM_IDENTIFY:
+        return emul_nvme_identify(ep, cmdp, dp);
+    case NVME_ADM_GET_FEATURES:
+        switch (0xff & cmdp->cdw10) {
+        case 0x2:               /* Power Management: state 0 */
+        case 0x7:               /* Number of Queues: 1 of each */
+            cmdp->result = 0;
+            return 0;
+        case 0x6:               /* Volatile Write Cache: enabled */
+            cmdp->result = 1;
+            return 0;
+        default:
+            return NVME_SC_INVALID_FIELD;
+        }
+    case NVME_ADM_FORMAT_NVM:
+        if ((SG_EMUL_NSID != cmdp->nsid) && (0xffffffff != cmdp->nsid))
+            return NVME_SC_INVALID_NS;
+        if (0 != (0xf & cmdp->cdw10))   /* only LBA format 0 */
+            return NVME_SC_INVALID_FORMAT;
+        return emul_nvme_format(ep);
+    case NVME_ADM_GET_LOG_PAGE:
+        switch (0xff & cmdp->cdw10) {
+        case 0x1:               /* Error information */
+        case 0x2:               /* SMART / Health information */
+        case 0x3:               /* Firmware slot information */
+            numd = ((cmdp->cdw10 >> 16) | (cmdp->cdw11 << 16)) + 1;
+            numd *= 4;
+            if ((NULL == dp) || (numd > cmdp->data_len))
+                return NVME_SC_INVALID_FIELD;
+            memset(dp, 0, numd);
+            if ((0x2 == (0xff & cmdp->cdw10)) && (numd > 2))
+                sg_put_unaligned_le16(300, dp + 1);     /* Kelvin */
+            return 0;
+        default:
+            return NVME_SC_INVALID_FIELD;
+        }
+    default:
+        return NVME_SC_INVALID_OPCODE;
+    }
+}
+
+/* Zone Management Send. The Close, Finish, Open and Reset Zone Send
+ * Action values are the same as the corresponding ZBC OUT service
+ * actions. */
+static int
+emul_nvme_zm_send(struct sg_emul * ep,
+                  const struct sg_nvme_passthru_cmd * cmdp)
+{
+    bool all = !! (0x100 & cmdp->cdw13);        /* Select All */
+    int err = 0;
+    int zsa = 0xff & cmdp->cdw13;
+    uint32_t k;
+    uint64_t slba = ((uint64_t)cmdp->cdw11 << 32) | cmdp->cdw10;
+
+    if ((zsa < SCSI_CLOSE_ZONE_SA) || (zsa > SCSI_RESET_WP_SA))
+        return NVME_SC_INVALID_FIELD;
+    if ((! all) && ((slba >= ep->num_lbs) || (slba % ep->zone_lbs)))
+        return NVME_SC_INVALID_FIELD;
+    zone_lock(ep);
+    if (all) {
+        for (k = 0; (k < ep->num_zones) && (0 == err); ++k)
+            err = emul_zone_action(ep, ep->zones + k, zsa, true);
+    } else
+        err = emul_zone_action(ep, ep->zones + (slba / ep->zone_lbs), zsa,
+                               false);
+    zone_unlock(ep);
+    return err ? emul_nvme_errno(err, false) : 0;
+}
+
+/* Zone Management Receive, only the Report Zones action. Zone Receive
+ * Action Specific Field values 0 to 7 select zones in the same way as the
+ * REPORT ZONES reporting options with those values. */
+static int
+emul_nvme_zm_recv(struct sg_emul * ep,
+                  const struct sg_nvme_passthru_cmd * cmdp, uint8_t * dp)
+{
+    bool partial = !! (0x10000 & cmdp->cdw13);
+    int zrasf = 0xff & (cmdp->cdw13 >> 8);
+    uint32_t k, n, max_desc;
+    uint64_t len = ((uint64_t)cmdp->cdw12 + 1) * 4;
+    uint64_t slba = ((uint64_t)cmdp->cdw11 << 32) | cmdp->cdw10;
+    uint8_t * zdp;
+    struct sg_emul_zone * zp;
+
+    if ((0 != (0xff & cmdp->cdw13)) || (zrasf > 7))
+        return NVME_SC_INVALID_FIELD;
+    if ((NULL == dp) || (len < 64) || (len > cmdp->data_len))
+        return NVME_SC_INVALID_FIELD;
+    if (slba >= ep->num_lbs)
+        return NVME_SC_LBA_RANGE;
+    memset(dp, 0, len);
+    max_desc = (len - 64) / 64;
+    zone_lock(ep);
+    for (n = 0, k = slba / ep->zone_lbs, zp = ep->zones + k;
+         k < ep->num_zones; ++k, ++zp) {
+        if (! zone_matches(zp, zrasf))
+            continue;
+        if (n < max_desc) {
+            zdp = dp + 64 + (64 * n);
+            zdp[0] = ZT_SEQ_REQ;
+            zdp[1] = zp->cond << 4;     /* ZS: same values as ZBC */
+            sg_put_unaligned_le64(ep->zone_lbs, zdp + 8);       /* ZCAP */
+            sg_put_unaligned_le64(zp->start, zdp + 16);
+            sg_put_unaligned_le64(zp->wp, zdp + 24);
+        } else if (partial)
+            break;
+        ++n;
+    }
+    zone_unlock(ep);
+    sg_put_unaligned_le64(n, dp + 0);
+    return 0;
+}
+
+/* Maps emul_zone_wp_check() failures to ZNS status values */
+static int
+emul_nvme_zone_write(struct sg_emul * ep, uint64_t slba, uint64_t nlb)
+{
+    switch (emul_zone_wp_check(ep, slba, nlb)) {
+    case 0:
+        return 0;
+    case WRITE_BOUNDARY_ASCQ:
+        return NVME_SC_ZONE_BOUNDARY;
+    default:
+        return (ZC_FULL == ep->zones[slba / ep->zone_lbs].cond) ?
+               NVME_SC_ZONE_FULL : NVME_SC_ZONE_INVALID_WRITE;
+    }
+}
+
+static int
+emul_nvme_io(struct sg_emul * ep, struct sg_nvme_passthru_cmd * cmdp,
+             uint8_t * dp)
+{
+    bool miscmp;
+    int err;
+    uint32_t k, nr;
+    uint64_t slba = ((uint64_t)cmdp->cdw11 << 32) | cmdp->cdw10;
+    uint64_t nlb = (0xffff & cmdp->cdw12) + 1;
+    uint64_t nbytes = nlb << ep->lb_shift;
+    const uint8_t * rp;
+
+    if (SG_EMUL_NSID != cmdp->nsid)
+        return NVME_SC_INVALID_NS;
+    switch (cmdp->opcode) {
+    case NVME_NVM_FLUSH:
+        return (fdatasync(ep->fd) < 0) ? emul_nvme_errno(errno, false) : 0;
+    case NVME_NVM_DSM:
+        nr = (0xff & cmdp->cdw10) + 1;
+        if ((NULL == dp) || (cmdp->data_len < (16 * nr)))
+            return NVME_SC_INVALID_FIELD;
+        for (k = 0, rp = dp; k < nr; ++k, rp += 16) {
+            slba = sg_get_unaligned_le64(rp + 8);
+            nlb = sg_get_unaligned_le32(rp + 4);
+            if ((slba >= ep->num_lbs) || (nlb > ep->num_lbs - slba))
+                return NVME_SC_LBA_RANGE;
+        }
+        if (0 == (0x4 & cmdp->cdw11))   /* AD (deallocate) not set */
+            return 0;
+        for (k = 0, rp = dp; k < nr; ++k, rp += 16) {
+            err = emul_zero(ep, sg_get_unaligned_le64(rp + 8),
+                            sg_get_unaligned_le32(rp + 4), true);
+            if (err)
+                return emul_nvme_errno(err, false);
+        }
+        return 0;
+    case NVME_NVM_ZONE_MGMT_SEND:
+    case NVME_NVM_ZONE_MGMT_RECV:
+        if (0 == ep->zone_lbs)
+            return NVME_SC_INVALID_OPCODE;
+        if (NVME_NVM_ZONE_MGMT_SEND == cmdp->opcode)
+            return emul_nvme_zm_send(ep, cmdp);
+        return emul_nvme_zm_recv(ep, cmdp, dp);
+    default:
+        break;
+    }
+    if ((slba >= ep->num_lbs) || (nlb > ep->num_lbs - slba))
+        return NVME_SC_LBA_RANGE;
+    switch (cmdp->opcode) {
+    case NVME_NVM_WRITE_ZEROES:
+        if (ep->zone_lbs && (err = emul_nvme_zone_write(ep, slba, nlb)))
+            return err;
+        err = emul_zero(ep, slba, nlb, !! (0x2000000 & cmdp->cdw12));
+        return err ? emul_nvme_errno(err, false) : 0;
+    case NVME_NVM_READ:
+    case NVME_NVM_WRITE:
+    case NVME_NVM_COMPARE:
+        break;
+    default:
+        return NVME_SC_INVALID_OPCODE;
+    }
+    if ((NULL == dp) || (cmdp->data_len < nbytes))
+        return NVME_SC_DATA_XFER_ERR;
+    if (NVME_NVM_READ == cmdp->opcode) {
+        err = emul_read(ep, dp, slba, nbytes);
+        return err ? emul_nvme_errno(err, true) : 0;
+    } else if (NVME_NVM_WRITE == cmdp->opcode) {
+        if (ep->zone_lbs && (err = emul_nvme_zone_write(ep, slba, nlb)))
+            return err;
+        err = emul_write(ep, dp, slba, nbytes);
+        return err ? emul_nvme_errno(err, false) : 0;
+    }
+    err = emul_compare(ep, dp, slba, nbytes, &miscmp);
+    if (err)
+        return emul_nvme_errno(err, true);
+    return miscmp ? NVME_SC_COMPARE_FAILED : 0;
+}
+
+/* Executes the NVMe command in cmdp (Admin command when 'admin' is true,
+ * else NVM command set) on the emulated device fd. Returns the NVMe status
+ * (SCT and SC, with DNR set on errors) like the Linux NVMe pass-through
+ * ioctls do, or a negated errno. CDW0 of the completion is placed in
+ * cmdp->result . */
+int
+sg_emul_nvme_cmd(int fd, struct sg_nvme_passthru_cmd * cmdp, bool admin,
+                 int vb)
+{
+    int res;
+    uint8_t * dp = (uint8_t *)(sg_uintptr_t)cmdp->addr;
+    struct sg_emul * ep = emul_find(fd);
+
+    if ((NULL == ep) || (! ep->is_nvme))
+        return -ENOTTY;
+    cmdp->result = 0;
+    if (admin)
+        res = emul_nvme_admin(ep, cmdp, dp);
+    else
+        res = emul_nvme_io(ep, cmdp, dp);
+    if (vb > 3)
+        pr2ws("emul: NVMe %s opcode=0x%x nsid=%u --> 0x%x\n",
+              admin ? "Admin" : "NVM", cmdp->opcode, cmdp->nsid, res);
+    return res;
+}
+
+#else           /* (HAVE_NVME && (! IGNORE_NVME)) */
+
+int
+sg_emul_nvme_cmd(int fd, struct sg_nvme_passthru_cmd * cmdp, bool admin,
+                 int vb)
+{
+    if (fd) { ; }               /* suppress warning */
+    if (cmdp) { ; }             /* suppress warning */
+    if (admin) { ; }            /* suppress warning */
+    if (vb) { ; }               /* suppress warning */
+    return -ENOTTY;
+}
+
+#endif          /* (HAVE_NVME && (! IGNORE_NVME)) */
+
+/*
+ * Command execution, synchronous and asynchronous
+ */
+
+/* Executes the command in vp on emulated device ep without any added
+ * latency. */
+static int
+emul_exec(struct sg_emul * ep, struct sg_pt_base * vp, int time_secs,
+          int vb)
+{
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    if (0 == ptp->io_hdr.request) {
+        if (vb)
+            pr2ws("No SCSI command (cdb) given\n");
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    if (ep->is_nvme)
+        return sg_do_nvme_pt(vp, -1, time_secs, vb);
+    if (time_secs) { ; }        /* only used by NVMe */
+    return emul_scsi_cmd(ep, ptp, vb);
+}
+
+/* Takes one of the qd slots. Returns false if all are taken. */
+static bool
+emul_qd_get(struct sg_emul * ep)
+{
+    if ((uint32_t)__atomic_add_fetch(&ep->inflight, 1, __ATOMIC_ACQ_REL) >
+        ep->qd) {
+        __atomic_sub_fetch(&ep->inflight, 1, __ATOMIC_ACQ_REL);
+        return false;
+    }
+    return true;
+}
+
+static void
+emul_qd_put(struct sg_emul * ep)
+{
+    __atomic_sub_fetch(&ep->inflight, 1, __ATOMIC_ACQ_REL);
+}
+
+/* Called by do_scsi_pt() for emulated devices. Same return values as that
+ * function. */
+int
+sg_emul_do_pt(struct sg_pt_base * vp, int time_secs, int vb)
+{
+    int res;
+    uint64_t start_ns;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    struct sg_emul * ep = emul_find(ptp->dev_fd);
+
+    if (NULL == ep)
+        return -ENODEV;
+    if (! emul_qd_get(ep)) {
+        if (vb > 2)
+            pr2ws("emul: queue depth (%u) exceeded\n", ep->qd);
+        if (ep->is_nvme)
+            return -EBUSY;
+        ptp->io_hdr.device_status = SAM_STAT_TASK_SET_FULL;
+        return 0;
+    }
+    start_ns = now_ns();
+    res = emul_exec(ep, vp, time_secs, vb);
+    if (ep->lat_us)
+        sleep_until_ns(start_ns + (1000ULL * ep->lat_us));
+    ptp->io_hdr.duration = (now_ns() - start_ns) / 1000000;
+    emul_qd_put(ep);
+    return res;
+}
+
+/* Called by submit_scsi_pt() for emulated devices. The command is executed
+ * immediately but its completion is not available to receive_scsi_pt()
+ * until the lat= time has passed. Returns 0 if queued, -EAGAIN if qd
+ * commands are already queued, or another value that submit_scsi_pt()
+ * may return. */
+int
+sg_emul_submit(struct sg_pt_base * vp, int time_secs, int vb)
+{
+    int res;
+    uint64_t start_ns;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    struct sg_emul * ep = emul_find(ptp->dev_fd);
+    struct sg_emul_done * dnp;
+
+    if (NULL == ep)
+        return -ENODEV;
+    if ((ep->done_num >= ep->qd) || (! emul_qd_get(ep))) {
+        if (vb > 2)
+            pr2ws("emul: queue depth (%u) exceeded\n", ep->qd);
+        return -EAGAIN;
+    }
+    start_ns = now_ns();
+    res = emul_exec(ep, vp, time_secs, vb);
+    if (res < 0)
+        ptp->os_err = -res;
+    else if (res) {
+        emul_qd_put(ep);
+        return res;
+    }
+    dnp = ep->done_arr + ((ep->done_head + ep->done_num) % ep->qd);
+    dnp->vp = vp;
+    dnp->due_ns = start_ns + (1000ULL * ep->lat_us);
+    ++ep->done_num;
+    return 0;
+}
+
+/* Returns the number of completions that are due on fd, or -ENOTTY if fd
+ * is not an emulated device. */
+int
+sg_emul_poll(int fd, int vb)
+{
+    uint32_t k;
+    uint64_t t_ns;
+    struct sg_emul * ep = emul_find(fd);
+    const struct sg_emul_done * dnp;
+
+    if (NULL == ep)
+        return -ENOTTY;
+    t_ns = now_ns();
+    for (k = 0; k < ep->done_num; ++k) {
+        dnp = ep->done_arr + ((ep->done_head + k) % ep->qd);
+        if (dnp->due_ns > t_ns)
+            break;
+    }
+    if (vb > 4)
+        pr2ws("emul: fd=%d, %u of %u completions due\n", fd, k,
+              ep->done_num);
+    return k;
+}
+
+/* Reaps up to max_num completions from emulated device fd. If wait_ms is
+ * zero does not wait, if negative waits until at least one completion (if
+ * any are outstanding), otherwise waits up to wait_ms milliseconds.
+ * Returns number reaped or -ENOTTY if fd is not an emulated device. */
+int
+sg_emul_receive(int fd, struct sg_pt_base ** vpp, int max_num, int wait_ms,
+                int vb)
+{
+    int k;
+    uint64_t t_ns, due_ns;
+    struct sg_emul * ep = emul_find(fd);
+    struct sg_emul_done * dnp;
+
+    if (NULL == ep)
+        return -ENOTTY;
+    if ((0 == ep->done_num) || (max_num < 1))
+        return 0;
+    dnp = ep->done_arr + ep->done_head;
+    t_ns = now_ns();
+    if ((dnp->due_ns > t_ns) && (0 != wait_ms)) {
+        due_ns = dnp->due_ns;
+        if ((wait_ms > 0) && (due_ns > t_ns + (1000000ULL * wait_ms)))
+            due_ns = t_ns + (1000000ULL * wait_ms);
+        sleep_until_ns(due_ns);
+        t_ns = now_ns();
+    }
+    for (k = 0; (k < max_num) && (ep->done_num > 0); ++k) {
+        dnp = ep->done_arr + ep->done_head;
+        if (dnp->due_ns > t_ns)
+            break;
+        vpp[k] = dnp->vp;
+        vpp[k]->impl.io_hdr.duration = (t_ns - dnp->due_ns +
+                                        (1000ULL * ep->lat_us)) / 1000000;
+        ep->done_head = (ep->done_head + 1) % ep->qd;
+        --ep->done_num;
+        emul_qd_put(ep);
+    }
+    if (vb > 4)
+        pr2ws("emul: fd=%d, reaped %d, %u outstanding\n", fd, k,
+              ep->done_num);
+    return k;
+}
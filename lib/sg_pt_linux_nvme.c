@@ -41,7 +41,7 @@
  *                   MA 02110-1301, USA.
  */
 
-/* sg_pt_linux_nvme version 1.09 20190303 */
+/* sg_pt_linux_nvme version 1.12 20261017 */
 
 /* This file contains a small "SPC-only" SNTL to support the SES pass-through
  * of SEND DIAGNOSTIC and RECEIVE DIAGNOSTIC RESULTS through NVME-MI
@@ -76,6 +76,7 @@
 #include "sg_pt.h"
 #include "sg_lib.h"
 #include "sg_linux_inc.h"
+#include "sg_io_linux.h"
 #include "sg_pt_linux.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
@@ -95,6 +96,50 @@
 #define SCSI_SERVICE_ACT_IN_OPC  0x9e
 #define SCSI_READ_CAPACITY16_SA  0x10
 #define SCSI_SA_MSK  0x1f
+#define SCSI_READ10_OPC  0x28
+#define SCSI_WRITE10_OPC  0x2a
+#define SCSI_VERIFY10_OPC  0x2f
+#define SCSI_SYNC_CACHE10_OPC  0x35
+#define SCSI_WRITE_SAME10_OPC  0x41
+#define SCSI_UNMAP_OPC  0x42
+#define SCSI_READ16_OPC  0x88
+#define SCSI_WRITE16_OPC  0x8a
+#define SCSI_VERIFY16_OPC  0x8f
+#define SCSI_SYNC_CACHE16_OPC  0x91
+#define SCSI_WRITE_SAME16_OPC  0x93
+#define SCSI_GET_LBA_STATUS16_SA  0x12
+#define SCSI_ZBC_OUT_OPC  0x94
+#define SCSI_ZBC_IN_OPC  0x95
+#define SCSI_REPORT_ZONES_SA  0x0
+#define SCSI_CLOSE_ZONE_SA  0x1
+#define SCSI_FINISH_ZONE_SA  0x2
+#define SCSI_OPEN_ZONE_SA  0x3
+#define SCSI_RESET_WP_SA  0x4
+
+/* NVMe I/O (NVM command set) opcodes used by the SNTL */
+#define NVME_NVM_FLUSH_OPC  0x0
+#define NVME_NVM_WRITE_OPC  0x1
+#define NVME_NVM_READ_OPC  0x2
+#define NVME_NVM_COMPARE_OPC  0x5
+#define NVME_NVM_WRITE_ZEROES_OPC  0x8
+#define NVME_NVM_DSM_OPC  0x9
+#define NVME_NVM_ZONE_MGMT_SEND_OPC  0x79
+#define NVME_NVM_ZONE_MGMT_RECV_OPC  0x7a
+#define NVME_CDW12_FUA  0x40000000      /* Read, Write: Force Unit Access */
+#define NVME_CDW12_DEAC  0x2000000      /* Write Zeroes: Deallocate */
+#define NVME_DSM_AD  0x4                /* CDW11: Attribute Deallocate */
+#define NVME_DSM_MAX_RANGES  256
+#define NVME_ONCS_DSM  0x4              /* in Identify controller ONCS */
+#define NVME_ONCS_WRITE_ZEROES  0x8
+#define NVME_NVM_MAX_NLB  0x10000       /* NLB is a 16 bit, 0 based field */
+#define NVME_MPSMIN_BYTES  4096         /* assumed for MDTS, CAP.MPSMIN=0 */
+#define NVME_CSI_ZNS  0x2               /* Zoned Namespace command set */
+#define NVME_ZSA_SELECT_ALL  0x100      /* Zone Mgmt Send CDW13 */
+#define NVME_ZRA_PARTIAL  0x10000       /* Zone Mgmt Receive CDW13 */
+#define NVME_ZA_RZR  0x4                /* Zone Attributes: Reset Recommended */
+#define SNTL_SCRATCH_MAX_BYTES  (1024 * 1024)
+#define SNTL_LBA_STATUS_SCAN_BYTES  (64 * 1024 * 1024)
+#define SNTL_ZONE_REPORT_MAX_BYTES  (2 * 1024 * 1024)
 
 /* Additional Sense Code (ASC) */
 #define NO_ADDITIONAL_SENSE 0x0
@@ -105,6 +150,7 @@
 #define INVALID_OPCODE 0x20
 #define LBA_OUT_OF_RANGE 0x21
 #define INVALID_FIELD_IN_CDB 0x24
+#define LU_NOT_SUPPORTED 0x25
 #define INVALID_FIELD_IN_PARAM_LIST 0x26
 #define UA_RESET_ASC 0x29
 #define UA_CHANGED_ASC 0x2a
@@ -261,33 +307,105 @@ mk_sense_invalid_fld(struct sg_pt_linux_scsi * ptp, bool in_cdb, int in_byte,
               ((in_bit > 0) ? (0x7 & in_bit) : 0));
 }
 
-/* Returns 0 for success. Returns SG_LIB_NVME_STATUS if there is non-zero
- * NVMe status (from the completion queue) with the value placed in
- * ptp->nvme_status. If Unix error from ioctl then return negated value
- * (equivalent -errno from basic Unix system functions like open()).
- * CDW0 from the completion queue is placed in ptp->nvme_result in the
- * absence of a Unix error. If time_secs is negative it is treated as
+/* Places the completion of a NVMe command into ptp. 'res' is the NVMe
+ * completion queue CDW3 31:17 (15 bits) as yielded by the Linux NVMe
+ * pass-through ioctls and by io_uring's uring_cmd, and 'result' is CDW0.
+ * If ptp->nvme_direct then the completion is also placed in the "sense"
+ * buffer (up to 32 bytes), else if 'sntl' is true and there is a non-zero
+ * NVMe status then it is translated into SCSI sense data. Returns 0 for
+ * success or SG_LIB_NVME_STATUS if there is a non-zero NVMe status. */
+int
+sg_nvme_pt_completion(struct sg_pt_linux_scsi * ptp, int res, uint32_t result,
+                      bool sntl, int vb)
+{
+    uint32_t n;
+    uint16_t sct_sc;
+
+    ptp->nvme_result = result;
+    if (ptp->nvme_direct && ptp->io_hdr.response &&
+        (ptp->io_hdr.max_response_len > 3)) {
+        /* build 32 byte "sense" buffer */
+        uint8_t * sbp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
+        uint16_t st = (uint16_t)res;
+
+        n = ptp->io_hdr.max_response_len;
+        n = (n < 32) ? n : 32;
+        memset(sbp, 0 , n);
+        ptp->io_hdr.response_len = n;
+        sg_put_unaligned_le32(result, sbp + SG_NVME_PT_CQ_RESULT);
+        if (n > 15) /* LSBit will be 0 (Phase bit) after (st << 1) */
+            sg_put_unaligned_le16(st << 1, sbp + SG_NVME_PT_CQ_STATUS_P);
+    }
+    /* clear upper bits (DNR and More) leaving ((SCT << 8) | SC) */
+    sct_sc = 0x7ff & res;       /* 11 bits */
+    ptp->nvme_status = sct_sc;
+    ptp->nvme_stat_dnr = !!(0x4000 & res);
+    ptp->nvme_stat_more = !!(0x2000 & res);
+    if (sct_sc) {
+        if (sntl && (! ptp->nvme_direct))
+            mk_sense_from_nvme_status(ptp, vb);
+        return SG_LIB_NVME_STATUS;      /* == SCSI_PT_DO_NVME_STATUS */
+    }
+    return 0;
+}
+
+static void sntl_id_invalidate(int vb);
+
+/* Returns true if the completion of cmdp suggests that what NVMe Identify
+ * reports may have changed. */
+static bool
+sntl_id_changed(const struct sg_nvme_passthru_cmd * cmdp, bool admin,
+                uint32_t status)
+{
+    const uint8_t * dp = (const uint8_t *)(sg_uintptr_t)cmdp->addr;
+
+    if (! admin)        /* Invalid namespace or format, Namespace not ready */
+        return (0xb == status) || (0x82 == status);
+    if (status)
+        return false;
+    switch (cmdp->opcode) {
+    case 0x0d:          /* Namespace Management */
+    case 0x10:          /* Firmware Commit */
+    case 0x15:          /* Namespace Attachment */
+    case 0x80:          /* Format NVM */
+    case 0x84:          /* Sanitize */
+        return true;
+    case 0x2:           /* Get Log Page: non-empty Changed Namespace List */
+        return (0x4 == (0xff & cmdp->cdw10)) && dp &&
+               (cmdp->data_len >= 4) && (sg_get_unaligned_le32(dp) > 0);
+    default:
+        return false;
+    }
+}
+
+/* Sends a NVMe Admin command (when 'admin' is true) or a NVMe I/O (NVM
+ * command set) command. Returns 0 for success. Returns SG_LIB_NVME_STATUS
+ * if there is non-zero NVMe status (from the completion queue) with the
+ * value placed in ptp->nvme_status. If Unix error from ioctl then return
+ * negated value (equivalent -errno from basic Unix system functions like
+ * open()). CDW0 from the completion queue is placed in ptp->nvme_result in
+ * the absence of a Unix error. If time_secs is negative it is treated as
  * a timeout in milliseconds (of abs(time_secs) ). */
 static int
-sg_nvme_admin_cmd(struct sg_pt_linux_scsi * ptp,
-                  struct sg_nvme_passthru_cmd *cmdp, void * dp, bool is_read,
-                  int time_secs, int vb)
+sg_nvme_cmd(struct sg_pt_linux_scsi * ptp, struct sg_nvme_passthru_cmd *cmdp,
+            void * dp, bool is_read, bool admin, int time_secs, int vb)
 {
     const uint32_t cmd_len = sizeof(struct sg_nvme_passthru_cmd);
+    bool do_lat;
     int res;
     uint32_t n;
-    uint16_t sct_sc;
+    uint64_t start_ns = 0;
     const uint8_t * up = ((const uint8_t *)cmdp) + SG_NVME_PT_OPCODE;
     char nam[64];
 
     if (vb)
-        sg_get_nvme_opcode_name(*up, true, sizeof(nam), nam);
+        sg_get_nvme_opcode_name(*up, admin, sizeof(nam), nam);
     else
         nam[0] = '\0';
     cmdp->timeout_ms = (time_secs < 0) ? (-time_secs) : (1000 * time_secs);
     ptp->os_err = 0;
     if (vb > 2) {
-        pr2ws("NVMe Admin command: %s\n", nam);
+        pr2ws("NVMe %s command: %s\n", (admin ? "Admin" : "NVM"), nam);
         hex2stderr((const uint8_t *)cmdp, cmd_len, 1);
         if ((vb > 3) && (! is_read) && dp) {
             uint32_t len = sg_get_unaligned_le32(up + SG_NVME_PT_DATA_LEN);
@@ -304,7 +422,18 @@ sg_nvme_admin_cmd(struct sg_pt_linux_scsi * ptp,
             }
         }
     }
-    res = ioctl(ptp->dev_fd, NVME_IOCTL_ADMIN_CMD, cmdp);
+    do_lat = __atomic_load_n(&sg_pt_lat_hist_state, __ATOMIC_RELAXED) &&
+             sg_pt_lat_hist_active();
+    if (do_lat)
+        start_ns = sg_pt_trace_now_ns();
+    if (ptp->is_emul)
+        res = sg_emul_nvme_cmd(ptp->dev_fd, cmdp, admin, vb);
+    else
+        res = ioctl(ptp->dev_fd, (admin ? NVME_IOCTL_ADMIN_CMD :
+                                          NVME_IOCTL_IO_CMD), cmdp);
+    if (do_lat)
+        sg_pt_lat_hist_add((admin ? SG_PT_LAT_NVME_ADMIN : SG_PT_LAT_NVME_IO),
+                           *up, sg_pt_trace_now_ns() - start_ns);
     if (res < 0) {  /* OS error (errno negated) */
         ptp->os_err = -res;
         if (vb > 1) {
@@ -315,36 +444,19 @@ sg_nvme_admin_cmd(struct sg_pt_linux_scsi * ptp,
     }
 
     /* Now res contains NVMe completion queue CDW3 31:17 (15 bits) */
-    ptp->nvme_result = cmdp->result;
-    if (ptp->nvme_direct && ptp->io_hdr.response &&
-        (ptp->io_hdr.max_response_len > 3)) {
-        /* build 32 byte "sense" buffer */
-        uint8_t * sbp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
-        uint16_t st = (uint16_t)res;
-
-        n = ptp->io_hdr.max_response_len;
-        n = (n < 32) ? n : 32;
-        memset(sbp, 0 , n);
-        ptp->io_hdr.response_len = n;
-        sg_put_unaligned_le32(cmdp->result,
-                              sbp + SG_NVME_PT_CQ_RESULT);
-        if (n > 15) /* LSBit will be 0 (Phase bit) after (st << 1) */
-            sg_put_unaligned_le16(st << 1, sbp + SG_NVME_PT_CQ_STATUS_P);
-    }
-    /* clear upper bits (DNR and More) leaving ((SCT << 8) | SC) */
-    sct_sc = 0x7ff & res;       /* 11 bits */
-    ptp->nvme_status = sct_sc;
-    ptp->nvme_stat_dnr = !!(0x4000 & res);
-    ptp->nvme_stat_more = !!(0x2000 & res);
-    if (sct_sc) {  /* when non-zero, treat as command error */
+    res = sg_nvme_pt_completion(ptp, res, cmdp->result, false, vb);
+    if (sntl_id_changed(cmdp, admin, ptp->nvme_status))
+        sntl_id_invalidate(vb);
+    if (res) {  /* when non-zero, treat as command error */
         if (vb > 1) {
             char b[80];
 
             pr2ws("%s: ioctl for %s [0x%x] failed, status: %s [0x%x]\n",
                    __func__, nam, *up,
-                  sg_get_nvme_cmd_status_str(sct_sc, sizeof(b), b), sct_sc);
+                  sg_get_nvme_cmd_status_str(ptp->nvme_status, sizeof(b), b),
+                  ptp->nvme_status);
         }
-        return SG_LIB_NVME_STATUS;      /* == SCSI_PT_DO_NVME_STATUS */
+        return res;
     }
     if ((vb > 3) && is_read && dp) {
         uint32_t len = sg_get_unaligned_le32(up + SG_NVME_PT_DATA_LEN);
@@ -363,6 +475,263 @@ sg_nvme_admin_cmd(struct sg_pt_linux_scsi * ptp,
     return 0;
 }
 
+static inline int
+sg_nvme_admin_cmd(struct sg_pt_linux_scsi * ptp,
+                  struct sg_nvme_passthru_cmd *cmdp, void * dp, bool is_read,
+                  int time_secs, int vb)
+{
+    return sg_nvme_cmd(ptp, cmdp, dp, is_read, true, time_secs, vb);
+}
+
+static inline int
+sg_nvme_io_cmd(struct sg_pt_linux_scsi * ptp,
+               struct sg_nvme_passthru_cmd *cmdp, void * dp, bool is_read,
+               int time_secs, int vb)
+{
+    return sg_nvme_cmd(ptp, cmdp, dp, is_read, false, time_secs, vb);
+}
+
+/*
+ * Process wide cache of NVMe Identify responses
+ */
+
+/* Identify responses seldom change but are needed by many SNTL commands,
+ * so rather than each pt object fetching its own copy they are shared by
+ * all pt objects in the process. Entries are keyed by device (st_rdev for
+ * char and block devices, else st_dev and st_ino), CNS, nsid and CSI.
+ * Identify commands failing with the DNR bit set are cached as well (as
+ * their NVMe status) so that an unsupported CNS is not asked for again;
+ * other failures may be transient so are not cached. Each pt object holding
+ * an entry has a reference to it. Namespace changes seen by this process
+ * (see sntl_id_invalidate() ) unlink all entries and mark them stale; a
+ * stale entry is dropped by its holders before their next SNTL command
+ * and freed when the last reference goes. */
+struct sg_nvme_id_ent {
+    struct sg_nvme_id_ent * next;
+    uint64_t dev;
+    uint64_t ino;       /* 0 for char and block devices */
+    uint32_t nsid;
+    uint8_t cns;
+    uint8_t csi;
+    bool stale;         /* unlinked, accessed atomically by holders */
+    int refs;           /* protected by sg_nvme_id_lock */
+    int status;         /* 0 or NVMe status (with DNR and More bits) */
+    uint8_t * up;       /* SG_NVME_ID_LEN bytes, page aligned */
+    uint8_t * free_up;
+};
+
+#define SG_NVME_ID_LEN 4096
+
+static struct sg_nvme_id_ent * sg_nvme_id_head;
+static uint8_t sg_nvme_id_lock;         /* spinlock for the above */
+
+static void
+id_lock(void)
+{
+    while (__atomic_test_and_set(&sg_nvme_id_lock, __ATOMIC_ACQUIRE))
+        ;
+}
+
+static void
+id_unlock(void)
+{
+    __atomic_clear(&sg_nvme_id_lock, __ATOMIC_RELEASE);
+}
+
+static void
+id_ent_free(struct sg_nvme_id_ent * ep)
+{
+    free(ep->free_up);
+    free(ep);
+}
+
+/* Drops a reference to ep, freeing it if it was the last one and ep is
+ * stale. */
+static void
+sntl_id_put(struct sg_nvme_id_ent * ep)
+{
+    bool gone;
+
+    if (NULL == ep)
+        return;
+    id_lock();
+    gone = (0 == --ep->refs) && ep->stale;
+    id_unlock();
+    if (gone)
+        id_ent_free(ep);
+}
+
+/* Empties the Identify cache. Called after commands that may change what
+ * Identify reports (e.g. Format NVM) and on NVMe status values suggesting
+ * that a namespace has changed. Devices other than the one the command
+ * was sent to are affected too (e.g. a namespace attached through the
+ * controller's char device) so the whole cache goes. */
+static void
+sntl_id_invalidate(int vb)
+{
+    struct sg_nvme_id_ent * ep;
+    struct sg_nvme_id_ent * nep;
+
+    id_lock();
+    ep = sg_nvme_id_head;
+    sg_nvme_id_head = NULL;
+    for ( ; ep; ep = nep) {
+        nep = ep->next;
+        __atomic_store_n(&ep->stale, true, __ATOMIC_RELEASE);
+        if (0 == ep->refs)
+            id_ent_free(ep);
+    }
+    id_unlock();
+    if (vb > 3)
+        pr2ws("%s: Identify cache emptied\n", __func__);
+}
+
+static struct sg_nvme_id_ent *
+id_find(uint64_t dev, uint64_t ino, int cns, uint32_t nsid, int csi)
+{
+    struct sg_nvme_id_ent * ep;
+
+    for (ep = sg_nvme_id_head; ep; ep = ep->next) {
+        if ((dev == ep->dev) && (ino == ep->ino) && (cns == ep->cns) &&
+            (nsid == ep->nsid) && (csi == ep->csi))
+            return ep;
+    }
+    return NULL;
+}
+
+/* Gets the Identify response for cns, nsid and csi (CDW11 bits 31:24) of
+ * the device ptp is using, from the cache if possible. Returns 0 and a
+ * reference to the entry in *entp (the response is at (*entp)->up ), or
+ * SG_LIB_NVME_STATUS with the NVMe status placed in ptp, or a negated
+ * errno or positive value as sg_nvme_admin_cmd() does. */
+static int
+sntl_id_get(struct sg_pt_linux_scsi * ptp, int cns, uint32_t nsid, int csi,
+            int time_secs, struct sg_nvme_id_ent ** entp, int vb)
+{
+    bool hit = true;
+    int res;
+    uint64_t dev, ino;
+    struct sg_nvme_id_ent * ep;
+    struct sg_nvme_id_ent * nep;
+    struct sg_nvme_passthru_cmd cmd;
+    struct stat a_stat;
+
+    *entp = NULL;
+    if (fstat(ptp->dev_fd, &a_stat) < 0)
+        return -errno;
+    if (S_ISCHR(a_stat.st_mode) || S_ISBLK(a_stat.st_mode)) {
+        dev = a_stat.st_rdev;
+        ino = 0;
+    } else {            /* e.g. an emulated device */
+        dev = a_stat.st_dev;
+        ino = a_stat.st_ino;
+    }
+    id_lock();
+    ep = id_find(dev, ino, cns, nsid, csi);
+    if (ep)
+        ++ep->refs;
+    id_unlock();
+    if (NULL == ep) {
+        hit = false;
+        nep = (struct sg_nvme_id_ent *)calloc(1, sizeof(*nep));
+        if (NULL == nep)
+            return sg_convert_errno(ENOMEM);
+        nep->up = sg_memalign(SG_NVME_ID_LEN, 0, &nep->free_up, false);
+        if (NULL == nep->up) {
+            free(nep);
+            pr2ws("%s: sg_memalign() failed to get memory\n", __func__);
+            return sg_convert_errno(ENOMEM);
+        }
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.opcode = 0x6;       /* Identify */
+        cmd.nsid = nsid;
+        cmd.cdw10 = cns;
+        cmd.cdw11 = (uint32_t)csi << 24;
+        cmd.addr = (uint64_t)(sg_uintptr_t)nep->up;
+        cmd.data_len = SG_NVME_ID_LEN;
+        res = sg_nvme_admin_cmd(ptp, &cmd, nep->up, true, time_secs, vb);
+        if (res && ((SG_LIB_NVME_STATUS != res) || (! ptp->nvme_stat_dnr))) {
+            if (vb > 3)
+                pr2ws("%s: CNS=0x%x nsid=%u CSI=%d: failed, not cached\n",
+                      __func__, cns, nsid, csi);
+            id_ent_free(nep);
+            return res;
+        }
+        if (res)
+            nep->status = ptp->nvme_status |
+                          (ptp->nvme_stat_dnr ? 0x4000 : 0) |
+                          (ptp->nvme_stat_more ? 0x2000 : 0);
+        nep->dev = dev;
+        nep->ino = ino;
+        nep->cns = cns;
+        nep->nsid = nsid;
+        nep->csi = csi;
+        nep->refs = 1;
+        id_lock();
+        ep = id_find(dev, ino, cns, nsid, csi);
+        if (ep)                 /* another thread beat us to it */
+            ++ep->refs;
+        else {
+            nep->next = sg_nvme_id_head;
+            sg_nvme_id_head = nep;
+            ep = nep;
+            nep = NULL;
+        }
+        id_unlock();
+        if (nep)
+            id_ent_free(nep);
+    }
+    if (vb > 3)
+        pr2ws("%s: CNS=0x%x nsid=%u CSI=%d: %s, status=0x%x\n", __func__,
+              cns, nsid, csi, (hit ? "cached" : "fetched"), ep->status);
+    if (ep->status) {
+        if (hit)
+            sg_nvme_pt_completion(ptp, ep->status, 0, false, vb);
+        sntl_id_put(ep);
+        return SG_LIB_NVME_STATUS;
+    }
+    *entp = ep;
+    return 0;
+}
+
+/* Drops the Identify responses held by ptp and the namespace geometry
+ * derived from them. */
+void
+sg_nvme_id_release(struct sg_pt_linux_scsi * ptp)
+{
+    sntl_id_put(ptp->nvme_id_ctl_ent);
+    sntl_id_put(ptp->nvme_id_ns_ent);
+    ptp->nvme_id_ctl_ent = NULL;
+    ptp->nvme_id_ns_ent = NULL;
+    ptp->nvme_id_ctlp = NULL;
+    memset(&ptp->nvme_geom, 0, sizeof(ptp->nvme_geom));
+}
+
+/* Called before each SNTL command; drops Identify responses that have been
+ * invalidated since ptp took them. */
+static void
+sntl_id_check(struct sg_pt_linux_scsi * ptp)
+{
+    const struct sg_nvme_id_ent * cep = ptp->nvme_id_ctl_ent;
+    const struct sg_nvme_id_ent * nep = ptp->nvme_id_ns_ent;
+
+    if ((cep && __atomic_load_n(&cep->stale, __ATOMIC_ACQUIRE)) ||
+        (nep && __atomic_load_n(&nep->stale, __ATOMIC_ACQUIRE)))
+        sg_nvme_id_release(ptp);
+}
+
+/* Gets the Identify namespace response for ptp's nsid into
+ * ptp->nvme_id_ns_ent if it is not already there. Returns as
+ * sntl_id_get() does. */
+static int
+sntl_cache_id_ns(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
+{
+    if (ptp->nvme_id_ns_ent)
+        return 0;
+    return sntl_id_get(ptp, 0x0 /* CNS */, ptp->nvme_nsid, 0, time_secs,
+                       &ptp->nvme_id_ns_ent, vb);
+}
+
 static void
 sntl_check_enclosure_override(struct sg_pt_linux_scsi * ptp, int vb)
 {
@@ -416,40 +785,20 @@ sntl_check_enclosure_override(struct sg_pt_linux_scsi * ptp, int vb)
     }
 }
 
-static int
-sntl_do_identify(struct sg_pt_linux_scsi * ptp, int cns, int nsid,
-                 int time_secs, int u_len, uint8_t * up, int vb)
-{
-    struct sg_nvme_passthru_cmd cmd;
-
-    memset(&cmd, 0, sizeof(cmd));
-    cmd.opcode = 0x6;   /* Identify */
-    cmd.nsid = nsid;
-    cmd.cdw10 = cns;
-    cmd.addr = (uint64_t)(sg_uintptr_t)up;
-    cmd.data_len = u_len;
-    return sg_nvme_admin_cmd(ptp, &cmd, up, true, time_secs, vb);
-}
-
-/* Currently only caches associated identify controller response (4096 bytes).
- * Returns 0 on success; otherwise a positive value is returned */
+/* Gets the associated identify controller response (4096 bytes) into
+ * ptp->nvme_id_ctlp, from the Identify cache if possible. Returns 0 on
+ * success; otherwise a positive value is returned */
 static int
 sntl_cache_identity(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
 {
     int ret;
-    uint32_t pg_sz = sg_get_page_size();
-    uint8_t * up;
 
-    up = sg_memalign(pg_sz, pg_sz, &ptp->free_nvme_id_ctlp, false);
-    ptp->nvme_id_ctlp = up;
-    if (NULL == up) {
-        pr2ws("%s: sg_memalign() failed to get memory\n", __func__);
-        return sg_convert_errno(ENOMEM);
-    }
-    ret = sntl_do_identify(ptp, 0x1 /* CNS */, 0 /* nsid */, time_secs,
-                           pg_sz, up, vb);
-    if (0 == ret)
+    ret = sntl_id_get(ptp, 0x1 /* CNS */, 0 /* nsid */, 0, time_secs,
+                      &ptp->nvme_id_ctl_ent, vb);
+    if (0 == ret) {
+        ptp->nvme_id_ctlp = ptp->nvme_id_ctl_ent->up;
         sntl_check_enclosure_override(ptp, vb);
+    }
     return (ret < 0) ? sg_convert_errno(-ret) : ret;
 }
 
@@ -464,9 +813,7 @@ sntl_inq(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int time_secs,
     bool cp_id_ctl = false;
     int res;
     uint16_t n, alloc_len, pg_cd;
-    uint32_t pg_sz = sg_get_page_size();
-    uint8_t * nvme_id_ns = NULL;
-    uint8_t * free_nvme_id_ns = NULL;
+    const uint8_t * nvme_id_ns = NULL;
     uint8_t inq_dout[256];
 
     if (vb > 3)
@@ -512,30 +859,14 @@ sntl_inq(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int time_secs,
             break;
         case 0x83:
             if ((ptp->nvme_nsid > 0) &&
-                (ptp->nvme_nsid < SG_NVME_BROADCAST_NSID)) {
-                nvme_id_ns = sg_memalign(pg_sz, pg_sz, &free_nvme_id_ns,
-                                         false);
-                if (nvme_id_ns) {
-                    /* CNS=0x0 Identify namespace */
-                    res = sntl_do_identify(ptp, 0x0, ptp->nvme_nsid,
-                                           time_secs, pg_sz, nvme_id_ns, vb);
-                    if (res) {
-                        free(free_nvme_id_ns);
-                        free_nvme_id_ns = NULL;
-                        nvme_id_ns = NULL;
-                    }
-                }
-            }
+                (ptp->nvme_nsid < SG_NVME_BROADCAST_NSID) &&
+                (0 == sntl_cache_id_ns(ptp, time_secs, vb)))
+                nvme_id_ns = ptp->nvme_id_ns_ent->up;
             n = sg_make_vpd_devid_for_nvme(ptp->nvme_id_ctlp, nvme_id_ns,
                                            0 /* pdt */, -1 /*tproto */,
                                            inq_dout, sizeof(inq_dout));
             if (n > 3)
                 sg_put_unaligned_be16(n - 4, inq_dout + 2);
-            if (free_nvme_id_ns) {
-                free(free_nvme_id_ns);
-                free_nvme_id_ns = NULL;
-                nvme_id_ns = NULL;
-            }
             break;
         case 0x86:      /* Extended INQUIRY (per SFS SPC Discovery 2016) */
             inq_dout[1] = pg_cd;
@@ -1178,28 +1509,24 @@ sntl_readcap(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
     int res, n, len, alloc_len, dps;
     uint8_t flbas, index, lbads;
     uint32_t lbafx;     /* "x" is 0 to 15 in NVMe spec */
-    uint32_t pg_sz = sg_get_page_size();
     uint64_t nsze;
     uint8_t * bp;
-    uint8_t * up;
-    uint8_t * free_up = NULL;
+    const uint8_t * up;
     uint8_t resp[32];
 
     if (vb > 3)
         pr2ws("%s: RCAP%d, time_secs=%d\n", __func__,
               (is_rcap10 ? 10 : 16), time_secs);
-    up = sg_memalign(pg_sz, pg_sz, &free_up, false);
-    if (NULL == up) {
-        pr2ws("%s: sg_memalign() failed to get memory\n", __func__);
-        return sg_convert_errno(ENOMEM);
-    }
-    res = sntl_do_identify(ptp, 0x0 /* CNS */, ptp->nvme_nsid, time_secs,
-                           pg_sz, up, vb);
-    if (res < 0) {
-        res = sg_convert_errno(-res);
-        goto fini;
-    }
-    memset(resp, 0, sizeof(*resp));
+    res = sntl_cache_id_ns(ptp, time_secs, vb);
+    if (SG_LIB_NVME_STATUS == res) {
+        mk_sense_from_nvme_status(ptp, vb);
+        return 0;
+    } else if (res < 0)
+        return sg_convert_errno(-res);
+    else if (res)
+        return res;
+    up = ptp->nvme_id_ns_ent->up;
+    memset(resp, 0, sizeof(resp));
     nsze = sg_get_unaligned_le64(up + 0);
     flbas = up[26];
     index = 128 + (4 * (flbas & 0xf));
@@ -1228,6 +1555,14 @@ sntl_readcap(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
         else
             sg_put_unaligned_be64(nsze - 1, resp + 0);
         sg_put_unaligned_be32(1 << lbads, resp + 8);    /* RLBA field */
+        if (NULL == ptp->nvme_id_ctlp)
+            sntl_cache_identity(ptp, time_secs, vb);
+        if (ptp->nvme_id_ctlp &&
+            (NVME_ONCS_DSM & sg_get_unaligned_le16(ptp->nvme_id_ctlp + 520))) {
+            resp[14] |= 0x80;           /* LBPME: UNMAP is translated */
+            if (0x1 == (0x7 & up[33]))  /* DLFEAT: deallocated read 0s */
+                resp[14] |= 0x40;       /* LBPRZ */
+        }
     }
     len = ptp->io_hdr.din_xfer_len;
     bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
@@ -1237,9 +1572,1001 @@ sntl_readcap(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
     ptp->io_hdr.din_resid = len - n;
     if (n > 0)
         memcpy(bp, resp, n);
+    return 0;
+}
+
+/* Fetches the namespace size (NSZE), the logical block size (LBADS) of the
+ * current format and DLFEAT plus the controller's MDTS and ONCS, and
+ * caches them in ptp->nvme_geom for the media access commands. If a NVMe
+ * Identify fails then sense data is built and nvme_geom.lbads is left at
+ * 0. Returns 0 unless there is an OS error (negated errno) or a resource
+ * problem (positive value). */
+static int
+sntl_cache_geometry(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
+{
+    int res;
+    uint8_t flbas, lbads;
+    const uint8_t * up;
+    struct sg_nvme_geom * gp = &ptp->nvme_geom;
+
+    if (NULL == ptp->nvme_id_ctlp) {
+        res = sntl_cache_identity(ptp, time_secs, vb);
+        if (SG_LIB_NVME_STATUS == res) {
+            mk_sense_from_nvme_status(ptp, vb);
+            return 0;
+        } else if (res)
+            return res;
+    }
+    res = sntl_cache_id_ns(ptp, time_secs, vb);
+    if (SG_LIB_NVME_STATUS == res) {
+        mk_sense_from_nvme_status(ptp, vb);
+        return 0;
+    } else if (res)
+        return res;
+    up = ptp->nvme_id_ns_ent->up;
+    flbas = up[26];
+    lbads = (sg_get_unaligned_le32(up + 128 + (4 * (flbas & 0xf))) >> 16) &
+            0xff;
+    if ((lbads < 9) || (lbads > 31)) {  /* NVMe: 512 bytes or more */
+        if (vb)
+            pr2ws("%s: unexpected LBADS=%u, namespace not formatted?\n",
+                  __func__, lbads);
+        mk_sense_asc_ascq(ptp, SPC_SK_NOT_READY, LOGICAL_UNIT_NOT_READY, 0,
+                          vb);
+        return 0;
+    }
+    gp->nsze = sg_get_unaligned_le64(up + 0);
+    gp->dlfeat = up[33];
+    gp->mdts = ptp->nvme_id_ctlp[77];
+    gp->oncs = sg_get_unaligned_le16(ptp->nvme_id_ctlp + 520);
+    gp->lbads = lbads;
+    gp->lbaf = flbas & 0xf;
+    if (vb > 3)
+        pr2ws("%s: nsze=%" PRIu64 ", lb_size=%u, mdts=%u, oncs=0x%x\n",
+              __func__, gp->nsze, 1U << lbads, gp->mdts, gp->oncs);
+    return 0;
+}
+
+/* Fetches the NVM command set specific Identify controller data structure
+ * (CNS 6, CSI 0) for the Dataset Management and Write Zeroes limits. That
+ * structure was added in NVMe 2.0; if the controller does not support it
+ * then no limits (other than those in the commands themselves) apply. */
+static void
+sntl_cache_nvm_lims(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
+{
+    const uint8_t * up;
+    struct sg_nvme_geom * gp = &ptp->nvme_geom;
+    struct sg_nvme_id_ent * ep;
+
+    gp->nvm_lims = true;
+    if (0 == sntl_id_get(ptp, 0x6 /* CNS */, 0 /* nsid */, 0 /* CSI */,
+                         time_secs, &ep, vb)) {
+        up = ep->up;
+        gp->wzsl = up[1];
+        gp->dmrl = up[3];
+        gp->dmrsl = sg_get_unaligned_le32(up + 4);
+        sntl_id_put(ep);
+        if (vb > 3)
+            pr2ws("%s: wzsl=%u, dmrl=%u, dmrsl=%u\n", __func__, gp->wzsl,
+                  gp->dmrl, gp->dmrsl);
+    } else if (vb > 3)
+        pr2ws("%s: not supported, assume no limits\n", __func__);
+}
+
+/* Checks that media access is possible on ptp (i.e. it is a namespace)
+ * and that the namespace geometry is cached. Returns true if so. If false
+ * is returned then *resp holds the value the SNTL function should return;
+ * when that is 0 sense data has been built. */
+static bool
+sntl_media_ready(struct sg_pt_linux_scsi * ptp, int time_secs, int * resp,
+                 int vb)
+{
+    *resp = 0;
+    if (0 == ptp->nvme_nsid) {
+        if (vb > 1)
+            pr2ws("%s: need a namespace (e.g. /dev/nvme0n1) for media "
+                  "access\n", __func__);
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, LU_NOT_SUPPORTED, 0,
+                          vb);
+        return false;
+    }
+    if (0 == ptp->nvme_geom.lbads) {
+        *resp = sntl_cache_geometry(ptp, time_secs, vb);
+        if (*resp || (0 == ptp->nvme_geom.lbads))
+            return false;
+    }
+    return true;
+}
+
+/* Returns the maximum number of LBs a single NVMe command may cover. NLB
+ * is a 16 bit field; pow2_lim is MDTS or WZSL (both in units of the
+ * minimum memory page size, 0 for no limit) and no more than max_bytes
+ * are wanted per command. */
+static uint32_t
+sntl_max_nlb(const struct sg_nvme_geom * gp, uint8_t pow2_lim,
+             uint64_t max_bytes)
+{
+    uint32_t max_nlb = NVME_NVM_MAX_NLB;
+    uint64_t mx;
+
+    if (pow2_lim && (pow2_lim < 32)) {
+        mx = ((uint64_t)NVME_MPSMIN_BYTES << pow2_lim) >> gp->lbads;
+        if (mx < max_nlb)
+            max_nlb = mx ? (uint32_t)mx : 1;
+    }
+    mx = max_bytes >> gp->lbads;
+    if (mx < max_nlb)
+        max_nlb = mx ? (uint32_t)mx : 1;
+    return max_nlb;
+}
+
+/* Returns a scratch buffer of nlb LBs, each a copy of the LB at pat or
+ * zeroed if pat is NULL. The pointer to free is placed in *free_pp . */
+static uint8_t *
+sntl_scratch(uint32_t nlb, uint32_t lbs, const uint8_t * pat,
+             uint8_t ** free_pp)
+{
+    uint32_t k;
+    uint8_t * bp = sg_memalign(nlb * lbs, 0, free_pp, false);
+
+    if (NULL == bp) {
+        pr2ws("%s: sg_memalign() failed to get memory\n", __func__);
+        return NULL;
+    }
+    if (pat) {
+        for (k = 0; k < nlb; ++k)
+            memcpy(bp + ((uint64_t)k * lbs), pat, lbs);
+    }
+    return bp;
+}
+
+/* Issues NVMe command opc (Read, Write, Compare or Write Zeroes) over num
+ * LBs starting at lba, split into commands of at most max_nlb LBs. If bp
+ * is NULL no data is transferred. Otherwise successive commands use
+ * successive parts of bp, unless 'same' is set in which case they all use
+ * the start of bp (a scratch buffer or a replicated pattern). cdw12_flags
+ * (e.g. FUA) are ORed into each command. The number of LBs done is placed
+ * in *done_p; NVMe errors are translated to sense data. Returns 0, or a
+ * negated errno or positive value as sg_nvme_io_cmd() does. */
+static int
+sntl_nvm_xfer(struct sg_pt_linux_scsi * ptp, uint8_t opc, uint64_t lba,
+              uint64_t num, uint32_t max_nlb, uint32_t cdw12_flags,
+              uint8_t * bp, bool same, bool is_read, uint64_t * done_p,
+              int time_secs, int vb)
+{
+    int res = 0;
+    uint8_t lbads = ptp->nvme_geom.lbads;
+    uint32_t nlb;
+    uint64_t off;
+    struct sg_nvme_passthru_cmd cmd;
+
+    for (off = 0; off < num; off += nlb) {
+        nlb = ((num - off) > max_nlb) ? max_nlb : (uint32_t)(num - off);
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.opcode = opc;
+        cmd.nsid = ptp->nvme_nsid;
+        cmd.cdw10 = (uint32_t)(lba + off);
+        cmd.cdw11 = (uint32_t)((lba + off) >> 32);
+        cmd.cdw12 = (nlb - 1) | cdw12_flags;
+        if (bp) {
+            cmd.addr = (uint64_t)(sg_uintptr_t)(same ? bp :
+                                                (bp + (off << lbads)));
+            cmd.data_len = nlb << lbads;
+        }
+        res = sg_nvme_io_cmd(ptp, &cmd, (void *)(sg_uintptr_t)cmd.addr,
+                             is_read, time_secs, vb);
+        if (res) {
+            if (SG_LIB_NVME_STATUS == res) {
+                mk_sense_from_nvme_status(ptp, vb);
+                res = 0;
+            }
+            break;
+        }
+    }
+    *done_p = off;
+    return res;
+}
+
+/* Translates READ(10,16), WRITE(10,16) and VERIFY(10,16) to NVMe Read,
+ * Write and Compare commands. The data buffer given by the caller is
+ * handed to the NVMe command, there is no bounce buffer. Transfers larger
+ * than a single NVMe command can carry (NLB is 16 bits and the controller
+ * may have a MDTS limit) are split into several NVMe commands. VERIFY
+ * with BYTCHK=0 (medium verification) reads into a scratch buffer which
+ * is then discarded; BYTCHK=3 compares each LB with the single LB given
+ * in the data-out buffer. Protection information is not supported. */
+static int
+sntl_rwv(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int time_secs,
+         int vb)
+{
+    bool is_16 = (cdbp[0] >= SCSI_READ16_OPC);
+    bool is_read = false;
+    bool scratch = false;
+    int res, bytchk;
+    uint8_t opc;
+    uint32_t num, max_nlb, lbs, len, cdw12_flags;
+    uint64_t lba, done;
+    uint8_t * bp = NULL;
+    uint8_t * free_bp = NULL;
+    const struct sg_nvme_geom * gp = &ptp->nvme_geom;
+
+    if (is_16) {
+        lba = sg_get_unaligned_be64(cdbp + 2);
+        num = sg_get_unaligned_be32(cdbp + 10);
+    } else {
+        lba = sg_get_unaligned_be32(cdbp + 2);
+        num = sg_get_unaligned_be16(cdbp + 7);
+    }
+    if (vb > 3)
+        pr2ws("%s: opcode=0x%x, lba=0x%" PRIx64 ", num=%u\n", __func__,
+              cdbp[0], lba, num);
+    if (0xe0 & cdbp[1]) {       /* RDPROTECT, WRPROTECT or VRPROTECT */
+        mk_sense_invalid_fld(ptp, true, 1, 7, vb);
+        return 0;
+    }
+    bytchk = 0x3 & (cdbp[1] >> 1);
+    cdw12_flags = (0x8 & cdbp[1]) ? NVME_CDW12_FUA : 0;
+    switch (cdbp[0]) {
+    case SCSI_READ10_OPC:
+    case SCSI_READ16_OPC:
+        opc = NVME_NVM_READ_OPC;
+        is_read = true;
+        break;
+    case SCSI_WRITE10_OPC:
+    case SCSI_WRITE16_OPC:
+        opc = NVME_NVM_WRITE_OPC;
+        break;
+    default:            /* VERIFY(10) or VERIFY(16) */
+        if (2 == bytchk) {
+            mk_sense_invalid_fld(ptp, true, 1, 2, vb);
+            return 0;
+        }
+        opc = bytchk ? NVME_NVM_COMPARE_OPC : NVME_NVM_READ_OPC;
+        is_read = (0 == bytchk);
+        scratch = (1 != bytchk);
+        cdw12_flags = 0;
+        break;
+    }
+    if (! sntl_media_ready(ptp, time_secs, &res, vb))
+        return res;
+    if ((lba > gp->nsze) || (num > (gp->nsze - lba))) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0,
+                          vb);
+        return 0;
+    }
+    if (0 == num)       /* not an error in SBC */
+        return 0;
+    lbs = 1U << gp->lbads;
+    max_nlb = sntl_max_nlb(gp, gp->mdts, (scratch ? SNTL_SCRATCH_MAX_BYTES :
+                                                    0x80000000U));
+    if (is_read && (! scratch)) {
+        len = ptp->io_hdr.din_xfer_len;
+        bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+    } else if (! is_read) {
+        len = ptp->io_hdr.dout_xfer_len;
+        bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+    } else
+        len = 0;
+    if ((! scratch) && (((uint64_t)num * lbs) > len)) {
+        if (vb)
+            pr2ws("%s: data-%s buffer (%u bytes) too short for %u LBs\n",
+                  __func__, (is_read ? "in" : "out"), len, num);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    if (scratch) {
+        if ((3 == bytchk) && (len < lbs)) {
+            if (vb)
+                pr2ws("%s: BYTCHK=3 needs a data-out buffer of one LB\n",
+                      __func__);
+            return SCSI_PT_DO_BAD_PARAMS;
+        }
+        if (max_nlb > num)
+            max_nlb = num;
+        bp = sntl_scratch(max_nlb, lbs, ((3 == bytchk) ? bp : NULL),
+                          &free_bp);
+        if (NULL == bp)
+            return sg_convert_errno(ENOMEM);
+    }
+    res = sntl_nvm_xfer(ptp, opc, lba, num, max_nlb, cdw12_flags, bp,
+                        scratch, is_read, &done, time_secs, vb);
+    if (! scratch) {
+        if (is_read)
+            ptp->io_hdr.din_resid = len - (done << gp->lbads);
+        else
+            ptp->io_hdr.dout_resid = len - (done << gp->lbads);
+    }
+    free(free_bp);
+    return res;
+}
+
+/* Translates WRITE SAME(10,16). If the data-out LB is all zeros (or NDOB
+ * is set) then NVMe Write Zeroes is used, with DEAC set when the UNMAP
+ * bit is set so the controller may deallocate rather than write zeros.
+ * Otherwise (or if the controller lacks Write Zeroes) the LB is replicated
+ * in a scratch buffer that is written with NVMe Write commands. */
+static int
+sntl_write_same(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
+                int time_secs, int vb)
+{
+    bool is_16 = (SCSI_WRITE_SAME16_OPC == cdbp[0]);
+    bool ndob = is_16 && (0x1 & cdbp[1]);
+    bool zero = true;
+    int res;
+    uint32_t lbs, max_nlb, len = 0;
+    uint64_t lba, num, done;
+    const uint8_t * dop = NULL;
+    uint8_t * bp;
+    uint8_t * free_bp = NULL;
+    const struct sg_nvme_geom * gp = &ptp->nvme_geom;
+
+    if (is_16) {
+        lba = sg_get_unaligned_be64(cdbp + 2);
+        num = sg_get_unaligned_be32(cdbp + 10);
+    } else {
+        lba = sg_get_unaligned_be32(cdbp + 2);
+        num = sg_get_unaligned_be16(cdbp + 7);
+    }
+    if (vb > 3)
+        pr2ws("%s: lba=0x%" PRIx64 ", num=%" PRIu64 ", unmap=%d, ndob=%d\n",
+              __func__, lba, num, !!(0x8 & cdbp[1]), (int)ndob);
+    if (0xe0 & cdbp[1]) {       /* WRPROTECT */
+        mk_sense_invalid_fld(ptp, true, 1, 7, vb);
+        return 0;
+    }
+    if (0x10 & cdbp[1]) {       /* ANCHOR: no anchored state in NVMe */
+        mk_sense_invalid_fld(ptp, true, 1, 4, vb);
+        return 0;
+    }
+    if (! sntl_media_ready(ptp, time_secs, &res, vb))
+        return res;
+    if (lba > gp->nsze) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0,
+                          vb);
+        return 0;
+    }
+    if (0 == num)       /* SBC: through to the last LBA */
+        num = gp->nsze - lba;
+    else if (num > (gp->nsze - lba)) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0,
+                          vb);
+        return 0;
+    }
+    lbs = 1U << gp->lbads;
+    if (! ndob) {
+        len = ptp->io_hdr.dout_xfer_len;
+        dop = (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+        if ((NULL == dop) || (len < lbs)) {
+            if (vb)
+                pr2ws("%s: data-out buffer (%u bytes) shorter than a LB\n",
+                      __func__, len);
+            return SCSI_PT_DO_BAD_PARAMS;
+        }
+        zero = sg_all_zeros(dop, lbs);
+        ptp->io_hdr.dout_resid = len - lbs;
+    }
+    if (zero && (NVME_ONCS_WRITE_ZEROES & gp->oncs)) {
+        max_nlb = sntl_max_nlb(gp, gp->wzsl,
+                               (uint64_t)NVME_NVM_MAX_NLB << gp->lbads);
+        return sntl_nvm_xfer(ptp, NVME_NVM_WRITE_ZEROES_OPC, lba, num,
+                             max_nlb, ((0x8 & cdbp[1]) ? NVME_CDW12_DEAC : 0),
+                             NULL, false, false, &done, time_secs, vb);
+    }
+    max_nlb = sntl_max_nlb(gp, gp->mdts, SNTL_SCRATCH_MAX_BYTES);
+    if (max_nlb > num)
+        max_nlb = (uint32_t)num;
+    if (0 == max_nlb)
+        return 0;
+    bp = sntl_scratch(max_nlb, lbs, (zero ? NULL : dop), &free_bp);
+    if (NULL == bp)
+        return sg_convert_errno(ENOMEM);
+    res = sntl_nvm_xfer(ptp, NVME_NVM_WRITE_OPC, lba, num, max_nlb, 0, bp,
+                        true, false, &done, time_secs, vb);
+    free(free_bp);
+    return res;
+}
+
+struct sntl_lb_range {
+    uint64_t lba;
+    uint64_t num;
+};
+
+static int
+sntl_lb_range_cmp(const void * ap, const void * bp)
+{
+    const struct sntl_lb_range * a = (const struct sntl_lb_range *)ap;
+    const struct sntl_lb_range * b = (const struct sntl_lb_range *)bp;
+
+    if (a->lba == b->lba)
+        return 0;
+    return (a->lba < b->lba) ? -1 : 1;
+}
+
+/* Sends a Dataset Management command with the Attribute Deallocate (AD)
+ * bit set for the nr ranges (16 bytes each) at rp. Returns as
+ * sg_nvme_io_cmd() does. */
+static int
+sntl_dsm_dealloc(struct sg_pt_linux_scsi * ptp, uint8_t * rp, int nr,
+                 int time_secs, int vb)
+{
+    struct sg_nvme_passthru_cmd cmd;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_NVM_DSM_OPC;
+    cmd.nsid = ptp->nvme_nsid;
+    cmd.cdw10 = nr - 1;                 /* NR is 0 based */
+    cmd.cdw11 = NVME_DSM_AD;
+    cmd.addr = (uint64_t)(sg_uintptr_t)rp;
+    cmd.data_len = 16 * nr;
+    return sg_nvme_io_cmd(ptp, &cmd, rp, false, time_secs, vb);
+}
+
+/* Translates UNMAP to NVMe Dataset Management (deallocate) commands. The
+ * UNMAP block descriptors are sorted and those that overlap or are
+ * adjacent are coalesced. Each NVMe command then carries as many ranges
+ * as the controller allows (DMRL, at most 256), no range being longer
+ * than DMRSL (or 2^32 - 1) LBs. */
+static int
+sntl_unmap(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
+           int time_secs, int vb)
+{
+    int res, k, j, nd, nr, max_nr;
+    uint32_t pl_len = sg_get_unaligned_be16(cdbp + 7);
+    uint32_t len = ptp->io_hdr.dout_xfer_len;
+    uint32_t bd_len, max_rlen, rlen;
+    uint64_t lba, num, end;
+    const uint8_t * dop = (const uint8_t *)(sg_uintptr_t)
+                          ptp->io_hdr.dout_xferp;
+    const uint8_t * bdp;
+    uint8_t * rp = NULL;
+    uint8_t * free_rp = NULL;
+    struct sntl_lb_range * arr = NULL;
+    struct sg_nvme_geom * gp = &ptp->nvme_geom;
+
+    if (vb > 3)
+        pr2ws("%s: param_list_len=%u\n", __func__, pl_len);
+    if (0x1 & cdbp[1]) {        /* ANCHOR: no anchored state in NVMe */
+        mk_sense_invalid_fld(ptp, true, 1, 0, vb);
+        return 0;
+    }
+    if (0 == pl_len)
+        return 0;
+    if ((pl_len > len) || (NULL == dop)) {
+        if (vb)
+            pr2ws("%s: parameter list length (%u) exceeds data-out buffer "
+                  "(%u bytes)\n", __func__, pl_len, len);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    ptp->io_hdr.dout_resid = len - pl_len;
+    if (pl_len < 8) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST,
+                          PARAMETER_LIST_LENGTH_ERR, 0, vb);
+        return 0;
+    }
+    bd_len = sg_get_unaligned_be16(dop + 2);
+    if (bd_len > (pl_len - 8)) {
+        mk_sense_invalid_fld(ptp, false, 2, -1, vb);
+        return 0;
+    }
+    nd = bd_len / 16;
+    if (! sntl_media_ready(ptp, time_secs, &res, vb))
+        return res;
+    if (0 == (NVME_ONCS_DSM & gp->oncs)) {
+        if (vb > 2)
+            pr2ws("%s: controller lacks Dataset Management\n", __func__);
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_OPCODE, 0,
+                          vb);
+        return 0;
+    }
+    if (0 == nd)
+        return 0;
+    arr = (struct sntl_lb_range *)calloc(nd, sizeof(*arr));
+    if (NULL == arr)
+        return sg_convert_errno(ENOMEM);
+    for (k = 0, j = 0, bdp = dop + 8; k < nd; ++k, bdp += 16) {
+        lba = sg_get_unaligned_be64(bdp + 0);
+        num = sg_get_unaligned_be32(bdp + 8);
+        if ((lba > gp->nsze) || (num > (gp->nsze - lba))) {
+            mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE,
+                              0, vb);
+            goto fini;
+        }
+        if (num > 0) {
+            arr[j].lba = lba;
+            arr[j++].num = num;
+        }
+    }
+    nd = j;
+    if (0 == nd)
+        goto fini;
+    qsort(arr, nd, sizeof(*arr), sntl_lb_range_cmp);
+    for (k = 1, j = 0; k < nd; ++k) {   /* coalesce */
+        end = arr[j].lba + arr[j].num;
+        if (arr[k].lba <= end) {
+            if ((arr[k].lba + arr[k].num) > end)
+                arr[j].num = arr[k].lba + arr[k].num - arr[j].lba;
+        } else
+            arr[++j] = arr[k];
+    }
+    nd = j + 1;
+    if (! gp->nvm_lims)
+        sntl_cache_nvm_lims(ptp, time_secs, vb);
+    max_nr = gp->dmrl ? gp->dmrl : NVME_DSM_MAX_RANGES;
+    max_rlen = gp->dmrsl ? gp->dmrsl : 0xffffffff;
+    if (vb > 3)
+        pr2ws("%s: %d coalesced ranges, max_nr=%d, max_rlen=%u\n", __func__,
+              nd, max_nr, max_rlen);
+    rp = sg_memalign(16 * NVME_DSM_MAX_RANGES, 0, &free_rp, false);
+    if (NULL == rp) {
+        res = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0, nr = 0; k < nd; ++k) {
+        for (lba = arr[k].lba, num = arr[k].num; num > 0;
+             lba += rlen, num -= rlen) {
+            rlen = (num > max_rlen) ? max_rlen : (uint32_t)num;
+            sg_put_unaligned_le32(0, rp + (16 * nr) + 0);  /* attributes */
+            sg_put_unaligned_le32(rlen, rp + (16 * nr) + 4);
+            sg_put_unaligned_le64(lba, rp + (16 * nr) + 8);
+            if (++nr >= max_nr) {
+                res = sntl_dsm_dealloc(ptp, rp, nr, time_secs, vb);
+                if (res)
+                    goto fini;
+                nr = 0;
+            }
+        }
+    }
+    if (nr > 0)
+        res = sntl_dsm_dealloc(ptp, rp, nr, time_secs, vb);
 fini:
-    if (free_up)
-        free(free_up);
+    if (SG_LIB_NVME_STATUS == res) {
+        mk_sense_from_nvme_status(ptp, vb);
+        res = 0;
+    }
+    free(free_rp);
+    free(arr);
+    return res;
+}
+
+/* Adds a GET LBA STATUS descriptor to resp (after the 8 byte header) if
+ * report type rt wants it and there is room. Returns false when full. */
+static bool
+sntl_lba_stat_desc(uint8_t * resp, int * np, int max_desc, int rt,
+                   uint64_t lba, uint64_t num, bool dealloc)
+{
+    uint32_t n;
+    uint8_t * dp;
+
+    if (! ((0 == rt) || ((2 == rt) && (! dealloc)) ||
+           (((1 == rt) || (3 == rt)) && dealloc)))
+        return true;
+    for ( ; (num > 0) && (*np < max_desc); lba += n, num -= n, ++*np) {
+        n = (num > 0xffffffff) ? 0xffffffff : (uint32_t)num;
+        dp = resp + 8 + (16 * *np);
+        sg_put_unaligned_be64(lba, dp + 0);
+        sg_put_unaligned_be32(n, dp + 8);
+        dp[12] = dealloc ? 0x1 : 0x0;   /* provisioning status */
+    }
+    return *np < max_desc;
+}
+
+/* Translates GET LBA STATUS(16). NVMe has no command that reports which
+ * LBs are deallocated. However when DLFEAT says deallocated LBs read as
+ * zeros, LBs that read back as all zeros are reported as deallocated;
+ * at most SNTL_LBA_STATUS_SCAN_BYTES are read from the starting LBA, the
+ * application can continue from the last LBA reported. Otherwise one
+ * descriptor to the end of the namespace with provisioning status
+ * "mapped or unknown" is returned. */
+static int
+sntl_get_lba_status(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
+                    int time_secs, int vb)
+{
+    bool dealloc, run_dealloc = false;
+    int res, n, max_desc, rt;
+    uint32_t k, lbs, max_nlb, nlb, alloc_len, len;
+    uint64_t lba, cur, run_lba, scan_end, done;
+    uint8_t * resp = NULL;
+    uint8_t * bp = NULL;
+    uint8_t * free_bp = NULL;
+    const struct sg_nvme_geom * gp = &ptp->nvme_geom;
+
+    lba = sg_get_unaligned_be64(cdbp + 2);
+    alloc_len = sg_get_unaligned_be32(cdbp + 10);
+    rt = cdbp[14];
+    if (vb > 3)
+        pr2ws("%s: lba=0x%" PRIx64 ", alloc_len=%u, report_type=%d\n",
+              __func__, lba, alloc_len, rt);
+    if (! sntl_media_ready(ptp, time_secs, &res, vb))
+        return res;
+    if (lba >= gp->nsze) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0,
+                          vb);
+        return 0;
+    }
+    max_desc = (alloc_len < 24) ? 0 : ((alloc_len - 8) / 16);
+    if (max_desc > 1024)
+        max_desc = 1024;
+    resp = (uint8_t *)calloc(8 + (16 * max_desc), 1);
+    if (NULL == resp)
+        return sg_convert_errno(ENOMEM);
+    n = 0;
+    res = 0;
+    if (0 == max_desc)
+        ;
+    else if (0x1 != (0x7 & gp->dlfeat))
+        sntl_lba_stat_desc(resp, &n, max_desc, rt, lba, gp->nsze - lba,
+                           false);
+    else {
+        lbs = 1U << gp->lbads;
+        max_nlb = sntl_max_nlb(gp, gp->mdts, SNTL_SCRATCH_MAX_BYTES);
+        bp = sntl_scratch(max_nlb, lbs, NULL, &free_bp);
+        if (NULL == bp) {
+            res = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+        scan_end = lba + (SNTL_LBA_STATUS_SCAN_BYTES >> gp->lbads);
+        if (scan_end > gp->nsze)
+            scan_end = gp->nsze;
+        for (cur = lba, run_lba = lba; cur < scan_end; cur += nlb) {
+            nlb = ((scan_end - cur) > max_nlb) ? max_nlb :
+                                                 (uint32_t)(scan_end - cur);
+            res = sntl_nvm_xfer(ptp, NVME_NVM_READ_OPC, cur, nlb, max_nlb,
+                                0, bp, true, true, &done, time_secs, vb);
+            if (res || (done < nlb))
+                goto fini;      /* error or sense data built */
+            for (k = 0; k < nlb; ++k) {
+                dealloc = sg_all_zeros(bp + ((uint64_t)k * lbs), lbs);
+                if ((cur + k) == lba)
+                    run_dealloc = dealloc;
+                else if (dealloc != run_dealloc) {
+                    if (! sntl_lba_stat_desc(resp, &n, max_desc, rt,
+                                             run_lba, cur + k - run_lba,
+                                             run_dealloc))
+                        goto done;
+                    run_lba = cur + k;
+                    run_dealloc = dealloc;
+                }
+            }
+        }
+        sntl_lba_stat_desc(resp, &n, max_desc, rt, run_lba, cur - run_lba,
+                           run_dealloc);
+    }
+done:
+    sg_put_unaligned_be32(4 + (16 * n), resp + 0);
+    resp[7] = 0x1;                      /* RTP: report type honoured */
+    len = 8 + (16 * n);
+    if (len > alloc_len)
+        len = alloc_len;
+    if (len > ptp->io_hdr.din_xfer_len)
+        len = ptp->io_hdr.din_xfer_len;
+    if (len > 0)
+        memcpy((uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp, resp, len);
+    ptp->io_hdr.din_resid = ptp->io_hdr.din_xfer_len - len;
+fini:
+    free(free_bp);
+    free(resp);
+    return res;
+}
+
+/* Determines whether the namespace is a zoned one by looking for a Command
+ * Set Identifier of ZNS in its Namespace Identification Descriptor list
+ * (CNS 3). If so the zone size is taken from the ZNS specific Identify
+ * namespace data structure (CNS 5, CSI 2). Controllers that predate the
+ * descriptor list have no zoned namespaces. Returns 0 unless there is an
+ * OS error (negated errno) or a resource problem (positive value). */
+static int
+sntl_cache_zns(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
+{
+    int res, k, nidl;
+    uint8_t csi = 0;
+    const uint8_t * up;
+    struct sg_nvme_geom * gp = &ptp->nvme_geom;
+    struct sg_nvme_id_ent * ep;
+
+    res = sntl_id_get(ptp, 0x3 /* CNS */, ptp->nvme_nsid, 0, time_secs, &ep,
+                      vb);
+    if ((res < 0) || ((res > 0) && (SG_LIB_NVME_STATUS != res)))
+        return res;
+    if (0 == res) {
+        up = ep->up;
+        for (k = 0; k < (SG_NVME_ID_LEN - 4); k += 4 + nidl) {
+            nidl = up[k + 1];
+            if (0 == up[k])             /* NIDT 0: end of list */
+                break;
+            if ((0x4 == up[k]) && (nidl > 0)) {     /* NIDT 4: CSI */
+                csi = up[k + 4];
+                break;
+            }
+        }
+        sntl_id_put(ep);
+    }
+    if (NVME_CSI_ZNS == csi) {
+        /* CNS 5: I/O command set specific Identify namespace */
+        res = sntl_id_get(ptp, 0x5, ptp->nvme_nsid, NVME_CSI_ZNS, time_secs,
+                          &ep, vb);
+        if ((res < 0) || ((res > 0) && (SG_LIB_NVME_STATUS != res)))
+            return res;
+        if (0 == res) {
+            gp->zsze = sg_get_unaligned_le64(ep->up + 2816 +
+                                             (16 * gp->lbaf));
+            gp->zns = (gp->zsze > 0);
+            sntl_id_put(ep);
+        }
+    }
+    if (vb > 3)
+        pr2ws("%s: csi=%u, zns=%d, zsze=%" PRIu64 "\n", __func__, csi,
+              (int)gp->zns, gp->zsze);
+    gp->zns_known = true;
+    return 0;
+}
+
+/* As sntl_media_ready() and additionally checks that the namespace is a
+ * zoned one; if not, builds INVALID OPCODE sense data as a SCSI disk that
+ * is not a ZBC device would. */
+static bool
+sntl_zoned_ready(struct sg_pt_linux_scsi * ptp, int time_secs, int * resp,
+                 int vb)
+{
+    if (! sntl_media_ready(ptp, time_secs, resp, vb))
+        return false;
+    if (! ptp->nvme_geom.zns_known) {
+        *resp = sntl_cache_zns(ptp, time_secs, vb);
+        if (*resp)
+            return false;
+    }
+    if (! ptp->nvme_geom.zns) {
+        if (vb > 1)
+            pr2ws("%s: namespace is not zoned\n", __func__);
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_OPCODE, 0,
+                          vb);
+        return false;
+    }
+    return true;
+}
+
+/* Converts, in place, a 64 byte NVMe Zone Descriptor (little endian) to a
+ * ZBC zone descriptor (big endian). The zone types and zone states (ZBC:
+ * zone conditions) of the two standards have the same values. */
+static void
+sntl_zdesc_to_zbc(uint8_t * dp, uint64_t zsze)
+{
+    uint8_t zt = 0xf & dp[0];
+    uint8_t zs = 0xf & (dp[1] >> 4);
+    uint8_t za = dp[2];
+    uint64_t zslba = sg_get_unaligned_le64(dp + 16);
+    uint64_t wp = sg_get_unaligned_le64(dp + 24);
+
+    memset(dp, 0, 64);
+    dp[0] = zt;
+    dp[1] = (zs << 4) | ((NVME_ZA_RZR & za) ? 0x1 : 0x0);   /* RESET */
+    sg_put_unaligned_be64(zsze, dp + 8);
+    sg_put_unaligned_be64(zslba, dp + 16);
+    sg_put_unaligned_be64(wp, dp + 24);
+}
+
+/* Issues one NVMe Zone Management Receive (Report Zones) command placing
+ * len bytes in bp. Returns as sg_nvme_io_cmd() does. */
+static int
+sntl_zm_recv(struct sg_pt_linux_scsi * ptp, uint64_t slba, int zrasf,
+             bool partial, uint8_t * bp, uint32_t len, int time_secs, int vb)
+{
+    struct sg_nvme_passthru_cmd cmd;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_NVM_ZONE_MGMT_RECV_OPC;
+    cmd.nsid = ptp->nvme_nsid;
+    cmd.cdw10 = (uint32_t)slba;
+    cmd.cdw11 = (uint32_t)(slba >> 32);
+    cmd.cdw12 = (len / 4) - 1;          /* NUMD, 0 based */
+    cmd.cdw13 = ((uint32_t)zrasf << 8) | (partial ? NVME_ZRA_PARTIAL : 0);
+    cmd.addr = (uint64_t)(sg_uintptr_t)bp;
+    cmd.data_len = len;
+    return sg_nvme_io_cmd(ptp, &cmd, bp, true, time_secs, vb);
+}
+
+/* Translates REPORT ZONES to NVMe Zone Management Receive (Report Zones).
+ * Both reports are a 64 byte header followed by 64 byte zone descriptors
+ * so the NVMe report is placed directly in the caller's buffer and each
+ * descriptor is converted in place. Reports larger than one NVMe command
+ * can carry (MDTS) are fetched with several commands; the header of each
+ * later command lands on the last descriptor of the previous one, which
+ * is saved and put back. The first command is not partial so it yields
+ * the number of matching zones for the SCSI zone list length. */
+static int
+sntl_rep_zones(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
+               int time_secs, int vb)
+{
+    bool partial = !! (0x80 & cdbp[14]);
+    int res, zrasf;
+    int ro = 0x3f & cdbp[14];
+    uint32_t k, len, alloc_len, max_desc, want, max_chunk, got, n;
+    uint64_t lba, total, next;
+    uint8_t * bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+    uint8_t * cp;
+    const struct sg_nvme_geom * gp = &ptp->nvme_geom;
+    uint8_t hdr[64];
+    uint8_t save[64];
+
+    lba = sg_get_unaligned_be64(cdbp + 2);
+    alloc_len = sg_get_unaligned_be32(cdbp + 10);
+    if (vb > 3)
+        pr2ws("%s: lba=0x%" PRIx64 ", alloc_len=%u, ro=0x%x, partial=%d\n",
+              __func__, lba, alloc_len, ro, (int)partial);
+    if (! sntl_zoned_ready(ptp, time_secs, &res, vb))
+        return res;
+    if (lba >= gp->nsze) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0,
+                          vb);
+        return 0;
+    }
+    switch (ro) {
+    case 0x0:   /* all */
+    case 0x1:   /* empty */
+    case 0x2:   /* implicitly opened */
+    case 0x3:   /* explicitly opened */
+    case 0x4:   /* closed */
+    case 0x5:   /* full */
+    case 0x6:   /* read only */
+    case 0x7:   /* offline */
+        zrasf = ro;     /* same values in ZRASF */
+        break;
+    case 0x10:  /* reset recommended: not selectable by ZRASF */
+    case 0x11:  /* non-sequential write resources active */
+    case 0x3f:  /* not write pointer: ZNS has only sequential zones */
+        zrasf = -1;
+        break;
+    default:
+        mk_sense_invalid_fld(ptp, true, 14, 5, vb);
+        return 0;
+    }
+    len = (alloc_len < ptp->io_hdr.din_xfer_len) ? alloc_len :
+                                                   ptp->io_hdr.din_xfer_len;
+    max_desc = (len < 128) ? 0 : ((len - 64) / 64);
+    max_chunk = SNTL_ZONE_REPORT_MAX_BYTES;
+    if (gp->mdts && (gp->mdts < 10) &&
+        (((uint32_t)NVME_MPSMIN_BYTES << gp->mdts) < max_chunk))
+        max_chunk = (uint32_t)NVME_MPSMIN_BYTES << gp->mdts;
+    max_chunk = (max_chunk / 64) - 1;   /* now in descriptors */
+    total = 0;
+    n = 0;
+    if (zrasf < 0)
+        ;
+    else if (0 == max_desc) {   /* only room for the header */
+        res = sntl_zm_recv(ptp, lba, zrasf, false, hdr, sizeof(hdr),
+                           time_secs, vb);
+        if (res)
+            goto err_out;
+        total = sg_get_unaligned_le64(hdr + 0);
+    } else {
+        for (next = lba; n < max_desc; ) {
+            want = ((max_desc - n) > max_chunk) ? max_chunk : (max_desc - n);
+            cp = bp + (64 * n);         /* last descriptor, or header */
+            if (n > 0)
+                memcpy(save, cp, 64);
+            res = sntl_zm_recv(ptp, next, zrasf, (n > 0) || partial, cp,
+                               64 * (want + 1), time_secs, vb);
+            if (res) {
+                if (n > 0)
+                    memcpy(cp, save, 64);
+                goto err_out;
+            }
+            got = (uint32_t)sg_get_unaligned_le64(cp + 0);
+            if (0 == n)
+                total = sg_get_unaligned_le64(cp + 0);
+            if (got > want)             /* first, not partial, command */
+                got = want;
+            if (n > 0)
+                memcpy(cp, save, 64);
+            for (k = 0; k < got; ++k)
+                sntl_zdesc_to_zbc(cp + 64 + (64 * k), gp->zsze);
+            n += got;
+            if (got < want)
+                break;
+            next = sg_get_unaligned_be64(bp + (64 * n) + 16) + gp->zsze;
+            if (next >= gp->nsze)
+                break;
+        }
+    }
+    memset(hdr, 0, sizeof(hdr));
+    if (partial)
+        total = n;
+    if (total > (0xffffffffU / 64))
+        total = 0xffffffffU / 64;
+    sg_put_unaligned_be32(64 * (uint32_t)total, hdr + 0);
+    hdr[4] = 0x1;               /* SAME: all zones have the same length */
+    sg_put_unaligned_be64(gp->nsze - 1, hdr + 8);
+    k = (len < 64) ? len : 64;
+    if (k > 0)
+        memcpy(bp, hdr, k);
+    ptp->io_hdr.din_resid = ptp->io_hdr.din_xfer_len -
+                            ((len < 64) ? len : (64 + (64 * n)));
+    return 0;
+err_out:
+    if (SG_LIB_NVME_STATUS == res) {
+        mk_sense_from_nvme_status(ptp, vb);
+        return 0;
+    }
+    return res;
+}
+
+/* Translates the ZBC OUT zone actions (CLOSE ZONE, FINISH ZONE, OPEN ZONE
+ * and RESET WRITE POINTER) to NVMe Zone Management Send commands, whose
+ * Zone Send Action values are the same as those service actions. The ALL
+ * bit maps to Select All; a ZONE COUNT greater than 1 is done with one
+ * command per zone. */
+static int
+sntl_zbc_out(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
+             int time_secs, int vb)
+{
+    bool all = !! (0x1 & cdbp[14]);
+    int res;
+    int sa = SCSI_SA_MSK & cdbp[1];
+    uint32_t k, count;
+    uint64_t zid;
+    const struct sg_nvme_geom * gp = &ptp->nvme_geom;
+    struct sg_nvme_passthru_cmd cmd;
+
+    zid = sg_get_unaligned_be64(cdbp + 2);
+    count = sg_get_unaligned_be16(cdbp + 12);
+    if (vb > 3)
+        pr2ws("%s: sa=%d, zone_id=0x%" PRIx64 ", count=%u, all=%d\n",
+              __func__, sa, zid, count, (int)all);
+    if ((sa < SCSI_CLOSE_ZONE_SA) || (sa > SCSI_RESET_WP_SA)) {
+        mk_sense_invalid_fld(ptp, true, 1, 4, vb);
+        return 0;
+    }
+    if (! sntl_zoned_ready(ptp, time_secs, &res, vb))
+        return res;
+    if (all)
+        count = 1;
+    else {
+        if ((zid >= gp->nsze) || (zid % gp->zsze)) {
+            mk_sense_invalid_fld(ptp, true, 2, -1, vb);
+            return 0;
+        }
+        if (0 == count)
+            count = 1;
+        if (count > ((gp->nsze - zid) / gp->zsze)) {
+            mk_sense_invalid_fld(ptp, true, 12, -1, vb);
+            return 0;
+        }
+    }
+    for (k = 0; k < count; ++k, zid += gp->zsze) {
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.opcode = NVME_NVM_ZONE_MGMT_SEND_OPC;
+        cmd.nsid = ptp->nvme_nsid;
+        cmd.cdw10 = (uint32_t)zid;
+        cmd.cdw11 = (uint32_t)(zid >> 32);
+        cmd.cdw13 = sa | (all ? NVME_ZSA_SELECT_ALL : 0);
+        res = sg_nvme_io_cmd(ptp, &cmd, NULL, false, time_secs, vb);
+        if (SG_LIB_NVME_STATUS == res) {
+            mk_sense_from_nvme_status(ptp, vb);
+            return 0;
+        } else if (res)
+            return res;
+    }
+    return 0;
+}
+
+/* Translates SYNCHRONIZE CACHE(10,16) to a NVMe Flush of the whole
+ * namespace. The LBA range and the IMMED bit are ignored. */
+static int
+sntl_sync_cache(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
+{
+    int res;
+    struct sg_nvme_passthru_cmd cmd;
+
+    if (vb > 4)
+        pr2ws("%s: time_secs=%d\n", __func__, time_secs);
+    if (! sntl_media_ready(ptp, time_secs, &res, vb))
+        return res;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_NVM_FLUSH_OPC;
+    cmd.nsid = ptp->nvme_nsid;
+    res = sg_nvme_io_cmd(ptp, &cmd, NULL, false, time_secs, vb);
+    if (SG_LIB_NVME_STATUS == res) {
+        mk_sense_from_nvme_status(ptp, vb);
+        return 0;
+    }
     return res;
 }
 
@@ -1288,6 +2615,7 @@ sg_do_nvme_pt(struct sg_pt_base * vp, int fd, int time_secs, int vb)
     /* direct NVMe command (i.e. 64 bytes long) or SNTL */
     ptp->nvme_direct = ! scsi_cdb;
     if (scsi_cdb) {
+        sntl_id_check(ptp);
         switch (cdbp[0]) {
         case SCSI_INQUIRY_OPC:
             return sntl_inq(ptp, cdbp, time_secs, vb);
@@ -1309,6 +2637,29 @@ sg_do_nvme_pt(struct sg_pt_base * vp, int fd, int time_secs, int vb)
         case SCSI_SERVICE_ACT_IN_OPC:
             if (SCSI_READ_CAPACITY16_SA == (cdbp[1] & SCSI_SA_MSK))
                 return sntl_readcap(ptp, cdbp, time_secs, vb);
+            else if (SCSI_GET_LBA_STATUS16_SA == (cdbp[1] & SCSI_SA_MSK))
+                return sntl_get_lba_status(ptp, cdbp, time_secs, vb);
+            goto fini;
+        case SCSI_READ10_OPC:
+        case SCSI_READ16_OPC:
+        case SCSI_WRITE10_OPC:
+        case SCSI_WRITE16_OPC:
+        case SCSI_VERIFY10_OPC:
+        case SCSI_VERIFY16_OPC:
+            return sntl_rwv(ptp, cdbp, time_secs, vb);
+        case SCSI_SYNC_CACHE10_OPC:
+        case SCSI_SYNC_CACHE16_OPC:
+            return sntl_sync_cache(ptp, time_secs, vb);
+        case SCSI_WRITE_SAME10_OPC:
+        case SCSI_WRITE_SAME16_OPC:
+            return sntl_write_same(ptp, cdbp, time_secs, vb);
+        case SCSI_UNMAP_OPC:
+            return sntl_unmap(ptp, cdbp, time_secs, vb);
+        case SCSI_ZBC_OUT_OPC:
+            return sntl_zbc_out(ptp, cdbp, time_secs, vb);
+        case SCSI_ZBC_IN_OPC:
+            if (SCSI_REPORT_ZONES_SA == (cdbp[1] & SCSI_SA_MSK))
+                return sntl_rep_zones(ptp, cdbp, time_secs, vb);
             goto fini;
         case SCSI_MAINT_IN_OPC:
             sa = SCSI_SA_MSK & cdbp[1];        /* service action */
@@ -1382,4 +2733,10 @@ sg_do_nvme_pt(struct sg_pt_base * vp, int fd, int time_secs, int vb)
     return -ENOTTY;             /* inappropriate ioctl error */
 }
 
+void
+sg_nvme_id_release(struct sg_pt_linux_scsi * ptp)
+{
+    if (ptp) { ; }              /* suppress warning */
+}
+
 #endif          /* (HAVE_NVME && (! IGNORE_NVME)) */
@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_pt_linux_trace version 1.00 20261017 */
+
+/* This file contains the command trace capture used by do_scsi_pt() when
+ * the SG3_UTILS_TRACE environment variable is set to 'FILE[,data]'. FILE
+ * is opened for appending (and created if needed) so FILE may not contain
+ * a comma. The record format is described in sg_io_linux.h .
+ *
+ * The aim is to keep the capture overhead low enough that it can be left
+ * on during heavily multi-threaded runs (e.g. sgp_dd). So each thread
+ * builds its records in its own buffer, without locks, and that buffer is
+ * handed to the kernel with a single write() when it fills. As FILE is
+ * opened with O_APPEND those writes don't interleave. Remaining buffered
+ * records are written at process exit. Records from different threads
+ * are therefore not in time order in FILE; replay tools should sort them
+ * by their timestamps. Data hashes (',data') read all the data so they
+ * do cost something on large transfers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_pt.h"
+#include "sg_lib.h"
+#include "sg_linux_inc.h"
+#include "sg_io_linux.h"
+#include "sg_pt_linux.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+#define SG_TRACE_BUF_SZ (64 * 1024)     /* per thread */
+#define SG_TRACE_SEG_LEN 40
+#define SG_TRACE_CMD_LEN 40             /* fixed part of command record */
+#define SG_TRACE_INITING (-2)
+
+struct sg_trace_buf {
+    struct sg_trace_buf * next;         /* list of all thread buffers */
+    bool busy;          /* owning thread or exit flush is using this */
+    uint32_t len;
+    uint32_t tid;
+    uint8_t b[SG_TRACE_BUF_SZ];
+};
+
+/* Information gathered by the two record producers */
+struct sg_trace_cmd {
+    int flags;
+    int cdb_len;
+    int sense_len;
+    int status;
+    int resid;
+    int res;
+    uint32_t din_len;
+    uint32_t din_act;           /* bytes actually received */
+    uint32_t dout_len;
+    uint64_t start_ns;
+    const uint8_t * cdbp;
+    const uint8_t * sbp;
+    const uint8_t * dinp;       /* NULL if data-in not to be hashed */
+    const uint8_t * doutp;      /* NULL if data-out not to be hashed */
+};
+
+int sg_pt_trace_state = -1;
+
+static int trace_fd = -1;
+static bool trace_data;
+static int trace_lost;                  /* records lost by failed writes */
+static uint64_t trace_base_ns;
+static struct sg_trace_buf * trace_head;
+static __thread struct sg_trace_buf * trace_tbp;
+
+
+uint64_t
+sg_pt_trace_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+uint64_t
+sg_pt_trace_hash(const uint8_t * bp, uint32_t len)
+{
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for ( ; len >= 8; len -= 8, bp += 8) {
+        h ^= sg_get_unaligned_le64(bp);
+        h *= prime;
+    }
+    for ( ; len > 0; --len) {
+        h ^= *bp++;
+        h *= prime;
+    }
+    return h;
+}
+
+static void
+trace_flush(struct sg_trace_buf * tbp)
+{
+    if (tbp->len > 0) {
+        if (write(trace_fd, tbp->b, tbp->len) < (ssize_t)tbp->len)
+            __atomic_add_fetch(&trace_lost, 1, __ATOMIC_RELAXED);
+        tbp->len = 0;
+    }
+}
+
+/* Called at process exit. Buffers in use by another thread (unlikely at
+ * this point) are skipped. */
+static void
+trace_flush_all(void)
+{
+    struct sg_trace_buf * tbp;
+
+    __atomic_store_n(&sg_pt_trace_state, 0, __ATOMIC_RELEASE);
+    tbp = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+    for ( ; tbp; tbp = tbp->next) {
+        if (__atomic_test_and_set(&tbp->busy, __ATOMIC_ACQUIRE))
+            continue;
+        trace_flush(tbp);
+        __atomic_clear(&tbp->busy, __ATOMIC_RELEASE);
+    }
+    if (trace_lost)
+        pr2ws("%s: failed to write %d trace buffers\n", SG_PT_TRACE_EV,
+              trace_lost);
+}
+
+/* Only one thread does the work, others wait for it to finish */
+static void
+trace_init(void)
+{
+    int expect = -1;
+    int new_state = 0;
+    int fd;
+    struct timespec ts;
+    const char * cp;
+    char * op;
+    char b[PATH_MAX];
+    uint8_t seg[SG_TRACE_SEG_LEN];
+
+    if (! __atomic_compare_exchange_n(&sg_pt_trace_state, &expect,
+                                      SG_TRACE_INITING, false,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        while (SG_TRACE_INITING ==
+               __atomic_load_n(&sg_pt_trace_state, __ATOMIC_ACQUIRE))
+            sched_yield();
+        return;
+    }
+    cp = getenv(SG_PT_TRACE_EV);
+    if ((NULL == cp) || ('\0' == *cp))
+        goto fini;
+    snprintf(b, sizeof(b), "%s", cp);
+    op = strchr(b, ',');
+    if (op) {
+        *op++ = '\0';
+        if (0 == strcmp(op, "data"))
+            trace_data = true;
+        else
+            pr2ws("%s: unknown option '%s' ignored\n", SG_PT_TRACE_EV, op);
+    }
+    fd = open(b, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        pr2ws("%s: unable to open %s: %s\n", SG_PT_TRACE_EV, b,
+              safe_strerror(errno));
+        goto fini;
+    }
+    trace_base_ns = sg_pt_trace_now_ns();
+    clock_gettime(CLOCK_REALTIME, &ts);
+    memset(seg, 0, sizeof(seg));
+    sg_put_unaligned_le16(SG_TRACE_SEG_LEN, seg + 0);
+    seg[2] = SG_PT_TRACE_T_SEG;
+    seg[3] = SG_PT_TRACE_VERSION;
+    sg_put_unaligned_le32((uint32_t)getpid(), seg + 4);
+    memcpy(seg + 8, SG_PT_TRACE_MAGIC, 8);
+    sg_put_unaligned_le64(((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec,
+                          seg + 16);
+    sg_put_unaligned_le32(trace_data ? 0x1 : 0, seg + 24);
+    if (write(fd, seg, sizeof(seg)) < (ssize_t)sizeof(seg)) {
+        pr2ws("%s: unable to write %s\n", SG_PT_TRACE_EV, b);
+        close(fd);
+        goto fini;
+    }
+    trace_fd = fd;
+    atexit(trace_flush_all);
+    new_state = 1;
+fini:
+    __atomic_store_n(&sg_pt_trace_state, new_state, __ATOMIC_RELEASE);
+}
+
+bool
+sg_pt_trace_active(void)
+{
+    int st = __atomic_load_n(&sg_pt_trace_state, __ATOMIC_ACQUIRE);
+
+    if (st < 0) {
+        trace_init();
+        st = __atomic_load_n(&sg_pt_trace_state, __ATOMIC_ACQUIRE);
+    }
+    return st > 0;
+}
+
+/* Returns this thread's buffer marked as busy, or NULL */
+static struct sg_trace_buf *
+trace_get_buf(void)
+{
+    struct sg_trace_buf * tbp = trace_tbp;
+
+    if (NULL == tbp) {
+        tbp = (struct sg_trace_buf *)calloc(1, sizeof(*tbp));
+        if (NULL == tbp)
+            return NULL;
+        tbp->tid = (uint32_t)syscall(SYS_gettid);
+        tbp->next = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+        while (! __atomic_compare_exchange_n(&trace_head, &tbp->next, tbp,
+                                             true, __ATOMIC_ACQ_REL,
+                                             __ATOMIC_ACQUIRE))
+            ;
+        trace_tbp = tbp;
+    }
+    if (__atomic_test_and_set(&tbp->busy, __ATOMIC_ACQUIRE))
+        return NULL;            /* being flushed at exit */
+    return tbp;
+}
+
+static void
+trace_put(const struct sg_trace_cmd * tcp)
+{
+    int cdb_len, sense_len, rlen;
+    uint64_t end_ns, dur, din_hash, dout_hash;
+    uint8_t * bp;
+    struct sg_trace_buf * tbp;
+    int flags = tcp->flags;
+
+    end_ns = sg_pt_trace_now_ns();
+    cdb_len = tcp->cdbp ? tcp->cdb_len : 0;
+    if (cdb_len > 255)
+        cdb_len = 255;
+    else if (cdb_len < 0)
+        cdb_len = 0;
+    sense_len = tcp->sbp ? tcp->sense_len : 0;
+    if (sense_len > 255)
+        sense_len = 255;
+    else if (sense_len < 0)
+        sense_len = 0;
+    rlen = SG_TRACE_CMD_LEN + cdb_len + sense_len;
+    din_hash = 0;
+    dout_hash = 0;
+    if (trace_data) {
+        if (tcp->dinp) {
+            din_hash = sg_pt_trace_hash(tcp->dinp, tcp->din_act);
+            flags |= SG_PT_TRACE_F_DIN_HASH;
+            rlen += 8;
+        }
+        if (tcp->doutp) {
+            dout_hash = sg_pt_trace_hash(tcp->doutp, tcp->dout_len);
+            flags |= SG_PT_TRACE_F_DOUT_HASH;
+            rlen += 8;
+        }
+    }
+    rlen = (rlen + 7) & ~7;
+
+    tbp = trace_get_buf();
+    if (NULL == tbp)
+        return;
+    if ((tbp->len + rlen) > SG_TRACE_BUF_SZ)
+        trace_flush(tbp);
+    bp = tbp->b + tbp->len;
+    memset(bp, 0, rlen);
+    sg_put_unaligned_le16(rlen, bp + 0);
+    bp[2] = SG_PT_TRACE_T_CMD;
+    bp[3] = (uint8_t)flags;
+    bp[4] = (uint8_t)cdb_len;
+    bp[5] = (uint8_t)sense_len;
+    sg_put_unaligned_le16((uint16_t)tcp->status, bp + 6);
+    sg_put_unaligned_le32(tbp->tid, bp + 8);
+    dur = (end_ns > tcp->start_ns) ? (end_ns - tcp->start_ns) / 1000 : 0;
+    sg_put_unaligned_le32((dur > UINT32_MAX) ? UINT32_MAX : (uint32_t)dur,
+                          bp + 12);
+    sg_put_unaligned_le64((tcp->start_ns > trace_base_ns) ?
+                          (tcp->start_ns - trace_base_ns) : 0, bp + 16);
+    sg_put_unaligned_le32(tcp->din_len, bp + 24);
+    sg_put_unaligned_le32(tcp->dout_len, bp + 28);
+    sg_put_unaligned_le32((uint32_t)tcp->resid, bp + 32);
+    sg_put_unaligned_le32((uint32_t)tcp->res, bp + 36);
+    bp += SG_TRACE_CMD_LEN;
+    if (flags & SG_PT_TRACE_F_DIN_HASH) {
+        sg_put_unaligned_le64(din_hash, bp);
+        bp += 8;
+    }
+    if (flags & SG_PT_TRACE_F_DOUT_HASH) {
+        sg_put_unaligned_le64(dout_hash, bp);
+        bp += 8;
+    }
+    if (cdb_len > 0)
+        memcpy(bp, tcp->cdbp, cdb_len);
+    if (sense_len > 0)
+        memcpy(bp + cdb_len, tcp->sbp, sense_len);
+    tbp->len += rlen;
+    __atomic_clear(&tbp->busy, __ATOMIC_RELEASE);
+}
+
+/* Called by do_scsi_pt() after the command in vp has completed */
+void
+sg_pt_trace_record(const struct sg_pt_base * vp, uint64_t start_ns, int res)
+{
+    int n;
+    const struct sg_pt_linux_scsi * ptp = &vp->impl;
+    const struct sg_io_v4 * h4p = &ptp->io_hdr;
+    struct sg_trace_cmd tc;
+
+    memset(&tc, 0, sizeof(tc));
+    tc.cdbp = (const uint8_t *)(sg_uintptr_t)h4p->request;
+    tc.cdb_len = h4p->request_len;
+    tc.sbp = (const uint8_t *)(sg_uintptr_t)h4p->response;
+    tc.sense_len = h4p->response_len;
+    if (ptp->nvme_direct) {
+        tc.flags |= SG_PT_TRACE_F_NVME;
+        tc.status = ptp->nvme_status;
+    } else
+        tc.status = h4p->device_status;
+    tc.din_len = h4p->din_xfer_len;
+    tc.dout_len = h4p->dout_xfer_len;
+    if (tc.din_len > 0) {
+        tc.flags |= SG_PT_TRACE_F_DIN;
+        n = (int)tc.din_len - h4p->din_resid;
+        tc.din_act = (n > 0) ? n : 0;
+        if (0 == h4p->din_iovec_count)
+            tc.dinp = (const uint8_t *)(sg_uintptr_t)h4p->din_xferp;
+    }
+    if (tc.dout_len > 0) {
+        tc.flags |= SG_PT_TRACE_F_DOUT;
+        if (0 == h4p->dout_iovec_count)
+            tc.doutp = (const uint8_t *)(sg_uintptr_t)h4p->dout_xferp;
+    }
+    tc.resid = get_scsi_pt_resid(vp);
+    tc.res = res;
+    tc.start_ns = start_ns;
+    trace_put(&tc);
+}
+
+void
+sg_pt_trace_v3(const struct sg_io_hdr * hp, uint64_t start_ns, int res)
+{
+    int n;
+    struct sg_trace_cmd tc;
+
+    if ((0 == __atomic_load_n(&sg_pt_trace_state, __ATOMIC_RELAXED)) ||
+        (! sg_pt_trace_active()))
+        return;
+    memset(&tc, 0, sizeof(tc));
+    tc.cdbp = hp->cmdp;
+    tc.cdb_len = hp->cmd_len;
+    tc.sbp = hp->sbp;
+    tc.sense_len = hp->sb_len_wr;
+    tc.status = hp->status;
+    if (hp->dxfer_len > 0) {
+        switch (hp->dxfer_direction) {
+        case SG_DXFER_TO_DEV:
+            tc.flags |= SG_PT_TRACE_F_DOUT;
+            tc.dout_len = hp->dxfer_len;
+            if (0 == hp->iovec_count)
+                tc.doutp = (const uint8_t *)hp->dxferp;
+            break;
+        case SG_DXFER_FROM_DEV:
+        case SG_DXFER_TO_FROM_DEV:
+            tc.flags |= SG_PT_TRACE_F_DIN;
+            tc.din_len = hp->dxfer_len;
+            n = (int)hp->dxfer_len - hp->resid;
+            tc.din_act = (n > 0) ? n : 0;
+            if (0 == hp->iovec_count)
+                tc.dinp = (const uint8_t *)hp->dxferp;
+            break;
+        default:
+            break;
+        }
+    }
+    tc.resid = hp->resid;
+    tc.res = res;
+    tc.start_ns = start_ns;
+    trace_put(&tc);
+}
+
+int
+sg_pt_trace_decode(const uint8_t * bp, int blen, struct sg_pt_trace_rec * rp)
+{
+    int rlen, n;
+
+    if (blen <= 0)
+        return 0;
+    if (blen < 8)
+        return -1;
+    rlen = sg_get_unaligned_le16(bp + 0);
+    if ((rlen < SG_TRACE_CMD_LEN) || (rlen > blen) || (rlen & 7))
+        return -1;
+    memset(rp, 0, sizeof(*rp));
+    rp->type = bp[2];
+    if (SG_PT_TRACE_T_SEG == rp->type) {
+        if (0 != memcmp(bp + 8, SG_PT_TRACE_MAGIC, 8))
+            return -1;
+        rp->pid = sg_get_unaligned_le32(bp + 4);
+        rp->start_ns = sg_get_unaligned_le64(bp + 16);
+        rp->flags = (int)sg_get_unaligned_le32(bp + 24);
+        return rlen;
+    } else if (SG_PT_TRACE_T_CMD != rp->type)
+        return rlen;            /* unknown type, caller should skip */
+    rp->flags = bp[3];
+    rp->cdb_len = bp[4];
+    rp->sense_len = bp[5];
+    rp->status = sg_get_unaligned_le16(bp + 6);
+    rp->tid = sg_get_unaligned_le32(bp + 8);
+    rp->duration_us = sg_get_unaligned_le32(bp + 12);
+    rp->start_ns = sg_get_unaligned_le64(bp + 16);
+    rp->din_len = sg_get_unaligned_le32(bp + 24);
+    rp->dout_len = sg_get_unaligned_le32(bp + 28);
+    rp->resid = (int)sg_get_unaligned_le32(bp + 32);
+    rp->res = (int)sg_get_unaligned_le32(bp + 36);
+    n = SG_TRACE_CMD_LEN;
+    if (rp->flags & SG_PT_TRACE_F_DIN_HASH) {
+        rp->din_hash = sg_get_unaligned_le64(bp + n);
+        n += 8;
+    }
+    if (rp->flags & SG_PT_TRACE_F_DOUT_HASH) {
+        rp->dout_hash = sg_get_unaligned_le64(bp + n);
+        n += 8;
+    }
+    if ((n + rp->cdb_len + rp->sense_len) > rlen)
+        return -1;
+    rp->cdbp = bp + n;
+    rp->sensep = bp + n + rp->cdb_len;
+    return rlen;
+}
@@ -0,0 +1,1124 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_pt_linux_uring version 1.02 20261017 */
+
+/* This file contains an io_uring based backend for the asynchronous
+ * pass-through interface (i.e. submit_scsi_pt(), receive_scsi_pt() and
+ * poll_scsi_pt() ) for devices that the sg and bsg drivers do not handle:
+ *   a) NVMe char devices (e.g. /dev/nvme0) and NVMe generic devices (e.g.
+ *      /dev/ng0n1): the NVMe command is sent with IORING_OP_URING_CMD.
+ *      64 byte NVMe commands are sent to the Admin queue while SCSI
+ *      READ(10,16), WRITE(10,16) and SYNCHRONIZE CACHE(10,16) are
+ *      translated to NVMe Read, Write and Flush commands and sent to an
+ *      I/O queue.
+ *   b) block devices (including NVMe namespace block devices) and regular
+ *      files: SCSI READ(10,16), WRITE(10,16) and SYNCHRONIZE CACHE(10,16)
+ *      are mapped to IORING_OP_READ, IORING_OP_WRITE (or their _FIXED
+ *      variants when the data buffer has been registered) and
+ *      IORING_OP_FSYNC.
+ * One ring is set up per file descriptor the first time it is used and
+ * that ring is torn down by scsi_pt_close_device(). Submissions are queued
+ * in the ring's submission queue (SQ) and only passed to the kernel (with
+ * one io_uring_enter() system call) when receive_scsi_pt() or
+ * poll_scsi_pt() is called, or when the SQ is full. A ring should only be
+ * used by one thread at a time. If the first command to use a ring has
+ * SCSI_PT_FLAGS_POLLED set, the ring is set up with IORING_SETUP_IOPOLL
+ * (when the device is a NVMe char device or a block device opened with
+ * O_DIRECT) so completions are found by polling the device's queues
+ * rather than waiting for an interrupt. Such rings only accept reads and
+ * writes (and NVMe Flush).
+ *
+ * The io_uring system calls are made directly (i.e. liburing is not
+ * required) and this backend needs the linux/io_uring.h header at build
+ * time. Without that header (or on kernels without io_uring) the functions
+ * in this file report that they are not supported.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1          /* for O_DIRECT */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/fs.h>           /* for BLKSSZGET and BLKGETSIZE64 */
+#include <linux/io_uring.h>
+#endif
+
+#include "sg_pt.h"
+#include "sg_lib.h"
+#include "sg_linux_inc.h"
+#include "sg_io_linux.h"
+#include "sg_pt_linux.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define SG_URING_BACKEND 1
+
+#if (HAVE_NVME && (! IGNORE_NVME)) && defined(IORING_SETUP_SQE128) && \
+    defined(IORING_SETUP_CQE32)
+#define SG_URING_NVME 1
+#endif
+
+#define DEF_TIMEOUT 60000       /* 60,000 millisecs (60 seconds) */
+
+#define SG_URING_DEF_ENTRIES 128        /* must be power of 2 */
+#define SG_URING_MAX_ENTRIES 4096
+#define SG_URING_MAX_FD 1024            /* rings kept for fds below this */
+#define SG_URING_EV_QD "SG3_UTILS_LINUX_URING_QD"
+
+#define SCSI_READ10_OPC 0x28
+#define SCSI_READ16_OPC 0x88
+#define SCSI_WRITE10_OPC 0x2a
+#define SCSI_WRITE16_OPC 0x8a
+#define SCSI_SYNC_CACHE10_OPC 0x35
+#define SCSI_SYNC_CACHE16_OPC 0x91
+
+#define SG_NVME_NVM_FLUSH 0x0           /* NVM command set opcodes */
+#define SG_NVME_NVM_WRITE 0x1
+#define SG_NVME_NVM_READ 0x2
+
+/* struct nvme_uring_cmd (kernel 5.19) has the same 72 byte layout as
+ * struct sg_nvme_passthru_cmd with the last field (result) reserved */
+#ifndef NVME_URING_CMD_IO
+#define NVME_URING_CMD_IO       _IOWR('N', 0x80, struct sg_nvme_passthru_cmd)
+#endif
+#ifndef NVME_URING_CMD_ADMIN
+#define NVME_URING_CMD_ADMIN    _IOWR('N', 0x82, struct sg_nvme_passthru_cmd)
+#endif
+
+#define SG_URING_SQE_CMD_OFF 48         /* start of sqe->cmd[] */
+
+enum sg_uring_mcmd_t {
+    SG_URING_MC_NONE = 0,
+    SG_URING_MC_READ,
+    SG_URING_MC_WRITE,
+    SG_URING_MC_SYNC,
+};
+
+/* A SCSI media access command decoded by decode_media_cdb() */
+struct sg_uring_mcmd {
+    enum sg_uring_mcmd_t op;
+    bool fua;
+    uint64_t lba;
+    uint32_t num_lbs;
+};
+
+struct sg_uring {
+    bool nvme_cmd;      /* true: IORING_OP_URING_CMD, SQE128 and CQE32 */
+    bool iopoll;        /* ring set up with IORING_SETUP_IOPOLL */
+    int dev_fd;
+    int ring_fd;
+    uint32_t lb_size;   /* logical block size, 0 if unknown */
+    uint64_t num_lbs;   /* capacity in logical blocks (not NVMe) */
+    uint32_t nsid;      /* NVMe namespace id, 0 if none */
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t sqe_sz;    /* 64 or 128 bytes */
+    uint32_t cqe_sz;    /* 16 or 32 bytes */
+    uint32_t inflight;  /* queued in SQ or submitted, not yet reaped */
+    uint32_t to_submit; /* queued in SQ, not yet given to kernel */
+    int num_bufs;       /* number of registered buffers */
+    uint32_t * sq_head;
+    uint32_t * sq_tail;
+    uint32_t * sq_mask;
+    uint32_t * sq_array;
+    uint32_t * cq_head;
+    uint32_t * cq_tail;
+    uint32_t * cq_mask;
+    uint8_t * sqes;
+    uint8_t * cqes;
+    void * sq_ring_p;
+    void * cq_ring_p;
+    size_t sq_ring_sz;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+    struct iovec * buf_arr;     /* copy of registered buffers */
+};
+
+static struct sg_uring * sg_uring_arr[SG_URING_MAX_FD];
+
+static int
+sys_io_uring_setup(uint32_t entries, struct io_uring_params * pp)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, pp);
+}
+
+static int
+sys_io_uring_enter(int ring_fd, uint32_t to_submit, uint32_t min_complete,
+                   uint32_t flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                        min_complete, flags, NULL, 0);
+}
+
+static int
+sys_io_uring_register(int ring_fd, uint32_t opcode, const void * argp,
+                      uint32_t nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, argp,
+                        nr_args);
+}
+
+static void
+uring_free(struct sg_uring * urp)
+{
+    if (NULL == urp)
+        return;
+    if (urp->sqes && (MAP_FAILED != (void *)urp->sqes))
+        munmap(urp->sqes, urp->sqes_sz);
+    if (urp->cq_ring_p && (MAP_FAILED != urp->cq_ring_p) &&
+        (urp->cq_ring_p != urp->sq_ring_p))
+        munmap(urp->cq_ring_p, urp->cq_ring_sz);
+    if (urp->sq_ring_p && (MAP_FAILED != urp->sq_ring_p))
+        munmap(urp->sq_ring_p, urp->sq_ring_sz);
+    if (urp->ring_fd >= 0)
+        close(urp->ring_fd);
+    if (urp->buf_arr)
+        free(urp->buf_arr);
+    free(urp);
+}
+
+#ifdef SG_URING_NVME
+/* Fetches the logical block size of the namespace nsid on the NVMe
+ * controller reached via dev_fd with an Identify namespace command.
+ * Returns 0 if it can not be determined. */
+static uint32_t
+nvme_ns_lb_size(int dev_fd, uint32_t nsid, int vb)
+{
+    int res;
+    uint8_t flbas, lbads;
+    uint32_t lb_size = 0;
+    uint8_t * free_bp = NULL;
+    uint8_t * bp;
+    const uint32_t pg_sz = 4096;        /* Identify data length */
+    struct sg_nvme_passthru_cmd cmd;
+
+    bp = sg_memalign(pg_sz, 0, &free_bp, false);
+    if (NULL == bp)
+        return 0;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = 0x6;           /* Identify */
+    cmd.nsid = nsid;
+    cmd.cdw10 = 0x0;            /* CNS=0x0 Identify namespace */
+    cmd.addr = (uint64_t)(sg_uintptr_t)bp;
+    cmd.data_len = pg_sz;
+    cmd.timeout_ms = DEF_TIMEOUT;
+    res = ioctl(dev_fd, NVME_IOCTL_ADMIN_CMD, &cmd);
+    if (0 == res) {
+        flbas = 0xf & bp[26];
+        lbads = bp[128 + (4 * flbas) + 2];
+        if ((lbads >= 9) && (lbads < 32))
+            lb_size = 1U << lbads;
+    } else if (vb)
+        pr2ws("%s: Identify namespace (nsid=%u) failed, res=%d\n", __func__,
+              nsid, res);
+    free(free_bp);
+    return lb_size;
+}
+#endif
+
+/* Sets up an io_uring instance for dev_fd. Returns NULL and places a
+ * negated errno or positive SCSI_PT_DO_* value in *errp on failure. */
+/* Sets the capacity (in logical blocks) of the block device or regular
+ * file that urp refers to. A regular file's capacity is its current
+ * size. */
+static void
+uring_set_capacity(struct sg_uring * urp)
+{
+    uint64_t sz = 0;
+    struct stat a_stat;
+
+    if (0 == fstat(urp->dev_fd, &a_stat)) {
+        if (S_ISBLK(a_stat.st_mode)) {
+            if (ioctl(urp->dev_fd, BLKGETSIZE64, &sz) < 0)
+                sz = 0;
+        } else if (S_ISREG(a_stat.st_mode))
+            sz = (uint64_t)a_stat.st_size;
+    }
+    urp->num_lbs = (urp->lb_size > 0) ? (sz / urp->lb_size) : 0;
+}
+
+static struct sg_uring *
+uring_create(int dev_fd, bool is_nvme, uint32_t nsid, bool iopoll, int vb,
+             int * errp)
+{
+    int n, err;
+    uint32_t entries = SG_URING_DEF_ENTRIES;
+    const char * cp;
+    struct sg_uring * urp;
+    struct stat a_stat;
+    struct io_uring_params params;
+
+    if (fstat(dev_fd, &a_stat) < 0) {
+        *errp = -errno;
+        return NULL;
+    }
+    urp = (struct sg_uring *)calloc(1, sizeof(*urp));
+    if (NULL == urp) {
+        *errp = -ENOMEM;
+        return NULL;
+    }
+    urp->dev_fd = dev_fd;
+    urp->ring_fd = -1;
+    urp->nsid = nsid;
+    if (is_nvme && S_ISCHR(a_stat.st_mode)) {
+#ifdef SG_URING_NVME
+        urp->nvme_cmd = true;
+        if (nsid > 0)
+            urp->lb_size = nvme_ns_lb_size(dev_fd, nsid, vb);
+#else
+        if (vb)
+            pr2ws("%s: NVMe uring_cmd not supported by this build\n",
+                  __func__);
+        *errp = SCSI_PT_DO_NOT_SUPPORTED;
+        goto err_out;
+#endif
+    } else if (S_ISBLK(a_stat.st_mode)) {
+        if ((ioctl(dev_fd, BLKSSZGET, &n) < 0) || (n <= 0))
+            n = 512;
+        urp->lb_size = (uint32_t)n;
+        if (iopoll) {
+            n = fcntl(dev_fd, F_GETFL);
+            iopoll = ((n >= 0) && (O_DIRECT & n));
+        }
+    } else if (S_ISREG(a_stat.st_mode)) {
+        urp->lb_size = 512;
+        iopoll = false;
+    }
+    else {
+        if (vb)
+            pr2ws("%s: file type not supported by io_uring backend\n",
+                  __func__);
+        *errp = SCSI_PT_DO_NOT_SUPPORTED;
+        goto err_out;
+    }
+    if (! urp->nvme_cmd)
+        uring_set_capacity(urp);
+    if ((cp = getenv(SG_URING_EV_QD))) {
+        n = sg_get_num(cp);
+        if ((n > 0) && (n <= SG_URING_MAX_ENTRIES)) {
+            for (entries = 1; (int)entries < n; entries <<= 1)
+                ;
+        } else if (vb)
+            pr2ws("%s: ignoring %s=%s\n", __func__, SG_URING_EV_QD, cp);
+    }
+    memset(&params, 0, sizeof(params));
+#ifdef SG_URING_NVME
+    if (urp->nvme_cmd)
+        params.flags = IORING_SETUP_SQE128 | IORING_SETUP_CQE32;
+#endif
+    if (iopoll) {
+        params.flags |= IORING_SETUP_IOPOLL;
+        urp->ring_fd = sys_io_uring_setup(entries, &params);
+        if (urp->ring_fd < 0) {
+            if (vb > 1)
+                pr2ws("%s: io_uring_setup(IOPOLL) failed: %s, try without\n",
+                      __func__, safe_strerror(errno));
+            params.flags &= ~IORING_SETUP_IOPOLL;
+            memset(&params.sq_off, 0, sizeof(params.sq_off));
+            memset(&params.cq_off, 0, sizeof(params.cq_off));
+        } else
+            urp->iopoll = true;
+    }
+    if (! urp->iopoll)
+        urp->ring_fd = sys_io_uring_setup(entries, &params);
+    if (urp->ring_fd < 0) {
+        err = errno;
+        if (vb)
+            pr2ws("%s: io_uring_setup() failed: %s\n", __func__,
+                  safe_strerror(err));
+        *errp = (ENOSYS == err) ? SCSI_PT_DO_NOT_SUPPORTED : -err;
+        goto err_out;
+    }
+    urp->sq_entries = params.sq_entries;
+    urp->cq_entries = params.cq_entries;
+    urp->sqe_sz = urp->nvme_cmd ? 128 : sizeof(struct io_uring_sqe);
+    urp->cqe_sz = urp->nvme_cmd ? 32 : sizeof(struct io_uring_cqe);
+    urp->sq_ring_sz = params.sq_off.array +
+                      (params.sq_entries * sizeof(uint32_t));
+    urp->cq_ring_sz = params.cq_off.cqes + (params.cq_entries * urp->cqe_sz);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (urp->cq_ring_sz > urp->sq_ring_sz)
+            urp->sq_ring_sz = urp->cq_ring_sz;
+        urp->cq_ring_sz = urp->sq_ring_sz;
+    }
+    urp->sq_ring_p = mmap(NULL, urp->sq_ring_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                          IORING_OFF_SQ_RING);
+    if (MAP_FAILED == urp->sq_ring_p)
+        goto mmap_err;
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        urp->cq_ring_p = urp->sq_ring_p;
+    else {
+        urp->cq_ring_p = mmap(NULL, urp->cq_ring_sz, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                              IORING_OFF_CQ_RING);
+        if (MAP_FAILED == urp->cq_ring_p)
+            goto mmap_err;
+    }
+    urp->sqes_sz = params.sq_entries * urp->sqe_sz;
+    urp->sqes = (uint8_t *)mmap(NULL, urp->sqes_sz, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                                IORING_OFF_SQES);
+    if (MAP_FAILED == (void *)urp->sqes)
+        goto mmap_err;
+    urp->sq_head = (uint32_t *)((uint8_t *)urp->sq_ring_p +
+                                params.sq_off.head);
+    urp->sq_tail = (uint32_t *)((uint8_t *)urp->sq_ring_p +
+                                params.sq_off.tail);
+    urp->sq_mask = (uint32_t *)((uint8_t *)urp->sq_ring_p +
+                                params.sq_off.ring_mask);
+    urp->sq_array = (uint32_t *)((uint8_t *)urp->sq_ring_p +
+                                 params.sq_off.array);
+    urp->cq_head = (uint32_t *)((uint8_t *)urp->cq_ring_p +
+                                params.cq_off.head);
+    urp->cq_tail = (uint32_t *)((uint8_t *)urp->cq_ring_p +
+                                params.cq_off.tail);
+    urp->cq_mask = (uint32_t *)((uint8_t *)urp->cq_ring_p +
+                                params.cq_off.ring_mask);
+    urp->cqes = (uint8_t *)urp->cq_ring_p + params.cq_off.cqes;
+    if (vb > 2)
+        pr2ws("%s: dev_fd=%d ring_fd=%d sq_entries=%u cq_entries=%u%s%s\n",
+              __func__, dev_fd, urp->ring_fd, urp->sq_entries,
+              urp->cq_entries, urp->nvme_cmd ? " [NVMe uring_cmd]" : "",
+              urp->iopoll ? " [IOPOLL]" : "");
+    return urp;
+
+mmap_err:
+    err = errno;
+    if (vb)
+        pr2ws("%s: mmap() of ring failed: %s\n", __func__,
+              safe_strerror(err));
+    *errp = -err;
+err_out:
+    uring_free(urp);
+    return NULL;
+}
+
+static struct sg_uring *
+uring_find(int dev_fd)
+{
+    if ((dev_fd < 0) || (dev_fd >= SG_URING_MAX_FD))
+        return NULL;
+    return __atomic_load_n(sg_uring_arr + dev_fd, __ATOMIC_ACQUIRE);
+}
+
+/* Returns the ring associated with dev_fd, creating it if necessary (with
+ * IORING_SETUP_IOPOLL if iopoll is true and the device allows). Returns
+ * NULL on failure with the reason in *errp. */
+static struct sg_uring *
+uring_get(int dev_fd, bool is_nvme, uint32_t nsid, bool iopoll, int vb,
+          int * errp)
+{
+    struct sg_uring * urp;
+    struct sg_uring * expect = NULL;
+
+    if ((dev_fd < 0) || (dev_fd >= SG_URING_MAX_FD)) {
+        if (vb)
+            pr2ws("%s: file descriptor %d too large for io_uring backend\n",
+                  __func__, dev_fd);
+        *errp = SCSI_PT_DO_NOT_SUPPORTED;
+        return NULL;
+    }
+    urp = uring_find(dev_fd);
+    if (urp)
+        return urp;
+    urp = uring_create(dev_fd, is_nvme, nsid, iopoll, vb, errp);
+    if (NULL == urp)
+        return NULL;
+    if (! __atomic_compare_exchange_n(sg_uring_arr + dev_fd, &expect, urp,
+                                      false, __ATOMIC_ACQ_REL,
+                                      __ATOMIC_ACQUIRE)) {
+        uring_free(urp);        /* lost race, use the other one */
+        urp = expect;
+    }
+    return urp;
+}
+
+/* Passes all queued SQEs to the kernel, optionally waiting for min_complete
+ * completions. Completions on an IOPOLL ring are only found when the
+ * kernel is asked to get events, so that is always done for them. Returns
+ * 0 or a negated errno. */
+static int
+uring_enter(struct sg_uring * urp, uint32_t min_complete, int vb)
+{
+    int res, err;
+
+    do {
+        res = sys_io_uring_enter(urp->ring_fd, urp->to_submit, min_complete,
+                                 (min_complete || urp->iopoll) ?
+                                        IORING_ENTER_GETEVENTS : 0);
+        if (res >= 0)
+            break;
+        err = errno;
+        if (EINTR != err) {
+            if (vb > 1)
+                pr2ws("%s: io_uring_enter() failed: %s\n", __func__,
+                      safe_strerror(err));
+            return -err;
+        }
+    } while (true);
+    if ((uint32_t)res >= urp->to_submit)
+        urp->to_submit = 0;
+    else
+        urp->to_submit -= (uint32_t)res;
+    return 0;
+}
+
+/* Returns the next free SQE (zeroed), passing queued SQEs to the kernel
+ * when the SQ is full. Returns NULL if no SQE is available. */
+static uint8_t *
+uring_get_sqe(struct sg_uring * urp, uint32_t * idxp, int vb)
+{
+    uint32_t head, tail, idx;
+    uint8_t * sqep;
+
+    tail = *urp->sq_tail;
+    head = __atomic_load_n(urp->sq_head, __ATOMIC_ACQUIRE);
+    if ((tail - head) >= urp->sq_entries) {
+        if (uring_enter(urp, 0, vb))
+            return NULL;
+        head = __atomic_load_n(urp->sq_head, __ATOMIC_ACQUIRE);
+        if ((tail - head) >= urp->sq_entries)
+            return NULL;
+    }
+    idx = tail & *urp->sq_mask;
+    sqep = urp->sqes + (idx * urp->sqe_sz);
+    memset(sqep, 0, urp->sqe_sz);
+    *idxp = idx;
+    return sqep;
+}
+
+static void
+uring_queue_sqe(struct sg_uring * urp, uint32_t idx)
+{
+    uint32_t tail = *urp->sq_tail;
+
+    urp->sq_array[tail & *urp->sq_mask] = idx;
+    __atomic_store_n(urp->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++urp->to_submit;
+    ++urp->inflight;
+}
+
+/* Returns the index of the registered buffer that contains [bp, bp+len),
+ * or -1 if there is none. */
+static int
+uring_find_buf(const struct sg_uring * urp, const uint8_t * bp, uint32_t len)
+{
+    int k;
+    const uint8_t * b_p;
+
+    for (k = 0; k < urp->num_bufs; ++k) {
+        b_p = (const uint8_t *)urp->buf_arr[k].iov_base;
+        if ((bp >= b_p) && ((bp + len) <= (b_p + urp->buf_arr[k].iov_len)))
+            return k;
+    }
+    return -1;
+}
+
+/* Decodes READ(10,16), WRITE(10,16) and SYNCHRONIZE CACHE(10,16). Returns
+ * false if cdbp is anything else. */
+static bool
+decode_media_cdb(const uint8_t * cdbp, int cdb_len,
+                 struct sg_uring_mcmd * mcp)
+{
+    memset(mcp, 0, sizeof(*mcp));
+    switch (cdbp[0]) {
+    case SCSI_READ10_OPC:
+    case SCSI_WRITE10_OPC:
+    case SCSI_SYNC_CACHE10_OPC:
+        if (cdb_len < 10)
+            return false;
+        mcp->lba = sg_get_unaligned_be32(cdbp + 2);
+        mcp->num_lbs = sg_get_unaligned_be16(cdbp + 7);
+        break;
+    case SCSI_READ16_OPC:
+    case SCSI_WRITE16_OPC:
+    case SCSI_SYNC_CACHE16_OPC:
+        if (cdb_len < 16)
+            return false;
+        mcp->lba = sg_get_unaligned_be64(cdbp + 2);
+        mcp->num_lbs = sg_get_unaligned_be32(cdbp + 10);
+        break;
+    default:
+        return false;
+    }
+    switch (cdbp[0]) {
+    case SCSI_READ10_OPC:
+    case SCSI_READ16_OPC:
+        mcp->op = SG_URING_MC_READ;
+        mcp->fua = !!(0x8 & cdbp[1]);
+        break;
+    case SCSI_WRITE10_OPC:
+    case SCSI_WRITE16_OPC:
+        mcp->op = SG_URING_MC_WRITE;
+        mcp->fua = !!(0x8 & cdbp[1]);
+        break;
+    default:
+        mcp->op = SG_URING_MC_SYNC;
+        break;
+    }
+    return true;
+}
+
+/* Checks the data-in or data-out buffer is large enough for the media
+ * command. Returns the data buffer (NULL if none needed) and its length in
+ * *lenp, or sets *errp. */
+static uint8_t *
+media_buf(const struct sg_pt_linux_scsi * ptp, const struct sg_uring * urp,
+          const struct sg_uring_mcmd * mcp, uint32_t * lenp, int * errp,
+          int vb)
+{
+    uint64_t len;
+    uint32_t xfer_len;
+    uint8_t * bp;
+
+    *errp = 0;
+    *lenp = 0;
+    if (SG_URING_MC_SYNC == mcp->op)
+        return NULL;
+    if (0 == urp->lb_size) {
+        if (vb)
+            pr2ws("%s: logical block size unknown\n", __func__);
+        *errp = SCSI_PT_DO_NOT_SUPPORTED;
+        return NULL;
+    }
+    if (SG_URING_MC_READ == mcp->op) {
+        bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+        xfer_len = ptp->io_hdr.din_xfer_len;
+    } else {
+        bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+        xfer_len = ptp->io_hdr.dout_xfer_len;
+    }
+    len = (uint64_t)mcp->num_lbs * urp->lb_size;
+    if ((len > xfer_len) || ((len > 0) && (NULL == bp))) {
+        if (vb)
+            pr2ws("%s: data buffer (%u bytes) smaller than %" PRIu64
+                  " bytes needed\n", __func__, xfer_len, len);
+        *errp = SCSI_PT_DO_BAD_PARAMS;
+        return NULL;
+    }
+    *lenp = (uint32_t)len;
+    return bp;
+}
+
+/* Builds fixed or descriptor format sense data depending on the setting
+ * for that device. */
+static void
+mk_sense(struct sg_pt_linux_scsi * ptp, int sk, int asc, int ascq)
+{
+    bool dsense = ptp->dev_stat.scsi_dsense;
+    uint32_t n;
+    uint8_t sb[20];
+
+    memset(sb, 0, sizeof(sb));
+    ptp->io_hdr.device_status = SAM_STAT_CHECK_CONDITION;
+    sg_build_sense_buffer(dsense, sb, sk, asc, ascq);
+    n = dsense ? 8 : 18;
+    if (n > ptp->io_hdr.max_response_len)
+        n = ptp->io_hdr.max_response_len;
+    if ((n > 0) && ptp->io_hdr.response)
+        memcpy((uint8_t *)(sg_uintptr_t)ptp->io_hdr.response, sb, n);
+    ptp->io_hdr.response_len = n;
+}
+
+/* Fills sqep for a block device or regular file. A READ or WRITE beyond
+ * the end of the medium is not passed to the kernel: the command gets
+ * ILLEGAL REQUEST, LBA OUT OF RANGE sense and sqep is set to a NOP so that
+ * it completes in order with the others. */
+static int
+fill_rw_sqe(struct sg_pt_linux_scsi * ptp, struct sg_uring * urp,
+            const uint8_t * cdbp, int cdb_len, struct io_uring_sqe * sqep,
+            int vb)
+{
+    int err, buf_ind;
+    uint32_t len;
+    uint8_t * bp;
+    struct sg_uring_mcmd mc;
+
+    if (! decode_media_cdb(cdbp, cdb_len, &mc)) {
+        if (vb)
+            pr2ws("%s: only READ, WRITE and SYNCHRONIZE CACHE supported "
+                  "on this file type\n", __func__);
+        return SCSI_PT_DO_NOT_SUPPORTED;
+    }
+    bp = media_buf(ptp, urp, &mc, &len, &err, vb);
+    if (err)
+        return err;
+    if ((SG_URING_MC_SYNC != mc.op) &&
+        ((mc.lba > urp->num_lbs) || (mc.num_lbs > urp->num_lbs - mc.lba))) {
+        uring_set_capacity(urp);        /* it may have grown, check again */
+        if ((mc.lba > urp->num_lbs) ||
+            (mc.num_lbs > urp->num_lbs - mc.lba)) {
+            if (vb > 1)
+                pr2ws("%s: lba=%" PRIu64 " num=%u beyond capacity of %"
+                      PRIu64 " blocks\n", __func__, mc.lba, mc.num_lbs,
+                      urp->num_lbs);
+            if (urp->iopoll) {
+                if (vb)
+                    pr2ws("%s: can not complete out of range command on "
+                          "an IOPOLL ring\n", __func__);
+                return SCSI_PT_DO_BAD_PARAMS;
+            }
+            mk_sense(ptp, SPC_SK_ILLEGAL_REQUEST, 0x21, 0);
+            sqep->fd = urp->dev_fd;
+            sqep->opcode = IORING_OP_NOP;
+            return 0;
+        }
+    }
+    if (urp->iopoll && ((SG_URING_MC_SYNC == mc.op) || (0 == len))) {
+        if (vb)
+            pr2ws("%s: only reads and writes on an IOPOLL ring\n", __func__);
+        return SCSI_PT_DO_NOT_SUPPORTED;
+    }
+    sqep->fd = urp->dev_fd;
+    if (SG_URING_MC_SYNC == mc.op) {
+        sqep->opcode = IORING_OP_FSYNC;
+        sqep->fsync_flags = IORING_FSYNC_DATASYNC;
+        return 0;
+    }
+    if (0 == len) {
+        sqep->opcode = IORING_OP_NOP;
+        return 0;
+    }
+    buf_ind = uring_find_buf(urp, bp, len);
+    if (SG_URING_MC_READ == mc.op)
+        sqep->opcode = (buf_ind < 0) ? IORING_OP_READ : IORING_OP_READ_FIXED;
+    else
+        sqep->opcode = (buf_ind < 0) ? IORING_OP_WRITE :
+                                       IORING_OP_WRITE_FIXED;
+    if (buf_ind >= 0)
+        sqep->buf_index = (uint16_t)buf_ind;
+    sqep->off = mc.lba * urp->lb_size;
+    sqep->addr = (uint64_t)(sg_uintptr_t)bp;
+    sqep->len = len;
+#ifdef RWF_DSYNC
+    if (mc.fua && (SG_URING_MC_WRITE == mc.op))
+        sqep->rw_flags = RWF_DSYNC;
+#endif
+    return 0;
+}
+
+#ifdef SG_URING_NVME
+/* Fills sqep for a NVMe char or generic device. */
+static int
+fill_nvme_sqe(struct sg_pt_linux_scsi * ptp, struct sg_uring * urp,
+              const uint8_t * cdbp, int cdb_len, int time_secs,
+              struct io_uring_sqe * sqep, int vb)
+{
+    bool scsi_cdb;
+    int err, buf_ind;
+    uint32_t len;
+    uint8_t * bp;
+    struct sg_uring_mcmd mc;
+    struct sg_nvme_passthru_cmd cmd;
+
+    memset(&cmd, 0, sizeof(cmd));
+    scsi_cdb = sg_is_scsi_cdb(cdbp, cdb_len);
+    ptp->nvme_direct = ! scsi_cdb;
+    if (scsi_cdb) {
+        if (! decode_media_cdb(cdbp, cdb_len, &mc)) {
+            if (vb)
+                pr2ws("%s: only READ, WRITE and SYNCHRONIZE CACHE are "
+                      "translated\n", __func__);
+            return SCSI_PT_DO_NOT_SUPPORTED;
+        }
+        if (0 == ptp->nvme_nsid) {
+            if (vb)
+                pr2ws("%s: media access needs a namespace\n", __func__);
+            return SCSI_PT_DO_NOT_SUPPORTED;
+        }
+        bp = media_buf(ptp, urp, &mc, &len, &err, vb);
+        if (err)
+            return err;
+        if ((SG_URING_MC_SYNC != mc.op) && (0 == len)) {
+            if (urp->iopoll)
+                return SCSI_PT_DO_NOT_SUPPORTED;
+            sqep->opcode = IORING_OP_NOP;
+            return 0;
+        }
+        cmd.nsid = ptp->nvme_nsid;
+        if (SG_URING_MC_SYNC == mc.op)
+            cmd.opcode = SG_NVME_NVM_FLUSH;
+        else {
+            cmd.opcode = (SG_URING_MC_READ == mc.op) ? SG_NVME_NVM_READ :
+                                                       SG_NVME_NVM_WRITE;
+            cmd.addr = (uint64_t)(sg_uintptr_t)bp;
+            cmd.data_len = len;
+            cmd.cdw10 = (uint32_t)mc.lba;
+            cmd.cdw11 = (uint32_t)(mc.lba >> 32);
+            cmd.cdw12 = (mc.num_lbs - 1) & 0xffff;      /* 0's based */
+            if (mc.fua)
+                cmd.cdw12 |= 0x40000000;
+        }
+        sqep->cmd_op = NVME_URING_CMD_IO;
+    } else {
+        if (urp->iopoll) {
+            if (vb)
+                pr2ws("%s: no Admin commands on an IOPOLL ring\n",
+                      __func__);
+            return SCSI_PT_DO_NOT_SUPPORTED;
+        }
+        if (cdb_len < (int)sizeof(cmd)) {
+            if (vb)
+                pr2ws("%s: NVMe command length %d too short\n", __func__,
+                      cdb_len);
+            return SCSI_PT_DO_BAD_PARAMS;
+        }
+        memcpy(&cmd, cdbp, 64);        /* result field left zeroed */
+        if (ptp->io_hdr.din_xfer_len > 0) {
+            bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+            len = ptp->io_hdr.din_xfer_len;
+        } else {
+            bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+            len = ptp->io_hdr.dout_xfer_len;
+        }
+        cmd.addr = (uint64_t)(sg_uintptr_t)bp;
+        cmd.data_len = len;
+        sqep->cmd_op = NVME_URING_CMD_ADMIN;
+    }
+    cmd.timeout_ms = (time_secs > 0) ? (1000 * time_secs) : DEF_TIMEOUT;
+    sqep->opcode = IORING_OP_URING_CMD;
+    sqep->fd = urp->dev_fd;
+#ifdef IORING_URING_CMD_FIXED
+    if (cmd.data_len > 0) {
+        buf_ind = uring_find_buf(urp, (const uint8_t *)(sg_uintptr_t)cmd.addr,
+                                 cmd.data_len);
+        if (buf_ind >= 0) {
+            sqep->uring_cmd_flags = IORING_URING_CMD_FIXED;
+            sqep->buf_index = (uint16_t)buf_ind;
+        }
+    }
+#else
+    buf_ind = 0;
+    if (buf_ind) { ; }          /* suppress warning */
+#endif
+    memcpy((uint8_t *)sqep + SG_URING_SQE_CMD_OFF, &cmd, sizeof(cmd));
+    return 0;
+}
+#endif          /* SG_URING_NVME */
+
+/* Queues the command held in vp on the ring belonging to its file
+ * descriptor (which is set up if needed). The command is passed to the
+ * kernel by a later sg_uring_receive() or sg_uring_poll(). Returns 0 if
+ * queued, -EAGAIN if the ring is full, another negated errno, or a
+ * positive SCSI_PT_DO_* value. */
+int
+sg_uring_submit(struct sg_pt_base * vp, int time_secs, int vb)
+{
+    int res, cdb_len;
+    uint32_t idx;
+    const uint8_t * cdbp;
+    uint8_t * sqep;
+    struct sg_uring * urp;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    urp = uring_get(ptp->dev_fd, ptp->is_nvme, ptp->nvme_nsid, ptp->polled,
+                    vb, &res);
+    if (NULL == urp)
+        return res;
+    if (urp->inflight >= urp->cq_entries) {
+        if (vb > 2)
+            pr2ws("%s: ring full (%u inflight)\n", __func__, urp->inflight);
+        return -EAGAIN;
+    }
+    cdbp = (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
+    cdb_len = (int)ptp->io_hdr.request_len;
+    sqep = uring_get_sqe(urp, &idx, vb);
+    if (NULL == sqep)
+        return -EAGAIN;
+    ptp->os_err = 0;
+    ptp->io_hdr.device_status = 0;
+    ptp->io_hdr.response_len = 0;
+    ptp->io_hdr.din_resid = 0;
+    ptp->io_hdr.dout_resid = 0;
+#ifdef SG_URING_NVME
+    if (urp->nvme_cmd)
+        res = fill_nvme_sqe(ptp, urp, cdbp, cdb_len, time_secs,
+                            (struct io_uring_sqe *)sqep, vb);
+    else
+#endif
+        res = fill_rw_sqe(ptp, urp, cdbp, cdb_len,
+                          (struct io_uring_sqe *)sqep, vb);
+    if (res)
+        return res;     /* SQE is not queued so can be reused */
+    ((struct io_uring_sqe *)sqep)->user_data = (uint64_t)(sg_uintptr_t)vp;
+    uring_queue_sqe(urp, idx);
+    if (vb > 3)
+        pr2ws("%s: queued, to_submit=%u inflight=%u\n", __func__,
+              urp->to_submit, urp->inflight);
+    if (time_secs) { ; }        /* only used by NVMe */
+    return 0;
+}
+
+/* Places the result of a completion in the pt object that owns it */
+static void
+uring_complete(struct sg_uring * urp, struct sg_pt_base * vp, int32_t res,
+               uint32_t result, int vb)
+{
+    bool is_read;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    is_read = (ptp->io_hdr.din_xfer_len > 0);
+    if (res < 0) {
+        if ((-EIO == res) && (! urp->nvme_cmd))
+            mk_sense(ptp, SPC_SK_MEDIUM_ERROR, is_read ? 0x11 : 0xc, 0);
+        else
+            ptp->os_err = -res;
+        if (vb > 1)
+            pr2ws("%s: completion error: %s\n", __func__,
+                  safe_strerror(-res));
+        return;
+    }
+#ifdef SG_URING_NVME
+    if (urp->nvme_cmd) {
+        sg_nvme_pt_completion(ptp, res, result, true, vb);
+        return;
+    }
+#else
+    if (result) { ; }           /* suppress warning */
+#endif
+    if (is_read) {
+        if ((uint32_t)res < ptp->io_hdr.din_xfer_len)
+            ptp->io_hdr.din_resid = ptp->io_hdr.din_xfer_len - res;
+    } else if ((uint32_t)res < ptp->io_hdr.dout_xfer_len)
+        ptp->io_hdr.dout_resid = ptp->io_hdr.dout_xfer_len - res;
+}
+
+/* Reaps up to max_num completions from the CQ. Returns number reaped. */
+static int
+uring_reap(struct sg_uring * urp, struct sg_pt_base ** vpp, int max_num,
+           int vb)
+{
+    int k;
+    uint32_t head, tail, result;
+    const uint8_t * cqep;
+    const struct io_uring_cqe * cp;
+    struct sg_pt_base * vp;
+
+    head = *urp->cq_head;
+    tail = __atomic_load_n(urp->cq_tail, __ATOMIC_ACQUIRE);
+    for (k = 0; (head != tail) && (k < max_num); ++head) {
+        cqep = urp->cqes + ((head & *urp->cq_mask) * urp->cqe_sz);
+        cp = (const struct io_uring_cqe *)cqep;
+        vp = (struct sg_pt_base *)(sg_uintptr_t)cp->user_data;
+        /* with CQE32 the first extra 64 bits hold the NVMe CDW0 */
+        result = urp->nvme_cmd ? sg_get_unaligned_le32(cqep + 16) : 0;
+        if (urp->inflight > 0)
+            --urp->inflight;
+        if (NULL == vp)
+            continue;
+        uring_complete(urp, vp, cp->res, result, vb);
+        vpp[k++] = vp;
+    }
+    __atomic_store_n(urp->cq_head, head, __ATOMIC_RELEASE);
+    return k;
+}
+
+/* Passes queued commands to the kernel then reaps up to max_num
+ * completions. If wait_ms is zero does not wait, if negative waits until at
+ * least one completion (if any are outstanding), otherwise waits up to
+ * wait_ms milliseconds. Returns number reaped, -ENOTTY if fd has no ring,
+ * or another negated errno. */
+int
+sg_uring_receive(int fd, struct sg_pt_base ** vpp, int max_num, int wait_ms,
+                 int vb)
+{
+    int n, res;
+    uint64_t end_ns;
+    struct sg_uring * urp = uring_find(fd);
+    struct pollfd a_pollfd;
+
+    if (NULL == urp)
+        return -ENOTTY;
+    /* the CQ is in shared memory so, unless something needs to be passed
+     * to the kernel, checking it doesn't need a system call */
+    if ((urp->to_submit > 0) || urp->iopoll ||
+        ((wait_ms < 0) && (urp->inflight > 0))) {
+        res = uring_enter(urp, ((wait_ms < 0) && (urp->inflight > 0)) ?
+                                                                1 : 0, vb);
+        if (res)
+            return res;
+    }
+    n = uring_reap(urp, vpp, max_num, vb);
+    if ((0 == n) && (wait_ms > 0) && (urp->inflight > 0) && urp->iopoll) {
+        /* nothing to wake poll() on an IOPOLL ring, so keep reaping */
+        end_ns = sg_pt_trace_now_ns() + (1000000ULL * wait_ms);
+        do {
+            res = uring_enter(urp, 0, vb);
+            if (res)
+                return res;
+            n = uring_reap(urp, vpp, max_num, vb);
+        } while ((0 == n) && (sg_pt_trace_now_ns() < end_ns));
+    } else if ((0 == n) && (wait_ms > 0) && (urp->inflight > 0)) {
+        a_pollfd.fd = urp->ring_fd;
+        a_pollfd.events = POLLIN;
+        a_pollfd.revents = 0;
+        res = poll(&a_pollfd, 1, wait_ms);
+        if (res < 0)
+            return -errno;
+        if (res > 0)
+            n = uring_reap(urp, vpp, max_num, vb);
+    }
+    return n;
+}
+
+/* Passes queued commands to the kernel. Returns the number of completions
+ * waiting, -ENOTTY if fd has no ring, or another negated errno. */
+int
+sg_uring_poll(int fd, int vb)
+{
+    int res;
+    struct sg_uring * urp = uring_find(fd);
+
+    if (NULL == urp)
+        return -ENOTTY;
+    if (urp->to_submit > 0) {
+        res = uring_enter(urp, 0, vb);
+        if (res)
+            return res;
+    }
+    return (int)(__atomic_load_n(urp->cq_tail, __ATOMIC_ACQUIRE) -
+                 *urp->cq_head);
+}
+
+/* Registers num data buffers with the ring belonging to fd (set up if
+ * needed), replacing any buffers registered earlier. If num is 0, removes
+ * the registered buffers. Returns 0 on success, a negated errno or a
+ * positive SCSI_PT_DO_* value. */
+int
+sg_uring_register_bufs(int fd, bool is_nvme, uint32_t nsid,
+                       uint8_t * const * bufpp, const uint32_t * buf_lens,
+                       int num, int vb)
+{
+    int k, res, err;
+    struct iovec * iovp = NULL;
+    struct sg_uring * urp;
+
+    urp = uring_get(fd, is_nvme, nsid, false, vb, &res);
+    if (NULL == urp)
+        return res;
+    if (urp->inflight > 0) {
+        if (vb)
+            pr2ws("%s: can't change buffers with commands outstanding\n",
+                  __func__);
+        return -EBUSY;
+    }
+    if (urp->num_bufs > 0) {
+        sys_io_uring_register(urp->ring_fd, IORING_UNREGISTER_BUFFERS,
+                              NULL, 0);
+        free(urp->buf_arr);
+        urp->buf_arr = NULL;
+        urp->num_bufs = 0;
+    }
+    if (num <= 0)
+        return 0;
+    iovp = (struct iovec *)calloc(num, sizeof(struct iovec));
+    if (NULL == iovp)
+        return -ENOMEM;
+    for (k = 0; k < num; ++k) {
+        iovp[k].iov_base = bufpp[k];
+        iovp[k].iov_len = buf_lens[k];
+    }
+    if (sys_io_uring_register(urp->ring_fd, IORING_REGISTER_BUFFERS, iovp,
+                              num) < 0) {
+        err = errno;
+        if (vb)
+            pr2ws("%s: io_uring_register(BUFFERS) failed: %s\n", __func__,
+                  safe_strerror(err));
+        free(iovp);
+        return -err;
+    }
+    urp->buf_arr = iovp;
+    urp->num_bufs = num;
+    return 0;
+}
+
+/* Tears down the ring belonging to fd, if any. Commands that have not
+ * been reaped are abandoned. */
+void
+sg_uring_release(int fd)
+{
+    struct sg_uring * urp;
+
+    if ((fd < 0) || (fd >= SG_URING_MAX_FD))
+        return;
+    urp = __atomic_exchange_n(sg_uring_arr + fd, NULL, __ATOMIC_ACQ_REL);
+    uring_free(urp);
+}
+
+#else           /* SG_URING_BACKEND */
+
+int
+sg_uring_submit(struct sg_pt_base * vp, int time_secs, int vb)
+{
+    if (vb)
+        pr2ws("%s: not supported, no io_uring in this build\n", __func__);
+    if (vp) { ; }               /* suppress warning */
+    if (time_secs) { ; }        /* suppress warning */
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+sg_uring_receive(int fd, struct sg_pt_base ** vpp, int max_num, int wait_ms,
+                 int vb)
+{
+    if (fd || vpp || max_num || wait_ms || vb) { ; }   /* suppress warning */
+    return -ENOTTY;
+}
+
+int
+sg_uring_poll(int fd, int vb)
+{
+    if (fd || vb) { ; }         /* suppress warning */
+    return -ENOTTY;
+}
+
+int
+sg_uring_register_bufs(int fd, bool is_nvme, uint32_t nsid,
+                       uint8_t * const * bufpp, const uint32_t * buf_lens,
+                       int num, int vb)
+{
+    if (vb)
+        pr2ws("%s: not supported, no io_uring in this build\n", __func__);
+    if (fd || is_nvme || nsid || bufpp || buf_lens || num) { ; }
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+void
+sg_uring_release(int fd)
+{
+    if (fd) { ; }               /* suppress warning */
+}
+
+#endif          /* SG_URING_BACKEND */
@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/param.h>
+#include <sys/uio.h>
 
 /* Solaris headers */
 #include <sys/scsi/generic/commands.h>
@@ -197,6 +198,33 @@ set_scsi_pt_data_out(struct sg_pt_base * vp, const uint8_t * dxferp,
     }
 }
 
+/* Only a scatter gather list with one element is supported */
+void
+set_scsi_pt_data_in_iovec(struct sg_pt_base * vp, const struct iovec * iovp,
+                          int iov_count)
+{
+    struct sg_pt_solaris_scsi * ptp = &vp->impl;
+
+    if (1 == iov_count)
+        set_scsi_pt_data_in(vp, (uint8_t *)iovp->iov_base,
+                            (int)iovp->iov_len);
+    else if (iov_count > 1)
+        ++ptp->in_err;
+}
+
+void
+set_scsi_pt_data_out_iovec(struct sg_pt_base * vp, const struct iovec * iovp,
+                           int iov_count)
+{
+    struct sg_pt_solaris_scsi * ptp = &vp->impl;
+
+    if (1 == iov_count)
+        set_scsi_pt_data_out(vp, (const uint8_t *)iovp->iov_base,
+                             (int)iovp->iov_len);
+    else if (iov_count > 1)
+        ++ptp->in_err;
+}
+
 void
 set_scsi_pt_packet_id(struct sg_pt_base * vp, int pack_id)
 {
@@ -421,6 +449,43 @@ get_pt_duration_ns(const struct sg_pt_base * vp __attribute__ ((unused)))
     return 0;
 }
 
+/* Asynchronous pass-through is not supported by this implementation */
+int
+submit_scsi_pt(struct sg_pt_base * vp __attribute__ ((unused)),
+               int fd __attribute__ ((unused)),
+               int time_secs __attribute__ ((unused)),
+               int verbose __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+receive_scsi_pt(int fd __attribute__ ((unused)),
+                struct sg_pt_base ** vpp __attribute__ ((unused)),
+                int max_num __attribute__ ((unused)),
+                int wait_ms __attribute__ ((unused)),
+                int verbose __attribute__ ((unused)))
+{
+    return -ENOTTY;
+}
+
+int
+poll_scsi_pt(int fd __attribute__ ((unused)),
+             int verbose __attribute__ ((unused)))
+{
+    return -ENOTTY;
+}
+
+int
+register_pt_async_buffers(int fd __attribute__ ((unused)),
+                          uint8_t * const * bufpp __attribute__ ((unused)),
+                          const uint32_t * buf_lens __attribute__ ((unused)),
+                          int num __attribute__ ((unused)),
+                          int verbose __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
 int
 get_scsi_pt_transport_err(const struct sg_pt_base * vp)
 {
@@ -949,6 +949,29 @@ set_scsi_pt_data_out(struct sg_pt_base * vp, const uint8_t * dxferp,
     }
 }
 
+/* Scatter gather lists are not supported */
+void
+set_scsi_pt_data_in_iovec(struct sg_pt_base * vp,
+                          const struct iovec * iovp __attribute__ ((unused)),
+                          int iov_count)
+{
+    struct sg_pt_win32_scsi * psp = vp->implp;
+
+    if (iov_count > 0)
+        ++psp->in_err;
+}
+
+void
+set_scsi_pt_data_out_iovec(struct sg_pt_base * vp,
+                           const struct iovec * iovp __attribute__ ((unused)),
+                           int iov_count)
+{
+    struct sg_pt_win32_scsi * psp = vp->implp;
+
+    if (iov_count > 0)
+        ++psp->in_err;
+}
+
 void
 set_pt_metadata_xfer(struct sg_pt_base * vp, uint8_t * mdxferp,
                      uint32_t mdxfer_len, bool out_true)
@@ -1368,6 +1391,43 @@ get_pt_duration_ns(const struct sg_pt_base * vp __attribute__ ((unused)))
     return 0;
 }
 
+/* Asynchronous pass-through is not supported by this implementation */
+int
+submit_scsi_pt(struct sg_pt_base * vp __attribute__ ((unused)),
+               int fd __attribute__ ((unused)),
+               int time_secs __attribute__ ((unused)),
+               int verbose __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+receive_scsi_pt(int fd __attribute__ ((unused)),
+                struct sg_pt_base ** vpp __attribute__ ((unused)),
+                int max_num __attribute__ ((unused)),
+                int wait_ms __attribute__ ((unused)),
+                int verbose __attribute__ ((unused)))
+{
+    return -ENOTTY;
+}
+
+int
+poll_scsi_pt(int fd __attribute__ ((unused)),
+             int verbose __attribute__ ((unused)))
+{
+    return -ENOTTY;
+}
+
+int
+register_pt_async_buffers(int fd __attribute__ ((unused)),
+                          uint8_t * const * bufpp __attribute__ ((unused)),
+                          const uint32_t * buf_lens __attribute__ ((unused)),
+                          int num __attribute__ ((unused)),
+                          int verbose __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
 int
 get_scsi_pt_transport_err(const struct sg_pt_base * vp)
 {
@@ -602,7 +602,7 @@ out:
         if (wfd >= 0)
                 close(wfd);
         if (devfd >= 0)
-                close(devfd);
+                sg_cmds_close_device(devfd);
         if (0 == op->verbose) {
                 if (! sg_if_can2stderr("sg_compare_and_write failed: ", res))
                         pr2serr("Some error occurred, try again with '-v' "
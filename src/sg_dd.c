@@ -40,9 +40,11 @@
 #include <stdbool.h>
 #include <string.h>
 #include <signal.h>
+#include <pthread.h>
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <poll.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <sys/ioctl.h>
@@ -66,7 +68,7 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "6.07 20190618";
+static const char * version_str = "6.10 20261017";
 
 
 #define ME "sg_dd: "
@@ -125,6 +127,14 @@ static const char * version_str = "6.07 20190618";
 #define MAX_UNIT_ATTENTIONS 10
 #define MAX_ABORTED_CMDS 256
 
+#define MAX_QUEUE_DEPTH 16      /* sg v3 driver limit per file descriptor */
+
+/* States of a qd=QD slot */
+#define QD_FREE 0
+#define QD_READING 1            /* READ queued on sg device */
+#define QD_READ 2               /* data in buffer, waiting to be written */
+#define QD_WRITING 3            /* WRITE queued on sg device */
+
 static int sum_of_resids = 0;
 
 static int64_t dd_count = -1;
@@ -154,6 +164,9 @@ static struct timeval start_tm;
 static uint8_t * zeros_buff = NULL;
 static uint8_t * free_zeros_buff = NULL;
 static int read_long_blk_inc = READ_LONG_DEF_BLK_INC;
+static struct sg_hash_stage * hash_stagep = NULL;   /* when hash= given */
+static pthread_t hash_thr_arr[SG_HASH_MAX_THR];
+static int num_hash_thr = 0;
 
 static const char * proc_allow_dio = "/proc/scsi/sg/allow_dio";
 
@@ -178,6 +191,16 @@ struct flags_t {
 static struct flags_t iflag;
 static struct flags_t oflag;
 
+struct qd_elem {                /* one of these per buffer when qd=QD */
+    int state;                  /* QD_FREE, QD_READING, etc */
+    int blocks;
+    int64_t lba;                /* on input, output lba is offset by seek */
+    uint8_t * buf;
+    struct sg_io_hdr io_hdr;
+    uint8_t cdb[MAX_SCSI_CDBSZ];
+    uint8_t sense[SENSE_BUFF_LEN];
+};
+
 static void calc_duration_throughput(bool contin);
 
 
@@ -359,9 +382,11 @@ usage()
             "              [--dry-run] [--help] [--verbose] [--version]\n\n"
             "              [blk_sgio=0|1] [bpt=BPT] [cdbsz=6|10|12|16] "
             "[coe=0|1|2|3]\n"
-            "              [coe_limit=CL] [dio=0|1] [odir=0|1] "
-            "[of2=OFILE2] [retries=RETR]\n"
-            "              [sync=0|1] [time=0|1] [verbose=VERB]\n"
+            "              [coe_limit=CL] [dio=0|1] [hash=ALG[,THR]] "
+            "[manifest=MFILE]\n"
+            "              [odir=0|1] [of2=OFILE2] [qd=QD] [retries=RETR] "
+            "[sync=0|1]\n"
+            "              [time=0|1] [verbose=VERB] [verify=MFILE]\n"
             "  where:\n"
             "    blk_sgio    0->block device use normal I/O(def), 1->use "
             "SG_IO\n"
@@ -381,12 +406,17 @@ usage()
             "    count       number of blocks to copy (def: device size)\n"
             "    dio         for direct IO, 1->attempt, 0->indirect IO "
             "(def)\n"
+            "    hash        hash data read with ALG: crc32c or xxh64, on "
+            "THR threads\n"
+            "                (def: 2); outputs stream hash (def: crc32c "
+            "if MFILE given)\n"
             "    ibs         input logical block size (if given must be same "
             "as 'bs=')\n"
             "    if          file or device to read from (def: stdin)\n"
             "    iflag       comma separated list from: [coe,dio,direct,"
             "dpo,dsync,excl,\n"
             "                flock,fua,nocache,null,sgio]\n"
+            "    manifest    write hash of each BPT blocks read to MFILE\n"
             "    obs         output logical block size (if given must be "
             "same as 'bs=')\n"
             "    odir        1->use O_DIRECT when opening block dev, "
@@ -401,6 +431,9 @@ usage()
             "direct,dpo,\n"
             "                dsync,excl,flock,fua,nocache,null,sgio,"
             "sparse]\n"
+            "    qd          queue depth: keep up to QD READs and QD WRITEs "
+            "queued on\n"
+            "                sg devices (def: 1 (no queuing), max: %d)\n"
             "    retries     retry sgio errors RETR times (def: 0)\n"
             "    seek        block position to start writing to OFILE\n"
             "    skip        block position to start reading from IFILE\n"
@@ -410,13 +443,15 @@ usage()
             "throughput\n"
             "    verbose     0->quiet(def), 1->some noise, 2->more noise, "
             "etc\n"
+            "    verify      check hashes against MFILE from earlier "
+            "manifest=MFILE\n"
             "    --dry-run    do preparation but bypass copy (or read)\n"
             "    --help      print out this usage message then exit\n"
             "    --verbose   same as 'verbose=1', can be used multiple "
             "times\n"
             "    --version   print version information then exit\n\n"
             "copy from IFILE to OFILE, similar to dd command; "
-            "specialized for SCSI devices\n");
+            "specialized for SCSI devices\n", MAX_QUEUE_DEPTH);
 }
 
 
@@ -589,12 +624,11 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
             int bs, const struct flags_t * ifp, bool * diop,
             uint64_t * io_addrp)
 {
-    bool info_valid;
-    int res, k, slen;
-    const uint8_t * sbp;
+    int res, k;
     uint8_t rdCmd[MAX_SCSI_CDBSZ];
     uint8_t senseBuff[SENSE_BUFF_LEN];
     struct sg_io_hdr io_hdr;
+    struct sg_sense_fields sf;
 
     if (sg_build_scsi_cdb(rdCmd, ifp->cdbsz, blocks, from_block, false,
                           ifp->fua, ifp->dpo)) {
@@ -635,15 +669,16 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
     if (verbose > 2)
         pr2serr("      duration=%u ms\n", io_hdr.duration);
     res = sg_err_category3(&io_hdr);
-    sbp = io_hdr.sbp;
-    slen = io_hdr.sb_len_wr;
+    if (SG_LIB_CAT_CLEAN != res) {     /* parse sense once for cases below */
+        sg_decode_sense(io_hdr.sbp, io_hdr.sb_len_wr, &sf);
+        *io_addrp = sf.info;
+    }
     switch (res) {
     case SG_LIB_CAT_CLEAN:
         break;
     case SG_LIB_CAT_RECOVERED:
         ++recovered_errs;
-        info_valid = sg_get_sense_info_fld(sbp, slen, io_addrp);
-        if (info_valid) {
+        if (sf.info_valid) {
             pr2serr("    lba of last recovered error in this READ=0x%" PRIx64
                     "\n", *io_addrp);
             if (verbose > 1)
@@ -662,9 +697,8 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
         if (verbose > 1)
             sg_chk_n_print3("reading", &io_hdr, verbose > 1);
         ++unrecovered_errs;
-        info_valid = sg_get_sense_info_fld(sbp, slen, io_addrp);
         /* MMC devices don't necessarily set VALID bit */
-        if (info_valid || ((5 == ifp->pdt) && (*io_addrp > 0)))
+        if (sf.info_valid || ((5 == ifp->pdt) && (*io_addrp > 0)))
             return SG_LIB_CAT_MEDIUM_HARD_WITH_INFO;
         else {
             pr2serr("Medium, hardware or blank check error but no lba of "
@@ -679,16 +713,11 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
         return res;
     case SG_LIB_CAT_ILLEGAL_REQ:
         if (5 == ifp->pdt) {    /* MMC READs can go down this path */
-            bool ili;
-            struct sg_scsi_sense_hdr ssh;
-
             if (verbose > 1)
                 sg_chk_n_print3("reading", &io_hdr, verbose > 1);
-            if (sg_scsi_normalize_sense(sbp, slen, &ssh) &&
-                (0x64 == ssh.asc) && (0x0 == ssh.ascq)) {
-                if (sg_get_sense_filemark_eom_ili(sbp, slen, NULL, NULL,
-                                                  &ili) && ili) {
-                    sg_get_sense_info_fld(sbp, slen, io_addrp);
+            if (sf.ssh.response_code && (0x64 == sf.ssh.asc) &&
+                (0x0 == sf.ssh.ascq)) {
+                if (sf.has_fm_eom_ili && sf.ili) {
                     if (*io_addrp > 0) {
                         ++unrecovered_errs;
                         return SG_LIB_CAT_MEDIUM_HARD_WITH_INFO;
@@ -994,12 +1023,11 @@ static int
 sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
          int bs, const struct flags_t * ofp, bool * diop)
 {
-    bool info_valid;
     int res, k;
-    uint64_t io_addr = 0;
     uint8_t wrCmd[MAX_SCSI_CDBSZ];
     uint8_t senseBuff[SENSE_BUFF_LEN];
     struct sg_io_hdr io_hdr;
+    struct sg_sense_fields sf;
 
     if (sg_build_scsi_cdb(wrCmd, ofp->cdbsz, blocks, to_block, true, ofp->fua,
                           ofp->dpo)) {
@@ -1046,11 +1074,10 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
         break;
     case SG_LIB_CAT_RECOVERED:
         ++recovered_errs;
-        info_valid = sg_get_sense_info_fld(io_hdr.sbp, io_hdr.sb_len_wr,
-                                           &io_addr);
-        if (info_valid) {
+        sg_decode_sense(io_hdr.sbp, io_hdr.sb_len_wr, &sf);
+        if (sf.info_valid) {
             pr2serr("    lba of last recovered error in this WRITE=0x%" PRIx64
-                    "\n", io_addr);
+                    "\n", sf.info);
             if (verbose > 1)
                 sg_chk_n_print3("writing", &io_hdr, true);
         } else {
@@ -1085,6 +1112,534 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
 }
 
 
+/* Calls sg_write() and, on failure, repeats it for unit attentions and
+ * aborted commands (up to their limits) and for other errors up to
+ * oflag.retries times. On ENOMEM reduces *blocksp (and *blocks_perp) to
+ * what the reserved buffer holds and tries again. Returns as sg_write(). */
+static int
+sg_write_retry(int outfd, uint8_t * buff, int * blocksp, int64_t to_block,
+               int * blocks_perp, bool * diop)
+{
+    bool first = true;
+    int ret, buf_sz;
+    int retries_tmp = oflag.retries;
+
+    while (1) {
+        ret = sg_write(outfd, buff, *blocksp, to_block, blk_sz, &oflag,
+                       diop);
+        if (0 == ret)
+            break;
+        if ((SG_LIB_CAT_NOT_READY == ret) ||
+            (SG_LIB_SYNTAX_ERROR == ret))
+            break;
+        else if ((-2 == ret) && first) {
+            /* ENOMEM: find what's available and try that */
+            if (ioctl(outfd, SG_GET_RESERVED_SIZE, &buf_sz) < 0) {
+                perror("RESERVED_SIZE ioctls failed");
+                break;
+            }
+            if (buf_sz < MIN_RESERVED_SIZE)
+                buf_sz = MIN_RESERVED_SIZE;
+            *blocks_perp = (buf_sz + blk_sz - 1) / blk_sz;
+            if (*blocks_perp < *blocksp) {
+                *blocksp = *blocks_perp;
+                pr2serr("Reducing write to %d blocks per loop\n", *blocksp);
+            } else
+                break;
+        } else if ((SG_LIB_CAT_UNIT_ATTENTION == ret) && first) {
+            if (--max_uas > 0)
+                pr2serr("Unit attention, continuing (w)\n");
+            else {
+                pr2serr("Unit attention, too many (w)\n");
+                break;
+            }
+        } else if ((SG_LIB_CAT_ABORTED_COMMAND == ret) && first) {
+            if (--max_aborted > 0)
+                pr2serr("Aborted command, continuing (w)\n");
+            else {
+                pr2serr("Aborted command, too many (w)\n");
+                break;
+            }
+        } else if (ret < 0)
+            break;
+        else if (retries_tmp > 0) {
+            pr2serr(">>> retrying a sgio write, lba=0x%" PRIx64 "\n",
+                    (uint64_t)to_block);
+            --retries_tmp;
+            ++num_retries;
+            if (unrecovered_errs > 0)
+                --unrecovered_errs;
+        } else
+            break;
+        first = false;
+    }
+    return ret;
+}
+
+/* Queues a READ or WRITE of qep->blocks at 'lba' using the asynchronous
+ * sg v3 interface: write() of the sg_io_hdr on the sg file descriptor.
+ * Returns 0 if queued, 1 if the driver can not take it now (so try again
+ * after a completion), SG_LIB_SYNTAX_ERROR if the cdb can not be built,
+ * else -1. */
+static int
+qd_start_io(int sg_fd, struct qd_elem * qep, int64_t lba, bool wr)
+{
+    int res, k;
+    const struct flags_t * fp = wr ? &oflag : &iflag;
+    struct sg_io_hdr * hp = &qep->io_hdr;
+
+    if (sg_build_scsi_cdb(qep->cdb, fp->cdbsz, qep->blocks, lba, wr,
+                          fp->fua, fp->dpo)) {
+        pr2serr(ME "bad %s cdb build, lba=%" PRId64 ", blocks=%d\n",
+                (wr ? "wr" : "rd"), lba, qep->blocks);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    hp->interface_id = 'S';
+    hp->cmd_len = fp->cdbsz;
+    hp->cmdp = qep->cdb;
+    hp->dxfer_direction = wr ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV;
+    hp->dxfer_len = blk_sz * qep->blocks;
+    hp->dxferp = qep->buf;
+    hp->mx_sb_len = SENSE_BUFF_LEN;
+    hp->sbp = qep->sense;
+    hp->timeout = DEF_TIMEOUT;
+    hp->usr_ptr = qep;
+    hp->pack_id = (int)++glob_pack_id;
+    if (fp->dio)
+        hp->flags |= SG_FLAG_DIRECT_IO;
+
+    if (verbose > 2) {
+        pr2serr("    queue %s cdb: ", (wr ? "write" : "read"));
+        for (k = 0; k < fp->cdbsz; ++k)
+            pr2serr("%02x ", qep->cdb[k]);
+        pr2serr("\n");
+    }
+    while (((res = write(sg_fd, hp, sizeof(struct sg_io_hdr))) < 0) &&
+           (EINTR == errno))
+        ;
+    if (res < 0) {
+        /* EDOM: too many commands already queued on this file */
+        if ((EAGAIN == errno) || (EDOM == errno) || (ENOMEM == errno))
+            return 1;
+        perror(wr ? "queuing write on sg device, error" :
+                    "queuing read on sg device, error");
+        return -1;
+    }
+    qep->state = wr ? QD_WRITING : QD_READING;
+    return 0;
+}
+
+/* Fetches one completed command from 'sg_fd' with read(), which fills in
+ * the status fields; the sense data lands where qep->sense points.
+ * Returns the slot it was queued from, or NULL if there is none yet or
+ * on error (then *errp is set to -1). */
+static struct qd_elem *
+qd_finish_io(int sg_fd, int * errp)
+{
+    int res;
+    struct sg_io_hdr io_hdr;
+    struct qd_elem * qep;
+
+    memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
+    io_hdr.interface_id = 'S';
+    io_hdr.pack_id = -1;                /* any */
+    while (((res = read(sg_fd, &io_hdr, sizeof(struct sg_io_hdr))) < 0) &&
+           (EINTR == errno))
+        ;
+    if (res < 0) {
+        if (EAGAIN != errno) {
+            perror("finishing io on sg device, error");
+            *errp = -1;
+        }
+        return NULL;
+    }
+    qep = (struct qd_elem *)io_hdr.usr_ptr;
+    memcpy(&qep->io_hdr, &io_hdr, sizeof(struct sg_io_hdr));
+    return qep;
+}
+
+/* Returns 0 if the command completed in 'qep' can be used as is (clean
+ * or recovered), else its sg_err_category3() value. The caller redoes
+ * failed commands with sg_read() or sg_write_retry() so that their error
+ * recovery (retries, coe, read_long) applies. */
+static int
+qd_chk_io(struct qd_elem * qep, bool wr, int * dio_incompletep)
+{
+    int res;
+    struct sg_io_hdr * hp = &qep->io_hdr;
+
+    if (verbose > 2)
+        pr2serr("      %s of lba=0x%" PRIx64 " done, duration=%u ms\n",
+                (wr ? "write" : "read"), (uint64_t)qep->lba, hp->duration);
+    res = sg_err_category3(hp);
+    switch (res) {
+    case SG_LIB_CAT_CLEAN:
+        break;
+    case SG_LIB_CAT_RECOVERED:
+        ++recovered_errs;
+        sg_chk_n_print3((wr ? "writing" : "reading"), hp, verbose > 1);
+        break;
+    default:
+        if (verbose > 1)
+            sg_chk_n_print3((wr ? "writing, will redo" :
+                                  "reading, will redo"), hp, true);
+        return res;
+    }
+    if ((wr ? oflag.dio : iflag.dio) &&
+        ((hp->info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
+        ++*dio_incompletep;
+    if (! wr)
+        sum_of_resids += hp->resid;
+    return 0;
+}
+
+/* Reads qep->blocks at qep->lba without queuing: sg_read() for sg devices
+ * (also used to redo a failed queued READ) otherwise read(). Reduces
+ * qep->blocks and sets *eofp on a short read. Returns 0 or an error as the
+ * main copy loop would. */
+static int
+qd_read_sync(int infd, int in_type, struct qd_elem * qep, bool * eofp,
+             int * dio_incompletep)
+{
+    bool dio_tmp;
+    int res, blks_read;
+    int want = qep->blocks * blk_sz;
+    char ebuff[EBUFF_SZ];
+
+    if (FT_SG & in_type) {
+        dio_tmp = iflag.dio;
+        res = sg_read(infd, qep->buf, qep->blocks, qep->lba, blk_sz, &iflag,
+                      &dio_tmp, &blks_read);
+        if (res) {
+            pr2serr("sg_read failed,%s at or after lba=%" PRId64 " [0x%"
+                    PRIx64 "]\n", ((-2 == res) ? " try reducing bpt," : ""),
+                    qep->lba, qep->lba);
+            return res;
+        }
+        if (blks_read < qep->blocks) {
+            qep->blocks = blks_read;
+            *eofp = true;
+        }
+        if (iflag.dio && (! dio_tmp))
+            ++*dio_incompletep;
+    } else {
+        while (((res = read(infd, qep->buf, want)) < 0) &&
+               ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+        if (verbose > 2)
+            pr2serr("read(unix): count=%d, res=%d\n", want, res);
+        if (res < 0) {
+            snprintf(ebuff, EBUFF_SZ, ME "reading, skip=%" PRId64 " ",
+                     qep->lba);
+            perror(ebuff);
+            return -1;
+        } else if (res < want) {
+            *eofp = true;
+            qep->blocks = res / blk_sz;
+            if ((res % blk_sz) > 0) {
+                qep->blocks++;
+                in_partial++;
+                if (hash_stagep)    /* so hash is of what is written */
+                    memset(qep->buf + res, 0, (qep->blocks * blk_sz) - res);
+            }
+        }
+    }
+    in_full += qep->blocks;
+    return 0;
+}
+
+/* Writes qep->blocks without queuing: sg_write_retry() for sg devices
+ * (also used to redo a failed queued WRITE) otherwise write(). Returns 0
+ * or an error as the main copy loop would. */
+static int
+qd_write_sync(int outfd, int out_type, struct qd_elem * qep, int64_t lba,
+              int * dio_incompletep)
+{
+    bool dio_tmp;
+    int res, blocks_per;
+    int want = qep->blocks * blk_sz;
+    char ebuff[EBUFF_SZ];
+
+    if (FT_DEV_NULL & out_type)
+        ;
+    else if (FT_SG & out_type) {
+        dio_tmp = oflag.dio;
+        blocks_per = qep->blocks;
+        res = sg_write_retry(outfd, qep->buf, &qep->blocks, lba, &blocks_per,
+                             &dio_tmp);
+        if (res) {
+            pr2serr("sg_write failed,%s seek=%" PRId64 "\n",
+                    ((-2 == res) ? " try reducing bpt," : ""), lba);
+            return res;
+        }
+        if (oflag.dio && (! dio_tmp))
+            ++*dio_incompletep;
+    } else {
+        while (((res = write(outfd, qep->buf, want)) < 0) &&
+               ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+        if (verbose > 2)
+            pr2serr("write(unix): count=%d, res=%d\n", want, res);
+        if (res < 0) {
+            snprintf(ebuff, EBUFF_SZ, ME "writing, seek=%" PRId64 " ", lba);
+            perror(ebuff);
+            return -1;
+        } else if (res < want) {
+            pr2serr("output file probably full, seek=%" PRId64 " ", lba);
+            out_full += res / blk_sz;
+            if ((res % blk_sz) > 0)
+                out_partial++;
+            return -1;
+        }
+    }
+    out_full += qep->blocks;
+    dd_count -= qep->blocks;
+    return 0;
+}
+
+/* Copy loop used instead of the main one when qd=QD is greater than 1.
+ * Keeps up to QD READs and up to QD WRITEs queued on sg devices (with
+ * 2 * QD buffers) and takes their completions in whatever order they
+ * arrive. A WRITE to an sg device is queued as soon as its data has been
+ * read; other outputs are written in order. A side that is not an sg
+ * device is read or written synchronously. Counters (including dd_count)
+ * are updated as the main loop does. Returns 0 or an error. */
+static int
+qd_copy(int infd, int in_type, int outfd, int out_type, int64_t skip,
+        int64_t seek, int bpt, int qd, struct sg_buf_pool * bpp,
+        uint8_t * wrkPos, int * dio_incompletep)
+{
+    bool in_async = (FT_SG & in_type) && (! (FT_BLOCK & in_type));
+    bool out_async = (FT_SG & out_type) && (! (FT_BLOCK & out_type));
+    bool in_order = ! ((FT_SG | FT_DEV_NULL) & out_type);
+    bool eof = false;
+    bool stop = false;
+    bool progress;
+    int k, res, nfds, r_fd, w_fd, tmout;
+    int ferr = 0;
+    int n_rd = 0;
+    int n_wr = 0;
+    int nslots = 2 * qd;
+    int ret = 0;
+    int64_t rd_lba = skip;
+    int64_t rd_end = skip + dd_count;
+    int64_t wr_next = skip;             /* next input lba, if in_order */
+    struct qd_elem * qep;
+    struct qd_elem * qarr;
+    struct pollfd pfd[2];
+
+    qarr = (struct qd_elem *)calloc(nslots, sizeof(struct qd_elem));
+    if (NULL == qarr) {
+        pr2serr("Not enough user memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < nslots; ++k) {
+        qarr[k].buf = k ? sg_buf_pool_get(bpp) : wrkPos;
+        if (NULL == qarr[k].buf) {
+            pr2serr("sg_buf_pool: error, out of memory?\n");
+            free(qarr);
+            return sg_convert_errno(ENOMEM);
+        }
+    }
+    if (verbose)
+        pr2serr("qd=%d: %s READs, %s WRITEs, %d buffers\n", qd,
+                (in_async ? "queued" : "synchronous"),
+                (out_async ? "queued" : (in_order ? "in order" :
+                                                    "synchronous")), nslots);
+
+    while (true) {
+        /* start READs, in lba order, while there is room */
+        for (k = 0; (! stop) && (rd_lba < rd_end) && (k < nslots); ++k) {
+            qep = qarr + k;
+            if (QD_FREE != qep->state)
+                continue;
+            if (in_async && (n_rd >= qd))
+                break;
+            if (hash_stagep)
+                sg_hash_stage_wait(hash_stagep, qep->buf);
+            qep->lba = rd_lba;
+            qep->blocks = ((rd_end - rd_lba) > bpt) ? bpt :
+                                                      (int)(rd_end - rd_lba);
+            /* 1 means read it now: not queued or the driver is busy */
+            res = in_async ? qd_start_io(infd, qep, rd_lba, false) : 1;
+            if (0 == res)
+                ++n_rd;
+            else if ((1 == res) && (n_rd > 0))
+                break;          /* driver busy, wait for a completion */
+            else if (1 == res) {
+                res = qd_read_sync(infd, in_type, qep, &eof,
+                                   dio_incompletep);
+                if (res) {
+                    ret = res;
+                    stop = true;
+                    break;
+                }
+                qep->state = QD_READ;
+                if (eof)
+                    rd_end = qep->lba + qep->blocks;
+                if (0 == qep->blocks)
+                    qep->state = QD_FREE;
+                else if (hash_stagep)
+                    sg_hash_stage_submit(hash_stagep, qep->lba - skip,
+                                         qep->buf, qep->blocks);
+            } else {
+                ret = res;
+                stop = true;
+                break;
+            }
+            rd_lba += qep->blocks;
+            if (! in_async)
+                break;          /* give WRITEs a chance */
+        }
+
+        /* WRITE what has been read; in lba order if in_order */
+        do {
+            progress = false;
+            for (k = 0; (! stop) && (k < nslots); ++k) {
+                qep = qarr + k;
+                if (QD_READ != qep->state)
+                    continue;
+                if (qep->lba >= rd_end) {       /* beyond a short read */
+                    qep->state = QD_FREE;
+                    continue;
+                }
+                if (in_order && (qep->lba != wr_next))
+                    continue;
+                if (out_async && (n_wr >= qd))
+                    break;
+                res = out_async ? qd_start_io(outfd, qep,
+                                              qep->lba + seek - skip, true) :
+                                  1;
+                if (0 == res) {
+                    ++n_wr;
+                    continue;
+                } else if ((1 == res) && (n_wr > 0))
+                    break;
+                else if (1 == res)
+                    res = qd_write_sync(outfd, out_type, qep,
+                                        qep->lba + seek - skip,
+                                        dio_incompletep);
+                if (res) {
+                    ret = res;
+                    stop = true;
+                    break;
+                }
+                qep->state = QD_FREE;
+                wr_next += qep->blocks;
+                progress = true;
+            }
+        } while (progress && in_order);
+
+        if (0 == (n_rd + n_wr)) {
+            if (stop)
+                break;
+            for (k = 0; k < nslots; ++k) {
+                if (QD_FREE != qarr[k].state)
+                    break;
+            }
+            if ((k >= nslots) && (rd_lba >= rd_end))
+                break;          /* all done */
+            continue;           /* synchronous side has more to do */
+        }
+
+        /* wait for a queued command to complete, unless there is a
+         * free buffer that a synchronous READ could fill meanwhile */
+        tmout = -1;
+        if ((! in_async) && (! stop) && (rd_lba < rd_end)) {
+            for (k = 0; k < nslots; ++k) {
+                if (QD_FREE == qarr[k].state) {
+                    tmout = 0;
+                    break;
+                }
+            }
+        }
+        nfds = 0;
+        r_fd = -1;
+        w_fd = -1;
+        if (n_rd > 0) {
+            pfd[nfds].fd = infd;
+            pfd[nfds].events = POLLIN;
+            r_fd = nfds++;
+        }
+        if (n_wr > 0) {
+            pfd[nfds].fd = outfd;
+            pfd[nfds].events = POLLIN;
+            w_fd = nfds++;
+        }
+        res = poll(pfd, nfds, tmout);
+        if (res < 0) {
+            if (EINTR == errno)
+                continue;
+            perror("poll on sg device(s), error");
+            ret = -1;
+            break;      /* can not wait for what is queued, so leave */
+        }
+        /* sg fds are O_NONBLOCK so take all completions that are ready */
+        while ((r_fd >= 0) && pfd[r_fd].revents && (n_rd > 0) &&
+               (qep = qd_finish_io(infd, &ferr))) {
+            --n_rd;
+            if (stop)
+                qep->state = QD_FREE;
+            else {
+                res = qd_chk_io(qep, false, dio_incompletep);
+                if (0 == res)
+                    in_full += qep->blocks;
+                else
+                    res = qd_read_sync(infd, in_type, qep, &eof,
+                                       dio_incompletep);
+                if (res) {
+                    ret = res;
+                    stop = true;
+                    qep->state = QD_FREE;
+                } else {
+                    qep->state = QD_READ;
+                    if (eof && (rd_end > (qep->lba + qep->blocks)))
+                        rd_end = qep->lba + qep->blocks;
+                    if (hash_stagep)
+                        sg_hash_stage_submit(hash_stagep, qep->lba - skip,
+                                             qep->buf, qep->blocks);
+                }
+            }
+        }
+        if (ferr) {
+            ret = ferr;
+            break;
+        }
+        while ((w_fd >= 0) && pfd[w_fd].revents && (n_wr > 0) &&
+               (qep = qd_finish_io(outfd, &ferr))) {
+            --n_wr;
+            if (! stop) {
+                res = qd_chk_io(qep, true, dio_incompletep);
+                if (0 == res) {
+                    out_full += qep->blocks;
+                    dd_count -= qep->blocks;
+                } else
+                    res = qd_write_sync(outfd, out_type, qep,
+                                        qep->lba + seek - skip,
+                                        dio_incompletep);
+                if (res) {
+                    ret = res;
+                    stop = true;
+                }
+            }
+            qep->state = QD_FREE;
+        }
+        if (ferr) {
+            ret = ferr;
+            break;
+        }
+    }
+    if (eof && (0 == ret))
+        dd_count = 0;
+    if (hash_stagep)    /* putting a buffer in the pool writes to it */
+        sg_hash_stage_wait(hash_stagep, NULL);
+    for (k = 1; k < nslots; ++k)
+        sg_buf_pool_put(bpp, qarr[k].buf);
+    free(qarr);
+    return ret;
+}
+
 static void
 calc_duration_throughput(bool contin)
 {
@@ -1498,43 +2053,51 @@ main(int argc, char * argv[])
 {
     bool bpt_given = false;
     bool cdbsz_given = false;
-    bool dio_tmp, first;
+    bool dio_tmp;
     bool do_sync = false;
     bool penult_sparse_skip = false;
     bool sparse_skip = false;
     bool verbose_given = false;
     bool version_given = false;
     int res, k, n, t, buf_sz, blocks_per, infd, outfd, out2fd, keylen;
-    int retries_tmp, blks_read, bytes_read, bytes_of2, bytes_of;
+    int blks_read, bytes_read, bytes_of2, bytes_of;
     int in_sect_sz, out_sect_sz;
     int blocks = 0;
     int bpt = DEF_BLOCKS_PER_TRANSFER;
     int dio_incomplete_count = 0;
+    int hash_alg = 0;
+    int hash_thr = 0;
     int ibs = 0;
     int in_type = FT_OTHER;
     int obs = 0;
     int out_type = FT_OTHER;
     int out2_type = FT_OTHER;
     int penult_blocks = 0;
+    int qd = 1;
     int ret = 0;
     int64_t skip = 0;
+    int64_t skip0;
     int64_t seek = 0;
     int64_t out2_off = 0;
     int64_t in_num_sect = -1;
     int64_t out_num_sect = -1;
     char * key;
     char * buf;
-    uint8_t * wrkBuff;
     uint8_t * wrkPos;
+    struct sg_buf_pool * buf_poolp = NULL;
     char inf[INOUTF_SZ];
     char outf[INOUTF_SZ];
     char out2f[INOUTF_SZ];
+    char manf[INOUTF_SZ];
+    char verf[INOUTF_SZ];
     char str[STR_SZ];
     char ebuff[EBUFF_SZ];
 
     inf[0] = '\0';
     outf[0] = '\0';
     out2f[0] = '\0';
+    manf[0] = '\0';
+    verf[0] = '\0';
     iflag.cdbsz = DEF_SCSI_CDBSZ;
     oflag.cdbsz = DEF_SCSI_CDBSZ;
 
@@ -1604,6 +2167,12 @@ main(int argc, char * argv[])
             t = sg_get_num(buf);
             oflag.fua = !! (t & 1);
             iflag.fua = !! (t & 2);
+        } else if (0 == strcmp(key, "hash")) {
+            if (! sg_hash_parse(buf, &hash_alg, &hash_thr)) {
+                pr2serr(ME "bad argument to 'hash=', expect crc32c or "
+                        "xxh64, optionally followed by ',THR'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "ibs"))
             ibs = sg_get_num(buf);
         else if (strcmp(key, "if") == 0) {
@@ -1619,6 +2188,9 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'iflag='\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "manifest")) {
+            memcpy(manf, buf, INOUTF_SZ - 1);
+            manf[INOUTF_SZ - 1] = '\0';
         } else if (0 == strcmp(key, "obs"))
             obs = sg_get_num(buf);
         else if (0 == strcmp(key, "odir")) {
@@ -1645,6 +2217,13 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'oflag='\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "qd")) {
+            qd = sg_get_num(buf);
+            if ((qd < 1) || (qd > MAX_QUEUE_DEPTH)) {
+                pr2serr(ME "bad argument to 'qd=', expect 1 to %d\n",
+                        MAX_QUEUE_DEPTH);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "retries")) {
             iflag.retries = sg_get_num(buf);
             oflag.retries = iflag.retries;
@@ -1670,7 +2249,10 @@ main(int argc, char * argv[])
             do_time = !! sg_get_num(buf);
         else if (0 == strncmp(key, "verb", 4))
             verbose = sg_get_num(buf);
-        else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
+        else if (0 == strcmp(key, "verify")) {
+            memcpy(verf, buf, INOUTF_SZ - 1);
+            verf[INOUTF_SZ - 1] = '\0';
+        } else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
             res = 0;
             n = num_chs_in_str(key + 1, keylen - 1, 'd');
             dry_run += n;
@@ -1804,6 +2386,19 @@ main(int argc, char * argv[])
     } else
         out2fd = -1;
 
+    if (qd > 1) {
+        if (! (((FT_SG & in_type) && (! (FT_BLOCK & in_type))) ||
+               ((FT_SG & out_type) && (! (FT_BLOCK & out_type))))) {
+            pr2serr("qd=%d ignored as neither IFILE nor OFILE is an sg "
+                    "device\n", qd);
+            qd = 1;
+        } else if (out2f[0] || oflag.sparse) {
+            pr2serr("qd= greater than 1 can't be used with of2= or "
+                    "oflag=sparse\n");
+            return SG_LIB_CONTRADICT;
+        }
+    }
+
     if ((STDIN_FILENO == infd) && (STDOUT_FILENO == outfd)) {
         pr2serr("Can't have both 'if' as stdin _and_ 'of' as stdout\n");
         pr2serr("For more information use '--help'\n");
@@ -1925,15 +2520,19 @@ main(int argc, char * argv[])
 
     if (iflag.dio || iflag.direct || oflag.direct || (FT_RAW & in_type) ||
         (FT_RAW & out_type)) {  /* want heap buffer aligned to page_size */
-
-        wrkPos = sg_memalign(blk_sz * bpt, 0, &wrkBuff, false);
+        /* pool buffers are at least page aligned */
+        buf_poolp = sg_buf_pool_create(blk_sz * bpt, 2 * qd,
+                                       SG_BUF_POOL_HUGE, verbose);
+        wrkPos = buf_poolp ? sg_buf_pool_get(buf_poolp) : NULL;
         if (NULL == wrkPos) {
-            pr2serr("sg_memalign: error, out of memory?\n");
+            pr2serr("sg_buf_pool: error, out of memory?\n");
             return sg_convert_errno(ENOMEM);
         }
     } else {
-        wrkPos = sg_memalign(blk_sz * bpt, 0, &wrkBuff, false);
-        if (0 == wrkPos) {
+        buf_poolp = sg_buf_pool_create(blk_sz * bpt, 2 * qd,
+                                       SG_BUF_POOL_HUGE, verbose);
+        wrkPos = buf_poolp ? sg_buf_pool_get(buf_poolp) : NULL;
+        if (NULL == wrkPos) {
             pr2serr("Not enough user memory\n");
             return sg_convert_errno(ENOMEM);
         }
@@ -1957,8 +2556,30 @@ main(int argc, char * argv[])
         goto bypass_copy;
     }
 
+    if (hash_alg || manf[0] || verf[0]) {
+        if (0 == hash_alg)
+            sg_hash_parse("crc32c", &hash_alg, &hash_thr);
+        hash_stagep = sg_hash_stage_create(hash_alg, hash_thr, blk_sz, bpt);
+        if (NULL == hash_stagep) {
+            pr2serr("Not enough user memory for hash stage\n");
+            return sg_convert_errno(ENOMEM);
+        }
+        for (k = 0; k < hash_thr; ++k) {
+            if (pthread_create(hash_thr_arr + k, NULL, sg_hash_stage_worker,
+                               hash_stagep))
+                break;  /* submitters hash what workers can't */
+            ++num_hash_thr;
+        }
+    }
+    skip0 = skip;
+    if (qd > 1)
+        ret = qd_copy(infd, in_type, outfd, out_type, skip, seek, bpt, qd,
+                      buf_poolp, wrkPos, &dio_incomplete_count);
+
     /* <<< main loop that does the copy >>> */
-    while (dd_count > 0) {
+    while ((qd < 2) && (dd_count > 0)) {
+        if (hash_stagep)    /* last chunk read may still be being hashed */
+            sg_hash_stage_wait(hash_stagep, wrkPos);
         bytes_read = 0;
         bytes_of = 0;
         bytes_of2 = 0;
@@ -2021,6 +2642,8 @@ main(int argc, char * argv[])
                 if ((res % blk_sz) > 0) {
                     blocks++;
                     in_partial++;
+                    if (hash_stagep)    /* so hash is of what is written */
+                        memset(wrkPos + res, 0, (blocks * blk_sz) - res);
                 }
             }
             bytes_read = res;
@@ -2029,6 +2652,8 @@ main(int argc, char * argv[])
 
         if (0 == blocks)
             break;      /* nothing read so leave loop */
+        if (hash_stagep)
+            sg_hash_stage_submit(hash_stagep, skip - skip0, wrkPos, blocks);
 
         if (out2f[0]) {
             while (((res = write(out2fd, wrkPos, blocks * blk_sz)) < 0) &&
@@ -2093,58 +2718,8 @@ main(int argc, char * argv[])
             }
         } else if (FT_SG & out_type) {
             dio_tmp = oflag.dio;
-            retries_tmp = oflag.retries;
-            first = true;
-            while (1) {
-                ret = sg_write(outfd, wrkPos, blocks, seek, blk_sz,
-                               &oflag, &dio_tmp);
-                if (0 == ret)
-                    break;
-                if ((SG_LIB_CAT_NOT_READY == ret) ||
-                    (SG_LIB_SYNTAX_ERROR == ret))
-                    break;
-                else if ((-2 == ret) && first) {
-                    /* ENOMEM: find what's available and try that */
-                    if (ioctl(outfd, SG_GET_RESERVED_SIZE, &buf_sz) < 0) {
-                        perror("RESERVED_SIZE ioctls failed");
-                        break;
-                    }
-                    if (buf_sz < MIN_RESERVED_SIZE)
-                        buf_sz = MIN_RESERVED_SIZE;
-                    blocks_per = (buf_sz + blk_sz - 1) / blk_sz;
-                    if (blocks_per < blocks) {
-                        blocks = blocks_per;
-                        pr2serr("Reducing write to %d blocks per loop\n",
-                                blocks);
-                    } else
-                        break;
-                } else if ((SG_LIB_CAT_UNIT_ATTENTION == ret) && first) {
-                    if (--max_uas > 0)
-                        pr2serr("Unit attention, continuing (w)\n");
-                    else {
-                        pr2serr("Unit attention, too many (w)\n");
-                        break;
-                    }
-                } else if ((SG_LIB_CAT_ABORTED_COMMAND == ret) && first) {
-                    if (--max_aborted > 0)
-                        pr2serr("Aborted command, continuing (w)\n");
-                    else {
-                        pr2serr("Aborted command, too many (w)\n");
-                        break;
-                    }
-                } else if (ret < 0)
-                    break;
-                else if (retries_tmp > 0) {
-                    pr2serr(">>> retrying a sgio write, lba=0x%" PRIx64 "\n",
-                            (uint64_t)seek);
-                    --retries_tmp;
-                    ++num_retries;
-                    if (unrecovered_errs > 0)
-                        --unrecovered_errs;
-                } else
-                    break;
-                first = false;
-            }
+            ret = sg_write_retry(outfd, wrkPos, &blocks, seek, &blocks_per,
+                                 &dio_tmp);
             if (0 != ret) {
                 pr2serr("sg_write failed,%s seek=%" PRId64 "\n",
                         ((-2 == ret) ? " try reducing bpt," : ""), seek);
@@ -2257,7 +2832,9 @@ bypass_copy:
     if (do_time)
         calc_duration_throughput(false);
 
-    free(wrkBuff);
+    if (hash_stagep)
+        sg_hash_stage_wait(hash_stagep, NULL);
+    sg_buf_pool_destroy(buf_poolp);
     if (free_zeros_buff)
         free(free_zeros_buff);
     if (STDIN_FILENO != infd)
@@ -2273,6 +2850,16 @@ bypass_copy:
             ret = SG_LIB_CAT_OTHER;
     }
     print_stats("");
+    if (hash_stagep) {
+        sg_hash_stage_stop(hash_stagep);
+        for (k = 0; k < num_hash_thr; ++k)
+            pthread_join(hash_thr_arr[k], NULL);
+        res = sg_hash_stage_finish(hash_stagep, (manf[0] ? manf : NULL),
+                                   (verf[0] ? verf : NULL), verbose);
+        if (res && (0 == ret))
+            ret = res;
+        sg_hash_stage_destroy(hash_stagep);
+    }
     if (dio_incomplete_count) {
         int fd;
         char c;
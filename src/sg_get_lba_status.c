@@ -35,7 +35,7 @@
  * device.
  */
 
-static const char * version_str = "1.20 20190822";      /* sbc4r15 */
+static const char * version_str = "1.21 20261017";      /* sbc4r15 */
 
 #ifndef UINT32_MAX
 #define UINT32_MAX ((uint32_t)-1)
@@ -313,14 +313,6 @@ main(int argc, char * argv[])
         return 0;
     }
 
-    if (maxlen > DEF_GLBAS_BUFF_LEN) {
-        glbasBuffp = (uint8_t *)sg_memalign(maxlen, 0, &free_glbasBuffp,
-                                            verbose > 3);
-        if (NULL == glbasBuffp) {
-            pr2serr("unable to allocate %d bytes on heap\n", maxlen);
-            return sg_convert_errno(ENOMEM);
-        }
-    }
     if (device_name && in_fn) {
         pr2serr("ignoring DEVICE, best to give DEVICE or --inhex=FN, but "
                 "not both\n");
@@ -328,15 +320,12 @@ main(int argc, char * argv[])
     }
     if (NULL == device_name) {
         if (in_fn) {
-            if ((ret = sg_f2hex_arr(in_fn, do_raw, false, glbasBuffp,
-                                    &in_len, maxlen))) {
-                if (SG_LIB_LBA_OUT_OF_RANGE == ret) {
-                    no_final_msg = true;
-                    pr2serr("... decode what we have, --maxlen=%d needs to "
-                            "be increased\n", maxlen);
-                } else
-                    goto fini;
-            }
+            if ((ret = sg_f2hex_arr_alloc(in_fn, do_raw, false, &glbasBuffp,
+                                          &in_len, maxlen)))
+                goto fini;
+            free_glbasBuffp = glbasBuffp;
+            if (in_len > maxlen)
+                maxlen = in_len;    /* decode all of FN */
             if (verbose > 2)
                 pr2serr("Read %d [0x%x] bytes of user supplied data\n",
                         in_len, in_len);
@@ -358,6 +347,14 @@ main(int argc, char * argv[])
             goto fini;
         }
     }
+    if (maxlen > DEF_GLBAS_BUFF_LEN) {
+        glbasBuffp = (uint8_t *)sg_memalign(maxlen, 0, &free_glbasBuffp,
+                                            verbose > 3);
+        if (NULL == glbasBuffp) {
+            pr2serr("unable to allocate %d bytes on heap\n", maxlen);
+            return sg_convert_errno(ENOMEM);
+        }
+    }
     if (do_raw) {
         if (sg_set_binary_mode(STDOUT_FILENO) < 0) {
             perror("sg_set_binary_mode");
@@ -36,7 +36,7 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.77 20190822";    /* spc5r22 + sbc4r17 */
+static const char * version_str = "1.78 20261017";    /* spc5r22 + sbc4r17 */
 
 #define MX_ALLOC_LEN (0xfffc)
 #define SHORT_RESP_LEN 128
@@ -6786,13 +6786,6 @@ main(int argc, char * argv[])
         enumerate_pages(op);
         return 0;
     }
-    rsp_buff = sg_memalign(rsp_buff_sz, 0 /* page aligned */, &free_rsp_buff,
-                           false);
-    if (NULL == rsp_buff) {
-        pr2serr("Unable to allocate %d bytes on the heap\n", rsp_buff_sz);
-        ret = sg_convert_errno(ENOMEM);
-        goto err_out;
-    }
     if (NULL == op->device_name) {
         if (op->in_fn) {
             const struct log_elem * lep;
@@ -6800,9 +6793,11 @@ main(int argc, char * argv[])
             int pg_code, subpg_code, pdt, n;
             uint16_t u;
 
-            if ((ret = sg_f2hex_arr(op->in_fn, op->do_raw, false, rsp_buff,
-                                    &in_len, rsp_buff_sz)))
+            /* FN may hold many log pages so its size is not limited */
+            if ((ret = sg_f2hex_arr_alloc(op->in_fn, op->do_raw, false,
+                                          &rsp_buff, &in_len, rsp_buff_sz)))
                 goto err_out;
+            free_rsp_buff = rsp_buff;
             if (vb > 2)
                 pr2serr("Read %d [0x%x] bytes of user supplied data\n",
                         in_len, in_len);
@@ -6860,6 +6855,13 @@ main(int argc, char * argv[])
         ret = SG_LIB_SYNTAX_ERROR;
         goto err_out;
     }
+    rsp_buff = sg_memalign(rsp_buff_sz, 0 /* page aligned */, &free_rsp_buff,
+                           false);
+    if (NULL == rsp_buff) {
+        pr2serr("Unable to allocate %d bytes on the heap\n", rsp_buff_sz);
+        ret = sg_convert_errno(ENOMEM);
+        goto err_out;
+    }
     if (op->do_select) {
         if (op->do_temperature) {
             pr2serr("--select cannot be used with --temperature\n");
@@ -38,7 +38,7 @@
  * and decodes the response. Based on zbc-r02.pdf
  */
 
-static const char * version_str = "1.17 20190113";
+static const char * version_str = "1.18 20261017";
 
 #define MAX_RZONES_BUFF_LEN (1024 * 1024)
 #define DEF_RZONES_BUFF_LEN (1024 * 8)
@@ -54,6 +54,8 @@ static const char * version_str = "1.17 20190113";
 static struct option long_options[] = {
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
+        {"in", required_argument, 0, 'i'},      /* silent, same as --inhex= */
+        {"inhex", required_argument, 0, 'i'},
         {"maxlen", required_argument, 0, 'm'},
         {"partial", no_argument, 0, 'p'},
         {"raw", no_argument, 0, 'r'},
@@ -71,7 +73,8 @@ usage(int h)
 {
     if (h > 1) goto h_twoormore;
     pr2serr("Usage: "
-            "sg_rep_zones  [--help] [--hex] [--maxlen=LEN] [--partial]\n"
+            "sg_rep_zones  [--help] [--hex] [--inhex=FN] [--maxlen=LEN] "
+            "[--partial]\n"
             "                     [--raw] [--readonly] [--report=OPT] "
             "[--start=LBA]\n"
             "                     [--verbose] [--version] DEVICE\n");
@@ -81,6 +84,10 @@ usage(int h)
             "    --hex|-H           output response in hexadecimal; used "
             "twice\n"
             "                       shows decoded values in hex\n"
+            "    --inhex=FN|-i FN    decode contents of FN, assumed to be "
+            "ASCII hex\n"
+            "                        or, if --raw, binary (def: send "
+            "command to DEVICE)\n"
             "    --maxlen=LEN|-m LEN    max response length (allocation "
             "length in cdb)\n"
             "                           (def: 0 -> 8192 bytes)\n"
@@ -98,7 +105,8 @@ usage(int h)
             "    --version|-V       print version string and exit\n\n"
             "Sends a SCSI REPORT ZONES command and decodes the response. "
             "Give\nhelp option twice (e.g. '-hh') to see reporting options "
-            "enumerated.\n");
+            "enumerated.\nIf --inhex=FN is given then the contents of FN "
+            "are decoded as if they\nwere the response to this command.\n");
     return;
 h_twoormore:
     pr2serr("Reporting options:\n"
@@ -292,6 +300,7 @@ main(int argc, char * argv[])
     uint64_t st_lba = 0;
     int64_t ll;
     const char * device_name = NULL;
+    const char * in_fn = NULL;
     uint8_t * reportZonesBuff = NULL;
     uint8_t * free_rzbp = NULL;
     uint8_t * bp;
@@ -300,7 +309,7 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "hHm:o:prRs:vV", long_options,
+        c = getopt_long(argc, argv, "hHi:m:o:prRs:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -313,6 +322,9 @@ main(int argc, char * argv[])
         case 'H':
             ++do_hex;
             break;
+        case 'i':
+            in_fn = optarg;
+            break;
         case 'm':
             maxlen = sg_get_num(optarg);
             if ((maxlen < 0) || (maxlen > MAX_RZONES_BUFF_LEN)) {
@@ -396,10 +408,30 @@ main(int argc, char * argv[])
         usage(do_help);
         return 0;
     }
+    if (device_name && in_fn) {
+        pr2serr("ignoring DEVICE, best to give DEVICE or --inhex=FN, but "
+                "not both\n");
+        device_name = NULL;
+    }
+    if (0 == maxlen)
+        maxlen = DEF_RZONES_BUFF_LEN;
     if (NULL == device_name) {
-        pr2serr("missing device name!\n");
-        usage(1);
-        return SG_LIB_SYNTAX_ERROR;
+        if (NULL == in_fn) {
+            pr2serr("missing device name!\n");
+            usage(1);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        /* a captured zone list may be far larger than one response */
+        ret = sg_f2hex_arr_alloc(in_fn, do_raw, false, &reportZonesBuff,
+                                 &rlen, maxlen);
+        if (ret)
+            goto the_end;
+        free_rzbp = reportZonesBuff;
+        if (verbose > 2)
+            pr2serr("Read %d [0x%x] bytes of user supplied data\n", rlen,
+                    rlen);
+        do_raw = false;         /* can interfere on decode */
+        goto start_response;
     }
 
     if (do_raw) {
@@ -418,8 +450,6 @@ main(int argc, char * argv[])
         goto the_end;
     }
 
-    if (0 == maxlen)
-        maxlen = DEF_RZONES_BUFF_LEN;
     reportZonesBuff = (uint8_t *)sg_memalign(maxlen, 0, &free_rzbp,
                                              verbose > 3);
     if (NULL == reportZonesBuff) {
@@ -430,72 +460,75 @@ main(int argc, char * argv[])
     res = sg_ll_report_zones(sg_fd, st_lba, do_partial, reporting_opt,
                              reportZonesBuff, maxlen, &resid, true, verbose);
     ret = res;
-    if (0 == res) {
-        rlen = maxlen - resid;
-        if (rlen < 4) {
-            pr2serr("Response length (%d) too short\n", rlen);
-            ret = SG_LIB_CAT_MALFORMED;
-            goto the_end;
-        }
-        zl_len = sg_get_unaligned_be32(reportZonesBuff + 0) + 64;
-        if (zl_len > rlen) {
-            if (verbose)
-                pr2serr("zl_len available is %d, response length is %d\n",
-                        zl_len, rlen);
-            len = rlen;
-        } else
-            len = zl_len;
-        if (do_raw) {
-            dStrRaw(reportZonesBuff, len);
-            goto the_end;
-        }
-        if (do_hex && (2 != do_hex)) {
-            hex2stdout(reportZonesBuff, len,
-                    ((1 == do_hex) ? 1 : -1));
-            goto the_end;
-        }
-        printf("Report zones response:\n");
-        if (len < 64) {
-            pr2serr("Zone length [%d] too short (perhaps after truncation\n)",
-                    len);
-            ret = SG_LIB_CAT_MALFORMED;
-            goto the_end;
+    if (res) {
+        if (SG_LIB_CAT_INVALID_OP == res)
+            pr2serr("Report zones command not supported\n");
+        else {
+            sg_get_category_sense_str(res, sizeof(b), b, verbose);
+            pr2serr("Report zones command: %s\n", b);
         }
-        same = reportZonesBuff[4] & 0xf;
-        printf("  Same=%d: %s\n\n", same, same_desc_arr[same]);
-        printf("  Maximum LBA: 0x%" PRIx64 "\n",
-               sg_get_unaligned_be64(reportZonesBuff + 8));
-        zones = (len - 64) / 64;
-        for (k = 0, bp = reportZonesBuff + 64; k < zones; ++k, bp += 64) {
-            printf(" Zone descriptor: %d\n", k);
-            if (do_hex) {
-                hex2stdout(bp, len, -1);
-                continue;
-            }
-            zt = bp[0] & 0xf;
-            zc = (bp[1] >> 4) & 0xf;
-            printf("   Zone type: %s\n", zone_type_str(zt, b, sizeof(b),
-                   verbose));
-            printf("   Zone condition: %s\n", zone_condition_str(zc, b,
-                   sizeof(b), verbose));
-            printf("   Non_seq: %d\n", !!(bp[1] & 0x2));
-            printf("   Reset: %d\n", bp[1] & 0x1);
-            printf("   Zone Length: 0x%" PRIx64 "\n",
-                   sg_get_unaligned_be64(bp + 8));
-            printf("   Zone start LBA: 0x%" PRIx64 "\n",
-                   sg_get_unaligned_be64(bp + 16));
-            printf("   Write pointer LBA: 0x%" PRIx64 "\n",
-                   sg_get_unaligned_be64(bp + 24));
+        goto the_end;
+    }
+    rlen = maxlen - resid;
+
+start_response:
+    if (rlen < 4) {
+        pr2serr("Response length (%d) too short\n", rlen);
+        ret = SG_LIB_CAT_MALFORMED;
+        goto the_end;
+    }
+    zl_len = sg_get_unaligned_be32(reportZonesBuff + 0) + 64;
+    if (zl_len > rlen) {
+        if (verbose)
+            pr2serr("zl_len available is %d, response length is %d\n",
+                    zl_len, rlen);
+        len = rlen;
+    } else
+        len = zl_len;
+    if (do_raw) {
+        dStrRaw(reportZonesBuff, len);
+        goto the_end;
+    }
+    if (do_hex && (2 != do_hex)) {
+        hex2stdout(reportZonesBuff, len, ((1 == do_hex) ? 1 : -1));
+        goto the_end;
+    }
+    printf("Report zones response:\n");
+    if (len < 64) {
+        pr2serr("Zone length [%d] too short (perhaps after truncation\n)",
+                len);
+        ret = SG_LIB_CAT_MALFORMED;
+        goto the_end;
+    }
+    same = reportZonesBuff[4] & 0xf;
+    printf("  Same=%d: %s\n\n", same, same_desc_arr[same]);
+    printf("  Maximum LBA: 0x%" PRIx64 "\n",
+           sg_get_unaligned_be64(reportZonesBuff + 8));
+    zones = (len - 64) / 64;
+    for (k = 0, bp = reportZonesBuff + 64; k < zones; ++k, bp += 64) {
+        printf(" Zone descriptor: %d\n", k);
+        if (do_hex) {
+            hex2stdout(bp, len, -1);
+            continue;
         }
-        if ((64 + (64 * zones)) < zl_len)
-            printf("\n>>> Beware: Zone list truncated, may need another "
-                   "call\n");
-    } else if (SG_LIB_CAT_INVALID_OP == res)
-        pr2serr("Report zones command not supported\n");
-    else {
-        sg_get_category_sense_str(res, sizeof(b), b, verbose);
-        pr2serr("Report zones command: %s\n", b);
+        zt = bp[0] & 0xf;
+        zc = (bp[1] >> 4) & 0xf;
+        printf("   Zone type: %s\n", zone_type_str(zt, b, sizeof(b),
+               verbose));
+        printf("   Zone condition: %s\n", zone_condition_str(zc, b,
+               sizeof(b), verbose));
+        printf("   Non_seq: %d\n", !!(bp[1] & 0x2));
+        printf("   Reset: %d\n", bp[1] & 0x1);
+        printf("   Zone Length: 0x%" PRIx64 "\n",
+               sg_get_unaligned_be64(bp + 8));
+        printf("   Zone start LBA: 0x%" PRIx64 "\n",
+               sg_get_unaligned_be64(bp + 16));
+        printf("   Write pointer LBA: 0x%" PRIx64 "\n",
+               sg_get_unaligned_be64(bp + 24));
     }
+    if ((64 + (64 * zones)) < zl_len)
+        printf("\n>>> Beware: Zone list truncated, may need another "
+               "call\n");
 
 the_end:
     if (free_rzbp)
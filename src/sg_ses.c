@@ -38,7 +38,7 @@
  * commands tailored for SES (enclosure) devices.
  */
 
-static const char * version_str = "2.46 20190826";    /* ses4r03 */
+static const char * version_str = "2.47 20261017";    /* ses4r03 */
 
 #define MX_ALLOC_LEN ((64 * 1024) - 4)  /* max allowable for big enclosures */
 #define MX_ELEM_HDR 1024
@@ -46,7 +46,6 @@ static const char * version_str = "2.46 20190826";    /* ses4r03 */
 #define DATA_IN_OFF 4
 #define MIN_DATA_IN_SZ 8192     /* use max(MIN_DATA_IN_SZ, op->maxlen) for
                                  * the size of data_arr */
-#define MX_DATA_IN_LINES (16 * 1024)
 #define MX_JOIN_ROWS 520        /* element index fields in dpages are only 8
                                  * bit, and index 0xff (255) is sometimes used
                                  * for 'not applicable'. However this limit
@@ -812,7 +811,7 @@ static uint8_t ses3_element_cmask_arr[NUM_ETC][4] = {
 
 
 static int read_hex(const char * inp, uint8_t * arr, int mx_arr_len,
-                    int * arr_len, bool in_hex, bool may_gave_at, int verb);
+                    int * arr_len, int verb);
 static int strcase_eq(const char * s1p, const char * s2p);
 static void enumerate_diag_pages(void);
 static bool saddr_non_zero(const uint8_t * bp);
@@ -1136,8 +1135,10 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
     int c, j, n, d_len, ret;
     const char * data_arg = NULL;
     const char * inhex_arg = NULL;
+    const char * fn = NULL;
     uint64_t saddr;
     const char * cp;
+    uint8_t * in_arr = NULL;
 
     while (1) {
         int option_index = 0;
@@ -1375,32 +1376,56 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
             goto err_help;
         }
     }
+    /* only --data=H,H... is not read from a file (or stdin) */
+    if (inhex_arg)
+        fn = inhex_arg;
+    else if (data_arg) {
+        if (0 == strcmp(data_arg, "-"))
+            fn = data_arg;
+        else if (('@' == data_arg[0]) || (op->do_raw > 1))
+            fn = data_arg + 1;  /* binary is never on the command line */
+    }
+    if (fn) {   /* a file (or stdin) may hold many dpages; no size limit */
+        ret = sg_f2hex_arr_alloc(fn, (op->do_raw > 1), false, &in_arr,
+                                 &op->arr_len, 0);
+        if (ret) {
+            if (inhex_arg)
+                pr2serr("bad argument, expect '--inhex=FN' or "
+                        "'--inhex=-'\n");
+            else
+                pr2serr("bad argument, expect '--data=-' or "
+                        "'--data=@FN'\n");
+            return ret;
+        }
+        if (op->verbose > 3) {
+            pr2serr("%s: user provided data:\n", __func__);
+            hex2stderr(in_arr, op->arr_len, 0);
+        }
+    }
     op->mx_arr_len = (op->maxlen > MIN_DATA_IN_SZ) ? op->maxlen :
                                                      MIN_DATA_IN_SZ;
+    if (op->mx_arr_len < (op->arr_len + DATA_IN_OFF))
+        op->mx_arr_len = op->arr_len + DATA_IN_OFF;
     op->data_arr = sg_memalign(op->mx_arr_len, 0 /* page aligned */,
                                &op->free_data_arr, false);
     if (NULL == op->data_arr) {
         pr2serr("unable to allocate %u bytes on heap\n", op->mx_arr_len);
+        free(in_arr);
         return sg_convert_errno(ENOMEM);
     }
-    if (data_arg || inhex_arg) {
-        if (inhex_arg) {
-            data_arg = inhex_arg;
-            if (read_hex(data_arg, op->data_arr + DATA_IN_OFF,
-                         op->mx_arr_len - DATA_IN_OFF, &op->arr_len,
-                         (op->do_raw < 2), false, op->verbose)) {
-                pr2serr("bad argument, expect '--inhex=FN' or '--inhex=-'\n");
-                return SG_LIB_SYNTAX_ERROR;
-            }
-        } else {
-            if (read_hex(data_arg, op->data_arr + DATA_IN_OFF,
-                         op->mx_arr_len - DATA_IN_OFF, &op->arr_len,
-                         (op->do_raw < 2), true, op->verbose)) {
-                pr2serr("bad argument, expect '--data=H,H...', '--data=-' or "
-                        "'--data=@FN'\n");
-                return SG_LIB_SYNTAX_ERROR;
-            }
+    if (in_arr) {
+        memcpy(op->data_arr + DATA_IN_OFF, in_arr, op->arr_len);
+        free(in_arr);
+    } else if (data_arg) {
+        if (read_hex(data_arg, op->data_arr + DATA_IN_OFF,
+                     op->mx_arr_len - DATA_IN_OFF, &op->arr_len,
+                     op->verbose)) {
+            pr2serr("bad argument, expect '--data=H,H...', '--data=-' or "
+                    "'--data=@FN'\n");
+            return SG_LIB_SYNTAX_ERROR;
         }
+    }
+    if (data_arg || inhex_arg) {
         op->do_raw = 0;
         /* struct data_in_desc_t stuff does not apply when --control */
         if (op->do_status && (op->arr_len > 3)) {
@@ -3884,221 +3909,60 @@ truncated:
     return;
 }
 
-/* Reads hex data from command line, stdin or a file when in_hex is true.
- * Reads binary from stdin or file when in_hex is false. Returns 0 on
- * success, 1 otherwise. If inp is a file and may_have_at, then the
- * first character is skipped to get filename (since it should be '@'). */
+/* Reads comma or space separated hex data from the command line (files
+ * and stdin are read by sg_f2hex_arr_alloc()). Returns 0 on success,
+ * 1 otherwise. */
 static int
 read_hex(const char * inp, uint8_t * arr, int mx_arr_len, int * arr_len,
-         bool in_hex, bool may_have_at, int vb)
+         int vb)
 {
-    bool has_stdin, split_line;
-    int in_len, k, j, m, off, off_fn;
+    int in_len, k;
     unsigned int h;
     const char * lcp;
     char * cp;
     char * c2p;
-    char line[512];
-    char carry_over[4];
-    FILE * fp = NULL;
 
     if ((NULL == inp) || (NULL == arr) || (NULL == arr_len))
         return 1;
-    off_fn = may_have_at ? 1 : 0;
     lcp = inp;
     in_len = strlen(inp);
     if (0 == in_len) {
         *arr_len = 0;
         return 0;
     }
-    has_stdin = ((1 == in_len) && ('-' == inp[0]));
-
-    if (! in_hex) {     /* binary, assume its not on the command line, */
-        int fd;         /* that leaves stdin or a file (pipe) */
-        struct stat a_stat;
-
-        if (has_stdin)
-            fd = STDIN_FILENO;
-        else {
-            fd = open(inp + off_fn, O_RDONLY);
-            if (fd < 0) {
-                pr2serr("unable to open binary file %s: %s\n", inp + off_fn,
-                         safe_strerror(errno));
-                return 1;
-            }
-        }
-        k = read(fd, arr, mx_arr_len);
-        if (k <= 0) {
-            if (0 == k)
-                pr2serr("read 0 bytes from binary file %s\n", inp + off_fn);
-            else
-                pr2serr("read from binary file %s: %s\n", inp + off_fn,
-                        safe_strerror(errno));
-            if (! has_stdin)
-                close(fd);
-            return 1;
-        }
-        if ((0 == fstat(fd, &a_stat)) && S_ISFIFO(a_stat.st_mode)) {
-            /* pipe; keep reading till error or 0 read */
-            while (k < mx_arr_len) {
-                m = read(fd, arr + k, mx_arr_len - k);
-                if (0 == m)
-                   break;
-                if (m < 0) {
-                    pr2serr("read from binary pipe %s: %s\n", inp + off_fn,
-                            safe_strerror(errno));
-                    if (! has_stdin)
-                        close(fd);
-                    return 1;
-                }
-                k += m;
-            }
-        }
-        *arr_len = k;
-        if (! has_stdin)
-            close(fd);
-        return 0;
+    k = strspn(inp, "0123456789aAbBcCdDeEfF, ");
+    if (in_len != k) {
+        pr2serr("%s: error at pos %d\n", __func__, k + 1);
+        return 1;
     }
-    if (has_stdin || (! may_have_at) || ('@' == inp[0])) {
-        /* read hex from stdin or file */
-        if (has_stdin)
-            fp = stdin;
-        else {
-            fp = fopen(inp + off_fn, "r");
-            if (NULL == fp) {
-                pr2serr("%s: unable to open file: %s\n", __func__,
-                        inp + off_fn);
+    for (k = 0; k < mx_arr_len; ++k) {
+        if (1 == sscanf(lcp, "%x", &h)) {
+            if (h > 0xff) {
+                pr2serr("%s: hex number larger than 0xff at pos %d\n",
+                        __func__, (int)(lcp - inp + 1));
                 return 1;
             }
-        }
-        carry_over[0] = 0;
-        for (j = 0, off = 0; j < MX_DATA_IN_LINES; ++j) {
-            if (NULL == fgets(line, sizeof(line), fp))
-                break;
-            in_len = strlen(line);
-            if (in_len > 0) {
-                if ('\n' == line[in_len - 1]) {
-                    --in_len;
-                    line[in_len] = '\0';
-                    split_line = false;
-                } else
-                    split_line = true;
-            }
-            if (in_len < 1) {
-                carry_over[0] = 0;
-                continue;
-            }
-            if (carry_over[0]) {
-                if (isxdigit(line[0])) {
-                    carry_over[1] = line[0];
-                    carry_over[2] = '\0';
-                    if (1 == sscanf(carry_over, "%x", &h))
-                        arr[off - 1] = h;       /* back up and overwrite */
-                    else {
-                        pr2serr("%s: carry_over error ['%s'] around line "
-                                "%d\n", __func__, carry_over, j + 1);
-                        goto err_with_fp;
-                    }
-                    lcp = line + 1;
-                    --in_len;
-                } else
-                    lcp = line;
-                carry_over[0] = 0;
-            } else
-                lcp = line;
-            m = strspn(lcp, " \t");
-            if (m == in_len)
-                continue;
-            lcp += m;
-            in_len -= m;
-            if ('#' == *lcp)
-                continue;
-            k = strspn(lcp, "0123456789aAbBcCdDeEfF ,\t");
-            if (in_len != k) {
-                pr2serr("%s: syntax error at line %d, pos %d\n", __func__,
-                        j + 1, m + k + 1);
-                if (vb > 2)
-                    pr2serr("first 40 characters of line: %.40s\n", line);
-                goto err_with_fp;
-            }
-            for (k = 0; k < (mx_arr_len - off); ++k) {
-                if (1 == sscanf(lcp, "%x", &h)) {
-                    if (h > 0xff) {
-                        pr2serr("%s: hex number larger than 0xff in line %d, "
-                                "pos %d\n", __func__, j + 1,
-                                (int)(lcp - line + 1));
-                        if (vb > 2)
-                            pr2serr("first 40 characters of line: %.40s\n",
-                                    line);
-                        goto err_with_fp;
-                    }
-                    if (split_line && (1 == strlen(lcp))) {
-                        /* single trailing hex digit might be a split pair */
-                        carry_over[0] = *lcp;
-                    }
-                    arr[off + k] = h;
-                    lcp = strpbrk(lcp, " ,\t");
-                    if (NULL == lcp)
-                        break;
-                    lcp += strspn(lcp, " ,\t");
-                    if ('\0' == *lcp)
-                        break;
-                } else {
-                    pr2serr("%s: error in line %d, at pos %d\n", __func__,
-                            j + 1, (int)(lcp - line + 1));
-                    if (vb > 2)
-                        pr2serr("first 40 characters of line: %.40s\n", line);
-                    goto err_with_fp;
-                }
-            }
-            off += k + 1;
-            if (off >= mx_arr_len)
+            arr[k] = h;
+            cp = (char *)strchr(lcp, ',');
+            c2p = (char *)strchr(lcp, ' ');
+            if (NULL == cp)
+                cp = c2p;
+            if (NULL == cp)
                 break;
+            if (c2p && (c2p < cp))
+                cp = c2p;
+            lcp = cp + 1;
+        } else {
+            pr2serr("%s: error at pos %d\n", __func__, (int)(lcp - inp + 1));
+            return 1;
         }
-        *arr_len = off;
-    } else {        /* hex string on command line */
-        k = strspn(inp, "0123456789aAbBcCdDeEfF, ");
-        if (in_len != k) {
-            pr2serr("%s: error at pos %d\n", __func__, k + 1);
-            goto err_with_fp;
-        }
-        for (k = 0; k < mx_arr_len; ++k) {
-            if (1 == sscanf(lcp, "%x", &h)) {
-                if (h > 0xff) {
-                    pr2serr("%s: hex number larger than 0xff at pos %d\n",
-                            __func__, (int)(lcp - inp + 1));
-                    goto err_with_fp;
-                }
-                arr[k] = h;
-                cp = (char *)strchr(lcp, ',');
-                c2p = (char *)strchr(lcp, ' ');
-                if (NULL == cp)
-                    cp = c2p;
-                if (NULL == cp)
-                    break;
-                if (c2p && (c2p < cp))
-                    cp = c2p;
-                lcp = cp + 1;
-            } else {
-                pr2serr("%s: error at pos %d\n", __func__,
-                        (int)(lcp - inp + 1));
-                goto err_with_fp;
-            }
-        }
-        *arr_len = k + 1;
     }
+    *arr_len = k + 1;
     if (vb > 3) {
         pr2serr("%s: user provided data:\n", __func__);
         hex2stderr(arr, *arr_len, 0);
     }
-    if (fp && (fp != stdin))
-        fclose(fp);
     return 0;
-
-err_with_fp:
-    if (fp && (fp != stdin))
-        fclose(fp);
-    return 1;
 }
 
 static int
@@ -40,7 +40,7 @@
 
 */
 
-static const char * version_str = "1.54 20190516";  /* spc5r22 + sbc4r17 */
+static const char * version_str = "1.55 20261017";  /* spc5r22 + sbc4r17 */
 
 /* standard VPD pages, in ascending page number order */
 #define VPD_SUPPORTED_VPDS 0x0
@@ -3823,22 +3823,17 @@ main(int argc, char * argv[])
         subvalue = op->vend_prod_num;
     }
 
-    rsp_buff = sg_memalign(rsp_buff_sz, 0 /* page align */, &free_rsp_buff,
-                           false);
-    if (NULL == rsp_buff) {
-        pr2serr("Unable to allocate %d bytes on heap\n", rsp_buff_sz);
-        return sg_convert_errno(ENOMEM);
-    }
     if (op->inhex_fn) {
         if (op->device_name) {
             pr2serr("Cannot have both a DEVICE and --inhex= option\n");
             ret = SG_LIB_SYNTAX_ERROR;
             goto err_out;
         }
-        if ((ret = sg_f2hex_arr(op->inhex_fn, !!op->do_raw, false, rsp_buff,
-                                &inhex_len, rsp_buff_sz))) {
+        /* buffer sized to hold all of FN, so --all can walk many pages */
+        if ((ret = sg_f2hex_arr_alloc(op->inhex_fn, !!op->do_raw, false,
+                                      &rsp_buff, &inhex_len, rsp_buff_sz)))
             goto err_out;
-        }
+        free_rsp_buff = rsp_buff;
         if (op->verbose > 2)
             pr2serr("Read %d [0x%x] bytes of user supplied data\n", inhex_len,
                     inhex_len);
@@ -3875,6 +3870,13 @@ main(int argc, char * argv[])
         usage();
         ret = SG_LIB_SYNTAX_ERROR;
         goto err_out;
+    } else {
+        rsp_buff = sg_memalign(rsp_buff_sz, 0 /* page align */,
+                               &free_rsp_buff, false);
+        if (NULL == rsp_buff) {
+            pr2serr("Unable to allocate %d bytes on heap\n", rsp_buff_sz);
+            return sg_convert_errno(ENOMEM);
+        }
     }
 
     if (op->do_raw && op->do_hex) {
@@ -43,6 +43,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <signal.h>
+#include <pthread.h>
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
@@ -69,7 +70,7 @@
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "1.63 20190618";
+static const char * version_str = "1.65 20261017";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_BLOCKS_PER_TRANSFER 128
@@ -270,8 +271,10 @@ usage()
             "               [--help] [--version]\n\n");
     pr2serr("               [bpt=BPT] [cdbsz=6|10|12|16] [dio=0|1] "
             "[fua=0|1|2|3]\n"
-            "               [sync=0|1] [time=0|1] [verbose=VERB] "
-            "[--dry-run] [--verbose]\n\n"
+            "               [hash=ALG[,THR]] [manifest=MFILE] [sync=0|1] "
+            "[time=0|1]\n"
+            "               [verbose=VERB] [verify=MFILE] [--dry-run] "
+            "[--verbose]\n\n"
             "  where:\n"
             "    bpt         is blocks_per_transfer (default is 128)\n"
             "    bs          must be device logical block size (default "
@@ -283,10 +286,15 @@ usage()
             "    fua         force unit access: 0->don't(def), 1->OFILE, "
             "2->IFILE,\n"
             "                3->OFILE+IFILE\n"
+            "    hash        hash data read with ALG: crc32c or xxh64, on "
+            "THR threads\n"
+            "                (def: 2); outputs stream hash (def: crc32c "
+            "if MFILE given)\n"
             "    if          file or device to read from (def: stdin)\n");
     pr2serr("    iflag       comma separated list from: [direct,dpo,dsync,"
             "excl,fua,\n"
             "                null]\n"
+            "    manifest    write hash of each BPT blocks read to MFILE\n"
             "    of          file or device to write to (def: stdout), "
             "OFILE of '.'\n"
             "                treated as /dev/null\n"
@@ -301,6 +309,8 @@ usage()
             "throughput\n"
             "    verbose     0->quiet(def), 1->some noise, 2->more noise, "
             "etc\n"
+            "    verify      check hashes against MFILE from earlier "
+            "manifest=MFILE\n"
             "    --dry-run|-d    prepare but bypass copy/read\n"
             "    --help|-h       print usage message then exit\n"
             "    --verbose|-v    increase verbosity\n"
@@ -717,6 +727,8 @@ main(int argc, char * argv[])
     bool version_given = false;
     int res, k, t, infd, outfd, blocks, n, flags, blocks_per, err, keylen;
     int bpt = DEF_BLOCKS_PER_TRANSFER;
+    int hash_alg = 0;
+    int hash_thr = 0;
     int ibs = 0;
     int in_res_sz = 0;
     int in_sect_sz;
@@ -733,15 +745,21 @@ main(int argc, char * argv[])
     int64_t in_num_sect = -1;
     int64_t out_num_sect = -1;
     int64_t skip = 0;
+    int64_t skip0;
     int64_t seek = 0;
     char * buf;
     char * key;
     uint8_t * wrkPos;
-    uint8_t * wrkBuff = NULL;
+    struct sg_buf_pool * buf_poolp = NULL;
+    struct sg_hash_stage * hash_stagep = NULL;
+    pthread_t hash_thr_arr[SG_HASH_MAX_THR];
+    int num_hash_thr = 0;
     uint8_t * wrkMmap = NULL;
     char inf[INOUTF_SZ];
     char str[STR_SZ];
     char outf[INOUTF_SZ];
+    char manf[INOUTF_SZ];
+    char verf[INOUTF_SZ];
     char ebuff[EBUFF_SZ];
     char b[80];
     struct flags_t in_flags;
@@ -754,6 +772,8 @@ main(int argc, char * argv[])
 #endif
     inf[0] = '\0';
     outf[0] = '\0';
+    manf[0] = '\0';
+    verf[0] = '\0';
     memset(&in_flags, 0, sizeof(in_flags));
     memset(&out_flags, 0, sizeof(out_flags));
 
@@ -803,6 +823,12 @@ main(int argc, char * argv[])
                 out_flags.fua = true;
             if (n & 2)
                 in_flags.fua = true;
+        } else if (0 == strcmp(key, "hash")) {
+            if (! sg_hash_parse(buf, &hash_alg, &hash_thr)) {
+                pr2serr(ME "bad argument to 'hash', expect crc32c or "
+                        "xxh64, optionally followed by ',THR'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"ibs")) {
             ibs = sg_get_num(buf);
             if (-1 == ibs) {
@@ -822,6 +848,9 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'iflag'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "manifest")) {
+            memcpy(manf, buf, INOUTF_SZ);
+            manf[INOUTF_SZ - 1] = '\0';
         } else if (strcmp(key,"of") == 0) {
             if ('\0' != outf[0]) {
                 pr2serr("Second 'of=' argument??\n");
@@ -859,7 +888,10 @@ main(int argc, char * argv[])
             do_time = sg_get_num(buf);
         else if (0 == strncmp(key, "verb", 4))
             verbose = sg_get_num(buf);
-        else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
+        else if (0 == strcmp(key, "verify")) {
+            memcpy(verf, buf, INOUTF_SZ);
+            verf[INOUTF_SZ - 1] = '\0';
+        } else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
             res = 0;
             n = num_chs_in_str(key + 1, keylen - 1, 'd');
             dry_run += n;
@@ -1275,8 +1307,9 @@ main(int argc, char * argv[])
     if (wrkMmap) {
         wrkPos = wrkMmap;
     } else {
-        wrkPos = (uint8_t *)sg_memalign(blk_sz * bpt, 0, &wrkBuff,
-                                        verbose > 3);
+        buf_poolp = sg_buf_pool_create(blk_sz * bpt, 1, SG_BUF_POOL_HUGE,
+                                       verbose);
+        wrkPos = buf_poolp ? sg_buf_pool_get(buf_poolp) : NULL;
         if (NULL == wrkPos) {
             pr2serr("Not enough user memory\n");
             return sg_convert_errno(ENOMEM);
@@ -1304,7 +1337,26 @@ main(int argc, char * argv[])
         pr2serr("Since both 'if' and 'of' are sg devices, only do mmap-ed "
                 "transfers on 'if'\n");
 
+    if (hash_alg || manf[0] || verf[0]) {
+        if (0 == hash_alg)
+            sg_hash_parse("crc32c", &hash_alg, &hash_thr);
+        hash_stagep = sg_hash_stage_create(hash_alg, hash_thr, blk_sz, bpt);
+        if (NULL == hash_stagep) {
+            pr2serr("Not enough user memory for hash stage\n");
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+        for (k = 0; k < hash_thr; ++k) {
+            if (pthread_create(hash_thr_arr + k, NULL, sg_hash_stage_worker,
+                               hash_stagep))
+                break;  /* submitters hash what workers can't */
+            ++num_hash_thr;
+        }
+    }
+    skip0 = skip;
     while (dd_count > 0) {
+        if (hash_stagep)    /* last chunk read may still be being hashed */
+            sg_hash_stage_wait(hash_stagep, wrkPos);
         blocks = (dd_count > blocks_per) ? blocks_per : dd_count;
         if (FT_SG == in_type) {
             ret = sg_read(infd, wrkPos, blocks, skip, blk_sz, scsi_cdbsz_in,
@@ -1344,6 +1396,8 @@ main(int argc, char * argv[])
                 if ((res % blk_sz) > 0) {
                     blocks++;
                     in_partial++;
+                    if (hash_stagep)    /* so hash is of what is written */
+                        memset(wrkPos + res, 0, (blocks * blk_sz) - res);
                 }
             }
             in_full += blocks;
@@ -1351,6 +1405,8 @@ main(int argc, char * argv[])
 
         if (0 == blocks)
             break;      /* read nothing so leave loop */
+        if (hash_stagep)
+            sg_hash_stage_submit(hash_stagep, skip - skip0, wrkPos, blocks);
 
         if (FT_SG == out_type) {
             bool dio_res = out_flags.dio;
@@ -1426,8 +1482,9 @@ main(int argc, char * argv[])
     }
 
 fini:
-    if (wrkBuff)
-        free(wrkBuff);
+    if (hash_stagep)    /* before the buffers are freed or unmapped */
+        sg_hash_stage_wait(hash_stagep, NULL);
+    sg_buf_pool_destroy(buf_poolp);
     if (STDIN_FILENO != infd)
         close(infd);
     if ((STDOUT_FILENO != outfd) && (FT_DEV_NULL != out_type))
@@ -1438,6 +1495,16 @@ fini:
             ret = SG_LIB_CAT_OTHER;
     }
     print_stats();
+    if (hash_stagep) {
+        sg_hash_stage_stop(hash_stagep);
+        for (k = 0; k < num_hash_thr; ++k)
+            pthread_join(hash_thr_arr[k], NULL);
+        res = sg_hash_stage_finish(hash_stagep, (manf[0] ? manf : NULL),
+                                   (verf[0] ? verf : NULL), verbose);
+        if (res && (0 == ret))
+            ret = res;
+        sg_hash_stage_destroy(hash_stagep);
+    }
     if (sum_of_resids)
         pr2serr(">> Non-zero sum of residual counts=%d\n", sum_of_resids);
     if (num_dio_not_done)
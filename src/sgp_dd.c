@@ -46,6 +46,8 @@
 #include <limits.h>
 #include <pthread.h>
 #include <signal.h>
+#include <sched.h>
+#include <time.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <sys/ioctl.h>
@@ -79,11 +81,12 @@
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_io_linux.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "5.73 20190618";
+static const char * version_str = "5.78 20261017";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_BLOCKS_PER_TRANSFER 128
@@ -130,6 +133,18 @@ struct flags_t {
     bool fua;
 };
 
+/* Writes to a pipe, stdout or an append mode OFILE must be in order. A
+ * worker deposits its buffer in the slot given by the sequence number of
+ * its transfer (i.e. (blk - skip) / bpt) modulo the window size. Whichever
+ * worker then wins the ro_busy flag writes out the run of full slots. */
+struct ro_slot {
+    uint8_t * buffp;
+    int64_t seq;
+    int64_t blk;                /* OFILE block address */
+    int num_blks;
+    bool full;                  /* set by depositor, cleared once written */
+};
+
 typedef struct request_collection
 {       /* one instance visible to all threads */
     int infd;
@@ -137,26 +152,39 @@ typedef struct request_collection
     int in_type;
     int cdbsz_in;
     struct flags_t in_flags;
-    int64_t in_blk;                 /* -\ next block address to read */
-    int64_t in_count;               /*  | blocks remaining for next read */
-    int64_t in_rem_count;           /*  | count of remaining in blocks */
-    int in_partial;                   /*  | */
-    bool in_stop;                     /*  | */
-    pthread_mutex_t in_mutex;         /* -/ */
+    int64_t in_blk;             /* next block address to claim, atomic */
+    int64_t in_end;             /* one past last block address to read */
+    int64_t in_rem_count;       /* count of remaining in blocks, atomic */
+    int in_partial;             /* atomic */
+    bool in_stop;               /* atomic */
+    bool in_pos;                /* seekable IFILE: pread() at block offset */
+    off64_t in_off;             /* IFILE offset of block 'skip' */
+    pthread_mutex_t in_mutex;   /* claim and read() when IFILE is a pipe */
     int outfd;
     int64_t seek;
     int out_type;
     int cdbsz_out;
     struct flags_t out_flags;
-    int64_t out_blk;                /* -\ next block address to write */
-    int64_t out_count;              /*  | blocks remaining for next write */
-    int64_t out_rem_count;          /*  | count of remaining out blocks */
-    int out_partial;                  /*  | */
-    bool out_stop;                    /*  | */
-    pthread_mutex_t out_mutex;        /*  | */
-    pthread_cond_t out_sync_cv;       /* -/ hold writes until "in order" */
+    int64_t out_count;          /* blocks remaining to write, atomic */
+    int64_t out_rem_count;      /* count of remaining out blocks, atomic */
+    int out_partial;            /* atomic */
+    bool out_stop;              /* atomic */
+    bool out_pos;               /* seekable OFILE: pwrite() at block offset */
+    off64_t out_off;            /* OFILE offset of block 'seek' */
+    struct ro_slot * ro_arr;    /* -\ reorder window when OFILE is not */
+    int ro_sz;                  /*  | sg, /dev/null nor seekable; ro_sz */
+    int64_t ro_next;            /*  | is a power of 2, ro_next the next */
+    bool ro_busy;               /* -/ sequence number to write, atomic */
+    bool numa_pin;              /* numa=1 and HBA local CPUs known */
+    int numa_node;              /* of that HBA, -1 if not known */
+    uint64_t cpu_mask[SG_CPU_MASK_WORDS];   /* HBA local CPUs */
+    bool started;               /* -\ first transfer done, hold other */
+    pthread_mutex_t start_mutex; /* | workers back until then */
+    pthread_cond_t start_cv;    /* -/ */
     int bs;
     int bpt;
+    struct sg_buf_pool * buf_poolp; /* one bs*bpt buffer per worker */
+    struct sg_hash_stage * hash_stagep; /* when hash= given */
     int dio_incomplete_count;   /* -\ */
     int sum_of_resids;          /*  | */
     pthread_mutex_t aux_mutex;  /* -/ (also serializes some printf()s */
@@ -172,7 +200,6 @@ typedef struct request_element
     int64_t blk;
     int num_blks;
     uint8_t * buffp;
-    uint8_t * alloc_bp;
     struct sg_io_hdr io_hdr;
     uint8_t cmd[MAX_SCSI_CDBSZ];
     uint8_t sb[SENSE_BUFF_LEN];
@@ -185,17 +212,31 @@ typedef struct request_element
     struct flags_t out_flags;
     int debug;
     uint32_t pack_id;
+    uint64_t start_ns;  /* when command tracing or latency histograms are
+                         * active: time command started, else 0 */
 } Rq_elem;
 
+struct numa_stats
+{       /* one instance per worker thread when numa=1 */
+    int cpu;                    /* CPU at the last transfer */
+    int node;
+    int64_t xfers;
+    int64_t local;              /* transfers with a buffer on 'node' */
+};
+
 static sigset_t signal_set;
 static pthread_t sig_listen_thread_id;
+static pthread_t log_drain_id;
+static pthread_t hash_thr_arr[SG_HASH_MAX_THR];
+static int num_hash_thr;
 
 static const char * proc_allow_dio = "/proc/scsi/sg/allow_dio";
 
 static void sg_in_operation(Rq_coll * clp, Rq_elem * rep);
 static void sg_out_operation(Rq_coll * clp, Rq_elem * rep);
 static bool normal_in_operation(Rq_coll * clp, Rq_elem * rep, int blocks);
-static void normal_out_operation(Rq_coll * clp, Rq_elem * rep, int blocks);
+static void normal_out_operation(Rq_coll * clp, uint8_t * bp, int64_t blk,
+                                 int blocks);
 static int sg_start_io(Rq_elem * rep);
 static int sg_finish_io(bool wr, Rq_elem * rep, pthread_mutex_t * a_mutp);
 
@@ -224,12 +265,13 @@ static int ascending_val = 1;
 
 #define STRERR_BUFF_LEN 128
 
-static pthread_mutex_t strerr_mut = PTHREAD_MUTEX_INITIALIZER;
-
 static pthread_t threads[MAX_NUM_THREADS];
+static struct numa_stats numa_stats_arr[MAX_NUM_THREADS];
+static int numa_next_id;
 
 static bool shutting_down = false;
 static bool do_sync = false;
+static bool do_numa = false;
 static bool do_time = false;
 static Rq_coll rcoll;
 static struct timeval start_tm;
@@ -334,15 +376,7 @@ thread_exit_handler(int sig)
 static char *
 tsafe_strerror(int code, char * ebp)
 {
-    char * cp;
-
-    pthread_mutex_lock(&strerr_mut);
-    cp = safe_strerror(code);
-    strncpy(ebp, cp, STRERR_BUFF_LEN);
-    pthread_mutex_unlock(&strerr_mut);
-
-    ebp[STRERR_BUFF_LEN - 1] = '\0';
-    return ebp;
+    return sg_strerror_r(code, ebp, STRERR_BUFF_LEN);
 }
 
 
@@ -392,8 +426,10 @@ usage()
             "               [--help] [--version]\n\n");
     pr2serr("               [bpt=BPT] [cdbsz=6|10|12|16] [coe=0|1] "
             "[deb=VERB] [dio=0|1]\n"
-            "               [fua=0|1|2|3] [sync=0|1] [thr=THR] "
-            "[time=0|1] [verbose=VERB]\n"
+            "               [fua=0|1|2|3] [hash=ALG[,THR]] [manifest=MFILE] "
+            "[numa=0|1]\n"
+            "               [sync=0|1] [thr=THR] [time=0|1] [verbose=VERB] "
+            "[verify=MFILE]\n"
             "               [--dry-run] [--verbose]\n"
             "  where:\n"
             "    bpt         is blocks_per_transfer (default is 128)\n"
@@ -409,10 +445,18 @@ usage()
             "    fua         force unit access: 0->don't(def), 1->OFILE, "
             "2->IFILE,\n"
             "                3->OFILE+IFILE\n"
+            "    hash        hash data read with ALG: crc32c or xxh64, on "
+            "THR threads\n"
+            "                (def: 2); outputs stream hash (def: crc32c "
+            "if MFILE given)\n"
             "    if          file or device to read from (def: stdin)\n"
             "    iflag       comma separated list from: [coe,dio,direct,dpo,"
             "dsync,excl,\n"
             "                fua, null]\n"
+            "    manifest    write hash of each BPT blocks read to MFILE\n"
+            "    numa        0->default placement (def), 1->bind workers to "
+            "the CPUs\n"
+            "                local to the HBA of IFILE (else OFILE)\n"
             "    of          file or device to write to (def: stdout), "
             "OFILE of '.'\n"
             "                treated as /dev/null\n"
@@ -428,6 +472,8 @@ usage()
             "    time        0->no timing(def), 1->time plus calculate "
             "throughput\n"
             "    verbose     same as 'deb=VERB': increase verbosity\n"
+            "    verify      check hashes against MFILE from earlier "
+            "manifest=MFILE\n"
             "    --dry-run|-d    prepare but bypass copy/read\n"
             "    --help|-h      output this usage message then exit\n"
             "    --verbose|-v   increase verbosity of utility\n"
@@ -437,26 +483,22 @@ usage()
 }
 
 static void
-guarded_stop_in(Rq_coll * clp)
+stop_in(Rq_coll * clp)
 {
-    pthread_mutex_lock(&clp->in_mutex);
-    clp->in_stop = true;
-    pthread_mutex_unlock(&clp->in_mutex);
+    __atomic_store_n(&clp->in_stop, true, __ATOMIC_RELEASE);
 }
 
 static void
-guarded_stop_out(Rq_coll * clp)
+stop_out(Rq_coll * clp)
 {
-    pthread_mutex_lock(&clp->out_mutex);
-    clp->out_stop = true;
-    pthread_mutex_unlock(&clp->out_mutex);
+    __atomic_store_n(&clp->out_stop, true, __ATOMIC_RELEASE);
 }
 
 static void
-guarded_stop_both(Rq_coll * clp)
+stop_both(Rq_coll * clp)
 {
-    guarded_stop_in(clp);
-    guarded_stop_out(clp);
+    stop_in(clp);
+    stop_out(clp);
 }
 
 /* Return of 0 -> success, see sg_ll_read_capacity*() otherwise */
@@ -536,35 +578,176 @@ sig_listen_thread(void * v_clp)
             break;
         if (SIGINT == sig_number) {
             pr2serr("%sinterrupted by SIGINT\n", my_name);
-            guarded_stop_both(clp);
-            pthread_cond_broadcast(&clp->out_sync_cv);
+            stop_both(clp);
         }
     }
     return NULL;
 }
 
 static void
-cleanup_in(void * v_clp)
+signal_started(Rq_coll * clp)
 {
-    Rq_coll * clp = (Rq_coll *)v_clp;
+    int status;
 
-    pr2serr("thread cancelled while in mutex held\n");
-    clp->in_stop = true;
-    pthread_mutex_unlock(&clp->in_mutex);
-    guarded_stop_out(clp);
-    pthread_cond_broadcast(&clp->out_sync_cv);
+    if (__atomic_load_n(&clp->started, __ATOMIC_ACQUIRE))
+        return;
+    status = pthread_mutex_lock(&clp->start_mutex);
+    if (0 != status) err_exit(status, "lock start_mutex");
+    __atomic_store_n(&clp->started, true, __ATOMIC_RELEASE);
+    status = pthread_cond_broadcast(&clp->start_cv);
+    if (0 != status) err_exit(status, "broadcast start_cv");
+    status = pthread_mutex_unlock(&clp->start_mutex);
+    if (0 != status) err_exit(status, "unlock start_mutex");
 }
 
+/* Back off while waiting for room in the reorder window: yield a few
+ * times then sleep briefly so waiters do not steal cycles from the
+ * thread writing. */
 static void
-cleanup_out(void * v_clp)
+ro_pause(int k)
 {
-    Rq_coll * clp = (Rq_coll *)v_clp;
+    struct timespec ts;
+
+    if (k < 16)
+        sched_yield();
+    else {
+        ts.tv_sec = 0;
+        ts.tv_nsec = 50000;
+        nanosleep(&ts, NULL);
+    }
+}
+
+/* Writes out, in order, the full slots starting at ro_next. Only one
+ * thread does this at a time; any other just returns as the thread that
+ * holds ro_busy will also write the slot just deposited. */
+static void
+ro_drain(Rq_coll * clp)
+{
+    bool busy;
+    int64_t seq;
+    struct ro_slot * sp;
+
+    while (1) {
+        busy = false;
+        if (! __atomic_compare_exchange_n(&clp->ro_busy, &busy, true, false,
+                                          __ATOMIC_SEQ_CST,
+                                          __ATOMIC_RELAXED))
+            return;
+        seq = __atomic_load_n(&clp->ro_next, __ATOMIC_RELAXED);
+        while (! __atomic_load_n(&clp->out_stop, __ATOMIC_ACQUIRE)) {
+            sp = clp->ro_arr + (seq & (clp->ro_sz - 1));
+            if ((! __atomic_load_n(&sp->full, __ATOMIC_SEQ_CST)) ||
+                (seq != sp->seq))
+                break;
+            if (sp->num_blks > 0) {
+                normal_out_operation(clp, sp->buffp, sp->blk, sp->num_blks);
+                /* on a write error normal_out_operation() has stopped us */
+                if (! __atomic_load_n(&clp->out_stop, __ATOMIC_ACQUIRE))
+                    __atomic_sub_fetch(&clp->out_count, sp->num_blks,
+                                       __ATOMIC_RELAXED);
+            }
+            if (clp->hash_stagep)   /* putting it in the pool writes to it */
+                sg_hash_stage_wait(clp->hash_stagep, sp->buffp);
+            sg_buf_pool_put(clp->buf_poolp, sp->buffp);
+            /* free the slot before the window moves past it */
+            __atomic_store_n(&sp->full, false, __ATOMIC_RELEASE);
+            __atomic_store_n(&clp->ro_next, ++seq, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&clp->ro_busy, false, __ATOMIC_SEQ_CST);
+        /* a deposit after the last check but before ro_busy was cleared
+         * would otherwise wait for the next deposit to be written */
+        sp = clp->ro_arr + (seq & (clp->ro_sz - 1));
+        if (__atomic_load_n(&clp->out_stop, __ATOMIC_ACQUIRE) ||
+            (! __atomic_load_n(&sp->full, __ATOMIC_SEQ_CST)) ||
+            (seq != sp->seq))
+            return;
+    }
+}
 
-    pr2serr("thread cancelled while out mutex held\n");
-    clp->out_stop = true;
-    pthread_mutex_unlock(&clp->out_mutex);
-    guarded_stop_in(clp);
-    pthread_cond_broadcast(&clp->out_sync_cv);
+/* Deposits the buffer of rep in the reorder window, taking a fresh one
+ * from the pool in its place, then writes out what is in order. */
+static void
+ro_put(Rq_coll * clp, Rq_elem * rep, int64_t seq)
+{
+    int k;
+    struct ro_slot * sp;
+
+    for (k = 0; seq >= (__atomic_load_n(&clp->ro_next, __ATOMIC_ACQUIRE) +
+                        clp->ro_sz); ++k) {
+        if (__atomic_load_n(&clp->out_stop, __ATOMIC_ACQUIRE))
+            return;
+        ro_pause(k);
+    }
+    sp = clp->ro_arr + (seq & (clp->ro_sz - 1));
+    sp->buffp = rep->buffp;
+    sp->seq = seq;
+    sp->blk = rep->blk;
+    sp->num_blks = rep->num_blks;
+    __atomic_store_n(&sp->full, true, __ATOMIC_SEQ_CST);
+    rep->buffp = sg_buf_pool_get(clp->buf_poolp);
+    if (NULL == rep->buffp)
+        err_exit(ENOMEM, "out of memory creating user buffers\n");
+    ro_drain(clp);
+}
+
+/* With numa=1, looks for the CPUs local to the HBA of IFILE and failing
+ * that of OFILE. Workers are then bound to those CPUs so they, and the
+ * buffers they touch first, are on the HBA's node. */
+static void
+numa_setup(Rq_coll * clp)
+{
+    int k, n;
+    const char * cp = "IFILE";
+
+    clp->numa_node = sg_get_fd_numa(clp->infd, clp->cpu_mask,
+                                    SG_CPU_MASK_WORDS, clp->debug);
+    for (k = 0, n = 0; k < SG_CPU_MASK_WORDS; ++k)
+        n += __builtin_popcountll(clp->cpu_mask[k]);
+    if ((0 == n) && (clp->outfd >= 0)) {
+        cp = "OFILE";
+        clp->numa_node = sg_get_fd_numa(clp->outfd, clp->cpu_mask,
+                                        SG_CPU_MASK_WORDS, clp->debug);
+        for (k = 0, n = 0; k < SG_CPU_MASK_WORDS; ++k)
+            n += __builtin_popcountll(clp->cpu_mask[k]);
+    }
+    if (n > 0) {
+        clp->numa_pin = true;
+        if (clp->debug)
+            pr2serr("numa: bind workers to the %d CPUs local to the %s "
+                    "HBA (node %d)\n", n, cp, clp->numa_node);
+    } else
+        pr2serr("numa=1: HBA local CPUs of IFILE and OFILE not known, "
+                "workers not bound\n");
+}
+
+/* Counts a transfer, noting if its buffer is on this worker's node */
+static void
+numa_account(struct numa_stats * nsp, const uint8_t * bp)
+{
+    nsp->node = sg_get_thread_numa(&nsp->cpu);
+    ++nsp->xfers;
+    if ((nsp->node >= 0) && (nsp->node == sg_get_addr_numa(bp)))
+        ++nsp->local;
+}
+
+static void
+numa_report(const Rq_coll * clp)
+{
+    int k;
+    int64_t xfers = 0;
+    int64_t local = 0;
+    const struct numa_stats * nsp;
+
+    for (k = 0, nsp = numa_stats_arr; k < numa_next_id; ++k, ++nsp) {
+        if (clp->debug)
+            pr2serr("  worker %d: cpu=%d node=%d, %" PRId64 " of %" PRId64
+                    " transfers with node local buffer\n", k, nsp->cpu,
+                    nsp->node, nsp->local, nsp->xfers);
+        xfers += nsp->xfers;
+        local += nsp->local;
+    }
+    pr2serr(">> numa: %" PRId64 " of %" PRId64 " transfers with buffer on "
+            "the worker's node\n", local, xfers);
 }
 
 static void *
@@ -573,16 +756,28 @@ read_write_thread(void * v_clp)
     Rq_coll * clp;
     Rq_elem rel;
     Rq_elem * rep = &rel;
-    int sz;
-    volatile bool stop_after_write = false;
-    int64_t seek_skip;
+    struct numa_stats * nsp = NULL;
+    bool in_locked;
+    bool stop_after_write = false;
+    int64_t seek_skip, blk;
     int blocks, status;
 
     clp = (Rq_coll *)v_clp;
-    sz = clp->bpt * clp->bs;
     seek_skip =  clp->seek - clp->skip;
     memset(rep, 0, sizeof(Rq_elem));
-    rep->buffp = sg_memalign(sz, 0 /* page align */, &rep->alloc_bp, false);
+    if (do_numa) {
+        nsp = numa_stats_arr + __atomic_fetch_add(&numa_next_id, 1,
+                                                  __ATOMIC_RELAXED);
+        /* bind before the first buffer is touched so it is node local */
+        if (clp->numa_pin &&
+            (status = sg_set_thread_cpus(clp->cpu_mask, SG_CPU_MASK_WORDS))) {
+            char strerr_buff[STRERR_BUFF_LEN];
+
+            pr2serr("%sunable to bind worker to HBA local CPUs: %s\n",
+                    my_name, tsafe_strerror(status, strerr_buff));
+        }
+    }
+    rep->buffp = sg_buf_pool_get(clp->buf_poolp);
     if (NULL == rep->buffp)
         err_exit(ENOMEM, "out of memory creating user buffers\n");
 
@@ -595,100 +790,88 @@ read_write_thread(void * v_clp)
     rep->cdbsz_out = clp->cdbsz_out;
     rep->in_flags = clp->in_flags;
     rep->out_flags = clp->out_flags;
+    /* only a pipe (or stdin) needs its claim and read() kept together */
+    in_locked = (FT_SG != clp->in_type) && (! clp->in_pos);
 
     while(1) {
-        status = pthread_mutex_lock(&clp->in_mutex);
-        if (0 != status) err_exit(status, "lock in_mutex");
-        if (clp->in_stop || (clp->in_count <= 0)) {
+        if (clp->hash_stagep)   /* buffer may still be being hashed */
+            sg_hash_stage_wait(clp->hash_stagep, rep->buffp);
+        if (in_locked) {
+            status = pthread_mutex_lock(&clp->in_mutex);
+            if (0 != status) err_exit(status, "lock in_mutex");
+        }
+        if (__atomic_load_n(&clp->in_stop, __ATOMIC_ACQUIRE) ||
+            ((blk = __atomic_fetch_add(&clp->in_blk, clp->bpt,
+                                       __ATOMIC_RELAXED)) >= clp->in_end)) {
             /* no more to do, exit loop then thread */
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock in_mutex");
+            if (in_locked) {
+                status = pthread_mutex_unlock(&clp->in_mutex);
+                if (0 != status) err_exit(status, "unlock in_mutex");
+            }
             break;
         }
-        blocks = (clp->in_count > clp->bpt) ? clp->bpt : clp->in_count;
+        blocks = ((clp->in_end - blk) > clp->bpt) ? clp->bpt :
+                                                    (clp->in_end - blk);
         rep->wr = false;
-        rep->blk = clp->in_blk;
+        rep->blk = blk;
         rep->num_blks = blocks;
-        clp->in_blk += blocks;
-        clp->in_count -= blocks;
 
-        pthread_cleanup_push(cleanup_in, (void *)clp);
         if (FT_SG == clp->in_type)
-            sg_in_operation(clp, rep); /* lets go of in_mutex mid operation */
+            sg_in_operation(clp, rep);
         else {
             stop_after_write = normal_in_operation(clp, rep, blocks);
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock in_mutex");
-        }
-        pthread_cleanup_pop(0);
-
-        status = pthread_mutex_lock(&clp->out_mutex);
-        if (0 != status) err_exit(status, "lock out_mutex");
-        if (FT_DEV_NULL != clp->out_type) {
-            while ((! clp->out_stop) &&
-                   ((rep->blk + seek_skip) != clp->out_blk)) {
-                /* if write would be out of sequence then wait */
-                pthread_cleanup_push(cleanup_out, (void *)clp);
-                status = pthread_cond_wait(&clp->out_sync_cv, &clp->out_mutex);
-                if (0 != status) err_exit(status, "cond out_sync_cv");
-                pthread_cleanup_pop(0);
+            if (in_locked) {
+                status = pthread_mutex_unlock(&clp->in_mutex);
+                if (0 != status) err_exit(status, "unlock in_mutex");
             }
         }
-
-        if (clp->out_stop || (clp->out_count <= 0)) {
-            if (! clp->out_stop)
-                clp->out_stop = true;
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
+        if (__atomic_load_n(&clp->out_stop, __ATOMIC_ACQUIRE))
             break;
-        }
-        if (stop_after_write)
-            clp->out_stop = true;
-        rep->wr = true;
-        rep->blk = clp->out_blk;
-        clp->out_blk += blocks;
-        clp->out_count -= blocks;
-
-        if (0 == rep->num_blks) {
-            clp->out_stop = true;
-            stop_after_write = true;
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
-            break;      /* read nothing so leave loop */
+        if (0 == rep->num_blks)
+            stop_after_write = true;    /* read nothing */
+        else {
+            if (nsp)
+                numa_account(nsp, rep->buffp);
+            if (clp->hash_stagep)
+                sg_hash_stage_submit(clp->hash_stagep, blk - clp->skip,
+                                     rep->buffp, rep->num_blks);
         }
 
-        pthread_cleanup_push(cleanup_out, (void *)clp);
-        if (FT_SG == clp->out_type)
-            sg_out_operation(clp, rep); /* releases out_mutex mid operation */
-        else if (FT_DEV_NULL == clp->out_type) {
+        rep->wr = true;
+        rep->blk = blk + seek_skip;
+        if (FT_SG == clp->out_type) {
+            if (rep->num_blks > 0)
+                sg_out_operation(clp, rep);
+        } else if (FT_DEV_NULL == clp->out_type)
             /* skip actual write operation */
-            clp->out_rem_count -= blocks;
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
-        }
-        else {
-            normal_out_operation(clp, rep, blocks);
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
-        }
-        pthread_cleanup_pop(0);
+            __atomic_sub_fetch(&clp->out_rem_count, rep->num_blks,
+                               __ATOMIC_RELAXED);
+        else if (clp->out_pos) {
+            if (rep->num_blks > 0)
+                normal_out_operation(clp, rep->buffp, rep->blk,
+                                     rep->num_blks);
+        } else  /* empty transfers too, they keep the sequence */
+            ro_put(clp, rep, (blk - clp->skip) / clp->bpt);
+        /* when reordered, ro_drain() counts blocks once they are written */
+        if ((NULL == clp->ro_arr) &&
+            (! __atomic_load_n(&clp->out_stop, __ATOMIC_ACQUIRE)))
+            __atomic_sub_fetch(&clp->out_count, rep->num_blks,
+                               __ATOMIC_RELAXED);
 
         if (stop_after_write)
             break;
-        pthread_cond_broadcast(&clp->out_sync_cv);
+        signal_started(clp);
     } /* end of while loop */
-    if (rep->alloc_bp)
-        free(rep->alloc_bp);
-    status = pthread_mutex_lock(&clp->in_mutex);
-    if (0 != status) err_exit(status, "lock in_mutex");
-    if (! clp->in_stop)
-        clp->in_stop = true;  /* flag other workers to stop */
-    status = pthread_mutex_unlock(&clp->in_mutex);
-    if (0 != status) err_exit(status, "unlock in_mutex");
-    pthread_cond_broadcast(&clp->out_sync_cv);
+    if (clp->hash_stagep)       /* putting it in the pool writes to it */
+        sg_hash_stage_wait(clp->hash_stagep, rep->buffp);
+    sg_buf_pool_put(clp->buf_poolp, rep->buffp);
+    stop_in(clp);       /* flag other workers to stop */
+    signal_started(clp);
     return stop_after_write ? NULL : clp;
 }
 
+/* Returns true when fewer than 'blocks' were read, so this is the last
+ * transfer. Called holding in_mutex when IFILE is not seekable. */
 static bool
 normal_in_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
 {
@@ -696,10 +879,19 @@ normal_in_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
     int res;
     char strerr_buff[STRERR_BUFF_LEN];
 
-    /* enters holding in_mutex */
-    while (((res = read(clp->infd, rep->buffp, blocks * clp->bs)) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    if (clp->in_pos) {
+        off64_t off = clp->in_off +
+                      ((off64_t)(rep->blk - clp->skip) * clp->bs);
+
+        while (((res = pread64(clp->infd, rep->buffp, blocks * clp->bs,
+                               off)) < 0) &&
+               ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+    } else {
+        while (((res = read(clp->infd, rep->buffp, blocks * clp->bs)) < 0) &&
+               ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+    }
     if (res < 0) {
         if (clp->in_flags.coe) {
             memset(rep->buffp, 0, rep->num_blks * rep->bs);
@@ -712,52 +904,56 @@ normal_in_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
         else {
             pr2serr("error in normal read, %s\n",
                     tsafe_strerror(errno, strerr_buff));
-            clp->in_stop = true;
-            guarded_stop_out(clp);
-            return 1;
+            stop_both(clp);
+            return true;
         }
     }
     if (res < blocks * clp->bs) {
-        int o_blocks = blocks;
         stop_after_write = true;
+        stop_in(clp);
         blocks = res / clp->bs;
         if ((res % clp->bs) > 0) {
             blocks++;
-            clp->in_partial++;
+            __atomic_add_fetch(&clp->in_partial, 1, __ATOMIC_RELAXED);
+            if (clp->hash_stagep)   /* so hash is of what is written */
+                memset(rep->buffp + res, 0, (blocks * clp->bs) - res);
         }
-        /* Reverse out + re-apply blocks on clp */
-        clp->in_blk -= o_blocks;
-        clp->in_count += o_blocks;
         rep->num_blks = blocks;
-        clp->in_blk += blocks;
-        clp->in_count -= blocks;
     }
-    clp->in_rem_count -= blocks;
+    __atomic_sub_fetch(&clp->in_rem_count, blocks, __ATOMIC_RELAXED);
     return stop_after_write;
 }
 
+/* Writes 'blocks' from 'bp' to OFILE block address 'blk'. Either OFILE
+ * is seekable or this is the thread draining the reorder window. */
 static void
-normal_out_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
+normal_out_operation(Rq_coll * clp, uint8_t * bp, int64_t blk, int blocks)
 {
     int res;
     char strerr_buff[STRERR_BUFF_LEN];
 
-    /* enters holding out_mutex */
-    while (((res = write(clp->outfd, rep->buffp, rep->num_blks * clp->bs))
-            < 0) && ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    if (clp->out_pos) {
+        off64_t off = clp->out_off + ((off64_t)(blk - clp->seek) * clp->bs);
+
+        while (((res = pwrite64(clp->outfd, bp, blocks * clp->bs, off)) < 0)
+               && ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+    } else {
+        while (((res = write(clp->outfd, bp, blocks * clp->bs)) < 0) &&
+               ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+    }
     if (res < 0) {
         if (clp->out_flags.coe) {
             pr2serr(">> ignored error for out blk=%" PRId64 " for %d bytes, "
-                    "%s\n", rep->blk, rep->num_blks * rep->bs,
+                    "%s\n", blk, blocks * clp->bs,
                     tsafe_strerror(errno, strerr_buff));
-            res = rep->num_blks * clp->bs;
+            res = blocks * clp->bs;
         }
         else {
             pr2serr("error normal write, %s\n",
                     tsafe_strerror(errno, strerr_buff));
-            guarded_stop_in(clp);
-            clp->out_stop = true;
+            stop_both(clp);
             return;
         }
     }
@@ -765,11 +961,10 @@ normal_out_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
         blocks = res / clp->bs;
         if ((res % clp->bs) > 0) {
             blocks++;
-            clp->out_partial++;
+            __atomic_add_fetch(&clp->out_partial, 1, __ATOMIC_RELAXED);
         }
-        rep->num_blks = blocks;
     }
-    clp->out_rem_count -= blocks;
+    __atomic_sub_fetch(&clp->out_rem_count, blocks, __ATOMIC_RELAXED);
 }
 
 static int
@@ -848,7 +1043,6 @@ sg_in_operation(Rq_coll * clp, Rq_elem * rep)
     int res;
     int status;
 
-    /* enters holding in_mutex */
     while (1) {
         res = sg_start_io(rep);
         if (1 == res)
@@ -856,31 +1050,22 @@ sg_in_operation(Rq_coll * clp, Rq_elem * rep)
         else if (res < 0) {
             pr2serr("%sinputting to sg failed, blk=%" PRId64 "\n", my_name,
                     rep->blk);
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock in_mutex");
-            guarded_stop_both(clp);
+            stop_both(clp);
             return;
         }
-        /* Now release in mutex to let other reads run in parallel */
-        status = pthread_mutex_unlock(&clp->in_mutex);
-        if (0 != status) err_exit(status, "unlock in_mutex");
-
         res = sg_finish_io(rep->wr, rep, &clp->aux_mutex);
         switch (res) {
         case SG_LIB_CAT_ABORTED_COMMAND:
         case SG_LIB_CAT_UNIT_ATTENTION:
             /* try again with same addr, count info */
-            /* now re-acquire in mutex for balance */
             /* N.B. This re-read could now be out of read sequence */
-            status = pthread_mutex_lock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "lock in_mutex");
             break;
         case SG_LIB_CAT_MEDIUM_HARD:
             if (0 == clp->in_flags.coe) {
                 pr2serr("error finishing sg in command (medium)\n");
                 if (exit_status <= 0)
                     exit_status = res;
-                guarded_stop_both(clp);
+                stop_both(clp);
                 return;
             } else {
                 memset(rep->buffp, 0, rep->num_blks * rep->bs);
@@ -902,17 +1087,14 @@ sg_in_operation(Rq_coll * clp, Rq_elem * rep)
                 status = pthread_mutex_unlock(&clp->aux_mutex);
                 if (0 != status) err_exit(status, "unlock aux_mutex");
             }
-            status = pthread_mutex_lock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "lock in_mutex");
-            clp->in_rem_count -= rep->num_blks;
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock in_mutex");
+            __atomic_sub_fetch(&clp->in_rem_count, rep->num_blks,
+                               __ATOMIC_RELAXED);
             return;
         default:
             pr2serr("error finishing sg in command (%d)\n", res);
             if (exit_status <= 0)
                 exit_status = res;
-            guarded_stop_both(clp);
+            stop_both(clp);
             return;
         }
     }
@@ -924,7 +1106,6 @@ sg_out_operation(Rq_coll * clp, Rq_elem * rep)
     int res;
     int status;
 
-    /* enters holding out_mutex */
     while (1) {
         res = sg_start_io(rep);
         if (1 == res)
@@ -932,31 +1113,22 @@ sg_out_operation(Rq_coll * clp, Rq_elem * rep)
         else if (res < 0) {
             pr2serr("%soutputting from sg failed, blk=%" PRId64 "\n",
                     my_name, rep->blk);
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
-            guarded_stop_both(clp);
+            stop_both(clp);
             return;
         }
-        /* Now release in mutex to let other reads run in parallel */
-        status = pthread_mutex_unlock(&clp->out_mutex);
-        if (0 != status) err_exit(status, "unlock out_mutex");
-
         res = sg_finish_io(rep->wr, rep, &clp->aux_mutex);
         switch (res) {
         case SG_LIB_CAT_ABORTED_COMMAND:
         case SG_LIB_CAT_UNIT_ATTENTION:
             /* try again with same addr, count info */
-            /* now re-acquire out mutex for balance */
             /* N.B. This re-write could now be out of write sequence */
-            status = pthread_mutex_lock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "lock out_mutex");
             break;
         case SG_LIB_CAT_MEDIUM_HARD:
             if (0 == clp->out_flags.coe) {
                 pr2serr("error finishing sg out command (medium)\n");
                 if (exit_status <= 0)
                     exit_status = res;
-                guarded_stop_both(clp);
+                stop_both(clp);
                 return;
             } else
                 pr2serr(">> ignored error for out blk=%" PRId64 " for %d "
@@ -976,17 +1148,14 @@ sg_out_operation(Rq_coll * clp, Rq_elem * rep)
                 status = pthread_mutex_unlock(&clp->aux_mutex);
                 if (0 != status) err_exit(status, "unlock aux_mutex");
             }
-            status = pthread_mutex_lock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "lock out_mutex");
-            clp->out_rem_count -= rep->num_blks;
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
+            __atomic_sub_fetch(&clp->out_rem_count, rep->num_blks,
+                               __ATOMIC_RELAXED);
             return;
         default:
             pr2serr("error finishing sg out command (%d)\n", res);
             if (exit_status <= 0)
                 exit_status = res;
-            guarded_stop_both(clp);
+            stop_both(clp);
             return;
         }
     }
@@ -1028,6 +1197,8 @@ sg_start_io(Rq_elem * rep)
                rep->wr ? "WRITE" : "READ", rep->blk, rep->num_blks);
         sg_print_command(hp->cmdp);
     }
+    rep->start_ns = (sg_pt_trace_active() || sg_pt_lat_hist_active()) ?
+                    sg_pt_trace_now_ns() : 0;
 
     while (((res = write(rep->wr ? rep->outfd : rep->infd, hp,
                          sizeof(struct sg_io_hdr))) < 0) &&
@@ -1073,6 +1244,12 @@ sg_finish_io(bool wr, Rq_elem * rep, pthread_mutex_t * a_mutp)
         err_exit(0, "sg_finish_io: bad usr_ptr, request-response mismatch\n");
     memcpy(&rep->io_hdr, &io_hdr, sizeof(struct sg_io_hdr));
     hp = &rep->io_hdr;
+    if (rep->start_ns) {
+        if (sg_pt_lat_hist_active())
+            sg_pt_lat_hist_add(SG_PT_LAT_SCSI, rep->cmd[0],
+                               sg_pt_trace_now_ns() - rep->start_ns);
+        sg_pt_trace_v3(hp, rep->start_ns, 0);
+    }
 
     res = sg_err_category3(hp);
     switch (res) {
@@ -1216,6 +1393,10 @@ main(int argc, char * argv[])
     char * buf;
     char inf[INOUTF_SZ];
     char outf[INOUTF_SZ];
+    char manf[INOUTF_SZ];
+    char verf[INOUTF_SZ];
+    int hash_alg = 0;
+    int hash_thr = 0;
     int res, k, err, keylen;
     int64_t in_num_sect = 0;
     int64_t out_num_sect = 0;
@@ -1240,6 +1421,8 @@ main(int argc, char * argv[])
     clp->cdbsz_out = DEF_SCSI_CDBSZ;
     inf[0] = '\0';
     outf[0] = '\0';
+    manf[0] = '\0';
+    verf[0] = '\0';
 
     for (k = 1; k < argc; k++) {
         if (argv[k]) {
@@ -1293,6 +1476,12 @@ main(int argc, char * argv[])
                 clp->out_flags.fua = true;
             if (n & 2)
                 clp->in_flags.fua = true;
+        } else if (0 == strcmp(key,"hash")) {
+            if (! sg_hash_parse(buf, &hash_alg, &hash_thr)) {
+                pr2serr("%sbad argument to 'hash=', expect crc32c or "
+                        "xxh64, optionally followed by ',THR'\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"ibs")) {
             ibs = sg_get_num(buf);
             if (-1 == ibs) {
@@ -1312,7 +1501,12 @@ main(int argc, char * argv[])
                 pr2serr("%sbad argument to 'iflag='\n", my_name);
                 return SG_LIB_SYNTAX_ERROR;
             }
-        } else if (0 == strcmp(key,"obs")) {
+        } else if (0 == strcmp(key,"manifest")) {
+            memcpy(manf, buf, INOUTF_SZ - 1);
+            manf[INOUTF_SZ - 1] = '\0';
+        } else if (0 == strcmp(key,"numa"))
+            do_numa = !! sg_get_num(buf);
+        else if (0 == strcmp(key,"obs")) {
             obs = sg_get_num(buf);
             if (-1 == obs) {
                 pr2serr("%sbad argument to 'obs='\n", my_name);
@@ -1349,7 +1543,10 @@ main(int argc, char * argv[])
             num_threads = sg_get_num(buf);
         else if (0 == strcmp(key,"time"))
             do_time = !! sg_get_num(buf);
-        else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
+        else if (0 == strcmp(key,"verify")) {
+            memcpy(verf, buf, INOUTF_SZ - 1);
+            verf[INOUTF_SZ - 1] = '\0';
+        } else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
             res = 0;
             n = num_chs_in_str(key + 1, keylen - 1, 'd');
             clp->dry_run += n;
@@ -1690,22 +1887,48 @@ main(int argc, char * argv[])
         }
     }
 
-    clp->in_count = dd_count;
     clp->in_rem_count = dd_count;
     clp->skip = skip;
     clp->in_blk = skip;
+    clp->in_end = skip + dd_count;
     clp->out_count = dd_count;
     clp->out_rem_count = dd_count;
     clp->seek = seek;
-    clp->out_blk = seek;
+    /* Seekable files are read and written at the offset of each block so
+     * workers need not take turns. Only a pipe, stdout or an append mode
+     * OFILE must be written in order, via the reorder window. */
+    if (FT_SG != clp->in_type) {
+        clp->in_off = lseek64(clp->infd, 0, SEEK_CUR);
+        clp->in_pos = (clp->in_off >= 0);
+    }
+    if ((FT_SG != clp->out_type) && (FT_DEV_NULL != clp->out_type)) {
+        if (! clp->out_flags.append) {
+            clp->out_off = lseek64(clp->outfd, 0, SEEK_CUR);
+            clp->out_pos = (clp->out_off >= 0);
+        }
+        if (! clp->out_pos) {
+            for (clp->ro_sz = 2; clp->ro_sz < (2 * num_threads); )
+                clp->ro_sz <<= 1;
+            clp->ro_arr = (struct ro_slot *)calloc(clp->ro_sz,
+                                                   sizeof(struct ro_slot));
+            if (NULL == clp->ro_arr)
+                err_exit(ENOMEM, "out of memory creating reorder window\n");
+        }
+    }
+    if (clp->debug > 1)
+        pr2serr("IFILE %s, OFILE %s\n", clp->in_pos ? "positional" :
+                "sequential", clp->out_pos ? "positional" :
+                (clp->ro_arr ? "reordered" : "direct"));
+    if (do_numa)
+        numa_setup(clp);
     status = pthread_mutex_init(&clp->in_mutex, NULL);
     if (0 != status) err_exit(status, "init in_mutex");
-    status = pthread_mutex_init(&clp->out_mutex, NULL);
-    if (0 != status) err_exit(status, "init out_mutex");
+    status = pthread_mutex_init(&clp->start_mutex, NULL);
+    if (0 != status) err_exit(status, "init start_mutex");
     status = pthread_mutex_init(&clp->aux_mutex, NULL);
     if (0 != status) err_exit(status, "init aux_mutex");
-    status = pthread_cond_init(&clp->out_sync_cv, NULL);
-    if (0 != status) err_exit(status, "init out_sync_cv");
+    status = pthread_cond_init(&clp->start_cv, NULL);
+    if (0 != status) err_exit(status, "init start_cv");
 
     if (clp->dry_run > 0) {
         pr2serr("Due to --dry-run option, bypass copy/read\n");
@@ -1719,6 +1942,21 @@ main(int argc, char * argv[])
                             sig_listen_thread, (void *)clp);
     if (0 != status) err_exit(status, "pthread_create, sig...");
 
+    if (hash_alg || manf[0] || verf[0]) {
+        /* workers created after SIGINT blocked so they inherit that */
+        if (0 == hash_alg)
+            sg_hash_parse("crc32c", &hash_alg, &hash_thr);
+        clp->hash_stagep = sg_hash_stage_create(hash_alg, hash_thr, clp->bs,
+                                                clp->bpt);
+        if (NULL == clp->hash_stagep)
+            err_exit(ENOMEM, "out of memory creating hash stage\n");
+        for (k = 0; k < hash_thr; ++k) {
+            status = pthread_create(hash_thr_arr + k, NULL,
+                                    sg_hash_stage_worker, clp->hash_stagep);
+            if (0 != status) err_exit(status, "pthread_create, hash");
+        }
+        num_hash_thr = hash_thr;
+    }
     if (do_time) {
         start_tm.tv_sec = 0;
         start_tm.tv_usec = 0;
@@ -1727,22 +1965,35 @@ main(int argc, char * argv[])
 
 /* vvvvvvvvvvv  Start worker threads  vvvvvvvvvvvvvvvvvvvvvvvv */
     if ((clp->out_rem_count > 0) && (num_threads > 0)) {
+        /* workers log to per thread rings, drained by another thread */
+        status = sg_log_ring_start(0, (clp->debug > 2) ?
+                                   (SG_LOG_RING_TS | SG_LOG_RING_TID) : 0);
+        if (0 != status) err_exit(ENOMEM, "sg_log_ring_start");
+        status = pthread_create(&log_drain_id, NULL, sg_log_ring_drain_loop,
+                                NULL);
+        if (0 != status) err_exit(status, "pthread_create, log drain");
+        /* each worker touches its buffer first so, with NUMA, it is local */
+        clp->buf_poolp = sg_buf_pool_create(clp->bpt * clp->bs, num_threads,
+                                            SG_BUF_POOL_HUGE |
+                                            SG_BUF_POOL_NUMA, clp->debug);
+        if (NULL == clp->buf_poolp)
+            err_exit(ENOMEM, "out of memory creating buffer pool\n");
         /* Run 1 work thread to shake down infant retryable stuff */
-        status = pthread_mutex_lock(&clp->out_mutex);
-        if (0 != status) err_exit(status, "lock out_mutex");
         status = pthread_create(&threads[0], NULL, read_write_thread,
                                 (void *)clp);
         if (0 != status) err_exit(status, "pthread_create");
         if (clp->debug)
             pr2serr("Starting worker thread k=0\n");
 
-        /* wait for any broadcast */
-        pthread_cleanup_push(cleanup_out, (void *)clp);
-        status = pthread_cond_wait(&clp->out_sync_cv, &clp->out_mutex);
-        if (0 != status) err_exit(status, "cond out_sync_cv");
-        pthread_cleanup_pop(0);
-        status = pthread_mutex_unlock(&clp->out_mutex);
-        if (0 != status) err_exit(status, "unlock out_mutex");
+        /* wait until its first transfer is done (or it has exited) */
+        status = pthread_mutex_lock(&clp->start_mutex);
+        if (0 != status) err_exit(status, "lock start_mutex");
+        while (! clp->started) {
+            status = pthread_cond_wait(&clp->start_cv, &clp->start_mutex);
+            if (0 != status) err_exit(status, "cond start_cv");
+        }
+        status = pthread_mutex_unlock(&clp->start_mutex);
+        if (0 != status) err_exit(status, "unlock start_mutex");
 
         /* now start the rest of the threads */
         for (k = 1; k < num_threads; ++k) {
@@ -1760,6 +2011,14 @@ main(int argc, char * argv[])
             if (clp->debug)
                 pr2serr("Worker thread k=%d terminated\n", k);
         }
+        sg_log_ring_stop();
+        pthread_join(log_drain_id, NULL);
+        if (clp->hash_stagep)
+            sg_hash_stage_wait(clp->hash_stagep, NULL);
+        sg_buf_pool_destroy(clp->buf_poolp);
+        clp->buf_poolp = NULL;
+        if (do_numa)
+            numa_report(clp);
     }   /* started worker threads and here after they have all exited */
 
     if (do_time && (start_tm.tv_sec || start_tm.tv_usec))
@@ -1802,6 +2061,8 @@ fini:
         close(clp->infd);
     if ((STDOUT_FILENO != clp->outfd) && (FT_DEV_NULL != clp->out_type))
         close(clp->outfd);
+    free(clp->ro_arr);
+    clp->ro_arr = NULL;
     res = exit_status;
     if ((0 != clp->out_count) && (0 == clp->dry_run)) {
         pr2serr(">>>> Some error occurred, remaining blocks=%" PRId64 "\n",
@@ -1810,6 +2071,19 @@ fini:
             res = SG_LIB_CAT_OTHER;
     }
     print_stats("");
+    if (clp->hash_stagep) {
+        sg_hash_stage_stop(clp->hash_stagep);
+        for (k = 0; k < num_hash_thr; ++k) {
+            status = pthread_join(hash_thr_arr[k], NULL);
+            if (0 != status) err_exit(status, "pthread_join, hash");
+        }
+        k = sg_hash_stage_finish(clp->hash_stagep, (manf[0] ? manf : NULL),
+                                 (verf[0] ? verf : NULL), clp->debug);
+        if (k && (0 == res))
+            res = k;
+        sg_hash_stage_destroy(clp->hash_stagep);
+        clp->hash_stagep = NULL;
+    }
     if (clp->dio_incomplete_count) {
         int fd;
         char c;
@@ -0,0 +1,595 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This program re-issues the commands held in a trace file, as captured
+ * by this package's library when the SG3_UTILS_TRACE environment variable
+ * is set, against another device. The commands can be sent with their
+ * original timing, with that timing scaled, or as fast as possible. Several
+ * threads can be used so that commands overlap as they did in the trace.
+ * The trace record format is described in ../include/sg_io_linux.h .
+ *
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <getopt.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_pt.h"
+#include "sg_io_linux.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+static const char * version_str = "1.00 20261017";
+
+
+#define ME "sg_replay: "
+
+#define SENSE_BUFF_LEN 64
+#define DEF_TIMEOUT_SECS 60
+#define MAX_JOBS 1024
+
+struct rp_cmd {                 /* one per command record in trace */
+    int ord;                    /* position in trace file */
+    uint64_t abs_ns;            /* realtime when command was started */
+    struct sg_pt_trace_rec r;
+};
+
+struct opts_t;
+
+struct rp_job {                 /* one per replay thread */
+    int id;
+    struct opts_t * op;
+    pthread_t thr;
+    int issued;
+    int skipped;
+    int errs;
+    int stat_diff;
+    int hash_diff;
+    uint64_t lat_sum_us;
+    uint64_t lat_max_us;
+    uint64_t lag_max_us;
+};
+
+struct opts_t {
+    bool do_dump;
+    bool do_verify;
+    bool do_write;
+    int jobs;
+    int timeout;
+    int vb;
+    double scale;               /* 0.0 -> as fast as possible */
+    int dev_fd;
+    int num_cmds;
+    struct rp_cmd * cmds;
+    uint64_t t0_ns;             /* monotonic time that replay started */
+};
+
+static int next_cmd_idx;
+
+
+static struct option long_options[] = {
+    {"dump", no_argument, 0, 'd'},
+    {"help", no_argument, 0, 'h'},
+    {"jobs", required_argument, 0, 'j'},
+    {"no-timing", no_argument, 0, 'n'},
+    {"no_timing", no_argument, 0, 'n'},
+    {"scale", required_argument, 0, 's'},
+    {"timeout", required_argument, 0, 't'},
+    {"verbose", no_argument, 0, 'v'},
+    {"verify", no_argument, 0, 'c'},
+    {"version", no_argument, 0, 'V'},
+    {"write", no_argument, 0, 'w'},
+    {0, 0, 0, 0},
+};
+
+static void
+usage(void)
+{
+    pr2serr("Usage: sg_replay [--dump] [--help] [--jobs=J] [--no-timing] "
+            "[--scale=S]\n"
+            "                 [--timeout=SECS] [--verbose] [--verify] "
+            "[--version]\n"
+            "                 [--write] TRACE_FILE [DEVICE]\n"
+            "  where:\n"
+            "    --dump|-d        decode and print TRACE_FILE, DEVICE not "
+            "needed\n"
+            "    --help|-h        print out usage message\n"
+            "    --jobs=J|-j J    number of threads issuing commands (def: "
+            "1)\n"
+            "    --no-timing|-n    issue commands as fast as possible (same "
+            "as\n"
+            "                      --scale=0)\n"
+            "    --scale=S|-s S    multiply gaps between commands by S "
+            "(def: 1.0,\n"
+            "                      the original timing)\n"
+            "    --timeout=SECS|-t SECS    command timeout (def: 60 "
+            "seconds)\n"
+            "    --verbose|-v     increase verbosity\n"
+            "    --verify|-c      compare hashes of data-in with those in "
+            "TRACE_FILE\n"
+            "                     (needs a trace taken with ',data')\n"
+            "    --version|-V     print version string and exit\n"
+            "    --write|-w       also replay commands that send data to "
+            "DEVICE\n\n"
+            "Re-issues the commands in TRACE_FILE, in the order that they "
+            "were started,\nto DEVICE. Commands with data-out are skipped "
+            "unless --write is given; when\nsent, their data-out buffers "
+            "are zero filled. TRACE_FILE is produced by\nsetting the "
+            "SG3_UTILS_TRACE environment variable to 'TRACE_FILE[,data]' "
+            "before\nrunning one or more utilities.\n");
+}
+
+static int
+cmp_cmd(const void * a, const void * b)
+{
+    const struct rp_cmd * ap = (const struct rp_cmd *)a;
+    const struct rp_cmd * bp = (const struct rp_cmd *)b;
+
+    if (ap->abs_ns != bp->abs_ns)
+        return (ap->abs_ns < bp->abs_ns) ? -1 : 1;
+    return ap->ord - bp->ord;
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void
+sleep_until_ns(uint64_t when_ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = when_ns / 1000000000;
+    ts.tv_nsec = when_ns % 1000000000;
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+                                    NULL))
+        ;
+}
+
+/* Reads whole of fname into a malloc-ed buffer. Returns that buffer (and
+ * its length in *lenp) or NULL. */
+static uint8_t *
+read_trace_file(const char * fname, int * lenp)
+{
+    int fd, k, n;
+    struct stat st;
+    uint8_t * bp;
+
+    fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        pr2serr(ME "unable to open %s: %s\n", fname, safe_strerror(errno));
+        return NULL;
+    }
+    if ((fstat(fd, &st) < 0) || (st.st_size > INT_MAX)) {
+        pr2serr(ME "unable to stat %s or too large\n", fname);
+        close(fd);
+        return NULL;
+    }
+    bp = (uint8_t *)malloc(st.st_size + 1);
+    if (NULL == bp) {
+        pr2serr(ME "out of memory\n");
+        close(fd);
+        return NULL;
+    }
+    for (k = 0; k < st.st_size; k += n) {
+        n = read(fd, bp + k, st.st_size - k);
+        if (n <= 0)
+            break;
+    }
+    close(fd);
+    *lenp = k;
+    return bp;
+}
+
+/* Decodes the trace held in bp into an array of command records sorted by
+ * their start times. Returns the number of command records or -1. */
+static int
+decode_trace(const uint8_t * bp, int blen, struct rp_cmd ** cmdpp, int vb)
+{
+    int k, n, num, segs;
+    uint64_t seg_ns = 0;
+    struct rp_cmd * cmdp;
+    struct sg_pt_trace_rec r;
+
+    /* first pass to count, second to fill */
+    for (num = 0, segs = 0, k = 0; k < blen; k += n) {
+        n = sg_pt_trace_decode(bp + k, blen - k, &r);
+        if (n <= 0) {
+            pr2serr(ME "malformed record at offset %d, ignore rest\n", k);
+            blen = k;
+            break;
+        }
+        if ((0 == segs) && (SG_PT_TRACE_T_SEG != r.type)) {
+            pr2serr(ME "not a trace file (no leading segment record)\n");
+            return -1;
+        }
+        if (SG_PT_TRACE_T_SEG == r.type)
+            ++segs;
+        else if (SG_PT_TRACE_T_CMD == r.type)
+            ++num;
+    }
+    cmdp = (struct rp_cmd *)calloc(num + 1, sizeof(struct rp_cmd));
+    if (NULL == cmdp) {
+        pr2serr(ME "out of memory\n");
+        return -1;
+    }
+    for (num = 0, k = 0; k < blen; k += n) {
+        n = sg_pt_trace_decode(bp + k, blen - k, &r);
+        if (SG_PT_TRACE_T_SEG == r.type) {
+            seg_ns = r.start_ns;
+            if (vb)
+                pr2serr("segment: pid=%u, data hashes: %s\n", r.pid,
+                        (r.flags & 0x1) ? "yes" : "no");
+        } else if (SG_PT_TRACE_T_CMD == r.type) {
+            cmdp[num].ord = num;
+            cmdp[num].abs_ns = seg_ns + r.start_ns;
+            cmdp[num].r = r;
+            ++num;
+        }
+    }
+    qsort(cmdp, num, sizeof(struct rp_cmd), cmp_cmd);
+    if (vb)
+        pr2serr("%d segment(s), %d command(s)\n", segs, num);
+    *cmdpp = cmdp;
+    return num;
+}
+
+static void
+cmd_name(const struct sg_pt_trace_rec * rp, int b_len, char * b)
+{
+    if (rp->cdb_len < 1)
+        snprintf(b, b_len, "<no cdb>");
+    else if (rp->flags & SG_PT_TRACE_F_NVME)
+        snprintf(b, b_len, "NVMe opcode=0x%x", rp->cdbp[0]);
+    else
+        sg_get_command_name(rp->cdbp, 0, b_len, b);
+}
+
+static void
+dump_trace(const struct opts_t * op)
+{
+    int k, j;
+    uint64_t first_ns;
+    const struct sg_pt_trace_rec * rp;
+    char b[80];
+
+    first_ns = (op->num_cmds > 0) ? op->cmds[0].abs_ns : 0;
+    for (k = 0; k < op->num_cmds; ++k) {
+        rp = &op->cmds[k].r;
+        cmd_name(rp, sizeof(b), b);
+        printf("%12.6f  tid=%-7u %-28s din=%u dout=%u status=0x%x res=%d "
+               "%u us\n",
+               (double)(op->cmds[k].abs_ns - first_ns) / 1000000000.0,
+               rp->tid, b, rp->din_len, rp->dout_len, rp->status, rp->res,
+               rp->duration_us);
+        if (op->vb) {
+            printf("    cdb:");
+            for (j = 0; j < rp->cdb_len; ++j)
+                printf(" %02x", rp->cdbp[j]);
+            printf("\n");
+            if (rp->sense_len > 0) {
+                printf("    sense:");
+                for (j = 0; j < rp->sense_len; ++j)
+                    printf(" %02x", rp->sensep[j]);
+                printf("\n");
+            }
+            if (rp->resid)
+                printf("    resid=%d\n", rp->resid);
+        }
+    }
+}
+
+static void *
+replay_thread(void * v_jp)
+{
+    struct rp_job * jp = (struct rp_job *)v_jp;
+    struct opts_t * op;
+    int k, res, status, act_din, vb;
+    uint32_t buf_sz = 0;
+    uint64_t first_ns, start_ns, target_ns, lat_us;
+    uint8_t * buf = NULL;
+    uint8_t * free_buf = NULL;
+    const struct sg_pt_trace_rec * rp;
+    struct sg_pt_base * ptvp;
+    uint8_t sense_b[SENSE_BUFF_LEN];
+
+    op = jp->op;
+    vb = op->vb;
+    ptvp = construct_scsi_pt_obj_with_fd(op->dev_fd, vb);
+    if (NULL == ptvp) {
+        pr2serr(ME "job %d: out of memory\n", jp->id);
+        return NULL;
+    }
+    first_ns = op->cmds[0].abs_ns;
+    while ((k = __atomic_fetch_add(&next_cmd_idx, 1, __ATOMIC_RELAXED)) <
+           op->num_cmds) {
+        rp = &op->cmds[k].r;
+        if ((rp->dout_len > 0) && (! op->do_write)) {
+            ++jp->skipped;
+            continue;
+        }
+        if (op->scale > 0.0) {
+            target_ns = op->t0_ns + (uint64_t)(op->scale *
+                                     (double)(op->cmds[k].abs_ns - first_ns));
+            if (now_ns() < target_ns)
+                sleep_until_ns(target_ns);
+            else if ((now_ns() - target_ns) / 1000 > jp->lag_max_us)
+                jp->lag_max_us = (now_ns() - target_ns) / 1000;
+        }
+        if ((rp->din_len > buf_sz) || (rp->dout_len > buf_sz)) {
+            if (free_buf)
+                free(free_buf);
+            buf_sz = (rp->din_len > rp->dout_len) ? rp->din_len :
+                                                    rp->dout_len;
+            buf = sg_memalign(buf_sz, 0, &free_buf, false);
+            if (NULL == buf) {
+                pr2serr(ME "job %d: out of memory\n", jp->id);
+                break;
+            }
+        }
+        clear_scsi_pt_obj(ptvp);
+        set_scsi_pt_cdb(ptvp, rp->cdbp, rp->cdb_len);
+        set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+        if (rp->din_len > 0)
+            set_scsi_pt_data_in(ptvp, buf, rp->din_len);
+        else if (rp->dout_len > 0)
+            set_scsi_pt_data_out(ptvp, buf, rp->dout_len);
+        start_ns = now_ns();
+        res = do_scsi_pt(ptvp, -1, op->timeout, vb);
+        lat_us = (now_ns() - start_ns) / 1000;
+        ++jp->issued;
+        jp->lat_sum_us += lat_us;
+        if (lat_us > jp->lat_max_us)
+            jp->lat_max_us = lat_us;
+        status = get_scsi_pt_status_response(ptvp);
+        if (res < 0) {
+            ++jp->errs;
+            if (vb)
+                pr2serr("trace cmd %d: %s\n", op->cmds[k].ord,
+                        safe_strerror(-res));
+        } else if (res > 0)
+            ++jp->errs;
+        if ((res < 0) != (rp->res < 0) || (status != rp->status)) {
+            ++jp->stat_diff;
+            if (vb)
+                pr2serr("trace cmd %d: status=0x%x, in trace 0x%x\n",
+                        op->cmds[k].ord, status, rp->status);
+        }
+        if (op->do_verify && (rp->flags & SG_PT_TRACE_F_DIN_HASH)) {
+            act_din = rp->din_len - get_scsi_pt_resid(ptvp);
+            if (act_din < 0)
+                act_din = 0;
+            if (sg_pt_trace_hash(buf, act_din) != rp->din_hash) {
+                ++jp->hash_diff;
+                if (vb)
+                    pr2serr("trace cmd %d: data-in differs\n",
+                            op->cmds[k].ord);
+            }
+        }
+    }
+    if (free_buf)
+        free(free_buf);
+    destruct_scsi_pt_obj(ptvp);
+    return NULL;
+}
+
+static int
+replay_trace(struct opts_t * op, const char * dev_name)
+{
+    int k, res;
+    int issued = 0, skipped = 0, errs = 0, stat_diff = 0, hash_diff = 0;
+    uint64_t lat_sum = 0, lat_max = 0, lag_max = 0;
+    uint64_t t_lat_sum = 0, t_lat_max = 0;
+    uint64_t elapsed_ns, span_ns;
+    struct rp_job * jobs;
+
+    if (op->num_cmds < 1) {
+        pr2serr(ME "no commands in trace\n");
+        return 0;
+    }
+    op->dev_fd = scsi_pt_open_device(dev_name, ! op->do_write, op->vb);
+    if (op->dev_fd < 0) {
+        pr2serr(ME "unable to open %s: %s\n", dev_name,
+                safe_strerror(-op->dev_fd));
+        return sg_convert_errno(-op->dev_fd);
+    }
+    jobs = (struct rp_job *)calloc(op->jobs, sizeof(struct rp_job));
+    if (NULL == jobs) {
+        pr2serr(ME "out of memory\n");
+        scsi_pt_close_device(op->dev_fd);
+        return sg_convert_errno(ENOMEM);
+    }
+    op->t0_ns = now_ns();
+    for (k = 0; k < op->jobs; ++k) {
+        jobs[k].id = k;
+        jobs[k].op = op;
+        res = pthread_create(&jobs[k].thr, NULL, replay_thread, jobs + k);
+        if (res) {
+            pr2serr(ME "pthread_create: %s\n", safe_strerror(res));
+            op->jobs = k;
+            break;
+        }
+    }
+    for (k = 0; k < op->jobs; ++k) {
+        pthread_join(jobs[k].thr, NULL);
+        issued += jobs[k].issued;
+        skipped += jobs[k].skipped;
+        errs += jobs[k].errs;
+        stat_diff += jobs[k].stat_diff;
+        hash_diff += jobs[k].hash_diff;
+        lat_sum += jobs[k].lat_sum_us;
+        if (jobs[k].lat_max_us > lat_max)
+            lat_max = jobs[k].lat_max_us;
+        if (jobs[k].lag_max_us > lag_max)
+            lag_max = jobs[k].lag_max_us;
+    }
+    elapsed_ns = now_ns() - op->t0_ns;
+    scsi_pt_close_device(op->dev_fd);
+    free(jobs);
+
+    for (k = 0; k < op->num_cmds; ++k) {
+        if ((op->cmds[k].r.dout_len > 0) && (! op->do_write))
+            continue;
+        t_lat_sum += op->cmds[k].r.duration_us;
+        if (op->cmds[k].r.duration_us > t_lat_max)
+            t_lat_max = op->cmds[k].r.duration_us;
+    }
+    span_ns = op->cmds[op->num_cmds - 1].abs_ns - op->cmds[0].abs_ns;
+    printf("Replayed %d of %d commands in %.6f secs (trace spanned %.6f "
+           "secs)\n", issued, op->num_cmds, (double)elapsed_ns / 1e9,
+           (double)span_ns / 1e9);
+    if (skipped)
+        printf("  skipped %d commands with data-out, use --write to send "
+               "them\n", skipped);
+    printf("  errors: %d, status differs from trace: %d", errs, stat_diff);
+    if (op->do_verify)
+        printf(", data-in differs: %d", hash_diff);
+    printf("\n");
+    if (issued > 0)
+        printf("  latency (us): replay mean=%" PRIu64 " max=%" PRIu64
+               ", trace mean=%" PRIu64 " max=%" PRIu64 "\n",
+               lat_sum / issued, lat_max, t_lat_sum / issued, t_lat_max);
+    if (op->scale > 0.0)
+        printf("  maximum lag behind schedule: %" PRIu64 " us\n", lag_max);
+    return (errs || stat_diff || hash_diff) ? SG_LIB_CAT_OTHER : 0;
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    int c, blen;
+    int ret = 0;
+    const char * trace_name = NULL;
+    const char * dev_name = NULL;
+    char * cp;
+    uint8_t * bp;
+    struct opts_t opts;
+    struct opts_t * op = &opts;
+
+    memset(op, 0, sizeof(opts));
+    op->jobs = 1;
+    op->timeout = DEF_TIMEOUT_SECS;
+    op->scale = 1.0;
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "cdhj:ns:t:vVw", long_options,
+                        &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'c':
+            op->do_verify = true;
+            break;
+        case 'd':
+            op->do_dump = true;
+            break;
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 'j':
+            op->jobs = sg_get_num(optarg);
+            if ((op->jobs < 1) || (op->jobs > MAX_JOBS)) {
+                pr2serr("bad argument to '--jobs=', expect 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'n':
+            op->scale = 0.0;
+            break;
+        case 's':
+            op->scale = strtod(optarg, &cp);
+            if ((cp == optarg) || (op->scale < 0.0)) {
+                pr2serr("bad argument to '--scale=', expect 0 or "
+                        "greater\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 't':
+            op->timeout = sg_get_num(optarg);
+            if (op->timeout < 0) {
+                pr2serr("bad argument to '--timeout=', expect 0 or "
+                        "higher\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'v':
+            ++op->vb;
+            break;
+        case 'V':
+            pr2serr(ME "version: %s\n", version_str);
+            return 0;
+        case 'w':
+            op->do_write = true;
+            break;
+        default:
+            pr2serr("unrecognised option code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc)
+        trace_name = argv[optind++];
+    if (optind < argc)
+        dev_name = argv[optind++];
+    if (optind < argc) {
+        pr2serr("unexpected extra argument: %s\n", argv[optind]);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((NULL == trace_name) || ((NULL == dev_name) && (! op->do_dump))) {
+        pr2serr("need TRACE_FILE and, unless --dump given, DEVICE\n\n");
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+
+    bp = read_trace_file(trace_name, &blen);
+    if (NULL == bp)
+        return SG_LIB_FILE_ERROR;
+    op->num_cmds = decode_trace(bp, blen, &op->cmds, op->vb);
+    if (op->num_cmds < 0) {
+        ret = SG_LIB_FILE_ERROR;
+        goto fini;
+    }
+    if (op->do_dump)
+        dump_trace(op);
+    else
+        ret = replay_trace(op, dev_name);
+fini:
+    if (op->cmds)
+        free(op->cmds);
+    free(bp);
+    return ret;
+}
@@ -873,7 +873,8 @@ work_sync_thread(int id, const char * dev_name, unsigned int /* hi_lba */,
                  struct opts_t * op)
 {
     bool is_rw = (SCSI_TUR != op->c2e);
-    int k, sg_fd, err, rs, n, sense_cat, ret;
+    int k, err, rs, n, sense_cat, ret;
+    int sg_fd = -1;
     int vb = op->verbose;
     int num_errs = 0;
     int thr_sync_starts = 0;
@@ -955,6 +956,8 @@ work_sync_thread(int id, const char * dev_name, unsigned int /* hi_lba */,
 err_out:
     if (ptp)
         destruct_scsi_pt_obj(ptp);
+    if (sg_fd >= 0)
+        sg_cmds_close_device(sg_fd);
     if (num_errs > 0)
         pr2serr_lk("id=%d: number of errors: %d\n", id, num_errs);
     sync_starts += thr_sync_starts;
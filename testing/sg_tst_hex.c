@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This program compares the hex dump functions in sg_lib (hex2str() and
+ * hex2stderr() redirected to a file) with reference versions that build
+ * each line a byte at a time with sprintf(), as sg_lib did up to version
+ * 1.44 . For each output type it checks that both yield identical output,
+ * then prints the time each takes per MiB of input.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_pr2serr.h"
+
+static const char * version_str = "1.00 20261017";
+
+
+#define ME "sg_tst_hex: "
+
+#define DEF_LEN (1024 * 1024)
+#define DEF_COUNT 4
+#define REF_LINE_BLEN 160
+#define REF_BPL 16
+
+static struct option long_options[] = {
+    {"count", required_argument, 0, 'c'},
+    {"help", no_argument, 0, 'h'},
+    {"len", required_argument, 0, 'l'},
+    {"verbose", no_argument, 0, 'v'},
+    {"version", no_argument, 0, 'V'},
+    {0, 0, 0, 0},
+};
+
+static void
+usage(void)
+{
+    pr2serr("Usage: sg_tst_hex [--count=CO] [--help] [--len=LEN] "
+            "[--verbose] [--version]\n"
+            "  where:\n"
+            "    --count=CO|-c CO    number of timed runs of each (def: "
+            "%d)\n"
+            "    --help|-h          print out usage message\n"
+            "    --len=LEN|-l LEN    bytes of random data to dump (def: "
+            "1 MiB)\n"
+            "    --verbose|-v       increase verbosity\n"
+            "    --version|-V       print version string and exit\n\n"
+            "Dumps LEN random bytes with sg_lib's hex2str() and "
+            "hex2stderr(), and with\nreference sprintf() based versions. "
+            "Checks that the output is identical\nthen prints the time "
+            "per MiB of input for each.\n", DEF_COUNT);
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static int
+ref_isprint(int ch)
+{
+    return ((ch >= ' ') && (ch < 0x7f));
+}
+
+static void
+ref_trim(char * b)
+{
+    int k;
+
+    for (k = ((int)strlen(b) - 1); k >= 0; --k) {
+        if (' ' != b[k])
+            break;
+    }
+    b[k + 1] = '\0';
+}
+
+/* Reference for hex2stderr() and friends: one sprintf() per byte */
+static void
+ref_hex_fp(const uint8_t * p, int len, int no_ascii, FILE * fp)
+{
+    uint8_t c;
+    char buff[82];
+    int a = 0;
+    int bpstart = 5;
+    const int cpstart = 60;
+    int cpos = cpstart;
+    int bpos = bpstart;
+    int i, k;
+
+    if (len <= 0)
+        return;
+    memset(buff, ' ', 80);
+    buff[80] = '\0';
+    if (no_ascii < 0) {
+        bpstart = 0;
+        bpos = bpstart;
+        for (k = 0; k < len; k++) {
+            c = *p++;
+            if (bpos == (bpstart + (8 * 3)))
+                bpos++;
+            snprintf(&buff[bpos], sizeof(buff) - bpos, "%.2x", (int)c);
+            buff[bpos + 2] = ' ';
+            if ((k > 0) && (0 == ((k + 1) % 16))) {
+                ref_trim(buff);
+                fprintf(fp, "%s\n", buff);
+                bpos = bpstart;
+                memset(buff, ' ', 80);
+            } else
+                bpos += 3;
+        }
+        if (bpos > bpstart) {
+            buff[bpos + 2] = '\0';
+            ref_trim(buff);
+            fprintf(fp, "%s\n", buff);
+        }
+        return;
+    }
+    k = snprintf(buff + 1, sizeof(buff) - 1, "%.2x", a);
+    buff[k + 1] = ' ';
+    for (i = 0; i < len; i++) {
+        c = *p++;
+        bpos += 3;
+        if (bpos == (bpstart + (9 * 3)))
+            bpos++;
+        snprintf(&buff[bpos], sizeof(buff) - bpos, "%.2x", (int)c);
+        buff[bpos + 2] = ' ';
+        buff[cpos++] = no_ascii ? ' ' : (ref_isprint(c) ? c : '.');
+        if (cpos > (cpstart + 15)) {
+            if (no_ascii) {
+                ref_trim(buff);
+                fprintf(fp, "%s\n", buff);
+            } else
+                fprintf(fp, "%.76s\n", buff);
+            bpos = bpstart;
+            cpos = cpstart;
+            a += 16;
+            memset(buff, ' ', 80);
+            k = snprintf(buff + 1, sizeof(buff) - 1, "%.2x", a);
+            buff[k + 1] = ' ';
+        }
+    }
+    if (cpos > cpstart) {
+        buff[cpos] = '\0';
+        if (no_ascii)
+            ref_trim(buff);
+        fprintf(fp, "%s\n", buff);
+    }
+}
+
+/* Reference for hex2str(): one sprintf() per byte */
+static int
+ref_hex_str(const uint8_t * p, int len, const char * leadin, int format,
+            int b_len, char * b)
+{
+    uint8_t c;
+    int bpstart, bpos, k, n, prior_ascii_len;
+    bool want_ascii = !format;
+    char buff[REF_LINE_BLEN + 2];
+    char a[REF_BPL + 1];
+
+    if (len <= 0) {
+        if (b_len > 0)
+            b[0] = '\0';
+        return 0;
+    }
+    if (b_len <= 0)
+        return 0;
+    memset(a, ' ', REF_BPL);
+    a[REF_BPL] = '\0';
+    bpstart = leadin ? (int)strlen(leadin) : 0;
+    if (bpstart > (REF_LINE_BLEN - 70))
+        bpstart = REF_LINE_BLEN - 70;
+    bpos = bpstart;
+    prior_ascii_len = bpstart + (REF_BPL * 3) + 1;
+    n = 0;
+    memset(buff, ' ', REF_LINE_BLEN);
+    buff[REF_LINE_BLEN] = '\0';
+    if (bpstart > 0)
+        memcpy(buff, leadin, bpstart);
+    for (k = 0; k < len; k++) {
+        c = *p++;
+        if (bpos == (bpstart + ((REF_BPL / 2) * 3)))
+            bpos++;
+        snprintf(buff + bpos, (int)sizeof(buff) - bpos, "%.2x", (int)c);
+        buff[bpos + 2] = ' ';
+        if (want_ascii)
+            a[k % REF_BPL] = ref_isprint(c) ? c : '.';
+        if ((k > 0) && (0 == ((k + 1) % REF_BPL))) {
+            ref_trim(buff);
+            if (want_ascii) {
+                n += sg_scnpr(b + n, b_len - n, "%-*s   %s\n",
+                              prior_ascii_len, buff, a);
+                memset(a, ' ', REF_BPL);
+            } else
+                n += sg_scnpr(b + n, b_len - n, "%s\n", buff);
+            if (n >= (b_len - 1))
+                return n;
+            memset(buff, ' ', REF_LINE_BLEN);
+            bpos = bpstart;
+            if (bpstart > 0)
+                memcpy(buff, leadin, bpstart);
+        } else
+            bpos += 3;
+    }
+    if (bpos > bpstart) {
+        ref_trim(buff);
+        if (want_ascii)
+            n += sg_scnpr(b + n, b_len - n, "%-*s   %s\n", prior_ascii_len,
+                          buff, a);
+        else
+            n += sg_scnpr(b + n, b_len - n, "%s\n", buff);
+    }
+    return n;
+}
+
+/* Returns true if the contents of 'fp1' and 'fp2' are the same */
+static bool
+same_files(FILE * fp1, FILE * fp2)
+{
+    int c1, c2;
+
+    rewind(fp1);
+    rewind(fp2);
+    do {
+        c1 = getc(fp1);
+        c2 = getc(fp2);
+    } while ((c1 == c2) && (EOF != c1));
+    return (c1 == c2);
+}
+
+static void
+pr_times(const char * name, uint64_t ref_ns, uint64_t lib_ns, int len)
+{
+    double mib = (double)len / (1024 * 1024);
+
+    printf("  %-24s reference: %8.2f ms/MiB   sg_lib: %8.2f ms/MiB  "
+           "(x%.1f)\n", name, (ref_ns / 1e6) / mib, (lib_ns / 1e6) / mib,
+           lib_ns ? ((double)ref_ns / lib_ns) : 0.0);
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    bool ok = true;
+    int c, k, j, b_len, n_ref, n_lib;
+    int count = DEF_COUNT;
+    int len = DEF_LEN;
+    int vb = 0;
+    int ret = 0;
+    uint64_t t0, ref_ns, lib_ns;
+    uint8_t * dp = NULL;
+    char * ref_b = NULL;
+    char * lib_b = NULL;
+    FILE * ref_fp = NULL;
+    FILE * lib_fp = NULL;
+    char name[32];
+
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "c:hl:vV", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'c':
+            count = sg_get_num(optarg);
+            if (count < 1) {
+                pr2serr("bad argument to '--count='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 'l':
+            len = sg_get_num(optarg);
+            if ((len < 1) || (len > (64 * 1024 * 1024))) {
+                pr2serr("bad argument to '--len=', expect 1 to 64 MiB\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'v':
+            ++vb;
+            break;
+        case 'V':
+            pr2serr(ME "version: %s\n", version_str);
+            return 0;
+        default:
+            pr2serr("unrecognised option code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc) {
+        for (; optind < argc; ++optind)
+            pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    /* each 16 byte line is at most 128 characters with a short leadin */
+    b_len = ((len / 16) + 1) * 128;
+    dp = (uint8_t *)malloc(len);
+    ref_b = (char *)malloc(b_len);
+    lib_b = (char *)malloc(b_len);
+    ref_fp = tmpfile();
+    lib_fp = tmpfile();
+    if ((NULL == dp) || (NULL == ref_b) || (NULL == lib_b) ||
+        (NULL == ref_fp) || (NULL == lib_fp)) {
+        pr2serr(ME "out of memory or no temporary file\n");
+        ret = SG_LIB_CAT_OTHER;
+        goto fini;
+    }
+    srand(len);
+    for (k = 0; k < len; ++k)
+        dp[k] = (uint8_t)rand();
+    printf("Dumping %d bytes, %d runs of each:\n", len, count);
+
+    for (j = 0; j < 2; ++j) {   /* hex2str() with and without ASCII */
+        n_ref = ref_hex_str(dp, len, "  ", j, b_len, ref_b);
+        n_lib = hex2str(dp, len, "  ", j, b_len, lib_b);
+        if ((n_ref != n_lib) || memcmp(ref_b, lib_b, n_ref)) {
+            pr2serr(ME "hex2str(format=%d) output differs\n", j);
+            ok = false;
+        }
+        t0 = now_ns();
+        for (k = 0; k < count; ++k)
+            ref_hex_str(dp, len, "  ", j, b_len, ref_b);
+        ref_ns = (now_ns() - t0) / count;
+        t0 = now_ns();
+        for (k = 0; k < count; ++k)
+            hex2str(dp, len, "  ", j, b_len, lib_b);
+        lib_ns = (now_ns() - t0) / count;
+        snprintf(name, sizeof(name), "hex2str(format=%d)", j);
+        pr_times(name, ref_ns, lib_ns, len);
+    }
+
+    for (j = -1; j < 2; ++j) {  /* no_ascii: -1, 0 and 1 */
+        rewind(ref_fp);
+        rewind(lib_fp);
+        ref_hex_fp(dp, len, j, ref_fp);
+        sg_set_warnings_strm(lib_fp);
+        hex2stderr(dp, len, j);
+        fflush(ref_fp);
+        fflush(lib_fp);
+        if ((ftell(ref_fp) != ftell(lib_fp)) ||
+            (! same_files(ref_fp, lib_fp))) {
+            pr2serr(ME "hex2stderr(no_ascii=%d) output differs\n", j);
+            ok = false;
+        }
+        t0 = now_ns();
+        for (k = 0; k < count; ++k) {
+            rewind(ref_fp);
+            ref_hex_fp(dp, len, j, ref_fp);
+        }
+        ref_ns = (now_ns() - t0) / count;
+        t0 = now_ns();
+        for (k = 0; k < count; ++k) {
+            rewind(lib_fp);
+            hex2stderr(dp, len, j);
+        }
+        lib_ns = (now_ns() - t0) / count;
+        sg_set_warnings_strm(NULL);
+        snprintf(name, sizeof(name), "hex2stderr(no_ascii=%d)", j);
+        pr_times(name, ref_ns, lib_ns, len);
+    }
+    printf("Output %s\n", ok ? "identical" : "DIFFERS");
+    if (! ok)
+        ret = SG_LIB_CAT_OTHER;
+    else if (vb)
+        pr2serr("hex2str() yielded %d bytes\n", n_lib);
+fini:
+    if (ref_fp)
+        fclose(ref_fp);
+    if (lib_fp)
+        fclose(lib_fp);
+    free(lib_b);
+    free(ref_b);
+    free(dp);
+    return ret;
+}
@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This program compares the command latency seen by do_scsi_pt() with
+ * the three completion modes that the library offers: interrupt driven
+ * (the OS wakes the caller), hybrid polled (spin for a budget, then
+ * block) and polled (spin until complete). The same command is issued
+ * repeatedly in each mode and the latency percentiles are printed. An
+ * emulated device with a latency (e.g. 'emul:/tmp/e.img,lat=20') shows
+ * the wake up cost of a sleep against spinning.
+ *
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_pt.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+static const char * version_str = "1.00 20261017";
+
+
+#define ME "sg_tst_poll: "
+
+#define SENSE_BUFF_LEN 64
+#define DEF_TIMEOUT_SECS 60
+#define DEF_COUNT 10000
+#define DEF_BS 512
+#define WARMUP_CMDS 100
+
+enum poll_mode_t {
+    MODE_IRQ = 0,
+    MODE_HYBRID,
+    MODE_POLL,
+    MODE_ALL,
+};
+
+static const char * mode_names[] = {"irq", "hybrid", "poll", "all"};
+
+struct opts_t {
+    bool do_read;
+    int bs;
+    int count;
+    int spin_us;
+    int timeout;
+    int vb;
+    enum poll_mode_t mode;
+};
+
+
+static struct option long_options[] = {
+    {"bs", required_argument, 0, 'b'},
+    {"count", required_argument, 0, 'c'},
+    {"help", no_argument, 0, 'h'},
+    {"mode", required_argument, 0, 'm'},
+    {"read", no_argument, 0, 'r'},
+    {"spin", required_argument, 0, 's'},
+    {"timeout", required_argument, 0, 't'},
+    {"verbose", no_argument, 0, 'v'},
+    {"version", no_argument, 0, 'V'},
+    {0, 0, 0, 0},
+};
+
+static void
+usage(void)
+{
+    pr2serr("Usage: sg_tst_poll [--bs=BS] [--count=CO] [--help] "
+            "[--mode=MO] [--read]\n"
+            "                   [--spin=US] [--timeout=SECS] [--verbose] "
+            "[--version]\n"
+            "                   DEVICE\n"
+            "  where:\n"
+            "    --bs=BS|-b BS      logical block size for --read (def: "
+            "512)\n"
+            "    --count=CO|-c CO    number of commands per mode (def: "
+            "10000)\n"
+            "    --help|-h          print out usage message\n"
+            "    --mode=MO|-m MO    'irq', 'hybrid', 'poll' or 'all' (def: "
+            "all)\n"
+            "    --read|-r          READ(16) one block at LBA 0 (def: TEST "
+            "UNIT READY)\n"
+            "    --spin=US|-s US    hybrid spin budget in microseconds "
+            "(def: %d)\n"
+            "    --timeout=SECS|-t SECS    command timeout (def: 60 "
+            "seconds)\n"
+            "    --verbose|-v       increase verbosity\n"
+            "    --version|-V       print version string and exit\n\n"
+            "Issues the same command CO times to DEVICE in each completion "
+            "mode of\ndo_scsi_pt(), then prints min, mean, p50, p99, p99.9 "
+            "and max latencies\nin microseconds. 'hybrid' and 'poll' use "
+            "SCSI_PT_FLAGS_POLLED, with a spin\nbudget of US and "
+            "SCSI_PT_SPIN_FOREVER respectively.\n", SCSI_PT_DEF_SPIN_US);
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static int
+cmp_u64(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/* Returns the value at percentile pc (0.0 to 100.0) in the sorted array */
+static uint64_t
+percentile(const uint64_t * arr, int num, double pc)
+{
+    int k = (int)((pc / 100.0) * (num - 1) + 0.5);
+
+    return arr[(k < num) ? k : (num - 1)];
+}
+
+/* Issues op->count commands (after a warm up) with the completion mode
+ * given. Latencies (in nanoseconds) are placed in lat_arr. Returns 0 if
+ * okay, else an error value suitable for exit(). */
+static int
+run_mode(int sg_fd, enum poll_mode_t mode, const struct opts_t * op,
+         uint8_t * buffp, uint64_t * lat_arr)
+{
+    int k, n, res, cdb_len, flags, cat;
+    uint64_t t_ns;
+    uint8_t cdb[16];
+    uint8_t sense_b[SENSE_BUFF_LEN];
+    struct sg_pt_base * ptvp;
+
+    memset(cdb, 0, sizeof(cdb));
+    if (op->do_read) {
+        cdb[0] = 0x88;          /* READ(16) */
+        sg_put_unaligned_be32(1, cdb + 10);
+        cdb_len = 16;
+    } else
+        cdb_len = 6;            /* TEST UNIT READY */
+    switch (mode) {
+    case MODE_HYBRID:
+        flags = SCSI_PT_FLAGS_POLLED | SCSI_PT_FLAGS_SPIN_US(op->spin_us);
+        break;
+    case MODE_POLL:
+        flags = SCSI_PT_FLAGS_POLLED |
+                SCSI_PT_FLAGS_SPIN_US(SCSI_PT_SPIN_FOREVER);
+        break;
+    default:
+        flags = 0;
+        break;
+    }
+    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, op->vb);
+    if (NULL == ptvp) {
+        pr2serr(ME "out of memory\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    for (k = -WARMUP_CMDS; k < op->count; ++k) {
+        clear_scsi_pt_obj(ptvp);
+        set_scsi_pt_cdb(ptvp, cdb, cdb_len);
+        set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+        if (op->do_read)
+            set_scsi_pt_data_in(ptvp, buffp, op->bs);
+        if (flags)
+            set_scsi_pt_flags(ptvp, flags);
+        t_ns = now_ns();
+        res = do_scsi_pt(ptvp, -1, op->timeout, op->vb);
+        t_ns = now_ns() - t_ns;
+        if (res) {
+            pr2serr(ME "%s mode: do_scsi_pt() failed, res=%d\n",
+                    mode_names[mode], res);
+            destruct_scsi_pt_obj(ptvp);
+            return (res < 0) ? sg_convert_errno(-res) : SG_LIB_CAT_OTHER;
+        }
+        cat = get_scsi_pt_result_category(ptvp);
+        if ((SCSI_PT_RESULT_GOOD != cat) && (k < 0)) {
+            n = get_scsi_pt_sense_len(ptvp);
+            pr2serr(ME "%s mode: command failed, category=%d\n",
+                    mode_names[mode], cat);
+            if ((n > 0) && op->vb)
+                sg_print_sense(NULL, sense_b, n, op->vb > 1);
+            destruct_scsi_pt_obj(ptvp);
+            return SG_LIB_CAT_OTHER;
+        }
+        if (k >= 0)
+            lat_arr[k] = t_ns;
+    }
+    destruct_scsi_pt_obj(ptvp);
+    return 0;
+}
+
+static void
+report(enum poll_mode_t mode, uint64_t * lat_arr, int num)
+{
+    int k;
+    uint64_t sum;
+
+    qsort(lat_arr, num, sizeof(uint64_t), cmp_u64);
+    for (k = 0, sum = 0; k < num; ++k)
+        sum += lat_arr[k];
+    printf("%-7s %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n", mode_names[mode],
+           lat_arr[0] / 1000.0, (sum / (double)num) / 1000.0,
+           percentile(lat_arr, num, 50.0) / 1000.0,
+           percentile(lat_arr, num, 99.0) / 1000.0,
+           percentile(lat_arr, num, 99.9) / 1000.0,
+           lat_arr[num - 1] / 1000.0);
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    int c, k, sg_fd;
+    int ret = 0;
+    const char * dev_name = NULL;
+    uint8_t * buffp = NULL;
+    uint8_t * free_buffp = NULL;
+    uint64_t * lat_arr = NULL;
+    enum poll_mode_t m;
+    struct opts_t opts;
+    struct opts_t * op = &opts;
+
+    memset(op, 0, sizeof(opts));
+    op->bs = DEF_BS;
+    op->count = DEF_COUNT;
+    op->spin_us = SCSI_PT_DEF_SPIN_US;
+    op->timeout = DEF_TIMEOUT_SECS;
+    op->mode = MODE_ALL;
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "b:c:hm:rs:t:vV", long_options,
+                        &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'b':
+            op->bs = sg_get_num(optarg);
+            if (op->bs < 1) {
+                pr2serr("bad argument to '--bs=', expect 1 or higher\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'c':
+            op->count = sg_get_num(optarg);
+            if (op->count < 1) {
+                pr2serr("bad argument to '--count=', expect 1 or higher\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 'm':
+            for (k = 0; k <= MODE_ALL; ++k) {
+                if (0 == strcmp(optarg, mode_names[k]))
+                    break;
+            }
+            if (k > MODE_ALL) {
+                pr2serr("bad argument to '--mode=', expect 'irq', "
+                        "'hybrid', 'poll' or 'all'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->mode = (enum poll_mode_t)k;
+            break;
+        case 'r':
+            op->do_read = true;
+            break;
+        case 's':
+            op->spin_us = sg_get_num(optarg);
+            if ((op->spin_us < 1) ||
+                (op->spin_us >= SCSI_PT_SPIN_FOREVER)) {
+                pr2serr("bad argument to '--spin=', expect 1 to %d\n",
+                        SCSI_PT_SPIN_FOREVER - 1);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 't':
+            op->timeout = sg_get_num(optarg);
+            if (op->timeout < 0) {
+                pr2serr("bad argument to '--timeout=', expect 0 or "
+                        "higher\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'v':
+            ++op->vb;
+            break;
+        case 'V':
+            pr2serr(ME "version: %s\n", version_str);
+            return 0;
+        default:
+            pr2serr("unrecognised option code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc)
+        dev_name = argv[optind++];
+    if (optind < argc) {
+        for (; optind < argc; ++optind)
+            pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (NULL == dev_name) {
+        pr2serr("missing device name!\n\n");
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    sg_fd = scsi_pt_open_device(dev_name, ! op->do_read, op->vb);
+    if (sg_fd < 0) {
+        pr2serr(ME "open error: %s: %s\n", dev_name,
+                safe_strerror(-sg_fd));
+        return sg_convert_errno(-sg_fd);
+    }
+    lat_arr = (uint64_t *)calloc(op->count, sizeof(uint64_t));
+    if (op->do_read)
+        buffp = sg_memalign(op->bs, 0, &free_buffp, false);
+    if ((NULL == lat_arr) || (op->do_read && (NULL == buffp))) {
+        pr2serr(ME "out of memory\n");
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    printf("%d x %s on %s, latencies in microseconds:\n", op->count,
+           op->do_read ? "READ(16)" : "TEST UNIT READY", dev_name);
+    printf("mode         min     mean      p50      p99    p99.9      "
+           "max\n");
+    for (m = MODE_IRQ; m < MODE_ALL; m = (enum poll_mode_t)(m + 1)) {
+        if ((MODE_ALL != op->mode) && (m != op->mode))
+            continue;
+        ret = run_mode(sg_fd, m, op, buffp, lat_arr);
+        if (ret)
+            break;
+        report(m, lat_arr, op->count);
+    }
+fini:
+    if (free_buffp)
+        free(free_buffp);
+    if (lat_arr)
+        free(lat_arr);
+    scsi_pt_close_device(sg_fd);
+    return ret;
+}
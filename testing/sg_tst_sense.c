@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2019 Douglas Gilbert
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This program times the sense data decoding in sg_lib. It builds a
+ * corpus of sense buffers, one in fixed and one in descriptor format for
+ * each entry in the library's ASC/ASCQ tables plus some codes that are
+ * not in those tables, then decodes the whole corpus repeatedly with
+ * sg_get_sense_str() (or just sg_get_asc_ascq_str() with --asc, or
+ * sg_decode_sense() with --decode) and prints the mean time per decode.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_lib_data.h"
+#include "sg_pr2serr.h"
+
+static const char * version_str = "1.01 20261017";
+
+
+#define ME "sg_tst_sense: "
+
+#define SENSE_BUFF_LEN 32
+#define DEF_COUNT 1000
+#define DECODE_BUFF_LEN 1024
+
+struct sense_elem_t {
+    uint8_t sb[SENSE_BUFF_LEN];
+    int sb_len;
+};
+
+static struct option long_options[] = {
+    {"asc", no_argument, 0, 'a'},
+    {"count", required_argument, 0, 'c'},
+    {"decode", no_argument, 0, 'd'},
+    {"help", no_argument, 0, 'h'},
+    {"verbose", no_argument, 0, 'v'},
+    {"version", no_argument, 0, 'V'},
+    {0, 0, 0, 0},
+};
+
+static void
+usage(void)
+{
+    pr2serr("Usage: sg_tst_sense [--asc] [--count=CO] [--decode] [--help] "
+            "[--verbose]\n"
+            "                    [--version]\n"
+            "  where:\n"
+            "    --asc|-a           only decode ASC/ASCQ with "
+            "sg_get_asc_ascq_str()\n"
+            "                       (def: whole buffer with "
+            "sg_get_sense_str())\n"
+            "    --count=CO|-c CO    number of passes over the corpus (def: "
+            "%d)\n"
+            "    --decode|-d        only decode fields with "
+            "sg_decode_sense()\n"
+            "    --help|-h          print out usage message\n"
+            "    --verbose|-v       increase verbosity\n"
+            "    --version|-V       print version string and exit\n\n"
+            "Decodes a corpus of sense buffers, covering every ASC/ASCQ "
+            "known to sg_lib\nand some that are not, CO times. Then prints "
+            "the mean time per decode.\n", DEF_COUNT);
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void
+build_sense(struct sense_elem_t * sep, bool desc, int sk, int asc, int ascq)
+{
+    uint8_t * sbp = sep->sb;
+
+    memset(sbp, 0, SENSE_BUFF_LEN);
+    if (desc) {
+        sbp[0] = 0x72;
+        sbp[1] = sk & 0xf;
+        sbp[2] = asc;
+        sbp[3] = ascq;
+        sbp[7] = 12;                    /* additional sense length */
+        sbp[8] = 0;                     /* information descriptor */
+        sbp[9] = 0xa;
+        sbp[10] = 0x80;                 /* VALID */
+        sbp[19] = (uint8_t)(asc ^ ascq);
+        sep->sb_len = 20;
+    } else {
+        sbp[0] = 0xf0;                  /* VALID, current fixed */
+        sbp[2] = sk & 0xf;
+        sbp[6] = (uint8_t)(asc ^ ascq); /* information field */
+        sbp[7] = 10;                    /* additional sense length */
+        sbp[12] = asc;
+        sbp[13] = ascq;
+        sep->sb_len = 18;
+    }
+}
+
+/* Returns number of elements placed in the newly allocated *corpusp */
+static int
+build_corpus(struct sense_elem_t ** corpusp)
+{
+    int k, j, n, num;
+    struct sense_elem_t * corpus;
+
+    for (num = 0; sg_lib_asc_ascq[num].text; ++num)
+        ;
+    for (k = 0; sg_lib_asc_ascq_range[k].text; ++k)
+        ++num;
+    num += 3 * 0x80;                    /* unknown and vendor specific */
+    corpus = (struct sense_elem_t *)calloc(2 * num, sizeof(*corpus));
+    if (NULL == corpus)
+        return 0;
+    for (n = 0, k = 0; sg_lib_asc_ascq[k].text; ++k, n += 2) {
+        build_sense(corpus + n, false, k, sg_lib_asc_ascq[k].asc,
+                    sg_lib_asc_ascq[k].ascq);
+        build_sense(corpus + n + 1, true, k, sg_lib_asc_ascq[k].asc,
+                    sg_lib_asc_ascq[k].ascq);
+    }
+    for (k = 0; sg_lib_asc_ascq_range[k].text; ++k, n += 2) {
+        j = sg_lib_asc_ascq_range[k].ascq_max;
+        build_sense(corpus + n, false, k, sg_lib_asc_ascq_range[k].asc, j);
+        build_sense(corpus + n + 1, true, k, sg_lib_asc_ascq_range[k].asc,
+                    j);
+    }
+    for (k = 0; k < 0x80; ++k, n += 6) {
+        build_sense(corpus + n, false, k, k, 0xfe);
+        build_sense(corpus + n + 1, true, k, k, 0xfe);
+        build_sense(corpus + n + 2, false, k, 0x80 + k, k);
+        build_sense(corpus + n + 3, true, k, 0x80 + k, k);
+        build_sense(corpus + n + 4, false, k, k, 0x7f);
+        build_sense(corpus + n + 5, true, k, k, 0x7f);
+    }
+    *corpusp = corpus;
+    return n;
+}
+
+static int
+sense_asc(const struct sense_elem_t * sep, int * ascqp)
+{
+    if (0x72 == sep->sb[0]) {
+        *ascqp = sep->sb[3];
+        return sep->sb[2];
+    }
+    *ascqp = sep->sb[13];
+    return sep->sb[12];
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    bool asc_only = false;
+    bool decode_only = false;
+    int c, k, j, num, asc, ascq;
+    int count = DEF_COUNT;
+    int vb = 0;
+    uint64_t t0, t1, sum = 0;
+    double ns;
+    const char * fn_name;
+    struct sense_elem_t * corpus = NULL;
+    struct sg_sense_fields sf;
+    char b[DECODE_BUFF_LEN];
+
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "ac:dhvV", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'a':
+            asc_only = true;
+            break;
+        case 'c':
+            count = sg_get_num(optarg);
+            if (count < 1) {
+                pr2serr("bad argument to '--count='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'd':
+            decode_only = true;
+            break;
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 'v':
+            ++vb;
+            break;
+        case 'V':
+            pr2serr(ME "version: %s\n", version_str);
+            return 0;
+        default:
+            pr2serr("unrecognised option code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc) {
+        for (; optind < argc; ++optind)
+            pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    num = build_corpus(&corpus);
+    if (num < 1) {
+        pr2serr(ME "unable to build corpus\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    if (vb > 1) {
+        for (k = 0; k < num; ++k) {
+            sg_get_sense_str(NULL, corpus[k].sb, corpus[k].sb_len, false,
+                             sizeof(b), b);
+            printf("%s", b);
+        }
+    }
+
+    /* one untimed pass so that any first use setup is not counted */
+    for (k = 0; k < num; ++k) {
+        asc = sense_asc(corpus + k, &ascq);
+        sg_get_asc_ascq_str(asc, ascq, sizeof(b), b);
+    }
+    t0 = now_ns();
+    for (j = 0; j < count; ++j) {
+        for (k = 0; k < num; ++k) {
+            if (asc_only) {
+                asc = sense_asc(corpus + k, &ascq);
+                sg_get_asc_ascq_str(asc, ascq, sizeof(b), b);
+            } else if (decode_only) {
+                sg_decode_sense(corpus[k].sb, corpus[k].sb_len, &sf);
+                b[0] = (char)(sf.category + sf.ssh.asc);
+            } else
+                sg_get_sense_str(NULL, corpus[k].sb, corpus[k].sb_len,
+                                 false, sizeof(b), b);
+            sum += (uint8_t)b[0];       /* keep the decode live */
+        }
+    }
+    t1 = now_ns();
+    ns = (double)(t1 - t0) / ((double)count * num);
+    if (asc_only)
+        fn_name = "sg_get_asc_ascq_str";
+    else if (decode_only)
+        fn_name = "sg_decode_sense";
+    else
+        fn_name = "sg_get_sense_str";
+    printf("%s: %d sense buffers x %d passes, %.1f ns per decode, "
+           "%.2f M decodes/sec\n", fn_name, num, count, ns,
+           (ns > 0.0) ? (1000.0 / ns) : 0.0);
+    if (vb)
+        pr2serr("checksum: %" PRIu64 "\n", sum);
+    free(corpus);
+    return 0;
+}
@@ -102,13 +102,14 @@
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_io_linux.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
 
 using namespace std;
 
-static const char * version_str = "1.44 20190906";
+static const char * version_str = "1.48 20261017";
 
 #ifdef __GNUC__
 #ifndef  __clang__
@@ -142,6 +143,12 @@ static const char * version_str = "1.44 20190906";
 #define DEF_NUM_THREADS 4
 #define MAX_NUM_THREADS 1024 /* was SG_MAX_QUEUE with v3 driver */
 #define DEF_NUM_MRQS 0
+#define DEF_AUTO_MAX_THREADS 64 /* upper limit for thr=auto */
+#define DEF_AUTO_MRQS 8         /* mrq=auto starting point, ... */
+#define MAX_AUTO_MRQS 256       /* ... then tried between 2 and this */
+#define AUTO_TUNE_MS 250        /* settle, then measure, for this long */
+#define AUTO_TUNE_GAIN_PCT 5    /* less than this is a plateau */
+#define AUTO_TUNE_MAX_ROUNDS 3  /* in case thr and mrq keep trading off */
 
 #ifndef RAW_MAJOR
 #define RAW_MAJOR 255   /*unlikely value */
@@ -235,6 +242,16 @@ typedef struct global_collection
     bool unit_nanosec;          /* default duration unit is millisecond */
     bool mrq_cmds;              /* mrq=<NRQS>,C  given */
     bool mrq_async;             /* any mrq_immed or no_waitq flags given */
+    bool numa_pin;              /* numa=1 and HBA local CPUs known */
+    bool thr_auto;              /* thr=auto[,MAX] given */
+    bool mrq_auto;              /* mrq=auto[,C] given and usable */
+    int numa_node;              /* of that HBA, -1 if not known */
+    int thr_max;                /* MAX of thr=auto, threads created */
+    uint64_t p99_max_ns;        /* p99=USECS bound, 0 for no bound */
+    atomic<int> act_threads;    /* with thr=auto workers with lower ids */
+    atomic<int> auto_nmrqs;     /* with mrq=auto workers switch to this */
+    uint64_t cpu_mask[SG_CPU_MASK_WORDS];   /* HBA local CPUs */
+    struct sg_hash_stage * hash_stagep; /* when hash= given */
     const char * infp;
     const char * outfp;
     const char * out2fp;
@@ -290,6 +307,8 @@ typedef struct request_element
     int mrq_id;
     uint32_t in_mrq_q_blks;
     uint32_t out_mrq_q_blks;
+    uint64_t lat_start_ns[2];   /* [0] for READ, [1] for WRITE; 0 when */
+    uint8_t lat_opcode[2];      /* latency histograms are not active */
     pthread_t mrq_abort_thread_id;
     Mrq_abort_info mai;
     struct flags_t in_flags;
@@ -302,6 +321,10 @@ typedef struct thread_info
     int id;
     Gbl_coll * gcp;
     pthread_t a_pthr;
+    int cpu;                    /* -\ numa=1 statistics: CPU and node at */
+    int node;                   /*  | the last transfer, transfers and */
+    int64_t xfers;              /*  | how many of them had a buffer on */
+    int64_t local;              /* -/ 'node' */
 } Thread_info;
 
 #define MONO_MRQ_ID_INIT 0x10000
@@ -329,6 +352,7 @@ private:
 static atomic<int> mono_pack_id(1);
 static atomic<int> mono_mrq_id(MONO_MRQ_ID_INIT);
 static atomic<long int> pos_index(0);
+static atomic<bool> auto_tune_stop(false);
 
 static atomic<int> num_ebusy(0);
 static atomic<int> num_start_eagain(0);
@@ -340,6 +364,8 @@ static atomic<int> num_mrq_abort_req_success(0);
 
 static sigset_t signal_set;
 static pthread_t sig_listen_thread_id;
+static pthread_t hash_thr_arr[SG_HASH_MAX_THR];
+static int num_hash_thr;
 
 static const char * proc_allow_dio = "/proc/scsi/sg/allow_dio";
 
@@ -361,14 +387,13 @@ static int sgh_do_deferred_mrq(Rq_elem * rep, mrq_arr_t & def_arr);
 
 #define STRERR_BUFF_LEN 128
 
-static pthread_mutex_t strerr_mut = PTHREAD_MUTEX_INITIALIZER;
-
 static bool have_sg_version = false;
 static int sg_version = 0;
 static bool sg_version_lt_4 = false;
 static bool sg_version_ge_40030 = false;
 static bool shutting_down = false;
 static bool do_sync = false;
+static bool do_numa = false;
 static bool do_time = true;
 static Gbl_coll gcoll;
 static struct timeval start_tm;
@@ -403,11 +428,9 @@ pr2serr_lk(const char * fmt, ...)
     int n;
     va_list args;
 
-    pthread_mutex_lock(&strerr_mut);
     va_start(args, fmt);
-    n = vfprintf(stderr, fmt, args);
+    n = sg_log_vpr(stderr, fmt, args);
     va_end(args);
-    pthread_mutex_unlock(&strerr_mut);
     return n;
 }
 
@@ -416,56 +439,56 @@ static void
 pr_errno_lk(int e_no, const char * fmt, ...)
 {
     char b[180];
+    char strerr_buff[STRERR_BUFF_LEN];
     va_list args;
 
-    pthread_mutex_lock(&strerr_mut);
     va_start(args, fmt);
     vsnprintf(b, sizeof(b), fmt, args);
-    fprintf(stderr, "%s: %s\n", b, strerror(e_no));
+    pr2serr("%s: %s\n", b, sg_strerror_r(e_no, strerr_buff,
+                                          STRERR_BUFF_LEN));
     va_end(args);
-    pthread_mutex_unlock(&strerr_mut);
 }
 #endif
 
 static void
 lk_print_command(uint8_t * cmdp)
 {
-    pthread_mutex_lock(&strerr_mut);
+    sg_log_ring_hold();
     sg_print_command(cmdp);
-    pthread_mutex_unlock(&strerr_mut);
+    sg_log_ring_release();
 }
 
 static void
 lk_chk_n_print3(const char * leadin, struct sg_io_hdr * hp, bool raw_sinfo)
 {
-    pthread_mutex_lock(&strerr_mut);
+    sg_log_ring_hold();
     sg_chk_n_print3(leadin, hp, raw_sinfo);
-    pthread_mutex_unlock(&strerr_mut);
+    sg_log_ring_release();
 }
 
 static void
 lk_chk_n_print4(const char * leadin, const struct sg_io_v4 * h4p,
                 bool raw_sinfo)
 {
-    pthread_mutex_lock(&strerr_mut);
+    sg_log_ring_hold();
     sg_linux_sense_print(leadin, h4p->device_status, h4p->transport_status,
                          h4p->driver_status, (const uint8_t *)h4p->response,
                          h4p->response_len, raw_sinfo);
-    pthread_mutex_unlock(&strerr_mut);
+    sg_log_ring_release();
 }
 
 static void
 hex2stderr_lk(const uint8_t * b_str, int len, int no_ascii)
 {
-    pthread_mutex_lock(&strerr_mut);
+    sg_log_ring_hold();
     hex2stderr(b_str, len, no_ascii);
-    pthread_mutex_unlock(&strerr_mut);
+    sg_log_ring_release();
 }
 
 static void
 v4hdr_out_lk(const char * leadin, const sg_io_v4 * h4p, int id)
 {
-    pthread_mutex_lock(&strerr_mut);
+    sg_log_ring_hold();
     if (leadin)
         pr2serr("%s [id=%d]:\n", leadin, id);
     if (('Q' != h4p->guard) || (0 != h4p->protocol) ||
@@ -486,7 +509,7 @@ v4hdr_out_lk(const char * leadin, const sg_io_v4 * h4p, int id)
             h4p->transport_status, h4p->device_status);
     pr2serr("  info=0x%x  din_resid=%u  dout_resid=%u  spare_out=%u\n",
             h4p->info, h4p->din_resid, h4p->dout_resid, h4p->spare_out);
-    pthread_mutex_unlock(&strerr_mut);
+    sg_log_ring_release();
 }
 
 static unsigned int
@@ -632,15 +655,7 @@ thread_exit_handler(int sig)
 static char *
 tsafe_strerror(int code, char * ebp)
 {
-    char * cp;
-
-    pthread_mutex_lock(&strerr_mut);
-    cp = safe_strerror(code);
-    strncpy(ebp, cp, STRERR_BUFF_LEN);
-    pthread_mutex_unlock(&strerr_mut);
-
-    ebp[STRERR_BUFF_LEN - 1] = '\0';
-    return ebp;
+    return sg_strerror_r(code, ebp, STRERR_BUFF_LEN);
 }
 
 
@@ -699,10 +714,13 @@ usage(int pg_num)
             "[coe=0|1]\n"
             "               [deb=VERB] [dio=0|1] [elemsz_kb=ESK] "
             "[fua=0|1|2|3]\n"
-            "               [mrq=NRQS[,C]] [of2=OFILE2] [ofreg=OFREG] "
-            "[sync=0|1]\n"
-            "               [thr=THR] [time=0|1] [verbose=VERB] [--dry-run] "
-            "[--verbose]\n\n"
+            "               [hash=ALG[,THR]] [manifest=MFILE] "
+            "[mrq=NRQS[,C]|auto[,C]]\n"
+            "               [numa=0|1] [of2=OFILE2] [ofreg=OFREG] "
+            "[p99=USECS] [sync=0|1]\n"
+            "               [thr=THR|auto[,MAX]] [time=0|1] [verbose=VERB] "
+            "[verify=MFILE]\n"
+            "               [--dry-run] [--verbose]\n\n"
             "  where the main options (shown in first group above) are:\n"
             "    bs          must be device logical block size (default "
             "512)\n"
@@ -762,19 +780,41 @@ page2:
             "    fua         force unit access: 0->don't(def), 1->OFILE, "
             "2->IFILE,\n"
             "                3->OFILE+IFILE\n"
+            "    hash        hash data read with ALG: crc32c or xxh64, on "
+            "THR threads\n"
+            "                (def: 2); outputs stream hash (def: crc32c "
+            "if MFILE given).\n"
+            "                Not with mrq=, iflag=noxfer nor swait when "
+            "IFILE is sg\n"
+            "    manifest    write hash of each BPT blocks read to MFILE\n"
             "    mrq         even number of cmds placed in each sg call "
             "(def: 0);\n"
-            "                may have trailing ',C', to send bulk cdb_s\n"
+            "                may have trailing ',C', to send bulk cdb_s; "
+            "'auto' tunes\n"
+            "                it while copying, see 'thr=auto'\n"
+            "    numa        0->default placement (def), 1->bind workers to "
+            "the CPUs\n"
+            "                local to the HBA of IFILE (else OFILE)\n"
             "    ofreg       OFREG is regular file or pipe to send what is "
             "read from\n"
             "                IFILE in the first half of each shared element\n"
+            "    p99         with 'auto': reject points where the p99 "
+            "latency of sg\n"
+            "                commands exceeds USECS microseconds (def: no "
+            "bound)\n"
             "    sync        0->no sync(def), 1->SYNCHRONIZE CACHE on OFILE "
             "after copy\n"
             "    thr         is number of threads, must be > 0, default 4, "
-            "max 1024\n"
+            "max 1024;\n"
+            "                'auto' starts MAX (def: 64) threads then, like "
+            "mrq=auto,\n"
+            "                doubles or halves how many copy while "
+            "throughput rises\n"
             "    time        0->no timing, 1->time plus calculate "
             "throughput (def)\n"
             "    verbose     same as 'deb=VERB': increase verbosity\n"
+            "    verify      check hashes against MFILE from earlier "
+            "manifest=MFILE\n"
             "    --dry-run|-d    prepare but bypass copy/read\n"
             "    --verbose|-v   increase verbosity of utility\n\n"
             "Use '-hhh' or '-hhhh' for more information about flags.\n"
@@ -963,6 +1003,7 @@ mrq_abort_thread(void * v_maip)
     unsigned int rn;
     Mrq_abort_info l_mai = *(Mrq_abort_info *)v_maip;
     struct sg_io_v4 ctl_v4;
+    char strerr_buff[STRERR_BUFF_LEN];
 
     if (l_mai.debug)
         pr2serr_lk("%s: from_id=%d: to abort mrq_pack_id=%d\n", __func__,
@@ -971,7 +1012,7 @@ mrq_abort_thread(void * v_maip)
     if (res < 0) {
         err = errno;
         pr2serr_lk("%s: ioctl(SG_GET_NUM_WAITING) failed: %s [%d]\n",
-                   __func__, safe_strerror(err), err);
+                   __func__, tsafe_strerror(err, strerr_buff), err);
     } else if (l_mai.debug)
         pr2serr_lk("%s: num_waiting=%d\n", __func__, n);
 
@@ -1001,7 +1042,7 @@ mrq_abort_thread(void * v_maip)
                        "MRQ pack_id=%d\n", __func__, l_mai.mrq_id);
         else
             pr2serr_lk("%s: MRQ ioctl(SG_IOABORT) failed: %s [%d]\n",
-                       __func__, safe_strerror(err), err);
+                       __func__, tsafe_strerror(err, strerr_buff), err);
     } else {
         ++num_mrq_abort_req_success;
         if (l_mai.debug > 1)
@@ -1017,6 +1058,7 @@ sg_share_prepare(int slave_wr_fd, int master_rd_fd, int id, bool vb_b)
 {
     struct sg_extended_info sei;
     struct sg_extended_info * seip;
+    char strerr_buff[STRERR_BUFF_LEN];
 
     seip = &sei;
     memset(seip, 0, sizeof(*seip));
@@ -1026,7 +1068,7 @@ sg_share_prepare(int slave_wr_fd, int master_rd_fd, int id, bool vb_b)
     if (ioctl(slave_wr_fd, SG_SET_GET_EXTENDED, seip) < 0) {
         pr2serr_lk("tid=%d: ioctl(EXTENDED(shared_fd=%d), failed "
                    "errno=%d %s\n", id, master_rd_fd, errno,
-                   strerror(errno));
+                   tsafe_strerror(errno, strerr_buff));
         return false;
     }
     if (vb_b)
@@ -1041,6 +1083,7 @@ sg_take_snap(int sg_fd, int id, bool vb_b)
 {
     struct sg_extended_info sei;
     struct sg_extended_info * seip;
+    char strerr_buff[STRERR_BUFF_LEN];
 
     seip = &sei;
     memset(seip, 0, sizeof(*seip));
@@ -1050,7 +1093,7 @@ sg_take_snap(int sg_fd, int id, bool vb_b)
     seip->ctl_flags &= SG_CTL_FLAGM_SNAP_DEV;   /* don't append */
     if (ioctl(sg_fd, SG_SET_GET_EXTENDED, seip) < 0) {
         pr2serr_lk("tid=%d: ioctl(EXTENDED(SNAP_DEV), failed errno=%d %s\n",
-                   id,  errno, strerror(errno));
+                   id,  errno, tsafe_strerror(errno, strerr_buff));
         return;
     }
     if (vb_b)
@@ -1080,6 +1123,222 @@ cleanup_out(void * v_clp)
     pthread_cond_broadcast(&clp->out_sync_cv);
 }
 
+/* With numa=1, looks for the CPUs local to the HBA of IFILE and failing
+ * that of OFILE. Workers are then bound to those CPUs so they, and the
+ * buffers they allocate (or mmap) first, are on the HBA's node. */
+static void
+numa_setup(Gbl_coll * clp)
+{
+    int k, n;
+    const char * cp = "IFILE";
+
+    clp->numa_node = sg_get_fd_numa(clp->infd, clp->cpu_mask,
+                                    SG_CPU_MASK_WORDS, clp->debug);
+    for (k = 0, n = 0; k < SG_CPU_MASK_WORDS; ++k)
+        n += __builtin_popcountll(clp->cpu_mask[k]);
+    if ((0 == n) && (clp->outfd >= 0)) {
+        cp = "OFILE";
+        clp->numa_node = sg_get_fd_numa(clp->outfd, clp->cpu_mask,
+                                        SG_CPU_MASK_WORDS, clp->debug);
+        for (k = 0, n = 0; k < SG_CPU_MASK_WORDS; ++k)
+            n += __builtin_popcountll(clp->cpu_mask[k]);
+    }
+    if (n > 0) {
+        clp->numa_pin = true;
+        if (clp->debug)
+            pr2serr("numa: bind workers to the %d CPUs local to the %s "
+                    "HBA (node %d)\n", n, cp, clp->numa_node);
+    } else
+        pr2serr("numa=1: HBA local CPUs of IFILE and OFILE not known, "
+                "workers not bound\n");
+}
+
+/* Counts a transfer, noting if its buffer is on this worker's node */
+static void
+numa_account(Thread_info * tip, const uint8_t * bp)
+{
+    tip->node = sg_get_thread_numa(&tip->cpu);
+    ++tip->xfers;
+    if ((tip->node >= 0) && (tip->node == sg_get_addr_numa(bp)))
+        ++tip->local;
+}
+
+static void
+numa_report(const Gbl_coll * clp, const Thread_info * thread_arr)
+{
+    int k;
+    int64_t xfers = 0;
+    int64_t local = 0;
+    const Thread_info * tip;
+
+    for (k = 0, tip = thread_arr; k < num_threads; ++k, ++tip) {
+        if (clp->debug)
+            pr2serr("  worker %d: cpu=%d node=%d, %" PRId64 " of %" PRId64
+                    " transfers with node local buffer\n", k, tip->cpu,
+                    tip->node, tip->local, tip->xfers);
+        xfers += tip->xfers;
+        local += tip->local;
+    }
+    pr2serr(">> numa: %" PRId64 " of %" PRId64 " transfers with buffer on "
+            "the worker's node\n", local, xfers);
+}
+
+/* Adds one latency sample per command in def_arr, all taken to have
+ * started at start_ns. The commands of a mrq complete as a batch so this
+ * is the batch latency rather than that of each command. */
+static void
+lat_add_mrq(const mrq_arr_t & def_arr, uint64_t start_ns)
+{
+    uint64_t lat_ns = sg_pt_trace_now_ns() - start_ns;
+
+    for (const big_cdb & cdb : def_arr.second)
+        sg_pt_lat_hist_add(SG_PT_LAT_SCSI, cdb[0], lat_ns);
+}
+
+static bool
+auto_copy_over(const Gbl_coll * clp)
+{
+    return auto_tune_stop.load() || clp->in_stop.load() ||
+           clp->out_stop.load() || (clp->out_rem_count.load() <= 0) ||
+           ((dd_count >= 0) && (pos_index.load() >= dd_count));
+}
+
+struct auto_point {
+    int thr;
+    int nmrqs;
+    double mbps;
+    uint64_t p99_ns;    /* largest p99 over opcodes, 0 if no sg commands */
+};
+
+/* Lets the workers settle at point *app then measures it for an interval.
+ * The p99 is taken from the latency samples added during that interval
+ * so the histograms are left intact for a SG3_UTILS_LAT_HIST report.
+ * Returns false if the copy ends first. */
+static bool
+auto_measure(Gbl_coll * clp, struct auto_point * app)
+{
+    int k, n;
+    int64_t rem = 0;
+    uint64_t t = 0;
+    struct sg_pt_lat_mark * markp = NULL;
+    struct sg_pt_lat_stats ls[8];
+    struct timespec tspec = {0, 10000000};   /* 10 milliseconds */
+
+    if (clp->thr_auto)
+        clp->act_threads = app->thr;
+    if (clp->mrq_auto)
+        clp->auto_nmrqs = app->nmrqs;
+    for (k = 0; k < 2; ++k) {
+        if (1 == k) {           /* first interval for settling */
+            markp = sg_pt_lat_hist_mark();
+            rem = clp->out_rem_count.load();
+            t = sg_pt_trace_now_ns();
+        }
+        for (n = 0; n < (AUTO_TUNE_MS / 10); ++n) {
+            if (auto_copy_over(clp)) {
+                sg_pt_lat_hist_mark_free(markp);
+                return false;
+            }
+            nanosleep(&tspec, NULL);
+        }
+    }
+    t = sg_pt_trace_now_ns() - t;
+    app->mbps = (t > 0) ? ((double)(rem - clp->out_rem_count.load()) *
+                           clp->bs * 1000.0 / (double)t) : 0.0;
+    app->p99_ns = 0;
+    n = sg_pt_lat_hist_since(markp, ls, 8);
+    sg_pt_lat_hist_mark_free(markp);
+    for (k = 0; k < n && k < 8; ++k) {
+        if (ls[k].p99_ns > app->p99_ns)
+            app->p99_ns = ls[k].p99_ns;
+    }
+    if (clp->debug)
+        pr2serr_lk("auto tune: thr=%d mrq=%d: %.1f MB/s, p99 %" PRIu64
+                   " us\n", app->thr, app->nmrqs, app->mbps,
+                   app->p99_ns / 1000);
+    return true;
+}
+
+/* Is point *ap better than *bestp? Only if its throughput rises by more
+ * than AUTO_TUNE_GAIN_PCT within the p99 bound; or if *bestp is over that
+ * bound, when its p99 falls without throughput dropping much. */
+static bool
+auto_better(const Gbl_coll * clp, const struct auto_point * ap,
+            const struct auto_point * bestp)
+{
+    uint64_t mx = clp->p99_max_ns;
+
+    if (mx && (bestp->p99_ns > mx))
+        return (ap->p99_ns < bestp->p99_ns) &&
+               (ap->mbps * (100 + AUTO_TUNE_GAIN_PCT) > bestp->mbps * 100);
+    if (mx && (ap->p99_ns > mx))
+        return false;
+    return ap->mbps * 100 > bestp->mbps * (100 + AUTO_TUNE_GAIN_PCT);
+}
+
+/* Hill climbs the number of active workers (thr=auto) and then the mrq
+ * batch size (mrq=auto): each is doubled while that is better, otherwise
+ * halved while that is better. Rounds repeat until one makes no change
+ * (at most AUTO_TUNE_MAX_ROUNDS), then the chosen operating point is
+ * reported. */
+static void *
+auto_tune_thread(void * v_clp)
+{
+    Gbl_coll * clp = (Gbl_coll *)v_clp;
+    bool changed, moved;
+    int knob, dir, round;
+    struct auto_point best, cand;
+
+    sg_pt_lat_hist_enable(true);
+    memset(&best, 0, sizeof(best));
+    best.thr = clp->act_threads.load();
+    best.nmrqs = clp->auto_nmrqs.load();
+    if (! auto_measure(clp, &best))
+        goto fini;
+    for (round = 0, changed = true; changed && (round < AUTO_TUNE_MAX_ROUNDS);
+         ++round) {
+        changed = false;
+        for (knob = 0; knob < 2; ++knob) {
+            if (! (knob ? clp->mrq_auto : clp->thr_auto))
+                continue;
+            for (dir = 1, moved = false; (dir >= -1) && (! moved);
+                 dir -= 2) {
+                while (true) {
+                    cand = best;
+                    if (0 == knob)
+                        cand.thr = (dir > 0) ? (2 * best.thr) : best.thr / 2;
+                    else
+                        cand.nmrqs = (dir > 0) ? (2 * best.nmrqs) :
+                                                 best.nmrqs / 2;
+                    if ((cand.thr < 1) || (cand.thr > clp->thr_max) ||
+                        (cand.nmrqs < 0) || (cand.nmrqs > MAX_AUTO_MRQS) ||
+                        (clp->mrq_auto && (cand.nmrqs < 2)))
+                        break;
+                    if (! auto_measure(clp, &cand))
+                        goto fini;
+                    if (! auto_better(clp, &cand, &best))
+                        break;
+                    best = cand;
+                    moved = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+    if (clp->thr_auto)
+        clp->act_threads = best.thr;
+    if (clp->mrq_auto)
+        clp->auto_nmrqs = best.nmrqs;
+    pr2serr_lk(">> auto tune: settled on thr=%d mrq=%d (%.1f MB/s, p99 %"
+               PRIu64 " us)\n", best.thr, best.nmrqs, best.mbps,
+               best.p99_ns / 1000);
+    return NULL;
+fini:
+    pr2serr_lk(">> auto tune: copy ended before settling; at thr=%d "
+               "mrq=%d\n", clp->act_threads.load(), clp->auto_nmrqs.load());
+    return NULL;
+}
+
 static void *
 read_write_thread(void * v_tip)
 {
@@ -1096,6 +1355,7 @@ read_write_thread(void * v_tip)
     bool own_out2fd = false;
     bool share_and_ofreg;
     mrq_arr_t deferred_arr;  /* MRQ deferred array (vector) */
+    char strerr_buff[STRERR_BUFF_LEN];
 
     tip = (Thread_info *)v_tip;
     clp = tip->gcp;
@@ -1106,6 +1366,13 @@ read_write_thread(void * v_tip)
     rep->id = tip->id;
     if (vb > 2)
         pr2serr_lk("%d <-- Starting worker thread\n", rep->id);
+    /* bind before buffers are allocated or sg devices opened (and maybe
+     * mmap-ed) so those are node local */
+    if (do_numa && clp->numa_pin &&
+        (status = sg_set_thread_cpus(clp->cpu_mask, SG_CPU_MASK_WORDS))) {
+        pr2serr_lk("thread=%d: unable to bind to HBA local CPUs: %s\n",
+                   rep->id, tsafe_strerror(status, strerr_buff));
+    }
     if (! clp->in_flags.mmap) {
         rep->buffp = sg_memalign(sz, 0 /* page align */, &rep->alloc_bp,
                                  false);
@@ -1224,6 +1491,28 @@ read_write_thread(void * v_tip)
 
     /* vvvvvvvvvvvvvv  Main segment copy loop  vvvvvvvvvvvvvvvvvvvvvvv */
     while (1) {
+        if (clp->thr_auto && (rep->id >= clp->act_threads.load())) {
+            struct timespec tspec = {0, 1000000};   /* 1 millisecond */
+
+            if (deferred_arr.first.size() > 0) {
+                /* mrq commands queued by this worker hold claimed blocks,
+                 * send them now or those blocks are never copied */
+                if (rep->debug > 2)
+                    pr2serr_lk("thread=%d: parked, to_do=%u\n", rep->id,
+                               (uint32_t)deferred_arr.first.size());
+                res = sgh_do_deferred_mrq(rep, deferred_arr);
+            }
+            /* parked by auto_tune_thread() with no block claimed, so the
+             * in order writes of the active workers don't wait for us */
+            if (auto_copy_over(clp))
+                break;  /* nothing left to claim so leave loop >>>>>>>> */
+            nanosleep(&tspec, NULL);
+            continue;
+        }
+        if (clp->mrq_auto && deferred_arr.first.empty())
+            rep->nmrqs = clp->auto_nmrqs.load();
+        if (clp->hash_stagep && rep->buffp)  /* may still be being hashed */
+            sg_hash_stage_wait(clp->hash_stagep, rep->buffp);
         rep->wr = false;
         my_index = atomic_fetch_add(&pos_index, (long int)clp->bpt);
         /* Start of READ half of a segment */
@@ -1269,6 +1558,12 @@ read_write_thread(void * v_tip)
         }
         pthread_cleanup_pop(0);
         ++rep->rep_count;
+        if (do_numa && rep->buffp && (rep->num_blks > 0))
+            numa_account(tip, rep->buffp);
+        if (clp->hash_stagep && (rep->num_blks > 0) &&
+            (! clp->out_stop.load()))
+            sg_hash_stage_submit(clp->hash_stagep, my_index, rep->buffp,
+                                 rep->num_blks);
 
         /* Start of WRITE part of a segment */
         rep->wr = true;
@@ -1310,7 +1605,8 @@ skip_force_out_sequence:
             err = errno;
             if (res < 0)
                 pr2serr_lk("%s: tid=%d: write(outregfd) failed: %s\n",
-                           __func__, rep->id, strerror(err));
+                           __func__, rep->id,
+                           tsafe_strerror(err, strerr_buff));
             else if (rep->debug > 9)
                 pr2serr_lk("%s: tid=%d: write(outregfd), fd=%d, num_blks=%d"
                            "\n", __func__, rep->id, rep->outregfd,
@@ -1376,6 +1672,8 @@ skip_force_out_sequence:
     if (0 != status) err_exit(status, "unlock in_mutex");
 
 fini:
+    if (clp->hash_stagep && rep->buffp)
+        sg_hash_stage_wait(clp->hash_stagep, rep->buffp);
     if (rep->mmap_len > 0) {
         if (munmap(rep->buffp, rep->mmap_len) < 0) {
             int err = errno;
@@ -1410,7 +1708,7 @@ normal_in_rd(Gbl_coll * clp, Rq_elem * rep, int blocks)
 
         if (lseek64(rep->infd, pos, SEEK_SET) < 0) {    /* problem if pipe! */
             pr2serr_lk("%s: tid=%d: >> lseek64(%" PRId64 "): %s\n", __func__,
-                       rep->id, pos, safe_strerror(errno));
+                       rep->id, pos, tsafe_strerror(errno, strerr_buff));
             stop_both(clp);
             return true;
         }
@@ -1443,6 +1741,8 @@ normal_in_rd(Gbl_coll * clp, Rq_elem * rep, int blocks)
         if ((res % clp->bs) > 0) {
             blocks++;
             clp->in_partial++;
+            if (clp->hash_stagep)   /* so hash is of what is written */
+                memset(rep->buffp + res, 0, (blocks * clp->bs) - res);
         }
         /* Reverse out + re-apply blocks on clp */
         // clp->in_blk -= o_blocks;
@@ -1642,6 +1942,7 @@ sg_wr_swap_share(Rq_elem * rep, int to_fd, bool before)
     int master_fd = rep->infd;  /* in (READ) side is master */
     struct sg_extended_info sei;
     struct sg_extended_info * seip;
+    char strerr_buff[STRERR_BUFF_LEN];
 
     seip = &sei;
     memset(seip, 0, sizeof(*seip));
@@ -1662,7 +1963,7 @@ sg_wr_swap_share(Rq_elem * rep, int to_fd, bool before)
             if (rep->debug > 9)
                 pr2serr_lk("tid=%d: ioctl(EXTENDED(change_shared_fd=%d), "
                            "failed errno=%d %s\n", rep->id, master_fd, err,
-                           strerror(err));
+                           tsafe_strerror(err, strerr_buff));
             not_first = true;
         }
         err = 0;
@@ -1670,7 +1971,8 @@ sg_wr_swap_share(Rq_elem * rep, int to_fd, bool before)
     }
     if (err) {
         pr2serr_lk("tid=%d: ioctl(EXTENDED(change_shared_fd=%d), failed "
-                   "errno=%d %s\n", rep->id, master_fd, err, strerror(err));
+                   "errno=%d %s\n", rep->id, master_fd, err,
+                   tsafe_strerror(err, strerr_buff));
         return false;
     }
     if (rep->debug > 15)
@@ -1775,6 +2077,7 @@ chk_mrq_response(Rq_elem * rep, const struct sg_io_v4 * ctl_v4p,
     uint32_t good_inblks = 0;
     uint32_t good_outblks = 0;
     const struct sg_io_v4 * a_np = a_v4p;
+    char strerr_buff[STRERR_BUFF_LEN];
 
     if (n_subm < 0) {
         pr2serr_lk("[%d] %s: co.dout_resid(%d) > nrq(%d)\n", id, __func__,
@@ -1791,7 +2094,8 @@ chk_mrq_response(Rq_elem * rep, const struct sg_io_v4 * ctl_v4p,
     }
     if (sres)
         pr2serr_lk("[%d] %s: secondary error: %s [%d], info=0x%x\n", id,
-                   __func__, strerror(sres), sres, ctl_v4p->info);
+                   __func__,
+                   tsafe_strerror(sres, strerr_buff), sres, ctl_v4p->info);
     /* Check if those submitted have finished or not */
     for (k = 0; k < n_subm; ++k, ++a_np) {
         slen = a_np->response_len;
@@ -1869,6 +2173,7 @@ sgh_do_async_mrq(Rq_elem * rep, mrq_arr_t & def_arr, int fd,
     const char * rec_str = "SG_IORECEIVE, MULTIPLE_REQS | IMMED";
     struct sg_io_v4 * a_v4p;
     struct sg_io_v4 hold_ctlo;
+    char strerr_buff[STRERR_BUFF_LEN];
 
     hold_ctlo = *ctlop;
     a_v4p = def_arr.first.data();
@@ -1890,7 +2195,7 @@ sgh_do_async_mrq(Rq_elem * rep, mrq_arr_t & def_arr, int fd,
         err = errno;
         pr2serr_lk("%s: ioctl(%s%s)-->%d, errno=%d: %s\n", __func__,
                    sub_str, (wless ? "NO_WAITQ" : "IMMED"), res, err,
-                   strerror(err));
+                   tsafe_strerror(err, strerr_buff));
         return -1;
     }
     /* fetch first half */
@@ -1899,7 +2204,7 @@ sgh_do_async_mrq(Rq_elem * rep, mrq_arr_t & def_arr, int fd,
         if (res < 0) {
             err = errno;
             pr2serr_lk("%s: ioctl(SG_GET_NUM_WAITING)-->%d, errno=%d: %s\n",
-                       __func__, res, err, strerror(err));
+                       __func__, res, err, tsafe_strerror(err, strerr_buff));
             return -1;
         }
         if (nwait >= half)
@@ -1912,7 +2217,7 @@ sgh_do_async_mrq(Rq_elem * rep, mrq_arr_t & def_arr, int fd,
         err = errno;
         if (ENODATA != err) {
             pr2serr_lk("%s: ioctl(%s),1-->%d, errno=%d: %s\n", __func__,
-                       rec_str, res, err, strerror(err));
+                       rec_str, res, err, tsafe_strerror(err, strerr_buff));
             return -1;
         }
         half_num = 0;
@@ -1964,7 +2269,8 @@ sgh_do_async_mrq(Rq_elem * rep, mrq_arr_t & def_arr, int fd,
         res = ioctl(fd, SG_GET_NUM_WAITING, &nwait);
         if (res < 0) {
             pr2serr_lk("%s: ioctl(SG_GET_NUM_WAITING)-->%d, errno=%d: %s\n",
-                       __func__, res, errno, strerror(errno));
+                       __func__, res, errno,
+                       tsafe_strerror(errno, strerr_buff));
             return -1;
         }
         if (nwait >= rest)
@@ -1982,7 +2288,7 @@ sgh_do_async_mrq(Rq_elem * rep, mrq_arr_t & def_arr, int fd,
         err = errno;
         if (ENODATA != err) {
             pr2serr_lk("%s: ioctl(%s),2-->%d, errno=%d: %s\n", __func__,
-                       rec_str, res, err, strerror(err));
+                       rec_str, res, err, tsafe_strerror(err, strerr_buff));
             return -1;
         }
         half_num = 0;
@@ -2072,10 +2378,12 @@ sgh_do_deferred_mrq(Rq_elem * rep, mrq_arr_t & def_arr)
     bool launch_mrq_abort = false;
     int nrq, k, res, fd, mrq_pack_id, status, id, num_good;
     uint32_t in_fin_blks, out_fin_blks;
+    uint64_t start_ns;
     const int max_cdb_sz = 16;
     struct sg_io_v4 * a_v4p;
     struct sg_io_v4 ctl_v4;
     uint8_t * cmd_ap = NULL;
+    char strerr_buff[STRERR_BUFF_LEN];
 
     id = rep->id;
     memset(&ctl_v4, 0, sizeof(ctl_v4));
@@ -2150,6 +2458,7 @@ sgh_do_deferred_mrq(Rq_elem * rep, mrq_arr_t & def_arr)
     }
     ctl_v4.request_extra = launch_mrq_abort ? mrq_pack_id : 0;
     rep->mrq_id = mrq_pack_id;
+    start_ns = sg_pt_lat_hist_active() ? sg_pt_trace_now_ns() : 0;
     if (rep->debug > 4) {
         pr2serr_lk("%s: Controlling object _before_ ioctl(SG_IO):\n",
                    __func__);
@@ -2189,6 +2498,8 @@ sgh_do_deferred_mrq(Rq_elem * rep, mrq_arr_t & def_arr)
             fd_ctl.din_xfer_len = num_fd * sizeof(*aa_v4p);
             fd_ctl.request_extra = launch_mrq_abort ? mrq_pack_id : 0;
             res = sgh_do_async_mrq(rep, fd_def_arr, fd, &fd_ctl, num_fd);
+            if (start_ns && (0 == res))
+                lat_add_mrq(fd_def_arr, start_ns);
             rep->in_mrq_q_blks = 0;
             if (res)
                 goto fini;
@@ -2220,6 +2531,8 @@ sgh_do_deferred_mrq(Rq_elem * rep, mrq_arr_t & def_arr)
             o_fd_ctl.request_extra = launch_mrq_abort ? mrq_pack_id : 0;
             res = sgh_do_async_mrq(rep, o_fd_def_arr, rep->outfd, &o_fd_ctl,
                                    o_num_fd);
+            if (start_ns && (0 == res))
+                lat_add_mrq(o_fd_def_arr, start_ns);
             rep->out_mrq_q_blks = 0;
         }
         goto fini;
@@ -2228,10 +2541,12 @@ sgh_do_deferred_mrq(Rq_elem * rep, mrq_arr_t & def_arr)
     res = ioctl(fd, SG_IO, &ctl_v4); // MULTIPLE_REQS | STOP_IF
     if (res < 0) {
         pr2serr_lk("%s: ioctl(SG_IO, MULTIPLE_REQS)-->%d, errno=%d: %s\n",
-                   __func__, res, errno, strerror(errno));
+                   __func__, res, errno, tsafe_strerror(errno, strerr_buff));
         res = -1;
         goto fini;
     }
+    if (start_ns)
+        lat_add_mrq(def_arr, start_ns);
     if (rep->debug > 4) {
         pr2serr_lk("%s: Controlling object output by ioctl(SG_IO):\n",
                    __func__);
@@ -2312,6 +2627,7 @@ sg_start_io(Rq_elem * rep, mrq_arr_t & def_arr, int & pack_id,
     const char * c2p = "";
     const char * c3p = "";
     const char * crwp;
+    char strerr_buff[STRERR_BUFF_LEN];
 
     if (wr) {
         fd = is_wr2 ? rep->out2fd : rep->outfd;
@@ -2340,8 +2656,8 @@ sg_start_io(Rq_elem * rep, mrq_arr_t & def_arr, int & pack_id,
         flags |= SGV4_FLAG_SHARE;
         if (wr)
             flags |= SGV4_FLAG_NO_DXFER;
-        else if (rep->outregfd < 0)
-            flags |= SGV4_FLAG_NO_DXFER;
+        else if ((rep->outregfd < 0) && (NULL == gcoll.hash_stagep))
+            flags |= SGV4_FLAG_NO_DXFER;    /* hashing needs READ data */
         if (flags & SGV4_FLAG_NO_DXFER)
             c2p = " and FLAG_NO_DXFER";
 
@@ -2364,6 +2680,11 @@ sg_start_io(Rq_elem * rep, mrq_arr_t & def_arr, int & pack_id,
                    c2p, c3p, blk, rep->num_blks);
         lk_print_command(rep->cmd);
     }
+    if (sg_pt_lat_hist_active()) {  /* for mrq see sgh_do_deferred_mrq() */
+        rep->lat_start_ns[wr] = sg_pt_trace_now_ns();
+        rep->lat_opcode[wr] = rep->cmd[0];
+    } else
+        rep->lat_start_ns[wr] = 0;
     if (v4)
         goto do_v4;
 
@@ -2403,7 +2724,7 @@ sg_start_io(Rq_elem * rep, mrq_arr_t & def_arr, int & pack_id,
         if (ENOMEM == err)
             return 1;
         pr2serr_lk("%s tid=%d: %s%s%s write(2) failed: %s\n", __func__,
-                   rep->id, cp, c2p, c3p, strerror(err));
+                   rep->id, cp, c2p, c3p, tsafe_strerror(err, strerr_buff));
         return -1;
     }
     return 0;
@@ -2465,7 +2786,7 @@ do_v4:
         if (ENOMEM == err)
             return 1;
         pr2serr_lk("%s tid=%d: %s%s%s ioctl(2) failed: %s\n", __func__,
-                   rep->id, cp, c2p, c3p, strerror(err));
+                   rep->id, cp, c2p, c3p, tsafe_strerror(err, strerr_buff));
         return -1;
     }
     if ((rep->aen > 0) && (rep->rep_count > 0)) {
@@ -2482,7 +2803,8 @@ do_v4:
             res = poll(&a_poll, 1 /* element */, 1 /* millisecond */);
             if (res < 0)
                 pr2serr_lk("%s: poll() failed: %s [%d]\n",
-                           __func__, safe_strerror(errno), errno);
+                           __func__,
+                           tsafe_strerror(errno, strerr_buff), errno);
             else if (0 == res) { /* timeout, cmd still inflight, so abort */
             }
 #endif
@@ -2495,7 +2817,8 @@ do_v4:
                                "pack_id=%d\n", __func__, pack_id);
                 else
                     pr2serr_lk("%s: ioctl(SG_IOABORT) failed: %s [%d]\n",
-                               __func__, safe_strerror(err), err);
+                               __func__,
+                               tsafe_strerror(err, strerr_buff), err);
             } else {
                 ++num_abort_req_success;
                 if (rep->debug > 1)
@@ -2562,6 +2885,9 @@ sg_finish_io(bool wr, Rq_elem * rep, int pack_id, bool is_wr2)
     }
     if (rep != (Rq_elem *)io_hdr.usr_ptr)
         err_exit(0, "sg_finish_io: bad usr_ptr, request-response mismatch\n");
+    if (rep->lat_start_ns[wr])
+        sg_pt_lat_hist_add(SG_PT_LAT_SCSI, rep->lat_opcode[wr],
+                           sg_pt_trace_now_ns() - rep->lat_start_ns[wr]);
     memcpy(&rep->io_hdr, &io_hdr, sizeof(struct sg_io_hdr));
     hp = &rep->io_hdr;
 
@@ -2630,6 +2956,9 @@ do_v4:
     }
     if (rep != (Rq_elem *)h4p->usr_ptr)
         err_exit(0, "sg_finish_io: bad usr_ptr, request-response mismatch\n");
+    if (rep->lat_start_ns[wr])
+        sg_pt_lat_hist_add(SG_PT_LAT_SCSI, rep->lat_opcode[wr],
+                           sg_pt_trace_now_ns() - rep->lat_start_ns[wr]);
     res = sg_err_category_new(h4p->device_status, h4p->transport_status,
                               h4p->driver_status,
                               (const uint8_t *)h4p->response,
@@ -2854,6 +3183,7 @@ sg_prepare_resbuf(int fd, int bs, int bpt, bool def_res, int elem_sz,
     uint8_t *mmp;
     struct sg_extended_info sei;
     struct sg_extended_info * seip;
+    char strerr_buff[STRERR_BUFF_LEN];
 
     seip = &sei;
     res = ioctl(fd, SG_GET_VERSION_NUM, &t);
@@ -2884,7 +3214,8 @@ sg_prepare_resbuf(int fd, int bs, int bpt, bool def_res, int elem_sz,
         res = ioctl(fd, SG_SET_GET_EXTENDED, seip);
         if (res < 0)
             pr2serr_lk("sgh_dd: %s: SG_SET_GET_EXTENDED(SGAT_ELEM_SZ) rd "
-                       "error: %s\n", __func__, strerror(errno));
+                       "error: %s\n", __func__,
+                       tsafe_strerror(errno, strerr_buff));
         if (elem_sz != (int)seip->sgat_elem_sz) {
             memset(seip, 0, sizeof(*seip));
             seip->sei_wr_mask |= SG_SEIM_SGAT_ELEM_SZ;
@@ -2892,7 +3223,8 @@ sg_prepare_resbuf(int fd, int bs, int bpt, bool def_res, int elem_sz,
             res = ioctl(fd, SG_SET_GET_EXTENDED, seip);
             if (res < 0)
                 pr2serr_lk("sgh_dd: %s: SG_SET_GET_EXTENDED(SGAT_ELEM_SZ) "
-                           "wr error: %s\n", __func__, strerror(errno));
+                           "wr error: %s\n", __func__,
+                           tsafe_strerror(errno, strerr_buff));
         }
     }
     if (no_dur || masync) {
@@ -2913,7 +3245,8 @@ sg_prepare_resbuf(int fd, int bs, int bpt, bool def_res, int elem_sz,
         res = ioctl(fd, SG_SET_GET_EXTENDED, seip);
         if (res < 0)
             pr2serr_lk("sgh_dd: %s: SG_SET_GET_EXTENDED(NO_DURATION) "
-                       "error: %s\n", __func__, strerror(errno));
+                       "error: %s\n", __func__,
+                       tsafe_strerror(errno, strerr_buff));
     }
 bypass:
     if (! def_res) {
@@ -2943,7 +3276,7 @@ bypass:
         if (ioctl(fd, SG_SET_GET_EXTENDED, seip) < 0) {
             res = -1;
             pr2serr_lk("ioctl(EXTENDED(TIME_IN_NS)) failed, errno=%d %s\n",
-                       errno, strerror(errno));
+                       errno, tsafe_strerror(errno, strerr_buff));
         }
     }
 fini:
@@ -3131,6 +3464,10 @@ main(int argc, char * argv[])
     char outf[INOUTF_SZ];
     char out2f[INOUTF_SZ];
     char outregf[INOUTF_SZ];
+    char manf[INOUTF_SZ];
+    char verf[INOUTF_SZ];
+    int hash_alg = 0;
+    int hash_thr = 0;
     int res, k, err, keylen;
     int64_t in_num_sect = 0;
     int64_t out_num_sect = 0;
@@ -3164,6 +3501,8 @@ main(int argc, char * argv[])
     outf[0] = '\0';
     out2f[0] = '\0';
     outregf[0] = '\0';
+    manf[0] = '\0';
+    verf[0] = '\0';
     fetch_sg_version();
     if (sg_version > 40000) {
         clp->in_flags.v4 = true;
@@ -3249,6 +3588,12 @@ main(int argc, char * argv[])
                 clp->out_flags.fua = true;
             if (n & 2)
                 clp->in_flags.fua = true;
+        } else if (0 == strcmp(key, "hash")) {
+            if (! sg_hash_parse(buf, &hash_alg, &hash_thr)) {
+                pr2serr("%sbad argument to 'hash=', expect crc32c or "
+                        "xxh64, optionally followed by ',THR'\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "ibs")) {
             ibs = sg_get_num(buf);
             if (-1 == ibs) {
@@ -3268,8 +3613,15 @@ main(int argc, char * argv[])
                 pr2serr("%sbad argument to 'iflag='\n", my_name);
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "manifest")) {
+            memcpy(manf, buf, INOUTF_SZ - 1);
+            manf[INOUTF_SZ - 1] = '\0';
         } else if (0 == strcmp(key, "mrq")) {
-            clp->nmrqs = sg_get_num(buf);
+            if (0 == strncmp(buf, "auto", 4)) {
+                clp->mrq_auto = true;
+                clp->nmrqs = DEF_AUTO_MRQS;
+            } else
+                clp->nmrqs = sg_get_num(buf);
             if ((-1 == clp->nmrqs) || (1 == (clp->nmrqs % 2))) {
                 pr2serr("%sbad argument to 'mrq=', want even number or "
                         "zero\n", my_name);
@@ -3278,7 +3630,9 @@ main(int argc, char * argv[])
             cp = strchr(buf, ',');
             if (cp && ('C' == toupper(cp[1])))
                 clp->mrq_cmds = true;
-        } else if (0 == strcmp(key, "obs")) {
+        } else if (0 == strcmp(key, "numa"))
+            do_numa = !! sg_get_num(buf);
+        else if (0 == strcmp(key, "obs")) {
             obs = sg_get_num(buf);
             if (-1 == obs) {
                 pr2serr("%sbad argument to 'obs='\n", my_name);
@@ -3300,6 +3654,14 @@ main(int argc, char * argv[])
                 memcpy(outregf, buf, INOUTF_SZ);
                 outregf[INOUTF_SZ - 1] = '\0';  /* noisy compiler */
             }
+        } else if (0 == strcmp(key, "p99")) {
+            n = sg_get_num(buf);
+            if (n < 0) {
+                pr2serr("%sbad argument to 'p99=', want microseconds\n",
+                        my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            clp->p99_max_ns = (uint64_t)n * 1000;
         } else if (strcmp(key, "of") == 0) {
             if ('\0' != outf[0]) {
                 pr2serr("Second 'of=' argument??\n");
@@ -3327,11 +3689,19 @@ main(int argc, char * argv[])
             }
         } else if (0 == strcmp(key, "sync"))
             do_sync = !! sg_get_num(buf);
-        else if (0 == strcmp(key, "thr"))
-            num_threads = sg_get_num(buf);
-        else if (0 == strcmp(key, "time"))
+        else if (0 == strcmp(key, "thr")) {
+            if (0 == strncmp(buf, "auto", 4)) {
+                clp->thr_auto = true;
+                cp = strchr(buf, ',');
+                num_threads = cp ? sg_get_num(cp + 1) : DEF_AUTO_MAX_THREADS;
+            } else
+                num_threads = sg_get_num(buf);
+        } else if (0 == strcmp(key, "time"))
             do_time = !! sg_get_num(buf);
-        else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
+        else if (0 == strcmp(key, "verify")) {
+            memcpy(verf, buf, INOUTF_SZ - 1);
+            verf[INOUTF_SZ - 1] = '\0';
+        } else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
             res = 0;
             n = num_chs_in_str(key + 1, keylen - 1, 'd');
             clp->dry_run += n;
@@ -3453,6 +3823,10 @@ main(int argc, char * argv[])
         usage(1);
         return SG_LIB_SYNTAX_ERROR;
     }
+    clp->thr_max = num_threads;
+    clp->act_threads = clp->thr_auto ? ((num_threads < DEF_NUM_THREADS) ?
+                                        num_threads : DEF_NUM_THREADS) :
+                                       num_threads;
     if (clp->in_flags.swait && (! clp->out_flags.swait)) {
         pr2serr("iflag=swait is treated as oflag=swait\n");
         clp->out_flags.swait = true;
@@ -3676,6 +4050,24 @@ main(int argc, char * argv[])
             return SG_LIB_SYNTAX_ERROR;
         }
     }
+    if (clp->mrq_auto) {
+        if (((FT_SG == clp->in_type) && clp->in_flags.v4) ||
+            ((FT_SG == clp->out_type) && clp->out_flags.v4))
+            clp->auto_nmrqs = clp->nmrqs;
+        else {
+            pr2serr("mrq=auto needs an sg device using the v4 interface, "
+                    "ignored\n");
+            clp->mrq_auto = false;
+            clp->nmrqs = 0;
+        }
+    }
+    if ((hash_alg || manf[0] || verf[0]) && (FT_SG == clp->in_type) &&
+        ((clp->nmrqs > 0) || clp->in_flags.noxfer || clp->out_flags.swait)) {
+        /* READ data is not in this thread's buffer when hashed */
+        pr2serr("hash=, manifest= and verify= can't be used with mrq=, "
+                "iflag=noxfer nor swait when IFILE is a sg device\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
     if (outregf[0]) {
         int ftyp = dd_filetype(outregf);
 
@@ -3812,6 +4204,8 @@ main(int argc, char * argv[])
     clp->out_rem_count = dd_count;
     clp->seek = seek;
     clp->out_blk = seek;
+    if (do_numa)
+        numa_setup(clp);
     status = pthread_mutex_init(&clp->in_mutex, NULL);
     if (0 != status) err_exit(status, "init in_mutex");
     status = pthread_mutex_init(&clp->out_mutex, NULL);
@@ -3837,6 +4231,21 @@ main(int argc, char * argv[])
                             sig_listen_thread, (void *)clp);
     if (0 != status) err_exit(status, "pthread_create, sig...");
 
+    if (hash_alg || manf[0] || verf[0]) {
+        /* workers created after SIGINT blocked so they inherit that */
+        if (0 == hash_alg)
+            sg_hash_parse("crc32c", &hash_alg, &hash_thr);
+        clp->hash_stagep = sg_hash_stage_create(hash_alg, hash_thr, clp->bs,
+                                                clp->bpt);
+        if (NULL == clp->hash_stagep)
+            err_exit(ENOMEM, "out of memory creating hash stage\n");
+        for (k = 0; k < hash_thr; ++k) {
+            status = pthread_create(hash_thr_arr + k, NULL,
+                                    sg_hash_stage_worker, clp->hash_stagep);
+            if (0 != status) err_exit(status, "pthread_create, hash");
+        }
+        num_hash_thr = hash_thr;
+    }
     if (do_time) {
         start_tm.tv_sec = 0;
         start_tm.tv_usec = 0;
@@ -3846,6 +4255,16 @@ main(int argc, char * argv[])
 /* vvvvvvvvvvv  Start worker threads  vvvvvvvvvvvvvvvvvvvvvvvv */
     if ((clp->out_rem_count.load() > 0) && (num_threads > 0)) {
         Thread_info *tip = thread_arr + 0;
+        pthread_t log_drain_id;
+        pthread_t auto_tune_id;
+
+        /* workers log to per thread rings, drained by another thread */
+        status = sg_log_ring_start(0, (clp->debug > 2) ?
+                                   (SG_LOG_RING_TS | SG_LOG_RING_TID) : 0);
+        if (0 != status) err_exit(ENOMEM, "sg_log_ring_start");
+        status = pthread_create(&log_drain_id, NULL, sg_log_ring_drain_loop,
+                                NULL);
+        if (0 != status) err_exit(status, "pthread_create, log drain");
 
         tip->gcp = clp;
         tip->id = 0;
@@ -3873,6 +4292,11 @@ main(int argc, char * argv[])
                                     (void *)tip);
             if (0 != status) err_exit(status, "pthread_create");
         }
+        if (clp->thr_auto || clp->mrq_auto) {
+            status = pthread_create(&auto_tune_id, NULL, auto_tune_thread,
+                                    (void *)clp);
+            if (0 != status) err_exit(status, "pthread_create, auto tune");
+        }
 
         /* now wait for worker threads to finish */
         for (k = 0; k < num_threads; ++k) {
@@ -3883,6 +4307,14 @@ main(int argc, char * argv[])
                 pr2serr_lk("%d <-- Worker thread terminated, vp=%s\n", k,
                            ((vp == clp) ? "clp" : "NULL (or !clp)"));
         }
+        if (clp->thr_auto || clp->mrq_auto) {
+            auto_tune_stop = true;
+            pthread_join(auto_tune_id, NULL);
+        }
+        sg_log_ring_stop();
+        pthread_join(log_drain_id, NULL);
+        if (do_numa)
+            numa_report(clp, thread_arr);
     }   /* started worker threads and here after they have all exited */
 
     if (do_time && (start_tm.tv_sec || start_tm.tv_usec))
@@ -3940,6 +4372,19 @@ fini:
             res = SG_LIB_CAT_OTHER;
     }
     print_stats("");
+    if (clp->hash_stagep) {
+        sg_hash_stage_stop(clp->hash_stagep);
+        for (k = 0; k < num_hash_thr; ++k) {
+            status = pthread_join(hash_thr_arr[k], NULL);
+            if (0 != status) err_exit(status, "pthread_join, hash");
+        }
+        k = sg_hash_stage_finish(clp->hash_stagep, (manf[0] ? manf : NULL),
+                                 (verf[0] ? verf : NULL), clp->debug);
+        if (k && (0 == res))
+            res = k;
+        sg_hash_stage_destroy(clp->hash_stagep);
+        clp->hash_stagep = NULL;
+    }
     if (clp->dio_incomplete_count.load()) {
         int fd;
         char c;
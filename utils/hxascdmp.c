@@ -24,11 +24,14 @@
 
 static int bytes_per_line = DEF_BYTES_PER_LINE;
 
-static const char * version_str = "1.11 20190527";
+static const char * version_str = "1.12 20261017";
 
 #define CHARS_PER_HEX_BYTE 3
 #define BINARY_START_COL 6
 #define MAX_LINE_LENGTH 257
+#define STDOUT_BUFF_LEN (64 * 1024)
+
+static const char hex_digits[] = "0123456789abcdef";
 
 
 #ifdef SG_LIB_MINGW
@@ -239,7 +242,8 @@ dStrHex(const char* str, int len, long start, int noAddr)
     for(j = 0; j < len; j++) {
         nl = (0 == (j % bytes_per_line));
         if ((j > 0) && nl) {
-            printf("%s\n", buff);
+            buff[line_length] = '\n';
+            fwrite(buff, 1, line_length + 1, stdout);
             bpos = bpstart;
             cpos = cpstart;
             a += bytes_per_line;
@@ -253,14 +257,17 @@ dStrHex(const char* str, int len, long start, int noAddr)
         bpos += (nl && noAddr) ?  0 : CHARS_PER_HEX_BYTE;
         if ((bytes_per_line > 4) && ((j % bytes_per_line) == midline_space))
             bpos++;
-        sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
+        buff[bpos] = hex_digits[c >> 4];
+        buff[bpos + 1] = hex_digits[c & 0xf];
         buff[bpos + 2] = ' ';
         if ((c < ' ') || (c >= 0x7f))
             c='.';
         buff[cpos++] = c;
     }
-    if (cpos > cpstart)
-        printf("%s\n", buff);
+    if (cpos > cpstart) {
+        buff[line_length] = '\n';
+        fwrite(buff, 1, line_length + 1, stdout);
+    }
 }
 
 static void
@@ -295,7 +302,8 @@ dStrHexOnly(const char* str, int len, long start, int noAddr)
     for(j = 0; j < len; j++) {
         nl = (0 == (j % bytes_per_line));
         if ((j > 0) && nl) {
-            printf("%s\n", buff);
+            buff[line_length] = '\n';
+            fwrite(buff, 1, line_length + 1, stdout);
             bpos = bpstart;
             a += bytes_per_line;
             memset(buff,' ', line_length);
@@ -308,11 +316,14 @@ dStrHexOnly(const char* str, int len, long start, int noAddr)
         bpos += (nl && noAddr) ? 0 : CHARS_PER_HEX_BYTE;
         if ((bytes_per_line > 4) && ((j % bytes_per_line) == midline_space))
             bpos++;
-        sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
+        buff[bpos] = hex_digits[c >> 4];
+        buff[bpos + 1] = hex_digits[c & 0xf];
         buff[bpos + 2] = ' ';
     }
-    if (bpos > bpstart)
-        printf("%s\n", buff);
+    if (bpos > bpstart) {
+        buff[line_length] = '\n';
+        fwrite(buff, 1, line_length + 1, stdout);
+    }
 }
 
 static void
@@ -436,6 +447,9 @@ main(int argc, const char ** argv)
         return 0;
     }
 
+    /* lines are written whole, let stdio gather many before a write() */
+    setvbuf(stdout, NULL, _IOFBF, STDOUT_BUFF_LEN);
+
     /* Make sure num to fetch is integral multiple of bytes_per_line */
     if (0 != (num % bytes_per_line))
         num = (num / bytes_per_line) * bytes_per_line;